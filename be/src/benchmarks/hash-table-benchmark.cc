@@ -0,0 +1,160 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+#include <vector>
+
+#include "common/object-pool.h"
+#include "exec/hash-table.inline.h"
+#include "exprs/expr.h"
+#include "exprs/expr-context.h"
+#include "exprs/slot-ref.h"
+#include "runtime/descriptors.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/tuple-row.h"
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
+
+using namespace impala;
+using namespace std;
+
+// Benchmark for probing the HashTable used by the partitioned join and aggregation
+// nodes, as a function of the table size. The table holds 'n' distinct int keys and is
+// probed with batches of 1024 random keys, half of which are in the table. Each
+// iteration probes one batch. Two probe loops are compared:
+//   1. Find: evaluate, hash and look up one row at a time.
+//   2. Batched Find: evaluate and hash the whole batch into the row cache while
+//      prefetching the buckets, then look up the cached rows. This is what the
+//      partitioned join and aggregation nodes do.
+// Small tables fit in cache and both loops are bound by expr evaluation and hashing.
+// Once the buckets no longer fit in cache, the row-at-a-time loop waits for one bucket
+// miss per row and its rate drops with the table size, while the batched loop overlaps
+// the misses of a batch.
+// The suites also print the number of hash collisions, i.e. rows that were compared
+// because the cached hash bits matched but were not equal. With 56 cached hash bits
+// this is expected to stay at 0 for all table sizes.
+
+static const int BATCH_SIZE = 1024;
+
+struct TestData {
+  HashTable* table;
+  HashTableCtx* ht_ctx;
+  vector<TupleRow*> probe_rows;
+  int64_t num_matches;
+};
+
+static TupleRow* CreateTupleRow(MemPool* pool, int32_t val) {
+  TupleRow* row = reinterpret_cast<TupleRow*>(pool->Allocate(sizeof(Tuple*)));
+  Tuple* tuple = Tuple::Create(sizeof(int32_t), pool);
+  *reinterpret_cast<int32_t*>(tuple) = val;
+  row->SetTuple(0, tuple);
+  return row;
+}
+
+void TestFind(int batch, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch; ++i) {
+    for (int j = 0; j < data->probe_rows.size(); ++j) {
+      uint64_t hash;
+      if (!data->ht_ctx->EvalAndHashProbe(data->probe_rows[j], &hash)) continue;
+      data->num_matches += !data->table->Find(data->ht_ctx, hash).AtEnd();
+    }
+  }
+}
+
+void TestBatchedFind(int batch, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  const int num_rows = data->probe_rows.size();
+  for (int i = 0; i < batch; ++i) {
+    for (int j = 0; j < num_rows; ++j) {
+      uint64_t hash;
+      if (!data->ht_ctx->EvalAndHashProbe(data->probe_rows[j], &hash)) {
+        data->ht_ctx->CacheRejectedRow(j);
+        continue;
+      }
+      data->ht_ctx->CacheCurrentRow(j, hash);
+      data->table->PrefetchBucket(hash);
+    }
+    for (int j = 0; j < num_rows; ++j) {
+      uint64_t hash;
+      if (!data->ht_ctx->LoadCachedRow(j, &hash)) continue;
+      data->num_matches += !data->table->Find(data->ht_ctx, hash).AtEnd();
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  CpuInfo::Init();
+  cout << Benchmark::GetMachineInfo() << endl;
+
+  ObjectPool obj_pool;
+  MemTracker tracker;
+  RowDescriptor desc;
+  vector<ExprContext*> build_expr_ctxs;
+  vector<ExprContext*> probe_expr_ctxs;
+  build_expr_ctxs.push_back(
+      obj_pool.Add(new ExprContext(obj_pool.Add(new SlotRef(TYPE_INT, 0)))));
+  probe_expr_ctxs.push_back(
+      obj_pool.Add(new ExprContext(obj_pool.Add(new SlotRef(TYPE_INT, 0)))));
+  Status status = Expr::Prepare(build_expr_ctxs, NULL, desc, &tracker);
+  if (status.ok()) status = Expr::Prepare(probe_expr_ctxs, NULL, desc, &tracker);
+  if (status.ok()) status = Expr::Open(build_expr_ctxs, NULL);
+  if (status.ok()) status = Expr::Open(probe_expr_ctxs, NULL);
+  if (!status.ok()) {
+    cout << "Could not prepare exprs: " << status.GetDetail();
+    return -1;
+  }
+
+  const int64_t TABLE_SIZES[] = { 1024, 64 * 1024, 1024 * 1024, 4 * 1024 * 1024 };
+  for (int i = 0; i < sizeof(TABLE_SIZES) / sizeof(TABLE_SIZES[0]); ++i) {
+    const int64_t num_keys = TABLE_SIZES[i];
+    MemPool mem_pool(&tracker);
+    HashTableCtx ht_ctx(build_expr_ctxs, probe_expr_ctxs, false, false, 1, 0, 1);
+    HashTable table(&mem_pool, false, HashTable::EstimateNumBuckets(num_keys));
+    for (int64_t key = 0; key < num_keys; ++key) {
+      TupleRow* row = CreateTupleRow(&mem_pool, key);
+      uint64_t hash;
+      if (!ht_ctx.EvalAndHashBuild(row, &hash)) continue;
+      table.Insert(&ht_ctx, row->GetTuple(0), hash);
+    }
+
+    TestData data;
+    data.table = &table;
+    data.ht_ctx = &ht_ctx;
+    data.num_matches = 0;
+    for (int j = 0; j < BATCH_SIZE; ++j) {
+      data.probe_rows.push_back(CreateTupleRow(&mem_pool, rand() % (2 * num_keys)));
+    }
+    ht_ctx.ReserveRowCache(BATCH_SIZE);
+
+    stringstream name;
+    name << "Probe " << num_keys << " keys";
+    Benchmark suite(name.str());
+    suite.AddBenchmark("Find", TestFind, &data);
+    suite.AddBenchmark("Batched Find", TestBatchedFind, &data);
+    cout << suite.Measure() << endl;
+    cout << table.PrintStats() << endl;
+
+    table.Close();
+    ht_ctx.Close();
+    mem_pool.FreeAll();
+  }
+
+  Expr::Close(build_expr_ctxs, NULL);
+  Expr::Close(probe_expr_ctxs, NULL);
+  return 0;
+}
@@ -0,0 +1,202 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <algorithm>
+#include <iostream>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "common/object-pool.h"
+#include "exprs/expr.h"
+#include "exprs/expr-context.h"
+#include "exprs/slot-ref.h"
+#include "runtime/descriptors.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/string-value.h"
+#include "runtime/tuple-row.h"
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
+#include "util/key-normalizer.inline.h"
+#include "util/normalized-key-sorter.h"
+#include "util/tuple-row-compare.h"
+
+using namespace impala;
+using namespace std;
+
+// Benchmark for the two ways the sorter sorts a run in memory, for int, string and
+// multi-column (int, string, bigint) keys. Each iteration sorts the same 64K rows.
+//   1. Comparator: a comparison sort that evaluates the sort exprs of both rows with
+//      TupleRowComparator for every comparison.
+//   2. Normalized keys: evaluate the sort exprs once per row to build a normalized key
+//      prefix with KeyNormalizer, radix sort the prefixes with NormalizedKeySorter and
+//      use the comparator only for equal prefixes of keys that did not fit.
+// The cost of the radix sort does not grow with the number of key columns, while every
+// comparison of the comparator sort evaluates exprs until the first differing column.
+// The multi-column keys have only 100 distinct ints, so both sorts have to look at the
+// strings for most rows.
+
+static const int NUM_ROWS = 64 * 1024;
+
+// Layout of the tuples that are sorted.
+struct SortTuple {
+  int32_t int_val;
+  int64_t bigint_val;
+  StringValue string_val;
+};
+
+struct TestData {
+  vector<SortTuple> tuples;
+  vector<TupleRow*> rows;
+  vector<TupleRow*> sorted_rows;
+  vector<NormalizedKeySorter::Entry> entries;
+  TupleRowComparator* comparator;
+  KeyNormalizer* normalizer;
+};
+
+// Compares rows through a pointer to the comparator, so std::sort() does not copy it.
+struct RowLessThan {
+  RowLessThan(const TupleRowComparator* comparator) : comparator_(comparator) { }
+  bool operator()(TupleRow* lhs, TupleRow* rhs) const {
+    return (*comparator_)(lhs, rhs);
+  }
+  const TupleRowComparator* comparator_;
+};
+
+// Breaks ties between normalized keys by comparing the rows.
+struct RowIndexLessThan {
+  RowIndexLessThan(const TestData* data) : data_(data) { }
+  bool operator()(uint32_t lhs, uint32_t rhs) const {
+    return (*data_->comparator)(data_->rows[lhs], data_->rows[rhs]);
+  }
+  const TestData* data_;
+};
+
+void TestComparator(int batch, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch; ++i) {
+    data->sorted_rows = data->rows;
+    sort(data->sorted_rows.begin(), data->sorted_rows.end(),
+        RowLessThan(data->comparator));
+  }
+}
+
+void TestNormalizedKeys(int batch, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  const int num_rows = data->rows.size();
+  NormalizedKeySorter::Entry* entries = &data->entries[0];
+  RowIndexLessThan tie_less_than(data);
+  for (int i = 0; i < batch; ++i) {
+    bool went_over_budget = false;
+    for (int j = 0; j < num_rows; ++j) {
+      went_over_budget |= data->normalizer->NormalizeKey(data->rows[j], entries[j].key);
+      entries[j].index = j;
+    }
+    NormalizedKeySorter::Sort(entries, entries + num_rows,
+        went_over_budget ? &tie_less_than : NULL);
+    for (int j = 0; j < num_rows; ++j) {
+      data->sorted_rows[j] = data->rows[entries[j].index];
+    }
+  }
+}
+
+static string RandomString(int min_len, int max_len) {
+  int len = min_len + rand() % (max_len - min_len + 1);
+  string result(len, 'a');
+  for (int i = 0; i < len; ++i) result[i] = 'a' + rand() % 26;
+  return result;
+}
+
+// Sorts NUM_ROWS rows by the exprs in 'ctxs' with both methods.
+static void RunBenchmark(const string& name, const vector<ExprContext*>& ctxs,
+    vector<string>* strings) {
+  TestData data;
+  data.tuples.resize(NUM_ROWS);
+  for (int i = 0; i < NUM_ROWS; ++i) {
+    data.tuples[i].int_val = rand();
+    data.tuples[i].bigint_val = rand();
+    data.tuples[i].string_val = StringValue(const_cast<char*>((*strings)[i].data()),
+        (*strings)[i].size());
+  }
+  // The multi-column keys only have few distinct leading values.
+  if (ctxs.size() > 1) {
+    for (int i = 0; i < NUM_ROWS; ++i) data.tuples[i].int_val %= 100;
+  }
+  data.rows.resize(NUM_ROWS);
+  for (int i = 0; i < NUM_ROWS; ++i) {
+    // Each row is a single tuple pointer, which is stored in the row itself.
+    data.rows[i] = reinterpret_cast<TupleRow*>(new Tuple*[1]);
+    data.rows[i]->SetTuple(0, reinterpret_cast<Tuple*>(&data.tuples[i]));
+  }
+  data.sorted_rows.resize(NUM_ROWS);
+  data.entries.resize(NUM_ROWS);
+
+  vector<bool> is_asc(ctxs.size(), true);
+  vector<bool> nulls_first(ctxs.size(), false);
+  TupleRowComparator comparator(ctxs, ctxs, is_asc, nulls_first);
+  KeyNormalizer normalizer(ctxs, NormalizedKeySorter::KEY_LEN, is_asc, nulls_first);
+  data.comparator = &comparator;
+  data.normalizer = &normalizer;
+
+  Benchmark suite(name);
+  suite.AddBenchmark("Comparator", TestComparator, &data);
+  suite.AddBenchmark("Normalized keys", TestNormalizedKeys, &data);
+  cout << suite.Measure() << endl;
+
+  for (int i = 0; i < NUM_ROWS; ++i) delete[] reinterpret_cast<Tuple**>(data.rows[i]);
+}
+
+int main(int argc, char **argv) {
+  CpuInfo::Init();
+  cout << Benchmark::GetMachineInfo() << endl;
+
+  ObjectPool obj_pool;
+  MemTracker tracker;
+  RowDescriptor desc;
+  ExprContext* int_ctx = obj_pool.Add(new ExprContext(obj_pool.Add(
+      new SlotRef(TYPE_INT, offsetof(SortTuple, int_val)))));
+  ExprContext* bigint_ctx = obj_pool.Add(new ExprContext(obj_pool.Add(
+      new SlotRef(TYPE_BIGINT, offsetof(SortTuple, bigint_val)))));
+  ExprContext* string_ctx = obj_pool.Add(new ExprContext(obj_pool.Add(
+      new SlotRef(TYPE_STRING, offsetof(SortTuple, string_val)))));
+  vector<ExprContext*> all_ctxs;
+  all_ctxs.push_back(int_ctx);
+  all_ctxs.push_back(bigint_ctx);
+  all_ctxs.push_back(string_ctx);
+  Status status = Expr::Prepare(all_ctxs, NULL, desc, &tracker);
+  if (status.ok()) status = Expr::Open(all_ctxs, NULL);
+  if (!status.ok()) {
+    cout << "Could not prepare exprs: " << status.GetDetail();
+    return -1;
+  }
+
+  vector<string> strings;
+  for (int i = 0; i < NUM_ROWS; ++i) strings.push_back(RandomString(8, 20));
+
+  vector<ExprContext*> int_key(1, int_ctx);
+  RunBenchmark("Int key", int_key, &strings);
+
+  vector<ExprContext*> string_key(1, string_ctx);
+  RunBenchmark("String key", string_key, &strings);
+
+  vector<ExprContext*> multi_column_key;
+  multi_column_key.push_back(int_ctx);
+  multi_column_key.push_back(string_ctx);
+  multi_column_key.push_back(bigint_ctx);
+  RunBenchmark("Multi-column key", multi_column_key, &strings);
+
+  Expr::Close(all_ctxs, NULL);
+  return 0;
+}
@@ -1096,6 +1096,10 @@ Function* LlvmCodeGen::GetMurmurHashFunction(int len) {
   return GetLenOptimizedHashFn(this, IRFunction::HASH_MURMUR, len);
 }
 
+Function* LlvmCodeGen::GetMurmur64HashFunction(int len) {
+  return GetLenOptimizedHashFn(this, IRFunction::HASH_MURMUR64, len);
+}
+
 void LlvmCodeGen::ReplaceInstWithValue(Instruction* from, Value* to) {
   BasicBlock::iterator iter(from);
   llvm::ReplaceInstWithValue(from->getParent()->getInstList(), iter, to);
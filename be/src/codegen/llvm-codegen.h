@@ -346,6 +346,11 @@ class LlvmCodeGen {
   llvm::Function* GetFnvHashFunction(int num_bytes = -1);
   llvm::Function* GetMurmurHashFunction(int num_bytes = -1);
 
+  // Returns the 64-bit murmur hash function with signature:
+  //   int64_t Hash(int8_t* data, int len, int64_t seed);
+  // 'num_bytes' has the same meaning as above.
+  llvm::Function* GetMurmur64HashFunction(int num_bytes = -1);
+
   // Allocate stack storage for local variables.  This is similar to traditional c, where
   // all the variables must be declared at the top of the function.  This helper can be
   // called from anywhere and will add a stack allocation for 'var' at the beginning of
@@ -15,10 +15,13 @@
 #include "exec/analytic-eval-node.h"
 
 #include "exprs/agg-fn-evaluator.h"
+#include "exprs/aggregate-functions.h"
+#include "runtime/raw-value.h"
 #include "runtime/buffered-tuple-stream.inline.h"
 #include "runtime/descriptors.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
+#include "runtime/string-value.h"
 #include "udf/udf-internal.h"
 
 using namespace std;
@@ -40,6 +43,7 @@ AnalyticEvalNode::AnalyticEvalNode(ObjectPool* pool, const TPlanNode& tnode,
     order_by_eq_expr_ctx_(NULL),
     rows_start_offset_(0),
     rows_end_offset_(0),
+    has_sliding_min_max_(false),
     has_first_val_null_offset_(false),
     first_val_null_offset_(0),
     last_result_idx_(-1),
@@ -190,7 +194,32 @@ Status AnalyticEvalNode::Open(RuntimeState* state) {
       VLOG_FILE << id() << " FIRST_VAL rewrite null offset: " << first_val_null_offset_;
       has_first_val_null_offset_ = true;
     }
+
+    FastPath fast_path = NO_FAST_PATH;
+    const AggFnEvaluator* evaluator = evaluators_[i];
+    if (evaluator->is_builtin()) {
+      if (evaluator->fn_name() == "row_number") {
+        fast_path = ROW_NUMBER;
+      } else if (evaluator->fn_name() == "rank") {
+        fast_path = RANK;
+      } else if (evaluator->fn_name() == "dense_rank") {
+        fast_path = DENSE_RANK;
+      } else if (fn_scope_ == ROWS && window_.__isset.window_start &&
+          (evaluator->agg_op() == AggFnEvaluator::MIN ||
+           evaluator->agg_op() == AggFnEvaluator::MAX)) {
+        // The FE only allows min()/max() with a start bound offset for fixed-length
+        // types.
+        const ColumnType& type = evaluator->intermediate_type();
+        DCHECK(!type.IsStringType()) << type;
+        DCHECK_LE(type.GetByteSize(), sizeof(SlidingValue().value));
+        DCHECK_EQ(evaluator->input_expr_ctxs().size(), 1);
+        fast_path = evaluator->agg_op() == AggFnEvaluator::MIN ? SLIDING_MIN : SLIDING_MAX;
+        has_sliding_min_max_ = true;
+      }
+    }
+    fast_paths_.push_back(fast_path);
   }
+  sliding_values_.resize(evaluators_.size());
 
   if (partition_by_eq_expr_ctx_ != NULL) {
     RETURN_IF_ERROR(partition_by_eq_expr_ctx_->Open(state));
@@ -307,7 +336,7 @@ inline Status AnalyticEvalNode::AddRow(int64_t stream_idx, TupleRow* row) {
   if (fn_scope_ != ROWS || !window_.__isset.window_start ||
       stream_idx - rows_start_offset_ >= curr_partition_idx_) {
     VLOG_ROW << id() << " Update idx=" << stream_idx;
-    AggFnEvaluator::Add(evaluators_, fn_ctxs_, row, curr_tuple_);
+    UpdateEvaluators(stream_idx, row);
     if (window_.__isset.window_start) {
       VLOG_ROW << id() << " Adding tuple to window at idx=" << stream_idx;
       Tuple* tuple = row->GetTuple(0)->DeepCopy(*child_tuple_desc_,
@@ -334,12 +363,90 @@ inline Status AnalyticEvalNode::AddRow(int64_t stream_idx, TupleRow* row) {
   return Status::OK;
 }
 
+inline void AnalyticEvalNode::UpdateEvaluators(int64_t stream_idx, TupleRow* row) {
+  for (int i = 0; i < evaluators_.size(); ++i) {
+    switch (fast_paths_[i]) {
+      case ROW_NUMBER: {
+        const SlotDescriptor* slot_desc = intermediate_tuple_desc_->slots()[i];
+        ++*reinterpret_cast<int64_t*>(curr_tuple_->GetSlot(slot_desc->tuple_offset()));
+        break;
+      }
+      case RANK: {
+        const SlotDescriptor* slot_desc = intermediate_tuple_desc_->slots()[i];
+        StringValue* state =
+            reinterpret_cast<StringValue*>(curr_tuple_->GetSlot(slot_desc->tuple_offset()));
+        DCHECK_EQ(state->len, sizeof(AggregateFunctions::RankState));
+        ++reinterpret_cast<AggregateFunctions::RankState*>(state->ptr)->count;
+        break;
+      }
+      case DENSE_RANK:
+        break;
+      case SLIDING_MIN:
+      case SLIDING_MAX:
+        AddSlidingValue(i, stream_idx, row);
+        break;
+      default:
+        evaluators_[i]->Add(fn_ctxs_[i], row, curr_tuple_);
+    }
+  }
+}
+
+inline void AnalyticEvalNode::RemoveFromEvaluators(int64_t stream_idx, TupleRow* row) {
+  for (int i = 0; i < evaluators_.size(); ++i) {
+    if (fast_paths_[i] == SLIDING_MIN || fast_paths_[i] == SLIDING_MAX) {
+      deque<SlidingValue>* values = &sliding_values_[i];
+      while (!values->empty() && values->front().stream_idx <= stream_idx) {
+        values->pop_front();
+      }
+    } else {
+      DCHECK_EQ(fast_paths_[i], NO_FAST_PATH);
+      evaluators_[i]->Remove(fn_ctxs_[i], row, curr_tuple_);
+    }
+  }
+}
+
+inline void AnalyticEvalNode::AddSlidingValue(int evaluator_idx, int64_t stream_idx,
+    TupleRow* row) {
+  void* value = evaluators_[evaluator_idx]->input_expr_ctxs()[0]->GetValue(row);
+  // NULLs are ignored by min() and max().
+  if (value == NULL) return;
+  const ColumnType& type = evaluators_[evaluator_idx]->intermediate_type();
+  deque<SlidingValue>* values = &sliding_values_[evaluator_idx];
+  bool is_min = fast_paths_[evaluator_idx] == SLIDING_MIN;
+  // Values before this one that are not smaller (min) or larger (max) leave the window
+  // before it and can never be the result again.
+  while (!values->empty()) {
+    int cmp = RawValue::Compare(values->back().value, value, type);
+    if (is_min ? cmp < 0 : cmp > 0) break;
+    values->pop_back();
+  }
+  values->push_back(SlidingValue());
+  values->back().stream_idx = stream_idx;
+  memcpy(values->back().value, value, type.GetByteSize());
+}
+
+void AnalyticEvalNode::WriteSlidingValues() {
+  for (int i = 0; i < evaluators_.size(); ++i) {
+    if (fast_paths_[i] != SLIDING_MIN && fast_paths_[i] != SLIDING_MAX) continue;
+    const SlotDescriptor* slot_desc = intermediate_tuple_desc_->slots()[i];
+    if (sliding_values_[i].empty()) {
+      curr_tuple_->SetNull(slot_desc->null_indicator_offset());
+    } else {
+      // RawValue::Write() does not clear the null indicator, which the init function
+      // of min()/max() sets.
+      curr_tuple_->SetNotNull(slot_desc->null_indicator_offset());
+      RawValue::Write(sliding_values_[i].front().value, curr_tuple_, slot_desc, NULL);
+    }
+  }
+}
+
 void AnalyticEvalNode::AddResultTuple(int64_t stream_idx) {
   VLOG_ROW << id() << " AddResultTuple idx=" << stream_idx;
   DCHECK(curr_tuple_ != NULL);
   Tuple* result_tuple = Tuple::Create(result_tuple_desc_->byte_size(),
       curr_tuple_pool_.get());
 
+  if (has_sliding_min_max_) WriteSlidingValues();
   AggFnEvaluator::GetValue(evaluators_, fn_ctxs_, curr_tuple_, result_tuple);
   DCHECK_GT(stream_idx, last_result_idx_);
   result_tuples_.push_back(pair<int64_t, Tuple*>(stream_idx, result_tuple));
@@ -384,7 +491,7 @@ inline void AnalyticEvalNode::TryRemoveRowsBeforeWindow(int64_t stream_idx) {
   DCHECK_EQ(remove_idx + max(rows_start_offset_, 0L), window_tuples_.front().first)
       << DebugStateString(true);
   TupleRow* remove_row = reinterpret_cast<TupleRow*>(&window_tuples_.front().second);
-  AggFnEvaluator::Remove(evaluators_, fn_ctxs_, remove_row, curr_tuple_);
+  RemoveFromEvaluators(window_tuples_.front().first, remove_row);
   window_tuples_.pop_front();
 }
 
@@ -420,7 +527,7 @@ inline void AnalyticEvalNode::TryAddRemainingResults(int64_t partition_idx,
       VLOG_ROW << id() << " Remove window_row_idx=" << window_tuples_.front().first
                << " for result row at idx=" << next_result_idx;
       TupleRow* remove_row = reinterpret_cast<TupleRow*>(&window_tuples_.front().second);
-      AggFnEvaluator::Remove(evaluators_, fn_ctxs_, remove_row, curr_tuple_);
+      RemoveFromEvaluators(window_tuples_.front().first, remove_row);
       window_tuples_.pop_front();
     }
     AddResultTuple(last_result_idx_ + 1);
@@ -478,6 +585,7 @@ inline void AnalyticEvalNode::InitNextPartition(int64_t stream_idx) {
     TryAddRemainingResults(stream_idx, prev_partition_stream_idx);
   }
   window_tuples_.clear();
+  for (int i = 0; i < sliding_values_.size(); ++i) sliding_values_[i].clear();
 
   VLOG_ROW << id() << " Reset curr_tuple";
   // Call finalize to release resources; result is not needed but the dst tuple must be
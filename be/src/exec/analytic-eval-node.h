@@ -15,6 +15,8 @@
 #ifndef IMPALA_EXEC_ANALYTIC_EVAL_NODE_H
 #define IMPALA_EXEC_ANALYTIC_EVAL_NODE_H
 
+#include <deque>
+
 #include "exec/exec-node.h"
 #include "exprs/expr.h"
 #include "exprs/expr-context.h"
@@ -107,6 +109,35 @@ class AnalyticEvalNode : public ExecNode {
     ROWS
   };
 
+  // Analytic functions that are evaluated by the node itself instead of calling
+  // AggFnEvaluator::Add()/Remove() for every input row. Set per evaluator in Open().
+  enum FastPath {
+    NO_FAST_PATH,
+
+    // row_number(): the BIGINT intermediate value is incremented in place.
+    ROW_NUMBER,
+
+    // rank(): the row count of the RankState intermediate value is incremented in place.
+    RANK,
+
+    // dense_rank(): the update is a no-op, so nothing is done per row.
+    DENSE_RANK,
+
+    // min()/max() over a ROWS window with a start bound offset, which cannot be
+    // evaluated with Remove(). The values in the window are kept in a monotonic deque
+    // in sliding_values_ and the min/max is written to curr_tuple_ in AddResultTuple().
+    SLIDING_MIN,
+    SLIDING_MAX
+  };
+
+  // A non-NULL input value of a sliding min()/max() and the index in input_stream_ of
+  // the row it belongs to. Only fixed-length types are supported, the largest of which
+  // (TIMESTAMP and DECIMAL) are 16 bytes.
+  struct SlidingValue {
+    int64_t stream_idx;
+    uint8_t value[16];
+  };
+
   // Evaluates analytic functions over curr_child_batch_. Each input row is passed
   // to the evaluators and added to input_stream_ where they are stored until a tuple
   // containing the results of the analytic functions for that row is ready to be
@@ -149,6 +180,23 @@ class AnalyticEvalNode : public ExecNode {
   // ProcessChildBatch().
   void TryRemoveRowsBeforeWindow(int64_t stream_idx);
 
+  // Adds the row at stream_idx to curr_tuple_, either with the fast path of each
+  // evaluator or by calling AggFnEvaluator::Add().
+  void UpdateEvaluators(int64_t stream_idx, TupleRow* row);
+
+  // Removes the row at stream_idx, which is no longer in the window, from curr_tuple_,
+  // either with the fast path of each evaluator or by calling AggFnEvaluator::Remove().
+  void RemoveFromEvaluators(int64_t stream_idx, TupleRow* row);
+
+  // Adds the input value of the SLIDING_MIN/SLIDING_MAX evaluator at 'evaluator_idx'
+  // for the row at stream_idx to sliding_values_, dropping the values that can no
+  // longer be the min/max of any window.
+  void AddSlidingValue(int evaluator_idx, int64_t stream_idx, TupleRow* row);
+
+  // Writes the min/max of the current window of every SLIDING_MIN/SLIDING_MAX
+  // evaluator into its intermediate slot in curr_tuple_.
+  void WriteSlidingValues();
+
   // Initializes state at the start of a new partition. stream_idx is the index of the
   // current input row from input_stream_.
   void InitNextPartition(int64_t stream_idx);
@@ -225,6 +273,19 @@ class AnalyticEvalNode : public ExecNode {
   // determine which slots need to be reset.
   std::vector<bool> is_lead_fn_;
 
+  // The fast path of each evaluator.
+  std::vector<FastPath> fast_paths_;
+
+  // True if any evaluator is SLIDING_MIN or SLIDING_MAX.
+  bool has_sliding_min_max_;
+
+  // For each SLIDING_MIN/SLIDING_MAX evaluator, the values in the current window that
+  // may still become its min/max, ordered by stream index. The values are strictly
+  // increasing (min) or decreasing (max) from the front, so the front is the min/max of
+  // the window. Every value is pushed and popped once, so maintaining the window is
+  // amortized O(1) per row regardless of the window size. Empty for other evaluators.
+  std::vector<std::deque<SlidingValue> > sliding_values_;
+
   // If true, evaluating FIRST_VALUE requires special null handling when initializing new
   // partitions determined by the offset. Set in Open() by inspecting the agg fns.
   bool has_first_val_null_offset_;
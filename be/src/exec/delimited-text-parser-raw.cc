@@ -65,14 +65,14 @@ void RawDelimitedTextParser::setupSearchCharacters(){
 
 	    // To process escape characters, we need to check if there was an escape
 	    // character between (col_start,col_end).  The SSE instructions return
-	    // a bit mask for 16 bits so we need to mask off the bits below col_start
-	    // and after col_end.
-	    low_mask_[0] = 0xffff;
-	    high_mask_[15] = 0xffff;
-	    for (int i = 1; i < 16; ++i) {
+	    // a bit mask for 16 (32 for AVX2) bits so we need to mask off the bits below
+	    // col_start and after col_end.
+	    low_mask_[0] = 0xffffffff;
+	    high_mask_[31] = 0xffffffff;
+	    for (int i = 1; i < 32; ++i) {
 	      low_mask_[i] = low_mask_[i - 1] << 1;
 	    }
-	    for (int i = 14; i >= 0; --i) {
+	    for (int i = 30; i >= 0; --i) {
 	      high_mask_[i] = high_mask_[i + 1] >> 1;
 	    }
 	  }
@@ -95,7 +95,11 @@ void RawDelimitedTextParser::setupSearchCharacters(){
 	  }
 
 	  DCHECK_GT(num_delims_, 0);
+	  DCHECK_LE(num_delims_, SSEUtil::AVX2_MAX_SEARCH_CHARS);
 	  xmm_delim_search_ = _mm_loadu_si128(reinterpret_cast<__m128i*>(search_chars));
+	  for (int i = 0; i < SSEUtil::AVX2_MAX_SEARCH_CHARS; ++i) {
+	    avx2_delim_search_[i] = search_chars[i < num_delims_ ? i : 0];
+	  }
 }
 
 void RawDelimitedTextParser::parserResetInternal(bool hard){
@@ -119,13 +123,25 @@ Status RawDelimitedTextParser::ParseFieldLocations(int max_tuples, int64_t remai
     last_row_delim_offset_ = -1;
   }
 
+  if (CpuInfo::IsSupported(CpuInfo::AVX2)) {
+    if (process_escapes_) {
+      ParseSse<true, true>(max_tuples, &remaining_len, byte_buffer_ptr,
+          row_end_locations, field_locations, num_tuples, num_fields, next_column_start);
+    } else {
+      ParseSse<false, true>(max_tuples, &remaining_len, byte_buffer_ptr,
+          row_end_locations, field_locations, num_tuples, num_fields, next_column_start);
+    }
+    if (*num_tuples == max_tuples) return Status::OK;
+  }
+
+  // With AVX2, this only picks up the last (less than 32) characters.
   if (CpuInfo::IsSupported(CpuInfo::SSE4_2)) {
     if (process_escapes_) {
-      ParseSse<true>(max_tuples, &remaining_len, byte_buffer_ptr, row_end_locations,
-          field_locations, num_tuples, num_fields, next_column_start);
+      ParseSse<true, false>(max_tuples, &remaining_len, byte_buffer_ptr,
+          row_end_locations, field_locations, num_tuples, num_fields, next_column_start);
     } else {
-      ParseSse<false>(max_tuples, &remaining_len, byte_buffer_ptr, row_end_locations,
-          field_locations, num_tuples, num_fields, next_column_start);
+      ParseSse<false, false>(max_tuples, &remaining_len, byte_buffer_ptr,
+          row_end_locations, field_locations, num_tuples, num_fields, next_column_start);
     }
   }
 
@@ -33,22 +33,23 @@ namespace impala {
 
 // Updates the values in the field and tuple masks, escaping them if necessary.
 // If the character at n is an escape character, then delimiters(tuple/field/escape
-// characters) at n+1 don't count.
-inline void ProcessEscapeMask(uint16_t escape_mask, bool* last_char_is_escape,
-                              uint16_t* delim_mask) {
+// characters) at n+1 don't count. NUM_CHARS is the number of characters covered by
+// the masks (16 for SSE, 32 for AVX2).
+template <int NUM_CHARS>
+inline void ProcessEscapeMask(uint32_t escape_mask, bool* last_char_is_escape,
+                              uint32_t* delim_mask) {
   // Escape characters can escape escape characters.
   bool first_char_is_escape = *last_char_is_escape;
   bool escape_next = first_char_is_escape;
-  for (int i = 0; i < SSEUtil::CHARS_PER_128_BIT_REGISTER; ++i) {
+  for (int i = 0; i < NUM_CHARS; ++i) {
     if (escape_next) {
-      escape_mask &= ~SSEUtil::SSE_BITMASK[i];
+      escape_mask &= ~(1U << i);
     }
-    escape_next = escape_mask & SSEUtil::SSE_BITMASK[i];
+    escape_next = escape_mask & (1U << i);
   }
 
   // Remember last character for the next iteration
-  *last_char_is_escape = escape_mask &
-    SSEUtil::SSE_BITMASK[SSEUtil::CHARS_PER_128_BIT_REGISTER - 1];
+  *last_char_is_escape = escape_mask & (1U << (NUM_CHARS - 1));
 
   // Shift escape mask up one so they match at the same bit index as the tuple and
   // field mask (instead of being the character before) and set the correct first bit
@@ -58,6 +59,36 @@ inline void ProcessEscapeMask(uint16_t escape_mask, bool* last_char_is_escape,
   *delim_mask &= ~escape_mask;
 }
 
+template <bool process_escapes, bool use_avx2>
+inline uint32_t RawDelimitedTextParser::FindDelims(const char* buffer,
+    uint32_t* escape_mask) {
+  if (use_avx2) {
+    // AVX2 has no strchr instruction, but comparing 32 bytes against each (broadcast)
+    // search character and or-ing the results gives the same mask for twice the data.
+    uint32_t delim_mask = AVX2_cmpeq_any4_mask(buffer, avx2_delim_search_);
+    if (process_escapes) *escape_mask = AVX2_cmpeq_mask(buffer, escape_char_);
+    return delim_mask;
+  }
+
+  // Load the next 16 bytes into the xmm register
+  __m128i xmm_buffer = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer));
+
+  // Do the strchr for tuple and field breaks
+  // The strchr sse instruction returns the result in the lower bits of the sse
+  // register.  Since we only process 16 characters at a time, only the lower 16 bits
+  // can contain non-zero values.
+  // _mm_extract_epi16 will extract 16 bits out of the xmm register.  The second
+  // parameter specifies which 16 bits to extract (0 for the lowest 16 bits).
+  __m128i xmm_delim_mask = SSE4_cmpestrm(xmm_delim_search_, num_delims_, xmm_buffer,
+      SSEUtil::CHARS_PER_128_BIT_REGISTER, SSEUtil::STRCHR_MODE);
+  if (process_escapes) {
+    __m128i xmm_escape_mask = SSE4_cmpestrm(xmm_escape_search_, 1,
+        xmm_buffer, SSEUtil::CHARS_PER_128_BIT_REGISTER, SSEUtil::STRCHR_MODE);
+    *escape_mask = static_cast<uint16_t>(_mm_extract_epi16(xmm_escape_mask, 0));
+  }
+  return static_cast<uint16_t>(_mm_extract_epi16(xmm_delim_mask, 0));
+}
+
 // SSE optimized raw text file parsing.  SSE4_2 added an instruction (with 3 modes) for
 // text processing.  The modes mimic strchr, strstr and strcmp.  For text parsing, we can
 // leverage the strchr functionality.
@@ -71,60 +102,42 @@ inline void ProcessEscapeMask(uint16_t escape_mask, bool* last_char_is_escape,
 //  Needle   = 'abcd000000000000' (we're searching for any a's, b's, c's or d's)
 //  Haystack = 'asdfghjklhjbdwwc' (the raw string)
 //  Result   = '1010000000011001'
-template <bool process_escapes>
+//
+// With 'use_avx2', the same masks are computed 32 characters at a time with AVX2 byte
+// compares (see FindDelims()); everything downstream of the masks is shared.
+template <bool process_escapes, bool use_avx2>
 inline void RawDelimitedTextParser::ParseSse(int max_tuples,
     int64_t* remaining_len, char** byte_buffer_ptr,
     char** row_end_locations,
     FieldLocation* field_locations,
     int* num_tuples, int* num_fields, char** next_column_start) {
   DCHECK(CpuInfo::IsSupported(CpuInfo::SSE4_2));
+  DCHECK(!use_avx2 || CpuInfo::IsSupported(CpuInfo::AVX2));
+  const int chars_per_chunk = use_avx2 ?
+      SSEUtil::CHARS_PER_256_BIT_REGISTER : SSEUtil::CHARS_PER_128_BIT_REGISTER;
 
   // To parse using SSE, we:
   //  1. Load into different sse registers the different characters we need to search for
   //        tuple breaks, field breaks, escape characters
-  //  2. Load 16 characters at a time into the sse register
-  //  3. Use the SSE instruction to do strchr on those 16 chars, the result is a bitmask
+  //  2. Load 16 (32 with AVX2) characters at a time into the sse register
+  //  3. Use the SSE instruction to do strchr on those chars, the result is a bitmask
   //  4. Compute the bitmask for tuple breaks, field breaks and escape characters.
   //  5. If there are escape characters, fix up the matching masked bits in the
   //        field/tuple mask
   //  6. Go through the mask bit by bit and write the parsed data.
+  while (LIKELY(*remaining_len >= chars_per_chunk)) {
+    uint32_t escape_mask = 0;
+    uint32_t delim_mask =
+        FindDelims<process_escapes, use_avx2>(*byte_buffer_ptr, &escape_mask);
 
-  // xmm registers:
-  //  - xmm_buffer: the register holding the current (16 chars) we're working on from the
-  //        file
-  //  - xmm_delim_search_: the delim search register.  Contains field delimiter,
-  //        collection_item delim_char and tuple delimiter
-  //  - xmm_escape_search_: the escape search register. Only contains escape char
-  //  - xmm_delim_mask: the result of doing strchr for the delimiters
-  //  - xmm_escape_mask: the result of doing strchr for the escape char
-  __m128i xmm_buffer, xmm_delim_mask, xmm_escape_mask;
-
-  while (LIKELY(*remaining_len >= SSEUtil::CHARS_PER_128_BIT_REGISTER)) {
-    // Load the next 16 bytes into the xmm register
-    xmm_buffer = _mm_loadu_si128(reinterpret_cast<__m128i*>(*byte_buffer_ptr));
-
-    // Do the strchr for tuple and field breaks
-    // The strchr sse instruction returns the result in the lower bits of the sse
-    // register.  Since we only process 16 characters at a time, only the lower 16 bits
-    // can contain non-zero values.
-    // _mm_extract_epi16 will extract 16 bits out of the xmm register.  The second
-    // parameter specifies which 16 bits to extract (0 for the lowest 16 bits).
-    xmm_delim_mask = SSE4_cmpestrm(xmm_delim_search_, num_delims_, xmm_buffer,
-        SSEUtil::CHARS_PER_128_BIT_REGISTER, SSEUtil::STRCHR_MODE);
-    uint16_t delim_mask = _mm_extract_epi16(xmm_delim_mask, 0);
-
-    uint16_t escape_mask = 0;
     // If the table does not use escape characters, skip processing for it.
     if (process_escapes) {
       DCHECK(escape_char_ != '\0');
-      xmm_escape_mask = SSE4_cmpestrm(xmm_escape_search_, 1,
-          xmm_buffer, SSEUtil::CHARS_PER_128_BIT_REGISTER, SSEUtil::STRCHR_MODE);
-      escape_mask = _mm_extract_epi16(xmm_escape_mask, 0);
-      ProcessEscapeMask(escape_mask, &last_char_is_escape_, &delim_mask);
+      ProcessEscapeMask<chars_per_chunk>(escape_mask, &last_char_is_escape_, &delim_mask);
     }
 
-    char* last_char = *byte_buffer_ptr + (SSEUtil::CHARS_PER_128_BIT_REGISTER - 1);
-    bool last_char_is_unescaped_delim = delim_mask >> (SSEUtil::CHARS_PER_128_BIT_REGISTER - 1);
+    char* last_char = *byte_buffer_ptr + (chars_per_chunk - 1);
+    bool last_char_is_unescaped_delim = delim_mask >> (chars_per_chunk - 1);
     unfinished_tuple_ = !(last_char_is_unescaped_delim &&
         (*last_char == tuple_delim_ || (tuple_delim_ == '\n' && *last_char == '\r')));
 
@@ -135,9 +148,9 @@ inline void RawDelimitedTextParser::ParseSse(int max_tuples,
       // ffs is a libc function that returns the index of the first set bit (1-indexed)
       int n = ffs(delim_mask) - 1;
       DCHECK_GE(n, 0);
-      DCHECK_LT(n, 16);
+      DCHECK_LT(n, chars_per_chunk);
       // clear current bit
-      delim_mask &= ~(SSEUtil::SSE_BITMASK[n]);
+      delim_mask &= ~(1U << n);
 
       if (process_escapes) {
         // Determine if there was an escape character between [last_col_idx, n]
@@ -183,13 +196,14 @@ inline void RawDelimitedTextParser::ParseSse(int max_tuples,
     }
 
     if (process_escapes) {
-      // Determine if there was an escape character between (last_col_idx, 15)
-      bool unprocessed_escape = escape_mask & low_mask_[last_col_idx] & high_mask_[15];
+      // Determine if there was an escape character between (last_col_idx, end of chunk)
+      bool unprocessed_escape =
+          escape_mask & low_mask_[last_col_idx] & high_mask_[chars_per_chunk - 1];
       current_column_has_escape_ |= unprocessed_escape;
     }
 
-    *remaining_len -= SSEUtil::CHARS_PER_128_BIT_REGISTER;
-    *byte_buffer_ptr += SSEUtil::CHARS_PER_128_BIT_REGISTER;
+    *remaining_len -= chars_per_chunk;
+    *byte_buffer_ptr += chars_per_chunk;
   }
 }
 
@@ -207,16 +221,17 @@ inline void RawDelimitedTextParser::parseSingleTupleInternal(int64_t remaining_l
 
       xmm_delim_mask = SSE4_cmpestrm(xmm_delim_search_, num_delims_, xmm_buffer,
           SSEUtil::CHARS_PER_128_BIT_REGISTER, SSEUtil::STRCHR_MODE);
-      uint16_t delim_mask = _mm_extract_epi16(xmm_delim_mask, 0);
+      uint32_t delim_mask = static_cast<uint16_t>(_mm_extract_epi16(xmm_delim_mask, 0));
 
-      uint16_t escape_mask = 0;
+      uint32_t escape_mask = 0;
       // If the table does not use escape characters, skip processing for it.
       if (process_escapes_flag) {
         DCHECK(escape_char_ != '\0');
         xmm_escape_mask = SSE4_cmpestrm(xmm_escape_search_, 1, xmm_buffer,
             SSEUtil::CHARS_PER_128_BIT_REGISTER, SSEUtil::STRCHR_MODE);
-        escape_mask = _mm_extract_epi16(xmm_escape_mask, 0);
-        ProcessEscapeMask(escape_mask, &last_char_is_escape_, &delim_mask);
+        escape_mask = static_cast<uint16_t>(_mm_extract_epi16(xmm_escape_mask, 0));
+        ProcessEscapeMask<SSEUtil::CHARS_PER_128_BIT_REGISTER>(
+            escape_mask, &last_char_is_escape_, &delim_mask);
       }
 
       int last_col_idx = 0;
@@ -167,6 +167,66 @@ TEST_F(DelimtedTextParserTest, FieldsRawParserTest) {
   validate("a|b,c|d@,e", 2, TUPLE_DELIM, 1, 2);
 }
 
+// Parses all of 'data' and returns the offset and length of every field followed by the
+// offset of every row end.
+static vector<int> ParseAll(DelimitedTextParser* parser, const string& data) {
+  parser->parserReset();
+  char* data_ptr = const_cast<char*>(data.c_str());
+  const int MAX_TUPLES = 1000;
+  vector<char*> row_end_locs(MAX_TUPLES);
+  vector<FieldLocation> field_locations(MAX_TUPLES * 10);
+  int num_tuples = 0;
+  int num_fields = 0;
+  char* next_column_start;
+  Status status = parser->ParseFieldLocations(MAX_TUPLES, data.size(), &data_ptr,
+      &row_end_locs[0], &field_locations[0], &num_tuples, &num_fields,
+      &next_column_start);
+  EXPECT_TRUE(status.ok());
+  vector<int> result;
+  for (int i = 0; i < num_fields; ++i) {
+    result.push_back(field_locations[i].start - data.c_str());
+    result.push_back(field_locations[i].len);
+  }
+  for (int i = 0; i < num_tuples; ++i) result.push_back(row_end_locs[i] - data.c_str());
+  return result;
+}
+
+// The AVX2, SSE and scalar paths must find the same fields, including delimiters,
+// escapes and \r\n row ends that straddle the 16 and 32 byte chunk boundaries.
+TEST_F(DelimtedTextParserTest, SimdRawParserTest) {
+  const char TUPLE_DELIM = '\n';
+  const char FIELD_DELIM = ',';
+  const char COLLECTION_DELIM = ',';
+  const char ESCAPE_CHAR = '@';
+  const int NUM_COLS = 3;
+
+  string data;
+  for (int i = 0; i < 200; ++i) {
+    data += string(i % 37, 'a') + ",";
+    if (i % 3 == 0) data += "x@,y";
+    if (i % 5 == 0) data += "@@";
+    data += string(i % 11, 'b') + "," + string(i % 7, 'c');
+    data += (i % 4 == 0) ? "\r\n" : "\n";
+  }
+
+  bool has_avx2 = CpuInfo::IsSupported(CpuInfo::AVX2);
+  bool has_sse4_2 = CpuInfo::IsSupported(CpuInfo::SSE4_2);
+  for (int escapes = 0; escapes < 2; ++escapes) {
+    reset(RAW, NUM_COLS, TUPLE_DELIM, FIELD_DELIM, COLLECTION_DELIM,
+        escapes ? ESCAPE_CHAR : '\0');
+    vector<int> expected = ParseAll(m_parser, data);
+    EXPECT_FALSE(expected.empty());
+
+    CpuInfo::EnableFeature(CpuInfo::AVX2, false);
+    EXPECT_EQ(ParseAll(m_parser, data), expected);
+    CpuInfo::EnableFeature(CpuInfo::SSE4_2, false);
+    EXPECT_EQ(ParseAll(m_parser, data), expected);
+    CpuInfo::EnableFeature(CpuInfo::SSE4_2, has_sse4_2);
+    CpuInfo::EnableFeature(CpuInfo::AVX2, has_avx2);
+    TearDown();
+  }
+}
+
 TEST_F(DelimtedTextParserTest, Batch_0_no_delimiters) {
 	char TUPLE_DELIM = '|';
 
@@ -253,6 +253,10 @@ private:
 	  /* SSE(xmm) register containing the delimiter search character. */
 	  __m128i xmm_delim_search_;
 
+	  /* The delimiter search characters for the AVX2 path, padded by repeating the
+	   * first one. */
+	  char avx2_delim_search_[SSEUtil::AVX2_MAX_SEARCH_CHARS];
+
 	  /* Character delimiting collection items (to become slots). */
 	  char collection_item_delim_;
 
@@ -262,9 +266,10 @@ private:
 	  /* Whether or not the previous character was the escape character */
 	  bool last_char_is_escape_;
 
-	  /** Precomputed masks to process escape characters */
-	  uint16_t low_mask_[16];
-	  uint16_t high_mask_[16];
+	  /** Precomputed masks to process escape characters. Sized for the 32 characters
+	   *  of an AVX2 chunk; the SSE path only uses the low 16 bits. */
+	  uint32_t low_mask_[32];
+	  uint32_t high_mask_[32];
 
 	  /** initialize parser-specific search characters registry */
 	  void setupSearchCharacters();
@@ -281,14 +286,22 @@ private:
 	  void parseSingleTupleInternal(int64_t len, char* buffer, FieldLocation* field_locations,
 	  	      int* num_fields, const bool flag);
 
+	  /** Returns the mask of delimiters in the next 16 (32 if 'use_avx2') characters at
+	   *  'buffer' and, if 'process_escapes', sets 'escape_mask' to the mask of escape
+	   *  characters. */
+	  template <bool process_escapes, bool use_avx2>
+	  uint32_t FindDelims(const char* buffer, uint32_t* escape_mask);
+
 	  /** Helper routine to parse delimited text using SSE instructions.
 	   *  Identical arguments as ParseFieldLocations.
 	   *  If the template argument, 'process_escapes' is true, this function will handle
 	   *  escapes, otherwise, it will assume the text is unescaped.  By using templates,
 	   *  we can special case the un-escaped path for better performance.  The unescaped
 	   *  path is optimized away by the compiler.
+	   *  If 'use_avx2' is true, the text is scanned 32 characters at a time; the caller
+	   *  must check that the CPU supports AVX2 and finish the tail with the SSE version.
 	   */
-	  template <bool process_escapes>void ParseSse(int max_tuples, int64_t* remaining_len,
+	  template <bool process_escapes, bool use_avx2>void ParseSse(int max_tuples, int64_t* remaining_len,
 	      char** byte_buffer_ptr, char** row_end_locations_,
 	      FieldLocation* field_locations,
 	      int* num_tuples, int* num_fields, char** next_column_start);
@@ -81,9 +81,24 @@ Status ExchangeNode::Open(RuntimeState* state) {
     RETURN_IF_ERROR(sort_exec_exprs_.Open(state));
     TupleRowComparator less_than(sort_exec_exprs_.lhs_ordering_expr_ctxs(),
         sort_exec_exprs_.rhs_ordering_expr_ctxs(), is_asc_order_, nulls_first_);
+    // The threads that pre-merge groups of senders each need their own copies of the
+    // ordering exprs.
+    vector<TupleRowComparator> group_less_thans;
+    for (int i = 0; i < stream_recvr_->num_merge_groups(); ++i) {
+      vector<ExprContext*> lhs_ctxs;
+      vector<ExprContext*> rhs_ctxs;
+      RETURN_IF_ERROR(
+          Expr::Clone(sort_exec_exprs_.lhs_ordering_expr_ctxs(), state, &lhs_ctxs));
+      RETURN_IF_ERROR(
+          Expr::Clone(sort_exec_exprs_.rhs_ordering_expr_ctxs(), state, &rhs_ctxs));
+      group_expr_ctxs_.insert(group_expr_ctxs_.end(), lhs_ctxs.begin(), lhs_ctxs.end());
+      group_expr_ctxs_.insert(group_expr_ctxs_.end(), rhs_ctxs.begin(), rhs_ctxs.end());
+      group_less_thans.push_back(
+          TupleRowComparator(lhs_ctxs, rhs_ctxs, is_asc_order_, nulls_first_));
+    }
     // CreateMerger() will populate its merging heap with batches from the stream_recvr_,
     // so it is not necessary to call FillInputRowBatch().
-    stream_recvr_->CreateMerger(less_than);
+    RETURN_IF_ERROR(stream_recvr_->CreateMerger(less_than, group_less_thans));
   } else {
     RETURN_IF_ERROR(FillInputRowBatch(state));
   }
@@ -95,6 +110,8 @@ void ExchangeNode::Close(RuntimeState* state) {
   if (is_merging_) sort_exec_exprs_.Close(state);
   if (stream_recvr_ != NULL) stream_recvr_->Close();
   stream_recvr_.reset();
+  // Closed after the receiver, which stops the threads that use them.
+  Expr::Close(group_expr_ctxs_, state);
   ExecNode::Close(state);
 }
 
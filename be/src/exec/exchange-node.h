@@ -95,6 +95,10 @@ class ExchangeNode : public ExecNode {
   std::vector<bool> is_asc_order_;
   std::vector<bool> nulls_first_;
 
+  // Clones of the ordering exprs for the receiver's pre-merge threads, see
+  // DataStreamRecvr::CreateMerger().
+  std::vector<ExprContext*> group_expr_ctxs_;
+
   // Offset specifying number of rows to skip.
   int64_t offset_;
 
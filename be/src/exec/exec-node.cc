@@ -24,6 +24,8 @@
 #include "common/object-pool.h"
 #include "common/status.h"
 #include "exprs/expr.h"
+#include "exprs/expr-column.h"
+#include "exprs/expr-context.h"
 #include "exec/aggregation-node.h"
 #include "exec/analytic-eval-node.h"
 #include "exec/cross-join-node.h"
@@ -394,6 +396,26 @@ bool ExecNode::EvalConjuncts(ExprContext* const* ctxs, int num_ctxs, TupleRow* r
   return true;
 }
 
+int ExecNode::EvalConjuncts(ExprContext* const* ctxs, int num_ctxs, RowBatch* batch,
+    int* sel) {
+  int num_sel = batch->num_rows();
+  for (int i = 0; i < num_sel; ++i) sel[i] = i;
+  for (int i = 0; i < num_ctxs && num_sel > 0; ++i) {
+    // The first conjunct is evaluated over all rows, without a selection vector.
+    ExprColumn* result = ctxs[i]->EvalBatch(batch, i == 0 ? NULL : sel, num_sel);
+    const bool* values = result->values<bool>();
+    const uint8_t* is_null = result->is_null();
+    int num_passed = 0;
+    for (int j = 0; j < num_sel; ++j) {
+      int row_idx = sel[j];
+      sel[num_passed] = row_idx;
+      num_passed += values[row_idx] & !is_null[row_idx];
+    }
+    num_sel = num_passed;
+  }
+  return num_sel;
+}
+
 Status ExecNode::QueryMaintenance(RuntimeState* state) {
   ExprContext::FreeLocalAllocations(expr_ctxs_to_free_);
   return state->CheckQueryState();
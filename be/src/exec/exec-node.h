@@ -123,6 +123,13 @@ class ExecNode {
   // out how to deal with declaring a templated std:vector type in IR
   static bool EvalConjuncts(ExprContext* const* ctxs, int num_ctxs, TupleRow* row);
 
+  // Evaluates ExprContexts over all rows of 'batch' with Expr::EvalBatch(). Stores the
+  // indices of the rows for which all exprs return true in 'sel', which must have room
+  // for batch->num_rows() indices, and returns their number. Each expr is only
+  // evaluated over the rows that passed the previous ones.
+  static int EvalConjuncts(ExprContext* const* ctxs, int num_ctxs, RowBatch* batch,
+      int* sel);
+
   // Returns a codegen'd version of EvalConjuncts(), or NULL if the function couldn't be
   // codegen'd. The codegen'd version uses inlined, codegen'd GetBooleanVal() functions.
   static llvm::Function* CodegenEvalConjuncts(
@@ -19,6 +19,8 @@
 #include "codegen/llvm-codegen.h"
 #include "exec/old-hash-table.inline.h"
 #include "exprs/expr.h"
+#include "exprs/expr-context.h"
+#include "exprs/slot-ref.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "util/debug-util.h"
@@ -140,6 +142,7 @@ Status HashJoinNode::Prepare(RuntimeState* state) {
 void HashJoinNode::Close(RuntimeState* state) {
   if (is_closed()) return;
   if (hash_tbl_.get() != NULL) hash_tbl_->Close();
+  build_resources_.reset();
   Expr::Close(build_expr_ctxs_, state);
   Expr::Close(probe_expr_ctxs_, state);
   Expr::Close(other_join_conjunct_ctxs_, state);
@@ -154,8 +157,10 @@ Status HashJoinNode::ConstructBuildSide(RuntimeState* state) {
   // Do a full scan of child(1) and store everything in hash_tbl_
   // The hash join node needs to keep in memory all build tuples, including the tuple
   // row ptrs.  The row ptrs are copied into the hash table's internal structure so they
-  // don't need to be stored in the build_pool_.
+  // don't need to be stored in build_resources_.
   RowBatch build_batch(child(1)->row_desc(), state->batch_size(), mem_tracker());
+  build_resources_.reset(
+      new RowBatch(child(1)->row_desc(), state->batch_size(), mem_tracker()));
   RETURN_IF_ERROR(child(1)->Open(state));
   while (true) {
     RETURN_IF_CANCELLED(state);
@@ -163,8 +168,6 @@ Status HashJoinNode::ConstructBuildSide(RuntimeState* state) {
     bool eos;
     RETURN_IF_ERROR(child(1)->GetNext(state, &build_batch, &eos));
     SCOPED_TIMER(build_timer_);
-    // take ownership of tuple data of build_batch
-    build_pool_->AcquireData(build_batch.tuple_data_pool(), false);
     RETURN_IF_ERROR(QueryMaintenance(state));
 
     // Call codegen version if possible
@@ -178,7 +181,10 @@ Status HashJoinNode::ConstructBuildSide(RuntimeState* state) {
     COUNTER_SET(build_row_counter_, hash_tbl_->size());
     COUNTER_SET(build_buckets_counter_, hash_tbl_->num_buckets());
     COUNTER_SET(hash_tbl_load_factor_counter_, hash_tbl_->load_factor());
-    build_batch.Reset();
+    // Take ownership of all the data the rows of build_batch reference. The data isn't
+    // necessarily in its tuple data pool, e.g. an exchange keeps the received tuple data
+    // separately. This resets build_batch.
+    build_batch.TransferResourceOwnership(build_resources_.get());
     DCHECK(!build_batch.AtCapacity());
     if (eos) break;
   }
@@ -197,6 +203,14 @@ Status HashJoinNode::ConstructBuildSide(RuntimeState* state) {
               << hash_tbl_->size();
     }
   }
+
+  // Global filters are only built by the PartitionedHashJoinNode. Disable them so the
+  // scans of the probe side don't wait for them.
+  for (int i = 0; i < probe_expr_ctxs_.size(); ++i) {
+    if (!probe_expr_ctxs_[i]->root()->is_slotref()) continue;
+    SlotId slot_id = reinterpret_cast<SlotRef*>(probe_expr_ctxs_[i]->root())->slot_id();
+    if (state->IsGlobalFilterSource(slot_id)) state->PublishGlobalFilter(slot_id, NULL);
+  }
   return Status::OK;
 }
 
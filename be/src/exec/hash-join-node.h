@@ -66,6 +66,10 @@ class HashJoinNode : public BlockingJoinNode {
   boost::scoped_ptr<OldHashTable> hash_tbl_;
   OldHashTable::Iterator hash_tbl_iterator_;
 
+  // Owns the resources of the build batches that the rows in hash_tbl_ reference: their
+  // tuple data, io buffers and the tuple data received by an exchange. Never has rows.
+  boost::scoped_ptr<RowBatch> build_resources_;
+
   // our equi-join predicates "<lhs> = <rhs>" are separated into
   // build_exprs_ (over child(1)) and probe_exprs_ (over child(0))
     std::vector<ExprContext*> probe_expr_ctxs_;
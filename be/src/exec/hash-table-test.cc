@@ -125,7 +125,7 @@ class HashTableTest : public testing::Test {
 
   void ProbeTest(HashTable* table, HashTableCtx* ht_ctx,
       ProbeTestData* data, int num_data, bool scan) {
-    uint32_t hash = 0;
+    uint64_t hash = 0;
     for (int i = 0; i < num_data; ++i) {
       TupleRow* row = data[i].probe_row;
 
@@ -202,7 +202,7 @@ class HashTableTest : public testing::Test {
     HashTable hash_table(&mem_pool_, quadratic, table_size);
     HashTableCtx ht_ctx(build_expr_ctxs_, probe_expr_ctxs_, false, false, 1, 0, 1);
 
-    uint32_t hash = 0;
+    uint64_t hash = 0;
     bool success = hash_table.CheckAndResize(5, &ht_ctx);
     EXPECT_TRUE(success);
     for (int i = 0; i < 5; ++i) {
@@ -255,7 +255,7 @@ class HashTableTest : public testing::Test {
     vector<TupleRow*> build_rows;
     ProbeTestData* probe_rows = new ProbeTestData[total_rows];
     probe_rows[0].probe_row = CreateTupleRow(0);
-    uint32_t hash = 0;
+    uint64_t hash = 0;
     for (int val = 1; val <= rows_to_insert; ++val) {
       bool success = hash_table.CheckAndResize(val, &ht_ctx);
       EXPECT_TRUE(success) << " failed to resize: " << val;
@@ -308,7 +308,7 @@ class HashTableTest : public testing::Test {
     // Inserts num_to_add + (num_to_add^2) + (num_to_add^4) + ... + (num_to_add^20)
     // entries. When num_to_add == 4, then the total number of inserts is 4194300.
     int build_row_val = 0;
-    uint32_t hash = 0;
+    uint64_t hash = 0;
     for (int i = 0; i < 20; ++i) {
       // Currently the mem used for the bucket is not being tracked by the mem tracker.
       // Thus the resize is expected to be successful.
@@ -359,7 +359,7 @@ class HashTableTest : public testing::Test {
 
     // Insert and probe table_size different tuples. All of them are expected to be
     // successfully inserted and probed.
-    uint32_t hash = 0;
+    uint64_t hash = 0;
     HashTable::Iterator iter;
     for (int build_row_val = 0; build_row_val < table_size; ++build_row_val) {
       TupleRow* row = CreateTupleRow(build_row_val);
@@ -387,6 +387,82 @@ class HashTableTest : public testing::Test {
     pool.FreeAll();
     mem_pool_.FreeAll();
   }
+
+  // Inserts two rows whose hashes have the same low 32 bits and only differ in the bits
+  // cached as the bucket's hash tag. Checks that they land in different buckets without
+  // the rows being compared, and that both can be found.
+  void HashTagTest(bool quadratic) {
+    HashTable hash_table(&mem_pool_, quadratic, 64);
+    HashTableCtx ht_ctx(build_expr_ctxs_, probe_expr_ctxs_, false, false, 1, 0, 1);
+    TupleRow* rows[2] = { CreateTupleRow(1), CreateTupleRow(2) };
+    const uint64_t hashes[2] = { 5, 5 | (1ULL << 40) };
+    uint64_t hash = 0;
+    for (int i = 0; i < 2; ++i) {
+      EXPECT_TRUE(ht_ctx.EvalAndHashBuild(rows[i], &hash));
+      EXPECT_TRUE(hash_table.Insert(&ht_ctx, rows[i]->GetTuple(0), hashes[i]));
+    }
+    EXPECT_EQ(hash_table.size(), 2);
+    EXPECT_EQ(hash_table.num_hash_collisions_, 0);
+
+    for (int i = 0; i < 2; ++i) {
+      EXPECT_TRUE(ht_ctx.EvalAndHashProbe(rows[i], &hash));
+      HashTable::Iterator iter = hash_table.Find(&ht_ctx, hashes[i]);
+      ASSERT_FALSE(iter.AtEnd());
+      EXPECT_EQ(iter.GetRow()->GetTuple(0), rows[i]->GetTuple(0));
+    }
+    EXPECT_EQ(hash_table.num_hash_collisions_, 0);
+
+    // Resizing places the buckets from the cached hash bits, so both rows must still be
+    // found afterwards.
+    ResizeTable(&hash_table, 1024, &ht_ctx);
+    for (int i = 0; i < 2; ++i) {
+      EXPECT_TRUE(ht_ctx.EvalAndHashProbe(rows[i], &hash));
+      EXPECT_FALSE(hash_table.Find(&ht_ctx, hashes[i]).AtEnd());
+    }
+    hash_table.Close();
+    mem_pool_.FreeAll();
+  }
+
+  // Inserts the build rows [0->100) and probes [0->200) the way batched callers do:
+  // first caching and prefetching all probe rows, then restoring them from the row
+  // cache out of order and probing.
+  void BatchedProbeTest(bool quadratic) {
+    HashTable hash_table(&mem_pool_, quadratic, 1024);
+    HashTableCtx ht_ctx(build_expr_ctxs_, probe_expr_ctxs_, false, false, 1, 0, 1);
+    uint64_t hash = 0;
+    for (int i = 0; i < 100; ++i) {
+      TupleRow* row = CreateTupleRow(i);
+      if (!ht_ctx.EvalAndHashBuild(row, &hash)) continue;
+      EXPECT_TRUE(hash_table.Insert(&ht_ctx, row->GetTuple(0), hash));
+    }
+
+    const int num_probe_rows = 200;
+    TupleRow* probe_rows[num_probe_rows];
+    ht_ctx.ReserveRowCache(num_probe_rows);
+    for (int i = 0; i < num_probe_rows; ++i) {
+      probe_rows[i] = CreateTupleRow(i);
+      EXPECT_TRUE(ht_ctx.EvalAndHashProbe(probe_rows[i], &hash));
+      ht_ctx.CacheCurrentRow(i, hash);
+      hash_table.PrefetchBucket(hash);
+    }
+    ht_ctx.CacheRejectedRow(num_probe_rows - 1);
+
+    for (int i = num_probe_rows - 1; i >= 0; --i) {
+      if (!ht_ctx.LoadCachedRow(i, &hash)) {
+        EXPECT_EQ(i, num_probe_rows - 1);
+        continue;
+      }
+      HashTable::Iterator iter = hash_table.Find(&ht_ctx, hash);
+      if (i >= 100) {
+        EXPECT_TRUE(iter.AtEnd());
+      } else {
+        ASSERT_FALSE(iter.AtEnd());
+        ValidateMatch(probe_rows[i], iter.GetRow());
+      }
+    }
+    hash_table.Close();
+    mem_pool_.FreeAll();
+  }
 };
 
 TEST_F(HashTableTest, LinearSetupTest) {
@@ -434,6 +510,22 @@ TEST_F(HashTableTest, QuadraticGrowTableTest) {
   GrowTableTest(true);
 }
 
+TEST_F(HashTableTest, LinearHashTagTest) {
+  HashTagTest(false);
+}
+
+TEST_F(HashTableTest, QuadraticHashTagTest) {
+  HashTagTest(true);
+}
+
+TEST_F(HashTableTest, LinearBatchedProbeTest) {
+  BatchedProbeTest(false);
+}
+
+TEST_F(HashTableTest, QuadraticBatchedProbeTest) {
+  BatchedProbeTest(true);
+}
+
 TEST_F(HashTableTest, LinearInsertFullTest) {
   InsertFullTest(false, 1);
   InsertFullTest(false, 4);
@@ -96,6 +96,7 @@ HashTableCtx::HashTableCtx(const vector<ExprContext*>& build_expr_ctxs,
   expr_values_buffer_ = new uint8_t[results_buffer_size_];
   memset(expr_values_buffer_, 0, sizeof(uint8_t) * results_buffer_size_);
   expr_value_null_bits_ = new uint8_t[build_expr_ctxs.size()];
+  row_cache_stride_ = results_buffer_size_ + build_expr_ctxs.size();
 
   // Populate the seeds to use for all the levels. TODO: revisit how we generate these.
   DCHECK_GE(max_levels, 0);
@@ -120,6 +121,13 @@ void HashTableCtx::Close() {
   row_ = NULL;
 }
 
+void HashTableCtx::ReserveRowCache(int num_rows) {
+  if (row_cache_hashes_.size() >= num_rows) return;
+  row_cache_values_.resize(num_rows * row_cache_stride_);
+  row_cache_hashes_.resize(num_rows);
+  row_cache_rejected_.resize(num_rows);
+}
+
 bool HashTableCtx::EvalRow(TupleRow* row, const vector<ExprContext*>& ctxs) {
   bool has_null = false;
   for (int i = 0; i < ctxs.size(); ++i) {
@@ -142,8 +150,8 @@ bool HashTableCtx::EvalRow(TupleRow* row, const vector<ExprContext*>& ctxs) {
   return has_null;
 }
 
-uint32_t HashTableCtx::HashVariableLenRow() {
-  uint32_t hash = seeds_[level_];
+uint64_t HashTableCtx::HashVariableLenRow() {
+  uint64_t hash = seeds_[level_];
   // Hash the non-var length portions (if there are any)
   if (var_result_begin_ != 0) {
     hash = Hash(expr_values_buffer_, var_result_begin_, hash);
@@ -321,8 +329,8 @@ bool HashTable::ResizeBuckets(int64_t num_buckets, HashTableCtx* ht_ctx) {
        NextFilledBucket(&iter.bucket_idx_, &iter.node_)) {
     Bucket* bucket_to_copy = &buckets_[iter.bucket_idx_];
     bool found = false;
-    int64_t bucket_idx = Probe(new_buckets, num_buckets, NULL, bucket_to_copy->hash,
-                               &found);
+    int64_t bucket_idx = Probe(new_buckets, num_buckets, NULL,
+        BucketHash(bucket_to_copy), &found);
     DCHECK(!found);
     DCHECK_NE(bucket_idx, Iterator::BUCKET_NOT_FOUND) << " Probe failed even though "
         " there are free buckets. " << num_buckets << " " << num_filled_buckets_;
@@ -618,16 +626,19 @@ Function* HashTableCtx::CodegenEvalRow(RuntimeState* state, bool build) {
 
 // Codegen for hashing the current row.  In the case with both string and non-string data
 // (group by int_col, string_col), the IR looks like:
-// define i32 @HashCurrentRow(%"class.impala::HashTableCtx"* %this_ptr) #20 {
+// define i64 @HashCurrentRow(%"class.impala::HashTableCtx"* %this_ptr) #20 {
 // entry:
 //   %seed = call i32 @GetHashSeed(%"class.impala::HashTableCtx"* %this_ptr)
-//   %0 = call i32 @CrcHash16(i8* inttoptr (i64 119151296 to i8*), i32 16, i32 %seed)
+//   %seed64 = zext i32 %seed to i64
+//   %0 = call i64 @IrMurmur64Hash(i8* inttoptr (i64 119151296 to i8*), i32 16,
+//       i64 %seed64)
 //   %1 = load i8* inttoptr (i64 119943721 to i8*)
 //   %2 = icmp ne i8 %1, 0
 //   br i1 %2, label %null, label %not_null
 //
 // null:                                             ; preds = %entry
-//   %3 = call i32 @CrcHash161(i8* inttoptr (i64 119151312 to i8*), i32 16, i32 %0)
+//   %3 = call i64 @IrMurmur64Hash1(i8* inttoptr (i64 119151312 to i8*), i32 16,
+//       i64 %0)
 //   br label %continue
 //
 // not_null:                                         ; preds = %entry
@@ -635,15 +646,14 @@ Function* HashTableCtx::CodegenEvalRow(RuntimeState* state, bool build) {
 //       (i64 119151312 to %"struct.impala::StringValue"*), i32 0, i32 0)
 //   %5 = load i32* getelementptr inbounds (%"struct.impala::StringValue"* inttoptr
 //       (i64 119151312 to %"struct.impala::StringValue"*), i32 0, i32 1)
-//   %6 = call i32 @IrCrcHash(i8* %4, i32 %5, i32 %0)
+//   %6 = call i64 @IrMurmur64Hash2(i8* %4, i32 %5, i64 %0)
 //   br label %continue
 //
 // continue:                                         ; preds = %not_null, %null
-//   %7 = phi i32 [ %6, %not_null ], [ %3, %null ]
-//   call void @set_hash(%"class.impala::HashTableCtx"* %this_ptr, i32 %7)
-//   ret i32 %7
+//   %7 = phi i64 [ %6, %not_null ], [ %3, %null ]
+//   ret i64 %7
 // }
-Function* HashTableCtx::CodegenHashCurrentRow(RuntimeState* state, bool use_murmur) {
+Function* HashTableCtx::CodegenHashCurrentRow(RuntimeState* state) {
   for (int i = 0; i < build_expr_ctxs_.size(); ++i) {
     // Disable codegen for CHAR
     if (build_expr_ctxs_[i]->root()->type().type == TYPE_CHAR) return NULL;
@@ -657,9 +667,8 @@ Function* HashTableCtx::CodegenHashCurrentRow(RuntimeState* state, bool use_murm
   DCHECK(this_type != NULL);
   PointerType* this_ptr_type = PointerType::get(this_type, 0);
 
-  LlvmCodeGen::FnPrototype prototype(codegen,
-      (use_murmur ? "MurmurHashCurrentRow" : "HashCurrentRow"),
-      codegen->GetType(TYPE_INT));
+  LlvmCodeGen::FnPrototype prototype(codegen, "HashCurrentRow",
+      codegen->GetType(TYPE_BIGINT));
   prototype.AddArgument(LlvmCodeGen::NamedVariable("this_ptr", this_ptr_type));
 
   LLVMContext& context = codegen->context();
@@ -671,22 +680,18 @@ Function* HashTableCtx::CodegenHashCurrentRow(RuntimeState* state, bool use_murm
   Function* get_hash_seed_fn = codegen->GetFunction(IRFunction::HASH_TABLE_GET_HASH_SEED);
   Value* seed = builder.CreateCall(get_hash_seed_fn, this_arg, "seed");
 
-  Value* hash_result = seed;
+  Value* hash_result = builder.CreateZExt(seed, codegen->GetType(TYPE_BIGINT), "seed64");
   Value* data = codegen->CastPtrToLlvmPtr(codegen->ptr_type(), expr_values_buffer_);
   if (var_result_begin_ == -1) {
     // No variable length slots, just hash what is in 'expr_values_buffer_'
     if (results_buffer_size_ > 0) {
-      Function* hash_fn = use_murmur ?
-                          codegen->GetMurmurHashFunction(results_buffer_size_) :
-                          codegen->GetHashFunction(results_buffer_size_);
+      Function* hash_fn = codegen->GetMurmur64HashFunction(results_buffer_size_);
       Value* len = codegen->GetIntConstant(TYPE_INT, results_buffer_size_);
       hash_result = builder.CreateCall3(hash_fn, data, len, hash_result, "hash");
     }
   } else {
     if (var_result_begin_ > 0) {
-      Function* hash_fn = use_murmur ?
-                          codegen->GetMurmurHashFunction(var_result_begin_) :
-                          codegen->GetHashFunction(var_result_begin_);
+      Function* hash_fn = codegen->GetMurmur64HashFunction(var_result_begin_);
       Value* len = codegen->GetIntConstant(TYPE_INT, var_result_begin_);
       hash_result = builder.CreateCall3(hash_fn, data, len, hash_result, "hash");
     }
@@ -721,9 +726,8 @@ Function* HashTableCtx::CodegenHashCurrentRow(RuntimeState* state, bool use_murm
         // For null, we just want to call the hash function on the portion of
         // the data
         builder.SetInsertPoint(null_block);
-        Function* null_hash_fn = use_murmur ?
-                                 codegen->GetMurmurHashFunction(sizeof(StringValue)) :
-                                 codegen->GetHashFunction(sizeof(StringValue));
+        Function* null_hash_fn =
+            codegen->GetMurmur64HashFunction(sizeof(StringValue));
         Value* llvm_loc = codegen->CastPtrToLlvmPtr(codegen->ptr_type(), loc);
         Value* len = codegen->GetIntConstant(TYPE_INT, sizeof(StringValue));
         str_null_result =
@@ -742,8 +746,7 @@ Function* HashTableCtx::CodegenHashCurrentRow(RuntimeState* state, bool use_murm
       len = builder.CreateLoad(len, "len");
 
       // Call hash(ptr, len, hash_result);
-      Function* general_hash_fn = use_murmur ? codegen->GetMurmurHashFunction() :
-                                  codegen->GetHashFunction();
+      Function* general_hash_fn = codegen->GetMurmur64HashFunction();
       Value* string_hash_result =
           builder.CreateCall3(general_hash_fn, ptr, len, hash_result, "string_hash");
 
@@ -752,7 +755,8 @@ Function* HashTableCtx::CodegenHashCurrentRow(RuntimeState* state, bool use_murm
         builder.SetInsertPoint(continue_block);
         // Use phi node to reconcile that we could have come from the string-null
         // path and string not null paths.
-        PHINode* phi_node = builder.CreatePHI(codegen->GetType(TYPE_INT), 2, "hash_phi");
+        PHINode* phi_node =
+            builder.CreatePHI(codegen->GetType(TYPE_BIGINT), 2, "hash_phi");
         phi_node->addIncoming(string_hash_result, not_null_block);
         phi_node->addIncoming(str_null_result, null_block);
         hash_result = phi_node;
@@ -20,6 +20,7 @@
 #include <boost/cstdint.hpp>
 #include <boost/scoped_ptr.hpp>
 #include "codegen/impala-ir.h"
+#include "common/compiler-util.h"
 #include "common/logging.h"
 #include "runtime/buffered-block-mgr.h"
 #include "runtime/buffered-tuple-stream.h"
@@ -77,6 +78,13 @@ class HashTable;
 // doubling nature of the buckets, we require that the number of buckets is a power of 2.
 // This allows us to perform a modulo of the hash using a bitmask.
 //
+// Hashes are 64 bits. Callers that partition their input (partitioned aggregation and
+// hash join) take the partition from the top bits of the hash, while the hash table
+// takes the bucket index from the low bits. Each bucket caches bits 0 to 55 of the hash
+// of its entry: the low 32 bits in 'hash' and the next 24 bits in 'hash_tag'. A probe
+// only compares rows when both match, so rows in the same partition that are not equal
+// are compared with a probability of roughly 2^-56 per bucket visited.
+//
 // We choose to use linear or quadratic probing because they exhibit good (predictable)
 // cache behavior.
 // We require that the number of buckets is a power of 2. This allows us to determine the
@@ -85,8 +93,6 @@ class HashTable;
 // to reduce the memory footprint of small queries.
 //
 // TODO: Compare linear and quadratic probing and remove the loser.
-// TODO: We currently use 32-bit hashes. There is room in the bucket structure for at
-// least 48-bits. We should exploit this space.
 // TODO: Consider capping the probes with a threshold value. If an insert reaches
 // that threshold it is inserted to another linked list of overflow entries.
 // TODO: Smarter resizes, and perhaps avoid using powers of 2 as the hash table size.
@@ -96,7 +102,6 @@ class HashTable;
 // all the rows and then calls scan to find them.  Aggregation interleaves Find() and
 // Inserts().  We may want to optimize joins more heavily for Inserts() (in particular
 // growing).
-// TODO: Batched interface for inserts and finds.
 // TODO: Do we need to check mem limit exceeded so often. Check once per batch?
 
 // Control block for a hash table.  This class contains the logic as well as the variables
@@ -145,8 +150,30 @@ class HashTableCtx {
   // contains NULL.
   // These need to be inlined in the IR module so we can find and replace the calls to
   // EvalBuildRow()/EvalProbeRow().
-  bool IR_ALWAYS_INLINE EvalAndHashBuild(TupleRow* row, uint32_t* hash);
-  bool IR_ALWAYS_INLINE EvalAndHashProbe(TupleRow* row, uint32_t* hash);
+  bool IR_ALWAYS_INLINE EvalAndHashBuild(TupleRow* row, uint64_t* hash);
+  bool IR_ALWAYS_INLINE EvalAndHashProbe(TupleRow* row, uint64_t* hash);
+
+  // Row cache for batched lookups. Looking up a row typically misses the cache on its
+  // bucket, and going one row at a time serializes these misses. Instead, callers can
+  // evaluate and hash all rows of a batch up front, saving each one with
+  // CacheCurrentRow() or CacheRejectedRow() and prefetching its bucket with
+  // HashTable::PrefetchBucket(). In a second pass LoadCachedRow() makes each row the
+  // last evaluated row again, so it can be passed to Find() or Insert().
+  // Makes sure the cache can hold 'num_rows' rows.
+  void ReserveRowCache(int num_rows);
+
+  // Saves the last evaluated row and its 'hash' at position 'idx' of the row cache.
+  void IR_ALWAYS_INLINE CacheCurrentRow(int idx, uint64_t hash);
+
+  // Marks the row at position 'idx' as rejected by EvalAndHashBuild()/EvalAndHashProbe().
+  void CacheRejectedRow(int idx) {
+    DCHECK_LT(idx, row_cache_hashes_.size());
+    row_cache_rejected_[idx] = true;
+  }
+
+  // Restores the row at position 'idx' of the row cache as the last evaluated row and
+  // returns its hash in *hash. Returns false if the row was rejected.
+  bool IR_ALWAYS_INLINE LoadCachedRow(int idx, uint64_t* hash);
 
   int results_buffer_size() const { return results_buffer_size_; }
 
@@ -160,11 +187,9 @@ class HashTableCtx {
   llvm::Function* CodegenEquals(RuntimeState* state);
 
   // Codegen for hashing the expr values in 'expr_values_buffer_'. Function prototype
-  // matches HashCurrentRow identically. Unlike HashCurrentRow(), the returned function
-  // only uses a single hash function, rather than switching based on level_.
-  // If 'use_murmur' is true, murmur hash is used, otherwise CRC is used if the hardware
-  // supports it (see hash-util.h).
-  llvm::Function* CodegenHashCurrentRow(RuntimeState* state, bool use_murmur);
+  // matches HashCurrentRow identically. The seed is read from the context, so the
+  // returned function can be used at any level.
+  llvm::Function* CodegenHashCurrentRow(RuntimeState* state);
 
   static const char* LLVM_CLASS_NAME;
 
@@ -174,25 +199,21 @@ class HashTableCtx {
   // Compute the hash of the values in expr_values_buffer_.
   // This will be replaced by codegen.  We don't want this inlined for replacing
   // with codegen'd functions so the function name does not change.
-  uint32_t IR_NO_INLINE HashCurrentRow() {
+  uint64_t IR_NO_INLINE HashCurrentRow() {
     DCHECK_LT(level_, seeds_.size());
     if (var_result_begin_ == -1) {
       // This handles NULLs implicitly since a constant seed value was put
       // into results buffer for nulls.
-      // TODO: figure out which hash function to use. We need to generate uncorrelated
-      // hashes by changing just the seed. CRC does not have this property and FNV is
-      // okay. We should switch to something else.
       return Hash(expr_values_buffer_, results_buffer_size_, seeds_[level_]);
     } else {
       return HashTableCtx::HashVariableLenRow();
     }
   }
 
-  // Wrapper function for calling correct HashUtil function in non-codegen'd case.
-  uint32_t inline Hash(const void* input, int len, int32_t hash) {
-    // Use CRC hash at first level for better performance. Switch to murmur hash at
-    // subsequent levels since CRC doesn't randomize well with different seed inputs.
-    if (level_ == 0) return HashUtil::Hash(input, len, hash);
+  // Wrapper function for calling the HashUtil function in the non-codegen'd case.
+  // Murmur is used at all levels: it produces 64 bits, and unlike CRC, hashes with
+  // different seeds are not correlated, which repartitioning at the next level needs.
+  uint64_t inline Hash(const void* input, int len, uint64_t hash) {
     return HashUtil::MurmurHash2_64(input, len, hash);
   }
 
@@ -212,7 +233,7 @@ class HashTableCtx {
 
   // Compute the hash of the values in expr_values_buffer_ for rows with variable length
   // fields (e.g. strings).
-  uint32_t HashVariableLenRow();
+  uint64_t HashVariableLenRow();
 
   // Evaluate the exprs over row and cache the results in 'expr_values_buffer_'.
   // Returns whether any expr evaluated to NULL.
@@ -265,6 +286,14 @@ class HashTableCtx {
   // Scratch buffer to generate rows on the fly.
   TupleRow* row_;
 
+  // Row cache, see ReserveRowCache(). Each entry of 'row_cache_values_' is
+  // 'row_cache_stride_' bytes: the contents of 'expr_values_buffer_' followed by the
+  // contents of 'expr_value_null_bits_'.
+  int row_cache_stride_;
+  std::vector<uint8_t> row_cache_values_;
+  std::vector<uint64_t> row_cache_hashes_;
+  std::vector<uint8_t> row_cache_rejected_;
+
   // Cross-compiled functions to access member variables used in CodegenHashCurrentRow().
   uint32_t GetHashSeed() const;
 };
@@ -302,20 +331,24 @@ class HashTable {
 
   struct Bucket {
     // Whether this bucket contains a vaild entry, or it is empty.
-    bool filled;
+    bool filled : 1;
 
     // Used for full outer and right {outer, anti, semi} joins. Indicates whether the
     // row in the bucket has been matched.
     // From an abstraction point of view, this is an awkward place to store this
     // information but it is efficient. This space is otherwise unused.
-    bool matched;
+    bool matched : 1;
 
     // Used in case of duplicates. If true, then the bucketData union should be used as
     // 'duplicates'.
-    bool hasDuplicates;
+    bool hasDuplicates : 1;
+
+    // Bits 32 to 55 of the hash for data. Fits next to the flags above without growing
+    // the bucket.
+    uint32_t hash_tag : 24;
 
-    // Cache of the hash for data.
-    // TODO: Do we even have to cache the hash value?
+    // Cache of the low 32 bits of the hash for data. Together with 'hash_tag' this is
+    // enough to find the bucket again when resizing, see BucketHash().
     uint32_t hash;
 
     // Either the data for this bucket or the linked list of duplicates.
@@ -362,11 +395,11 @@ class HashTable {
   // the insert fails and this function returns false.
   // Used during the build phase of hash joins.
   bool IR_ALWAYS_INLINE Insert(HashTableCtx* ht_ctx,
-      const BufferedTupleStream::RowIdx& idx, TupleRow* row, uint32_t hash);
+      const BufferedTupleStream::RowIdx& idx, TupleRow* row, uint64_t hash);
 
   // Same as Insert() but for inserting a single Tuple. The 'tuple' is not copied by
   // the hash table and the caller must guarantee it stays in memory.
-  bool IR_ALWAYS_INLINE Insert(HashTableCtx* ht_ctx, Tuple* tuple, uint32_t hash);
+  bool IR_ALWAYS_INLINE Insert(HashTableCtx* ht_ctx, Tuple* tuple, uint64_t hash);
 
   // Returns an iterator to the bucket matching the last row evaluated in 'ht_ctx'.
   // Returns HashTable::End() if no match is found. The iterator can be iterated until
@@ -374,7 +407,13 @@ class HashTable {
   // go to the next matching row. The matching rows do not need to be evaluated since all
   // the nodes of a bucket are duplicates. One scan can be in progress for each 'ht_ctx'.
   // Used during the probe phase of hash joins.
-  Iterator IR_ALWAYS_INLINE Find(HashTableCtx* ht_ctx, uint32_t hash);
+  Iterator IR_ALWAYS_INLINE Find(HashTableCtx* ht_ctx, uint64_t hash);
+
+  // Prefetches the bucket where a Find() or Insert() of 'hash' starts probing. Used to
+  // overlap the cache misses of a batch of lookups, see HashTableCtx::ReserveRowCache().
+  void IR_ALWAYS_INLINE PrefetchBucket(uint64_t hash) {
+    PREFETCH(&buckets_[hash & (num_buckets_ - 1)]);
+  }
 
   // Returns number of elements inserted in the hash table
   int64_t size() const {
@@ -404,6 +443,12 @@ class HashTable {
     return num_buckets * sizeof(Bucket);
   }
 
+  // Returns an estimate of the number of bytes of data pages needed for 'num_rows' if
+  // they all have the same key, i.e. all but one of them are stored in DuplicateNodes.
+  static int64_t EstimateDuplicateNodesSize(int64_t num_rows) {
+    return num_rows * sizeof(DuplicateNode);
+  }
+
   // Returns the memory occupied by the hash table, takes into account the number of
   // duplicates.
   int64_t CurrentMemSize() const;
@@ -495,7 +540,7 @@ class HashTable {
     friend class HashTable;
 
     Iterator(HashTable* table, TupleRow* row, int bucket_idx, DuplicateNode* node,
-             uint32_t hash)
+             uint64_t hash)
       : table_(table),
         row_(row),
         bucket_idx_(bucket_idx),
@@ -534,11 +579,11 @@ class HashTable {
   //
   // There are wrappers of this function that perform the Find and Insert logic.
   int64_t IR_ALWAYS_INLINE Probe(Bucket* buckets, int64_t num_buckets,
-      HashTableCtx* ht_ctx, uint32_t hash,  bool* found);
+      HashTableCtx* ht_ctx, uint64_t hash,  bool* found);
 
   // Performs the insert logic. Returns the HtData* of the bucket or duplicate node
   // where the data should be inserted. Returns NULL if the insert was not successful.
-  HtData* IR_ALWAYS_INLINE InsertInternal(HashTableCtx* ht_ctx, uint32_t hash);
+  HtData* IR_ALWAYS_INLINE InsertInternal(HashTableCtx* ht_ctx, uint64_t hash);
 
   // Updates 'bucket_idx' to the index of the next non-empty bucket. If the bucket has
   // duplicates, 'node' will be pointing to the head of the linked list of duplicates.
@@ -566,7 +611,15 @@ class HashTable {
 
   // Resets the contents of the bucket with index 'bucket_idx', in preparation for an
   // insert. Sets all the fields of the bucket other than 'data'.
-  void IR_ALWAYS_INLINE PrepareBucketForInsert(int64_t bucket_idx, uint32_t hash);
+  void IR_ALWAYS_INLINE PrepareBucketForInsert(int64_t bucket_idx, uint64_t hash);
+
+  // Returns the bits of the hash cached in 'bucket'. Only the bits below 56 are set.
+  static uint64_t BucketHash(const Bucket* bucket) {
+    return (static_cast<uint64_t>(bucket->hash_tag) << 32) | bucket->hash;
+  }
+
+  // Returns the bits of 'hash' that are cached as 'hash_tag'.
+  static uint32_t HashTag(uint64_t hash) { return (hash >> 32) & ((1 << 24) - 1); }
 
   // Return the TupleRow pointed by 'htdata'.
   TupleRow* GetRow(HtData& htdata, TupleRow* row) const;
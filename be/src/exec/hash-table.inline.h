@@ -20,26 +20,47 @@
 
 namespace impala {
 
-inline bool HashTableCtx::EvalAndHashBuild(TupleRow* row, uint32_t* hash) {
+inline bool HashTableCtx::EvalAndHashBuild(TupleRow* row, uint64_t* hash) {
   bool has_null = EvalBuildRow(row);
   if (!stores_nulls_ && has_null) return false;
   *hash = HashCurrentRow();
   return true;
 }
 
-inline bool HashTableCtx::EvalAndHashProbe(TupleRow* row, uint32_t* hash) {
+inline bool HashTableCtx::EvalAndHashProbe(TupleRow* row, uint64_t* hash) {
   bool has_null = EvalProbeRow(row);
   if ((!stores_nulls_ || !finds_nulls_) && has_null) return false;
   *hash = HashCurrentRow();
   return true;
 }
 
+inline void HashTableCtx::CacheCurrentRow(int idx, uint64_t hash) {
+  DCHECK_LT(idx, row_cache_hashes_.size());
+  uint8_t* entry = &row_cache_values_[idx * row_cache_stride_];
+  memcpy(entry, expr_values_buffer_, results_buffer_size_);
+  memcpy(entry + results_buffer_size_, expr_value_null_bits_, build_expr_ctxs_.size());
+  row_cache_hashes_[idx] = hash;
+  row_cache_rejected_[idx] = false;
+}
+
+inline bool HashTableCtx::LoadCachedRow(int idx, uint64_t* hash) {
+  DCHECK_LT(idx, row_cache_hashes_.size());
+  if (row_cache_rejected_[idx]) return false;
+  const uint8_t* entry = &row_cache_values_[idx * row_cache_stride_];
+  memcpy(expr_values_buffer_, entry, results_buffer_size_);
+  memcpy(expr_value_null_bits_, entry + results_buffer_size_, build_expr_ctxs_.size());
+  *hash = row_cache_hashes_[idx];
+  return true;
+}
+
 inline int64_t HashTable::Probe(Bucket* buckets, int64_t num_buckets,
-    HashTableCtx* ht_ctx, uint32_t hash, bool* found) {
+    HashTableCtx* ht_ctx, uint64_t hash, bool* found) {
   DCHECK_NOTNULL(buckets);
   DCHECK_GT(num_buckets, 0);
   *found = false;
   int64_t bucket_idx = hash & (num_buckets - 1);
+  const uint32_t hash_low = static_cast<uint32_t>(hash);
+  const uint32_t hash_tag = HashTag(hash);
 
   // In case of linear probing it counts the total number of steps for statistics and
   // for knowing when to exit the loop (e.g. by capping the total travel length). In case
@@ -48,7 +69,7 @@ inline int64_t HashTable::Probe(Bucket* buckets, int64_t num_buckets,
   do {
     Bucket* bucket = &buckets[bucket_idx];
     if (!bucket->filled) return bucket_idx;
-    if (hash == bucket->hash) {
+    if (hash_low == bucket->hash && hash_tag == bucket->hash_tag) {
       if (ht_ctx != NULL && ht_ctx->Equals(GetRow(bucket, ht_ctx->row_))) {
         *found = true;
         return bucket_idx;
@@ -75,7 +96,7 @@ inline int64_t HashTable::Probe(Bucket* buckets, int64_t num_buckets,
 }
 
 inline HashTable::HtData* HashTable::InsertInternal(HashTableCtx* ht_ctx,
-    uint32_t hash) {
+    uint64_t hash) {
   ++num_probes_;
   bool found = false;
   int64_t bucket_idx = Probe(buckets_, num_buckets_, ht_ctx, hash, &found);
@@ -92,7 +113,7 @@ inline HashTable::HtData* HashTable::InsertInternal(HashTableCtx* ht_ctx,
 }
 
 inline bool HashTable::Insert(HashTableCtx* ht_ctx,
-    const BufferedTupleStream::RowIdx& idx, TupleRow* row, uint32_t hash) {
+    const BufferedTupleStream::RowIdx& idx, TupleRow* row, uint64_t hash) {
   if (stores_tuples_) return Insert(ht_ctx, row->GetTuple(0), hash);
   HtData* htdata = InsertInternal(ht_ctx, hash);
   // If successful insert, update the contents of the newly inserted entry with 'idx'.
@@ -103,7 +124,7 @@ inline bool HashTable::Insert(HashTableCtx* ht_ctx,
   return false;
 }
 
-inline bool HashTable::Insert(HashTableCtx* ht_ctx, Tuple* tuple, uint32_t hash) {
+inline bool HashTable::Insert(HashTableCtx* ht_ctx, Tuple* tuple, uint64_t hash) {
   DCHECK(stores_tuples_);
   HtData* htdata = InsertInternal(ht_ctx, hash);
   // If successful insert, update the contents of the newly inserted entry with 'tuple'.
@@ -114,7 +135,7 @@ inline bool HashTable::Insert(HashTableCtx* ht_ctx, Tuple* tuple, uint32_t hash)
   return false;
 }
 
-inline HashTable::Iterator HashTable::Find(HashTableCtx* ht_ctx, uint32_t hash) {
+inline HashTable::Iterator HashTable::Find(HashTableCtx* ht_ctx, uint64_t hash) {
   ++num_probes_;
   bool found = false;
   int64_t bucket_idx = Probe(buckets_, num_buckets_, ht_ctx, hash, &found);
@@ -160,7 +181,7 @@ inline void HashTable::NextFilledBucket(int64_t* bucket_idx, DuplicateNode** nod
   *node = NULL;
 }
 
-inline void HashTable::PrepareBucketForInsert(int64_t bucket_idx, uint32_t hash) {
+inline void HashTable::PrepareBucketForInsert(int64_t bucket_idx, uint64_t hash) {
   DCHECK_GE(bucket_idx, 0);
   DCHECK_LT(bucket_idx, num_buckets_);
   Bucket* bucket = &buckets_[bucket_idx];
@@ -169,7 +190,8 @@ inline void HashTable::PrepareBucketForInsert(int64_t bucket_idx, uint32_t hash)
   bucket->filled = true;
   bucket->matched = false;
   bucket->hasDuplicates = false;
-  bucket->hash = hash;
+  bucket->hash = static_cast<uint32_t>(hash);
+  bucket->hash_tag = HashTag(hash);
 }
 
 inline HashTable::DuplicateNode* HashTable::AppendNextNode(Bucket* bucket) {
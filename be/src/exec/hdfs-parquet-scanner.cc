@@ -26,6 +26,8 @@
 #include "exec/scanner-context.inline.h"
 #include "exec/read-write-util.h"
 #include "exprs/expr.h"
+#include "exprs/expr-context.h"
+#include "exprs/slot-ref.h"
 #include "runtime/descriptors.h"
 #include "runtime/runtime-state.h"
 #include "runtime/mem-pool.h"
@@ -36,12 +38,14 @@
 #include "runtime/string-value.h"
 #include "util/bitmap.h"
 #include "util/bit-util.h"
+#include "util/bloom-filter.h"
 #include "util/decompress.h"
 #include "util/debug-util.h"
 #include "util/error-util.h"
 #include "util/dict-encoding.h"
 #include "util/rle-encoding.h"
 #include "util/runtime-profile.h"
+#include "util/string-parser.h"
 #include "rpc/thrift-util.h"
 
 using namespace std;
@@ -55,6 +59,15 @@ DEFINE_bool(convert_legacy_hive_parquet_utc_timestamps, false,
     "When true, TIMESTAMPs read from files written by Parquet-MR (used by Hive) will "
     "be converted from UTC to local time. Writes are unaffected.");
 
+DEFINE_bool(parquet_dictionary_filtering, true, "When true, conjuncts that only "
+    "reference a single dictionary-encoded column are evaluated once per dictionary "
+    "entry. Rows with rejected entries are skipped and row groups with no matching "
+    "entries are not read.");
+
+DEFINE_bool(parquet_index_filtering, true, "When true, comparisons of a column with "
+    "constants are evaluated against the page indexes and bloom filters of the file, if "
+    "it has them. Row groups and data pages that cannot match are skipped.");
+
 // Max data page header size in bytes. This is an estimate and only needs to be an upper
 // bound. It is theoretically possible to have a page header of any size due to string
 // value statistics, but in practice we'll have trouble reading string values this large.
@@ -150,6 +163,10 @@ class HdfsParquetScanner::BaseColumnReader {
     metadata_ = metadata;
     dict_decoder_base_ = NULL;
     num_values_read_ = 0;
+    dict_filter_.clear();
+    dict_filter_null_passes_ = true;
+    dict_filter_rejects_all_ = false;
+    skip_current_page_ = false;
     if (metadata_->codec != parquet::CompressionCodec::UNCOMPRESSED) {
       RETURN_IF_ERROR(Codec::CreateDecompressor(
           NULL, false, PARQUET_TO_IMPALA_CODEC[metadata_->codec], &decompressor_));
@@ -167,6 +184,7 @@ class HdfsParquetScanner::BaseColumnReader {
   const parquet::SchemaElement& schema_element() const { return *node_.element; }
   int col_idx() const { return node_.col_idx; }
   int max_def_level() const { return node_.max_def_level; }
+  int max_rep_level() const { return node_.max_rep_level; }
   THdfsCompression::type codec() const {
     if (metadata_ == NULL) return THdfsCompression::NONE;
     return PARQUET_TO_IMPALA_CODEC[metadata_->codec];
@@ -189,6 +207,23 @@ class HdfsParquetScanner::BaseColumnReader {
   // we know this row can be skipped. This could be very useful with stats and big
   // sections can be skipped. Implement that when we can benefit from it.
 
+  // Returns true if this reader can evaluate conjuncts against its dictionary entries.
+  virtual bool SupportsDictFilter() const { return false; }
+
+  // Returns true if this reader can evaluate index predicates against page indexes and
+  // bloom filters.
+  virtual bool SupportsIndexFilter() const { return false; }
+
+  // Returns false if no value in [min_value, max_value], which are encoded with
+  // ParquetIndexEncoder, can pass all of index_predicates_.
+  virtual bool PageMayMatch(const string& min_value, const string& max_value) const {
+    return true;
+  }
+
+  // Returns false if none of the values of an equality or IN predicate in
+  // index_predicates_ is in 'filter'.
+  bool BloomFilterMayMatch(const BloomFilter& filter) const;
+
  protected:
   friend class HdfsParquetScanner;
 
@@ -235,6 +270,35 @@ class HdfsParquetScanner::BaseColumnReader {
   int64_t rows_returned_;
   int64_t bitmap_filter_rows_rejected_;
 
+  // Global runtime filter on this slot (see RuntimeState::GetGlobalFilter()), NULL if
+  // there is none. Applied to every value and, with dictionary filtering, to every
+  // dictionary entry.
+  const BloomFilter* global_filter_;
+
+  // Conjuncts that only reference this column's slot. When the column chunk has a
+  // dictionary, these are evaluated once per dictionary entry (see EvalDictFilter())
+  // instead of once per row. Not owned. Empty if dictionary filtering is disabled.
+  std::vector<ExprContext*> dict_filter_conjunct_ctxs_;
+
+  // Result of evaluating dict_filter_conjunct_ctxs_, indexed by dictionary index.
+  // Rows whose dictionary entry is false are skipped without being materialized.
+  // Empty if the current column chunk has no dictionary or no conjuncts to evaluate.
+  std::vector<bool> dict_filter_;
+
+  // True if a NULL value for this column passes dict_filter_conjunct_ctxs_.
+  bool dict_filter_null_passes_;
+
+  // True if neither a NULL nor any of the dictionary entries pass the conjuncts.
+  bool dict_filter_rejects_all_;
+
+  // Comparisons of this column with constants, evaluated against the page indexes and
+  // bloom filters of the file. Empty if index filtering is disabled.
+  std::vector<IndexPredicate> index_predicates_;
+
+  // True if the current data page was skipped because none of its rows can pass the
+  // conjuncts. The page's values are not decoded and its rows fail the conjuncts.
+  bool skip_current_page_;
+
   BaseColumnReader(HdfsParquetScanner* parent, const SchemaNode& node)
     : parent_(parent),
       node_(node),
@@ -242,7 +306,8 @@ class HdfsParquetScanner::BaseColumnReader {
       stream_(NULL),
       decompressed_data_pool_(new MemPool(parent->scan_node_->mem_tracker())),
       num_buffered_values_(0),
-      num_values_read_(0) {
+      num_values_read_(0),
+      skip_current_page_(false) {
     DCHECK_NOTNULL(node.slot_desc);
     DCHECK_GE(node.col_idx, 0);
     DCHECK_GE(node.max_def_level, 0);
@@ -252,6 +317,15 @@ class HdfsParquetScanner::BaseColumnReader {
     hash_seed_ = state->fragment_hash_seed();
     rows_returned_ = 0;
     bitmap_filter_rows_rejected_ = 0;
+    global_filter_ = state->GetGlobalFilter(slot_desc()->id());
+  }
+
+  // Returns true if the dictionary entries of the column chunk are filtered, either by
+  // conjuncts or by the global filter.
+  bool HasDictFilter() const {
+    return !dict_filter_conjunct_ctxs_.empty() ||
+        (global_filter_ != NULL && FLAGS_parquet_dictionary_filtering &&
+         SupportsDictFilter());
   }
 
   // Read the next data page.  If a dictionary page is encountered, that will
@@ -266,6 +340,11 @@ class HdfsParquetScanner::BaseColumnReader {
   // and set dict_decoder_base_.
   virtual void CreateDictionaryDecoder(uint8_t* values, int size) = 0;
 
+  // Evaluates dict_filter_conjunct_ctxs_ against every entry of the dictionary and
+  // populates dict_filter_, dict_filter_null_passes_ and dict_filter_rejects_all_.
+  // Only called if SupportsDictFilter() returns true.
+  virtual void EvalDictFilter() = 0;
+
   // Initializes the reader with the data contents. This is the content for
   // the entire decompressed data page. Decoders can initialize state from
   // here.
@@ -301,11 +380,105 @@ class HdfsParquetScanner::ColumnReader : public HdfsParquetScanner::BaseColumnRe
   }
 
  protected:
+  virtual bool SupportsDictFilter() const {
+    // The conjuncts must see the converted value, so don't bypass the conversion.
+    return !needs_conversion_;
+  }
+
+  virtual bool SupportsIndexFilter() const {
+    // Page statistics are computed over the values in the file, which for converted
+    // and truncated (VARCHAR) values can differ from what the conjuncts see.
+    return !needs_conversion_ && slot_desc()->type().type != TYPE_VARCHAR;
+  }
+
+  virtual bool PageMayMatch(const string& min_value, const string& max_value) const {
+    int fixed_len_size = ParquetPlainEncoder::ByteSize(slot_desc()->type());
+    T min, max;
+    if (!ParquetIndexEncoder::Decode(min_value, fixed_len_size, &min) ||
+        !ParquetIndexEncoder::Decode(max_value, fixed_len_size, &max)) {
+      return true;
+    }
+    for (int i = 0; i < index_predicates_.size(); ++i) {
+      const IndexPredicate& pred = index_predicates_[i];
+      bool may_match = false;
+      for (int j = 0; j < pred.values.size() && !may_match; ++j) {
+        T v;
+        if (!ParquetIndexEncoder::Decode(pred.values[j], fixed_len_size, &v)) {
+          may_match = true;
+          break;
+        }
+        switch (pred.op) {
+          case IndexPredicate::EQ:
+          case IndexPredicate::IN:
+            may_match = !(v < min) && !(max < v);
+            break;
+          case IndexPredicate::LT:
+            may_match = min < v;
+            break;
+          case IndexPredicate::LE:
+            may_match = !(v < min);
+            break;
+          case IndexPredicate::GT:
+            may_match = v < max;
+            break;
+          case IndexPredicate::GE:
+            may_match = !(max < v);
+            break;
+        }
+      }
+      if (!may_match) return false;
+    }
+    return true;
+  }
+
   virtual void CreateDictionaryDecoder(uint8_t* values, int size) {
     dict_decoder_.reset(new DictDecoder<T>(values, size, fixed_len_size_));
     dict_decoder_base_ = dict_decoder_.get();
   }
 
+  virtual void EvalDictFilter() {
+    DCHECK(SupportsDictFilter());
+    DCHECK(dict_decoder_.get() != NULL);
+    DCHECK(HasDictFilter());
+    int num_ctxs = dict_filter_conjunct_ctxs_.size();
+    ExprContext* const* ctxs = num_ctxs == 0 ? NULL : &dict_filter_conjunct_ctxs_[0];
+
+    // The conjuncts only reference this slot, so a scratch row with just this slot
+    // set is enough to evaluate them.
+    vector<uint8_t> tuple_mem(parent_->tuple_byte_size_);
+    Tuple* tuple = reinterpret_cast<Tuple*>(&tuple_mem[0]);
+    parent_->InitTuple(parent_->template_tuple_, tuple);
+    vector<uint8_t> row_mem(parent_->scan_node_->row_desc().GetRowSize(), 0);
+    TupleRow* row = reinterpret_cast<TupleRow*>(&row_mem[0]);
+    row->SetTuple(parent_->scan_node_->tuple_idx(), tuple);
+    T* slot = reinterpret_cast<T*>(tuple->GetSlot(slot_desc()->tuple_offset()));
+
+    int num_entries = dict_decoder_->num_entries();
+    int num_passed = 0;
+    dict_filter_.resize(num_entries);
+    tuple->SetNotNull(slot_desc()->null_indicator_offset());
+    for (int i = 0; i < num_entries; ++i) {
+      dict_decoder_->GetDictValue(i, slot);
+      dict_filter_[i] = ExecNode::EvalConjuncts(ctxs, num_ctxs, row);
+      if (dict_filter_[i] && global_filter_ != NULL) {
+        dict_filter_[i] = global_filter_->Find(
+            RuntimeState::GetGlobalFilterHash(slot, slot_desc()->type()));
+      }
+      if (dict_filter_[i]) ++num_passed;
+    }
+    if (max_def_level() > 0) {
+      tuple->SetNull(slot_desc()->null_indicator_offset());
+      dict_filter_null_passes_ = ExecNode::EvalConjuncts(ctxs, num_ctxs, row);
+    } else {
+      // Required column, there are no NULLs to filter.
+      dict_filter_null_passes_ = false;
+    }
+    ExprContext::FreeLocalAllocations(dict_filter_conjunct_ctxs_);
+    dict_filter_rejects_all_ = num_passed == 0 && !dict_filter_null_passes_;
+    VLOG_FILE << "Dictionary filter for column " << col_idx() << ": " << num_passed
+              << " of " << num_entries << " entries passed.";
+  }
+
   virtual Status InitDataPage(uint8_t* data, int size) {
     if (current_page_header_.data_page_header.encoding ==
           parquet::Encoding::PLAIN_DICTIONARY) {
@@ -332,7 +505,13 @@ class HdfsParquetScanner::ColumnReader : public HdfsParquetScanner::BaseColumnRe
     T val;
     T* val_ptr = needs_conversion_ ? &val : reinterpret_cast<T*>(slot);
     if (page_encoding == parquet::Encoding::PLAIN_DICTIONARY) {
-      result = dict_decoder_->GetValue(val_ptr);
+      if (dict_filter_.empty()) {
+        result = dict_decoder_->GetValue(val_ptr);
+      } else {
+        int index;
+        result = dict_decoder_->GetValue(val_ptr, &index);
+        if (result && !dict_filter_[index]) *conjuncts_failed = true;
+      }
     } else {
       DCHECK(page_encoding == parquet::Encoding::PLAIN);
       data_ += ParquetPlainEncoder::Decode<T>(data_, fixed_len_size_, val_ptr);
@@ -344,6 +523,12 @@ class HdfsParquetScanner::ColumnReader : public HdfsParquetScanner::BaseColumnRe
       *conjuncts_failed = !bitmap_filter_->Get<true>(h);
       ++bitmap_filter_rows_rejected_;
     }
+    // Values of dictionary pages were already checked by EvalDictFilter().
+    if (!*conjuncts_failed && global_filter_ != NULL &&
+        (page_encoding != parquet::Encoding::PLAIN_DICTIONARY || dict_filter_.empty())) {
+      *conjuncts_failed = !global_filter_->Find(
+          RuntimeState::GetGlobalFilterHash(slot, slot_desc()->type()));
+    }
     return result;
   }
 
@@ -417,6 +602,10 @@ class HdfsParquetScanner::BoolColumnReader : public HdfsParquetScanner::BaseColu
                   << "have gotten this far.";
   }
 
+  virtual void EvalDictFilter() {
+    DCHECK(false) << "Dictionary filtering is not supported for bools.";
+  }
+
   virtual Status InitDataPage(uint8_t* data, int size) {
     // Initialize bool decoder
     bool_values_ = BitReader(data, size);
@@ -439,6 +628,15 @@ Status HdfsParquetScanner::Prepare(ScannerContext* context) {
   RETURN_IF_ERROR(HdfsScanner::Prepare(context));
   num_cols_counter_ =
       ADD_COUNTER(scan_node_->runtime_profile(), "NumColumns", TUnit::UNIT);
+  num_dict_filtered_row_groups_counter_ = ADD_COUNTER(
+      scan_node_->runtime_profile(), "NumDictFilteredRowGroups", TUnit::UNIT);
+  num_bloom_filtered_row_groups_counter_ = ADD_COUNTER(
+      scan_node_->runtime_profile(), "NumBloomFilteredRowGroups", TUnit::UNIT);
+  num_page_index_filtered_row_groups_counter_ = ADD_COUNTER(
+      scan_node_->runtime_profile(), "NumPageIndexFilteredRowGroups", TUnit::UNIT);
+  num_page_index_skipped_pages_counter_ = ADD_COUNTER(
+      scan_node_->runtime_profile(), "NumPageIndexSkippedPages", TUnit::UNIT);
+  conjuncts_failed_.resize(state_->batch_size());
 
   scan_node_->IncNumScannersCodegenDisabled();
   return Status::OK;
@@ -647,6 +845,7 @@ Status HdfsParquetScanner::BaseColumnReader::ReadDataPage() {
             "Invalid dictionary. Expected $0 entries but data contained $1 entries",
             dict_header->num_values, dict_decoder_base_->num_entries()));
       }
+      if (HasDictFilter()) EvalDictFilter();
       // Done with dictionary page, read next page
       continue;
     }
@@ -657,9 +856,21 @@ Status HdfsParquetScanner::BaseColumnReader::ReadDataPage() {
       continue;
     }
 
+    // Skip pages that have no rows that can pass the conjuncts without decompressing
+    // or decoding them.
+    int num_values = current_page_header_.data_page_header.num_values;
+    skip_current_page_ = !parent_->RowsMayMatch(num_values_read_, num_values);
+    if (skip_current_page_) {
+      if (!stream_->SkipBytes(data_size, &status)) return status;
+      num_buffered_values_ = num_values;
+      num_values_read_ += num_values;
+      COUNTER_ADD(parent_->num_page_index_skipped_pages_counter_, 1);
+      break;
+    }
+
     // Read Data Page
     if (!stream_->ReadBytes(data_size, &data_, &status)) return status;
-    num_buffered_values_ = current_page_header_.data_page_header.num_values;
+    num_buffered_values_ = num_values;
     num_values_read_ += num_buffered_values_;
 
     if (decompressor_.get() != NULL) {
@@ -752,6 +963,10 @@ inline bool HdfsParquetScanner::BaseColumnReader::ReadValue(
   }
 
   --num_buffered_values_;
+  if (UNLIKELY(skip_current_page_)) {
+    *conjuncts_failed = true;
+    return true;
+  }
   int definition_level = ReadDefinitionLevel();
   if (definition_level < 0) return false;
 
@@ -759,6 +974,7 @@ inline bool HdfsParquetScanner::BaseColumnReader::ReadValue(
     // Null value
     DCHECK_LT(definition_level, max_def_level());
     tuple->SetNull(slot_desc()->null_indicator_offset());
+    if (!dict_filter_null_passes_) *conjuncts_failed = true;
     return true;
   }
   return ReadSlot(tuple->GetSlot(slot_desc()->tuple_offset()), pool, conjuncts_failed);
@@ -791,7 +1007,17 @@ Status HdfsParquetScanner::ProcessSplit() {
     // Commit the rows to flush the row batch from the previous row group
     CommitRows(0);
 
+    bool skip_row_group;
+    RETURN_IF_ERROR(EvalIndexFilters(i, &skip_row_group));
+    if (skip_row_group) continue;
+
     RETURN_IF_ERROR(InitColumns(i));
+
+    RETURN_IF_ERROR(EvalDictionaryFilters(i, &skip_row_group));
+    if (skip_row_group) {
+      COUNTER_ADD(num_dict_filtered_row_groups_counter_, 1);
+      continue;
+    }
     RETURN_IF_ERROR(AssembleRows(i));
   }
 
@@ -819,44 +1045,75 @@ Status HdfsParquetScanner::AssembleRows(int row_group_idx) {
 
     int num_to_commit = 0;
     if (num_column_readers > 0) {
+      // Materialize the tuples column by column: every column reader decodes its values
+      // of all 'num_rows' tuples before the next reader starts, which keeps the state of
+      // one reader (its page, dictionary and decoders) hot and the decoding loop tight.
+      // The conjuncts are evaluated in a second pass, and the passing tuples are
+      // compacted to the front of the tuple buffer.
+      DCHECK_LE(num_rows, conjuncts_failed_.size());
+      Tuple* first_tuple = tuple;
       for (int i = 0; i < num_rows; ++i) {
-        bool conjuncts_failed = false;
         InitTuple(template_tuple_, tuple);
-        for (int c = 0; c < num_column_readers; ++c) {
-          if (!column_readers_[c]->ReadValue(pool, tuple, &conjuncts_failed)) {
-            assemble_rows_timer_.Stop();
+        conjuncts_failed_[i] = false;
+        tuple = next_tuple(tuple);
+      }
+      // Index of the first column that ran out of values, or -1.
+      int done_column = -1;
+      for (int c = 0; c < num_column_readers; ++c) {
+        BaseColumnReader* reader = column_readers_[c];
+        tuple = first_tuple;
+        for (int i = 0; i < num_rows; ++i) {
+          bool conjuncts_failed = conjuncts_failed_[i];
+          if (!reader->ReadValue(pool, tuple, &conjuncts_failed)) {
             // This column is complete and has no more data.  This indicates
             // we are done with this row group.
             // For correctly formed files, this should be the first column we
-            // are reading.
+            // are reading. The other columns only read the rows it completed.
             DCHECK(c == 0 || !parse_status_.ok())
-              << "c=" << c << " " << parse_status_.GetDetail();;
-            COUNTER_ADD(scan_node_->rows_read_counter(), i);
-            RETURN_IF_ERROR(CommitRows(num_to_commit));
-
-            // If we reach this point, it means that we reached the end of file for
-            // this column. Test if the expected number of rows from metadata matches
-            // the actual number of rows in the file.
-            rows_read += i;
-            if (rows_read != expected_rows_in_group) {
-              HdfsParquetScanner::BaseColumnReader* reader = column_readers_[c];
-              DCHECK_NOTNULL(reader->stream_);
-
-              ErrorMsg msg(TErrorCode::PARQUET_GROUP_ROW_COUNT_ERROR,
-                 reader->stream_->filename(), row_group_idx,
-                 expected_rows_in_group, rows_read);
-              LOG_OR_RETURN_ON_ERROR(msg, scan_node_->runtime_state());
-            }
-            return parse_status_;
+              << "c=" << c << " " << parse_status_.GetDetail();
+            if (done_column < 0) done_column = c;
+            num_rows = i;
+            break;
           }
+          conjuncts_failed_[i] = conjuncts_failed;
+          tuple = next_tuple(tuple);
         }
-        if (conjuncts_failed) continue;
+      }
+
+      tuple = first_tuple;
+      Tuple* dst_tuple = first_tuple;
+      for (int i = 0; i < num_rows; ++i, tuple = next_tuple(tuple)) {
+        if (conjuncts_failed_[i]) continue;
         row->SetTuple(scan_node_->tuple_idx(), tuple);
-        if (EvalConjuncts(row)) {
-          row = next_row(row);
-          tuple = next_tuple(tuple);
-          ++num_to_commit;
+        if (!EvalConjuncts(row)) continue;
+        if (dst_tuple != tuple) {
+          memcpy(dst_tuple, tuple, tuple_byte_size_);
+          row->SetTuple(scan_node_->tuple_idx(), dst_tuple);
         }
+        row = next_row(row);
+        dst_tuple = next_tuple(dst_tuple);
+        ++num_to_commit;
+      }
+
+      if (done_column >= 0) {
+        assemble_rows_timer_.Stop();
+        COUNTER_ADD(scan_node_->rows_read_counter(), num_rows);
+        RETURN_IF_ERROR(CommitRows(num_to_commit));
+
+        // If we reach this point, it means that we reached the end of file for
+        // this column. Test if the expected number of rows from metadata matches
+        // the actual number of rows in the file.
+        rows_read += num_rows;
+        if (rows_read != expected_rows_in_group) {
+          HdfsParquetScanner::BaseColumnReader* reader = column_readers_[done_column];
+          DCHECK_NOTNULL(reader->stream_);
+
+          ErrorMsg msg(TErrorCode::PARQUET_GROUP_ROW_COUNT_ERROR,
+             reader->stream_->filename(), row_group_idx,
+             expected_rows_in_group, rows_read);
+          LOG_OR_RETURN_ON_ERROR(msg, scan_node_->runtime_state());
+        }
+        return parse_status_;
       }
     } else {
       // Special case when there is no data for the accessed column(s) in the file.
@@ -963,33 +1220,9 @@ Status HdfsParquetScanner::ProcessFooter(bool* eosr) {
           "footer: $1 bytes. File size: $2 bytes.", stream_->filename(), metadata_size,
           file_desc->file_length));
     }
-    // IoMgr can only do a fixed size Read(). The metadata could be larger
-    // so we stitch it here.
-    // TODO: consider moving this stitching into the scanner context. The scanner
-    // context usually handles the stitching but no other scanner need this logic
-    // now.
     metadata_buffer.resize(metadata_size);
     metadata_ptr = &metadata_buffer[0];
-    int64_t copy_offset = 0;
-    DiskIoMgr* io_mgr = scan_node_->runtime_state()->io_mgr();
-
-    while (metadata_bytes_to_read > 0) {
-      int64_t to_read = ::min(static_cast<int64_t>(io_mgr->max_read_buffer_size()),
-          metadata_bytes_to_read);
-      DiskIoMgr::ScanRange* range = scan_node_->AllocateScanRange(
-          metadata_range_->fs(), metadata_range_->file(), to_read,
-          metadata_start + copy_offset, -1, metadata_range_->disk_id(),
-          metadata_range_->try_cache(), metadata_range_->expected_local());
-
-      DiskIoMgr::BufferDescriptor* io_buffer = NULL;
-      RETURN_IF_ERROR(io_mgr->Read(scan_node_->reader_context(), range, &io_buffer));
-      memcpy(metadata_ptr + copy_offset, io_buffer->buffer(), io_buffer->len());
-      io_buffer->Return();
-
-      metadata_bytes_to_read -= to_read;
-      copy_offset += to_read;
-    }
-    DCHECK_EQ(metadata_bytes_to_read, 0);
+    RETURN_IF_ERROR(ReadFileBytes(metadata_start, metadata_bytes_to_read, metadata_ptr));
   }
   // Deserialize file header
   // TODO: this takes ~7ms for a 1000-column table, figure out how to reduce this.
@@ -1044,6 +1277,31 @@ Status HdfsParquetScanner::ProcessFooter(bool* eosr) {
   return Status::OK;
 }
 
+Status HdfsParquetScanner::ReadFileBytes(int64_t offset, int64_t len, uint8_t* buffer) {
+  // IoMgr can only do a fixed size Read(). The data could be larger so we stitch it
+  // here.
+  // TODO: consider moving this stitching into the scanner context. The scanner
+  // context usually handles the stitching but no other scanner need this logic
+  // now.
+  DiskIoMgr* io_mgr = scan_node_->runtime_state()->io_mgr();
+  int64_t copy_offset = 0;
+  while (copy_offset < len) {
+    int64_t to_read = ::min(static_cast<int64_t>(io_mgr->max_read_buffer_size()),
+        len - copy_offset);
+    DiskIoMgr::ScanRange* range = scan_node_->AllocateScanRange(
+        metadata_range_->fs(), metadata_range_->file(), to_read,
+        offset + copy_offset, -1, metadata_range_->disk_id(),
+        metadata_range_->try_cache(), metadata_range_->expected_local());
+
+    DiskIoMgr::BufferDescriptor* io_buffer = NULL;
+    RETURN_IF_ERROR(io_mgr->Read(scan_node_->reader_context(), range, &io_buffer));
+    memcpy(buffer + copy_offset, io_buffer->buffer(), io_buffer->len());
+    io_buffer->Return();
+    copy_offset += to_read;
+  }
+  return Status::OK;
+}
+
 Status HdfsParquetScanner::CreateColumnReaders() {
   DCHECK(column_readers_.empty());
   for (int i = 0; i < scan_node_->materialized_slots().size(); ++i) {
@@ -1082,11 +1340,390 @@ Status HdfsParquetScanner::CreateColumnReaders() {
     }
     node->slot_desc = slot_desc;
 
-    column_readers_.push_back(CreateReader(*node));
+    BaseColumnReader* reader = CreateReader(*node);
+    if (FLAGS_parquet_dictionary_filtering && reader->SupportsDictFilter()) {
+      reader->dict_filter_conjunct_ctxs_ =
+          GetDictFilterConjuncts(conjunct_ctxs_, slot_desc->id());
+    }
+    // The page indexes locate pages by the index of their first row, which is only the
+    // index of their first value for flat columns.
+    if (FLAGS_parquet_index_filtering && node->max_rep_level == 0 &&
+        reader->SupportsIndexFilter()) {
+      GetIndexPredicates(slot_desc, &reader->index_predicates_);
+    }
+    column_readers_.push_back(reader);
+  }
+  return Status::OK;
+}
+
+vector<ExprContext*> HdfsParquetScanner::GetDictFilterConjuncts(
+    const vector<ExprContext*>& conjunct_ctxs, SlotId slot_id) {
+  vector<ExprContext*> result;
+  vector<SlotId> slot_ids;
+  for (int i = 0; i < conjunct_ctxs.size(); ++i) {
+    // The conjuncts are evaluated once per dictionary entry instead of once per row,
+    // which is only equivalent if they always return the same result for a value.
+    if (!conjunct_ctxs[i]->root()->IsDeterministic()) continue;
+    slot_ids.clear();
+    if (conjunct_ctxs[i]->root()->GetSlotIds(&slot_ids) == 0) continue;
+    bool single_slot = true;
+    for (int j = 0; j < slot_ids.size(); ++j) {
+      if (slot_ids[j] != slot_id) {
+        single_slot = false;
+        break;
+      }
+    }
+    if (single_slot) result.push_back(conjunct_ctxs[i]);
+  }
+  return result;
+}
+
+// Returns true if all the data pages of the column chunk are dictionary encoded, i.e.
+// every non-NULL value in the chunk is an entry of the dictionary.
+static bool IsDictionaryEncoded(const parquet::ColumnMetaData& col_metadata) {
+  if (!col_metadata.__isset.dictionary_page_offset) return false;
+  bool has_dict_encoding = false;
+  for (int i = 0; i < col_metadata.encodings.size(); ++i) {
+    if (col_metadata.encodings[i] == parquet::Encoding::PLAIN) return false;
+    if (col_metadata.encodings[i] == parquet::Encoding::PLAIN_DICTIONARY) {
+      has_dict_encoding = true;
+    }
+  }
+  return has_dict_encoding;
+}
+
+Status HdfsParquetScanner::EvalDictionaryFilters(int row_group_idx,
+    bool* skip_row_group) {
+  *skip_row_group = false;
+  const parquet::RowGroup& row_group = file_metadata_.row_groups[row_group_idx];
+  for (int i = 0; i < column_readers_.size(); ++i) {
+    BaseColumnReader* reader = column_readers_[i];
+    if (!reader->HasDictFilter()) continue;
+    if (!IsDictionaryEncoded(row_group.columns[reader->col_idx()].meta_data)) continue;
+    // The dictionary page comes first in the column chunk. Reading the first data page
+    // now loads the dictionary and evaluates the conjuncts against it.
+    RETURN_IF_ERROR(reader->ReadDataPage());
+    if (reader->dict_filter_rejects_all_) {
+      VLOG_FILE << "Skipping row group " << row_group_idx << " of file "
+                << metadata_range_->file() << ": no dictionary entry of column "
+                << reader->col_idx() << " passes the conjuncts.";
+      *skip_row_group = true;
+      return Status::OK;
+    }
+  }
+  return Status::OK;
+}
+
+// Encodes the slot value 'value' of type 'type' with ParquetIndexEncoder.
+static void EncodeIndexValue(const ColumnType& type, const void* value, string* out) {
+  int fixed_len_size = ParquetPlainEncoder::ByteSize(type);
+  switch (type.type) {
+    case TYPE_TINYINT:
+      ParquetIndexEncoder::Encode(fixed_len_size,
+          *reinterpret_cast<const int8_t*>(value), out);
+      break;
+    case TYPE_SMALLINT:
+      ParquetIndexEncoder::Encode(fixed_len_size,
+          *reinterpret_cast<const int16_t*>(value), out);
+      break;
+    case TYPE_INT:
+      ParquetIndexEncoder::Encode(fixed_len_size,
+          *reinterpret_cast<const int32_t*>(value), out);
+      break;
+    case TYPE_BIGINT:
+      ParquetIndexEncoder::Encode(fixed_len_size,
+          *reinterpret_cast<const int64_t*>(value), out);
+      break;
+    case TYPE_FLOAT:
+      ParquetIndexEncoder::Encode(fixed_len_size,
+          *reinterpret_cast<const float*>(value), out);
+      break;
+    case TYPE_DOUBLE:
+      ParquetIndexEncoder::Encode(fixed_len_size,
+          *reinterpret_cast<const double*>(value), out);
+      break;
+    case TYPE_TIMESTAMP:
+      ParquetIndexEncoder::Encode(fixed_len_size,
+          *reinterpret_cast<const TimestampValue*>(value), out);
+      break;
+    case TYPE_STRING:
+      ParquetIndexEncoder::Encode(fixed_len_size,
+          *reinterpret_cast<const StringValue*>(value), out);
+      break;
+    case TYPE_DECIMAL:
+      switch (type.GetByteSize()) {
+        case 4:
+          ParquetIndexEncoder::Encode(fixed_len_size,
+              *reinterpret_cast<const Decimal4Value*>(value), out);
+          break;
+        case 8:
+          ParquetIndexEncoder::Encode(fixed_len_size,
+              *reinterpret_cast<const Decimal8Value*>(value), out);
+          break;
+        case 16:
+          ParquetIndexEncoder::Encode(fixed_len_size,
+              *reinterpret_cast<const Decimal16Value*>(value), out);
+          break;
+        default:
+          DCHECK(false);
+      }
+      break;
+    default:
+      DCHECK(false);
+  }
+}
+
+void HdfsParquetScanner::GetIndexPredicates(const SlotDescriptor* slot_desc,
+    vector<IndexPredicate>* predicates) {
+  for (int i = 0; i < conjunct_ctxs_.size(); ++i) {
+    ExprContext* ctx = conjunct_ctxs_[i];
+    Expr* root = ctx->root();
+    const string& fn_name = root->builtin_fn_name();
+    if (fn_name.empty()) continue;
+
+    // Recognize <slot> <op> <constant>, <constant> <op> <slot> and
+    // <slot> IN (<constants>). The FE analyzes 'null_matching_eq' (IS NOT DISTINCT
+    // FROM) into the 'eq' builtin, so both arrive here as 'eq'. They only differ for
+    // NULL constants, which are not used below.
+    IndexPredicate pred;
+    int slot_child = 0;
+    if (fn_name == "in_iterate" || fn_name == "in_set_lookup") {
+      pred.op = IndexPredicate::IN;
+    } else if (root->GetNumChildren() == 2) {
+      if (fn_name == "eq") {
+        pred.op = IndexPredicate::EQ;
+      } else if (fn_name == "lt") {
+        pred.op = IndexPredicate::LT;
+      } else if (fn_name == "le") {
+        pred.op = IndexPredicate::LE;
+      } else if (fn_name == "gt") {
+        pred.op = IndexPredicate::GT;
+      } else if (fn_name == "ge") {
+        pred.op = IndexPredicate::GE;
+      } else {
+        continue;
+      }
+      if (!root->GetChild(0)->is_slotref()) {
+        // Normalize to <slot> <op> <constant>.
+        slot_child = 1;
+        if (pred.op == IndexPredicate::LT) {
+          pred.op = IndexPredicate::GT;
+        } else if (pred.op == IndexPredicate::LE) {
+          pred.op = IndexPredicate::GE;
+        } else if (pred.op == IndexPredicate::GT) {
+          pred.op = IndexPredicate::LT;
+        } else if (pred.op == IndexPredicate::GE) {
+          pred.op = IndexPredicate::LE;
+        }
+      }
+    } else {
+      continue;
+    }
+
+    Expr* slot_expr = root->GetChild(slot_child);
+    if (!slot_expr->is_slotref()) continue;
+    if (static_cast<SlotRef*>(slot_expr)->slot_id() != slot_desc->id()) continue;
+
+    bool usable = true;
+    for (int j = 0; j < root->GetNumChildren(); ++j) {
+      if (j == slot_child) continue;
+      Expr* child = root->GetChild(j);
+      if (!child->IsConstant() || child->type() != slot_desc->type()) {
+        usable = false;
+        break;
+      }
+      void* value = ctx->GetConstantValue(child);
+      if (value == NULL) {
+        // A NULL in an IN list never matches. '<slot> = NULL' never matches either,
+        // but it may be a 'null_matching_eq' that matches the NULLs of the column, so
+        // don't use comparisons with NULL.
+        if (pred.op == IndexPredicate::IN) continue;
+        usable = false;
+        break;
+      }
+      pred.values.push_back(string());
+      EncodeIndexValue(slot_desc->type(), value, &pred.values.back());
+    }
+    ctx->FreeLocalAllocations();
+    if (usable) predicates->push_back(pred);
+  }
+}
+
+bool HdfsParquetScanner::BaseColumnReader::BloomFilterMayMatch(
+    const BloomFilter& filter) const {
+  // The bloom filter is over the encoded values, which differ for equal floating point
+  // values (0.0 and -0.0).
+  PrimitiveType type = slot_desc()->type().type;
+  if (type == TYPE_FLOAT || type == TYPE_DOUBLE) return true;
+  for (int i = 0; i < index_predicates_.size(); ++i) {
+    const IndexPredicate& pred = index_predicates_[i];
+    if (pred.op != IndexPredicate::EQ && pred.op != IndexPredicate::IN) continue;
+    bool found = false;
+    for (int j = 0; j < pred.values.size() && !found; ++j) {
+      found = filter.Find(ParquetIndexEncoder::Hash(pred.values[j]));
+    }
+    if (!found) return false;
+  }
+  return true;
+}
+
+// Returns the location of the bloom filter of the column chunk from its key-value
+// metadata. Returns false if the chunk has no bloom filter.
+static bool GetBloomFilterLocation(const parquet::ColumnMetaData& col_metadata,
+    int64_t* offset, int64_t* len) {
+  bool has_offset = false;
+  bool has_len = false;
+  for (int i = 0; i < col_metadata.key_value_metadata.size(); ++i) {
+    const parquet::KeyValue& kv = col_metadata.key_value_metadata[i];
+    if (!kv.__isset.value) continue;
+    StringParser::ParseResult result;
+    if (kv.key == PARQUET_BLOOM_FILTER_OFFSET_KEY) {
+      *offset = StringParser::StringToInt<int64_t>(
+          kv.value.data(), kv.value.size(), &result);
+      has_offset = result == StringParser::PARSE_SUCCESS;
+    } else if (kv.key == PARQUET_BLOOM_FILTER_LENGTH_KEY) {
+      *len = StringParser::StringToInt<int64_t>(
+          kv.value.data(), kv.value.size(), &result);
+      has_len = result == StringParser::PARSE_SUCCESS;
+    }
+  }
+  return has_offset && has_len;
+}
+
+// Returns the rows that are in both 'a' and 'b'. Both must be sorted and
+// non-overlapping.
+static vector<pair<int64_t, int64_t> > IntersectRowRanges(
+    const vector<pair<int64_t, int64_t> >& a, const vector<pair<int64_t, int64_t> >& b) {
+  vector<pair<int64_t, int64_t> > result;
+  int i = 0;
+  int j = 0;
+  while (i < a.size() && j < b.size()) {
+    int64_t first = max(a[i].first, b[j].first);
+    int64_t last = min(a[i].second, b[j].second);
+    if (first < last) result.push_back(make_pair(first, last));
+    if (a[i].second < b[j].second) {
+      ++i;
+    } else {
+      ++j;
+    }
+  }
+  return result;
+}
+
+Status HdfsParquetScanner::EvalIndexFilters(int row_group_idx, bool* skip_row_group) {
+  *skip_row_group = false;
+  candidate_row_ranges_.clear();
+  const HdfsFileDesc* file_desc = scan_node_->GetFileDesc(metadata_range_->file());
+  DCHECK_NOTNULL(file_desc);
+  const parquet::RowGroup& row_group = file_metadata_.row_groups[row_group_idx];
+  vector<RowRange> row_ranges(1, RowRange(0, row_group.num_rows));
+  vector<uint8_t> buffer;
+
+  for (int i = 0; i < column_readers_.size(); ++i) {
+    BaseColumnReader* reader = column_readers_[i];
+    if (reader->index_predicates_.empty()) continue;
+    // first_row_index and the row ranges below count values, see CreateColumnReaders().
+    DCHECK_EQ(reader->max_rep_level(), 0);
+    // The index values are decoded based on the slot type.
+    RETURN_IF_ERROR(ValidateColumn(*reader, row_group_idx));
+    const parquet::ColumnChunk& col_chunk = row_group.columns[reader->col_idx()];
+
+    int64_t bloom_offset, bloom_len;
+    if (GetBloomFilterLocation(col_chunk.meta_data, &bloom_offset, &bloom_len) &&
+        bloom_offset >= 0 && bloom_len > 0 &&
+        bloom_offset + bloom_len <= file_desc->file_length) {
+      buffer.resize(bloom_len);
+      RETURN_IF_ERROR(ReadFileBytes(bloom_offset, bloom_len, &buffer[0]));
+      BloomFilter filter(0);
+      if (BloomFilter::Deserialize(&buffer[0], bloom_len, &filter) &&
+          !reader->BloomFilterMayMatch(filter)) {
+        VLOG_FILE << "Skipping row group " << row_group_idx << " of file "
+                  << metadata_range_->file() << ": rejected by the bloom filter of "
+                  << "column " << reader->col_idx();
+        COUNTER_ADD(num_bloom_filtered_row_groups_counter_, 1);
+        *skip_row_group = true;
+        return Status::OK;
+      }
+    }
+
+    if (!col_chunk.__isset.column_index_offset ||
+        !col_chunk.__isset.offset_index_offset ||
+        col_chunk.column_index_length <= 0 || col_chunk.offset_index_length <= 0 ||
+        col_chunk.column_index_offset + col_chunk.column_index_length >
+            file_desc->file_length ||
+        col_chunk.offset_index_offset + col_chunk.offset_index_length >
+            file_desc->file_length) {
+      continue;
+    }
+    parquet::ColumnIndex column_index;
+    parquet::OffsetIndex offset_index;
+    uint32_t len = col_chunk.column_index_length;
+    buffer.resize(len);
+    RETURN_IF_ERROR(ReadFileBytes(col_chunk.column_index_offset, len, &buffer[0]));
+    RETURN_IF_ERROR(DeserializeThriftMsg(&buffer[0], &len, true, &column_index));
+    len = col_chunk.offset_index_length;
+    buffer.resize(len);
+    RETURN_IF_ERROR(ReadFileBytes(col_chunk.offset_index_offset, len, &buffer[0]));
+    RETURN_IF_ERROR(DeserializeThriftMsg(&buffer[0], &len, true, &offset_index));
+
+    const vector<parquet::PageLocation>& pages = offset_index.page_locations;
+    if (column_index.null_pages.size() != pages.size() ||
+        column_index.min_values.size() != pages.size() ||
+        column_index.max_values.size() != pages.size()) {
+      VLOG_FILE << "Ignoring invalid page index of column " << reader->col_idx()
+                << " in file " << metadata_range_->file();
+      continue;
+    }
+
+    // Collect the rows of the pages that may match.
+    vector<RowRange> column_ranges;
+    for (int p = 0; p < pages.size(); ++p) {
+      // Conjuncts are never true for NULLs, so pages with only NULLs never match.
+      if (column_index.null_pages[p]) continue;
+      if (!reader->PageMayMatch(column_index.min_values[p],
+          column_index.max_values[p])) {
+        continue;
+      }
+      int64_t first_row = pages[p].first_row_index;
+      int64_t last_row = p + 1 < pages.size() ?
+          pages[p + 1].first_row_index : row_group.num_rows;
+      if (!column_ranges.empty() && column_ranges.back().second == first_row) {
+        column_ranges.back().second = last_row;
+      } else {
+        column_ranges.push_back(RowRange(first_row, last_row));
+      }
+    }
+    row_ranges = IntersectRowRanges(row_ranges, column_ranges);
+    if (row_ranges.empty()) {
+      VLOG_FILE << "Skipping row group " << row_group_idx << " of file "
+                << metadata_range_->file() << ": no page of column "
+                << reader->col_idx() << " can match.";
+      COUNTER_ADD(num_page_index_filtered_row_groups_counter_, 1);
+      *skip_row_group = true;
+      return Status::OK;
+    }
+  }
+
+  if (row_ranges.size() != 1 || row_ranges[0].first != 0 ||
+      row_ranges[0].second != row_group.num_rows) {
+    candidate_row_ranges_.swap(row_ranges);
   }
   return Status::OK;
 }
 
+// Returns true if 'range' ends at or before 'row'.
+static bool RangeEndsBefore(const pair<int64_t, int64_t>& range, int64_t row) {
+  return range.second <= row;
+}
+
+bool HdfsParquetScanner::RowsMayMatch(int64_t first_row, int64_t num_rows) const {
+  if (candidate_row_ranges_.empty()) return true;
+  // Find the first candidate range that ends after first_row.
+  vector<RowRange>::const_iterator it = lower_bound(candidate_row_ranges_.begin(),
+      candidate_row_ranges_.end(), first_row, RangeEndsBefore);
+  return it != candidate_row_ranges_.end() && it->first < first_row + num_rows;
+}
+
 Status HdfsParquetScanner::InitColumns(int row_group_idx) {
   const HdfsFileDesc* file_desc = scan_node_->GetFileDesc(metadata_range_->file());
   DCHECK_NOTNULL(file_desc);
@@ -1173,14 +1810,15 @@ Status HdfsParquetScanner::InitColumns(int row_group_idx) {
 Status HdfsParquetScanner::CreateSchemaTree(const vector<parquet::SchemaElement>& schema,
     HdfsParquetScanner::SchemaNode* node) const {
   int max_def_level = 0;
+  int max_rep_level = 0;
   int idx = 0;
   int col_idx = 0;
-  return CreateSchemaTree(schema, max_def_level, &idx, &col_idx, node);
+  return CreateSchemaTree(schema, max_def_level, max_rep_level, &idx, &col_idx, node);
 }
 
 Status HdfsParquetScanner::CreateSchemaTree(
-    const vector<parquet::SchemaElement>& schema, int max_def_level, int* idx,
-    int* col_idx, HdfsParquetScanner::SchemaNode* node) const {
+    const vector<parquet::SchemaElement>& schema, int max_def_level, int max_rep_level,
+    int* idx, int* col_idx, HdfsParquetScanner::SchemaNode* node) const {
   if (*idx >= schema.size()) {
     return Status(Substitute("File $0 corrupt: could not reconstruct schema tree from "
             "flattened schema in file metadata", stream_->filename()));
@@ -1197,13 +1835,18 @@ Status HdfsParquetScanner::CreateSchemaTree(
 
   if (node->element->repetition_type == parquet::FieldRepetitionType::OPTIONAL) {
     ++max_def_level;
+  } else if (node->element->repetition_type ==
+      parquet::FieldRepetitionType::REPEATED) {
+    ++max_rep_level;
   }
   node->max_def_level = max_def_level;
+  node->max_rep_level = max_rep_level;
 
   node->children.resize(node->element->num_children);
   for (int i = 0; i < node->element->num_children; ++i) {
     RETURN_IF_ERROR(
-        CreateSchemaTree(schema, max_def_level, idx, col_idx, &node->children[i]));
+        CreateSchemaTree(schema, max_def_level, max_rep_level, idx, col_idx,
+            &node->children[i]));
   }
   return Status::OK;
 }
@@ -1445,7 +2088,8 @@ string HdfsParquetScanner::SchemaNode::DebugString(int indent) const {
   } else {
     ss << PrintParquetType(element->type);
   }
-  ss << " " << element->name << " [i:" << col_idx << " d:" << max_def_level << "]";
+  ss << " " << element->name << " [i:" << col_idx << " d:" << max_def_level
+     << " r:" << max_rep_level << "]";
   if (element->num_children > 0) {
     ss << " {" << endl;
     for (int i = 0; i < element->num_children; ++i) {
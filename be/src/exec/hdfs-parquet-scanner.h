@@ -54,6 +54,11 @@ class HdfsParquetScanner : public HdfsScanner {
   static Status IssueInitialRanges(HdfsScanNode* scan_node,
                                    const std::vector<HdfsFileDesc*>& files);
 
+  // Returns the deterministic conjuncts from 'conjunct_ctxs' that reference slot_id and
+  // no other slot. These can be evaluated against the dictionary of that slot's column.
+  static std::vector<ExprContext*> GetDictFilterConjuncts(
+      const std::vector<ExprContext*>& conjunct_ctxs, SlotId slot_id);
+
   struct FileVersion {
     // Application that wrote the file. e.g. "IMPALA"
     std::string application;
@@ -99,15 +104,31 @@ class HdfsParquetScanner : public HdfsScanner {
     // corresponds to a non-NULL value. Valid values are >= 0.
     int max_def_level;
 
+    // The maximum repetition level of this column, i.e. the number of repeated nodes on
+    // its path. 0 for flat columns, whose values correspond one to one to rows.
+    int max_rep_level;
+
     // Any nested schema nodes. Empty for non-nested types.
     std::vector<SchemaNode> children;
 
     SlotDescriptor* slot_desc;
 
-    SchemaNode() : col_idx(-1), max_def_level(-1), slot_desc(NULL) { }
+    SchemaNode() : col_idx(-1), max_def_level(-1), max_rep_level(-1), slot_desc(NULL) { }
     std::string DebugString(int indent = 0) const;
   };
 
+  // A conjunct of the form <slot> <op> <constant> or <slot> IN (<constants>) that can
+  // be evaluated against page indexes and bloom filters. The constants are encoded
+  // with ParquetIndexEncoder.
+  struct IndexPredicate {
+    enum Op { EQ, LT, LE, GT, GE, IN };
+    Op op;
+    std::vector<std::string> values;
+  };
+
+  // A range [first, last) of rows of a row group.
+  typedef std::pair<int64_t, int64_t> RowRange;
+
   // Size of the file footer.  This is a guess.  If this value is too little, we will
   // need to issue another read.
   static const int FOOTER_SIZE = 100 * 1024;
@@ -146,9 +167,30 @@ class HdfsParquetScanner : public HdfsScanner {
   // Timer for materializing rows.  This ignores time getting the next buffer.
   ScopedTimer<MonotonicStopWatch> assemble_rows_timer_;
 
+  // Set by AssembleRows() for the tuples of the current batch that failed a conjunct
+  // evaluated by a column reader. Sized to the batch capacity in Prepare().
+  std::vector<uint8_t> conjuncts_failed_;
+
   // Number of cols that need to be read.
   RuntimeProfile::Counter* num_cols_counter_;
 
+  // Number of row groups skipped because no dictionary entry passed the conjuncts.
+  RuntimeProfile::Counter* num_dict_filtered_row_groups_counter_;
+
+  // Number of row groups skipped because of their columns' bloom filters.
+  RuntimeProfile::Counter* num_bloom_filtered_row_groups_counter_;
+
+  // Number of row groups skipped because no page of a column could match.
+  RuntimeProfile::Counter* num_page_index_filtered_row_groups_counter_;
+
+  // Number of data pages that were skipped without being decompressed or decoded.
+  RuntimeProfile::Counter* num_page_index_skipped_pages_counter_;
+
+  // Ranges of rows of the current row group that may pass the conjuncts according to
+  // the page indexes, sorted and non-overlapping. Data pages that don't overlap any of
+  // these ranges are skipped. Empty if all rows may pass.
+  std::vector<RowRange> candidate_row_ranges_;
+
   // Reads data from all the columns (in parallel) and assembles rows into the context
   // object. Returns when the entire row group is complete or an error occurred.
   Status AssembleRows(int row_group_idx);
@@ -173,6 +215,31 @@ class HdfsParquetScanner : public HdfsScanner {
   // initializes column_readers_ and issues the reads for the columns.
   Status InitColumns(int row_group_idx);
 
+
+  // Loads the dictionaries of the columns with dictionary filter conjuncts whose chunks
+  // in this row group are entirely dictionary encoded. Sets *skip_row_group to true if
+  // any of them has no entry (or NULL) that can pass the conjuncts, in which case no
+  // row in the row group can pass. Must be called after InitColumns().
+  Status EvalDictionaryFilters(int row_group_idx, bool* skip_row_group);
+
+  // Returns the conjuncts from conjunct_ctxs_ on slot_desc's slot that can be evaluated
+  // against page indexes and bloom filters.
+  void GetIndexPredicates(const SlotDescriptor* slot_desc,
+      std::vector<IndexPredicate>* predicates);
+
+  // Evaluates the index predicates of the column readers against the bloom filters
+  // and page indexes of the row group, if the file has them. Sets *skip_row_group to
+  // true if no row can pass, and otherwise populates candidate_row_ranges_. Must be
+  // called before InitColumns() so that skipped row groups are not read at all.
+  Status EvalIndexFilters(int row_group_idx, bool* skip_row_group);
+
+  // Returns false if [first_row, first_row + num_rows) of the current row group doesn't
+  // overlap candidate_row_ranges_.
+  bool RowsMayMatch(int64_t first_row, int64_t num_rows) const;
+
+  // Reads 'len' bytes at 'offset' of the file of metadata_range_ into 'buffer'.
+  Status ReadFileBytes(int64_t offset, int64_t len, uint8_t* buffer);
+
   // Validates the file metadata
   Status ValidateFileMetadata();
 
@@ -191,7 +258,8 @@ class HdfsParquetScanner : public HdfsScanner {
 
   // Recursive implementation used internally by the above CreateSchemaTree() function.
   Status CreateSchemaTree(const std::vector<parquet::SchemaElement>& schema,
-      int max_def_level, int* idx, int* col_idx, SchemaNode* node) const;
+      int max_def_level, int max_rep_level, int* idx, int* col_idx,
+      SchemaNode* node) const;
 };
 
 } // namespace impala
@@ -14,6 +14,11 @@
 
 #include "exec/hdfs-parquet-table-writer.h"
 
+#include <boost/algorithm/string.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/locks.hpp>
+#include <gflags/gflags.h>
+
 #include "common/version.h"
 #include "exprs/expr.h"
 #include "exprs/expr-context.h"
@@ -24,14 +29,17 @@
 #include "runtime/string-value.inline.h"
 #include "util/bit-stream-utils.h"
 #include "util/bit-util.h"
+#include "util/bloom-filter.h"
 #include "util/buffer-builder.h"
 #include "util/compress.h"
 #include "util/debug-util.h"
 #include "util/dict-encoding.h"
 #include "util/hdfs-util.h"
 #include "util/rle-encoding.h"
+#include "util/thread-pool.h"
 #include "rpc/thrift-util.h"
 
+#include <limits>
 #include <sstream>
 
 #include "gen-cpp/ImpalaService_types.h"
@@ -52,6 +60,33 @@ using namespace apache::thrift;
 // The current buffered pages (one for each column) can have a very poor estimate.
 // To adjust for this, we aim for a slightly smaller file size than the ideal.
 
+// Encoding and compressing the columns of a row batch are independent of each other.
+// If parquet_writer_threads > 1, the columns are appended in parallel on a thread
+// pool shared by all Parquet writers of this process. Each column writer owns its
+// memory pools and buffers, so the only shared state is the file size estimate.
+DEFINE_int32(parquet_writer_threads, 0, "Number of threads used by the Parquet "
+    "writers of this process to encode and compress columns in parallel. 0 or 1 "
+    "encodes all columns on the fragment thread.");
+DEFINE_int32(debug_parquet_writer_fail_column, -1, "Debug flag. If >= 0, the parallel "
+    "Parquet writer fails to append the column with this index, to test how errors of "
+    "the column threads are reported.");
+
+// Page indexes (per page min/max values and page locations) and bloom filters let
+// readers skip the pages and row groups that cannot match point and range
+// predicates. Both are written after the column chunks of each row group.
+DEFINE_bool(parquet_write_page_index, false, "When true, the Parquet writer writes a "
+    "ColumnIndex and an OffsetIndex for every column chunk.");
+DEFINE_string(parquet_bloom_filter_columns, "", "Comma-separated list of column names "
+    "for which the Parquet writer writes a bloom filter per column chunk. Intended for "
+    "high-cardinality columns that are used in equality and IN predicates.");
+DEFINE_int32(parquet_bloom_filter_max_bytes, 1024 * 1024, "Maximum size in bytes of "
+    "a Parquet bloom filter. Filters are folded to a smaller size when there are few "
+    "distinct values.");
+
+// Bloom filters are folded while at most this fraction of their bits are set. Each
+// value sets 8 bits, so this gives a false positive probability of about 0.5^8.
+static const double BLOOM_FILTER_MAX_FILL = 0.5;
+
 // The maximum entries in the dictionary before giving up and switching to
 // plain encoding.
 // TODO: more complicated heuristic?
@@ -96,13 +131,21 @@ class HdfsParquetTableWriter::BaseColumnWriter {
       total_uncompressed_byte_size_(0),
       dict_encoder_base_(NULL),
       def_levels_(NULL),
-      values_buffer_len_(DEFAULT_DATA_PAGE_SIZE) {
+      values_buffer_len_(DEFAULT_DATA_PAGE_SIZE),
+      thrift_serializer_(new ThriftSerializer(true)),
+      reusable_mem_pool_(new MemPool(parent_->parent_->mem_tracker())),
+      per_file_mem_pool_(new MemPool(parent_->parent_->mem_tracker())),
+      compress_timer_(TUnit::TIME_NS),
+      append_status_(Status::OK),
+      write_page_index_(FLAGS_parquet_write_page_index),
+      column_index_valid_(false),
+      bloom_filter_log_num_blocks_(-1) {
     Codec::CreateCompressor(NULL, false, codec, &compressor_);
 
     def_levels_ = parent_->state_->obj_pool()->Add(
-        new RleEncoder(parent_->reusable_col_mem_pool_->Allocate(DEFAULT_DATA_PAGE_SIZE),
+        new RleEncoder(reusable_mem_pool_->Allocate(DEFAULT_DATA_PAGE_SIZE),
                        DEFAULT_DATA_PAGE_SIZE, 1));
-    values_buffer_ = parent_->reusable_col_mem_pool_->Allocate(values_buffer_len_);
+    values_buffer_ = reusable_mem_pool_->Allocate(values_buffer_len_);
   }
 
   virtual ~BaseColumnWriter() {}
@@ -115,6 +158,12 @@ class HdfsParquetTableWriter::BaseColumnWriter {
   // would also solve this problem.
   Status AppendRow(TupleRow* row);
 
+  // Appends rows [start_row, end_row) of batch to this column. If row_group_indices is
+  // not empty, it maps the row numbers to the rows in the batch. Called from the
+  // column thread pool; the status is returned in append_status_.
+  void AppendRows(RowBatch* batch, const vector<int32_t>& row_group_indices,
+      int start_row, int end_row);
+
   // Flushes all buffered data pages to the file.
   // *file_pos is an output parameter and will be incremented by
   // the number of bytes needed to write all the data pages for this column.
@@ -134,6 +183,15 @@ class HdfsParquetTableWriter::BaseColumnWriter {
     num_values_ = 0;
     total_compressed_byte_size_ = 0;
     current_encoding_ = Encoding::PLAIN;
+    plain_pages_written_ = false;
+    column_index_valid_ = write_page_index_;
+    column_index_ = ColumnIndex();
+    column_index_.boundary_order = BoundaryOrder::UNORDERED;
+    column_index_.__set_null_counts(vector<int64_t>());
+    offset_index_.page_locations.clear();
+    if (bloom_filter_log_num_blocks_ >= 0) {
+      bloom_filter_.reset(new BloomFilter(bloom_filter_log_num_blocks_));
+    }
   }
 
   // Close this writer. This is only called after Flush() and no more rows will
@@ -141,6 +199,18 @@ class HdfsParquetTableWriter::BaseColumnWriter {
   void Close() {
     if (compressor_.get() != NULL) compressor_->Close();
     if (dict_encoder_base_ != NULL) dict_encoder_base_->ClearIndices();
+    reusable_mem_pool_->FreeAll();
+    per_file_mem_pool_->FreeAll();
+    compression_staging_buffer_.clear();
+  }
+
+  // Releases the memory allocated for the previous file.
+  void ClearPerFileMemory() { per_file_mem_pool_->Clear(); }
+
+  // Adds the time spent compressing since the last call to the sink's profile.
+  void UpdateCompressTimer() {
+    COUNTER_ADD(parent_->parent_->compress_timer(), compress_timer_.value());
+    compress_timer_.Set(0L);
   }
 
   const ColumnType& type() const { return expr_ctx_->root()->type(); }
@@ -150,6 +220,19 @@ class HdfsParquetTableWriter::BaseColumnWriter {
   parquet::CompressionCodec::type codec() const {
     return IMPALA_TO_PARQUET_CODEC[codec_];
   }
+  bool plain_pages_written() const { return plain_pages_written_; }
+
+  // Makes this column write a bloom filter of at most 'max_bytes' per column chunk.
+  void EnableBloomFilter(int64_t max_bytes) {
+    int64_t num_blocks = max<int64_t>(max_bytes / BloomFilter::BYTES_PER_BLOCK, 1);
+    // Round down to a power of two.
+    bloom_filter_log_num_blocks_ = BitUtil::Log2(num_blocks + 1) - 1;
+  }
+
+  // Writes the page index and bloom filter of the current row group, if any, and
+  // records their locations in 'col_chunk'. Must be called after Flush() and before
+  // Reset().
+  Status WriteIndexes(int64_t* file_pos, ColumnChunk* col_chunk);
 
  protected:
   friend class HdfsParquetTableWriter;
@@ -162,6 +245,12 @@ class HdfsParquetTableWriter::BaseColumnWriter {
   // Implemented in the subclass.
   virtual bool EncodeValue(void* value, int64_t* bytes_needed) = 0;
 
+  // Returns the encoded min and max values of the current page and resets them for
+  // the next page. Returns false if they are not known (e.g. the type has no
+  // statistics or a value that can't be ordered was seen). Only called for pages with
+  // non-NULL values.
+  virtual bool GetPageStats(string* min_value, string* max_value) { return false; }
+
   // Encodes out all data for the current page and updates the metadata.
   virtual void FinalizeCurrentPage();
 
@@ -189,6 +278,10 @@ class HdfsParquetTableWriter::BaseColumnWriter {
 
     // Number of non-null values
     int num_non_null;
+
+    // Encoded min and max values of the page. Only set if write_page_index_ is true.
+    string min_value;
+    string max_value;
   };
 
   HdfsParquetTableWriter* parent_;
@@ -218,6 +311,11 @@ class HdfsParquetTableWriter::BaseColumnWriter {
   int64_t total_uncompressed_byte_size_;
   Encoding::type current_encoding_;
 
+  // True if any data page of the current row group was PLAIN encoded. If false, the
+  // column chunk is entirely dictionary encoded, which lets readers evaluate
+  // predicates against the dictionary alone.
+  bool plain_pages_written_;
+
   // Created and set by the base class.
   DictEncoderBase* dict_encoder_base_;
 
@@ -231,6 +329,49 @@ class HdfsParquetTableWriter::BaseColumnWriter {
   uint8_t* values_buffer_;
   // The size of values_buffer_.
   int values_buffer_len_;
+
+  // The following are owned per column (rather than by the parent writer) so that
+  // columns can be encoded and compressed concurrently.
+
+  // Thrift serializer used to compute page header sizes.
+  scoped_ptr<ThriftSerializer> thrift_serializer_;
+
+  // Memory for buffers that are reused for the duration of the writer (i.e. reused
+  // across files).
+  scoped_ptr<MemPool> reusable_mem_pool_;
+
+  // Memory for pages and dictionary values that is allocated per file.  This is
+  // cleared after flushing a file.
+  scoped_ptr<MemPool> per_file_mem_pool_;
+
+  // Staging buffer to use to compress data.  This is used only if compression is
+  // enabled and is reused between all data pages.
+  vector<uint8_t> compression_staging_buffer_;
+
+  // Time spent compressing data pages, added to the sink's profile by the
+  // fragment thread (profile counters are not thread safe).
+  RuntimeProfile::Counter compress_timer_;
+
+  // Result of the last AppendRows() call.
+  Status append_status_;
+
+  // Copy of FLAGS_parquet_write_page_index, checked per value.
+  const bool write_page_index_;
+
+  // True if the statistics of all pages of the current row group are known. The page
+  // index is only written if this is true.
+  bool column_index_valid_;
+
+  // Page index of the current row group. Populated by Flush().
+  ColumnIndex column_index_;
+  OffsetIndex offset_index_;
+
+  // Log2 of the number of blocks of bloom_filter_, or -1 if this column does not
+  // write bloom filters.
+  int bloom_filter_log_num_blocks_;
+
+  // Bloom filter over the non-NULL values of the current row group.
+  scoped_ptr<BloomFilter> bloom_filter_;
 };
 
 // Per type column writer.
@@ -240,7 +381,9 @@ class HdfsParquetTableWriter::ColumnWriter :
  public:
   ColumnWriter(HdfsParquetTableWriter* parent, ExprContext* ctx,
       const THdfsCompression::type& codec) : BaseColumnWriter(parent, ctx, codec),
-      num_values_since_dict_size_check_(0) {
+      num_values_since_dict_size_check_(0),
+      page_stats_set_(false),
+      page_stats_valid_(true) {
     DCHECK_NE(ctx->root()->type().type, TYPE_BOOLEAN);
     encoded_value_size_ = ParquetPlainEncoder::ByteSize(ctx->root()->type());
   }
@@ -251,12 +394,15 @@ class HdfsParquetTableWriter::ColumnWriter :
     // it will fall back to plain.
     current_encoding_ = Encoding::PLAIN_DICTIONARY;
     dict_encoder_.reset(
-        new DictEncoder<T>(parent_->per_file_mem_pool_.get(), encoded_value_size_));
+        new DictEncoder<T>(per_file_mem_pool_.get(), encoded_value_size_));
     dict_encoder_base_ = dict_encoder_.get();
+    page_stats_set_ = false;
+    page_stats_valid_ = true;
   }
 
  protected:
   virtual bool EncodeValue(void* value, int64_t* bytes_needed) {
+    T* v = CastValue(value);
     if (current_encoding_ == Encoding::PLAIN_DICTIONARY) {
       if (UNLIKELY(num_values_since_dict_size_check_ >=
                    DICTIONARY_DATA_PAGE_SIZE_CHECK_PERIOD)) {
@@ -264,7 +410,7 @@ class HdfsParquetTableWriter::ColumnWriter :
         if (dict_encoder_->EstimatedDataEncodedSize() >= page_size_) return false;
       }
       ++num_values_since_dict_size_check_;
-      *bytes_needed = dict_encoder_->Put(*CastValue(value));
+      *bytes_needed = dict_encoder_->Put(*v);
       // If the dictionary contains the maximum number of values, switch to plain
       // encoding.  The current dictionary encoded page is written out.
       if (UNLIKELY(*bytes_needed < 0)) {
@@ -274,7 +420,6 @@ class HdfsParquetTableWriter::ColumnWriter :
       }
       parent_->file_size_estimate_ += *bytes_needed;
     } else if (current_encoding_ == Encoding::PLAIN) {
-      T* v = CastValue(value);
       *bytes_needed = encoded_value_size_ < 0 ?
           ParquetPlainEncoder::ByteSize<T>(*v) : encoded_value_size_;
       if (current_page_->header.uncompressed_page_size + *bytes_needed > page_size_) {
@@ -289,9 +434,24 @@ class HdfsParquetTableWriter::ColumnWriter :
       // TODO: support other encodings here
       DCHECK(false);
     }
+    if (bloom_filter_.get() != NULL) {
+      bloom_filter_->Insert(ParquetIndexEncoder::Hash(encoded_value_size_, *v));
+    }
+    if (write_page_index_) UpdatePageStats(*v);
     return true;
   }
 
+  virtual bool GetPageStats(string* min_value, string* max_value) {
+    bool valid = page_stats_set_ && page_stats_valid_;
+    if (valid) {
+      ParquetIndexEncoder::Encode(encoded_value_size_, page_min_, min_value);
+      ParquetIndexEncoder::Encode(encoded_value_size_, page_max_, max_value);
+    }
+    page_stats_set_ = false;
+    page_stats_valid_ = true;
+    return valid;
+  }
+
  private:
   // The period, in # of rows, to check the estimated dictionary page size against
   // the data page size. We want to start a new data page when the estimated size
@@ -314,6 +474,39 @@ class HdfsParquetTableWriter::ColumnWriter :
   // Temporary string value to hold CHAR(N)
   StringValue temp_;
 
+  // Min and max values of the current page, for the page index. page_stats_valid_ is
+  // false if a value without a defined order (e.g. NaN) was seen.
+  bool page_stats_set_;
+  bool page_stats_valid_;
+  T page_min_;
+  T page_max_;
+
+  // Backing memory for page_min_ and page_max_ for strings, since the input values
+  // don't outlive the row batch.
+  string page_min_buffer_;
+  string page_max_buffer_;
+
+  inline void UpdatePageStats(const T& v) {
+    if (UNLIKELY(!IsOrdered(v))) {
+      page_stats_valid_ = false;
+      return;
+    }
+    if (UNLIKELY(!page_stats_set_)) {
+      CopyStatsValue(v, &page_min_, &page_min_buffer_);
+      CopyStatsValue(v, &page_max_, &page_max_buffer_);
+      page_stats_set_ = true;
+    } else if (v < page_min_) {
+      CopyStatsValue(v, &page_min_, &page_min_buffer_);
+    } else if (page_max_ < v) {
+      CopyStatsValue(v, &page_max_, &page_max_buffer_);
+    }
+  }
+
+  // Returns false for values that can't be compared with operator<.
+  bool IsOrdered(const T& v) const { return true; }
+
+  void CopyStatsValue(const T& src, T* dst, string* buffer) { *dst = src; }
+
   // Converts a slot pointer to a raw value suitable for encoding
   inline T* CastValue(void* value) {
     return reinterpret_cast<T*>(value);
@@ -331,6 +524,32 @@ inline StringValue* HdfsParquetTableWriter::ColumnWriter<StringValue>::CastValue
   return reinterpret_cast<StringValue*>(value);
 }
 
+template<>
+inline bool HdfsParquetTableWriter::ColumnWriter<float>::IsOrdered(
+    const float& v) const {
+  return !isnan(v);
+}
+
+template<>
+inline bool HdfsParquetTableWriter::ColumnWriter<double>::IsOrdered(
+    const double& v) const {
+  return !isnan(v);
+}
+
+template<>
+inline bool HdfsParquetTableWriter::ColumnWriter<TimestampValue>::IsOrdered(
+    const TimestampValue& v) const {
+  return v.HasDateAndTime();
+}
+
+template<>
+inline void HdfsParquetTableWriter::ColumnWriter<StringValue>::CopyStatsValue(
+    const StringValue& src, StringValue* dst, string* buffer) {
+  buffer->assign(src.ptr, src.len);
+  dst->ptr = const_cast<char*>(buffer->data());
+  dst->len = src.len;
+}
+
 // Bools are encoded a bit differently so subclass it explicitly.
 class HdfsParquetTableWriter::BoolColumnWriter :
     public HdfsParquetTableWriter::BaseColumnWriter {
@@ -406,7 +625,7 @@ inline Status HdfsParquetTableWriter::BaseColumnWriter::AppendRow(TupleRow* row)
         return Status(ss.str());
       }
       values_buffer_len_ = page_size_;
-      values_buffer_ = parent_->reusable_col_mem_pool_->Allocate(values_buffer_len_);
+      values_buffer_ = reusable_mem_pool_->Allocate(values_buffer_len_);
     }
     NewPage();
   }
@@ -414,6 +633,16 @@ inline Status HdfsParquetTableWriter::BaseColumnWriter::AppendRow(TupleRow* row)
   return Status::OK;
 }
 
+void HdfsParquetTableWriter::BaseColumnWriter::AppendRows(RowBatch* batch,
+    const vector<int32_t>& row_group_indices, int start_row, int end_row) {
+  bool all_rows = row_group_indices.empty();
+  for (int i = start_row; i < end_row; ++i) {
+    TupleRow* row = all_rows ? batch->GetRow(i) : batch->GetRow(row_group_indices[i]);
+    append_status_ = AppendRow(row);
+    if (UNLIKELY(!append_status_.ok())) return;
+  }
+}
+
 inline void HdfsParquetTableWriter::BaseColumnWriter::WriteDictDataPage() {
   DCHECK(dict_encoder_base_ != NULL);
   DCHECK_EQ(current_page_->header.uncompressed_page_size, 0);
@@ -423,7 +652,7 @@ inline void HdfsParquetTableWriter::BaseColumnWriter::WriteDictDataPage() {
     // len < 0 indicates the data doesn't fit into a data page. Allocate a larger data
     // page.
     values_buffer_len_ *= 2;
-    values_buffer_ = parent_->reusable_col_mem_pool_->Allocate(values_buffer_len_);
+    values_buffer_ = reusable_mem_pool_->Allocate(values_buffer_len_);
     len = dict_encoder_base_->WriteData(values_buffer_, values_buffer_len_);
   }
   dict_encoder_base_->ClearIndices();
@@ -456,7 +685,7 @@ Status HdfsParquetTableWriter::BaseColumnWriter::Flush(int64_t* file_pos,
     header.__set_dictionary_page_header(dict_header);
 
     // Write the dictionary page data, compressing it if necessary.
-    uint8_t* dict_buffer = parent_->per_file_mem_pool_->Allocate(
+    uint8_t* dict_buffer = per_file_mem_pool_->Allocate(
         header.uncompressed_page_size);
     dict_encoder_base_->WriteDict(dict_buffer);
     if (compressor_.get() != NULL) {
@@ -465,14 +694,14 @@ Status HdfsParquetTableWriter::BaseColumnWriter::Flush(int64_t* file_pos,
           compressor_->MaxOutputLen(header.uncompressed_page_size);
       DCHECK_GT(max_compressed_size, 0);
       uint8_t* compressed_data =
-          parent_->per_file_mem_pool_->Allocate(max_compressed_size);
+          per_file_mem_pool_->Allocate(max_compressed_size);
       header.compressed_page_size = max_compressed_size;
       compressor_->ProcessBlock32(true, header.uncompressed_page_size, dict_buffer,
           &header.compressed_page_size, &compressed_data);
       dict_buffer = compressed_data;
       // We allocated the output based on the guessed size, return the extra allocated
       // bytes back to the mem pool.
-      parent_->per_file_mem_pool_->ReturnPartialAllocation(
+      per_file_mem_pool_->ReturnPartialAllocation(
           max_compressed_size - header.compressed_page_size);
     } else {
       header.compressed_page_size = header.uncompressed_page_size;
@@ -480,7 +709,7 @@ Status HdfsParquetTableWriter::BaseColumnWriter::Flush(int64_t* file_pos,
 
     uint8_t* header_buffer;
     uint32_t header_len;
-    RETURN_IF_ERROR(parent_->thrift_serializer_->Serialize(
+    RETURN_IF_ERROR(thrift_serializer_->Serialize(
         &header, &header_len, &header_buffer));
     RETURN_IF_ERROR(parent_->Write(header_buffer, header_len));
     *file_pos += header_len;
@@ -494,6 +723,7 @@ Status HdfsParquetTableWriter::BaseColumnWriter::Flush(int64_t* file_pos,
   }
 
   *first_data_page = *file_pos;
+  int64_t first_row_index = 0;
   // Write data pages
   for (int i = 0; i < num_data_pages_; ++i) {
     DataPage& page = pages_[i];
@@ -509,8 +739,22 @@ Status HdfsParquetTableWriter::BaseColumnWriter::Flush(int64_t* file_pos,
     uint8_t* buffer;
     uint32_t len;
     RETURN_IF_ERROR(
-        parent_->thrift_serializer_->Serialize(&page.header, &len, &buffer));
+        thrift_serializer_->Serialize(&page.header, &len, &buffer));
     RETURN_IF_ERROR(parent_->Write(buffer, len));
+
+    if (column_index_valid_) {
+      PageLocation location;
+      location.offset = *file_pos;
+      location.compressed_page_size = len + page.header.compressed_page_size;
+      location.first_row_index = first_row_index;
+      offset_index_.page_locations.push_back(location);
+      int64_t num_nulls = page.header.data_page_header.num_values - page.num_non_null;
+      column_index_.null_pages.push_back(page.num_non_null == 0);
+      column_index_.min_values.push_back(page.min_value);
+      column_index_.max_values.push_back(page.max_value);
+      column_index_.null_counts.push_back(num_nulls);
+    }
+    first_row_index += page.header.data_page_header.num_values;
     *file_pos += len;
 
     // Write the page data
@@ -520,6 +764,41 @@ Status HdfsParquetTableWriter::BaseColumnWriter::Flush(int64_t* file_pos,
   return Status::OK;
 }
 
+Status HdfsParquetTableWriter::BaseColumnWriter::WriteIndexes(int64_t* file_pos,
+    ColumnChunk* col_chunk) {
+  uint8_t* buffer;
+  uint32_t len;
+  if (column_index_valid_ && !offset_index_.page_locations.empty()) {
+    RETURN_IF_ERROR(thrift_serializer_->Serialize(&column_index_, &len, &buffer));
+    RETURN_IF_ERROR(parent_->Write(buffer, len));
+    col_chunk->__set_column_index_offset(*file_pos);
+    col_chunk->__set_column_index_length(len);
+    *file_pos += len;
+
+    RETURN_IF_ERROR(thrift_serializer_->Serialize(&offset_index_, &len, &buffer));
+    RETURN_IF_ERROR(parent_->Write(buffer, len));
+    col_chunk->__set_offset_index_offset(*file_pos);
+    col_chunk->__set_offset_index_length(len);
+    *file_pos += len;
+  }
+
+  if (bloom_filter_.get() != NULL) {
+    bloom_filter_->Fold(0, BLOOM_FILTER_MAX_FILL);
+    RETURN_IF_ERROR(parent_->Write(bloom_filter_->data(), bloom_filter_->size()));
+    KeyValue offset;
+    offset.key = PARQUET_BLOOM_FILTER_OFFSET_KEY;
+    offset.__set_value(lexical_cast<string>(*file_pos));
+    KeyValue length;
+    length.key = PARQUET_BLOOM_FILTER_LENGTH_KEY;
+    length.__set_value(lexical_cast<string>(bloom_filter_->size()));
+    col_chunk->meta_data.key_value_metadata.push_back(offset);
+    col_chunk->meta_data.key_value_metadata.push_back(length);
+    col_chunk->meta_data.__isset.key_value_metadata = true;
+    *file_pos += bloom_filter_->size();
+  }
+  return Status::OK;
+}
+
 void HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
   DCHECK(current_page_ != NULL);
   if (current_page_->finalized) return;
@@ -533,6 +812,16 @@ void HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
 
   PageHeader& header = current_page_->header;
   header.data_page_header.encoding = current_encoding_;
+  if (current_encoding_ == Encoding::PLAIN) plain_pages_written_ = true;
+
+  if (write_page_index_) {
+    current_page_->min_value.clear();
+    current_page_->max_value.clear();
+    if (current_page_->num_non_null > 0 &&
+        !GetPageStats(&current_page_->min_value, &current_page_->max_value)) {
+      column_index_valid_ = false;
+    }
+  }
 
   // Compute size of definition bits
   def_levels_->Flush();
@@ -542,13 +831,11 @@ void HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
   // At this point we know all the data for the data page.  Combine them into one buffer.
   uint8_t* uncompressed_data = NULL;
   if (compressor_.get() == NULL) {
-    uncompressed_data =
-        parent_->per_file_mem_pool_->Allocate(header.uncompressed_page_size);
+    uncompressed_data = per_file_mem_pool_->Allocate(header.uncompressed_page_size);
   } else {
     // We have compression.  Combine into the staging buffer.
-    parent_->compression_staging_buffer_.resize(
-        header.uncompressed_page_size);
-    uncompressed_data = &parent_->compression_staging_buffer_[0];
+    compression_staging_buffer_.resize(header.uncompressed_page_size);
+    uncompressed_data = &compression_staging_buffer_[0];
   }
 
   BufferBuilder buffer(uncompressed_data, header.uncompressed_page_size);
@@ -566,11 +853,11 @@ void HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
     current_page_->data = reinterpret_cast<uint8_t*>(uncompressed_data);
     header.compressed_page_size = header.uncompressed_page_size;
   } else {
-    SCOPED_TIMER(parent_->parent_->compress_timer());
+    SCOPED_TIMER(&compress_timer_);
     int64_t max_compressed_size =
         compressor_->MaxOutputLen(header.uncompressed_page_size);
     DCHECK_GT(max_compressed_size, 0);
-    uint8_t* compressed_data = parent_->per_file_mem_pool_->Allocate(max_compressed_size);
+    uint8_t* compressed_data = per_file_mem_pool_->Allocate(max_compressed_size);
     header.compressed_page_size = max_compressed_size;
     compressor_->ProcessBlock32(true, header.uncompressed_page_size, uncompressed_data,
         &header.compressed_page_size, &compressed_data);
@@ -578,15 +865,14 @@ void HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
 
     // We allocated the output based on the guessed size, return the extra allocated
     // bytes back to the mem pool.
-    parent_->per_file_mem_pool_->ReturnPartialAllocation(
+    per_file_mem_pool_->ReturnPartialAllocation(
         max_compressed_size - header.compressed_page_size);
   }
 
   // Add the size of the data page header
   uint8_t* header_buffer;
   uint32_t header_len = 0;
-  parent_->thrift_serializer_->Serialize(
-      &current_page_->header, &header_len, &header_buffer);
+  thrift_serializer_->Serialize(&current_page_->header, &header_len, &header_buffer);
 
   current_page_->finalized = true;
   total_compressed_byte_size_ += header_len + header.compressed_page_size;
@@ -623,11 +909,15 @@ HdfsParquetTableWriter::HdfsParquetTableWriter(HdfsTableSink* parent, RuntimeSta
         parent, state, output, part_desc, table_desc, output_expr_ctxs),
       thrift_serializer_(new ThriftSerializer(true)),
       current_row_group_(NULL),
+      num_bloom_filter_columns_(0),
       row_count_(0),
       file_size_limit_(0),
-      reusable_col_mem_pool_(new MemPool(parent_->mem_tracker())),
-      per_file_mem_pool_(new MemPool(parent_->mem_tracker())),
-      row_idx_(0) {
+      row_idx_(0),
+      append_batch_(NULL),
+      append_row_group_indices_(NULL),
+      append_start_row_(0),
+      append_end_row_(0),
+      num_pending_column_tasks_(0) {
 }
 
 HdfsParquetTableWriter::~HdfsParquetTableWriter() {
@@ -660,6 +950,15 @@ Status HdfsParquetTableWriter::Init() {
   VLOG_FILE << "Using compression codec: " << codec;
 
   columns_.resize(table_desc_->num_cols() - table_desc_->num_clustering_cols());
+  vector<string> bloom_filter_columns;
+  if (!FLAGS_parquet_bloom_filter_columns.empty()) {
+    split(bloom_filter_columns, FLAGS_parquet_bloom_filter_columns, is_any_of(","));
+    for (int i = 0; i < bloom_filter_columns.size(); ++i) {
+      trim(bloom_filter_columns[i]);
+      to_lower(bloom_filter_columns[i]);
+    }
+  }
+  num_bloom_filter_columns_ = 0;
   // Initialize each column structure.
   for (int i = 0; i < columns_.size(); ++i) {
     BaseColumnWriter* writer = NULL;
@@ -725,6 +1024,14 @@ Status HdfsParquetTableWriter::Init() {
         DCHECK(false);
     }
     columns_[i] = state_->obj_pool()->Add(writer);
+    const string& col_name =
+        table_desc_->col_names()[i + table_desc_->num_clustering_cols()];
+    if (type.type != TYPE_BOOLEAN &&
+        find(bloom_filter_columns.begin(), bloom_filter_columns.end(),
+            to_lower_copy(col_name)) != bloom_filter_columns.end()) {
+      columns_[i]->EnableBloomFilter(FLAGS_parquet_bloom_filter_max_bytes);
+      ++num_bloom_filter_columns_;
+    }
     columns_[i]->Reset();
   }
   RETURN_IF_ERROR(CreateSchema());
@@ -778,10 +1085,9 @@ Status HdfsParquetTableWriter::AddRowGroup() {
     // Add all encodings that were used in this file.  Currently we use PLAIN and
     // PLAIN_DICTIONARY for data values and RLE for the definition levels.
     metadata.encodings.push_back(Encoding::RLE);
-    // Columns are initially dictionary encoded
-    // TODO: we might not have PLAIN encoding in this case
+    // Columns are initially dictionary encoded. PLAIN is added in
+    // FlushCurrentRowGroup() if the column fell back to it.
     metadata.encodings.push_back(Encoding::PLAIN_DICTIONARY);
-    metadata.encodings.push_back(Encoding::PLAIN);
     metadata.path_in_schema.push_back(table_desc_->col_names()[i + num_clustering_cols]);
     metadata.codec = columns_[i]->codec();
     current_row_group_->columns[i].__set_meta_data(metadata);
@@ -792,7 +1098,12 @@ Status HdfsParquetTableWriter::AddRowGroup() {
 
 int64_t HdfsParquetTableWriter::MinBlockSize() const {
   // See file_size_limit_ calculation in InitNewFile().
-  return 3 * DEFAULT_DATA_PAGE_SIZE * columns_.size();
+  return 3 * DEFAULT_DATA_PAGE_SIZE * columns_.size() + BloomFilterReservation();
+}
+
+int64_t HdfsParquetTableWriter::BloomFilterReservation() const {
+  return static_cast<int64_t>(FLAGS_parquet_bloom_filter_max_bytes) *
+      num_bloom_filter_columns_;
 }
 
 uint64_t HdfsParquetTableWriter::default_block_size() const {
@@ -815,7 +1126,9 @@ uint64_t HdfsParquetTableWriter::default_block_size() const {
 Status HdfsParquetTableWriter::InitNewFile() {
   DCHECK(current_row_group_ == NULL);
 
-  per_file_mem_pool_->Clear();
+  for (int i = 0; i < columns_.size(); ++i) {
+    columns_[i]->ClearPerFileMemory();
+  }
 
   // Get the file limit
   RETURN_IF_ERROR(HdfsTableSink::GetFileBlockSize(output_, &file_size_limit_));
@@ -847,7 +1160,10 @@ Status HdfsParquetTableWriter::InitNewFile() {
        << "PARQUET_FILE_SIZE to at least " << MinBlockSize() << ".";
     return Status(ss.str());
   }
-  file_size_limit_ -= 2 * DEFAULT_DATA_PAGE_SIZE * columns_.size();
+  // Bloom filters are written at the end of the row group, so reserve space for them
+  // as well.
+  file_size_limit_ -= 2 * DEFAULT_DATA_PAGE_SIZE * columns_.size() +
+      BloomFilterReservation();
   DCHECK_GE(file_size_limit_, DEFAULT_DATA_PAGE_SIZE * columns_.size());
   file_pos_ = 0;
   row_count_ = 0;
@@ -871,6 +1187,20 @@ Status HdfsParquetTableWriter::AppendRowBatch(RowBatch* batch,
     limit = row_group_indices.size();
   }
 
+  Status status;
+  if (FLAGS_parquet_writer_threads > 1 && columns_.size() > 1) {
+    status = AppendRowsParallel(batch, row_group_indices, limit, new_file);
+  } else {
+    status = AppendRows(batch, row_group_indices, limit, new_file);
+  }
+  for (int i = 0; i < columns_.size(); ++i) {
+    columns_[i]->UpdateCompressTimer();
+  }
+  return status;
+}
+
+Status HdfsParquetTableWriter::AppendRows(RowBatch* batch,
+    const vector<int32_t>& row_group_indices, int limit, bool* new_file) {
   bool all_rows = row_group_indices.empty();
   for (; row_idx_ < limit;) {
     TupleRow* current_row = all_rows ?
@@ -895,6 +1225,91 @@ Status HdfsParquetTableWriter::AppendRowBatch(RowBatch* batch,
   return Status::OK;
 }
 
+Status HdfsParquetTableWriter::AppendRowsParallel(RowBatch* batch,
+    const vector<int32_t>& row_group_indices, int limit, bool* new_file) {
+  ThreadPool<ColumnTask>* pool = GetColumnThreadPool();
+  while (row_idx_ < limit) {
+    // The file size is only checked between chunks of rows, so bound the chunk to
+    // use at most half a data page per column of the space reserved below
+    // file_size_limit_ (see InitNewFile()).
+    int num_rows = limit - row_idx_;
+    if (row_count_ > 0) {
+      int64_t bytes_per_row = max(file_size_estimate_ / row_count_, 1L);
+      int64_t max_rows = DEFAULT_DATA_PAGE_SIZE * columns_.size() / (2 * bytes_per_row);
+      num_rows = min(static_cast<int64_t>(num_rows), max(max_rows, 1L));
+    }
+
+    append_batch_ = batch;
+    append_row_group_indices_ = &row_group_indices;
+    append_start_row_ = row_idx_;
+    append_end_row_ = row_idx_ + num_rows;
+    {
+      lock_guard<mutex> l(column_tasks_lock_);
+      num_pending_column_tasks_ = columns_.size();
+    }
+    for (int i = 0; i < columns_.size(); ++i) {
+      ColumnTask task;
+      task.writer = this;
+      task.col_idx = i;
+      pool->Offer(task);
+    }
+    {
+      unique_lock<mutex> l(column_tasks_lock_);
+      while (num_pending_column_tasks_ > 0) column_tasks_done_cv_.wait(l);
+    }
+    for (int i = 0; i < columns_.size(); ++i) {
+      RETURN_IF_ERROR(columns_[i]->append_status_);
+    }
+
+    row_idx_ += num_rows;
+    row_count_ += num_rows;
+    output_->num_rows += num_rows;
+
+    if (file_size_estimate_ > file_size_limit_) {
+      // This file is full.  We need a new file.
+      *new_file = true;
+      return Status::OK;
+    }
+  }
+
+  // Reset the row_idx_ when we exhaust the batch.
+  row_idx_ = 0;
+  return Status::OK;
+}
+
+void HdfsParquetTableWriter::ProcessColumnTask(int thread_id, const ColumnTask& task) {
+  HdfsParquetTableWriter* writer = task.writer;
+  BaseColumnWriter* column = writer->columns_[task.col_idx];
+  if (UNLIKELY(task.col_idx == FLAGS_debug_parquet_writer_fail_column)) {
+    stringstream ss;
+    ss << "Debug failure appending column " << task.col_idx << " of "
+       << writer->output_->current_file_name;
+    column->append_status_ = Status(ss.str());
+  } else {
+    column->AppendRows(writer->append_batch_, *writer->append_row_group_indices_,
+        writer->append_start_row_, writer->append_end_row_);
+  }
+  lock_guard<mutex> l(writer->column_tasks_lock_);
+  if (--writer->num_pending_column_tasks_ == 0) {
+    writer->column_tasks_done_cv_.notify_one();
+  }
+}
+
+ThreadPool<HdfsParquetTableWriter::ColumnTask>*
+HdfsParquetTableWriter::GetColumnThreadPool() {
+  static mutex pool_lock;
+  static ThreadPool<ColumnTask>* pool = NULL;
+  lock_guard<mutex> l(pool_lock);
+  if (pool == NULL) {
+    DCHECK_GT(FLAGS_parquet_writer_threads, 1);
+    // The pool lives for the lifetime of the process.
+    pool = new ThreadPool<ColumnTask>("parquet-writer", "column-encoder",
+        FLAGS_parquet_writer_threads, std::numeric_limits<int32_t>::max(),
+        &HdfsParquetTableWriter::ProcessColumnTask);
+  }
+  return pool;
+}
+
 Status HdfsParquetTableWriter::Finalize() {
   SCOPED_TIMER(parent_->hdfs_write_timer());
 
@@ -903,6 +1318,9 @@ Status HdfsParquetTableWriter::Finalize() {
   file_metadata_.num_rows = row_count_;
   RETURN_IF_ERROR(FlushCurrentRowGroup());
   RETURN_IF_ERROR(WriteFileFooter());
+  for (int i = 0; i < columns_.size(); ++i) {
+    columns_[i]->UpdateCompressTimer();
+  }
   stats_.__set_parquet_stats(parquet_stats_);
   COUNTER_ADD(parent_->rows_inserted_counter(), row_count_);
   return Status::OK;
@@ -913,9 +1331,6 @@ void HdfsParquetTableWriter::Close() {
   for (int i = 0; i < columns_.size(); ++i) {
     columns_[i]->Close();
   }
-  reusable_col_mem_pool_->FreeAll();
-  per_file_mem_pool_->FreeAll();
-  compression_staging_buffer_.clear();
 }
 
 Status HdfsParquetTableWriter::WriteFileHeader() {
@@ -942,6 +1357,9 @@ Status HdfsParquetTableWriter::FlushCurrentRowGroup() {
           dict_page_offset);
     }
 
+    if (columns_[i]->plain_pages_written()) {
+      current_row_group_->columns[i].meta_data.encodings.push_back(Encoding::PLAIN);
+    }
     current_row_group_->columns[i].meta_data.num_values = columns_[i]->num_values();
     current_row_group_->columns[i].meta_data.total_uncompressed_size =
         columns_[i]->total_uncompressed_size();
@@ -967,7 +1385,14 @@ Status HdfsParquetTableWriter::FlushCurrentRowGroup() {
         thrift_serializer_->Serialize(&current_row_group_->columns[i], &len, &buffer));
     RETURN_IF_ERROR(Write(buffer, len));
     file_pos_ += len;
+  }
 
+  // The page indexes and bloom filters go after all the column chunks so that readers
+  // can fetch the ones they need with few reads. They are only referenced from the
+  // file footer.
+  for (int i = 0; i < columns_.size(); ++i) {
+    RETURN_IF_ERROR(
+        columns_[i]->WriteIndexes(&file_pos_, &current_row_group_->columns[i]));
     columns_[i]->Reset();
   }
 
@@ -23,7 +23,10 @@
 #include "dfs_cache/dfs-cache.h"
 #include <map>
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 
+#include "common/atomic.h"
 #include "util/compress.h"
 #include "runtime/descriptors.h"
 #include "exec/hdfs-table-writer.h"
@@ -36,6 +39,7 @@ struct OutputPartition;
 class RuntimeState;
 class ThriftSerializer;
 class TupleRow;
+template <typename T> class ThreadPool;
 
 // The writer consumes all rows passed to it and writes the evaluated output_exprs
 // as a parquet file in hdfs.
@@ -113,6 +117,9 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
   // Minimum allowable block size in bytes. This is a function of the number of columns.
   int64_t MinBlockSize() const;
 
+  // Space in bytes reserved at the end of each file for bloom filters.
+  int64_t BloomFilterReservation() const;
+
   // Fills in the schema portion of the file metadata, converting the schema in
   // table_desc_ into the format in the file metadata
   Status CreateSchema();
@@ -131,6 +138,30 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
   // new row group.  current_row_group_ will be flushed.
   Status AddRowGroup();
 
+  // Appends rows [row_idx_, limit) of batch to the current file, one row at a time
+  // on the calling thread. Stops and sets *new_file if the file is full.
+  Status AppendRows(RowBatch* batch, const std::vector<int32_t>& row_group_indices,
+      int limit, bool* new_file);
+
+  // Same as AppendRows() but appends chunks of rows to all the columns in parallel on
+  // the column thread pool. The file size is checked after each chunk.
+  Status AppendRowsParallel(RowBatch* batch,
+      const std::vector<int32_t>& row_group_indices, int limit, bool* new_file);
+
+  // Work item for the column thread pool: append the current chunk of rows
+  // (append_batch_, append_start_row_, append_end_row_) to one column.
+  struct ColumnTask {
+    HdfsParquetTableWriter* writer;
+    int col_idx;
+  };
+
+  // Thread pool function that processes a ColumnTask.
+  static void ProcessColumnTask(int thread_id, const ColumnTask& task);
+
+  // Returns the column thread pool shared by all writers, creating it on first use
+  // with FLAGS_parquet_writer_threads threads.
+  static ThreadPool<ColumnTask>* GetColumnThreadPool();
+
   // Thrift serializer utility object.  Reusing this object allows for
   // fewer memory allocations.
   boost::scoped_ptr<ThriftSerializer> thrift_serializer_;
@@ -144,6 +175,9 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
   // array of pointers to column information.
   std::vector<BaseColumnWriter*> columns_;
 
+  // Number of columns in columns_ that write bloom filters.
+  int num_bloom_filter_columns_;
+
   // Number of rows in current file
   int64_t row_count_;
 
@@ -151,8 +185,8 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
   // the running size of the (uncompressed) dictionary, the size of all finalized
   // (compressed) data pages and their page headers.
   // If this size exceeds file_size_limit_, the current data is written and a new file
-  // is started.
-  int64_t file_size_estimate_;
+  // is started. Updated by the column writers, which may run concurrently.
+  AtomicInt<int64_t> file_size_estimate_;
 
   // Limit on the total size of the file.
   int64_t file_size_limit_;
@@ -162,22 +196,22 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
   // in a few places.
   int64_t file_pos_;
 
-  // Memory for column/block buffers that are reused for the duration of the
-  // writer (i.e. reused across files).
-  boost::scoped_ptr<MemPool> reusable_col_mem_pool_;
-
-  // Memory for column/block buffers that is allocated per file.  We need to
-  // reset this pool after flushing a file.
-  boost::scoped_ptr<MemPool> per_file_mem_pool_;
-
   // Current position in the batch being written.  This must be persistent across
   // calls since the writer may stop in the middle of a row batch and ask for a new
   // file.
   int row_idx_;
 
-  // Staging buffer to use to compress data.  This is used only if compression is
-  // enabled and is reused between all data pages.
-  std::vector<uint8_t> compression_staging_buffer_;
+  // The chunk of rows being appended by the column tasks of AppendRowsParallel().
+  RowBatch* append_batch_;
+  const std::vector<int32_t>* append_row_group_indices_;
+  int append_start_row_;
+  int append_end_row_;
+
+  // Number of column tasks of the current chunk that have not finished yet. Protected
+  // by column_tasks_lock_. column_tasks_done_cv_ is signalled when it reaches 0.
+  int num_pending_column_tasks_;
+  boost::mutex column_tasks_lock_;
+  boost::condition_variable column_tasks_done_cv_;
 
   // For each column, the on disk size written.
   TParquetInsertStats parquet_stats_;
@@ -40,6 +40,7 @@
 #include "runtime/raw-value.h"
 #include "runtime/row-batch.h"
 #include "util/bit-util.h"
+#include "util/bloom-filter.h"
 #include "util/container-util.h"
 #include "util/debug-util.h"
 #include "util/disk-info.h"
@@ -52,6 +53,9 @@
 #include "gen-cpp/PlanNodes_types.h"
 
 DEFINE_int32(max_row_batches, 0, "the maximum size of materialized_row_batches_");
+DEFINE_int32(global_runtime_filter_wait_time_ms, 1000, "The maximum time in ms a scan "
+    "waits for the global runtime filters from joins in other fragments before "
+    "starting without them.");
 DECLARE_string(cgroup_hierarchy_path);
 DECLARE_bool(enable_rm);
 
@@ -113,7 +117,10 @@ Status HdfsScanNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos
   if (!initial_ranges_issued_) {
     // We do this in GetNext() to ensure that all execution time predicates have
     // been generated (e.g. probe side bitmap filters).
-    // TODO: we could do dynamic partition pruning here as well.
+    // Open() already called SetDone() if there is nothing to scan.
+    if (runtime_state_->has_global_filter_targets() && !done_) {
+      RETURN_IF_ERROR(ApplyGlobalFilters());
+    }
     initial_ranges_issued_ = true;
     // Issue initial ranges for all file types.
     RETURN_IF_ERROR(HdfsTextScanner::IssueInitialRanges(this,
@@ -135,6 +142,70 @@ Status HdfsScanNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos
   return status;
 }
 
+Status HdfsScanNode::ApplyGlobalFilters() {
+  {
+    SCOPED_TIMER(global_filter_wait_timer_);
+    if (!runtime_state_->WaitForGlobalFilters(FLAGS_global_runtime_filter_wait_time_ms)) {
+      RETURN_IF_CANCELLED(runtime_state_);
+      AddRuntimeExecOption("Global Filter Wait Timed Out");
+    }
+  }
+
+  // Filters on partition key slots prune whole partitions. Filters on other slots are
+  // applied by the scanners.
+  vector<pair<const SlotDescriptor*, const BloomFilter*> > key_filters;
+  for (int i = 0; i < partition_key_slots_.size(); ++i) {
+    const BloomFilter* filter =
+        runtime_state_->GetGlobalFilter(partition_key_slots_[i]->id());
+    if (filter != NULL) key_filters.push_back(make_pair(partition_key_slots_[i], filter));
+  }
+  if (key_filters.empty()) return Status::OK;
+
+  unordered_set<int64_t> rejected_partitions;
+  BOOST_FOREACH(int64_t partition_id, partition_ids_) {
+    HdfsPartitionDescriptor* partition = hdfs_table_->GetPartition(partition_id);
+    for (int i = 0; i < key_filters.size(); ++i) {
+      const SlotDescriptor* slot_desc = key_filters[i].first;
+      // Partition key exprs are literals and are evaluated without a row.
+      void* value =
+          partition->partition_key_value_ctxs()[slot_desc->col_pos()]->GetValue(NULL);
+      uint64_t hash = RuntimeState::GetGlobalFilterHash(value, slot_desc->type());
+      if (!key_filters[i].second->Find(hash)) {
+        rejected_partitions.insert(partition_id);
+        break;
+      }
+    }
+  }
+  if (rejected_partitions.empty()) return Status::OK;
+
+  int num_rejected_files = 0;
+  int num_rejected_splits = 0;
+  for (FileFormatsMap::iterator it = per_type_files_.begin();
+       it != per_type_files_.end(); ++it) {
+    vector<HdfsFileDesc*>& files = it->second;
+    int num_kept = 0;
+    for (int i = 0; i < files.size(); ++i) {
+      DCHECK(!files[i]->splits.empty());
+      ScanRangeMetadata* metadata =
+          reinterpret_cast<ScanRangeMetadata*>(files[i]->splits[0]->meta_data());
+      if (rejected_partitions.find(metadata->partition_id) ==
+          rejected_partitions.end()) {
+        files[num_kept++] = files[i];
+        continue;
+      }
+      ++num_rejected_files;
+      num_rejected_splits += files[i]->splits.size();
+    }
+    files.resize(num_kept);
+  }
+  VLOG_FILE << "Global filters rejected " << rejected_partitions.size()
+            << " partition(s) with " << num_rejected_files << " file(s)";
+  COUNTER_ADD(num_files_global_filtered_, num_rejected_files);
+  num_unqueued_files_ -= num_rejected_files;
+  progress_.Update(num_rejected_splits);
+  return Status::OK;
+}
+
 Status HdfsScanNode::GetNextInternal(
     RuntimeState* state, RowBatch* row_batch, bool* eos) {
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
@@ -595,6 +666,10 @@ Status HdfsScanNode::Open(RuntimeState* state) {
   max_compressed_text_file_length_ = runtime_profile()->AddHighWaterMarkCounter(
       "MaxCompressedTextFileLength", TUnit::BYTES);
 
+  global_filter_wait_timer_ = ADD_TIMER(runtime_profile(), "GlobalFilterWaitTime");
+  num_files_global_filtered_ =
+      ADD_COUNTER(runtime_profile(), "FilesRejectedByGlobalFilters", TUnit::UNIT);
+
   for (int i = 0; i < state->io_mgr()->num_total_disks() + 1; ++i) {
     hdfs_read_thread_concurrency_bucket_.push_back(
         pool_->Add(new RuntimeProfile::Counter(TUnit::DOUBLE_VALUE, 0)));
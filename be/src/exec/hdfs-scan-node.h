@@ -251,6 +251,11 @@ class HdfsScanNode : public ScanNode {
   // order set to conjuncts.size()
   void ComputeSlotMaterializationOrder(std::vector<int>* order) const;
 
+  // Waits for the global runtime filters this fragment instance receives and drops the
+  // files of partitions whose partition key values fail them. Called before the initial
+  // scan ranges are issued.
+  Status ApplyGlobalFilters();
+
   // map from volume id to <number of split, per volume split lengths>
   typedef boost::unordered_map<int32_t, std::pair<int, int64_t> > PerVolumnStats;
 
@@ -404,6 +409,12 @@ class HdfsScanNode : public ScanNode {
   // Total number of bytes read remotely that were expected to be local
   RuntimeProfile::Counter* unexpected_remote_bytes_;
 
+  // Time spent waiting for global runtime filters before starting the scan.
+  RuntimeProfile::Counter* global_filter_wait_timer_;
+
+  // Number of files skipped because their partition failed a global runtime filter.
+  RuntimeProfile::Counter* num_files_global_filtered_;
+
   // Lock protects access between scanner thread and main query thread (the one calling
   // GetNext()) for all fields below.  If this lock and any other locks needs to be taken
   // together, this lock must be taken first.
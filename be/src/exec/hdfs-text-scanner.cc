@@ -26,6 +26,7 @@
 #include "exec/text-converter.inline.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
+#include "util/bzip2-util.h"
 #include "util/codec.h"
 #include "util/decompress.h"
 #include "util/cpu-info.h"
@@ -39,6 +40,9 @@ using namespace std;
 
 DEFINE_bool(debug_disable_streaming_gzip, false, "Debug flag, will be removed. Disables "
     "streaming gzip decompression.");
+DEFINE_bool(split_bzip2_text, false, "If true, bzip2-compressed text files are split "
+    "into scan ranges at compressed block boundaries so that several scanners can "
+    "decompress one file in parallel. Otherwise a single scanner reads the whole file.");
 
 const char* HdfsTextScanner::LLVM_CLASS_NAME = "class.impala::HdfsTextScanner";
 
@@ -49,6 +53,9 @@ const string HdfsTextScanner::LZO_INDEX_SUFFIX = ".index";
 // progress.
 const int64_t GZIP_FIXED_READ_SIZE = 1 * 1024 * 1024;
 
+// Number of bytes to read at a time when looking for the next bzip2 block.
+const int64_t BZIP2_READ_SIZE = 1 * 1024 * 1024;
+
 HdfsTextScanner::HdfsTextScanner(HdfsScanNode* scan_node, RuntimeState* state)
     : HdfsScanner(scan_node, state),
       byte_buffer_ptr_(NULL),
@@ -64,7 +71,12 @@ HdfsTextScanner::HdfsTextScanner(HdfsScanNode* scan_node, RuntimeState* state)
 	  error_in_row_(false),
 	  partial_tuple_(NULL),
 	  partial_tuple_empty_(false),
-	  parse_delimiter_timer_(NULL){
+	  parse_delimiter_timer_(NULL),
+	  split_bzip2_(false),
+	  bzip2_buffer_offset_(0),
+	  bzip2_eof_(false),
+	  bzip2_eosr_(false),
+	  next_bzip2_block_bit_(BZIP2_BLOCK_NOT_FOUND) {
 }
 
 HdfsTextScanner::~HdfsTextScanner() {
@@ -85,10 +97,17 @@ Status HdfsTextScanner::IssueInitialRanges(HdfsScanNode* scan_node,
         RETURN_IF_ERROR(scan_node->AddDiskIoRanges(files[i]));
         break;
 
+      case THdfsCompression::BZIP2:
+        if (FLAGS_split_bzip2_text) {
+          // Each range decompresses the bzip2 blocks that start in it (see
+          // FillByteBufferBzip2Block()), so all ranges are issued at once.
+          RETURN_IF_ERROR(scan_node->AddDiskIoRanges(files[i]));
+          break;
+        }
+        // Fall through.
       case THdfsCompression::GZIP:
       case THdfsCompression::SNAPPY:
       case THdfsCompression::SNAPPY_BLOCKED:
-      case THdfsCompression::BZIP2:
         for (int j = 0; j < files[i]->splits.size(); ++j) {
           // In order to decompress gzip-, snappy- and bzip2-compressed text files, we
           // need to read entire files. Only read a file if we're assigned the first split
@@ -163,6 +182,12 @@ Status HdfsTextScanner::ProcessSplit() {
   // Reset state for new scan range
   RETURN_IF_ERROR(InitNewRange());
 
+  // Update the decompressor depending on the compression type of the file in the
+  // context. Split bzip2 files are decompressed before looking for the first tuple.
+  DCHECK(stream_->file_desc()->file_compression != THdfsCompression::SNAPPY)
+      << "FE should have generated SNAPPY_BLOCKED instead.";
+  RETURN_IF_ERROR(UpdateDecompressor(stream_->file_desc()->file_compression));
+
   // Find the first tuple.  If tuple_found is false, it means we went through the entire
   // scan range without finding a single tuple.  The bytes will be picked up by the scan
   // range before.
@@ -170,12 +195,6 @@ Status HdfsTextScanner::ProcessSplit() {
   RETURN_IF_ERROR(FindFirstTuple(&tuple_found));
 
   if (tuple_found) {
-    // Update the decompressor depending on the compression type of the file in the
-    // context.
-    DCHECK(stream_->file_desc()->file_compression != THdfsCompression::SNAPPY)
-        << "FE should have generated SNAPPY_BLOCKED instead.";
-    RETURN_IF_ERROR(UpdateDecompressor(stream_->file_desc()->file_compression));
-
     // Process the scan range.
     int dummy_num_tuples;
     RETURN_IF_ERROR(ProcessRange(&dummy_num_tuples, false));
@@ -212,6 +231,14 @@ Status HdfsTextScanner::InitNewRange() {
     stream_->set_contains_tuple_data(false);
   }
 
+  split_bzip2_ = FLAGS_split_bzip2_text &&
+      stream_->file_desc()->file_compression == THdfsCompression::BZIP2;
+  bzip2_buffer_.clear();
+  bzip2_buffer_offset_ = 0;
+  bzip2_eof_ = false;
+  bzip2_eosr_ = false;
+  next_bzip2_block_bit_ = BZIP2_BLOCK_NOT_FOUND;
+
   HdfsPartitionDescriptor* hdfs_partition = context_->partition_descriptor();
   char field_delim = hdfs_partition->field_delim();
   char collection_delim = hdfs_partition->collection_delim();
@@ -286,10 +313,13 @@ Status HdfsTextScanner::FinishScanRange() {
     Status status = Status::OK;
     byte_buffer_read_size_ = 0;
 
-    // If compressed text, then there is nothing more to be read.
+    // If compressed text, then there is nothing more to be read, unless the file is
+    // split at bzip2 block boundaries and the tuple continues in the next block.
     // TODO: calling FillByteBuffer() at eof() can cause
     // ScannerContext::Stream::GetNextBuffer to DCHECK. Fix this.
-    if (decompressor_.get() == NULL && !stream_->eof()) {
+    if (split_bzip2_) {
+      status = FillByteBuffer(&eosr);
+    } else if (decompressor_.get() == NULL && !stream_->eof()) {
       status = FillByteBuffer(&eosr, NEXT_BLOCK_READ_SIZE);
     }
 
@@ -354,7 +384,8 @@ Status HdfsTextScanner::FinishScanRange() {
 }
 
 Status HdfsTextScanner::ProcessRange(int* num_tuples, bool past_scan_range) {
-  bool eosr = past_scan_range || stream_->eosr();
+  // For split bzip2 files, stream_ is read ahead of the decompressed data.
+  bool eosr = past_scan_range || (split_bzip2_ ? bzip2_eosr_ : stream_->eosr());
 
   while (true) {
     if (!eosr && byte_buffer_ptr_ == byte_buffer_end_) {
@@ -465,6 +496,9 @@ Status HdfsTextScanner::FillByteBuffer(bool* eosr, int num_bytes) {
                                   &byte_buffer_read_size_);
     }
     *eosr = stream_->eosr();
+  } else if (split_bzip2_) {
+    DCHECK_EQ(num_bytes, 0);
+    RETURN_IF_ERROR(FillByteBufferBzip2Block(eosr));
   } else if (!FLAGS_debug_disable_streaming_gzip &&
       decompression_type_ == THdfsCompression::GZIP) {
     DCHECK_EQ(num_bytes, 0);
@@ -618,6 +652,91 @@ Status HdfsTextScanner::FillByteBufferCompressedFile(bool* eosr) {
   return Status::OK;
 }
 
+Status HdfsTextScanner::FillByteBufferBzip2Block(bool* eosr) {
+  DCHECK(decompression_type_ == THdfsCompression::BZIP2);
+  // Attach any previously decompressed buffers to the row batch before decompressing
+  // any more data.
+  if (!decompressor_->reuse_output_buffer()) {
+    AttachPool(data_buffer_pool_.get(), false);
+  }
+  byte_buffer_read_size_ = 0;
+  *eosr = bzip2_eosr_ = true;
+
+  int64_t range_len = stream_->scan_range()->len();
+  if (next_bzip2_block_bit_ == BZIP2_BLOCK_NOT_FOUND) {
+    RETURN_IF_ERROR(FindBzip2Marker(0, true, &next_bzip2_block_bit_));
+    // If no block starts in this range, the previous range decompresses the blocks
+    // that overlap it.
+    if (next_bzip2_block_bit_ / 8 >= range_len) next_bzip2_block_bit_ = -1;
+  }
+  if (next_bzip2_block_bit_ < 0) return Status::OK;
+
+  int64_t block_bit = next_bzip2_block_bit_;
+  int64_t end_bit;
+  RETURN_IF_ERROR(
+      FindBzip2Marker(block_bit + Bzip2Util::MARKER_BITS, false, &end_bit));
+  if (end_bit < 0) {
+    stringstream ss;
+    ss << "Unexpected end of file decompressing bzip2. File may be malformed. "
+       << "file: " << stream_->filename();
+    return Status(ss.str());
+  }
+  RETURN_IF_ERROR(FindBzip2Marker(end_bit, true, &next_bzip2_block_bit_));
+
+  Bzip2Util::WrapBlock(&bzip2_buffer_[0], block_bit, end_bit, &bzip2_stream_);
+  int64_t decompressed_len = 0;
+  uint8_t* decompressed_buffer = NULL;
+  {
+    SCOPED_TIMER(decompress_timer_);
+    RETURN_IF_ERROR(decompressor_->ProcessBlock(false, bzip2_stream_.size(),
+        &bzip2_stream_[0], &decompressed_len, &decompressed_buffer));
+  }
+  byte_buffer_ptr_ = reinterpret_cast<char*>(decompressed_buffer);
+  byte_buffer_read_size_ = decompressed_len;
+
+  // Drop the compressed bytes before the next block.
+  int64_t consumed = next_bzip2_block_bit_ < 0 ?
+      bzip2_buffer_.size() : next_bzip2_block_bit_ / 8;
+  bzip2_buffer_.erase(bzip2_buffer_.begin(), bzip2_buffer_.begin() + consumed);
+  bzip2_buffer_offset_ += consumed;
+  if (next_bzip2_block_bit_ >= 0) next_bzip2_block_bit_ -= consumed * 8;
+
+  *eosr = bzip2_eosr_ = next_bzip2_block_bit_ < 0 ||
+      bzip2_buffer_offset_ + next_bzip2_block_bit_ / 8 >= range_len;
+  return Status::OK;
+}
+
+Status HdfsTextScanner::FindBzip2Marker(int64_t start_bit, bool blocks_only,
+    int64_t* marker_bit) {
+  while (true) {
+    bool is_block;
+    *marker_bit = Bzip2Util::FindMarker(bzip2_buffer_.empty() ? NULL : &bzip2_buffer_[0],
+        bzip2_buffer_.size(), start_bit, &is_block);
+    if (*marker_bit >= 0) {
+      if (is_block || !blocks_only) return Status::OK;
+      start_bit = *marker_bit + Bzip2Util::MARKER_BITS;
+      continue;
+    }
+    if (bzip2_eof_) return Status::OK;
+
+    // A marker that starts in the last bits of the buffer may not have been read
+    // completely; search those bits again once more of the file is read.
+    start_bit = max<int64_t>(start_bit,
+        bzip2_buffer_.size() * 8 - Bzip2Util::MARKER_BITS + 1);
+    if (stream_->eof()) {
+      bzip2_eof_ = true;
+      continue;
+    }
+    uint8_t* buffer;
+    int64_t buffer_len;
+    Status status;
+    stream_->GetBytes(BZIP2_READ_SIZE, &buffer, &buffer_len, &status);
+    RETURN_IF_ERROR(status);
+    bzip2_buffer_.insert(bzip2_buffer_.end(), buffer, buffer + buffer_len);
+    if (buffer_len == 0) bzip2_eof_ = true;
+  }
+}
+
 Status HdfsTextScanner::FindFirstTuple(bool* tuple_found) {
 	LOG(INFO) << "Find first tuple" << ".\n";
   *tuple_found = true;
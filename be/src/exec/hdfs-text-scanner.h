@@ -16,6 +16,8 @@
 #ifndef IMPALA_EXEC_HDFS_TEXT_SCANNER_H
 #define IMPALA_EXEC_HDFS_TEXT_SCANNER_H
 
+#include <vector>
+
 #include "exec/hdfs-scanner.h"
 #include "runtime/string-buffer.h"
 
@@ -79,6 +81,7 @@ class HdfsTextScanner : public HdfsScanner {
 
  private:
   const static int NEXT_BLOCK_READ_SIZE = 1024; //bytes
+  const static int64_t BZIP2_BLOCK_NOT_FOUND = -2;
 
   // Initializes this scanner for this context.  The context maps to a single
   // scan range.
@@ -117,6 +120,19 @@ class HdfsTextScanner : public HdfsScanner {
   // to available decompressed data.
   Status FillByteBufferGzip(bool* eosr);
 
+  // Fills the next byte buffer with the next block of a bzip2 file that is split into
+  // scan ranges at block boundaries. A scan range owns the blocks whose markers start
+  // in it; *eosr is set once the next block starts past the end of the range. Called
+  // again past the end of the range, it returns the following blocks so that the last
+  // tuple can be finished.
+  Status FillByteBufferBzip2Block(bool* eosr);
+
+  // Sets *marker_bit to the bit offset in bzip2_buffer_ of the first bzip2 marker at
+  // or after 'start_bit', reading more of the file into bzip2_buffer_ as needed. If
+  // 'blocks_only', end-of-stream markers (of concatenated streams) are skipped.
+  // *marker_bit is -1 if the end of the file is reached first.
+  Status FindBzip2Marker(int64_t start_bit, bool blocks_only, int64_t* marker_bit);
+
   // Prepends field data that was from the previous file buffer (This field straddled two
   // file buffers).  'data' already contains the pointer/len from the current file buffer,
   // boundary_column_ contains the beginning of the data from the previous file
@@ -188,6 +204,28 @@ class HdfsTextScanner : public HdfsScanner {
 
   // Time parsing text files
   RuntimeProfile::Counter* parse_delimiter_timer_;
+
+  // True if the file is bzip2 compressed and split into scan ranges at block
+  // boundaries (see FLAGS_split_bzip2_text).
+  bool split_bzip2_;
+
+  // Compressed bytes of the bzip2 file that have been read but not yet decompressed,
+  // and the offset of the first of them relative to the start of the scan range.
+  std::vector<uint8_t> bzip2_buffer_;
+  int64_t bzip2_buffer_offset_;
+
+  // True once bzip2_buffer_ holds the end of the file.
+  bool bzip2_eof_;
+
+  // True once the last block that starts in the scan range has been decompressed.
+  bool bzip2_eosr_;
+
+  // Bit offset in bzip2_buffer_ of the next block to decompress. -1 if there are no
+  // more blocks, BZIP2_BLOCK_NOT_FOUND if the first block has not been searched for.
+  int64_t next_bzip2_block_bit_;
+
+  // The current block wrapped into a standalone bzip2 stream.
+  std::vector<uint8_t> bzip2_stream_;
 };
 
 }
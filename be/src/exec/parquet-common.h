@@ -21,6 +21,7 @@
 #include "runtime/decimal-value.h"
 #include "runtime/string-value.h"
 #include "util/bit-util.h"
+#include "util/bloom-filter.h"
 
 // This file contains common elements between the parquet Writer and Scanner.
 namespace impala {
@@ -30,6 +31,13 @@ class TimestampValue;
 const uint8_t PARQUET_VERSION_NUMBER[4] = {'P', 'A', 'R', '1'};
 const uint32_t PARQUET_CURRENT_VERSION = 1;
 
+// Keys of the ColumnMetaData key_value_metadata entries that locate the bloom filter
+// of a column chunk. The filter is an Impala-specific split-block bloom filter (see
+// util/bloom-filter.h) over values encoded with ParquetIndexEncoder, so it is not
+// advertised using any of the standard metadata fields.
+const char* const PARQUET_BLOOM_FILTER_OFFSET_KEY = "impala.bloom_filter.offset";
+const char* const PARQUET_BLOOM_FILTER_LENGTH_KEY = "impala.bloom_filter.length";
+
 // Mapping of impala types to parquet storage types.  This is indexed by
 // PrimitiveType enum
 const parquet::Type::type IMPALA_TO_PARQUET_TYPES[] = {
@@ -319,6 +327,64 @@ inline int ParquetPlainEncoder::Decode(
   return fixed_len_size;
 }
 
+
+// Encoding of values stored in page indexes (parquet::ColumnIndex) and hashed into
+// bloom filters. Values use the plain encoding, except strings, which are stored
+// without the length prefix.
+// 'fixed_len_size' is ParquetPlainEncoder::ByteSize() of the column type.
+class ParquetIndexEncoder {
+ public:
+  // Largest encoded size of a fixed-length value.
+  static const int MAX_FIXED_LEN_SIZE = 16;
+
+  template<typename T>
+  static void Encode(int fixed_len_size, const T& v, std::string* out) {
+    uint8_t buffer[MAX_FIXED_LEN_SIZE];
+    int len = ParquetPlainEncoder::Encode(buffer, fixed_len_size, v);
+    out->assign(reinterpret_cast<char*>(buffer), len);
+  }
+
+  // Decodes 'in' into 'v'. Returns false if 'in' has the wrong size for the type.
+  // For strings, 'v' points into 'in'.
+  template<typename T>
+  static bool Decode(const std::string& in, int fixed_len_size, T* v) {
+    if (fixed_len_size <= 0 || in.size() != fixed_len_size) return false;
+    ParquetPlainEncoder::Decode(
+        reinterpret_cast<uint8_t*>(const_cast<char*>(in.data())), fixed_len_size, v);
+    return true;
+  }
+
+  template<typename T>
+  static uint64_t Hash(int fixed_len_size, const T& v) {
+    uint8_t buffer[MAX_FIXED_LEN_SIZE];
+    int len = ParquetPlainEncoder::Encode(buffer, fixed_len_size, v);
+    return BloomFilter::Hash(buffer, len);
+  }
+
+  static uint64_t Hash(const std::string& encoded_value) {
+    return BloomFilter::Hash(encoded_value.data(), encoded_value.size());
+  }
+};
+
+template<>
+inline void ParquetIndexEncoder::Encode(
+    int fixed_len_size, const StringValue& v, std::string* out) {
+  out->assign(v.ptr, v.len);
+}
+
+template<>
+inline bool ParquetIndexEncoder::Decode(
+    const std::string& in, int fixed_len_size, StringValue* v) {
+  v->ptr = const_cast<char*>(in.data());
+  v->len = in.size();
+  return true;
+}
+
+template<>
+inline uint64_t ParquetIndexEncoder::Hash(int fixed_len_size, const StringValue& v) {
+  return BloomFilter::Hash(v.ptr, v.len);
+}
+
 }
 
 #endif
@@ -0,0 +1,171 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+#include "common/init.h"
+#include "common/object-pool.h"
+#include "exec/hdfs-parquet-scanner.h"
+#include "exprs/expr.h"
+#include "exprs/expr-context.h"
+#include "runtime/types.h"
+#include "util/test-info.h"
+
+#include "gen-cpp/Exprs_types.h"
+
+using namespace std;
+
+namespace impala {
+
+// Tests which conjuncts the Parquet scanner evaluates against the dictionaries of the
+// columns. The expr trees are only created, not prepared, so the functions don't need
+// to be resolved and the types of the children don't need to match them.
+
+static const SlotId A_SLOT_ID = 0;
+static const SlotId C_SLOT_ID = 1;
+
+static TExprNode MakeNode(TExprNodeType::type node_type, const ColumnType& type,
+    int num_children) {
+  TExprNode node;
+  node.node_type = node_type;
+  node.type = type.ToThrift();
+  node.num_children = num_children;
+  return node;
+}
+
+// Functions to append the nodes of an expr tree to a TExpr in depth-first order.
+static void AddSlotRef(SlotId slot_id, const ColumnType& type, TExpr* expr) {
+  TExprNode node = MakeNode(TExprNodeType::SLOT_REF, type, 0);
+  TSlotRef slot_ref;
+  slot_ref.slot_id = slot_id;
+  node.__set_slot_ref(slot_ref);
+  expr->nodes.push_back(node);
+}
+
+static void AddIntLiteral(int32_t value, TExpr* expr) {
+  TExprNode node = MakeNode(TExprNodeType::INT_LITERAL, TYPE_INT, 0);
+  TIntLiteral int_literal;
+  int_literal.value = value;
+  node.__set_int_literal(int_literal);
+  expr->nodes.push_back(node);
+}
+
+// 'op' is "and", "or" or "not".
+static void AddCompoundPredicate(const string& op, TExpr* expr) {
+  TExprNode node =
+      MakeNode(TExprNodeType::COMPOUND_PRED, TYPE_BOOLEAN, op == "not" ? 1 : 2);
+  node.__isset.fn = true;
+  node.fn.name.function_name = op;
+  node.fn.binary_type = TFunctionBinaryType::BUILTIN;
+  expr->nodes.push_back(node);
+}
+
+// Adds a call of 'name' with 'num_children' arguments, which must be added next.
+static void AddFunctionCall(const string& name, TFunctionBinaryType::type binary_type,
+    const ColumnType& ret_type, int num_children, TExpr* expr) {
+  TExprNode node = MakeNode(TExprNodeType::FUNCTION_CALL, ret_type, num_children);
+  TFunction fn;
+  fn.name.function_name = name;
+  fn.binary_type = binary_type;
+  fn.ret_type = ret_type.ToThrift();
+  node.__set_fn(fn);
+  expr->nodes.push_back(node);
+}
+
+class ParquetDictFilterTest : public testing::Test {
+ protected:
+  ExprContext* CreateContext(const TExpr& texpr) {
+    ExprContext* ctx;
+    EXPECT_TRUE(Expr::CreateExprTree(&pool_, texpr, &ctx).ok());
+    return ctx;
+  }
+
+  // 'c IN (1, <last>)', where <last> is 3 or a call of 'fn_name' without arguments.
+  TExpr MakeInPredicate(const string& fn_name, TFunctionBinaryType::type binary_type) {
+    TExpr texpr;
+    AddFunctionCall("in_iterate", TFunctionBinaryType::BUILTIN, TYPE_BOOLEAN, 3, &texpr);
+    AddSlotRef(C_SLOT_ID, TYPE_INT, &texpr);
+    AddIntLiteral(1, &texpr);
+    if (fn_name.empty()) {
+      AddIntLiteral(3, &texpr);
+    } else {
+      AddFunctionCall(fn_name, binary_type, TYPE_DOUBLE, 0, &texpr);
+    }
+    return texpr;
+  }
+
+  ObjectPool pool_;
+};
+
+TEST_F(ParquetDictFilterTest, SingleSlot) {
+  vector<ExprContext*> conjuncts;
+  conjuncts.push_back(CreateContext(
+      MakeInPredicate("", TFunctionBinaryType::BUILTIN)));
+  EXPECT_TRUE(conjuncts[0]->root()->IsDeterministic());
+
+  // 'a OR c IN (1, 3)' references two slots.
+  TExpr two_slots;
+  AddCompoundPredicate("or", &two_slots);
+  AddSlotRef(A_SLOT_ID, TYPE_BOOLEAN, &two_slots);
+  AddFunctionCall("in_iterate", TFunctionBinaryType::BUILTIN, TYPE_BOOLEAN, 3,
+      &two_slots);
+  AddSlotRef(C_SLOT_ID, TYPE_INT, &two_slots);
+  AddIntLiteral(1, &two_slots);
+  AddIntLiteral(3, &two_slots);
+  conjuncts.push_back(CreateContext(two_slots));
+
+  vector<ExprContext*> c_filters =
+      HdfsParquetScanner::GetDictFilterConjuncts(conjuncts, C_SLOT_ID);
+  ASSERT_EQ(static_cast<int>(c_filters.size()), 1);
+  EXPECT_EQ(c_filters[0], conjuncts[0]);
+  EXPECT_TRUE(HdfsParquetScanner::GetDictFilterConjuncts(conjuncts, A_SLOT_ID).empty());
+}
+
+TEST_F(ParquetDictFilterTest, NonDeterministic) {
+  // 'c IN (1, rand())' may be true for one row with a value and false for the next.
+  vector<ExprContext*> conjuncts;
+  conjuncts.push_back(CreateContext(
+      MakeInPredicate("rand", TFunctionBinaryType::BUILTIN)));
+  EXPECT_FALSE(conjuncts[0]->root()->IsDeterministic());
+  EXPECT_TRUE(conjuncts[0]->root()->GetChild(0)->IsDeterministic());
+
+  // 'NOT c IN (1, my_udf())': nothing is known about UDFs.
+  TExpr udf_texpr;
+  AddCompoundPredicate("not", &udf_texpr);
+  TExpr in_texpr = MakeInPredicate("my_udf", TFunctionBinaryType::NATIVE);
+  udf_texpr.nodes.insert(udf_texpr.nodes.end(), in_texpr.nodes.begin(),
+      in_texpr.nodes.end());
+  conjuncts.push_back(CreateContext(udf_texpr));
+  EXPECT_FALSE(conjuncts[1]->root()->IsDeterministic());
+
+  EXPECT_TRUE(HdfsParquetScanner::GetDictFilterConjuncts(conjuncts, C_SLOT_ID).empty());
+
+  // The deterministic conjuncts of the same slot are still used.
+  conjuncts.push_back(CreateContext(
+      MakeInPredicate("", TFunctionBinaryType::BUILTIN)));
+  vector<ExprContext*> c_filters =
+      HdfsParquetScanner::GetDictFilterConjuncts(conjuncts, C_SLOT_ID);
+  ASSERT_EQ(static_cast<int>(c_filters.size()), 1);
+  EXPECT_EQ(c_filters[0], conjuncts[2]);
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::InitCommonRuntime(argc, argv, false, impala::TestInfo::BE_TEST);
+  return RUN_ALL_TESTS();
+}
@@ -48,20 +48,36 @@ Status PartitionedAggregationNode::ProcessBatch(RowBatch* batch, HashTableCtx* h
     }
   }
 
+  // Evaluate and hash all rows up front and prefetch their buckets, so that the cache
+  // misses on the buckets overlap instead of being taken one row at a time below.
+  ht_ctx->ReserveRowCache(num_rows);
   for (int i = 0; i < num_rows; ++i) {
-    TupleRow* row = batch->GetRow(i);
-    uint32_t hash = 0;
+    uint64_t hash = 0;
+    bool keep_row;
     if (AGGREGATED_ROWS) {
-      if (!ht_ctx->EvalAndHashBuild(row, &hash)) continue;
+      keep_row = ht_ctx->EvalAndHashBuild(batch->GetRow(i), &hash);
     } else {
-      if (!ht_ctx->EvalAndHashProbe(row, &hash)) continue;
+      keep_row = ht_ctx->EvalAndHashProbe(batch->GetRow(i), &hash);
+    }
+    if (!keep_row) {
+      ht_ctx->CacheRejectedRow(i);
+      continue;
     }
+    ht_ctx->CacheCurrentRow(i, hash);
+    Partition* dst_partition = hash_partitions_[hash >> (64 - NUM_PARTITIONING_BITS)];
+    if (!dst_partition->is_spilled()) dst_partition->hash_tbl->PrefetchBucket(hash);
+  }
+
+  for (int i = 0; i < num_rows; ++i) {
+    TupleRow* row = batch->GetRow(i);
+    uint64_t hash = 0;
+    if (!ht_ctx->LoadCachedRow(i, &hash)) continue;
 
     // To process this row, we first see if it can be aggregated or inserted into this
     // partition's hash table. If we need to insert it and that fails, due to OOM, we
     // spill the partition. The partition to spill is not necessarily dst_partition,
     // so we can try again to insert the row.
-    Partition* dst_partition = hash_partitions_[hash >> (32 - NUM_PARTITIONING_BITS)];
+    Partition* dst_partition = hash_partitions_[hash >> (64 - NUM_PARTITIONING_BITS)];
     if (!dst_partition->is_spilled()) {
       DCHECK_NOTNULL(dst_partition->hash_tbl.get());
       DCHECK(dst_partition->aggregated_row_stream->is_pinned());
@@ -158,3 +174,80 @@ Status PartitionedAggregationNode::ProcessBatch_true(
     RowBatch* batch, HashTableCtx* ht_ctx) {
   return ProcessBatch<true>(batch, ht_ctx);
 }
+
+Status PartitionedAggregationNode::ProcessBatchStreaming(RowBatch* in_batch,
+    RowBatch* out_batch, HashTableCtx* ht_ctx) {
+  DCHECK(is_streaming_preagg_);
+  DCHECK_EQ(out_batch->num_rows(), 0);
+  DCHECK_LE(in_batch->num_rows(), out_batch->capacity());
+
+  // Make room for the whole batch in the hash tables that may still grow, like
+  // ProcessBatch(). A partition whose hash table is not allowed to grow, or cannot get
+  // the memory to, stops expanding for good: streaming pre-aggregations never spill.
+  int num_rows = in_batch->num_rows();
+  for (int partition_idx = 0; partition_idx < PARTITION_FANOUT; ++partition_idx) {
+    Partition* partition = hash_partitions_[partition_idx];
+    if (partition->is_spilled() || !partition->is_expanding) continue;
+    if (!ShouldExpandPreaggHashTable(partition) ||
+        !partition->hash_tbl->CheckAndResize(num_rows, ht_ctx)) {
+      partition->is_expanding = false;
+      COUNTER_ADD(num_passthrough_partitions_, 1);
+    }
+  }
+
+  ht_ctx->ReserveRowCache(num_rows);
+  for (int i = 0; i < num_rows; ++i) {
+    uint64_t hash = 0;
+    if (!ht_ctx->EvalAndHashProbe(in_batch->GetRow(i), &hash)) {
+      ht_ctx->CacheRejectedRow(i);
+      continue;
+    }
+    ht_ctx->CacheCurrentRow(i, hash);
+    Partition* dst_partition = hash_partitions_[hash >> (64 - NUM_PARTITIONING_BITS)];
+    if (!dst_partition->is_spilled()) dst_partition->hash_tbl->PrefetchBucket(hash);
+  }
+
+  for (int i = 0; i < num_rows; ++i) {
+    TupleRow* row = in_batch->GetRow(i);
+    uint64_t hash = 0;
+    if (!ht_ctx->LoadCachedRow(i, &hash)) continue;
+
+    Partition* dst_partition = hash_partitions_[hash >> (64 - NUM_PARTITIONING_BITS)];
+    if (!dst_partition->is_spilled()) {
+      HashTable* ht = dst_partition->hash_tbl.get();
+      HashTable::Iterator it = ht->Find(ht_ctx, hash);
+      if (!it.AtEnd()) {
+        UpdateTuple(&dst_partition->agg_fn_ctxs[0], it.GetTuple(), row);
+        ++dst_partition->num_aggregated_rows;
+        continue;
+      }
+      if (dst_partition->is_expanding) {
+        Tuple* intermediate_tuple = ConstructIntermediateTuple(
+            dst_partition->agg_fn_ctxs, NULL, dst_partition->aggregated_row_stream.get());
+        if (intermediate_tuple != NULL && ht->Insert(ht_ctx, intermediate_tuple, hash)) {
+          UpdateTuple(&dst_partition->agg_fn_ctxs[0], intermediate_tuple, row);
+          ++dst_partition->num_aggregated_rows;
+          continue;
+        }
+        // The stream is out of memory. Stop growing this partition and pass the row
+        // through. A tuple that made it into the stream but not into the hash table is
+        // never returned.
+        RETURN_IF_ERROR(dst_partition->aggregated_row_stream->status());
+        dst_partition->is_expanding = false;
+        COUNTER_ADD(num_passthrough_partitions_, 1);
+      }
+    }
+
+    // Pass the row through as a group of its own. The grouping values are copied into
+    // the output batch and the intermediate values are fixed-length, so the tuple
+    // references no memory of the child's batch or of the agg fn contexts.
+    Tuple* intermediate_tuple =
+        ConstructIntermediateTuple(agg_fn_ctxs_, out_batch->tuple_data_pool(), NULL);
+    UpdateTuple(&agg_fn_ctxs_[0], intermediate_tuple, row);
+    int row_idx = out_batch->AddRow();
+    out_batch->GetRow(row_idx)->SetTuple(0, intermediate_tuple);
+    out_batch->CommitLastRow();
+  }
+
+  return Status::OK;
+}
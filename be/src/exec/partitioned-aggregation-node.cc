@@ -24,6 +24,7 @@
 #include "exec/hash-table.inline.h"
 #include "exprs/agg-fn-evaluator.h"
 #include "exprs/expr.h"
+#include "exprs/expr-column.h"
 #include "exprs/expr-context.h"
 #include "exprs/slot-ref.h"
 #include "runtime/buffered-tuple-stream.inline.h"
@@ -36,8 +37,10 @@
 #include "runtime/tuple.h"
 #include "runtime/tuple-row.h"
 #include "udf/udf-internal.h"
+#include "util/cpu-info.h"
 #include "util/debug-util.h"
 #include "util/runtime-profile.h"
+#include "util/thread.h"
 
 #include "gen-cpp/Exprs_types.h"
 #include "gen-cpp/PlanNodes_types.h"
@@ -48,8 +51,26 @@ using namespace llvm;
 using namespace std;
 using namespace strings;
 
+DEFINE_bool(enable_streaming_preaggregation, true, "If true, pre-aggregations "
+    "before an exchange stop growing hash tables that do not reduce their input enough "
+    "and pass the remaining rows through to the merge aggregation.");
+DEFINE_int64(streaming_preagg_max_ht_bytes, 0, "(Advanced) Size in bytes of the "
+    "buckets of a streaming pre-aggregation partition's hash table, past which it only "
+    "grows if it reduces its input by --streaming_preagg_min_reduction. If 0, the L2 "
+    "cache size is used.");
+DEFINE_double(streaming_preagg_min_reduction, 2.0, "(Advanced) Minimum ratio of input "
+    "rows to groups for a streaming pre-aggregation partition's hash table to grow "
+    "beyond --streaming_preagg_max_ht_bytes.");
+DEFINE_int32(aggregation_threads, 1, "(Advanced) Number of threads that aggregate the "
+    "input of a non-streaming aggregation with grouping into thread-local hash tables, "
+    "whose results are merged at the end. Threads beyond the first are only used if "
+    "thread tokens are available.");
+
 namespace impala {
 
+// Used if --streaming_preagg_max_ht_bytes is 0 and the L2 cache size is unknown.
+static const int64_t DEFAULT_STREAMING_HT_MAX_BYTES = 256 * 1024;
+
 const char* PartitionedAggregationNode::LLVM_CLASS_NAME =
     "class.impala::PartitionedAggregationNode";
 
@@ -62,19 +83,31 @@ PartitionedAggregationNode::PartitionedAggregationNode(
     output_tuple_desc_(NULL),
     needs_finalize_(tnode.agg_node.need_finalize),
     needs_serialize_(false),
+    is_streaming_preagg_(false),
+    streaming_ht_max_bytes_(0),
+    child_eos_(false),
     block_mgr_client_(NULL),
     using_small_buffers_(true),
     singleton_output_tuple_(NULL),
     singleton_output_tuple_returned_(true),
+    process_batch_columnar_(false),
+    is_worker_(false),
+    parent_(NULL),
+    input_eos_(false),
+    num_input_rows_(0),
     output_partition_(NULL),
     process_row_batch_fn_(NULL),
+    process_batch_streaming_fn_(NULL),
     build_timer_(NULL),
     get_results_timer_(NULL),
     num_hash_buckets_(NULL),
     partitions_created_(NULL),
     max_partition_level_(NULL),
     num_row_repartitioned_(NULL),
-    num_repartitions_(NULL) {
+    num_repartitions_(NULL),
+    streaming_timer_(NULL),
+    num_passthrough_rows_(NULL),
+    num_passthrough_partitions_(NULL) {
   DCHECK_EQ(PARTITION_FANOUT, 1 << NUM_PARTITIONING_BITS);
 }
 
@@ -88,6 +121,26 @@ Status PartitionedAggregationNode::Init(const TPlanNode& tnode) {
         pool_, tnode.agg_node.aggregate_functions[i], &evaluator));
     aggregate_evaluators_.push_back(evaluator);
   }
+  // Rows passed through are merged by the merge aggregation, so the output does not
+  // need to be aggregated fully. Conjuncts and limits are always moved to the merge
+  // aggregation for pre-aggregations.
+  is_streaming_preagg_ = FLAGS_enable_streaming_preaggregation &&
+      tnode.agg_node.__isset.is_preagg && tnode.agg_node.is_preagg &&
+      !needs_finalize_ && !probe_expr_ctxs_.empty() && conjunct_ctxs_.empty() &&
+      limit_ == -1;
+  if (FLAGS_aggregation_threads > 1 && !is_worker_ && !is_streaming_preagg_ &&
+      !probe_expr_ctxs_.empty()) {
+    // The workers only aggregate, the conjuncts, limit and finalization are applied
+    // by this node after merging their results.
+    worker_tnode_ = tnode;
+    worker_tnode_.conjuncts.clear();
+    worker_tnode_.limit = -1;
+    worker_tnode_.row_tuples.assign(1, tnode.agg_node.intermediate_tuple_id);
+    worker_tnode_.nullable_tuples.assign(1, false);
+    worker_tnode_.agg_node.output_tuple_id = tnode.agg_node.intermediate_tuple_id;
+    worker_tnode_.agg_node.need_finalize = false;
+    worker_tnode_.agg_node.__set_is_preagg(false);
+  }
   return Status::OK;
 }
 
@@ -174,7 +227,25 @@ Status PartitionedAggregationNode::Prepare(RuntimeState* state) {
         intermediate_slot_desc, output_slot_desc, agg_fn_pool_.get(), &agg_fn_ctx));
     agg_fn_ctxs_.push_back(agg_fn_ctx);
     state->obj_pool()->Add(agg_fn_ctx);
+    agg_intermediate_slot_descs_.push_back(intermediate_slot_desc);
     needs_serialize_ |= aggregate_evaluators_[i]->SupportsSerialize();
+    is_streaming_preagg_ &= !intermediate_slot_desc->type().IsVarLen();
+  }
+  is_streaming_preagg_ &= !needs_serialize_;
+  if (is_streaming_preagg_) {
+    streaming_ht_max_bytes_ = FLAGS_streaming_preagg_max_ht_bytes;
+    if (streaming_ht_max_bytes_ <= 0) {
+      streaming_ht_max_bytes_ = CpuInfo::CacheSize(CpuInfo::L2_CACHE);
+    }
+    if (streaming_ht_max_bytes_ <= 0) {
+      streaming_ht_max_bytes_ = DEFAULT_STREAMING_HT_MAX_BYTES;
+    }
+    streaming_timer_ = ADD_TIMER(runtime_profile(), "StreamingTime");
+    num_passthrough_rows_ =
+        ADD_COUNTER(runtime_profile(), "RowsPassedThrough", TUnit::UNIT);
+    num_passthrough_partitions_ =
+        ADD_COUNTER(runtime_profile(), "PassThroughPartitions", TUnit::UNIT);
+    AddRuntimeExecOption("Streaming Preaggregation");
   }
 
   if (probe_expr_ctxs_.empty()) {
@@ -183,6 +254,8 @@ Status PartitionedAggregationNode::Prepare(RuntimeState* state) {
     singleton_output_tuple_ =
         ConstructIntermediateTuple(agg_fn_ctxs_, mem_pool_.get(), NULL);
     singleton_output_tuple_returned_ = false;
+    process_batch_columnar_ = CanProcessBatchColumnar();
+    if (process_batch_columnar_) AddRuntimeExecOption("Columnar Aggregation");
   } else {
     ht_ctx_.reset(new HashTableCtx(build_expr_ctxs_, probe_expr_ctxs_, true, true,
         state->fragment_hash_seed(), MAX_PARTITION_DEPTH, 1));
@@ -191,16 +264,21 @@ Status PartitionedAggregationNode::Prepare(RuntimeState* state) {
     RETURN_IF_ERROR(CreateHashPartitions(0));
   }
 
-  if (state->codegen_enabled()) {
+  // The columnar path is not codegen'd.
+  if (state->codegen_enabled() && !process_batch_columnar_) {
     LlvmCodeGen* codegen;
     RETURN_IF_ERROR(state->GetCodegen(&codegen));
     Function* codegen_process_row_batch_fn = CodegenProcessBatch();
     if (codegen_process_row_batch_fn != NULL) {
-      codegen->AddFunctionToJit(codegen_process_row_batch_fn,
-          reinterpret_cast<void**>(&process_row_batch_fn_));
+      void** fn_ptr = is_streaming_preagg_ ?
+          reinterpret_cast<void**>(&process_batch_streaming_fn_) :
+          reinterpret_cast<void**>(&process_row_batch_fn_);
+      codegen->AddFunctionToJit(codegen_process_row_batch_fn, fn_ptr);
       AddRuntimeExecOption("Codegen Enabled");
     }
   }
+
+  if (!worker_tnode_.row_tuples.empty()) RETURN_IF_ERROR(CreateWorkers(state));
   return Status::OK;
 }
 
@@ -225,32 +303,36 @@ Status PartitionedAggregationNode::Open(RuntimeState* state) {
     DCHECK(serialize_stream_->has_write_block());
   }
 
-  // Read all the rows from the child and process them.
   RETURN_IF_ERROR(children_[0]->Open(state));
-  RowBatch batch(children_[0]->row_desc(), state->batch_size(), mem_tracker());
-  bool eos = false;
-  while (!eos) {
-    RETURN_IF_CANCELLED(state);
-    RETURN_IF_ERROR(QueryMaintenance(state));
-    RETURN_IF_ERROR(children_[0]->GetNext(state, &batch, &eos));
-
-    if (VLOG_ROW_IS_ON) {
-      for (int i = 0; i < batch.num_rows(); ++i) {
-        TupleRow* row = batch.GetRow(i);
-        VLOG_ROW << "input row: " << PrintRow(row, children_[0]->row_desc());
-      }
-    }
+  // A streaming pre-aggregation consumes the child's rows in GetNext().
+  if (is_streaming_preagg_) return Status::OK;
+
+  // Start the workers that have a thread token. This thread aggregates the input too,
+  // so the aggregation proceeds even if there are no tokens.
+  ThreadGroup worker_threads;
+  vector<Status> worker_status(workers_.size());
+  int num_started_workers = 0;
+  while (num_started_workers < workers_.size() &&
+      state->resource_pool()->TryAcquireThreadToken()) {
+    int i = num_started_workers++;
+    worker_threads.AddThread(new Thread("aggregation", Substitute("worker-$0", i),
+        &PartitionedAggregationNode::AggregationWorker, this, state, workers_[i],
+        &worker_status[i]));
+  }
+  if (num_started_workers > 0) {
+    AddRuntimeExecOption(
+        Substitute("Parallel Aggregation ($0 threads)", num_started_workers + 1));
+  }
 
-    SCOPED_TIMER(build_timer_);
-    if (process_row_batch_fn_ != NULL) {
-      RETURN_IF_ERROR(process_row_batch_fn_(this, &batch, ht_ctx_.get()));
-    } else if (probe_expr_ctxs_.empty()) {
-      RETURN_IF_ERROR(ProcessBatchNoGrouping(&batch));
-    } else {
-      // There is grouping, so we will do partitioned aggregation.
-      RETURN_IF_ERROR(ProcessBatch<false>(&batch, ht_ctx_.get()));
-    }
-    batch.Reset();
+  // Don't return before the workers are done, they use this node's child.
+  Status status = ConsumeInput(state);
+  if (!status.ok()) StopInput();
+  worker_threads.JoinAll();
+  FreeInputBatches();
+  RETURN_IF_ERROR(status);
+  for (int i = 0; i < num_started_workers; ++i) {
+    RETURN_IF_ERROR(worker_status[i]);
+    RETURN_IF_ERROR(MergeWorkerOutput(state, workers_[i]));
   }
 
   // We have consumed all of the input from the child and transfered ownership of the
@@ -261,12 +343,207 @@ Status PartitionedAggregationNode::Open(RuntimeState* state) {
   // to spilled_partitions_/aggregated_partitions_. We'll finish the processing in
   // GetNext().
   if (!probe_expr_ctxs_.empty()) {
-    RETURN_IF_ERROR(MoveHashPartitions(child(0)->rows_returned()));
+    RETURN_IF_ERROR(MoveHashPartitions(num_input_rows_));
   }
 
   return Status::OK;
 }
 
+Status PartitionedAggregationNode::ConsumeInput(RuntimeState* state) {
+  if (!is_worker_ && workers_.empty()) {
+    RowBatch batch(children_[0]->row_desc(), state->batch_size(), mem_tracker());
+    bool eos = false;
+    while (!eos) {
+      RETURN_IF_CANCELLED(state);
+      RETURN_IF_ERROR(QueryMaintenance(state));
+      RETURN_IF_ERROR(children_[0]->GetNext(state, &batch, &eos));
+      RETURN_IF_ERROR(ProcessInputBatch(&batch));
+      batch.Reset();
+    }
+    return Status::OK;
+  }
+
+  // Several threads consume the batches of the same child, see GetNextInputBatch().
+  PartitionedAggregationNode* source = is_worker_ ? parent_ : this;
+  while (true) {
+    RETURN_IF_CANCELLED(state);
+    RETURN_IF_ERROR(QueryMaintenance(state));
+    RowBatch* batch;
+    RETURN_IF_ERROR(source->GetNextInputBatch(state, &batch));
+    if (batch == NULL) break;
+    Status status = ProcessInputBatch(batch);
+    source->ReleaseInputBatch(batch);
+    RETURN_IF_ERROR(status);
+  }
+  return Status::OK;
+}
+
+Status PartitionedAggregationNode::ProcessInputBatch(RowBatch* batch) {
+  if (VLOG_ROW_IS_ON) {
+    for (int i = 0; i < batch->num_rows(); ++i) {
+      TupleRow* row = batch->GetRow(i);
+      VLOG_ROW << "input row: " << PrintRow(row, children_[0]->row_desc());
+    }
+  }
+
+  SCOPED_TIMER(build_timer_);
+  num_input_rows_ += batch->num_rows();
+  if (process_batch_columnar_) {
+    ProcessBatchColumnar(batch);
+  } else if (process_row_batch_fn_ != NULL) {
+    RETURN_IF_ERROR(process_row_batch_fn_(this, batch, ht_ctx_.get()));
+  } else if (probe_expr_ctxs_.empty()) {
+    RETURN_IF_ERROR(ProcessBatchNoGrouping(batch));
+  } else {
+    // There is grouping, so we will do partitioned aggregation.
+    RETURN_IF_ERROR(ProcessBatch<false>(batch, ht_ctx_.get()));
+  }
+  return Status::OK;
+}
+
+// Child of the workers of a parallel aggregation. It has the row descriptor of the
+// child of the aggregation that created the workers, whose batches the workers get
+// from GetNextInputBatch(), so it never returns rows itself.
+class PartitionedAggregationNode::SharedInputNode : public ExecNode {
+ public:
+  SharedInputNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs)
+    : ExecNode(pool, tnode, descs) {
+  }
+
+  virtual Status GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
+    DCHECK(false) << "The input of a worker is returned by GetNextInputBatch()";
+    *eos = true;
+    return Status::OK;
+  }
+};
+
+Status PartitionedAggregationNode::CreateWorkers(RuntimeState* state) {
+  TPlanNode input_tnode;
+  input_tnode.node_id = id_;
+  input_tnode.node_type = type_;
+  input_tnode.num_children = 0;
+  input_tnode.limit = -1;
+  const RowDescriptor& input_desc = child(0)->row_desc();
+  for (int i = 0; i < input_desc.tuple_descriptors().size(); ++i) {
+    input_tnode.row_tuples.push_back(input_desc.tuple_descriptors()[i]->id());
+    input_tnode.nullable_tuples.push_back(input_desc.TupleIsNullable(i));
+  }
+
+  for (int i = 1; i < FLAGS_aggregation_threads; ++i) {
+    PartitionedAggregationNode* worker = pool_->Add(
+        new PartitionedAggregationNode(pool_, worker_tnode_, state->desc_tbl()));
+    // Added before it is prepared, so that Close() closes it on all paths.
+    workers_.push_back(worker);
+    worker->is_worker_ = true;
+    worker->parent_ = this;
+    RETURN_IF_ERROR(worker->Init(worker_tnode_));
+    worker->children_.push_back(pool_->Add(
+        new SharedInputNode(pool_, input_tnode, state->desc_tbl())));
+    RETURN_IF_ERROR(worker->Prepare(state));
+    runtime_profile()->AddChild(worker->runtime_profile());
+  }
+  return Status::OK;
+}
+
+Status PartitionedAggregationNode::GetNextInputBatch(RuntimeState* state,
+    RowBatch** batch) {
+  DCHECK(!workers_.empty());
+  *batch = NULL;
+  unique_lock<mutex> l(input_lock_);
+  // Each thread holds at most one unprocessed batch, so the front batch is released
+  // eventually.
+  while (!input_eos_ && input_batches_.size() >= 2 * (workers_.size() + 1)) {
+    input_batch_released_cv_.wait(l);
+  }
+  if (input_eos_) return Status::OK;
+
+  RowBatch* next_batch;
+  if (free_input_batches_.empty()) {
+    next_batch = new RowBatch(children_[0]->row_desc(), state->batch_size(),
+        mem_tracker());
+  } else {
+    next_batch = free_input_batches_.back();
+    free_input_batches_.pop_back();
+  }
+  InputBatch input_batch;
+  input_batch.batch = next_batch;
+  input_batch.processed = false;
+  input_batches_.push_back(input_batch);
+
+  Status status = children_[0]->GetNext(state, next_batch, &input_eos_);
+  if (!status.ok()) {
+    input_eos_ = true;
+    input_batch_released_cv_.notify_all();
+    // The batch is freed with the others.
+    return status;
+  }
+  if (input_eos_) input_batch_released_cv_.notify_all();
+  // The last batch may have rows too.
+  *batch = next_batch;
+  return Status::OK;
+}
+
+void PartitionedAggregationNode::ReleaseInputBatch(RowBatch* batch) {
+  lock_guard<mutex> l(input_lock_);
+  deque<InputBatch>::iterator it = input_batches_.begin();
+  while (it->batch != batch) {
+    ++it;
+    DCHECK(it != input_batches_.end());
+  }
+  it->processed = true;
+  bool released = false;
+  while (!input_batches_.empty() && input_batches_.front().processed) {
+    RowBatch* front = input_batches_.front().batch;
+    front->Reset();
+    free_input_batches_.push_back(front);
+    input_batches_.pop_front();
+    released = true;
+  }
+  if (released) input_batch_released_cv_.notify_all();
+}
+
+void PartitionedAggregationNode::StopInput() {
+  lock_guard<mutex> l(input_lock_);
+  input_eos_ = true;
+  input_batch_released_cv_.notify_all();
+}
+
+void PartitionedAggregationNode::FreeInputBatches() {
+  lock_guard<mutex> l(input_lock_);
+  for (int i = 0; i < input_batches_.size(); ++i) delete input_batches_[i].batch;
+  input_batches_.clear();
+  for (int i = 0; i < free_input_batches_.size(); ++i) delete free_input_batches_[i];
+  free_input_batches_.clear();
+}
+
+void PartitionedAggregationNode::AggregationWorker(RuntimeState* state,
+    PartitionedAggregationNode* worker, Status* status) {
+  {
+    SCOPED_TIMER(state->total_cpu_timer());
+    SCOPED_TIMER(runtime_profile()->total_async_timer());
+    *status = worker->Open(state);
+  }
+  if (!status->ok()) StopInput();
+  state->resource_pool()->ReleaseThreadToken(false);
+}
+
+Status PartitionedAggregationNode::MergeWorkerOutput(RuntimeState* state,
+    PartitionedAggregationNode* worker) {
+  RowBatch batch(worker->row_desc(), state->batch_size(), mem_tracker());
+  bool eos = false;
+  while (!eos) {
+    RETURN_IF_CANCELLED(state);
+    RETURN_IF_ERROR(QueryMaintenance(state));
+    RETURN_IF_ERROR(worker->GetNext(state, &batch, &eos));
+    SCOPED_TIMER(build_timer_);
+    num_input_rows_ += batch.num_rows();
+    RETURN_IF_ERROR(ProcessBatch<true>(&batch, ht_ctx_.get()));
+    batch.Reset();
+  }
+  worker->Close(state);
+  return Status::OK;
+}
+
 Status PartitionedAggregationNode::GetNext(RuntimeState* state,
     RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
@@ -279,6 +556,17 @@ Status PartitionedAggregationNode::GetNext(RuntimeState* state,
     return Status::OK;
   }
 
+  if (is_streaming_preagg_ && !child_eos_) {
+    RETURN_IF_ERROR(GetRowsStreaming(state, row_batch));
+    if (row_batch->num_rows() > 0) {
+      num_rows_returned_ += row_batch->num_rows();
+      COUNTER_SET(rows_returned_counter_, num_rows_returned_);
+      *eos = false;
+      return Status::OK;
+    }
+    DCHECK(child_eos_);
+  }
+
   ExprContext** ctxs = &conjunct_ctxs_[0];
   int num_ctxs = conjunct_ctxs_.size();
   if (probe_expr_ctxs_.empty()) {
@@ -348,6 +636,53 @@ Status PartitionedAggregationNode::GetNext(RuntimeState* state,
   return Status::OK;
 }
 
+Status PartitionedAggregationNode::GetRowsStreaming(RuntimeState* state,
+    RowBatch* out_batch) {
+  DCHECK(!child_eos_);
+  DCHECK_EQ(out_batch->num_rows(), 0);
+  if (child_batch_.get() == NULL) {
+    child_batch_.reset(
+        new RowBatch(child(0)->row_desc(), state->batch_size(), mem_tracker()));
+  }
+
+  do {
+    RETURN_IF_CANCELLED(state);
+    RETURN_IF_ERROR(QueryMaintenance(state));
+    RETURN_IF_ERROR(child(0)->GetNext(state, child_batch_.get(), &child_eos_));
+
+    SCOPED_TIMER(streaming_timer_);
+    // The rows passed through to 'out_batch' are copied into its pool, so the child's
+    // batch can be reset right away.
+    if (process_batch_streaming_fn_ != NULL) {
+      RETURN_IF_ERROR(process_batch_streaming_fn_(this, child_batch_.get(), out_batch,
+          ht_ctx_.get()));
+    } else {
+      RETURN_IF_ERROR(ProcessBatchStreaming(child_batch_.get(), out_batch,
+          ht_ctx_.get()));
+    }
+    child_batch_->Reset();
+  } while (out_batch->num_rows() == 0 && !child_eos_);
+  COUNTER_ADD(num_passthrough_rows_, out_batch->num_rows());
+
+  if (child_eos_) {
+    child_batch_.reset();
+    child(0)->Close(state);
+    RETURN_IF_ERROR(MoveHashPartitions(num_input_rows_));
+  }
+  return Status::OK;
+}
+
+bool PartitionedAggregationNode::ShouldExpandPreaggHashTable(
+    const Partition* partition) const {
+  // While the buckets fit in the cache, probing is cheap enough that any reduction is
+  // worth it. Beyond that most probes miss the cache and the hash table has to earn its
+  // keep by shrinking the data sent to the merge aggregation.
+  const HashTable* ht = partition->hash_tbl.get();
+  if (ht->CurrentMemSize() < streaming_ht_max_bytes_ || ht->size() == 0) return true;
+  double reduction = static_cast<double>(partition->num_aggregated_rows) / ht->size();
+  return reduction >= FLAGS_streaming_preagg_min_reduction;
+}
+
 void PartitionedAggregationNode::CleanupHashTbl(const vector<FunctionContext*>& ctxs,
     HashTable::Iterator it) {
   if (!needs_finalize_ && !needs_serialize_) return;
@@ -362,6 +697,9 @@ void PartitionedAggregationNode::CleanupHashTbl(const vector<FunctionContext*>&
 void PartitionedAggregationNode::Close(RuntimeState* state) {
   if (is_closed()) return;
 
+  for (int i = 0; i < workers_.size(); ++i) workers_[i]->Close(state);
+  FreeInputBatches();
+
   if (!singleton_output_tuple_returned_) {
     DCHECK_EQ(agg_fn_ctxs_.size(), aggregate_evaluators_.size());
     FinalizeTuple(agg_fn_ctxs_, singleton_output_tuple_, mem_pool_.get());
@@ -398,6 +736,7 @@ void PartitionedAggregationNode::Close(RuntimeState* state) {
   if (mem_pool_.get() != NULL) mem_pool_->FreeAll();
   if (ht_ctx_.get() != NULL) ht_ctx_->Close();
   if (serialize_stream_.get() != NULL) serialize_stream_->Close();
+  child_batch_.reset();
 
   if (block_mgr_client_ != NULL) {
     state->block_mgr()->ClearReservations(block_mgr_client_);
@@ -435,14 +774,13 @@ Status PartitionedAggregationNode::Partition::InitStreams() {
 
 bool PartitionedAggregationNode::Partition::InitHashTable() {
   DCHECK(hash_tbl.get() == NULL);
-  // We use the upper PARTITION_FANOUT num bits to pick the partition so only the
-  // remaining bits can be used for the hash table.
+  // We use the upper NUM_PARTITIONING_BITS bits of the 64-bit hash to pick the
+  // partition and the hash table uses the low bits, so the number of buckets does not
+  // need to be capped.
   // TODO: how many buckets?
-  // TODO: we could switch to 64 bit hashes and then we don't need a max size.
   // It might be reasonable to limit individual hash table size for other reasons
   // though. Always start with small buffers.
-  hash_tbl.reset(new HashTable(parent->state_, parent->block_mgr_client_, 1, NULL,
-      1 << (32 - NUM_PARTITIONING_BITS)));
+  hash_tbl.reset(new HashTable(parent->state_, parent->block_mgr_client_, 1, NULL, -1));
   return hash_tbl->Init();
 }
 
@@ -579,8 +917,7 @@ Tuple* PartitionedAggregationNode::ConstructIntermediateTuple(
   Tuple* intermediate_tuple = NULL;
   uint8_t* buffer = NULL;
   if (pool != NULL) {
-    intermediate_tuple = Tuple::Create(
-        intermediate_tuple_desc_->byte_size(), mem_pool_.get());
+    intermediate_tuple = Tuple::Create(intermediate_tuple_desc_->byte_size(), pool);
   } else {
     // Figure out how big it will be to copy the entire tuple. We need the tuple to end
     // up on one block in the stream.
@@ -668,6 +1005,134 @@ void PartitionedAggregationNode::UpdateTuple(FunctionContext** agg_fn_ctxs,
   }
 }
 
+bool PartitionedAggregationNode::CanProcessBatchColumnar() const {
+  if (!probe_expr_ctxs_.empty() || singleton_output_tuple_ == NULL) return false;
+  for (int i = 0; i < aggregate_evaluators_.size(); ++i) {
+    AggFnEvaluator* evaluator = aggregate_evaluators_[i];
+    const ColumnType& slot_type = agg_intermediate_slot_descs_[i]->type();
+    if (!evaluator->is_builtin()) return false;
+    if (evaluator->is_count_star()) continue;
+    if (evaluator->input_expr_ctxs().size() != 1) return false;
+    const ColumnType& input_type = evaluator->input_expr_ctxs()[0]->root()->type();
+    if (!ExprColumn::IsSupportedType(input_type)) return false;
+    switch (evaluator->agg_op()) {
+      case AggFnEvaluator::COUNT:
+        // A merging COUNT sums up counts.
+        if (slot_type.type != TYPE_BIGINT) return false;
+        if (evaluator->is_merge() && input_type.type != TYPE_BIGINT) return false;
+        break;
+      case AggFnEvaluator::MIN:
+      case AggFnEvaluator::MAX:
+        if (input_type != slot_type || input_type.type == TYPE_BOOLEAN) return false;
+        break;
+      case AggFnEvaluator::SUM:
+        // Only integers, which are summed up as BIGINT. Floating point sums are left to
+        // the row path because ExprColumn::SumValues() would change their rounding.
+        if (input_type.type == TYPE_BOOLEAN || input_type.type == TYPE_FLOAT ||
+            input_type.type == TYPE_DOUBLE || slot_type.type != TYPE_BIGINT) {
+          return false;
+        }
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+template <bool IS_MIN>
+static int MinMaxColumn(const ExprColumn& column, const ColumnType& type, int num_rows,
+    bool* dst_is_null, void* dst) {
+  switch (type.type) {
+    case TYPE_TINYINT:
+      return column.MinMaxValues<int8_t, IS_MIN>(
+          num_rows, dst_is_null, reinterpret_cast<int8_t*>(dst));
+    case TYPE_SMALLINT:
+      return column.MinMaxValues<int16_t, IS_MIN>(
+          num_rows, dst_is_null, reinterpret_cast<int16_t*>(dst));
+    case TYPE_INT:
+      return column.MinMaxValues<int32_t, IS_MIN>(
+          num_rows, dst_is_null, reinterpret_cast<int32_t*>(dst));
+    case TYPE_BIGINT:
+      return column.MinMaxValues<int64_t, IS_MIN>(
+          num_rows, dst_is_null, reinterpret_cast<int64_t*>(dst));
+    case TYPE_FLOAT:
+      return column.MinMaxValues<float, IS_MIN>(
+          num_rows, dst_is_null, reinterpret_cast<float*>(dst));
+    case TYPE_DOUBLE:
+      return column.MinMaxValues<double, IS_MIN>(
+          num_rows, dst_is_null, reinterpret_cast<double*>(dst));
+    default:
+      DCHECK(false) << type;
+      return 0;
+  }
+}
+
+static int SumColumn(const ExprColumn& column, const ColumnType& type, int num_rows,
+    void* dst) {
+  int64_t* sum = reinterpret_cast<int64_t*>(dst);
+  switch (type.type) {
+    case TYPE_TINYINT: return column.SumValues<int8_t>(num_rows, sum);
+    case TYPE_SMALLINT: return column.SumValues<int16_t>(num_rows, sum);
+    case TYPE_INT: return column.SumValues<int32_t>(num_rows, sum);
+    case TYPE_BIGINT: return column.SumValues<int64_t>(num_rows, sum);
+    default:
+      DCHECK(false) << type;
+      return 0;
+  }
+}
+
+void PartitionedAggregationNode::ProcessBatchColumnar(RowBatch* batch) {
+  DCHECK(process_batch_columnar_);
+  int num_rows = batch->num_rows();
+  if (num_rows == 0) return;
+  Tuple* tuple = singleton_output_tuple_;
+  for (int i = 0; i < aggregate_evaluators_.size(); ++i) {
+    AggFnEvaluator* evaluator = aggregate_evaluators_[i];
+    const SlotDescriptor* slot_desc = agg_intermediate_slot_descs_[i];
+    void* slot = tuple->GetSlot(slot_desc->tuple_offset());
+    if (evaluator->is_count_star()) {
+      *reinterpret_cast<int64_t*>(slot) += num_rows;
+      continue;
+    }
+    ExprContext* input_ctx = evaluator->input_expr_ctxs()[0];
+    const ColumnType& input_type = input_ctx->root()->type();
+    const ExprColumn& input = *input_ctx->EvalBatch(batch, NULL, num_rows);
+    int num_not_null = 0;
+    // The MIN and MAX slots were set to the largest and smallest value of the type by
+    // ConstructIntermediateTuple() but are NULL until the first value is seen.
+    bool is_null =
+        slot_desc->is_nullable() && tuple->IsNull(slot_desc->null_indicator_offset());
+    switch (evaluator->agg_op()) {
+      case AggFnEvaluator::COUNT:
+        if (evaluator->is_merge()) {
+          input.SumValues<int64_t>(num_rows, reinterpret_cast<int64_t*>(slot));
+        } else {
+          const uint8_t* input_is_null = input.is_null();
+          int64_t count = 0;
+          for (int j = 0; j < num_rows; ++j) count += !input_is_null[j];
+          *reinterpret_cast<int64_t*>(slot) += count;
+        }
+        // The count is never NULL.
+        continue;
+      case AggFnEvaluator::SUM:
+        num_not_null = SumColumn(input, input_type, num_rows, slot);
+        break;
+      case AggFnEvaluator::MIN:
+        num_not_null = MinMaxColumn<true>(input, input_type, num_rows, &is_null, slot);
+        break;
+      case AggFnEvaluator::MAX:
+        num_not_null = MinMaxColumn<false>(input, input_type, num_rows, &is_null, slot);
+        break;
+      default:
+        DCHECK(false) << evaluator->agg_op();
+    }
+    if (num_not_null > 0 && slot_desc->is_nullable()) {
+      tuple->SetNotNull(slot_desc->null_indicator_offset());
+    }
+  }
+}
+
 Tuple* PartitionedAggregationNode::FinalizeTuple(
     const vector<FunctionContext*>& agg_fn_ctxs, Tuple* tuple, MemPool* pool) {
   DCHECK(tuple != NULL || aggregate_evaluators_.empty()) << tuple;
@@ -1345,9 +1810,12 @@ Function* PartitionedAggregationNode::CodegenProcessBatch() {
   if (update_tuple_fn == NULL) return NULL;
 
   // Get the cross compiled update row batch function
-  IRFunction::Type ir_fn = (!probe_expr_ctxs_.empty() ?
-      IRFunction::PART_AGG_NODE_PROCESS_BATCH_FALSE :
-      IRFunction::PART_AGG_NODE_PROCESS_BATCH_NO_GROUPING);
+  IRFunction::Type ir_fn = IRFunction::PART_AGG_NODE_PROCESS_BATCH_NO_GROUPING;
+  if (is_streaming_preagg_) {
+    ir_fn = IRFunction::PART_AGG_NODE_PROCESS_BATCH_STREAMING;
+  } else if (!probe_expr_ctxs_.empty()) {
+    ir_fn = IRFunction::PART_AGG_NODE_PROCESS_BATCH_FALSE;
+  }
   Function* process_batch_fn = codegen->GetFunction(ir_fn);
   DCHECK(process_batch_fn != NULL);
 
@@ -1356,9 +1824,7 @@ Function* PartitionedAggregationNode::CodegenProcessBatch() {
     // Aggregation w/o grouping does not use a hash table.
 
     // Codegen for hash
-    // The codegen'd ProcessBatch function is only used in Open() with level_ = 0,
-    // so don't use murmur hash
-    Function* hash_fn = ht_ctx_->CodegenHashCurrentRow(state_, /* use murmur */ false);
+    Function* hash_fn = ht_ctx_->CodegenHashCurrentRow(state_);
     if (hash_fn == NULL) return NULL;
 
     // Codegen HashTable::Equals
@@ -1378,9 +1844,11 @@ Function* PartitionedAggregationNode::CodegenProcessBatch() {
         hash_fn, "HashCurrentRow", &replaced);
     DCHECK_EQ(replaced, 1);
 
+    // ProcessBatchStreaming() has one Find() and one Insert(), ProcessBatch() retries
+    // the Insert() after spilling.
     process_batch_fn = codegen->ReplaceCallSites(process_batch_fn, true,
         equals_fn, "Equals", &replaced);
-    DCHECK_EQ(replaced, 3);
+    DCHECK_EQ(replaced, is_streaming_preagg_ ? 2 : 3);
   }
 
   process_batch_fn = codegen->ReplaceCallSites(process_batch_fn, false,
@@ -16,8 +16,11 @@
 #ifndef IMPALA_EXEC_PARTITIONED_AGGREGATION_NODE_H
 #define IMPALA_EXEC_PARTITIONED_AGGREGATION_NODE_H
 
+#include <deque>
 #include <functional>
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "exec/exec-node.h"
 #include "exec/hash-table.h"
@@ -77,6 +80,18 @@ class SlotDescriptor;
 // hash tables will use smaller (less than io-sized) buffers. Once we spill, the streams
 // and hash table will use io-sized buffers only.
 //
+// Streaming pre-aggregation: the first phase of a two-phase aggregation (the plan marks
+// it as a pre-aggregation) only needs to reduce the rows sent to the merge aggregation,
+// so it does not have to aggregate its input fully. In that case the child's rows are
+// consumed in GetNext() rather than Open(). Each partition's hash table may grow until
+// its buckets no longer fit in the cache (--streaming_preagg_max_ht_bytes). Past that it
+// only keeps growing while the partition reduces its input by at least
+// --streaming_preagg_min_reduction. Once a partition stops growing, rows that do not
+// match a group in its hash table are returned right away as single-row groups in the
+// intermediate format, instead of being inserted or spilled. Streaming pre-aggregations
+// never spill. After the child's input is exhausted, the aggregated groups in the hash
+// tables are returned as usual.
+//
 // TODO: Buffer rows before probing into the hash table?
 // TODO: after spilling, we can still maintain a very small hash table just to remove
 // some number of rows (from likely going to disk).
@@ -109,6 +124,7 @@ class PartitionedAggregationNode : public ExecNode {
 
  private:
   struct Partition;
+  class SharedInputNode;
 
   // Number of initial partitions to create. Must be a power of 2.
   static const int PARTITION_FANOUT = 16;
@@ -149,6 +165,24 @@ class PartitionedAggregationNode : public ExecNode {
   // Contains any evaluators that require the serialize step.
   bool needs_serialize_;
 
+  // True if this node is a streaming pre-aggregation, see the class comment. Only set
+  // if the plan marked this node as a pre-aggregation, --enable_streaming_preaggregation
+  // is set and the intermediate values of all aggregate functions are fixed-length
+  // slots that need no serialize step, so rows can be passed through without memory
+  // from the agg fn contexts.
+  // TODO: pass through aggregate functions with var-len intermediates by copying the
+  // serialized values into the output batch.
+  bool is_streaming_preagg_;
+
+  // Streaming pre-aggregation only. Bytes a partition's hash table may grow to before
+  // it needs to reduce its input to keep growing.
+  int64_t streaming_ht_max_bytes_;
+
+  // Streaming pre-aggregation only. Batch of child rows and whether all child rows
+  // have been consumed.
+  boost::scoped_ptr<RowBatch> child_batch_;
+  bool child_eos_;
+
   std::vector<AggFnEvaluator*> aggregate_evaluators_;
 
   // FunctionContext for each aggregate function and backing MemPool. String data returned
@@ -183,6 +217,62 @@ class PartitionedAggregationNode : public ExecNode {
   Tuple* singleton_output_tuple_;
   bool singleton_output_tuple_returned_;
 
+  // Intermediate slots of aggregate_evaluators_, in the same order.
+  std::vector<SlotDescriptor*> agg_intermediate_slot_descs_;
+
+  // True if the input batches are aggregated column by column by
+  // ProcessBatchColumnar() instead of row by row. Set in Prepare(), see
+  // CanProcessBatchColumnar().
+  bool process_batch_columnar_;
+
+  // True if this node is one of the workers_ of another aggregation.
+  bool is_worker_;
+
+  // The aggregation that created this worker. NULL unless is_worker_.
+  PartitionedAggregationNode* parent_;
+
+  // Copy of the plan node for the workers of a parallel aggregation, which output
+  // unfinalized intermediate tuples and have no conjuncts or limit. Only set if
+  // --aggregation_threads > 1.
+  TPlanNode worker_tnode_;
+
+  // Aggregations with their own hash tables that consume the child's batches in
+  // parallel with this node, if thread tokens are available. Their results are merged
+  // into this node's partitions at the end of Open(). Empty unless the aggregation has
+  // grouping and --aggregation_threads > 1, see CreateWorkers().
+  std::vector<PartitionedAggregationNode*> workers_;
+
+  // Protects the members below, and serializes the calls to the child's GetNext() from
+  // this node and workers_. The child returned eos or an error, or a worker failed,
+  // once input_eos_ is set.
+  boost::mutex input_lock_;
+  bool input_eos_;
+
+  // A batch of the child handed out by GetNextInputBatch().
+  struct InputBatch {
+    RowBatch* batch;
+    // Set by ReleaseInputBatch().
+    bool processed;
+  };
+
+  // The batches handed out by GetNextInputBatch() that are not reset yet, in the
+  // order they were returned by the child. Rows of a batch may reference resources
+  // that the child attached to a later batch (e.g. the io buffers of a scanner or the
+  // tuple data of an exchange), so a batch is only reset once it and all earlier
+  // batches are processed. Only used if there are workers_.
+  std::deque<InputBatch> input_batches_;
+
+  // Reset batches that GetNextInputBatch() reuses. Owned by this node.
+  std::vector<RowBatch*> free_input_batches_;
+
+  // Signalled when ReleaseInputBatch() resets batches or the input stops.
+  // GetNextInputBatch() waits on it while input_batches_ is full, so that a slow
+  // thread doesn't make the others accumulate batches without bound.
+  boost::condition_variable input_batch_released_cv_;
+
+  // Number of rows this node (or worker) aggregated in ConsumeInput().
+  int64_t num_input_rows_;
+
   // MemPool used to allocate memory for when we don't have grouping and don't initialize
   // the partitioning structures, or during Close() when creating new output tuples.
   boost::scoped_ptr<MemPool> mem_pool_;
@@ -202,6 +292,12 @@ class PartitionedAggregationNode : public ExecNode {
   // Jitted ProcessRowBatch function pointer.  Null if codegen is disabled.
   ProcessRowBatchFn process_row_batch_fn_;
 
+  typedef Status (*ProcessBatchStreamingFn)(
+      PartitionedAggregationNode*, RowBatch*, RowBatch*, HashTableCtx*);
+  // Jitted ProcessBatchStreaming function pointer. Null if codegen is disabled or this
+  // is not a streaming pre-aggregation.
+  ProcessBatchStreamingFn process_batch_streaming_fn_;
+
   // Time spent processing the child rows
   RuntimeProfile::Counter* build_timer_;
 
@@ -230,9 +326,20 @@ class PartitionedAggregationNode : public ExecNode {
   // 1 / PARTITION_FANOUT. A value much larger indicates skew.
   RuntimeProfile::HighWaterMarkCounter* largest_partition_percent_;
 
+  // Time spent processing the child rows in a streaming pre-aggregation.
+  RuntimeProfile::Counter* streaming_timer_;
+
+  // Number of rows a streaming pre-aggregation returned without aggregating them.
+  RuntimeProfile::Counter* num_passthrough_rows_;
+
+  // Number of partitions of a streaming pre-aggregation whose hash table stopped
+  // growing.
+  RuntimeProfile::Counter* num_passthrough_partitions_;
+
   struct Partition {
     Partition(PartitionedAggregationNode* parent, int level)
-      : parent(parent), is_closed(false), level(level) {}
+      : parent(parent), is_closed(false), level(level), is_expanding(true),
+        num_aggregated_rows(0) {}
 
     // Initializes aggregated_row_stream and unaggregated_row_stream, reserving
     // one buffer for each. The buffers backing these streams are reserved, so this
@@ -283,6 +390,14 @@ class PartitionedAggregationNode : public ExecNode {
 
     // Unaggregated rows that are spilled.
     boost::scoped_ptr<BufferedTupleStream> unaggregated_row_stream;
+
+    // Streaming pre-aggregation only. False once the hash table has stopped growing
+    // and rows that miss it are passed through.
+    bool is_expanding;
+
+    // Streaming pre-aggregation only. Number of input rows aggregated into the hash
+    // table, used to compute its reduction.
+    int64_t num_aggregated_rows;
   };
 
   // Current partitions we are partitioning into.
@@ -338,6 +453,54 @@ class PartitionedAggregationNode : public ExecNode {
   // ProcessBatch() for codegen. This function is replaced by codegen.
   Status ProcessBatchNoGrouping(RowBatch* batch, HashTableCtx* ht_ctx = NULL);
 
+  // Returns true if ProcessBatchColumnar() can be used: there is no grouping and all
+  // aggregate functions are builtin COUNT, MIN or MAX or integer SUM over a single input
+  // whose type is supported by ExprColumn.
+  bool CanProcessBatchColumnar() const;
+
+  // Alternative to ProcessBatchNoGrouping() that aggregates the rows of 'batch' one
+  // aggregate function at a time. The input expr of each function is evaluated over
+  // the whole batch with Expr::EvalBatch() into a column of values, which is reduced
+  // into singleton_output_tuple_ with a loop the compiler can vectorize.
+  void ProcessBatchColumnar(RowBatch* batch);
+
+  // Creates --aggregation_threads - 1 workers_ and prepares them. Each worker is a copy
+  // of this node that aggregates batches of this node's child, which it gets from
+  // GetNextInputBatch(). The child of a worker is a SharedInputNode, which only
+  // provides the row descriptor.
+  Status CreateWorkers(RuntimeState* state);
+
+  // Sets 'batch' to the next batch of the child, or to NULL once the child returned
+  // eos, or the input was stopped. The batch must be passed to ReleaseInputBatch()
+  // when it is processed. Thread-safe, only used if there are workers_.
+  Status GetNextInputBatch(RuntimeState* state, RowBatch** batch);
+
+  // Marks 'batch' as processed, and resets the batches at the front of input_batches_
+  // that are processed, i.e. whose rows and the rows of all earlier batches are no
+  // longer referenced.
+  void ReleaseInputBatch(RowBatch* batch);
+
+  // Makes GetNextInputBatch() return NULL, so that the workers stop after an error.
+  void StopInput();
+
+  // Frees the batches in input_batches_ and free_input_batches_.
+  void FreeInputBatches();
+
+  // Aggregates the batches of the child (or of the parent_'s child if this is a
+  // worker) into hash_partitions_ (or the singleton tuple) until eos.
+  Status ConsumeInput(RuntimeState* state);
+
+  // Aggregates the rows of one input batch.
+  Status ProcessInputBatch(RowBatch* batch);
+
+  // Thread function that opens 'worker', i.e. aggregates its share of the input.
+  void AggregationWorker(RuntimeState* state, PartitionedAggregationNode* worker,
+      Status* status);
+
+  // Merges the intermediate tuples returned by the opened 'worker' into
+  // hash_partitions_ and closes it.
+  Status MergeWorkerOutput(RuntimeState* state, PartitionedAggregationNode* worker);
+
   // Processes a batch of rows. This is the core function of the algorithm. We partition
   // the rows into hash_partitions_, spilling as necessary.
   // If AGGREGATED_ROWS is true, it means that the rows in the batch are already
@@ -348,6 +511,25 @@ class PartitionedAggregationNode : public ExecNode {
   template<bool AGGREGATED_ROWS>
   Status IR_ALWAYS_INLINE ProcessBatch(RowBatch* batch, HashTableCtx* ht_ctx);
 
+  // Streaming pre-aggregation version of ProcessBatch(). Aggregates the rows of
+  // 'in_batch' that match or can be inserted into the hash tables of hash_partitions_
+  // and adds the other rows to 'out_batch' as intermediate tuples. 'out_batch' must be
+  // empty and have room for all rows of 'in_batch'. This function is replaced by
+  // codegen.
+  Status ProcessBatchStreaming(RowBatch* in_batch, RowBatch* out_batch,
+      HashTableCtx* ht_ctx);
+
+  // Returns true if the hash table of 'partition' of a streaming pre-aggregation may
+  // grow further: either it still fits in streaming_ht_max_bytes_ or it reduces its
+  // input by at least --streaming_preagg_min_reduction.
+  bool ShouldExpandPreaggHashTable(const Partition* partition) const;
+
+  // Streaming pre-aggregation only. Consumes child batches with
+  // ProcessBatchStreaming() until some rows were passed through to 'out_batch' or the
+  // child's input is exhausted. In the latter case the child is closed and the hash
+  // partitions are moved to aggregated_partitions_ to be returned by GetNext().
+  Status GetRowsStreaming(RuntimeState* state, RowBatch* out_batch);
+
   // Reads all the rows from input_stream and process them by calling ProcessBatch().
   template<bool AGGREGATED_ROWS>
   Status ProcessStream(BufferedTupleStream* input_stream);
@@ -396,7 +578,8 @@ class PartitionedAggregationNode : public ExecNode {
   // IR and loaded into the codegen object.  UpdateAggTuple has also been
   // codegen'd to IR.  This function will modify the loop subsituting the statically
   // compiled functions with codegen'd ones.
-  // Assumes AGGREGATED_ROWS = false.
+  // Assumes AGGREGATED_ROWS = false. For a streaming pre-aggregation, this codegens
+  // ProcessBatchStreaming() instead.
   llvm::Function* CodegenProcessBatch();
 
   // Functions to instantiate templated versions of ProcessBatch().
@@ -173,11 +173,13 @@ next_row:
       goto end;
     }
 
+    if (UNLIKELY(probe_batch_pos_ == 0)) EvalAndHashProbeBatch(ht_ctx);
+
     // Establish current_probe_row_ and find its corresponding partition.
-    current_probe_row_ = probe_batch_->GetRow(probe_batch_pos_++);
+    current_probe_row_ = probe_batch_->GetRow(probe_batch_pos_);
     matched_probe_ = false;
-    uint32_t hash;
-    if (!ht_ctx->EvalAndHashProbe(current_probe_row_, &hash)) {
+    uint64_t hash;
+    if (!ht_ctx->LoadCachedRow(probe_batch_pos_++, &hash)) {
       if (JoinOp == TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN) {
         // For NAAJ, we need to treat NULLs on the probe carefully. The logic is:
         // 1. No build rows -> Return this row.
@@ -197,7 +199,7 @@ next_row:
       }
       continue;
     }
-    const uint32_t partition_idx = hash >> (32 - NUM_PARTITIONING_BITS);
+    const uint32_t partition_idx = hash >> (64 - NUM_PARTITIONING_BITS);
     if (LIKELY(hash_tbls_[partition_idx] != NULL)) {
       hash_tbl_iterator_= hash_tbls_[partition_idx]->Find(ht_ctx, hash);
     } else {
@@ -223,6 +225,21 @@ end:
   return num_rows_added;
 }
 
+void PartitionedHashJoinNode::EvalAndHashProbeBatch(HashTableCtx* ht_ctx) {
+  const int num_rows = probe_batch_->num_rows();
+  ht_ctx->ReserveRowCache(num_rows);
+  for (int i = 0; i < num_rows; ++i) {
+    uint64_t hash;
+    if (!ht_ctx->EvalAndHashProbe(probe_batch_->GetRow(i), &hash)) {
+      ht_ctx->CacheRejectedRow(i);
+      continue;
+    }
+    ht_ctx->CacheCurrentRow(i, hash);
+    HashTable* hash_tbl = hash_tbls_[hash >> (64 - NUM_PARTITIONING_BITS)];
+    if (hash_tbl != NULL) hash_tbl->PrefetchBucket(hash);
+  }
+}
+
 int PartitionedHashJoinNode::ProcessProbeBatch(
     const TJoinOp::type join_op, RowBatch* out_batch, HashTableCtx* ht_ctx) {
  switch (join_op) {
@@ -253,7 +270,7 @@ int PartitionedHashJoinNode::ProcessProbeBatch(
 Status PartitionedHashJoinNode::ProcessBuildBatch(RowBatch* build_batch) {
   for (int i = 0; i < build_batch->num_rows(); ++i) {
     TupleRow* build_row = build_batch->GetRow(i);
-    uint32_t hash;
+    uint64_t hash;
     if (!ht_ctx_->EvalAndHashBuild(build_row, &hash)) {
       if (null_aware_partition_ != NULL) {
         // TODO: remove with codegen/template
@@ -265,7 +282,7 @@ Status PartitionedHashJoinNode::ProcessBuildBatch(RowBatch* build_batch) {
       }
       continue;
     }
-    const uint32_t partition_idx = hash >> (32 - NUM_PARTITIONING_BITS);
+    const uint32_t partition_idx = hash >> (64 - NUM_PARTITIONING_BITS);
     Partition* partition = hash_partitions_[partition_idx];
     const bool result = AppendRow(partition->build_rows(), build_row);
     if (UNLIKELY(!result)) return status_;
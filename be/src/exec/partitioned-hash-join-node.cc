@@ -26,6 +26,7 @@
 #include "runtime/buffered-tuple-stream.inline.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
+#include "util/bloom-filter.h"
 #include "util/debug-util.h"
 #include "util/runtime-profile.h"
 
@@ -48,17 +49,20 @@ PartitionedHashJoinNode::PartitionedHashJoinNode(
     state_(PARTITIONING_BUILD),
     block_mgr_client_(NULL),
     process_build_batch_fn_(NULL),
-    process_build_batch_fn_level0_(NULL),
     process_probe_batch_fn_(NULL),
-    process_probe_batch_fn_level0_(NULL),
     input_partition_(NULL),
     null_aware_partition_(NULL),
     non_empty_build_(false),
     null_probe_rows_(NULL),
-    null_probe_output_idx_(-1) {
+    null_probe_output_idx_(-1),
+    skew_chunk_(NULL),
+    skew_build_batch_pos_(0),
+    skew_last_chunk_(false),
+    skew_probe_batch_idx_(0) {
   memset(hash_tbls_, 0, sizeof(hash_tbls_));
   can_add_probe_filters_ = tnode.hash_join_node.add_probe_filters;
   can_add_probe_filters_ &= FLAGS_enable_phj_probe_side_filtering;
+  can_add_global_filters_ = tnode.hash_join_node.__isset.global_filter_probe_slot_ids;
 }
 
 Status PartitionedHashJoinNode::Init(const TPlanNode& tnode) {
@@ -163,18 +167,22 @@ Status PartitionedHashJoinNode::Prepare(RuntimeState* state) {
       ADD_COUNTER(runtime_profile(), "SpilledPartitions", TUnit::UNIT);
   largest_partition_percent_ = runtime_profile()->AddHighWaterMarkCounter(
       "LargestPartitionPercent", TUnit::UNIT);
+  num_skewed_partitions_ =
+      ADD_COUNTER(runtime_profile(), "SkewedPartitions", TUnit::UNIT);
+  num_skewed_build_rows_ =
+      ADD_COUNTER(runtime_profile(), "SkewedBuildRows", TUnit::UNIT);
+  num_skew_chunks_ = ADD_COUNTER(runtime_profile(), "SkewChunks", TUnit::UNIT);
 
   if (state->codegen_enabled()) {
     // Codegen for hashing rows
-    Function* hash_fn = ht_ctx_->CodegenHashCurrentRow(state, false);
-    Function* murmur_hash_fn = ht_ctx_->CodegenHashCurrentRow(state, true);
-    if (hash_fn != NULL && murmur_hash_fn != NULL) {
+    Function* hash_fn = ht_ctx_->CodegenHashCurrentRow(state);
+    if (hash_fn != NULL) {
       // Codegen for build path
-      if (CodegenProcessBuildBatch(state, hash_fn, murmur_hash_fn)) {
+      if (CodegenProcessBuildBatch(state, hash_fn)) {
         AddRuntimeExecOption("Build Side Codegen Enabled");
       }
       // Codegen for probe path
-      if (CodegenProcessProbeBatch(state, hash_fn, murmur_hash_fn)) {
+      if (CodegenProcessProbeBatch(state, hash_fn)) {
         AddRuntimeExecOption("Probe Side Codegen Enabled");
       }
     }
@@ -199,9 +207,14 @@ void PartitionedHashJoinNode::Close(RuntimeState* state) {
   }
 
   if (input_partition_ != NULL) input_partition_->Close(NULL);
+  if (skew_chunk_ != NULL) skew_chunk_->Close(NULL);
+  skew_build_batch_.reset();
   if (null_aware_partition_ != NULL) null_aware_partition_->Close(NULL);
   if (null_probe_rows_ != NULL) null_probe_rows_->Close();
   nulls_build_batch_.reset();
+  // Only non-empty if the build side failed.
+  for (int i = 0; i < global_filters_.size(); ++i) delete global_filters_[i].second;
+  global_filters_.clear();
 
   if (block_mgr_client_ != NULL) {
     state->block_mgr()->ClearReservations(block_mgr_client_);
@@ -217,6 +230,7 @@ PartitionedHashJoinNode::Partition::Partition(RuntimeState* state,
   : parent_(parent),
     is_closed_(false),
     is_spilled_(false),
+    is_skewed_(false),
     level_(level),
     build_rows_(state->obj_pool()->Add(new BufferedTupleStream(
         state, parent_->child(1)->row_desc(), state->block_mgr(),
@@ -324,7 +338,7 @@ Status PartitionedHashJoinNode::Partition::BuildHashTableInternal(
       HashTable::EstimateNumBuckets(build_rows()->num_rows());
   hash_tbl_.reset(new HashTable(state, parent_->block_mgr_client_,
       parent_->child(1)->row_desc().tuple_descriptors().size(), build_rows(),
-      1 << (32 - NUM_PARTITIONING_BITS), estimated_num_buckets));
+      -1, estimated_num_buckets));
   if (!hash_tbl_->Init()) goto not_built;
 
   if (AddProbeFilters) DCHECK_EQ(level_, 0) << "Should not add filters if repartitioning";
@@ -338,7 +352,7 @@ Status PartitionedHashJoinNode::Partition::BuildHashTableInternal(
         << " sized. Size=" << estimated_num_buckets;
     for (int i = 0; i < num_rows; ++i) {
       TupleRow* row = batch.GetRow(i);
-      uint32_t hash = 0;
+      uint64_t hash = 0;
       if (!ctx->EvalAndHashBuild(row, &hash)) continue;
       if (UNLIKELY(!hash_tbl_->Insert(ctx, indices[i], row, hash))) goto not_built;
       if (AddProbeFilters) {
@@ -350,6 +364,12 @@ Status PartitionedHashJoinNode::Partition::BuildHashTableInternal(
               parent_->build_expr_ctxs_[j]->root()->type(), seed0);
           parent_->probe_filters_[j].second->Set<true>(h, true);
         }
+        for (int j = 0; j < parent_->global_filters_.size(); ++j) {
+          int expr_idx = parent_->global_filters_[j].first;
+          void* e = parent_->build_expr_ctxs_[expr_idx]->GetValue(row);
+          parent_->global_filters_[j].second->Insert(RuntimeState::GetGlobalFilterHash(
+              e, parent_->build_expr_ctxs_[expr_idx]->root()->type()));
+        }
       }
     }
     batch.Reset();
@@ -373,6 +393,7 @@ not_built:
     parent_->can_add_probe_filters_ = false;
     VLOG(2) << "Disabling probe filter push down because a partition will spill.";
   }
+  parent_->can_add_global_filters_ = false;
   return Status::OK;
 }
 
@@ -421,6 +442,30 @@ bool PartitionedHashJoinNode::AttachProbeFilters(RuntimeState* state) {
   }
 }
 
+void PartitionedHashJoinNode::AllocateGlobalFilters(RuntimeState* state) {
+  if (!can_add_global_filters_) return;
+  for (int i = 0; i < probe_expr_ctxs_.size(); ++i) {
+    if (!probe_expr_ctxs_[i]->root()->is_slotref()) continue;
+    SlotId slot_id = reinterpret_cast<SlotRef*>(probe_expr_ctxs_[i]->root())->slot_id();
+    if (!state->IsGlobalFilterSource(slot_id)) continue;
+    global_filters_.push_back(make_pair(i,
+        new BloomFilter(RuntimeState::global_filter_log_num_blocks())));
+  }
+  if (global_filters_.empty()) can_add_global_filters_ = false;
+}
+
+void PartitionedHashJoinNode::PublishGlobalFilters(RuntimeState* state) {
+  if (can_add_global_filters_) AddRuntimeExecOption("Global Build-Side Filter Sent");
+  for (int i = 0; i < global_filters_.size(); ++i) {
+    SlotRef* slot_ref =
+        reinterpret_cast<SlotRef*>(probe_expr_ctxs_[global_filters_[i].first]->root());
+    state->PublishGlobalFilter(slot_ref->slot_id(),
+        can_add_global_filters_ ? global_filters_[i].second : NULL);
+    delete global_filters_[i].second;
+  }
+  global_filters_.clear();
+}
+
 bool PartitionedHashJoinNode::AppendRowStreamFull(BufferedTupleStream* stream,
     TupleRow* row) {
   status_ = stream->status();
@@ -484,12 +529,14 @@ Status PartitionedHashJoinNode::ConstructBuildSide(RuntimeState* state) {
   RETURN_IF_ERROR(Expr::Open(probe_expr_ctxs_, state));
   RETURN_IF_ERROR(Expr::Open(other_join_conjunct_ctxs_, state));
   AllocateProbeFilters(state);
+  AllocateGlobalFilters(state);
 
   // Do a full scan of child(1) and partition the rows.
   RETURN_IF_ERROR(child(1)->Open(state));
   RETURN_IF_ERROR(ProcessBuildInput(state, 0));
 
   AttachProbeFilters(state);
+  PublishGlobalFilters(state);
   UpdateState(PROCESSING_PROBE);
   return Status::OK;
 }
@@ -545,15 +592,10 @@ Status PartitionedHashJoinNode::ProcessBuildInput(RuntimeState* state, int level
     total_build_rows += build_batch.num_rows();
 
     SCOPED_TIMER(partition_build_timer_);
-    if (process_build_batch_fn_ == NULL || ht_ctx_->level() != 0) {
+    if (process_build_batch_fn_ == NULL) {
       RETURN_IF_ERROR(ProcessBuildBatch(&build_batch));
     } else {
-      DCHECK_NOTNULL(process_build_batch_fn_level0_);
-      if (ht_ctx_->level() == 0) {
-        RETURN_IF_ERROR(process_build_batch_fn_level0_(this, &build_batch));
-      } else {
-        RETURN_IF_ERROR(process_build_batch_fn_(this, &build_batch));
-      }
+      RETURN_IF_ERROR(process_build_batch_fn_(this, &build_batch));
     }
     build_batch.Reset();
     DCHECK(!build_batch.AtCapacity());
@@ -678,6 +720,12 @@ Status PartitionedHashJoinNode::PrepareNextPartition(RuntimeState* state) {
     RETURN_IF_ERROR(input_partition_->BuildHashTable(state, &built, false));
   }
 
+  if (!built && input_partition_->is_skewed_) {
+    // Repartitioning did not split this partition before, so it would not now either.
+    DCHECK(input_partition_->is_spilled());
+    return PrepareSkewedPartition(state);
+  }
+
   if (!built) {
     // This build partition still does not fit in memory, repartition.
     DCHECK(input_partition_->is_spilled());
@@ -691,13 +739,22 @@ Status PartitionedHashJoinNode::PrepareNextPartition(RuntimeState* state) {
     DCHECK_GE(num_input_rows, largest_partition) << "Cannot have a partition with "
         "more rows than the input";
     if (num_input_rows == largest_partition) {
-      Status status = Status::MEM_LIMIT_EXCEEDED;
-      status.AddDetail(Substitute("Cannot perform hash join at node with id $0. "
-          "Repartitioning did not reduce the size of a spilled partition. "
-          "Repartitioning level $1. Number of rows $2.",
-          id_, input_partition_->level_ + 1, num_input_rows));
-      state->SetMemLimitExceeded();
-      return status;
+      // All build rows have the same hash with two different seeds, so they almost
+      // certainly have the same key. Repartitioning again will not help. Once its probe
+      // rows are partitioned, the partition is joined chunk by chunk instead.
+      for (int i = 0; i < hash_partitions_.size(); ++i) {
+        Partition* partition = hash_partitions_[i];
+        if (partition->is_spilled() &&
+            partition->build_rows()->num_rows() == num_input_rows) {
+          partition->is_skewed_ = true;
+          break;
+        }
+      }
+      VLOG(2) << "Repartitioning did not reduce the size of a spilled partition. "
+              << "Repartitioning level " << input_partition_->level_ + 1
+              << ". Number of rows " << num_input_rows << ".";
+      COUNTER_ADD(num_skewed_partitions_, 1);
+      COUNTER_ADD(num_skewed_build_rows_, num_input_rows);
     }
     UpdateState(REPARTITIONING);
   } else {
@@ -717,6 +774,283 @@ Status PartitionedHashJoinNode::PrepareNextPartition(RuntimeState* state) {
   return Status::OK;
 }
 
+// Returns true if a probe row must only be returned, or dropped, once it is known
+// whether it matches any build row of a skewed partition, i.e. with the last chunk.
+static bool TracksSkewedProbeMatches(TJoinOp::type join_op) {
+  return join_op == TJoinOp::LEFT_OUTER_JOIN || join_op == TJoinOp::LEFT_SEMI_JOIN ||
+      join_op == TJoinOp::LEFT_ANTI_JOIN || join_op == TJoinOp::FULL_OUTER_JOIN ||
+      join_op == TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN;
+}
+
+Status PartitionedHashJoinNode::PrepareSkewedPartition(RuntimeState* state) {
+  DCHECK(input_partition_->is_skewed_);
+  DCHECK(skew_chunk_ == NULL);
+  VLOG(2) << "Joining skewed partition chunk by chunk\n" << NodeDebugString();
+  // The build rows are read once, the probe rows once per chunk. Only the read buffers
+  // of the two streams stay pinned, the rest of the memory is used for the chunks.
+  RETURN_IF_ERROR(input_partition_->build_rows()->UnpinStream(true));
+  bool got_buffer;
+  RETURN_IF_ERROR(input_partition_->build_rows()->PrepareForRead(&got_buffer));
+  if (!got_buffer) return state->block_mgr()->MemLimitTooLowError(block_mgr_client_);
+  skew_build_batch_.reset(
+      new RowBatch(child(1)->row_desc(), state->batch_size(), mem_tracker()));
+  skew_build_batch_pos_ = 0;
+  skew_last_chunk_ = false;
+  if (TracksSkewedProbeMatches(join_op_)) {
+    skew_probe_matched_.assign(input_partition_->probe_rows()->num_rows(), false);
+  }
+  current_probe_row_ = NULL;
+  probe_batch_pos_ = -1;
+  UpdateState(PROBING_SKEWED_PARTITION);
+  return Status::OK;
+}
+
+int64_t PartitionedHashJoinNode::SkewChunkMemSize() const {
+  int64_t num_rows = skew_chunk_->build_rows()->num_rows();
+  // The rows of a skewed partition have the same key, so all but the first one are
+  // stored in duplicate nodes. Their pages are allocated one block at a time.
+  return skew_chunk_->build_rows()->byte_size() + HashTable::EstimateSize(num_rows) +
+      HashTable::EstimateDuplicateNodesSize(num_rows) +
+      runtime_state_->block_mgr()->max_block_size();
+}
+
+Status PartitionedHashJoinNode::PrepareNextSkewChunk(RuntimeState* state) {
+  DCHECK(skew_chunk_ == NULL);
+  DCHECK(!skew_last_chunk_);
+  BufferedTupleStream* build_rows = input_partition_->build_rows();
+  skew_chunk_ = pool_->Add(new Partition(state, this, input_partition_->level_, false));
+  BufferedTupleStream* chunk_rows = skew_chunk_->build_rows();
+  RETURN_IF_ERROR(chunk_rows->Init(runtime_profile()));
+
+  // The chunk's rows and its hash table must fit in the buffers this node can still
+  // get from the block mgr, except for one buffer to read the probe rows again. The
+  // buckets are not allocated from buffers, but they are counted against the same
+  // memory.
+  BufferedBlockMgr* block_mgr = state->block_mgr();
+  const int64_t max_chunk_size = min(
+      (block_mgr->available_buffers(block_mgr_client_) - 1) *
+          block_mgr->max_block_size(),
+      mem_tracker()->SpareCapacity());
+  while (true) {
+    if (skew_build_batch_pos_ == skew_build_batch_->num_rows()) {
+      skew_build_batch_->Reset();
+      skew_build_batch_pos_ = 0;
+      if (build_rows->rows_returned() == build_rows->num_rows()) {
+        skew_last_chunk_ = true;
+        break;
+      }
+      bool eos;
+      RETURN_IF_ERROR(build_rows->GetNext(skew_build_batch_.get(), &eos));
+      continue;
+    }
+    if (chunk_rows->num_rows() > 0 && SkewChunkMemSize() >= max_chunk_size) break;
+    if (!chunk_rows->AddRow(skew_build_batch_->GetRow(skew_build_batch_pos_))) {
+      RETURN_IF_ERROR(chunk_rows->status());
+      // There are no more buffers for this chunk.
+      if (chunk_rows->num_rows() == 0) {
+        return state->block_mgr()->MemLimitTooLowError(block_mgr_client_);
+      }
+      break;
+    }
+    ++skew_build_batch_pos_;
+  }
+
+  bool built = false;
+  RETURN_IF_ERROR(skew_chunk_->BuildHashTable(state, &built, false));
+  if (!built) {
+    Status status = Status::MEM_LIMIT_EXCEEDED;
+    status.AddDetail(Substitute("Cannot perform hash join at node with id $0. "
+        "Not enough memory to build a hash table over $1 rows of a skewed partition.",
+        id_, chunk_rows->num_rows()));
+    state->SetMemLimitExceeded();
+    return status;
+  }
+  COUNTER_ADD(num_skew_chunks_, 1);
+  VLOG(2) << "Built hash table over " << chunk_rows->num_rows() << " rows of skewed "
+          << "partition, last chunk: " << skew_last_chunk_;
+  return Status::OK;
+}
+
+Status PartitionedHashJoinNode::ProcessSkewedPartition(RuntimeState* state,
+    RowBatch* out_batch) {
+  DCHECK_EQ(state_, PROBING_SKEWED_PARTITION);
+  DCHECK(input_partition_ != NULL);
+  BufferedTupleStream* probe_rows = input_partition_->probe_rows();
+  while (!out_batch->AtCapacity() && !ReachedLimit()) {
+    RETURN_IF_CANCELLED(state);
+    RETURN_IF_ERROR(QueryMaintenance(state));
+    if (skew_chunk_ == NULL) {
+      if (skew_last_chunk_) {
+        // All chunks have been joined with all probe rows. GetNext() moves onto the
+        // next partition once out_batch is returned.
+        input_partition_->Close(out_batch);
+        input_partition_ = NULL;
+        skew_build_batch_.reset();
+        skew_probe_matched_.clear();
+        current_probe_row_ = NULL;
+        probe_batch_pos_ = -1;
+        return Status::OK;
+      }
+      RETURN_IF_ERROR(PrepareNextSkewChunk(state));
+      // Read all probe rows of the partition again for the new chunk.
+      bool got_buffer;
+      RETURN_IF_ERROR(probe_rows->PrepareForRead(&got_buffer));
+      if (!got_buffer) return state->block_mgr()->MemLimitTooLowError(block_mgr_client_);
+    }
+
+    if (current_probe_row_ == NULL &&
+        (probe_batch_pos_ == -1 || probe_batch_pos_ == probe_batch_->num_rows())) {
+      // The out_batch has resources associated with it that will be recycled on the
+      // next call to GetNext() on the probe stream. Return this batch now.
+      probe_batch_->TransferResourceOwnership(out_batch);
+      probe_batch_pos_ = -1;
+      if (out_batch->AtCapacity()) break;
+      if (probe_rows->rows_returned() < probe_rows->num_rows()) {
+        skew_probe_batch_idx_ = probe_rows->rows_returned();
+        bool eos = false;
+        RETURN_IF_ERROR(probe_rows->GetNext(probe_batch_.get(), &eos));
+        DCHECK_GT(probe_batch_->num_rows(), 0);
+        ResetForProbe();
+        continue;
+      }
+
+      // All probe rows have been joined with this chunk.
+      if (join_op_ == TJoinOp::RIGHT_OUTER_JOIN || join_op_ == TJoinOp::RIGHT_ANTI_JOIN ||
+          join_op_ == TJoinOp::FULL_OUTER_JOIN) {
+        DCHECK(output_build_partitions_.empty());
+        hash_tbl_iterator_ = skew_chunk_->hash_tbl()->FirstUnmatched(ht_ctx_.get());
+        output_build_partitions_.push_back(skew_chunk_);
+        skew_chunk_ = NULL;
+        break;
+      }
+      skew_chunk_->Close(out_batch);
+      skew_chunk_ = NULL;
+      continue;
+    }
+
+    int rows_added = ProcessSkewedProbeBatch(out_batch);
+    if (UNLIKELY(rows_added < 0)) {
+      DCHECK(!status_.ok());
+      return status_;
+    }
+    out_batch->CommitRows(rows_added);
+    num_rows_returned_ += rows_added;
+    COUNTER_SET(rows_returned_counter_, num_rows_returned_);
+  }
+  return Status::OK;
+}
+
+int PartitionedHashJoinNode::ProcessSkewedProbeBatch(RowBatch* out_batch) {
+  ExprContext* const* other_join_conjunct_ctxs = &other_join_conjunct_ctxs_[0];
+  const int num_other_join_conjuncts = other_join_conjunct_ctxs_.size();
+  ExprContext* const* conjunct_ctxs = &conjunct_ctxs_[0];
+  const int num_conjuncts = conjunct_ctxs_.size();
+  HashTableCtx* ht_ctx = ht_ctx_.get();
+  HashTable* hash_tbl = skew_chunk_->hash_tbl();
+  DCHECK(hash_tbl != NULL);
+
+  // Semi and anti joins return the probe xor the build row.
+  const bool returns_probe_row = join_op_ == TJoinOp::LEFT_SEMI_JOIN ||
+      join_op_ == TJoinOp::LEFT_ANTI_JOIN ||
+      join_op_ == TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN;
+  const bool returns_build_row = join_op_ == TJoinOp::RIGHT_SEMI_JOIN ||
+      join_op_ == TJoinOp::RIGHT_ANTI_JOIN;
+  const bool marks_build_rows = returns_build_row ||
+      join_op_ == TJoinOp::RIGHT_OUTER_JOIN || join_op_ == TJoinOp::FULL_OUTER_JOIN;
+  const bool tracks_probe_matches = TracksSkewedProbeMatches(join_op_);
+
+  DCHECK(!out_batch->AtCapacity());
+  TupleRow* out_row = out_batch->GetRow(out_batch->AddRow());
+  const int max_rows = out_batch->capacity() - out_batch->num_rows();
+  int num_rows_added = 0;
+
+  while (true) {
+    if (current_probe_row_ != NULL) {
+      const int64_t probe_idx = skew_probe_batch_idx_ + probe_batch_pos_ - 1;
+      while (!hash_tbl_iterator_.AtEnd()) {
+        TupleRow* build_row = hash_tbl_iterator_.GetRow();
+        if (returns_build_row && hash_tbl_iterator_.IsMatched()) {
+          hash_tbl_iterator_.NextDuplicate();
+          continue;
+        }
+        TupleRow* joined_row = (returns_probe_row || returns_build_row) ?
+            semi_join_staging_row_ : out_row;
+        CreateOutputRow(joined_row, current_probe_row_, build_row);
+        if (!EvalConjuncts(other_join_conjunct_ctxs, num_other_join_conjuncts,
+                joined_row)) {
+          hash_tbl_iterator_.NextDuplicate();
+          continue;
+        }
+
+        bool output = true;
+        if (marks_build_rows) hash_tbl_iterator_.SetMatched();
+        if (returns_probe_row) {
+          // A left semi join returns the probe row for its first match in any chunk.
+          // The anti joins only return probe rows that never match.
+          output = join_op_ == TJoinOp::LEFT_SEMI_JOIN && !skew_probe_matched_[probe_idx];
+          if (output) out_batch->CopyRow(current_probe_row_, out_row);
+          hash_tbl_iterator_.SetAtEnd();
+        } else {
+          if (returns_build_row) {
+            output = join_op_ == TJoinOp::RIGHT_SEMI_JOIN;
+            if (output) out_batch->CopyRow(build_row, out_row);
+          }
+          hash_tbl_iterator_.NextDuplicate();
+        }
+        if (tracks_probe_matches) skew_probe_matched_[probe_idx] = true;
+
+        if (output && EvalConjuncts(conjunct_ctxs, num_conjuncts, out_row)) {
+          ++num_rows_added;
+          out_row = out_row->next_row(out_batch);
+          if (num_rows_added == max_rows) return num_rows_added;
+        }
+      }
+
+      if (skew_last_chunk_ && tracks_probe_matches && !skew_probe_matched_[probe_idx]) {
+        // The probe row did not match any build row of the partition. Mark it so that
+        // it is only handled once if out_batch fills up.
+        skew_probe_matched_[probe_idx] = true;
+        bool output = false;
+        if (join_op_ == TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN &&
+            null_aware_partition_->build_rows()->num_rows() != 0) {
+          // As in ProcessProbeBatch(), the result is unknown if there are NULLs on the
+          // build side, so the remaining join predicates are evaluated later.
+          if (num_other_join_conjuncts > 0 &&
+              !null_aware_partition_->probe_rows()->AddRow(current_probe_row_)) {
+            status_ = null_aware_partition_->probe_rows()->status();
+            return -1;
+          }
+        } else if (join_op_ == TJoinOp::LEFT_OUTER_JOIN ||
+            join_op_ == TJoinOp::FULL_OUTER_JOIN) {
+          CreateOutputRow(out_row, current_probe_row_, NULL);
+          output = EvalConjuncts(conjunct_ctxs, num_conjuncts, out_row);
+        } else if (join_op_ != TJoinOp::LEFT_SEMI_JOIN) {
+          out_batch->CopyRow(current_probe_row_, out_row);
+          output = true;
+        }
+        if (output) {
+          ++num_rows_added;
+          out_row = out_row->next_row(out_batch);
+          if (num_rows_added == max_rows) return num_rows_added;
+        }
+      }
+    }
+
+    // Move on to the next probe row.
+    if (probe_batch_pos_ == probe_batch_->num_rows()) {
+      current_probe_row_ = NULL;
+      return num_rows_added;
+    }
+    current_probe_row_ = probe_batch_->GetRow(probe_batch_pos_++);
+    uint64_t hash;
+    if (ht_ctx->EvalAndHashProbe(current_probe_row_, &hash)) {
+      hash_tbl_iterator_ = hash_tbl->Find(ht_ctx, hash);
+    } else {
+      hash_tbl_iterator_.SetAtEnd();
+    }
+  }
+}
+
 int64_t PartitionedHashJoinNode::LargestSpilledPartition() const {
   int64_t max_rows = 0;
   for (int i = 0; i < hash_partitions_.size(); ++i) {
@@ -756,12 +1090,15 @@ Status PartitionedHashJoinNode::GetNext(RuntimeState* state, RowBatch* out_batch
       OutputUnmatchedBuild(out_batch);
       if (!output_build_partitions_.empty()) break;
 
-      // Finished to output unmatched build rows, move to next partition.
+      // Finished to output unmatched build rows, move to next partition. A skewed
+      // partition continues with its next chunk instead.
       DCHECK(hash_partitions_.empty());
-      RETURN_IF_ERROR(PrepareNextPartition(state));
-      if (input_partition_ == NULL) {
-        *eos = true;
-        break;
+      if (state_ != PROBING_SKEWED_PARTITION) {
+        RETURN_IF_ERROR(PrepareNextPartition(state));
+        if (input_partition_ == NULL) {
+          *eos = true;
+          break;
+        }
       }
     }
 
@@ -785,21 +1122,39 @@ Status PartitionedHashJoinNode::GetNext(RuntimeState* state, RowBatch* out_batch
       }
     }
 
+    if (state_ == PROBING_SKEWED_PARTITION) {
+      // Skewed partitions are joined separately from the probe path below.
+      if (input_partition_ != NULL) {
+        RETURN_IF_ERROR(ProcessSkewedPartition(state, out_batch));
+        if (out_batch->AtCapacity() || ReachedLimit()) break;
+        // The unmatched build rows of the last chunk need to be output first.
+        if (input_partition_ != NULL) continue;
+      }
+      // Done with the skewed partition, move onto the next partition.
+      UpdateState(PROBING_SPILLED_PARTITION);
+      RETURN_IF_ERROR(PrepareNextPartition(state));
+      if (input_partition_ == NULL) {
+        if (join_op_ == TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN) {
+          RETURN_IF_ERROR(PrepareNullAwarePartition());
+        }
+        if (null_aware_partition_ == NULL) {
+          *eos = true;
+          break;
+        }
+      }
+      continue;
+    }
+
     // Finish up the current batch.
     {
       // Putting SCOPED_TIMER in ProcessProbeBatch() causes weird exception handling IR in
       // the xcompiled function, so call it here instead.
       int rows_added = 0;
       SCOPED_TIMER(probe_timer_);
-      if (process_probe_batch_fn_ == NULL || ht_ctx_->level() != 0) {
+      if (process_probe_batch_fn_ == NULL) {
         rows_added = ProcessProbeBatch(join_op_, out_batch, ht_ctx_.get());
       } else {
-        DCHECK_NOTNULL(process_probe_batch_fn_level0_);
-        if (ht_ctx_->level() == 0) {
-          rows_added = process_probe_batch_fn_level0_(this, out_batch, ht_ctx_.get());
-        } else {
-          rows_added = process_probe_batch_fn_(this, out_batch, ht_ctx_.get());
-        }
+        rows_added = process_probe_batch_fn_(this, out_batch, ht_ctx_.get());
       }
       if (UNLIKELY(rows_added < 0)) {
         DCHECK(!status_.ok());
@@ -1078,6 +1433,9 @@ Status PartitionedHashJoinNode::BuildHashTables(RuntimeState* state) {
   } else {
     can_add_probe_filters_ = false;
   }
+  // The global filters must cover all build rows, so they are only built if none of the
+  // level 0 partitions spilled.
+  if (input_partition_ != NULL) can_add_global_filters_ = false;
 
   // First loop over the partitions and build hash tables for the partitions that did
   // not already spill.
@@ -1087,11 +1445,13 @@ Status PartitionedHashJoinNode::BuildHashTables(RuntimeState* state) {
       partition->Close(NULL);
       continue;
     }
+    if (partition->is_spilled()) can_add_global_filters_ = false;
 
     if (!partition->is_spilled()) {
       bool built = false;
       DCHECK(partition->build_rows()->is_pinned());
-      RETURN_IF_ERROR(partition->BuildHashTable(state, &built, can_add_probe_filters_));
+      RETURN_IF_ERROR(partition->BuildHashTable(state, &built,
+          can_add_probe_filters_ || can_add_global_filters_));
       // If we did not have enough memory to build this hash table, we need to spill this
       // partition (clean up the hash table, unpin build).
       if (!built) RETURN_IF_ERROR(partition->Spill(true));
@@ -1297,6 +1657,7 @@ string PartitionedHashJoinNode::PrintState() const {
     case PROCESSING_PROBE: return "ProcessingProbe";
     case PROBING_SPILLED_PARTITION: return "ProbingSpilledPartitions";
     case REPARTITIONING: return "Repartioning";
+    case PROBING_SKEWED_PARTITION: return "ProbingSkewedPartition";
     default: DCHECK(false);
   }
   return "";
@@ -1447,7 +1808,7 @@ Function* PartitionedHashJoinNode::CodegenCreateOutputRow(LlvmCodeGen* codegen)
 }
 
 bool PartitionedHashJoinNode::CodegenProcessBuildBatch(
-    RuntimeState* state, Function* hash_fn, Function* murmur_hash_fn) {
+    RuntimeState* state, Function* hash_fn) {
   LlvmCodeGen* codegen;
   if (!state->GetCodegen(&codegen).ok()) return false;
   // Get cross compiled function
@@ -1465,33 +1826,22 @@ bool PartitionedHashJoinNode::CodegenProcessBuildBatch(
       eval_row_fn, "EvalBuildRow", &replaced);
   DCHECK_EQ(replaced, 1);
 
-  // process_build_batch_fn_level0 uses CRC hash if available,
-  // process_build_batch_fn uses murmur
-  Function* process_build_batch_fn_level0 = codegen->ReplaceCallSites(
-      process_build_batch_fn, false, hash_fn, "HashCurrentRow", &replaced);
-  DCHECK_EQ(replaced, 1);
-
   process_build_batch_fn = codegen->ReplaceCallSites(
-      process_build_batch_fn, true, murmur_hash_fn, "HashCurrentRow", &replaced);
+      process_build_batch_fn, true, hash_fn, "HashCurrentRow", &replaced);
   DCHECK_EQ(replaced, 1);
 
-  // Finalize ProcessBuildBatch functions
+  // Finalize ProcessBuildBatch function
   process_build_batch_fn = codegen->OptimizeFunctionWithExprs(process_build_batch_fn);
   if (process_build_batch_fn == NULL) return false;
-  process_build_batch_fn_level0 =
-      codegen->OptimizeFunctionWithExprs(process_build_batch_fn_level0);
-  if (process_build_batch_fn_level0 == NULL) return false;
 
-  // Register native function pointers
+  // Register native function pointer
   codegen->AddFunctionToJit(process_build_batch_fn,
                             reinterpret_cast<void**>(&process_build_batch_fn_));
-  codegen->AddFunctionToJit(process_build_batch_fn_level0,
-                            reinterpret_cast<void**>(&process_build_batch_fn_level0_));
   return true;
 }
 
 bool PartitionedHashJoinNode::CodegenProcessProbeBatch(
-    RuntimeState* state, Function* hash_fn, Function* murmur_hash_fn) {
+    RuntimeState* state, Function* hash_fn) {
   LlvmCodeGen* codegen;
   if (!state->GetCodegen(&codegen).ok()) return false;
 
@@ -1608,27 +1958,16 @@ bool PartitionedHashJoinNode::CodegenProcessProbeBatch(
   // Depends on join_op_
   DCHECK(replaced == 1 || replaced == 2 || replaced == 3 || replaced == 4) << replaced;
 
-  // process_probe_batch_fn_level0 uses CRC hash if available,
-  // process_probe_batch_fn uses murmur
-  Function* process_probe_batch_fn_level0 = codegen->ReplaceCallSites(
-      process_probe_batch_fn, false, hash_fn, "HashCurrentRow", &replaced);
-  DCHECK_EQ(replaced, 1);
-
   process_probe_batch_fn = codegen->ReplaceCallSites(
-      process_probe_batch_fn, true, murmur_hash_fn, "HashCurrentRow", &replaced);
+      process_probe_batch_fn, true, hash_fn, "HashCurrentRow", &replaced);
   DCHECK_EQ(replaced, 1);
 
-  // Finalize ProcessProbeBatch functions
+  // Finalize ProcessProbeBatch function
   process_probe_batch_fn = codegen->OptimizeFunctionWithExprs(process_probe_batch_fn);
   if (process_probe_batch_fn == NULL) return false;
-  process_probe_batch_fn_level0 =
-      codegen->OptimizeFunctionWithExprs(process_probe_batch_fn_level0);
-  if (process_probe_batch_fn_level0 == NULL) return false;
 
-  // Register native function pointers
+  // Register native function pointer
   codegen->AddFunctionToJit(process_probe_batch_fn,
                             reinterpret_cast<void**>(&process_probe_batch_fn_));
-  codegen->AddFunctionToJit(process_probe_batch_fn_level0,
-                            reinterpret_cast<void**>(&process_probe_batch_fn_level0_));
   return true;
 }
@@ -30,6 +30,7 @@
 
 namespace impala {
 
+class BloomFilter;
 class BufferedBlockMgr;
 class MemPool;
 class RowBatch;
@@ -47,6 +48,11 @@ class BufferedTupleStream;
 //     build rows and process the spilled probe rows. If the partition is still too
 //     big, repeat steps 1-4, using this spilled partitions build and probe rows as
 //     input.
+//  5. If repartitioning a spilled partition does not reduce its size, all of its build
+//     rows have the same hash, which in practice means a single key that is too large
+//     to fit in memory (skew). Repartitioning cannot help, so the partition is joined
+//     in chunks instead: the build rows are split into chunks whose hash tables fit in
+//     memory and all probe rows of the partition are streamed against each chunk.
 //
 // TODO: don't copy tuple rows so often.
 // TODO: we need multiple hash functions. Each repartition needs new hash functions
@@ -86,10 +92,13 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   //      spilled partition and the hash table fits in memory. Neither the build nor probe
   //      side need to be partitioned and we just perform the join.
   //
+  //   4. Join a skewed spilled partition, one chunk of its build rows at a time. The
+  //      probe rows of the partition are read once per chunk.
+  //
   // States:
   // The transition goes from PARTITIONING_BUILD -> PROCESSING_PROBE ->
-  //    PROBING_SPILLED_PARTITION/REPARTITIONING.
-  // The last two steps will switch back and forth as many times as we need to
+  //    PROBING_SPILLED_PARTITION/REPARTITIONING/PROBING_SKEWED_PARTITION.
+  // The last three steps will switch back and forth as many times as we need to
   // repartition.
   enum State {
     // Partitioning the build (right) child's input. Corresponds to mode 1 above but
@@ -108,6 +117,10 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
     // hash_partitions_.
     // Corresponds to mode 1 & 2 but reading from a spilled partition.
     REPARTITIONING,
+
+    // Joining a skewed partition (input_partition_) chunk by chunk in
+    // ProcessSkewedPartition(). Corresponds to mode 4.
+    PROBING_SKEWED_PARTITION,
   };
 
   // Number of initial partitions to create. Must be a power of two.
@@ -123,9 +136,9 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   // limit and 64 fanout, we can support 256TB build tables in the case where
   // there is no skew.
   // In the case where there is skew, repartitioning is unlikely to help (assuming a
-  // reasonable hash function).
+  // reasonable hash function). Skew is detected when repartitioning does not reduce
+  // the size of a partition, see PROBING_SKEWED_PARTITION.
   // Note that we need to have at least as many SEED_PRIMES in HashTableCtx.
-  // TODO: we can revisit and try harder to explicitly detect skew.
   static const int MAX_PARTITION_DEPTH = 16;
 
   // Maximum number of build tables that can be in memory at any time. This is in
@@ -178,6 +191,12 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   template<int const JoinOp>
   int ProcessProbeBatch(RowBatch* out_batch, HashTableCtx* ht_ctx);
 
+  // Evaluates and hashes all rows of probe_batch_ into the row cache of 'ht_ctx' and
+  // prefetches the hash table bucket of each row, so that the cache misses on the
+  // buckets overlap instead of being taken one probe row at a time. Called by
+  // ProcessProbeBatch() when it starts on a new probe batch.
+  void IR_ALWAYS_INLINE EvalAndHashProbeBatch(HashTableCtx* ht_ctx);
+
   // Wrapper that calls the templated version of ProcessProbeBatch() based on 'join_op'.
   int ProcessProbeBatch(
       const TJoinOp::type join_op, RowBatch* out_batch, HashTableCtx* ht_ctx);
@@ -243,6 +262,33 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   // of the largest partition (in terms of number of aggregated and unaggregated rows).
   int64_t LargestSpilledPartition() const;
 
+  // Starts joining input_partition_, whose build side is skewed and does not fit in
+  // memory, chunk by chunk. Transitions to PROBING_SKEWED_PARTITION.
+  Status PrepareSkewedPartition(RuntimeState* state);
+
+  // Joins the skewed input_partition_ until out_batch is at capacity or the partition
+  // is done, in which case it is closed and input_partition_ is set to NULL. For
+  // right outer, right anti and full outer joins, a chunk that has been probed with
+  // all probe rows is moved to output_build_partitions_ to output its unmatched build
+  // rows, and this function returns so that GetNext() can output them first.
+  Status ProcessSkewedPartition(RuntimeState* state, RowBatch* out_batch);
+
+  // Reads build rows from input_partition_ into skew_chunk_ until the chunk with its
+  // hash table would not fit in the buffers that the block mgr can still give this
+  // node, minus one buffer to read the probe rows, and builds the chunk's hash table.
+  Status PrepareNextSkewChunk(RuntimeState* state);
+
+  // Returns the estimated memory of skew_chunk_ once its hash table is built,
+  // including the data pages of its duplicate nodes.
+  int64_t SkewChunkMemSize() const;
+
+  // Joins the rows of probe_batch_ with the build rows in skew_chunk_. Like
+  // ProcessProbeBatch(), but not codegen'd and keeps track of probe rows that matched
+  // in any of the chunks (skew_probe_matched_), so that unmatched probe rows are only
+  // returned (or dropped) with the last chunk. Returns the number of rows added to
+  // out_batch; -1 on error (and status_ will be set).
+  int ProcessSkewedProbeBatch(RowBatch* out_batch);
+
   // Prepares for probing the next batch.
   void ResetForProbe();
 
@@ -253,18 +299,24 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   // Attach the probe filters to runtime state.
   bool AttachProbeFilters(RuntimeState* state);
 
+  // For each probe slot ref that the fragment instance is a global filter source for
+  // (see RuntimeState::IsGlobalFilterSource()), allocate a bloom filter.
+  void AllocateGlobalFilters(RuntimeState* state);
+
+  // Sends the global filters to the coordinator, or reports them as disabled if they
+  // could not be built, and frees them.
+  void PublishGlobalFilters(RuntimeState* state);
+
   // Codegen function to create output row. Assumes that the probe row is non-NULL.
   llvm::Function* CodegenCreateOutputRow(LlvmCodeGen* codegen);
 
   // Codegen processing build batches.  Identical signature to ProcessBuildBatch.
   // Returns false if codegen was not possible.
-  bool CodegenProcessBuildBatch(
-      RuntimeState* state, llvm::Function* hash_fn, llvm::Function* murmur_hash_fn);
+  bool CodegenProcessBuildBatch(RuntimeState* state, llvm::Function* hash_fn);
 
   // Codegen processing probe batches.  Identical signature to ProcessProbeBatch.
   // Returns false if codegen was not possible.
-  bool CodegenProcessProbeBatch(
-      RuntimeState* state, llvm::Function* hash_fn, llvm::Function* murmur_hash_fn);
+  bool CodegenProcessProbeBatch(RuntimeState* state, llvm::Function* hash_fn);
 
   // Returns the current state of the partition as a string.
   std::string PrintState() const;
@@ -341,6 +393,17 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   // Time spent evaluating other_join_conjuncts for NAAJ.
   RuntimeProfile::Counter* null_aware_eval_timer_;
 
+  // Number of spilled partitions that repartitioning could not split and that were
+  // joined chunk by chunk. Each of them is normally a single skewed key.
+  RuntimeProfile::Counter* num_skewed_partitions_;
+
+  // Number of build rows in the skewed partitions.
+  RuntimeProfile::Counter* num_skewed_build_rows_;
+
+  // Number of chunks the build rows of the skewed partitions were split into. The probe
+  // rows of a skewed partition are read once per chunk.
+  RuntimeProfile::Counter* num_skew_chunks_;
+
   class Partition {
    public:
     Partition(RuntimeState* state, PartitionedHashJoinNode* parent, int level,
@@ -396,6 +459,11 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
     // True if this partition is spilled.
     bool is_spilled_;
 
+    // True if this partition was created by repartitioning a spilled partition without
+    // reducing its size. If it does not fit in memory, it is joined chunk by chunk
+    // instead of being repartitioned again.
+    bool is_skewed_;
+
     // How many times rows in this partition have been repartitioned. Partitions created
     // from the node's children's input is level 0, 1 after the first repartitionining,
     // etc.
@@ -415,22 +483,14 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
 
   // llvm function and signature for codegening build batch.
   typedef Status (*ProcessBuildBatchFn)(PartitionedHashJoinNode*, RowBatch*);
-  // Jitted ProcessBuildBatch function pointers.  NULL if codegen is disabled.
-  // process_build_batch_fn_level0_ uses CRC hashing when available and is used when the
-  // partition level is 0, otherwise process_build_batch_fn_ uses murmur hash and is used
-  // for subsequent levels.
+  // Jitted ProcessBuildBatch function pointer.  NULL if codegen is disabled.
   ProcessBuildBatchFn process_build_batch_fn_;
-  ProcessBuildBatchFn process_build_batch_fn_level0_;
 
   // llvm function and signature for codegening probe batch.
   typedef int (*ProcessProbeBatchFn)(
       PartitionedHashJoinNode*, RowBatch*, HashTableCtx*);
   // Jitted ProcessProbeBatch function pointer.  NULL if codegen is disabled.
-  // process_probe_batch_fn_level0_ uses CRC hashing when available and is used when the
-  // partition level is 0, otherwise process_probe_batch_fn_ uses murmur hash and is used
-  // for subsequent levels.
   ProcessProbeBatchFn process_probe_batch_fn_;
-  ProcessProbeBatchFn process_probe_batch_fn_level0_;
 
   // The list of partitions that have been spilled on both sides and still need more
   // processing. These partitions could need repartitioning, in which cases more
@@ -463,6 +523,14 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   // probe-side filter optimization.
   std::vector<std::pair<SlotId, Bitmap*> > probe_filters_;
 
+  // Bloom filters over the build side values of the eq join conjuncts, which are sent
+  // to the scans of the probe side in other fragment instances. Each entry is the index
+  // of the join conjunct and the filter.
+  std::vector<std::pair<int, BloomFilter*> > global_filters_;
+
+  // False if the global filters can not be built, e.g. because a partition spilled.
+  bool can_add_global_filters_;
+
   // Partition used if null_aware_ is set. This partition is always processed at the end
   // after all build and probe rows are processed. Rows are added to this partition along
   // the way.
@@ -494,6 +562,26 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   // The current index into null_probe_rows_/matched_null_probe_ that we are
   // outputting.
   int64_t null_probe_output_idx_;
+
+  // State for joining a skewed input_partition_ in PROBING_SKEWED_PARTITION.
+  // The current chunk of build rows, which owns the chunk's hash table. NULL between
+  // chunks.
+  Partition* skew_chunk_;
+
+  // Batch of build rows read from input_partition_ and the index of the first row in
+  // it that has not been added to a chunk yet.
+  boost::scoped_ptr<RowBatch> skew_build_batch_;
+  int skew_build_batch_pos_;
+
+  // True if skew_chunk_ holds the last build rows of input_partition_.
+  bool skew_last_chunk_;
+
+  // For each probe row of input_partition_, true if it matched a build row in one of
+  // the chunks so far. Only used for joins that return or drop unmatched probe rows.
+  std::vector<bool> skew_probe_matched_;
+
+  // Index in input_partition_'s probe rows of the first row of probe_batch_.
+  int64_t skew_probe_batch_idx_;
 };
 
 }
@@ -27,6 +27,7 @@ SelectNode::SelectNode(
     ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs)
     : ExecNode(pool, tnode, descs),
       child_row_batch_(NULL),
+      num_selected_rows_(0),
       child_row_idx_(0),
       child_eos_(false) {
 }
@@ -36,6 +37,7 @@ Status SelectNode::Prepare(RuntimeState* state) {
   RETURN_IF_ERROR(ExecNode::Prepare(state));
   child_row_batch_.reset(
       new RowBatch(child(0)->row_desc(), state->batch_size(), mem_tracker()));
+  selected_rows_.resize(state->batch_size());
   return Status::OK;
 }
 
@@ -50,7 +52,7 @@ Status SelectNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos)
   SCOPED_TIMER(runtime_profile_->total_time_counter());
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
 
-  if (ReachedLimit() || (child_row_idx_ == child_row_batch_->num_rows() && child_eos_)) {
+  if (ReachedLimit() || (child_row_idx_ == num_selected_rows_ && child_eos_)) {
     // we're already done or we exhausted the last child batch and there won't be any
     // new ones
     *eos = true;
@@ -62,18 +64,21 @@ Status SelectNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos)
   while (true) {
     RETURN_IF_CANCELLED(state);
     RETURN_IF_ERROR(QueryMaintenance(state));
-    if (child_row_idx_ == child_row_batch_->num_rows()) {
+    if (child_row_idx_ == num_selected_rows_) {
       child_row_idx_ = 0;
+      num_selected_rows_ = 0;
       // fetch next batch
       child_row_batch_->TransferResourceOwnership(row_batch);
       child_row_batch_->Reset();
       if (row_batch->AtCapacity()) return Status::OK;
       RETURN_IF_ERROR(child(0)->GetNext(state, child_row_batch_.get(), &child_eos_));
+      num_selected_rows_ = EvalConjuncts(&conjunct_ctxs_[0], conjunct_ctxs_.size(),
+          child_row_batch_.get(), &selected_rows_[0]);
     }
 
     if (CopyRows(row_batch)) {
       *eos = ReachedLimit()
-          || (child_row_idx_ == child_row_batch_->num_rows() && child_eos_);
+          || (child_row_idx_ == num_selected_rows_ && child_eos_);
       return Status::OK;
     }
     if (child_eos_) {
@@ -86,23 +91,17 @@ Status SelectNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos)
 }
 
 bool SelectNode::CopyRows(RowBatch* output_batch) {
-  ExprContext** conjunct_ctxs = &conjunct_ctxs_[0];
-  int num_conjunct_ctxs = conjunct_ctxs_.size();
-
-  for (; child_row_idx_ < child_row_batch_->num_rows(); ++child_row_idx_) {
+  for (; child_row_idx_ < num_selected_rows_; ++child_row_idx_) {
     // Add a new row to output_batch
     int dst_row_idx = output_batch->AddRow();
     if (dst_row_idx == RowBatch::INVALID_ROW_INDEX) return true;
     TupleRow* dst_row = output_batch->GetRow(dst_row_idx);
-    TupleRow* src_row = child_row_batch_->GetRow(child_row_idx_);
-
-    if (EvalConjuncts(conjunct_ctxs, num_conjunct_ctxs, src_row)) {
-      output_batch->CopyRow(src_row, dst_row);
-      output_batch->CommitLastRow();
-      ++num_rows_returned_;
-      COUNTER_SET(rows_returned_counter_, num_rows_returned_);
-      if (ReachedLimit()) return true;
-    }
+    TupleRow* src_row = child_row_batch_->GetRow(selected_rows_[child_row_idx_]);
+    output_batch->CopyRow(src_row, dst_row);
+    output_batch->CommitLastRow();
+    ++num_rows_returned_;
+    COUNTER_SET(rows_returned_counter_, num_rows_returned_);
+    if (ReachedLimit()) return true;
   }
   return output_batch->AtCapacity();
 }
@@ -42,14 +42,18 @@ class SelectNode : public ExecNode {
   // current row batch of child
   boost::scoped_ptr<RowBatch> child_row_batch_;
 
-  // index of current row in child_row_batch_
+  // Indices of the rows of child_row_batch_ that pass the conjuncts, and their number.
+  // Computed with ExecNode::EvalConjuncts() when a new child batch is fetched.
+  std::vector<int> selected_rows_;
+  int num_selected_rows_;
+
+  // index of the current row in selected_rows_
   int child_row_idx_;
 
   // true if last GetNext() call on child signalled eos
   bool child_eos_;
 
-  // Copy rows from child_row_batch_ for which conjuncts_ evaluate to true to
-  // output_batch, up to limit_.
+  // Copy the selected rows from child_row_batch_ to output_batch, up to limit_.
   // Return true if limit was hit or output_batch should be returned, otherwise false.
   bool CopyRows(RowBatch* output_batch);
 };
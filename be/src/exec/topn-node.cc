@@ -14,6 +14,7 @@
 
 #include "exec/topn-node.h"
 
+#include <algorithm>
 #include <sstream>
 
 #include "exprs/expr.h"
@@ -33,10 +34,18 @@
 using namespace impala;
 using namespace std;
 
+// tuple_pool_ is only replaced by a pool holding just the TopN if it has grown to at
+// least this many bytes.
+static const int64_t MIN_TUPLE_POOL_RECLAIM_BYTES = 1024 * 1024;
+
 TopNNode::TopNNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs)
   : ExecNode(pool, tnode, descs),
     offset_(tnode.sort_node.__isset.offset ? tnode.sort_node.offset : 0),
-    num_rows_skipped_(0) {
+    num_rows_skipped_(0),
+    boundary_(NULL),
+    tuple_pool_retained_bytes_(0),
+    materialized_batch_(NULL),
+    rows_filtered_counter_(NULL) {
 }
 
 Status TopNNode::Init(const TPlanNode& tnode) {
@@ -55,13 +64,16 @@ Status TopNNode::Prepare(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
   RETURN_IF_ERROR(ExecNode::Prepare(state));
   tuple_pool_.reset(new MemPool(mem_tracker()));
+  materialized_batch_pool_.reset(new MemPool(mem_tracker()));
   RETURN_IF_ERROR(sort_exec_exprs_.Prepare(
       state, child(0)->row_desc(), row_descriptor_, expr_mem_tracker()));
   AddExprCtxsToFree(sort_exec_exprs_);
   materialized_tuple_desc_ = row_descriptor_.tuple_descriptors()[0];
-  // Allocate memory for a temporary tuple.
-  tmp_tuple_ = reinterpret_cast<Tuple*>(
-      tuple_pool_->Allocate(materialized_tuple_desc_->byte_size()));
+  // Allocate memory to materialize a batch of input rows.
+  materialized_batch_ = materialized_batch_pool_->Allocate(
+      state->batch_size() * materialized_tuple_desc_->byte_size());
+  rows_filtered_counter_ =
+      ADD_COUNTER(runtime_profile(), "RowsFilteredByBoundary", TUnit::UNIT);
   return Status::OK;
 }
 
@@ -75,9 +87,7 @@ Status TopNNode::Open(RuntimeState* state) {
   tuple_row_less_than_.reset(new TupleRowComparator(
       sort_exec_exprs_.lhs_ordering_expr_ctxs(), sort_exec_exprs_.rhs_ordering_expr_ctxs(),
       is_asc_order_, nulls_first_));
-  priority_queue_.reset(
-      new priority_queue<Tuple*, vector<Tuple*>, TupleRowComparator>(
-          *tuple_row_less_than_));
+  if (limit_ > 0) top_n_.reserve(2 * (limit_ + offset_));
 
   RETURN_IF_ERROR(child(0)->Open(state));
 
@@ -88,15 +98,13 @@ Status TopNNode::Open(RuntimeState* state) {
     do {
       batch.Reset();
       RETURN_IF_ERROR(child(0)->GetNext(state, &batch, &eos));
-      for (int i = 0; i < batch.num_rows(); ++i) {
-        InsertTupleRow(batch.GetRow(i));
-      }
+      InsertBatch(&batch);
       RETURN_IF_CANCELLED(state);
       RETURN_IF_ERROR(QueryMaintenance(state));
     } while (!eos);
   }
-  DCHECK_LE(priority_queue_->size(), limit_ + offset_);
   PrepareForOutput();
+  DCHECK_LE(sorted_top_n_.size(), limit_ + offset_);
   child(0)->Close(state);
   return Status::OK;
 }
@@ -129,48 +137,82 @@ Status TopNNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
 void TopNNode::Close(RuntimeState* state) {
   if (is_closed()) return;
   if (tuple_pool_.get() != NULL) tuple_pool_->FreeAll();
+  if (materialized_batch_pool_.get() != NULL) materialized_batch_pool_->FreeAll();
   sort_exec_exprs_.Close(state);
   ExecNode::Close(state);
 }
 
-// Insert if either not at the limit or it's a new TopN tuple_row
-void TopNNode::InsertTupleRow(TupleRow* input_row) {
-  Tuple* insert_tuple = NULL;
-
-  if (priority_queue_->size() < limit_ + offset_) {
-    insert_tuple = reinterpret_cast<Tuple*>(
-        tuple_pool_->Allocate(materialized_tuple_desc_->byte_size()));
-    insert_tuple->MaterializeExprs<false>(input_row, *materialized_tuple_desc_,
-        sort_exec_exprs_.sort_tuple_slot_expr_ctxs(), tuple_pool_.get());
-  } else {
-    DCHECK(!priority_queue_->empty());
-    Tuple* top_tuple = priority_queue_->top();
-    tmp_tuple_->MaterializeExprs<false>(input_row, *materialized_tuple_desc_,
-            sort_exec_exprs_.sort_tuple_slot_expr_ctxs(), NULL);
-    if ((*tuple_row_less_than_)(tmp_tuple_, top_tuple)) {
-      // TODO: DeepCopy() will allocate new buffers for the string data. This needs
-      // to be fixed to use a freelist
-      tmp_tuple_->DeepCopy(top_tuple, *materialized_tuple_desc_, tuple_pool_.get());
-      insert_tuple = top_tuple;
-      priority_queue_->pop();
+void TopNNode::InsertBatch(RowBatch* batch) {
+  const int tuple_size = materialized_tuple_desc_->byte_size();
+  const vector<ExprContext*>& slot_expr_ctxs =
+      sort_exec_exprs_.sort_tuple_slot_expr_ctxs();
+  TupleLessThan less_than(tuple_row_less_than_.get());
+
+  // Materialize the batch and filter it against the boundary. The boundary does not
+  // change until the next compaction, so the rows can be filtered in one pass. The
+  // materialized tuples reference the string data in 'batch'.
+  int num_candidates = 0;
+  for (int i = 0; i < batch->num_rows(); ++i) {
+    Tuple* tuple = reinterpret_cast<Tuple*>(materialized_batch_ + i * tuple_size);
+    tuple->MaterializeExprs<false>(batch->GetRow(i), *materialized_tuple_desc_,
+        slot_expr_ctxs, NULL);
+    if (boundary_ != NULL && !less_than(tuple, boundary_)) continue;
+    // Move the candidates to the front of the materialized batch.
+    if (num_candidates != i) {
+      memcpy(materialized_batch_ + num_candidates * tuple_size, tuple, tuple_size);
     }
+    ++num_candidates;
   }
 
-  if (insert_tuple != NULL) priority_queue_->push(insert_tuple);
+  const int64_t top_n_size = limit_ + offset_;
+  int num_filtered = batch->num_rows() - num_candidates;
+  for (int i = 0; i < num_candidates; ++i) {
+    Tuple* tuple = reinterpret_cast<Tuple*>(materialized_batch_ + i * tuple_size);
+    // A compaction earlier in this batch may have tightened the boundary.
+    if (boundary_ != NULL && !less_than(tuple, boundary_)) {
+      ++num_filtered;
+      continue;
+    }
+    top_n_.push_back(tuple->DeepCopy(*materialized_tuple_desc_, tuple_pool_.get()));
+    if (top_n_.size() >= (boundary_ == NULL ? top_n_size : 2 * top_n_size)) Compact();
+  }
+  COUNTER_ADD(rows_filtered_counter_, num_filtered);
 }
 
-// Reverse the order of the tuples in the priority queue
-void TopNNode::PrepareForOutput() {
-  sorted_top_n_.resize(priority_queue_->size());
-  int index = sorted_top_n_.size() - 1;
-
-  while (priority_queue_->size() > 0) {
-    Tuple* tuple = priority_queue_->top();
-    priority_queue_->pop();
-    sorted_top_n_[index] = tuple;
-    --index;
+void TopNNode::Compact() {
+  const int64_t top_n_size = limit_ + offset_;
+  DCHECK_GE(top_n_.size(), top_n_size);
+  nth_element(top_n_.begin(), top_n_.begin() + top_n_size - 1, top_n_.end(),
+      TupleLessThan(tuple_row_less_than_.get()));
+  top_n_.resize(top_n_size);
+  boundary_ = top_n_.back();
+
+  // The discarded tuples are still allocated from tuple_pool_. Once they take up most
+  // of it, copy the TopN into a new pool and free the old one.
+  int64_t allocated_bytes = tuple_pool_->total_allocated_bytes();
+  if (allocated_bytes < MIN_TUPLE_POOL_RECLAIM_BYTES ||
+      allocated_bytes < 2 * tuple_pool_retained_bytes_) {
+    return;
   }
+  boost::scoped_ptr<MemPool> new_pool(new MemPool(mem_tracker()));
+  for (int i = 0; i < top_n_.size(); ++i) {
+    top_n_[i] = top_n_[i]->DeepCopy(*materialized_tuple_desc_, new_pool.get());
+  }
+  boundary_ = top_n_.back();
+  tuple_pool_->FreeAll();
+  tuple_pool_.swap(new_pool);
+  tuple_pool_retained_bytes_ = tuple_pool_->total_allocated_bytes();
+}
 
+void TopNNode::PrepareForOutput() {
+  TupleLessThan less_than(tuple_row_less_than_.get());
+  if (static_cast<int64_t>(top_n_.size()) > limit_ + offset_) {
+    nth_element(top_n_.begin(), top_n_.begin() + limit_ + offset_ - 1, top_n_.end(),
+        less_than);
+    top_n_.resize(limit_ + offset_);
+  }
+  sort(top_n_.begin(), top_n_.end(), less_than);
+  sorted_top_n_.swap(top_n_);
   get_next_iter_ = sorted_top_n_.begin();
 }
 
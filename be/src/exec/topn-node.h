@@ -16,7 +16,7 @@
 #ifndef IMPALA_EXEC_TOPN_NODE_H
 #define IMPALA_EXEC_TOPN_NODE_H
 
-#include <queue>
+#include <vector>
 #include <boost/scoped_ptr.hpp>
 
 #include "exec/exec-node.h"
@@ -34,7 +34,13 @@ class Tuple;
 // This handles the case where the result fits in memory.
 // This node will materialize its input rows into a new tuple using the expressions
 // in sort_tuple_slot_exprs_ in its sort_exec_exprs_ member.
-// TopN is implemented by storing rows in a priority queue.
+// TopN is implemented without a heap: once limit + offset rows were seen, the largest
+// tuple of the current TopN is the boundary. Each input batch is materialized as a
+// whole and only the rows that are less than the boundary are copied and appended to
+// an unordered buffer of candidates. When the buffer holds twice the TopN, it is
+// compacted to the TopN with a selection algorithm, which also tightens the boundary.
+// Since most rows of a large input are rejected by a single comparison with the
+// boundary, this avoids the heap maintenance per inserted row.
 class TopNNode : public ExecNode {
  public:
   TopNNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs);
@@ -50,13 +56,25 @@ class TopNNode : public ExecNode {
 
  private:
 
-  friend class TupleLessThan;
-
-  // Inserts a tuple row into the priority queue if it's in the TopN.  Creates a deep
-  // copy of tuple_row, which it stores in tuple_pool_.
-  void InsertTupleRow(TupleRow* tuple_row);
-
-  // Flatten and reverse the priority queue.
+  // Compares tuples with a TupleRowComparator. The std algorithms copy their
+  // comparator, so this holds a pointer to it.
+  struct TupleLessThan {
+    TupleLessThan(const TupleRowComparator* less_than) : less_than_(less_than) { }
+    bool operator()(Tuple* lhs, Tuple* rhs) const { return (*less_than_)(lhs, rhs); }
+    const TupleRowComparator* less_than_;
+  };
+
+  // Materializes the rows of 'batch' and adds copies of those that are less than
+  // boundary_ to top_n_, compacting top_n_ when it is full. The copies are stored in
+  // tuple_pool_.
+  void InsertBatch(RowBatch* batch);
+
+  // Keeps the smallest limit_ + offset_ tuples of top_n_ and makes the largest of them
+  // the new boundary_. Copies the remaining tuples into a new tuple_pool_ if the
+  // discarded tuples take up most of it.
+  void Compact();
+
+  // Sorts the TopN into sorted_top_n_.
   void PrepareForOutput();
 
   // Number of rows to skip.
@@ -73,24 +91,36 @@ class TopNNode : public ExecNode {
 
   boost::scoped_ptr<TupleRowComparator> tuple_row_less_than_;
 
-  // The priority queue will never have more elements in it than the LIMIT + OFFSET.
-  // The stl priority queue doesn't support a max size, so to get that functionality,
-  // the order of the queue is the opposite of what the ORDER BY clause specifies, such
-  // that the top of the queue is the last sorted element.
-  boost::scoped_ptr<
-      std::priority_queue<Tuple*, std::vector<Tuple*>, TupleRowComparator> >
-          priority_queue_;
+  // The TopN of the rows seen so far plus the candidates added since the last
+  // compaction, in no particular order. Never holds more than 2 * (limit_ + offset_)
+  // tuples.
+  std::vector<Tuple*> top_n_;
 
-  // After computing the TopN in the priority_queue, pop them and put them in this vector
+  // The largest tuple of the TopN as of the last compaction. Rows that are not less than
+  // it cannot be in the TopN. NULL until limit_ + offset_ rows were seen.
+  Tuple* boundary_;
+
+  // After computing the TopN in top_n_, sort them and put them in this vector
   std::vector<Tuple*> sorted_top_n_;
   std::vector<Tuple*>::iterator get_next_iter_;
 
-  // Stores everything referenced in priority_queue_
+  // Stores everything referenced in top_n_
   boost::scoped_ptr<MemPool> tuple_pool_;
-  // Tuple allocated once from tuple_pool_ and reused in InsertTupleRow to
-  // materialize input tuples if necessary. After materialization, tmp_tuple_ may be
-  // copied into the the tuple pool and inserted into the priority queue.
-  Tuple* tmp_tuple_;
+
+  // Value of tuple_pool_->total_allocated_bytes() after the last time it was replaced
+  // by Compact().
+  int64_t tuple_pool_retained_bytes_;
+
+  // Pool for materialized_batch_.
+  boost::scoped_ptr<MemPool> materialized_batch_pool_;
+
+  // One tuple per row of an input batch, allocated once from materialized_batch_pool_.
+  // Input rows are materialized into these before they are compared with boundary_, and
+  // only the rows that pass are copied into tuple_pool_.
+  uint8_t* materialized_batch_;
+
+  // Number of input rows that were rejected by the comparison with boundary_.
+  RuntimeProfile::Counter* rows_filtered_counter_;
 };
 
 };
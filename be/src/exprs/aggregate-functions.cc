@@ -1162,12 +1162,6 @@ DoubleVal AggregateFunctions::KnuthStddevPopFinalize(FunctionContext* ctx,
   return sqrt(ComputeKnuthVariance(*state, true));
 }
 
-struct RankState {
-  int64_t rank;
-  int64_t count;
-  RankState() : rank(1), count(0) { }
-};
-
 void AggregateFunctions::RankInit(FunctionContext* ctx, StringVal* dst) {
   int str_len = sizeof(RankState);
   dst->is_null = false;
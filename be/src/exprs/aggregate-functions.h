@@ -210,6 +210,14 @@ class AggregateFunctions {
   // also implement a (private) GetValue() method to just return the value. In that
   // case, Finalize() is only called at the end to clean up.
 
+  // Intermediate state for RANK and DENSE_RANK, stored in the StringVal slot. Public so
+  // that the AnalyticEvalNode can update it without calling RankUpdate().
+  struct RankState {
+    int64_t rank;
+    int64_t count;
+    RankState() : rank(1), count(0) { }
+  };
+
   // Initializes the state for RANK and DENSE_RANK
   static void RankInit(FunctionContext*, StringVal* slot);
 
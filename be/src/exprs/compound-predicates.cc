@@ -15,6 +15,9 @@
 #include "exprs/compound-predicates.h"
 #include "codegen/codegen-anyval.h"
 #include "codegen/llvm-codegen.h"
+#include "exprs/expr-column.h"
+#include "exprs/expr-context.h"
+#include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 
 using namespace impala;
@@ -46,6 +49,57 @@ BooleanVal OrPredicate::GetBooleanVal(ExprContext* context, TupleRow* row) {
   return BooleanVal(false);
 }
 
+template <bool and_fn>
+void CompoundPredicate::EvalCompoundBatch(ExprContext* context, RowBatch* batch,
+    const int* sel, int num_sel, ExprColumn* result) {
+  DCHECK_EQ(children_.size(), 2);
+  children_[0]->EvalBatch(context, batch, sel, num_sel, result);
+  bool* values = result->values<bool>();
+  uint8_t* is_null = result->is_null();
+
+  // Collect the rows that are not false (AND) or not true (OR). The column is only used
+  // as storage for their indices.
+  ExprColumn* remaining_column = context->AcquireBatchColumn(batch->num_rows());
+  int* remaining = remaining_column->values<int>();
+  int num_remaining = 0;
+  for (int i = 0; i < num_sel; ++i) {
+    int row_idx = sel == NULL ? i : sel[i];
+    remaining[num_remaining] = row_idx;
+    num_remaining += is_null[row_idx] || values[row_idx] == and_fn;
+  }
+
+  if (num_remaining > 0) {
+    ExprColumn* rhs = context->AcquireBatchColumn(batch->num_rows());
+    children_[1]->EvalBatch(context, batch, remaining, num_remaining, rhs);
+    const bool* rhs_values = rhs->values<bool>();
+    const uint8_t* rhs_is_null = rhs->is_null();
+    for (int i = 0; i < num_remaining; ++i) {
+      int row_idx = remaining[i];
+      if (!rhs_is_null[row_idx] && rhs_values[row_idx] != and_fn) {
+        // (<> && false) is false, (<> || true) is true
+        values[row_idx] = !and_fn;
+        is_null[row_idx] = 0;
+      } else {
+        // (true && NULL) and (NULL && true) are NULL, likewise for OR.
+        is_null[row_idx] |= rhs_is_null[row_idx];
+        values[row_idx] = is_null[row_idx] ? false : and_fn;
+      }
+    }
+    context->ReleaseBatchColumn();
+  }
+  context->ReleaseBatchColumn();
+}
+
+void AndPredicate::EvalBatch(ExprContext* context, RowBatch* batch, const int* sel,
+    int num_sel, ExprColumn* result) {
+  CompoundPredicate::EvalCompoundBatch<true>(context, batch, sel, num_sel, result);
+}
+
+void OrPredicate::EvalBatch(ExprContext* context, RowBatch* batch, const int* sel,
+    int num_sel, ExprColumn* result) {
+  CompoundPredicate::EvalCompoundBatch<false>(context, batch, sel, num_sel, result);
+}
+
 // IR codegen for compound and/or predicates.  Compound predicate has non trivial 
 // null handling as well as many branches so this is pretty complicated.  The IR 
 // for x && y is:
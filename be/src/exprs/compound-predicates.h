@@ -32,12 +32,21 @@ class CompoundPredicate: public Predicate {
   CompoundPredicate(const TExprNode& node) : Predicate(node) { }
 
   Status CodegenComputeFn(bool and_fn, RuntimeState* state, llvm::Function** fn);
+
+  // Implements EvalBatch() for AND if 'and_fn' is true, for OR otherwise. The second
+  // child is only evaluated over the rows whose result is not decided by the first one,
+  // like GetBooleanVal() short-circuits.
+  template <bool and_fn>
+  void EvalCompoundBatch(ExprContext* context, RowBatch* batch, const int* sel,
+      int num_sel, ExprColumn* result);
 };
 
 // Expr for evaluating and (&&) operators
 class AndPredicate: public CompoundPredicate {
  public:
   virtual impala_udf::BooleanVal GetBooleanVal(ExprContext* context, TupleRow*);
+  virtual void EvalBatch(ExprContext* context, RowBatch* batch, const int* sel,
+      int num_sel, ExprColumn* result);
 
   virtual Status GetCodegendComputeFn(RuntimeState* state, llvm::Function** fn) {
     return CompoundPredicate::CodegenComputeFn(true, state, fn);
@@ -61,6 +70,8 @@ class AndPredicate: public CompoundPredicate {
 class OrPredicate: public CompoundPredicate {
  public:
   virtual impala_udf::BooleanVal GetBooleanVal(ExprContext* context, TupleRow*);
+  virtual void EvalBatch(ExprContext* context, RowBatch* batch, const int* sel,
+      int num_sel, ExprColumn* result);
 
   virtual Status GetCodegendComputeFn(RuntimeState* state, llvm::Function** fn) {
     return CompoundPredicate::CodegenComputeFn(false, state, fn);
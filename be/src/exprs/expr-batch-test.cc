@@ -0,0 +1,503 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <string.h>
+#include <algorithm>
+#include <limits>
+#include <string>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+
+#include <gtest/gtest.h>
+#include "common/init.h"
+#include "common/object-pool.h"
+#include "exec/exec-node.h"
+#include "exprs/aggregate-functions.h"
+#include "exprs/expr.h"
+#include "exprs/expr-column.h"
+#include "exprs/expr-context.h"
+#include "exprs/expr-value.h"
+#include "runtime/descriptors.h"
+#include "runtime/exec-env.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/tuple-row.h"
+#include "testutil/desc-tbl-builder.h"
+#include "util/test-info.h"
+
+#include "gen-cpp/Exprs_types.h"
+#include "gen-cpp/ImpalaInternalService_types.h"
+
+using namespace boost;
+using namespace std;
+
+namespace impala {
+
+// Tests Expr::EvalBatch() and the batch version of ExecNode::EvalConjuncts() against
+// SQL's three-valued logic and the row-by-row GetBooleanVal().
+
+// The builtins, which are looked up in the test binary like the FE's symbols are looked
+// up in impalad.
+static const char* NOT_SYMBOL =
+    "_ZN6impala17CompoundPredicate3NotEPN10impala_udf15FunctionContextERKNS1_10Boolean"
+    "ValE";
+static const char* IN_ITERATE_SYMBOL =
+    "_ZN6impala11InPredicate9InIterateEPN10impala_udf15FunctionContextERKNS1_6IntVal"
+    "EiPS5_";
+static const char* NOT_IN_ITERATE_SYMBOL =
+    "_ZN6impala11InPredicate12NotInIterateEPN10impala_udf15FunctionContextERKNS1_6IntVal"
+    "EiPS5_";
+
+// Results of boolean exprs.
+enum TruthValue {
+  FALSE_VAL = 0,
+  TRUE_VAL = 1,
+  NULL_VAL = 2,
+};
+
+static TruthValue And(TruthValue x, TruthValue y) {
+  if (x == FALSE_VAL || y == FALSE_VAL) return FALSE_VAL;
+  if (x == NULL_VAL || y == NULL_VAL) return NULL_VAL;
+  return TRUE_VAL;
+}
+
+static TruthValue Or(TruthValue x, TruthValue y) {
+  if (x == TRUE_VAL || y == TRUE_VAL) return TRUE_VAL;
+  if (x == NULL_VAL || y == NULL_VAL) return NULL_VAL;
+  return FALSE_VAL;
+}
+
+static TruthValue Not(TruthValue x) {
+  if (x == NULL_VAL) return NULL_VAL;
+  return x == TRUE_VAL ? FALSE_VAL : TRUE_VAL;
+}
+
+// The test rows have the columns (a BOOLEAN, b BOOLEAN, c INT). The rows go through
+// all combinations of a and b, including NULLs, and c is NULL in every seventh row.
+static const int NUM_ROWS = 100;
+
+static TruthValue AValue(int row_idx) { return static_cast<TruthValue>(row_idx % 3); }
+static TruthValue BValue(int row_idx) {
+  return static_cast<TruthValue>((row_idx / 3) % 3);
+}
+static bool CIsNull(int row_idx) { return row_idx % 7 == 6; }
+static int32_t CValue(int row_idx) { return row_idx % 5; }
+
+// Returns the expected result of 'c [NOT] IN (1, 3[, NULL])'.
+static TruthValue InListValue(int row_idx, bool not_in, bool list_has_null) {
+  if (CIsNull(row_idx)) return NULL_VAL;
+  if (CValue(row_idx) == 1 || CValue(row_idx) == 3) return not_in ? FALSE_VAL : TRUE_VAL;
+  if (list_has_null) return NULL_VAL;
+  return not_in ? TRUE_VAL : FALSE_VAL;
+}
+
+static TExprNode MakeNode(TExprNodeType::type node_type, const ColumnType& type,
+    int num_children) {
+  TExprNode node;
+  node.node_type = node_type;
+  node.type = type.ToThrift();
+  node.num_children = num_children;
+  return node;
+}
+
+static TFunction MakeBuiltin(const string& name, const string& symbol,
+    const ColumnType& arg_type, bool has_var_args) {
+  TFunction fn;
+  fn.name.function_name = name;
+  fn.binary_type = TFunctionBinaryType::BUILTIN;
+  fn.arg_types.push_back(arg_type.ToThrift());
+  if (has_var_args) fn.arg_types.push_back(arg_type.ToThrift());
+  fn.ret_type = ColumnType(TYPE_BOOLEAN).ToThrift();
+  fn.has_var_args = has_var_args;
+  fn.__isset.scalar_fn = true;
+  fn.scalar_fn.symbol = symbol;
+  return fn;
+}
+
+// Functions to append the nodes of an expr tree to a TExpr in depth-first order.
+static void AddSlotRef(const SlotDescriptor* slot_desc, TExpr* expr) {
+  TExprNode node = MakeNode(TExprNodeType::SLOT_REF, slot_desc->type(), 0);
+  TSlotRef slot_ref;
+  slot_ref.slot_id = slot_desc->id();
+  node.__set_slot_ref(slot_ref);
+  expr->nodes.push_back(node);
+}
+
+static void AddIntLiteral(int32_t value, TExpr* expr) {
+  TExprNode node = MakeNode(TExprNodeType::INT_LITERAL, TYPE_INT, 0);
+  TIntLiteral int_literal;
+  int_literal.value = value;
+  node.__set_int_literal(int_literal);
+  expr->nodes.push_back(node);
+}
+
+static void AddNullLiteral(const ColumnType& type, TExpr* expr) {
+  expr->nodes.push_back(MakeNode(TExprNodeType::NULL_LITERAL, type, 0));
+}
+
+// 'op' is "and", "or" or "not".
+static void AddCompoundPredicate(const string& op, TExpr* expr) {
+  TExprNode node =
+      MakeNode(TExprNodeType::COMPOUND_PRED, TYPE_BOOLEAN, op == "not" ? 1 : 2);
+  if (op == "not") {
+    node.__set_fn(MakeBuiltin(op, NOT_SYMBOL, TYPE_BOOLEAN, false));
+  } else {
+    node.__isset.fn = true;
+    node.fn.name.function_name = op;
+  }
+  expr->nodes.push_back(node);
+}
+
+// Adds '[NOT] IN' with 'num_values' values, which must be added as the next children
+// after the compared expr.
+static void AddInPredicate(bool not_in, int num_values, TExpr* expr) {
+  TExprNode node = MakeNode(TExprNodeType::FUNCTION_CALL, TYPE_BOOLEAN, 1 + num_values);
+  node.__set_fn(MakeBuiltin(not_in ? "not_in_iterate" : "in_iterate",
+      not_in ? NOT_IN_ITERATE_SYMBOL : IN_ITERATE_SYMBOL, TYPE_INT, true));
+  node.__set_vararg_start_idx(1);
+  expr->nodes.push_back(node);
+}
+
+class ExprBatchTest : public testing::Test {
+ protected:
+  ExprBatchTest() : runtime_state_(TPlanFragmentInstanceCtx(), "", &exec_env_) {
+    exec_env_.InitForFeTests();
+    runtime_state_.InitMemTrackers(TUniqueId(), NULL, -1);
+  }
+
+  virtual void SetUp() {
+    DescriptorTblBuilder builder(&pool_);
+    builder.DeclareTuple() << TYPE_BOOLEAN << TYPE_BOOLEAN << TYPE_INT;
+    DescriptorTbl* desc_tbl = builder.Build();
+    runtime_state_.set_desc_tbl(desc_tbl);
+    vector<bool> nullable_tuples(1, false);
+    vector<TTupleId> tuple_ids(1, static_cast<TTupleId>(0));
+    row_desc_ = pool_.Add(new RowDescriptor(*desc_tbl, tuple_ids, nullable_tuples));
+    tuple_desc_ = desc_tbl->GetTupleDescriptor(0);
+    a_slot_ = tuple_desc_->slots()[0];
+    b_slot_ = tuple_desc_->slots()[1];
+    c_slot_ = tuple_desc_->slots()[2];
+    batch_.reset(CreateBatch(NUM_ROWS));
+  }
+
+  virtual void TearDown() {
+    for (int i = 0; i < ctxs_.size(); ++i) ctxs_[i]->Close(&runtime_state_);
+    batch_.reset();
+  }
+
+  RowBatch* CreateBatch(int num_rows) {
+    RowBatch* batch = new RowBatch(*row_desc_, max(num_rows, 1), &tracker_);
+    for (int i = 0; i < num_rows; ++i) {
+      int byte_size = tuple_desc_->byte_size();
+      Tuple* tuple = reinterpret_cast<Tuple*>(
+          batch->tuple_data_pool()->Allocate(byte_size));
+      memset(tuple, 0, byte_size);
+      SetBoolSlot(tuple, a_slot_, AValue(i));
+      SetBoolSlot(tuple, b_slot_, BValue(i));
+      if (CIsNull(i)) {
+        tuple->SetNull(c_slot_->null_indicator_offset());
+      } else {
+        *reinterpret_cast<int32_t*>(tuple->GetSlot(c_slot_->tuple_offset())) = CValue(i);
+      }
+      int row_idx = batch->AddRow();
+      batch->GetRow(row_idx)->SetTuple(0, tuple);
+      batch->CommitLastRow();
+    }
+    return batch;
+  }
+
+  void SetBoolSlot(Tuple* tuple, const SlotDescriptor* slot_desc, TruthValue value) {
+    if (value == NULL_VAL) {
+      tuple->SetNull(slot_desc->null_indicator_offset());
+    } else {
+      *reinterpret_cast<bool*>(tuple->GetSlot(slot_desc->tuple_offset())) =
+          value == TRUE_VAL;
+    }
+  }
+
+  ExprContext* CreateContext(const TExpr& texpr) {
+    ExprContext* ctx;
+    EXPECT_TRUE(Expr::CreateExprTree(&pool_, texpr, &ctx).ok());
+    Status status = ctx->Prepare(&runtime_state_, *row_desc_, &tracker_);
+    EXPECT_TRUE(status.ok()) << status.GetDetail();
+    status = ctx->Open(&runtime_state_);
+    EXPECT_TRUE(status.ok()) << status.GetDetail();
+    ctxs_.push_back(ctx);
+    return ctx;
+  }
+
+  static TruthValue ResultAt(const ExprColumn& result, int row_idx) {
+    if (result.is_null()[row_idx]) return NULL_VAL;
+    return result.values<bool>()[row_idx] ? TRUE_VAL : FALSE_VAL;
+  }
+
+  // Checks the results of the boolean expr in 'ctx' against 'expected', which has the
+  // result of every row of batch_: evaluated over the whole batch, over the rows of a
+  // selection vector and row by row.
+  void CheckResults(ExprContext* ctx, const vector<TruthValue>& expected) {
+    ExprColumn* result = ctx->EvalBatch(batch_.get(), NULL, batch_->num_rows());
+    for (int i = 0; i < batch_->num_rows(); ++i) {
+      EXPECT_EQ(expected[i], ResultAt(*result, i)) << "row " << i;
+    }
+
+    // Every third row, so that the first and second children of AND and OR see rows
+    // with gaps between them.
+    vector<int> sel;
+    for (int i = 1; i < batch_->num_rows(); i += 3) sel.push_back(i);
+    result = ctx->EvalBatch(batch_.get(), &sel[0], sel.size());
+    for (int i = 0; i < sel.size(); ++i) {
+      EXPECT_EQ(expected[sel[i]], ResultAt(*result, sel[i])) << "row " << sel[i];
+    }
+
+    for (int i = 0; i < batch_->num_rows(); ++i) {
+      BooleanVal val = ctx->GetBooleanVal(batch_->GetRow(i));
+      TruthValue value = val.is_null ? NULL_VAL : (val.val ? TRUE_VAL : FALSE_VAL);
+      EXPECT_EQ(expected[i], value) << "row " << i;
+    }
+  }
+
+  // Returns 'c [NOT] IN (1, 3[, NULL])'.
+  TExpr MakeInPredicate(bool not_in, bool list_has_null) {
+    TExpr texpr;
+    AddInPredicate(not_in, list_has_null ? 3 : 2, &texpr);
+    AddSlotRef(c_slot_, &texpr);
+    AddIntLiteral(1, &texpr);
+    AddIntLiteral(3, &texpr);
+    if (list_has_null) AddNullLiteral(TYPE_INT, &texpr);
+    return texpr;
+  }
+
+  ObjectPool pool_;
+  ExecEnv exec_env_;
+  RuntimeState runtime_state_;
+  MemTracker tracker_;
+  RowDescriptor* row_desc_;
+  TupleDescriptor* tuple_desc_;
+  SlotDescriptor* a_slot_;
+  SlotDescriptor* b_slot_;
+  SlotDescriptor* c_slot_;
+  scoped_ptr<RowBatch> batch_;
+  vector<ExprContext*> ctxs_;
+};
+
+TEST_F(ExprBatchTest, And) {
+  TExpr texpr;
+  AddCompoundPredicate("and", &texpr);
+  AddSlotRef(a_slot_, &texpr);
+  AddSlotRef(b_slot_, &texpr);
+  vector<TruthValue> expected;
+  for (int i = 0; i < NUM_ROWS; ++i) expected.push_back(And(AValue(i), BValue(i)));
+  CheckResults(CreateContext(texpr), expected);
+}
+
+TEST_F(ExprBatchTest, Or) {
+  TExpr texpr;
+  AddCompoundPredicate("or", &texpr);
+  AddSlotRef(a_slot_, &texpr);
+  AddSlotRef(b_slot_, &texpr);
+  vector<TruthValue> expected;
+  for (int i = 0; i < NUM_ROWS; ++i) expected.push_back(Or(AValue(i), BValue(i)));
+  CheckResults(CreateContext(texpr), expected);
+}
+
+TEST_F(ExprBatchTest, Not) {
+  // NOT is evaluated row by row, over the column of its child.
+  TExpr texpr;
+  AddCompoundPredicate("not", &texpr);
+  AddCompoundPredicate("or", &texpr);
+  AddSlotRef(a_slot_, &texpr);
+  AddSlotRef(b_slot_, &texpr);
+  vector<TruthValue> expected;
+  for (int i = 0; i < NUM_ROWS; ++i) expected.push_back(Not(Or(AValue(i), BValue(i))));
+  CheckResults(CreateContext(texpr), expected);
+}
+
+TEST_F(ExprBatchTest, Nested) {
+  // 'a AND (b OR NOT a)': the OR only sees the rows the AND did not decide, and the
+  // NOT only the rows the OR did not decide.
+  TExpr texpr;
+  AddCompoundPredicate("and", &texpr);
+  AddSlotRef(a_slot_, &texpr);
+  AddCompoundPredicate("or", &texpr);
+  AddSlotRef(b_slot_, &texpr);
+  AddCompoundPredicate("not", &texpr);
+  AddSlotRef(a_slot_, &texpr);
+  vector<TruthValue> expected;
+  for (int i = 0; i < NUM_ROWS; ++i) {
+    expected.push_back(And(AValue(i), Or(BValue(i), Not(AValue(i)))));
+  }
+  CheckResults(CreateContext(texpr), expected);
+}
+
+TEST_F(ExprBatchTest, InPredicate) {
+  for (int not_in = 0; not_in < 2; ++not_in) {
+    for (int list_has_null = 0; list_has_null < 2; ++list_has_null) {
+      vector<TruthValue> expected;
+      for (int i = 0; i < NUM_ROWS; ++i) {
+        expected.push_back(InListValue(i, not_in, list_has_null));
+      }
+      CheckResults(CreateContext(MakeInPredicate(not_in, list_has_null)), expected);
+    }
+  }
+}
+
+TEST_F(ExprBatchTest, EvalConjuncts) {
+  // 'a OR b' and 'c NOT IN (1, 3)'. Rows only pass if both are true.
+  TExpr or_texpr;
+  AddCompoundPredicate("or", &or_texpr);
+  AddSlotRef(a_slot_, &or_texpr);
+  AddSlotRef(b_slot_, &or_texpr);
+  ExprContext* conjuncts[2];
+  conjuncts[0] = CreateContext(or_texpr);
+  conjuncts[1] = CreateContext(MakeInPredicate(true, false));
+
+  // An empty batch, before the contexts have any columns.
+  scoped_ptr<RowBatch> empty_batch(CreateBatch(0));
+  int empty_sel[1];
+  EXPECT_EQ(ExecNode::EvalConjuncts(conjuncts, 2, empty_batch.get(), empty_sel), 0);
+
+  vector<int> sel(NUM_ROWS);
+  int num_sel = ExecNode::EvalConjuncts(conjuncts, 2, batch_.get(), &sel[0]);
+  vector<int> expected_sel;
+  for (int i = 0; i < NUM_ROWS; ++i) {
+    if (Or(AValue(i), BValue(i)) == TRUE_VAL && InListValue(i, true, false) == TRUE_VAL) {
+      expected_sel.push_back(i);
+    }
+    // The row-by-row version agrees.
+    EXPECT_EQ(ExecNode::EvalConjuncts(conjuncts, 2, batch_->GetRow(i)),
+        find(expected_sel.begin(), expected_sel.end(), i) != expected_sel.end());
+  }
+  ASSERT_FALSE(expected_sel.empty());
+  ASSERT_EQ(static_cast<int>(expected_sel.size()), num_sel);
+  for (int i = 0; i < num_sel; ++i) EXPECT_EQ(expected_sel[i], sel[i]);
+}
+
+// Fills 'column' with the rows [begin, end) of 'values', which are NULL where 'is_null'
+// is true.
+template <typename T>
+static void FillColumn(const vector<T>& values, const vector<bool>& is_null, int begin,
+    int end, ExprColumn* column) {
+  column->Reserve(end - begin);
+  for (int i = begin; i < end; ++i) {
+    column->values<T>()[i - begin] = is_null[i] ? T() : values[i];
+    column->is_null()[i - begin] = is_null[i];
+  }
+}
+
+TEST(ExprColumnTest, SumValues) {
+  int32_t int_values[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+  vector<int32_t> values(int_values, int_values + 10);
+  vector<bool> is_null(10, false);
+  for (int i = 1; i < 10; i += 2) is_null[i] = true;
+  ExprColumn column;
+  FillColumn(values, is_null, 0, 10, &column);
+  int64_t sum = 100;
+  EXPECT_EQ(5, column.SumValues<int32_t>(10, &sum));
+  EXPECT_EQ(100 + 1 + 3 + 5 + 7 + 9, sum);
+
+  // Only NULLs.
+  vector<bool> all_null(10, true);
+  FillColumn(values, all_null, 0, 10, &column);
+  EXPECT_EQ(0, column.SumValues<int32_t>(10, &sum));
+  EXPECT_EQ(125, sum);
+
+  // An empty batch, for which the column has no arrays.
+  ExprColumn empty_column;
+  EXPECT_EQ(0, empty_column.SumValues<int32_t>(0, &sum));
+  EXPECT_EQ(125, sum);
+
+  // Small integers are summed up as BIGINT and don't overflow.
+  int8_t tinyint_values[] = { 100, 100, 100 };
+  vector<int8_t> tinyints(tinyint_values, tinyint_values + 3);
+  ExprColumn tinyint_column;
+  FillColumn(tinyints, vector<bool>(3, false), 0, 3, &tinyint_column);
+  sum = 0;
+  EXPECT_EQ(3, tinyint_column.SumValues<int8_t>(3, &sum));
+  EXPECT_EQ(300, sum);
+}
+
+// Checks ExprColumn::MinMaxValues() against AggregateFunctions::Min() or Max(), the
+// row path of the aggregation. The result slot is initialized like
+// PartitionedAggregationNode::ConstructIntermediateTuple() does: NULL, with the largest
+// (for MIN) or smallest (for MAX) value of the type. The rows are reduced in one batch
+// and in two batches.
+template <bool IS_MIN>
+static void CheckMinMax(const vector<double>& values, const vector<bool>& is_null) {
+  DoubleVal expected = DoubleVal::null();
+  int expected_num_not_null = 0;
+  for (int i = 0; i < values.size(); ++i) {
+    DoubleVal src = is_null[i] ? DoubleVal::null() : DoubleVal(values[i]);
+    if (IS_MIN) {
+      AggregateFunctions::Min(NULL, src, &expected);
+    } else {
+      AggregateFunctions::Max(NULL, src, &expected);
+    }
+    expected_num_not_null += !is_null[i];
+  }
+
+  int num_rows = values.size();
+  int splits[] = { num_rows, num_rows / 2 };
+  for (int s = 0; s < 2; ++s) {
+    ExprValue init_value;
+    bool dst_is_null = true;
+    double dst = *reinterpret_cast<double*>(IS_MIN ?
+        init_value.SetToMax(TYPE_DOUBLE) : init_value.SetToMin(TYPE_DOUBLE));
+    ExprColumn first;
+    ExprColumn second;
+    FillColumn(values, is_null, 0, splits[s], &first);
+    FillColumn(values, is_null, splits[s], num_rows, &second);
+    int num_not_null =
+        first.MinMaxValues<double, IS_MIN>(splits[s], &dst_is_null, &dst);
+    num_not_null += second.MinMaxValues<double, IS_MIN>(
+        num_rows - splits[s], &dst_is_null, &dst);
+    EXPECT_EQ(expected_num_not_null, num_not_null) << "split " << splits[s];
+    EXPECT_EQ(expected.is_null, dst_is_null) << "split " << splits[s];
+    if (!expected.is_null) EXPECT_EQ(expected.val, dst) << "split " << splits[s];
+  }
+}
+
+TEST(ExprColumnTest, MinMaxValues) {
+  const double inf = numeric_limits<double>::infinity();
+  double value_lists[][4] = {
+    { inf, inf, inf, inf },
+    { -inf, -inf, -inf, -inf },
+    { 0, 3, -2, 7 },
+    { -5, -1, -7, -3 },
+    { 0, 0, 0, 0 },
+  };
+  bool null_lists[][4] = {
+    { false, false, false, false },
+    { true, false, true, false },
+    { true, true, true, true },
+  };
+  for (int v = 0; v < 5; ++v) {
+    for (int n = 0; n < 3; ++n) {
+      for (int num_rows = 0; num_rows <= 4; ++num_rows) {
+        vector<double> values(value_lists[v], value_lists[v] + num_rows);
+        vector<bool> is_null(null_lists[n], null_lists[n] + num_rows);
+        CheckMinMax<true>(values, is_null);
+        CheckMinMax<false>(values, is_null);
+      }
+    }
+  }
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::InitCommonRuntime(argc, argv, false, impala::TestInfo::BE_TEST);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,135 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_EXPRS_EXPR_COLUMN_H
+#define IMPALA_EXPRS_EXPR_COLUMN_H
+
+#include <vector>
+#include <boost/cstdint.hpp>
+
+#include "runtime/types.h"
+
+namespace impala {
+
+// The results of evaluating an expr over the rows of a row batch with
+// Expr::EvalBatch(). The values and NULL indicators are stored in arrays that are
+// indexed by the index of the row in the batch, so the columns of an expr and its
+// children line up and the loops over them can be vectorized by the compiler. Only the
+// entries of the rows that were evaluated are valid. The values of NULL rows are
+// unspecified (but valid values of the type).
+//
+// Only fixed-length types of up to 8 bytes can be stored, see IsSupportedType(). The
+// values are stored in their slot representation, e.g. bool for BOOLEAN and int32_t for
+// INT.
+class ExprColumn {
+ public:
+  ExprColumn() : capacity_(0) { }
+
+  // Makes room for the results of the rows [0, num_rows).
+  void Reserve(int num_rows) {
+    if (num_rows <= capacity_) return;
+    values_.resize(num_rows);
+    is_null_.resize(num_rows);
+    capacity_ = num_rows;
+  }
+
+  // The arrays are NULL until Reserve() is called with a positive number of rows, e.g.
+  // for empty batches.
+  template <typename T>
+  T* values() {
+    return values_.empty() ? NULL : reinterpret_cast<T*>(&values_[0]);
+  }
+
+  template <typename T>
+  const T* values() const {
+    return values_.empty() ? NULL : reinterpret_cast<const T*>(&values_[0]);
+  }
+
+  // 1 if the result of the row is NULL, 0 otherwise.
+  uint8_t* is_null() { return is_null_.empty() ? NULL : &is_null_[0]; }
+  const uint8_t* is_null() const { return is_null_.empty() ? NULL : &is_null_[0]; }
+
+  // Adds the non-NULL values of the rows [0, num_rows) to *sum. Returns the number of
+  // non-NULL values. Only for integer types: the values are summed up into a partial sum
+  // first, which would change the rounding of floating point sums.
+  template <typename T>
+  int SumValues(int num_rows, int64_t* sum) const {
+    const T* values = this->values<T>();
+    const uint8_t* is_null = this->is_null();
+    int64_t result = 0;
+    int num_not_null = 0;
+    for (int i = 0; i < num_rows; ++i) {
+      result += is_null[i] ? 0 : static_cast<int64_t>(values[i]);
+      num_not_null += !is_null[i];
+    }
+    *sum += result;
+    return num_not_null;
+  }
+
+  // Updates *dst to the minimum (or maximum if IS_MIN is false) of itself and the
+  // non-NULL values of the rows [0, num_rows), in row order. If *dst_is_null is true,
+  // *dst is ignored and the first non-NULL value is taken as is, like
+  // AggregateFunctions::Min() and Max() do, so e.g. the MIN of infinite values is
+  // infinite. *dst_is_null is cleared if there is a non-NULL value. Returns the number
+  // of non-NULL values.
+  template <typename T, bool IS_MIN>
+  int MinMaxValues(int num_rows, bool* dst_is_null, T* dst) const {
+    const T* values = this->values<T>();
+    const uint8_t* is_null = this->is_null();
+    int i = 0;
+    int num_not_null = 0;
+    if (*dst_is_null) {
+      while (i < num_rows && is_null[i]) ++i;
+      if (i == num_rows) return 0;
+      *dst = values[i++];
+      *dst_is_null = false;
+      num_not_null = 1;
+    }
+    T result = *dst;
+    for (; i < num_rows; ++i) {
+      bool replace = IS_MIN ? values[i] < result : values[i] > result;
+      result = (!is_null[i] & replace) ? values[i] : result;
+      num_not_null += !is_null[i];
+    }
+    *dst = result;
+    return num_not_null;
+  }
+
+  // Returns true if results of 'type' can be stored in an ExprColumn.
+  static bool IsSupportedType(const ColumnType& type) {
+    switch (type.type) {
+      case TYPE_BOOLEAN:
+      case TYPE_TINYINT:
+      case TYPE_SMALLINT:
+      case TYPE_INT:
+      case TYPE_BIGINT:
+      case TYPE_FLOAT:
+      case TYPE_DOUBLE:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+ private:
+  // 8 bytes per row, which fits all supported types and keeps the values aligned.
+  std::vector<int64_t> values_;
+  std::vector<uint8_t> is_null_;
+  int capacity_;
+};
+
+}
+
+#endif
@@ -17,7 +17,9 @@
 #include <sstream>
 
 #include "exprs/expr.h"
+#include "exprs/expr-column.h"
 #include "runtime/mem-pool.h"
+#include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "udf/udf-internal.h"
 
@@ -30,6 +32,7 @@ const char* ExprContext::LLVM_CLASS_NAME = "class.impala::ExprContext";
 ExprContext::ExprContext(Expr* root)
   : fn_contexts_ptr_(NULL),
     root_(root),
+    num_batch_columns_used_(0),
     is_clone_(false),
     prepared_(false),
     opened_(false),
@@ -200,6 +203,11 @@ void* ExprContext::GetValue(TupleRow* row) {
   return GetValue(root_, row);
 }
 
+void* ExprContext::GetConstantValue(Expr* e) {
+  DCHECK(e->IsConstant());
+  return GetValue(e, NULL);
+}
+
 void* ExprContext::GetValue(Expr* e, TupleRow* row) {
   switch (e->type_.type) {
     case TYPE_BOOLEAN: {
@@ -306,6 +314,25 @@ void ExprContext::PrintValue(TupleRow* row, stringstream* stream) {
   RawValue::PrintValue(GetValue(row), root_->type(), root_->output_scale_, stream);
 }
 
+ExprColumn* ExprContext::EvalBatch(RowBatch* batch, const int* sel, int num_sel) {
+  DCHECK(prepared_);
+  DCHECK_EQ(num_batch_columns_used_, 0);
+  ExprColumn* result = AcquireBatchColumn(batch->num_rows());
+  root_->EvalBatch(this, batch, sel, num_sel, result);
+  // The result stays valid, the column is only reused by the next call.
+  ReleaseBatchColumn();
+  return result;
+}
+
+ExprColumn* ExprContext::AcquireBatchColumn(int num_rows) {
+  if (num_batch_columns_used_ == batch_columns_.size()) {
+    batch_columns_.push_back(new ExprColumn());
+  }
+  ExprColumn* column = &batch_columns_[num_batch_columns_used_++];
+  column->Reserve(num_rows);
+  return column;
+}
+
 BooleanVal ExprContext::GetBooleanVal(TupleRow* row) {
   return root_->GetBooleanVal(this, row);
 }
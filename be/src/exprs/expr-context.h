@@ -16,6 +16,7 @@
 #define IMPALA_EXPRS_EXPR_CONTEXT_H
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
 
 #include "common/status.h"
 #include "exprs/expr-value.h"
@@ -26,9 +27,11 @@ using namespace impala_udf;
 namespace impala {
 
 class Expr;
+class ExprColumn;
 class MemPool;
 class MemTracker;
 class RuntimeState;
+class RowBatch;
 class RowDescriptor;
 class TColumnValue;
 class TupleRow;
@@ -64,6 +67,17 @@ class ExprContext {
   // result in result_.
   void* GetValue(TupleRow* row);
 
+  // Returns the value of 'e', a constant expr in the tree of this context, e.g. the
+  // constant argument of a predicate. Like GetValue(), the result is only valid until
+  // the next call that evaluates an expr of this context.
+  void* GetConstantValue(Expr* e);
+
+  // Evaluates the expr tree over the rows of 'batch' whose indices are in
+  // sel[0, num_sel), or the rows [0, num_sel) if 'sel' is NULL, see Expr::EvalBatch().
+  // The type of the root expr must be supported by ExprColumn. Returns the results,
+  // which are owned by this context and valid until the next call to EvalBatch().
+  ExprColumn* EvalBatch(RowBatch* batch, const int* sel, int num_sel);
+
   // Convenience function: extract value into col_val and sets the
   // appropriate __isset flag.
   // If the value is NULL and as_ascii is false, nothing is set.
@@ -102,6 +116,16 @@ class ExprContext {
     return fn_contexts_[i];
   }
 
+  // Returns a column with room for the results of 'num_rows' rows, for Exprs to
+  // evaluate their children into in Expr::EvalBatch(). Columns must be released with
+  // ReleaseBatchColumn() in the reverse order they were acquired in. This should only
+  // be called by Exprs.
+  ExprColumn* AcquireBatchColumn(int num_rows);
+  void ReleaseBatchColumn() {
+    DCHECK_GT(num_batch_columns_used_, 0);
+    --num_batch_columns_used_;
+  }
+
   Expr* root() { return root_; }
   bool closed() { return closed_; }
 
@@ -150,6 +174,11 @@ class ExprContext {
   // void*.
   ExprValue result_;
 
+  // Columns for the intermediate results of EvalBatch(). The first
+  // num_batch_columns_used_ are in use, and are used like a stack by the exprs.
+  boost::ptr_vector<ExprColumn> batch_columns_;
+  int num_batch_columns_used_;
+
   // Debugging variables.
   bool is_clone_;
   bool prepared_;
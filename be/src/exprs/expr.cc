@@ -28,6 +28,7 @@
 #include "common/status.h"
 #include "exprs/anyval-util.h"
 #include "exprs/expr.h"
+#include "exprs/expr-column.h"
 #include "exprs/expr-context.h"
 #include "exprs/aggregate-functions.h"
 #include "exprs/case-expr.h"
@@ -54,6 +55,7 @@
 #include "gen-cpp/Exprs_types.h"
 #include "gen-cpp/Data_types.h"
 #include "runtime/lib-cache.h"
+#include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "runtime/raw-value.h"
 #include "udf/udf.h"
@@ -408,6 +410,13 @@ string Expr::DebugString(const vector<ExprContext*>& ctxs) {
   return DebugString(exprs);
 }
 
+const string& Expr::builtin_fn_name() const {
+  static const string EMPTY;
+  // fn_ is empty for exprs that are not function calls.
+  if (fn_.binary_type != TFunctionBinaryType::BUILTIN) return EMPTY;
+  return fn_.name.function_name;
+}
+
 bool Expr::IsConstant() const {
   for (int i = 0; i < children_.size(); ++i) {
     if (!children_[i]->IsConstant()) return false;
@@ -415,6 +424,13 @@ bool Expr::IsConstant() const {
   return true;
 }
 
+bool Expr::IsDeterministic() const {
+  for (int i = 0; i < children_.size(); ++i) {
+    if (!children_[i]->IsDeterministic()) return false;
+  }
+  return true;
+}
+
 int Expr::GetSlotIds(vector<SlotId>* slot_ids) const {
   int n = 0;
   for (int i = 0; i < children_.size(); ++i) {
@@ -610,3 +626,57 @@ DecimalVal Expr::GetDecimalVal(ExprContext* context, TupleRow* row) {
   DCHECK(false) << DebugString();
   return DecimalVal::null();
 }
+
+// Stores the result of GetValue() in 'values' and 'is_null' at index 'row_idx'.
+template <typename T>
+static inline void StoreValue(void* value, int row_idx, T* values, uint8_t* is_null) {
+  is_null[row_idx] = value == NULL;
+  values[row_idx] = value == NULL ? T() : *reinterpret_cast<T*>(value);
+}
+
+template <typename T>
+void Expr::EvalRowByRow(ExprContext* context, RowBatch* batch, const int* sel,
+    int num_sel, ExprColumn* result) {
+  T* values = result->values<T>();
+  uint8_t* is_null = result->is_null();
+  if (IsConstant()) {
+    void* value = context->GetValue(this, NULL);
+    for (int i = 0; i < num_sel; ++i) {
+      StoreValue(value, sel == NULL ? i : sel[i], values, is_null);
+    }
+    return;
+  }
+  for (int i = 0; i < num_sel; ++i) {
+    int row_idx = sel == NULL ? i : sel[i];
+    StoreValue(context->GetValue(this, batch->GetRow(row_idx)), row_idx, values, is_null);
+  }
+}
+
+void Expr::EvalBatch(ExprContext* context, RowBatch* batch, const int* sel,
+    int num_sel, ExprColumn* result) {
+  switch (type_.type) {
+    case TYPE_BOOLEAN:
+      EvalRowByRow<bool>(context, batch, sel, num_sel, result);
+      break;
+    case TYPE_TINYINT:
+      EvalRowByRow<int8_t>(context, batch, sel, num_sel, result);
+      break;
+    case TYPE_SMALLINT:
+      EvalRowByRow<int16_t>(context, batch, sel, num_sel, result);
+      break;
+    case TYPE_INT:
+      EvalRowByRow<int32_t>(context, batch, sel, num_sel, result);
+      break;
+    case TYPE_BIGINT:
+      EvalRowByRow<int64_t>(context, batch, sel, num_sel, result);
+      break;
+    case TYPE_FLOAT:
+      EvalRowByRow<float>(context, batch, sel, num_sel, result);
+      break;
+    case TYPE_DOUBLE:
+      EvalRowByRow<double>(context, batch, sel, num_sel, result);
+      break;
+    default:
+      DCHECK(false) << "Type not supported by ExprColumn: " << type_;
+  }
+}
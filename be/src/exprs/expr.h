@@ -103,9 +103,11 @@ namespace llvm {
 namespace impala {
 
 class Expr;
+class ExprColumn;
 class IsNullExpr;
 class LlvmCodeGen;
 class ObjectPool;
+class RowBatch;
 class RowDescriptor;
 class RuntimeState;
 class TColumnValue;
@@ -132,6 +134,20 @@ class Expr {
   virtual TimestampVal GetTimestampVal(ExprContext* context, TupleRow*);
   virtual DecimalVal GetDecimalVal(ExprContext* context, TupleRow*);
 
+  // Evaluates this expr over a batch of rows: the rows of 'batch' whose indices are in
+  // sel[0, num_sel), or the rows [0, num_sel) if 'sel' is NULL. The result of row i is
+  // stored at index i of 'result', which must have room for batch->num_rows() rows. The
+  // type of this expr must be supported by ExprColumn.
+  //
+  // The default implementation calls the Get*Val() function of this expr for every row,
+  // or once if this expr is constant. Exprs that can do better override it with loops
+  // over the columns of their children, which they evaluate with EvalBatch() into
+  // columns from ExprContext::AcquireBatchColumn(). Children whose type is not
+  // supported by ExprColumn cannot be evaluated that way, in which case the default
+  // implementation must be used.
+  virtual void EvalBatch(ExprContext* context, RowBatch* batch, const int* sel,
+      int num_sel, ExprColumn* result);
+
   // Get the number of digits after the decimal that should be displayed for this
   // value. Returns -1 if no scale has been specified (currently the scale is only set for
   // doubles set by RoundUpTo). GetValue() must have already been called.
@@ -147,11 +163,20 @@ class Expr {
 
   const std::vector<Expr*>& children() const { return children_; }
 
+  // Returns the name of the builtin function called by this expr, or an empty string if
+  // this expr does not call a builtin function.
+  const std::string& builtin_fn_name() const;
+
   // Returns true if GetValue(NULL) can be called on this expr and always returns the same
   // result (e.g., exprs that don't contain slotrefs). The default implementation returns
   // true if all children are constant.
   virtual bool IsConstant() const;
 
+  // Returns true if this expr always returns the same result for the same input row,
+  // e.g. doesn't call rand(). The default implementation returns true if all children
+  // are deterministic.
+  virtual bool IsDeterministic() const;
+
   // Returns the slots that are referenced by this expr tree in 'slot_ids'.
   // Returns the number of slots added to the vector
   virtual int GetSlotIds(std::vector<SlotId>* slot_ids) const;
@@ -358,6 +383,11 @@ class Expr {
       const std::vector<TExprNode>& nodes, Expr* parent, int* node_idx,
       Expr** root_expr, ExprContext** ctx);
 
+  // Implementation of the default EvalBatch() for results of type T.
+  template <typename T>
+  void EvalRowByRow(ExprContext* context, RowBatch* batch, const int* sel, int num_sel,
+      ExprColumn* result);
+
   // Static wrappers around the virtual Get*Val() functions. Calls the appropriate
   // Get*Val() function on expr, passing it the context and row arguments.
   //
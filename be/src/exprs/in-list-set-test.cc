@@ -0,0 +1,84 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "exprs/in-list-set.h"
+#include "util/cpu-info.h"
+
+using namespace std;
+
+namespace impala {
+
+TEST(InListSet, Ints) {
+  for (int num_values = 0; num_values < 10000; num_values = num_values * 3 + 1) {
+    InListSet<int64_t> in_list;
+    set<int64_t> expected;
+    // Add every value twice, duplicates must not be added again.
+    in_list.Init(2 * num_values);
+    for (int i = 0; i < num_values; ++i) {
+      int64_t value = rand() % (2 * num_values);
+      in_list.Insert(value);
+      in_list.Insert(value);
+      expected.insert(value);
+    }
+    EXPECT_EQ(in_list.size(), expected.size());
+    for (int64_t i = -1; i <= 2 * num_values; ++i) {
+      EXPECT_EQ(in_list.Contains(i), expected.find(i) != expected.end()) << i;
+    }
+  }
+}
+
+TEST(InListSet, Doubles) {
+  InListSet<double> in_list;
+  in_list.Init(3);
+  in_list.Insert(0.0);
+  in_list.Insert(1.5);
+  in_list.Insert(-2.25);
+  EXPECT_TRUE(in_list.Contains(0.0));
+  EXPECT_TRUE(in_list.Contains(-0.0));
+  EXPECT_TRUE(in_list.Contains(1.5));
+  EXPECT_TRUE(in_list.Contains(-2.25));
+  EXPECT_FALSE(in_list.Contains(2.25));
+}
+
+TEST(InListSet, Strings) {
+  const char* STRINGS[] = { "", "a", "ab", "abc", "b", "a\0b", "abcdefghijklmnopq" };
+  const int STRING_LENS[] = { 0, 1, 2, 3, 1, 3, 17 };
+  const int NUM_STRINGS = sizeof(STRING_LENS) / sizeof(int);
+  InListSet<StringValue> in_list;
+  in_list.Init(NUM_STRINGS);
+  // Only add every other string.
+  for (int i = 0; i < NUM_STRINGS; i += 2) {
+    in_list.Insert(StringValue(const_cast<char*>(STRINGS[i]), STRING_LENS[i]));
+  }
+  for (int i = 0; i < NUM_STRINGS; ++i) {
+    // Look up copies, so that the strings are compared and not the pointers.
+    string copy(STRINGS[i], STRING_LENS[i]);
+    StringValue value(const_cast<char*>(copy.data()), copy.size());
+    EXPECT_EQ(in_list.Contains(value), i % 2 == 0) << i;
+  }
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::CpuInfo::Init();
+  return RUN_ALL_TESTS();
+}
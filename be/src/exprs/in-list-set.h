@@ -0,0 +1,124 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_EXPRS_IN_LIST_SET_H
+#define IMPALA_EXPRS_IN_LIST_SET_H
+
+#include <algorithm>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+#include "common/logging.h"
+#include "runtime/decimal-value.h"
+#include "runtime/string-value.inline.h"
+#include "runtime/timestamp-value.h"
+#include "util/bit-util.h"
+#include "util/hash-util.h"
+
+namespace impala {
+
+// Set of the non-NULL constant values of an IN list. It is built once when the
+// predicate is prepared and probed for every row, so it is laid out for lookups: an
+// open addressing hash table with linear probing whose size is a power of two and at
+// least twice the number of values. A lookup of a value that is not in the list
+// usually ends at the first or second slot, which stays cheap for IN lists with
+// hundreds of thousands of values, unlike the tree of a std::set or a binary search.
+// Each slot stores the hash of its value, so strings are only compared if their
+// hashes are equal.
+//
+// T is one of the SetTypes of InPredicate, or int64_t for the integer types.
+template <typename T>
+class InListSet {
+ public:
+  InListSet() : mask_(0), size_(0) { }
+
+  // Clears the set and sizes it for up to 'max_values' values.
+  void Init(int max_values) {
+    int64_t num_slots = BitUtil::NextPowerOfTwo(std::max<int64_t>(2 * max_values, 2));
+    slots_.assign(num_slots, Slot());
+    mask_ = num_slots - 1;
+    size_ = 0;
+  }
+
+  // Adds 'value' if it is not in the set yet. Must not be called more than the
+  // 'max_values' times passed to Init().
+  void Insert(const T& value) {
+    uint32_t hash = HashValue(value);
+    for (int64_t i = hash & mask_; ; i = (i + 1) & mask_) {
+      Slot* slot = &slots_[i];
+      if (!slot->occupied) {
+        DCHECK_LT(2 * size_, mask_ + 1);
+        slot->occupied = true;
+        slot->hash = hash;
+        slot->value = value;
+        ++size_;
+        return;
+      }
+      if (slot->hash == hash && slot->value == value) return;
+    }
+  }
+
+  bool Contains(const T& value) const {
+    uint32_t hash = HashValue(value);
+    for (int64_t i = hash & mask_; ; i = (i + 1) & mask_) {
+      const Slot& slot = slots_[i];
+      if (!slot.occupied) return false;
+      if (slot.hash == hash && slot.value == value) return true;
+    }
+  }
+
+  // Number of distinct values in the set.
+  int size() const { return size_; }
+
+ private:
+  struct Slot {
+    Slot() : occupied(false), hash(0), value() { }
+    bool occupied;
+    uint32_t hash;
+    T value;
+  };
+
+  // The hash functions of the values. -0.0 and 0.0 are equal, so they are hashed the
+  // same.
+  static uint32_t HashValue(bool v) { return v; }
+  static uint32_t HashValue(int8_t v) { return HashUtil::Hash(&v, sizeof(v), 0); }
+  static uint32_t HashValue(int16_t v) { return HashUtil::Hash(&v, sizeof(v), 0); }
+  static uint32_t HashValue(int32_t v) { return HashUtil::Hash(&v, sizeof(v), 0); }
+  static uint32_t HashValue(int64_t v) { return HashUtil::Hash(&v, sizeof(v), 0); }
+  static uint32_t HashValue(float v) {
+    if (v == 0) v = 0;
+    return HashUtil::Hash(&v, sizeof(v), 0);
+  }
+  static uint32_t HashValue(double v) {
+    if (v == 0) v = 0;
+    return HashUtil::Hash(&v, sizeof(v), 0);
+  }
+  static uint32_t HashValue(const StringValue& v) {
+    return HashUtil::Hash(v.ptr, v.len, 0);
+  }
+  static uint32_t HashValue(const TimestampValue& v) { return v.Hash(); }
+  static uint32_t HashValue(const Decimal16Value& v) { return v.Hash(); }
+
+  std::vector<Slot> slots_;
+
+  // slots_.size() - 1, to map hashes to slots.
+  int64_t mask_;
+
+  int size_;
+};
+
+}
+
+#endif
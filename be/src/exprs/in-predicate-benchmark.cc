@@ -318,11 +318,16 @@ int main(int argc, char **argv) {
 
   for (int i = 1; i <= 10; ++i) InPredicateBenchmark::RunIntBenchmark(i);
   InPredicateBenchmark::RunIntBenchmark(400);
+  // IN lists of ids generated by BI tools.
+  InPredicateBenchmark::RunIntBenchmark(10000);
+  InPredicateBenchmark::RunIntBenchmark(100000);
 
   cout << endl;
 
   for (int i = 1; i <= 10; ++i) InPredicateBenchmark::RunStringBenchmark(i);
   InPredicateBenchmark::RunStringBenchmark(400);
+  InPredicateBenchmark::RunStringBenchmark(10000);
+  InPredicateBenchmark::RunStringBenchmark(100000);
 
   for (int i = 1; i <= 4; ++i) InPredicateBenchmark::RunDecimalBenchmark(i);
   InPredicateBenchmark::RunDecimalBenchmark(400);
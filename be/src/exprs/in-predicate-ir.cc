@@ -98,13 +98,14 @@ void InPredicate::SetLookupPrepare(
   SetLookupState<SetType>* state = new SetLookupState<SetType>;
   state->type = ctx->GetArgType(0);
   state->contains_null = false;
+  state->val_set.Init(ctx->GetNumArgs() - 1);
   for (int i = 1; i < ctx->GetNumArgs(); ++i) {
     DCHECK(ctx->IsArgConstant(i));
     T* arg = reinterpret_cast<T*>(ctx->GetConstantArg(i));
     if (arg->is_null) {
       state->contains_null = true;
     } else {
-      state->val_set.insert(GetVal<T, SetType>(state->type, *arg));
+      state->val_set.Insert(GetVal<T, SetType>(state->type, *arg));
     }
   }
   ctx->SetFunctionState(scope, state);
@@ -143,7 +144,7 @@ BooleanVal InPredicate::SetLookup(
     SetLookupState<SetType>* state, const T& v) {
   DCHECK_NOTNULL(state);
   SetType val = GetVal<T, SetType>(state->type, v);
-  bool found = state->val_set.find(val) != state->val_set.end();
+  bool found = state->val_set.Contains(val);
   if (found) return BooleanVal(true);
   if (state->contains_null) return BooleanVal::null();
   return BooleanVal(false);
@@ -17,6 +17,7 @@
 #define IMPALA_EXPRS_IN_PREDICATE_H_
 
 #include <string>
+#include "exprs/in-list-set.h"
 #include "exprs/predicate.h"
 #include "udf/udf.h"
 
@@ -278,9 +279,9 @@ class InPredicate : public Predicate {
     bool contains_null;
 
     // The set of all non-NULL constant values in the IN list.
-    // Note: boost::unordered_set and std::binary_search performed worse based on the
-    // in-predicate-benchmark
-    std::set<SetType> val_set;
+    // Note: std::set, boost::unordered_set and std::binary_search performed worse based
+    // on the in-predicate-benchmark, especially for large IN lists.
+    InListSet<SetType> val_set;
 
     // The type of the arguments
     const FunctionContext::TypeDesc* type;
@@ -14,6 +14,7 @@
 
 #include "exprs/scalar-fn-call.h"
 
+#include <algorithm>
 #include <vector>
 #include <gutil/strings/substitute.h>
 #include <llvm/IR/Attributes.h>
@@ -25,6 +26,7 @@
 #include "exprs/expr-context.h"
 #include "runtime/hdfs-fs-cache.h"
 #include "runtime/lib-cache.h"
+#include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "runtime/types.h"
 #include "udf/udf-internal.h"
@@ -44,7 +46,9 @@ ScalarFnCall::ScalarFnCall(const TExprNode& node)
     scalar_fn_wrapper_(NULL),
     prepare_fn_(NULL),
     close_fn_(NULL),
-    scalar_fn_(NULL) {
+    scalar_fn_(NULL),
+    batch_op_(BATCH_OP_NONE),
+    in_list_has_null_(false) {
   DCHECK_NE(fn_.binary_type, TFunctionBinaryType::HIVE);
 }
 
@@ -141,6 +145,7 @@ Status ScalarFnCall::Prepare(RuntimeState* state, const RowDescriptor& desc,
         reinterpret_cast<void**>(&close_fn_)));
   }
 
+  batch_op_ = GetBatchOp();
   return Status::OK;
 }
 
@@ -168,6 +173,17 @@ Status ScalarFnCall::Open(RuntimeState* state, ExprContext* ctx,
       constant_args.push_back(children_[i]->GetConstVal(ctx));
     }
     fn_ctx->impl()->SetConstantArgs(constant_args);
+
+    if (batch_op_ == BATCH_OP_IN || batch_op_ == BATCH_OP_NOT_IN) {
+      switch (children_[0]->type().type) {
+        case TYPE_BOOLEAN: InitInList<bool>(ctx); break;
+        case TYPE_TINYINT: InitInList<int8_t>(ctx); break;
+        case TYPE_SMALLINT: InitInList<int16_t>(ctx); break;
+        case TYPE_INT: InitInList<int32_t>(ctx); break;
+        case TYPE_BIGINT: InitInList<int64_t>(ctx); break;
+        default: DCHECK(false) << children_[0]->type();
+      }
+    }
   }
 
   if (prepare_fn_ != NULL) {
@@ -212,6 +228,13 @@ bool ScalarFnCall::IsConstant() const {
   return Expr::IsConstant();
 }
 
+bool ScalarFnCall::IsDeterministic() const {
+  if (fn_.name.function_name == "rand") return false;
+  // Nothing is known about UDFs, they may keep state between calls.
+  if (fn_.binary_type != TFunctionBinaryType::BUILTIN) return false;
+  return Expr::IsDeterministic();
+}
+
 // Dynamically loads the pre-compiled UDF and codegens a function that calls each child's
 // codegen'd function, then passes those values to the UDF and returns the result.
 // Example generated IR for a UDF with signature
@@ -736,3 +759,202 @@ string ScalarFnCall::DebugString() const {
       << " symbol_name=" << fn_.scalar_fn.symbol << Expr::DebugString() << ")";
   return out.str();
 }
+
+ScalarFnCall::BatchOp ScalarFnCall::GetBatchOp() const {
+  if (fn_.binary_type != TFunctionBinaryType::BUILTIN) return BATCH_OP_NONE;
+  if (!ExprColumn::IsSupportedType(type_)) return BATCH_OP_NONE;
+  if (children_.empty()) return BATCH_OP_NONE;
+  const ColumnType& arg_type = children_[0]->type();
+  for (int i = 0; i < children_.size(); ++i) {
+    if (children_[i]->type() != arg_type) return BATCH_OP_NONE;
+  }
+  if (!ExprColumn::IsSupportedType(arg_type)) return BATCH_OP_NONE;
+
+  const string& name = fn_.name.function_name;
+  if (children_.size() == 2 && type_.type == TYPE_BOOLEAN) {
+    if (name == "eq") return BATCH_OP_EQ;
+    if (name == "ne") return BATCH_OP_NE;
+    if (name == "lt") return BATCH_OP_LT;
+    if (name == "gt") return BATCH_OP_GT;
+    if (name == "le") return BATCH_OP_LE;
+    if (name == "ge") return BATCH_OP_GE;
+  }
+  if (children_.size() == 2 && type_ == arg_type && type_.type != TYPE_BOOLEAN) {
+    if (name == "add") return BATCH_OP_ADD;
+    if (name == "subtract") return BATCH_OP_SUBTRACT;
+    if (name == "multiply") return BATCH_OP_MULTIPLY;
+  }
+  // The IN list is stored as int64_t values, which does not work for floating point.
+  if (type_.type == TYPE_BOOLEAN && arg_type.type != TYPE_FLOAT &&
+      arg_type.type != TYPE_DOUBLE) {
+    for (int i = 1; i < children_.size(); ++i) {
+      if (!children_[i]->IsConstant()) return BATCH_OP_NONE;
+    }
+    if (name == "in_iterate" || name == "in_set_lookup") return BATCH_OP_IN;
+    if (name == "not_in_iterate" || name == "not_in_set_lookup") return BATCH_OP_NOT_IN;
+  }
+  return BATCH_OP_NONE;
+}
+
+template <typename T>
+void ScalarFnCall::InitInList(ExprContext* context) {
+  in_list_.Init(children_.size() - 1);
+  in_list_has_null_ = false;
+  for (int i = 1; i < children_.size(); ++i) {
+    void* value = context->GetValue(children_[i], NULL);
+    if (value == NULL) {
+      in_list_has_null_ = true;
+    } else {
+      in_list_.Insert(*reinterpret_cast<T*>(value));
+    }
+  }
+}
+
+struct AddOp {
+  template <typename T> static T Apply(T x, T y) { return x + y; }
+};
+struct SubtractOp {
+  template <typename T> static T Apply(T x, T y) { return x - y; }
+};
+struct MultiplyOp {
+  template <typename T> static T Apply(T x, T y) { return x * y; }
+};
+struct EqOp {
+  template <typename T> static bool Apply(T x, T y) { return x == y; }
+};
+struct NeOp {
+  template <typename T> static bool Apply(T x, T y) { return x != y; }
+};
+struct LtOp {
+  template <typename T> static bool Apply(T x, T y) { return x < y; }
+};
+struct GtOp {
+  template <typename T> static bool Apply(T x, T y) { return x > y; }
+};
+struct LeOp {
+  template <typename T> static bool Apply(T x, T y) { return x <= y; }
+};
+struct GeOp {
+  template <typename T> static bool Apply(T x, T y) { return x >= y; }
+};
+
+// Applies 'Op' to the values of 'lhs' and 'rhs' of the selected rows. The operation
+// is also applied to NULL rows, whose results are ignored, so that there are no
+// branches in the loops.
+template <typename T, typename RESULT_TYPE, typename Op>
+static void ApplyBinaryOp(const ExprColumn& lhs, const ExprColumn& rhs, const int* sel,
+    int num_sel, ExprColumn* result) {
+  const T* x = lhs.values<T>();
+  const T* y = rhs.values<T>();
+  const uint8_t* x_is_null = lhs.is_null();
+  const uint8_t* y_is_null = rhs.is_null();
+  RESULT_TYPE* values = result->values<RESULT_TYPE>();
+  uint8_t* is_null = result->is_null();
+  if (sel == NULL) {
+    // All rows are selected, the compiler can vectorize this loop.
+    for (int i = 0; i < num_sel; ++i) {
+      values[i] = Op::Apply(x[i], y[i]);
+      is_null[i] = x_is_null[i] | y_is_null[i];
+    }
+  } else {
+    for (int i = 0; i < num_sel; ++i) {
+      int row_idx = sel[i];
+      values[row_idx] = Op::Apply(x[row_idx], y[row_idx]);
+      is_null[row_idx] = x_is_null[row_idx] | y_is_null[row_idx];
+    }
+  }
+}
+
+template <typename T>
+void ScalarFnCall::EvalBatchOp(ExprContext* context, RowBatch* batch, const int* sel,
+    int num_sel, ExprColumn* result) {
+  ExprColumn* arg = context->AcquireBatchColumn(batch->num_rows());
+  children_[0]->EvalBatch(context, batch, sel, num_sel, arg);
+
+  if (batch_op_ == BATCH_OP_IN || batch_op_ == BATCH_OP_NOT_IN) {
+    const T* arg_values = arg->values<T>();
+    const uint8_t* arg_is_null = arg->is_null();
+    const bool not_in = batch_op_ == BATCH_OP_NOT_IN;
+    bool* values = result->values<bool>();
+    uint8_t* is_null = result->is_null();
+    for (int i = 0; i < num_sel; ++i) {
+      int row_idx = sel == NULL ? i : sel[i];
+      bool found = !arg_is_null[row_idx] && in_list_.Contains(arg_values[row_idx]);
+      // Like InPredicate, the result is NULL if the value is NULL or if it is not in
+      // the list and the list contains NULL.
+      is_null[row_idx] = arg_is_null[row_idx] || (!found && in_list_has_null_);
+      values[row_idx] = found != not_in;
+    }
+    context->ReleaseBatchColumn();
+    return;
+  }
+
+  ExprColumn* arg2 = context->AcquireBatchColumn(batch->num_rows());
+  children_[1]->EvalBatch(context, batch, sel, num_sel, arg2);
+  switch (batch_op_) {
+    case BATCH_OP_ADD:
+      ApplyBinaryOp<T, T, AddOp>(*arg, *arg2, sel, num_sel, result);
+      break;
+    case BATCH_OP_SUBTRACT:
+      ApplyBinaryOp<T, T, SubtractOp>(*arg, *arg2, sel, num_sel, result);
+      break;
+    case BATCH_OP_MULTIPLY:
+      ApplyBinaryOp<T, T, MultiplyOp>(*arg, *arg2, sel, num_sel, result);
+      break;
+    case BATCH_OP_EQ:
+      ApplyBinaryOp<T, bool, EqOp>(*arg, *arg2, sel, num_sel, result);
+      break;
+    case BATCH_OP_NE:
+      ApplyBinaryOp<T, bool, NeOp>(*arg, *arg2, sel, num_sel, result);
+      break;
+    case BATCH_OP_LT:
+      ApplyBinaryOp<T, bool, LtOp>(*arg, *arg2, sel, num_sel, result);
+      break;
+    case BATCH_OP_GT:
+      ApplyBinaryOp<T, bool, GtOp>(*arg, *arg2, sel, num_sel, result);
+      break;
+    case BATCH_OP_LE:
+      ApplyBinaryOp<T, bool, LeOp>(*arg, *arg2, sel, num_sel, result);
+      break;
+    case BATCH_OP_GE:
+      ApplyBinaryOp<T, bool, GeOp>(*arg, *arg2, sel, num_sel, result);
+      break;
+    default:
+      DCHECK(false) << batch_op_;
+  }
+  context->ReleaseBatchColumn();
+  context->ReleaseBatchColumn();
+}
+
+void ScalarFnCall::EvalBatch(ExprContext* context, RowBatch* batch, const int* sel,
+    int num_sel, ExprColumn* result) {
+  if (batch_op_ == BATCH_OP_NONE || IsConstant()) {
+    Expr::EvalBatch(context, batch, sel, num_sel, result);
+    return;
+  }
+  switch (children_[0]->type().type) {
+    case TYPE_BOOLEAN:
+      EvalBatchOp<bool>(context, batch, sel, num_sel, result);
+      break;
+    case TYPE_TINYINT:
+      EvalBatchOp<int8_t>(context, batch, sel, num_sel, result);
+      break;
+    case TYPE_SMALLINT:
+      EvalBatchOp<int16_t>(context, batch, sel, num_sel, result);
+      break;
+    case TYPE_INT:
+      EvalBatchOp<int32_t>(context, batch, sel, num_sel, result);
+      break;
+    case TYPE_BIGINT:
+      EvalBatchOp<int64_t>(context, batch, sel, num_sel, result);
+      break;
+    case TYPE_FLOAT:
+      EvalBatchOp<float>(context, batch, sel, num_sel, result);
+      break;
+    case TYPE_DOUBLE:
+      EvalBatchOp<double>(context, batch, sel, num_sel, result);
+      break;
+    default:
+      DCHECK(false) << children_[0]->type();
+  }
+}
@@ -19,6 +19,8 @@
 #include <string>
 
 #include "exprs/expr.h"
+#include "exprs/expr-column.h"
+#include "exprs/in-list-set.h"
 #include "udf/udf.h"
 
 using namespace impala_udf;
@@ -39,6 +41,11 @@ class TExprNode;
 // function even if codegen is disabled. Codegen will also be used for IR UDFs (note that
 // there is no way to specify both a native and IR library for a single UDF).
 //
+// Some builtins are evaluated with loops over the columns of their arguments in
+// EvalBatch(): arithmetic (+, -, *) and comparisons of numeric and boolean arguments,
+// and IN predicates over integer or boolean arguments with constant IN lists. All other
+// functions are evaluated one row at a time by the default EvalBatch().
+//
 // TODO:
 // - Fix error reporting, e.g. reporting leaks
 // - Testing
@@ -62,6 +69,7 @@ class ScalarFnCall: public Expr {
       FunctionContext::FunctionStateScope scope = FunctionContext::FRAGMENT_LOCAL);
 
   virtual bool IsConstant() const;
+  virtual bool IsDeterministic() const;
 
   virtual BooleanVal GetBooleanVal(ExprContext* context, TupleRow*);
   virtual TinyIntVal GetTinyIntVal(ExprContext* context, TupleRow*);
@@ -74,7 +82,34 @@ class ScalarFnCall: public Expr {
   virtual TimestampVal GetTimestampVal(ExprContext* context, TupleRow*);
   virtual DecimalVal GetDecimalVal(ExprContext* context, TupleRow*);
 
+  virtual void EvalBatch(ExprContext* context, RowBatch* batch, const int* sel,
+      int num_sel, ExprColumn* result);
+
  private:
+  // The builtins that have a vectorized EvalBatch().
+  enum BatchOp {
+    BATCH_OP_NONE,
+    BATCH_OP_ADD,
+    BATCH_OP_SUBTRACT,
+    BATCH_OP_MULTIPLY,
+    BATCH_OP_EQ,
+    BATCH_OP_NE,
+    BATCH_OP_LT,
+    BATCH_OP_GT,
+    BATCH_OP_LE,
+    BATCH_OP_GE,
+    BATCH_OP_IN,
+    BATCH_OP_NOT_IN,
+  };
+
+  // Set in Prepare().
+  BatchOp batch_op_;
+
+  // For BATCH_OP_IN and BATCH_OP_NOT_IN: the non-NULL values of the IN list, widened
+  // to int64_t, and whether it contains NULL. Set in Open().
+  InListSet<int64_t> in_list_;
+  bool in_list_has_null_;
+
   // If this function has var args, children()[vararg_start_idx_] is the first vararg
   // argument.
   // If this function does not have varargs, it is set to -1.
@@ -119,6 +154,18 @@ class ScalarFnCall: public Expr {
   // Function to call scalar_fn_. Used in the interpreted path.
   template<typename RETURN_TYPE>
   RETURN_TYPE InterpretEval(ExprContext* context, TupleRow* row);
+
+  // Returns the BatchOp that EvalBatch() can use for this function.
+  BatchOp GetBatchOp() const;
+
+  // Evaluates the constant IN list into in_list_. T is the type of the arguments.
+  template <typename T>
+  void InitInList(ExprContext* context);
+
+  // Implementation of EvalBatch() for arguments of type T.
+  template <typename T>
+  void EvalBatchOp(ExprContext* context, RowBatch* batch, const int* sel, int num_sel,
+      ExprColumn* result);
 };
 
 }
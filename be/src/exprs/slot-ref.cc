@@ -18,7 +18,9 @@
 
 #include "codegen/codegen-anyval.h"
 #include "codegen/llvm-codegen.h"
+#include "exprs/expr-column.h"
 #include "gen-cpp/Exprs_types.h"
+#include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 
 using namespace impala_udf;
@@ -459,4 +461,36 @@ DecimalVal SlotRef::GetDecimalVal(ExprContext* context, TupleRow* row) {
   }
 }
 
+template <typename T>
+void SlotRef::CopySlots(RowBatch* batch, const int* sel, int num_sel,
+    ExprColumn* result) {
+  T* values = result->values<T>();
+  uint8_t* is_null = result->is_null();
+  for (int i = 0; i < num_sel; ++i) {
+    int row_idx = sel == NULL ? i : sel[i];
+    Tuple* t = batch->GetRow(row_idx)->GetTuple(tuple_idx_);
+    if (t == NULL || t->IsNull(null_indicator_offset_)) {
+      values[row_idx] = T();
+      is_null[row_idx] = 1;
+    } else {
+      values[row_idx] = *reinterpret_cast<T*>(t->GetSlot(slot_offset_));
+      is_null[row_idx] = 0;
+    }
+  }
+}
+
+void SlotRef::EvalBatch(ExprContext* context, RowBatch* batch, const int* sel,
+    int num_sel, ExprColumn* result) {
+  switch (type_.type) {
+    case TYPE_BOOLEAN: CopySlots<bool>(batch, sel, num_sel, result); break;
+    case TYPE_TINYINT: CopySlots<int8_t>(batch, sel, num_sel, result); break;
+    case TYPE_SMALLINT: CopySlots<int16_t>(batch, sel, num_sel, result); break;
+    case TYPE_INT: CopySlots<int32_t>(batch, sel, num_sel, result); break;
+    case TYPE_BIGINT: CopySlots<int64_t>(batch, sel, num_sel, result); break;
+    case TYPE_FLOAT: CopySlots<float>(batch, sel, num_sel, result); break;
+    case TYPE_DOUBLE: CopySlots<double>(batch, sel, num_sel, result); break;
+    default: DCHECK(false) << "Type not supported by ExprColumn: " << type_;
+  }
+}
+
 }
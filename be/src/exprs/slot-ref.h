@@ -52,12 +52,20 @@ class SlotRef : public Expr {
   virtual impala_udf::TimestampVal GetTimestampVal(ExprContext* context, TupleRow*);
   virtual impala_udf::DecimalVal GetDecimalVal(ExprContext* context, TupleRow*);
 
+  // Copies the slot of the selected rows into 'result'.
+  virtual void EvalBatch(ExprContext* context, RowBatch* batch, const int* sel,
+      int num_sel, ExprColumn* result);
+
  protected:
   int tuple_idx_;  // within row
   int slot_offset_;  // within tuple
   NullIndicatorOffset null_indicator_offset_;  // within tuple
   const SlotId slot_id_;
   bool tuple_is_nullable_; // true if the tuple is nullable.
+
+ private:
+  template <typename T>
+  void CopySlots(RowBatch* batch, const int* sel, int num_sel, ExprColumn* result);
 };
 
 }
@@ -51,6 +51,7 @@
 #include "statestore/scheduler.h"
 #include "exec/data-sink.h"
 #include "exec/scan-node.h"
+#include "util/bloom-filter.h"
 #include "util/container-util.h"
 #include "util/debug-util.h"
 #include "util/error-util.h"
@@ -65,6 +66,7 @@
 #include "gen-cpp/Frontend_types.h"
 #include "gen-cpp/PlanNodes_types.h"
 #include "gen-cpp/Partitions_types.h"
+#include "gen-cpp/DataSinks_types.h"
 #include "gen-cpp/ImpalaInternalService_constants.h"
 
 using namespace std;
@@ -76,12 +78,20 @@ using namespace strings;
 
 DECLARE_int32(be_port);
 DECLARE_string(hostname);
+DECLARE_int64(adaptive_join_max_broadcast_bytes);
 
 DEFINE_bool(insert_inherit_permissions, false, "If true, new directories created by "
     "INSERTs will inherit the permissions of their parent directories");
+DEFINE_bool(enable_global_runtime_filters, true, "If true, hash joins send a bloom "
+    "filter over their build side through the coordinator to the scans of their probe "
+    "side in other fragments.");
 
 namespace impala {
 
+// Global filters with a higher fraction of bits set have a false positive rate of more
+// than ~15% and are not published.
+static const double MAX_GLOBAL_FILTER_FILL_RATIO = 0.8;
+
 // container for debug options in TPlanFragmentExecParams (debug_node, debug_action,
 // debug_phase)
 struct DebugOptions {
@@ -303,11 +313,15 @@ Coordinator::Coordinator(ExecEnv* exec_env, RuntimeProfile::EventSequence* event
     executor_(NULL), // Set in Prepare()
     query_mem_tracker_(), // Set in Exec()
     num_remaining_backends_(0),
+    filter_fragments_started_(false),
     obj_pool_(new ObjectPool()),
     query_events_(events) {
 }
 
 Coordinator::~Coordinator() {
+  // Waits for the filters and exchange modes that are being published.
+  filter_publish_pool_.reset();
+  exchange_publish_pool_.reset();
   query_mem_tracker_.reset();
 }
 
@@ -385,6 +399,20 @@ Status Coordinator::Exec(QuerySchedule& schedule,
   fragment_exec_params = *(schedule.exec_params());
   // print them now
   TNetworkAddress coord = MakeNetworkAddress(FLAGS_hostname, FLAGS_be_port);
+  InitGlobalFilters(request);
+  if (!global_filters_.empty()) {
+    // Every filter is offered once, so Offer() never blocks.
+    filter_publish_pool_.reset(new ThreadPool<SlotId>("coordinator", "filter-publisher",
+        1, global_filters_.size(), bind<void>(
+            mem_fn(&Coordinator::PublishGlobalFilter), this, _1, _2)));
+  }
+  RETURN_IF_ERROR(InitAdaptiveExchanges(request));
+  if (!adaptive_exchanges_.empty()) {
+    // Every exchange is offered once, so Offer() never blocks.
+    exchange_publish_pool_.reset(new ThreadPool<PlanNodeId>("coordinator",
+        "exchange-mode-publisher", 1, adaptive_exchanges_.size(), bind<void>(
+            mem_fn(&Coordinator::PublishExchangeMode), this, _1, _2)));
+  }
 
   // to keep things simple, make async Cancel() calls wait until plan fragment
   // execution has been initiated, otherwise we might try to cancel fragment
@@ -500,6 +528,33 @@ Status Coordinator::Exec(QuerySchedule& schedule,
   }
 
   query_events_->MarkEvent("Remote fragments started");
+
+  // Publish the global filters and exchange modes that were completed while fragments
+  // were being started.
+  vector<SlotId> ready_filters;
+  vector<PlanNodeId> ready_exchanges;
+  {
+    lock_guard<mutex> l(filter_lock_);
+    filter_fragments_started_ = true;
+    for (GlobalFilterMap::iterator it = global_filters_.begin();
+         it != global_filters_.end(); ++it) {
+      if (it->second.num_pending_instances > 0) continue;
+      it->second.published = true;
+      ready_filters.push_back(it->first);
+    }
+    for (AdaptiveExchangeMap::iterator it = adaptive_exchanges_.begin();
+         it != adaptive_exchanges_.end(); ++it) {
+      if (!it->second.decided || it->second.published) continue;
+      it->second.published = true;
+      ready_exchanges.push_back(it->first);
+    }
+  }
+  for (int i = 0; i < ready_filters.size(); ++i) {
+    filter_publish_pool_->Offer(ready_filters[i]);
+  }
+  for (int i = 0; i < ready_exchanges.size(); ++i) {
+    exchange_publish_pool_->Offer(ready_exchanges[i]);
+  }
   query_profile_->AddInfoString("Fragment start latencies",
       latencies.ToHumanReadable());
 
@@ -1558,6 +1613,322 @@ Status Coordinator::UpdateFragmentExecStatus(const TReportExecStatusParams& para
   return Status::OK;
 }
 
+void Coordinator::InitGlobalFilters(const TQueryExecRequest& request) {
+  if (!FLAGS_enable_global_runtime_filters) return;
+
+  unordered_map<SlotId, TupleId> slot_parents;
+  BOOST_FOREACH(const TSlotDescriptor& slot_desc, desc_tbl_.slotDescriptors) {
+    slot_parents[slot_desc.id] = slot_desc.parent;
+  }
+  // Fragments that scan each tuple.
+  unordered_map<TupleId, vector<int> > scan_fragments;
+  for (int i = 0; i < request.fragments.size(); ++i) {
+    BOOST_FOREACH(const TPlanNode& node, request.fragments[i].plan.nodes) {
+      if (node.node_type != TPlanNodeType::HDFS_SCAN_NODE) continue;
+      scan_fragments[node.hdfs_scan_node.tuple_id].push_back(i);
+    }
+  }
+
+  // Slots that are probe slots of more than one join. The filters of different joins
+  // would have to be intersected rather than merged, so they are skipped.
+  unordered_set<SlotId> ambiguous_slots;
+  for (int i = 0; i < request.fragments.size(); ++i) {
+    BOOST_FOREACH(const TPlanNode& node, request.fragments[i].plan.nodes) {
+      if (node.node_type != TPlanNodeType::HASH_JOIN_NODE) continue;
+      // The planner only lists the probe slots of joins that drop the probe rows
+      // without a match, and only if the path from the join to the scan of the slot
+      // is made of exchanges and joins, which don't change the result of the remaining
+      // rows. E.g. it is not safe to filter the probe side of a left outer join, or
+      // below an aggregation.
+      if (!node.hash_join_node.__isset.global_filter_probe_slot_ids) continue;
+      BOOST_FOREACH(SlotId slot_id, node.hash_join_node.global_filter_probe_slot_ids) {
+        if (slot_parents.find(slot_id) == slot_parents.end()) continue;
+
+        // The scans in the join's own fragment already get the local bitmap filter.
+        vector<int> dst_fragment_idxs;
+        BOOST_FOREACH(int scan_fragment_idx, scan_fragments[slot_parents[slot_id]]) {
+          if (scan_fragment_idx != i) dst_fragment_idxs.push_back(scan_fragment_idx);
+        }
+        if (dst_fragment_idxs.empty()) continue;
+
+        if (global_filters_.find(slot_id) != global_filters_.end()) {
+          ambiguous_slots.insert(slot_id);
+          continue;
+        }
+        GlobalFilterState& filter_state = global_filters_[slot_id];
+        filter_state.src_fragment_idx = i;
+        filter_state.dst_fragment_idxs = dst_fragment_idxs;
+        filter_state.num_pending_instances = fragment_exec_params[i].hosts.size();
+      }
+    }
+  }
+  BOOST_FOREACH(SlotId slot_id, ambiguous_slots) global_filters_.erase(slot_id);
+
+  for (GlobalFilterMap::iterator it = global_filters_.begin();
+       it != global_filters_.end(); ++it) {
+    VLOG_QUERY << "Global filter on slot " << it->first << " from fragment "
+               << it->second.src_fragment_idx << " to "
+               << it->second.dst_fragment_idxs.size() << " fragment(s)";
+  }
+}
+
+void Coordinator::SetGlobalFilterParams(int fragment_idx,
+    TPlanFragmentExecParams* params) {
+  vector<SlotId> source_slot_ids;
+  vector<SlotId> target_slot_ids;
+  for (GlobalFilterMap::iterator it = global_filters_.begin();
+       it != global_filters_.end(); ++it) {
+    const GlobalFilterState& filter_state = it->second;
+    if (filter_state.src_fragment_idx == fragment_idx) {
+      source_slot_ids.push_back(it->first);
+    }
+    const vector<int>& dst_fragment_idxs = filter_state.dst_fragment_idxs;
+    if (std::find(dst_fragment_idxs.begin(), dst_fragment_idxs.end(), fragment_idx) !=
+        dst_fragment_idxs.end()) {
+      target_slot_ids.push_back(it->first);
+    }
+  }
+  if (!source_slot_ids.empty()) {
+    params->__set_global_filter_source_slot_ids(source_slot_ids);
+  }
+  if (!target_slot_ids.empty()) {
+    params->__set_global_filter_target_slot_ids(target_slot_ids);
+  }
+}
+
+Status Coordinator::UpdateFilter(const TUpdateFilterParams& params) {
+  VLOG_FILE << "UpdateFilter() query_id=" << query_id_
+            << " instance_id=" << params.fragment_instance_id
+            << " slot_id=" << params.slot_id
+            << (params.__isset.bloom_filter ? "" : " (disabled)");
+  GlobalFilterState* filter_state;
+  {
+    lock_guard<mutex> l(filter_lock_);
+    GlobalFilterMap::iterator it = global_filters_.find(params.slot_id);
+    if (it == global_filters_.end() || it->second.num_pending_instances == 0) {
+      return Status(Substitute("Unexpected global filter on slot $0 from instance $1",
+          params.slot_id, PrintId(params.fragment_instance_id)));
+    }
+    filter_state = &it->second;
+    --filter_state->num_pending_instances;
+
+    if (!params.__isset.bloom_filter) {
+      filter_state->disabled = true;
+    } else if (!filter_state->disabled) {
+      const uint8_t* data = reinterpret_cast<const uint8_t*>(params.bloom_filter.data());
+      if (filter_state->filter == NULL) {
+        filter_state->filter = obj_pool()->Add(new BloomFilter(0));
+        if (!BloomFilter::Deserialize(data, params.bloom_filter.size(),
+                filter_state->filter)) {
+          filter_state->disabled = true;
+        }
+      } else {
+        BloomFilter filter(0);
+        if (BloomFilter::Deserialize(data, params.bloom_filter.size(), &filter) &&
+            filter.log_num_blocks() == filter_state->filter->log_num_blocks()) {
+          filter_state->filter->Or(filter);
+        } else {
+          filter_state->disabled = true;
+        }
+      }
+    }
+    if (filter_state->num_pending_instances > 0) return Status::OK;
+
+    // A filter that passes almost every value is not worth applying.
+    if (!filter_state->disabled &&
+        filter_state->filter->FillRatio() > MAX_GLOBAL_FILTER_FILL_RATIO) {
+      VLOG_QUERY << "Disabling global filter on slot " << params.slot_id
+                 << ": fill ratio " << filter_state->filter->FillRatio();
+      filter_state->disabled = true;
+    }
+    if (filter_state->disabled) filter_state->filter = NULL;
+    // Exec() publishes the filters that are complete once all fragments are started.
+    if (!filter_fragments_started_) return Status::OK;
+    filter_state->published = true;
+  }
+  // Don't make the RPCs in this RPC handler, the join instance waits for it.
+  filter_publish_pool_->Offer(params.slot_id);
+  return Status::OK;
+}
+
+void Coordinator::PublishGlobalFilter(int thread_id, const SlotId& slot_id) {
+  // The filter is complete and not modified anymore once it is published.
+  const GlobalFilterState& filter_state = global_filters_.find(slot_id)->second;
+  DCHECK(filter_state.published);
+  const BloomFilter* filter = filter_state.filter;
+  const vector<int>& dst_fragment_idxs = filter_state.dst_fragment_idxs;
+  VLOG_QUERY << "Publishing global filter on slot " << slot_id << " for query "
+             << query_id_ << (filter == NULL ? " (disabled)" : "");
+  TPublishFilterParams params;
+  params.protocol_version = ImpalaInternalServiceVersion::V1;
+  params.__set_slot_id(slot_id);
+  if (filter != NULL) {
+    params.__set_bloom_filter(
+        string(reinterpret_cast<const char*>(filter->data()), filter->size()));
+  }
+
+  BOOST_FOREACH(int fragment_idx, dst_fragment_idxs) {
+    const FragmentExecParams& exec_params = fragment_exec_params[fragment_idx];
+    for (int i = 0; i < exec_params.instance_ids.size(); ++i) {
+      params.__set_dst_fragment_instance_id(exec_params.instance_ids[i]);
+      if (fragment_idx == 0 && executor_.get() != NULL) {
+        // The coordinator fragment runs in this process.
+        executor_->runtime_state()->SetGlobalFilter(params);
+        continue;
+      }
+      // Failures only mean that the scans of the instance run without the filter
+      // once they stop waiting for it.
+      Status status;
+      ImpalaInternalServiceConnection backend_client(
+          exec_env_->impalad_client_cache(), exec_params.hosts[i], &status);
+      if (!status.ok()) {
+        VLOG_QUERY << "Could not publish global filter to " << exec_params.hosts[i]
+                   << ": " << status.GetDetail();
+        continue;
+      }
+      TPublishFilterResult res;
+      try {
+        try {
+          backend_client->PublishFilter(res, params);
+        } catch (const TException& e) {
+          VLOG_RPC << "Retrying PublishFilter: " << e.what();
+          status = backend_client.Reopen();
+          if (!status.ok()) continue;
+          backend_client->PublishFilter(res, params);
+        }
+      } catch (const TException& e) {
+        VLOG_QUERY << "PublishFilter rpc query_id=" << query_id_
+                   << " instance_id=" << exec_params.instance_ids[i]
+                   << " failed: " << e.what();
+      }
+    }
+  }
+}
+
+Status Coordinator::InitAdaptiveExchanges(const TQueryExecRequest& request) {
+  for (int i = 0; i < request.fragments.size(); ++i) {
+    const TPlanFragment& fragment = request.fragments[i];
+    if (!fragment.__isset.output_sink || !fragment.output_sink.__isset.stream_sink) {
+      continue;
+    }
+    const TDataStreamSink& sink = fragment.output_sink.stream_sink;
+    if (!sink.__isset.adaptive_join_node_id) continue;
+    if (!sink.__isset.adaptive_exchange_role ||
+        sink.output_partition.type != TPartitionType::HASH_PARTITIONED) {
+      return Status(Substitute("Invalid adaptive exchange sink in fragment $0", i));
+    }
+    bool is_build = sink.adaptive_exchange_role == TAdaptiveExchangeRole::BUILD;
+    AdaptiveExchangeState& exchange = adaptive_exchanges_[sink.adaptive_join_node_id];
+    int* fragment_idx =
+        is_build ? &exchange.build_fragment_idx : &exchange.probe_fragment_idx;
+    if (*fragment_idx != -1) {
+      return Status(Substitute("Adaptive exchange of join $0 has more than one $1 "
+          "fragment", sink.adaptive_join_node_id, is_build ? "build" : "probe"));
+    }
+    *fragment_idx = i;
+    if (is_build) exchange.num_pending_instances = fragment_exec_params[i].hosts.size();
+  }
+
+  for (AdaptiveExchangeMap::iterator it = adaptive_exchanges_.begin();
+       it != adaptive_exchanges_.end(); ++it) {
+    const AdaptiveExchangeState& exchange = it->second;
+    if (exchange.build_fragment_idx == -1 || exchange.probe_fragment_idx == -1) {
+      return Status(Substitute("Adaptive exchange of join $0 is missing its $1 side",
+          it->first, exchange.build_fragment_idx == -1 ? "build" : "probe"));
+    }
+    VLOG_QUERY << "Adaptive exchange of join " << it->first << ": build fragment "
+               << exchange.build_fragment_idx << ", probe fragment "
+               << exchange.probe_fragment_idx;
+  }
+  return Status::OK;
+}
+
+Status Coordinator::UpdateBuildSize(const TUpdateBuildSizeParams& params) {
+  VLOG_FILE << "UpdateBuildSize() query_id=" << query_id_
+            << " instance_id=" << params.fragment_instance_id
+            << " join_node_id=" << params.join_node_id
+            << " num_bytes=" << params.num_bytes << " eos=" << params.eos;
+  {
+    lock_guard<mutex> l(filter_lock_);
+    AdaptiveExchangeMap::iterator it = adaptive_exchanges_.find(params.join_node_id);
+    if (it == adaptive_exchanges_.end()) {
+      return Status(Substitute("Unexpected build size of join $0 from instance $1",
+          params.join_node_id, PrintId(params.fragment_instance_id)));
+    }
+    AdaptiveExchangeState* exchange = &it->second;
+    // Once the join is partitioned, the remaining instances may still report.
+    if (exchange->decided) return Status::OK;
+
+    if (!params.eos) {
+      // The instance alone has more rows than can be broadcast.
+      exchange->decided = true;
+      exchange->broadcast = false;
+    } else {
+      if (exchange->num_pending_instances == 0) {
+        return Status(Substitute("Unexpected build size of join $0 from instance $1",
+            params.join_node_id, PrintId(params.fragment_instance_id)));
+      }
+      --exchange->num_pending_instances;
+      exchange->num_bytes += params.num_bytes;
+      exchange->num_rows += params.num_rows;
+      if (exchange->num_bytes > FLAGS_adaptive_join_max_broadcast_bytes) {
+        exchange->decided = true;
+        exchange->broadcast = false;
+      } else if (exchange->num_pending_instances == 0) {
+        exchange->decided = true;
+        exchange->broadcast = true;
+      }
+    }
+    if (!exchange->decided) return Status::OK;
+    // Exec() publishes the modes that are decided once all fragments are started.
+    if (!filter_fragments_started_) return Status::OK;
+    DCHECK(!exchange->published);
+    exchange->published = true;
+  }
+  exchange_publish_pool_->Offer(params.join_node_id);
+  return Status::OK;
+}
+
+void Coordinator::PublishExchangeMode(int thread_id, const PlanNodeId& join_node_id) {
+  // The mode is not modified after it was decided.
+  const AdaptiveExchangeState& exchange = adaptive_exchanges_.find(join_node_id)->second;
+  DCHECK(exchange.decided);
+  DCHECK(exchange.published);
+  string mode = exchange.broadcast ? "BROADCAST" : "PARTITIONED";
+  VLOG_QUERY << "Adaptive exchange of join " << join_node_id << " of query "
+             << query_id_ << " is " << mode;
+  query_profile_->AddInfoString(Substitute("Adaptive join $0", join_node_id), mode);
+  TPublishExchangeModeParams params;
+  params.protocol_version = ImpalaInternalServiceVersion::V1;
+  params.__set_join_node_id(join_node_id);
+  params.__set_broadcast(exchange.broadcast);
+
+  int fragment_idxs[] = { exchange.build_fragment_idx, exchange.probe_fragment_idx };
+  for (int j = 0; j < 2; ++j) {
+    // Both fragments have data stream sinks, so neither is the coordinator fragment.
+    DCHECK_NE(fragment_idxs[j], 0);
+    const FragmentExecParams& exec_params = fragment_exec_params[fragment_idxs[j]];
+    for (int i = 0; i < exec_params.instance_ids.size(); ++i) {
+      params.__set_dst_fragment_instance_id(exec_params.instance_ids[i]);
+      Status status;
+      ImpalaInternalServiceConnection backend_client(
+          exec_env_->impalad_client_cache(), exec_params.hosts[i], &status);
+      TPublishExchangeModeResult res;
+      if (status.ok()) {
+        status = backend_client.DoRpc(
+            &ImpalaInternalServiceClient::PublishExchangeMode, params, res);
+      }
+      if (status.ok()) status = Status(res.status);
+      if (!status.ok()) {
+        UpdateStatus(Status(Substitute("Could not publish the mode of the adaptive "
+            "exchange of join $0 to instance $1: $2", join_node_id,
+            PrintId(exec_params.instance_ids[i]), status.GetDetail())), NULL);
+        return;
+      }
+    }
+  }
+}
+
 Status Coordinator::UpdateCommandExecStatus(const TReportCommandStatusParams& params){
 	VLOG_FILE << "UpdateCommandExecStatus() query_id = \"" << query_id_
 	            << "\"; status = \"" << params.status.status_code
@@ -1876,16 +2247,21 @@ void Coordinator::SetExecPlanFragmentParams(
     }
   }
   rpc_params->params.__set_request_pool(schedule.request_pool());
-  FragmentScanRangeAssignment::const_iterator it =
-      params.scan_range_assignment.find(exec_host);
-  // Scan ranges may not always be set, so use an empty structure if so.
-  const PerNodeScanRanges& scan_ranges =
-      (it != params.scan_range_assignment.end()) ? it->second : PerNodeScanRanges();
-
-  rpc_params->params.__set_per_node_scan_ranges(scan_ranges);
+  if (!params.per_instance_scan_ranges.empty()) {
+    rpc_params->params.__set_per_node_scan_ranges(
+        params.per_instance_scan_ranges[instance_idx]);
+  } else {
+    FragmentScanRangeAssignment::const_iterator it =
+        params.scan_range_assignment.find(exec_host);
+    // Scan ranges may not always be set, so use an empty structure if so.
+    const PerNodeScanRanges& scan_ranges =
+        (it != params.scan_range_assignment.end()) ? it->second : PerNodeScanRanges();
+    rpc_params->params.__set_per_node_scan_ranges(scan_ranges);
+  }
   rpc_params->params.__set_per_exch_num_senders(params.per_exch_num_senders);
   rpc_params->params.__set_destinations(params.destinations);
   rpc_params->params.__set_sender_id(params.sender_id_base + instance_idx);
+  SetGlobalFilterParams(fragment_idx, &rpc_params->params);
   rpc_params->__isset.params = true;
   rpc_params->fragment_instance_ctx.__set_query_ctx(query_ctx_);
   rpc_params->fragment_instance_ctx.fragment_instance_id =
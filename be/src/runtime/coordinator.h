@@ -36,6 +36,7 @@
 #include "common/global-types.h"
 #include "util/progress-updater.h"
 #include "util/runtime-profile.h"
+#include "util/thread-pool.h"
 #include "runtime/runtime-state.h"
 #include "statestore/simple-scheduler.h"
 #include "gen-cpp/Types_types.h"
@@ -47,6 +48,7 @@ class DataStreamMgr;
 class DataSink;
 class RowBatch;
 class RowDescriptor;
+class BloomFilter;
 class PlanFragmentExecutor;
 class ObjectPool;
 class RuntimeState;
@@ -58,6 +60,8 @@ class ExecEnv;
 class TUpdateCatalogRequest;
 class TQueryExecRequest;
 class TReportExecStatusParams;
+class TUpdateFilterParams;
+class TUpdateBuildSizeParams;
 class TRowBatch;
 class TPlanExecRequest;
 class TRuntimeProfileTree;
@@ -137,6 +141,19 @@ class Coordinator {
   // to CancelInternal().
   Status UpdateFragmentExecStatus(const TReportExecStatusParams& params);
 
+  // Merges the global runtime filter sent by a fragment instance into the query-wide
+  // filter on the same slot. Once all instances of the fragment that builds the filter
+  // have sent theirs, the merged filter is published to all instances of the fragments
+  // that scan the slot.
+  Status UpdateFilter(const TUpdateFilterParams& params);
+
+  // Adds the build side size reported by a fragment instance to the adaptive join
+  // exchange it sends. The join is partitioned as soon as one instance reports that its
+  // build side is too large to broadcast, and broadcast if all instances finished and
+  // their build sides are small enough in total. The decision is published to all
+  // instances of the fragments that send the build and probe sides.
+  Status UpdateBuildSize(const TUpdateBuildSizeParams& params);
+
   /** Updates status of a command execution. if 'status' is an error status or if 'done' is true,
    * consider the command to have finished execution. Assumes
    * that calls to UpdateCommandExecStatus() won't happen concurrently for the same backend.
@@ -273,6 +290,88 @@ class Coordinator {
   // owned by plan root, which resides in runtime_state_'s pool
   const RowDescriptor* row_desc_;
 
+  // A global runtime filter on a probe slot of a hash join. It is built by every
+  // instance of the join's fragment and published to every instance of the other
+  // fragments that scan the slot's tuple.
+  struct GlobalFilterState {
+    // Fragment of the join.
+    int src_fragment_idx;
+
+    // Fragments scanning the probe slot.
+    std::vector<int> dst_fragment_idxs;
+
+    // Number of instances of the source fragment that have not sent their filter yet.
+    int num_pending_instances;
+
+    // Union of the filters received so far. Owned by obj_pool_. NULL if no filter was
+    // received yet or if the filter was disabled.
+    BloomFilter* filter;
+
+    // True if one of the instances could not build its filter.
+    bool disabled;
+
+    // True once the filter was handed to PublishGlobalFilter().
+    bool published;
+
+    GlobalFilterState()
+      : src_fragment_idx(-1), num_pending_instances(0), filter(NULL), disabled(false),
+        published(false) {}
+  };
+
+  // An adaptive join exchange: a join whose build side is broadcast or partitioned
+  // depending on its actual size, see TDataStreamSink.adaptive_join_node_id.
+  struct AdaptiveExchangeState {
+    // Fragments that send the build and the probe side of the join.
+    int build_fragment_idx;
+    int probe_fragment_idx;
+
+    // Number of instances of the build fragment that have not reported the size of
+    // their complete build side yet.
+    int num_pending_instances;
+
+    // Total size of the complete build sides reported so far.
+    int64_t num_bytes;
+    int64_t num_rows;
+
+    // True once the mode was decided, and if the join is broadcast.
+    bool decided;
+    bool broadcast;
+
+    // True once the mode was offered to exchange_publish_pool_. It is published only
+    // once.
+    bool published;
+
+    AdaptiveExchangeState()
+      : build_fragment_idx(-1), probe_fragment_idx(-1), num_pending_instances(0),
+        num_bytes(0), num_rows(0), decided(false), broadcast(false), published(false) {}
+  };
+
+  // Protects global_filters_, adaptive_exchanges_ and filter_fragments_started_. Not
+  // held during RPCs.
+  boost::mutex filter_lock_;
+
+  // Global runtime filters of this query, keyed by probe slot. Populated in Exec().
+  typedef boost::unordered_map<SlotId, GlobalFilterState> GlobalFilterMap;
+  GlobalFilterMap global_filters_;
+
+  // Adaptive join exchanges of this query, keyed by join node id. Populated in Exec().
+  typedef boost::unordered_map<PlanNodeId, AdaptiveExchangeState> AdaptiveExchangeMap;
+  AdaptiveExchangeMap adaptive_exchanges_;
+
+  // True once all fragment instances have been started. Filters and exchange modes are
+  // only published after that so that every destination instance exists.
+  bool filter_fragments_started_;
+
+  // Sends the completed global filters to the instances of their scan fragments, so
+  // that UpdateFilter() returns without waiting for RPCs. Only created if the query has
+  // global filters.
+  boost::scoped_ptr<ThreadPool<SlotId> > filter_publish_pool_;
+
+  // Sends the decided modes of the adaptive exchanges to their senders, so that
+  // UpdateBuildSize() returns without waiting for RPCs. Only created if the query has
+  // adaptive exchanges.
+  boost::scoped_ptr<ThreadPool<PlanNodeId> > exchange_publish_pool_;
+
   // map from fragment instance id to corresponding exec state stored in
   // backend_exec_states_
   typedef boost::unordered_map<TUniqueId, BackendExecState*> BackendExecStateMap;
@@ -375,6 +474,30 @@ class Coordinator {
       int fragment_idx, const FragmentExecParams& params, int instance_idx,
       const TNetworkAddress& coord, TExecPlanFragmentParams* rpc_params);
 
+  // Finds the hash joins that can send their build side filter to scans in other
+  // fragments and populates global_filters_. Must be called before the fragment
+  // parameters are set.
+  void InitGlobalFilters(const TQueryExecRequest& request);
+
+  // Sets the global filters that the instances of fragment 'fragment_idx' build and
+  // receive in 'params'.
+  void SetGlobalFilterParams(int fragment_idx, TPlanFragmentExecParams* params);
+
+  // Work function of filter_publish_pool_. Sends the merged filter on 'slot_id', which
+  // must be published, to all instances of its destination fragments.
+  void PublishGlobalFilter(int thread_id, const SlotId& slot_id);
+
+  // Finds the data stream sinks of the adaptive join exchanges and populates
+  // adaptive_exchanges_. Returns an error if an exchange does not have exactly one
+  // build and one probe fragment.
+  Status InitAdaptiveExchanges(const TQueryExecRequest& request);
+
+  // Work function of exchange_publish_pool_. Sends the decided mode of the exchange of
+  // 'join_node_id', which must be published, to all instances of its build and probe
+  // fragments. The senders cannot make progress without it, so the query fails if an
+  // instance cannot be reached.
+  void PublishExchangeMode(int thread_id, const PlanNodeId& join_node_id);
+
   /** Fill in Command Execution RPC params based on parameters */
   void SetExecCommandParams(int backend_num, const TRemoteShortCommand& command,
       int fragment_idx, const FragmentExecParams& params, int instance_idx,
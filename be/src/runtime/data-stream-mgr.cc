@@ -43,6 +43,13 @@ inline uint32_t DataStreamMgr::GetHashValue(
   return value;
 }
 
+inline DataStreamMgr::Shard* DataStreamMgr::GetShard(
+    const TUniqueId& fragment_instance_id) {
+  uint32_t value = RawValue::GetHashValue(&fragment_instance_id.lo, TYPE_BIGINT, 0);
+  value = RawValue::GetHashValue(&fragment_instance_id.hi, TYPE_BIGINT, value);
+  return &shards_[value % NUM_SHARDS];
+}
+
 shared_ptr<DataStreamRecvr> DataStreamMgr::CreateRecvr(RuntimeState* state,
     const RowDescriptor& row_desc, const TUniqueId& fragment_instance_id,
     PlanNodeId dest_node_id, int num_senders, int buffer_size, RuntimeProfile* profile,
@@ -55,9 +62,10 @@ shared_ptr<DataStreamRecvr> DataStreamMgr::CreateRecvr(RuntimeState* state,
           fragment_instance_id, dest_node_id, num_senders, is_merging, buffer_size,
           profile));
   size_t hash_value = GetHashValue(fragment_instance_id, dest_node_id);
-  lock_guard<mutex> l(lock_);
-  fragment_stream_set_.insert(make_pair(fragment_instance_id, dest_node_id));
-  receiver_map_.insert(make_pair(hash_value, recvr));
+  Shard* shard = GetShard(fragment_instance_id);
+  lock_guard<mutex> l(shard->lock);
+  shard->fragment_stream_set.insert(make_pair(fragment_instance_id, dest_node_id));
+  shard->receiver_map.insert(make_pair(hash_value, recvr));
   return recvr;
 }
 
@@ -66,28 +74,29 @@ shared_ptr<DataStreamRecvr> DataStreamMgr::FindRecvr(
   VLOG_ROW << "looking up fragment_instance_id=" << fragment_instance_id
            << ", node=" << node_id;
   size_t hash_value = GetHashValue(fragment_instance_id, node_id);
-  if (acquire_lock) lock_.lock();
+  Shard* shard = GetShard(fragment_instance_id);
+  if (acquire_lock) shard->lock.lock();
   pair<StreamMap::iterator, StreamMap::iterator> range =
-      receiver_map_.equal_range(hash_value);
+      shard->receiver_map.equal_range(hash_value);
   while (range.first != range.second) {
     shared_ptr<DataStreamRecvr> recvr = range.first->second;
     if (recvr->fragment_instance_id() == fragment_instance_id
         && recvr->dest_node_id() == node_id) {
-      if (acquire_lock) lock_.unlock();
+      if (acquire_lock) shard->lock.unlock();
       return recvr;
     }
     ++range.first;
   }
-  if (acquire_lock) lock_.unlock();
+  if (acquire_lock) shard->lock.unlock();
   return shared_ptr<DataStreamRecvr>();
 }
 
 Status DataStreamMgr::AddData(
     const TUniqueId& fragment_instance_id, PlanNodeId dest_node_id,
-    const TRowBatch& thrift_batch, int sender_id) {
+    TRowBatch* thrift_batch, int sender_id) {
   VLOG_ROW << "AddData(): fragment_instance_id=" << fragment_instance_id
            << " node=" << dest_node_id
-           << " size=" << RowBatch::GetBatchSize(thrift_batch);
+           << " size=" << RowBatch::GetBatchSize(*thrift_batch);
   shared_ptr<DataStreamRecvr> recvr =
       FindRecvr(fragment_instance_id, dest_node_id);
   if (recvr == NULL) {
@@ -95,7 +104,7 @@ Status DataStreamMgr::AddData(
     // at any time without considering the remaining number of senders.
     // As a consequence, FindRecvr() may return an innocuous NULL if a thread
     // calling DeregisterRecvr() beat the thread calling FindRecvr()
-    // in acquiring lock_.
+    // in acquiring the lock of the receiver's shard.
     // TODO: Rethink the lifecycle of DataStreamRecvr to distinguish
     // errors from receiver-initiated teardowns.
     return Status::OK;
@@ -104,6 +113,18 @@ Status DataStreamMgr::AddData(
   return Status::OK;
 }
 
+Status DataStreamMgr::AddDataWithCredit(const TUniqueId& fragment_instance_id,
+    PlanNodeId dest_node_id, TRowBatch* thrift_batch, int sender_id, int64_t* credit) {
+  VLOG_ROW << "AddDataWithCredit(): fragment_instance_id=" << fragment_instance_id
+           << " node=" << dest_node_id << " size="
+           << (thrift_batch == NULL ? 0 : RowBatch::GetBatchSize(*thrift_batch));
+  shared_ptr<DataStreamRecvr> recvr = FindRecvr(fragment_instance_id, dest_node_id);
+  // See AddData() for why a missing recvr is not an error.
+  if (recvr == NULL) return Status::OK;
+  *credit = recvr->AddBatchWithCredit(thrift_batch, sender_id);
+  return Status::OK;
+}
+
 Status DataStreamMgr::CloseSender(const TUniqueId& fragment_instance_id,
     PlanNodeId dest_node_id, int sender_id) {
   VLOG_FILE << "CloseSender(): fragment_instance_id=" << fragment_instance_id
@@ -114,7 +135,7 @@ Status DataStreamMgr::CloseSender(const TUniqueId& fragment_instance_id,
     // at any time without considering the remaining number of senders.
     // As a consequence, FindRecvr() may return an innocuous NULL if a thread
     // calling DeregisterRecvr() beat the thread calling FindRecvr()
-    // in acquiring lock_.
+    // in acquiring the lock of the receiver's shard.
     // TODO: Rethink the lifecycle of DataStreamRecvr to distinguish
     // errors from receiver-initiated teardowns.
     return Status::OK;
@@ -128,18 +149,19 @@ Status DataStreamMgr::DeregisterRecvr(
   VLOG_QUERY << "DeregisterRecvr(): fragment_instance_id=" << fragment_instance_id
              << ", node=" << node_id;
   size_t hash_value = GetHashValue(fragment_instance_id, node_id);
-  lock_guard<mutex> l(lock_);
+  Shard* shard = GetShard(fragment_instance_id);
+  lock_guard<mutex> l(shard->lock);
   pair<StreamMap::iterator, StreamMap::iterator> range =
-      receiver_map_.equal_range(hash_value);
+      shard->receiver_map.equal_range(hash_value);
   while (range.first != range.second) {
     const shared_ptr<DataStreamRecvr>& recvr = range.first->second;
     if (recvr->fragment_instance_id() == fragment_instance_id
         && recvr->dest_node_id() == node_id) {
       // Notify concurrent AddData() requests that the stream has been terminated.
       recvr->CancelStream();
-      fragment_stream_set_.erase(make_pair(recvr->fragment_instance_id(),
+      shard->fragment_stream_set.erase(make_pair(recvr->fragment_instance_id(),
           recvr->dest_node_id()));
-      receiver_map_.erase(range.first);
+      shard->receiver_map.erase(range.first);
       return Status::OK;
     }
     ++range.first;
@@ -154,10 +176,11 @@ Status DataStreamMgr::DeregisterRecvr(
 
 void DataStreamMgr::Cancel(const TUniqueId& fragment_instance_id) {
   VLOG_QUERY << "cancelling all streams for fragment=" << fragment_instance_id;
-  lock_guard<mutex> l(lock_);
+  Shard* shard = GetShard(fragment_instance_id);
+  lock_guard<mutex> l(shard->lock);
   FragmentStreamSet::iterator i =
-      fragment_stream_set_.lower_bound(make_pair(fragment_instance_id, 0));
-  while (i != fragment_stream_set_.end() && i->first == fragment_instance_id) {
+      shard->fragment_stream_set.lower_bound(make_pair(fragment_instance_id, 0));
+  while (i != shard->fragment_stream_set.end() && i->first == fragment_instance_id) {
     shared_ptr<DataStreamRecvr> recvr = FindRecvr(i->first, i->second, false);
     if (recvr == NULL) {
       // keep going but at least log it
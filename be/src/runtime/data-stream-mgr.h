@@ -78,8 +78,16 @@ class DataStreamMgr {
   // TODO: enforce per-sender quotas (something like 200% of buffer_size/#senders),
   // so that a single sender can't flood the buffer and stall everybody else.
   // Returns OK if successful, error status otherwise.
+  // The uncompressed tuple data of 'thrift_batch' is taken over by the receiver.
   Status AddData(const TUniqueId& fragment_instance_id, PlanNodeId dest_node_id,
-                 const TRowBatch& thrift_batch, int sender_id);
+                 TRowBatch* thrift_batch, int sender_id);
+
+  // Like AddData(), but never blocks and sets *credit to the number of bytes the sender
+  // may still send to the recvr (see DataStreamRecvr::AddBatchWithCredit()).
+  // 'thrift_batch' may be NULL to only get the credit. *credit is not set if the
+  // recvr does not exist.
+  Status AddDataWithCredit(const TUniqueId& fragment_instance_id,
+      PlanNodeId dest_node_id, TRowBatch* thrift_batch, int sender_id, int64_t* credit);
 
   // Notifies the recvr associated with the fragment/node id that the specified
   // sender has closed.
@@ -93,8 +101,10 @@ class DataStreamMgr {
  private:
   friend class DataStreamRecvr;
 
-  // protects all fields below
-  boost::mutex lock_;
+  // Number of shards of the receiver registry. Every shard has its own lock, so that
+  // the rpc threads of concurrent queries and of the streams of a query rarely wait
+  // for each other when they look up a receiver.
+  static const int NUM_SHARDS = 64;
 
   // map from hash value of fragment instance id/node id pair to stream receivers;
   // Ownership of the stream revcr is shared between this instance and the caller of
@@ -103,7 +113,6 @@ class DataStreamMgr {
   // because that requires a bunch of copying of ids for lookup
   typedef boost::unordered_multimap<uint32_t,
       boost::shared_ptr<DataStreamRecvr> > StreamMap;
-  StreamMap receiver_map_;
 
   // less-than ordering for pair<TUniqueId, PlanNodeId>
   struct ComparisonOp {
@@ -124,11 +133,23 @@ class DataStreamMgr {
 
   // ordered set of registered streams' fragment instance id/node id
   typedef std::set<std::pair<TUniqueId, PlanNodeId>, ComparisonOp > FragmentStreamSet;
-  FragmentStreamSet fragment_stream_set_;
+
+  // The receivers of the fragment instances whose id hashes to the shard. All streams
+  // of a fragment instance are in the same shard, so Cancel() only locks one shard.
+  struct Shard {
+    // protects all fields below
+    boost::mutex lock;
+    StreamMap receiver_map;
+    FragmentStreamSet fragment_stream_set;
+  };
+  Shard shards_[NUM_SHARDS];
+
+  // Returns the shard of the receivers of 'fragment_instance_id'.
+  inline Shard* GetShard(const TUniqueId& fragment_instance_id);
 
   // Return the receiver for given fragment_instance_id/node_id,
-  // or NULL if not found. If 'acquire_lock' is false, assumes lock_ is already being
-  // held and won't try to acquire it.
+  // or NULL if not found. If 'acquire_lock' is false, assumes the lock of the
+  // receiver's shard is already being held and won't try to acquire it.
   boost::shared_ptr<DataStreamRecvr> FindRecvr(
       const TUniqueId& fragment_instance_id, PlanNodeId node_id,
       bool acquire_lock = true);
@@ -14,26 +14,64 @@
 
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
+#include <gflags/gflags.h>
+#include <gutil/strings/substitute.h>
 
 #include "runtime/data-stream-recvr.h"
 #include "runtime/data-stream-mgr.h"
 #include "runtime/row-batch.h"
 #include "runtime/sorted-run-merger.h"
+#include "util/blocking-queue.h"
 #include "util/runtime-profile.h"
 #include "util/periodic-counter-updater.h"
+#include "util/thread.h"
 
 using namespace std;
 using namespace boost;
+using namespace strings;   // for Substitute
+
+DEFINE_int32(exchange_merge_group_size, 16, "Merging exchanges with more senders than "
+    "this are merged in two steps: groups of this many senders are pre-merged in "
+    "parallel by one thread per group before the final merge. 0 or 1 disables "
+    "pre-merging.");
 
 namespace impala {
 
+// Number of batches that a sender of a merging receiver may have queued regardless of
+// the buffer limit, so that the merge does not have to wait for the next batch of a
+// sender right after it consumed the previous one.
+static const int MERGING_PREFETCH_BATCHES = 2;
+
+// Capacity of the row batches that a MergeGroup produces and the number of them it may
+// have merged ahead of the final merge.
+static const int MERGE_GROUP_BATCH_SIZE = 1024;
+static const int MERGE_GROUP_QUEUE_DEPTH = 2;
+
 // Implements a blocking queue of row batches from one or more senders. One queue
 // is maintained per sender if is_merging_ is true for the enclosing receiver, otherwise
 // rows from all senders are placed in the same queue.
+// The queue has many producers (the rpc threads that add the batches of the senders)
+// and a single consumer. lock_ is only held to reserve space for a batch and to link
+// or unlink it: producers deserialize their batches, and the consumer frees the
+// previous batch, outside of lock_. The consumer only waits when the queue is empty and
+// producers only wait when it is full, and the condition variables are only signalled
+// if somebody waits on them.
 class DataStreamRecvr::SenderQueue {
  public:
   SenderQueue(DataStreamRecvr* parent_recvr, int num_senders, RuntimeProfile* profile);
 
+  // Sets the timer for the time GetBatch() waits for a batch of this queue. Must be
+  // called before the first GetBatch().
+  void SetStallTimer(RuntimeProfile::Counter* stall_timer) { stall_timer_ = stall_timer; }
+
+  // Must be called before the first GetBatch() if this queue is consumed by the thread
+  // of a MergeGroup rather than by the receiver's consumer. The time that thread waits
+  // for batches is counted in 'group_stall_timer' instead of the consumer's timers.
+  void SetMergeGroup(RuntimeProfile::Counter* group_stall_timer) {
+    in_merge_group_ = true;
+    group_stall_timer_ = group_stall_timer;
+  }
+
   // Return the next batch form this sender queue. Sets the returned batch in cur_batch_.
   // A returned batch that is not filled to capacity does *not* indicate
   // end-of-stream.
@@ -46,7 +84,12 @@ class DataStreamRecvr::SenderQueue {
   // blocks if this will make the stream exceed its buffer limit.
   // If the total size of the batches in this queue would exceed the allowed buffer size,
   // the queue is considered full and the call blocks until a batch is dequeued.
-  void AddBatch(const TRowBatch& batch);
+  void AddBatch(TRowBatch* batch, int sender_id);
+
+  // Adds a row batch to this sender queue without blocking, even if this makes the
+  // stream exceed its buffer limit. 'batch' may be NULL. Returns the credit of
+  // 'sender_id' after adding the batch, see DataStreamRecvr::AddBatchWithCredit().
+  int64_t AddBatchWithCredit(TRowBatch* batch, int sender_id);
 
   // Decrement the number of remaining senders for this queue and signal eos ("new data")
   // if the count drops to 0. The number of senders will be 1 for a merging
@@ -57,13 +100,47 @@ class DataStreamRecvr::SenderQueue {
   // incoming batches will be dropped.
   void Cancel();
 
-  // Must be called once to cleanup any queued resources.
+  // Must be called once to cleanup any queued resources. Cancels the queue.
   void Close();
 
   // Returns the current batch from this queue being processed by a consumer.
   RowBatch* current_batch() const { return current_batch_.get(); }
 
  private:
+  // A batch in batch_queue_, with its serialized size and the sender it came from.
+  struct QueuedBatch {
+    int batch_size;
+    int sender_id;
+    RowBatch* batch;
+  };
+
+  // Reserves buffer space for a batch of 'batch_size' bytes of 'sender_id', which must
+  // then be passed to EnqueueBatch(). lock_ must be held and the stream must not be
+  // cancelled.
+  void ReserveBatch(int batch_size, int sender_id);
+
+  // Deserializes 'thrift_batch', for which ReserveBatch() was called, and appends it to
+  // batch_queue_, even if the stream was cancelled in the meantime. Must be called
+  // without holding lock_.
+  void EnqueueBatch(TRowBatch* thrift_batch, int batch_size, int sender_id);
+
+  // Returns true if a batch may be queued regardless of the buffer limit: if the queue
+  // is empty, or if it is the queue of a merging receiver with fewer than
+  // MERGING_PREFETCH_BATCHES batches. Batches that are being deserialized count as
+  // queued. lock_ must be held.
+  bool BelowPrefetchDepth() const {
+    int num_batches = batch_queue_.size() + num_pending_batches_;
+    if (num_batches == 0) return true;
+    return recvr_->is_merging_ && num_batches < MERGING_PREFETCH_BATCHES;
+  }
+
+  // Returns the index of 'sender_id' in sender_buffered_bytes_.
+  int SenderIndex(int sender_id) const {
+    int index = recvr_->is_merging_ ? 0 : sender_id;
+    DCHECK_LT(index, sender_buffered_bytes_.size());
+    return index;
+  }
+
   // Receiver of which this queue is a member.
   DataStreamRecvr* recvr_;
 
@@ -83,11 +160,29 @@ class DataStreamRecvr::SenderQueue {
   // signal removal of data by stream consumer
   condition_variable data_removal__cv_;
 
-  // queue of (batch length, batch) pairs.  The SenderQueue block owns memory to
+  // queue of batches.  The SenderQueue block owns memory to
   // these batches. They are handed off to the caller via GetBatch.
-  typedef list<pair<int, RowBatch*> > RowBatchQueue;
+  typedef list<QueuedBatch> RowBatchQueue;
   RowBatchQueue batch_queue_;
 
+  // Number of batches that were reserved with ReserveBatch() and are being deserialized
+  // by their producers, i.e. are not in batch_queue_ yet.
+  int num_pending_batches_;
+
+  // Signalled when num_pending_batches_ drops to 0 after the stream was cancelled.
+  // Close() waits on it, so that it frees all the batches.
+  condition_variable pending_batches_done_cv_;
+
+  // True while the consumer waits on data_arrival_cv_.
+  bool consumer_waiting_;
+
+  // Number of producers waiting on data_removal__cv_.
+  int num_waiting_producers_;
+
+  // Number of bytes in batch_queue_ by sender (a single entry if the receiver is
+  // merging, because there is one queue per sender then).
+  vector<int64_t> sender_buffered_bytes_;
+
   // The batch that was most recently returned via GetBatch(), i.e. the current batch
   // from this queue being processed by a consumer. Is destroyed when the next batch
   // is retrieved.
@@ -95,6 +190,15 @@ class DataStreamRecvr::SenderQueue {
 
   // Set to true when the first batch has been received
   bool received_first_batch_;
+
+  // Time spent in GetBatch() waiting for a batch to arrive. May be NULL.
+  RuntimeProfile::Counter* stall_timer_;
+
+  // True if this queue is consumed by the thread of a MergeGroup, see SetMergeGroup().
+  bool in_merge_group_;
+
+  // The stall timer of the MergeGroup that consumes this queue. May be NULL.
+  RuntimeProfile::Counter* group_stall_timer_;
 };
 
 DataStreamRecvr::SenderQueue::SenderQueue(DataStreamRecvr* parent_recvr, int num_senders,
@@ -102,24 +206,42 @@ DataStreamRecvr::SenderQueue::SenderQueue(DataStreamRecvr* parent_recvr, int num
   : recvr_(parent_recvr),
     is_cancelled_(false),
     num_remaining_senders_(num_senders),
-    received_first_batch_(false) {
+    num_pending_batches_(0),
+    consumer_waiting_(false),
+    num_waiting_producers_(0),
+    sender_buffered_bytes_(num_senders, 0),
+    received_first_batch_(false),
+    stall_timer_(NULL),
+    in_merge_group_(false),
+    group_stall_timer_(NULL) {
 }
 
 Status DataStreamRecvr::SenderQueue::GetBatch(RowBatch** next_batch) {
+  // cur_batch_ must be replaced with the returned batch. It is only accessed by the
+  // consumer, so it is freed before taking lock_.
+  current_batch_.reset();
+  *next_batch = NULL;
+
   unique_lock<mutex> l(lock_);
   // wait until something shows up or we know we're done
-  while (!is_cancelled_ && batch_queue_.empty() && num_remaining_senders_ > 0) {
+  while (!is_cancelled_ && batch_queue_.empty()
+      && (num_remaining_senders_ > 0 || num_pending_batches_ > 0)) {
     VLOG_ROW << "wait arrival fragment_instance_id=" << recvr_->fragment_instance_id()
              << " node=" << recvr_->dest_node_id();
-    // Don't count time spent waiting on the sender as active time.
-    SCOPED_TIMER(recvr_->data_arrival_timer_);
-    SCOPED_TIMER(received_first_batch_ ? NULL : recvr_->first_batch_wait_total_timer_);
+    // Don't count time spent waiting on the sender as active time. The threads of merge
+    // groups wait concurrently with the consumer, so their waits are only counted as
+    // stalls of their group.
+    SCOPED_TIMER(in_merge_group_ ? NULL : recvr_->data_arrival_timer_);
+    SCOPED_TIMER(in_merge_group_ || received_first_batch_ ?
+        NULL : recvr_->first_batch_wait_total_timer_);
+    SCOPED_TIMER(recvr_->sender_stall_timer_);
+    SCOPED_TIMER(group_stall_timer_);
+    SCOPED_TIMER(stall_timer_);
+    consumer_waiting_ = true;
     data_arrival_cv_.wait(l);
+    consumer_waiting_ = false;
   }
 
-  // cur_batch_ must be replaced with the returned batch.
-  current_batch_.reset();
-  *next_batch = NULL;
   if (is_cancelled_) return Status::CANCELLED;
 
   if (batch_queue_.empty()) {
@@ -130,21 +252,23 @@ Status DataStreamRecvr::SenderQueue::GetBatch(RowBatch** next_batch) {
   received_first_batch_ = true;
 
   DCHECK(!batch_queue_.empty());
-  RowBatch* result = batch_queue_.front().second;
-  recvr_->num_buffered_bytes_ -= batch_queue_.front().first;
+  const QueuedBatch& front = batch_queue_.front();
+  RowBatch* result = front.batch;
+  recvr_->num_buffered_bytes_ -= front.batch_size;
+  sender_buffered_bytes_[SenderIndex(front.sender_id)] -= front.batch_size;
   VLOG_ROW << "fetched #rows=" << result->num_rows();
   batch_queue_.pop_front();
-  data_removal__cv_.notify_one();
+  if (num_waiting_producers_ > 0) data_removal__cv_.notify_one();
   current_batch_.reset(result);
   *next_batch = current_batch_.get();
   return Status::OK;
 }
 
-void DataStreamRecvr::SenderQueue::AddBatch(const TRowBatch& thrift_batch) {
+void DataStreamRecvr::SenderQueue::AddBatch(TRowBatch* thrift_batch, int sender_id) {
+  int batch_size = RowBatch::GetBatchSize(*thrift_batch);
   unique_lock<mutex> l(lock_);
   if (is_cancelled_) return;
 
-  int batch_size = RowBatch::GetBatchSize(thrift_batch);
   COUNTER_ADD(recvr_->bytes_received_counter_, batch_size);
   DCHECK_GT(num_remaining_senders_, 0);
 
@@ -154,8 +278,9 @@ void DataStreamRecvr::SenderQueue::AddBatch(const TRowBatch& thrift_batch) {
   // the queue is currently empty. In the case of a merging receiver, batches are
   // received from a specific queue based on data order, and the pipeline will stall
   // if the merger is waiting for data from an empty queue that cannot be filled because
-  // the limit has been reached.
-  while (!batch_queue_.empty() && recvr_->ExceedsLimit(batch_size) && !is_cancelled_) {
+  // the limit has been reached. The queues of a merging receiver also prefetch a
+  // second batch, so that the merger does not stall on the queue it just drained.
+  while (!BelowPrefetchDepth() && recvr_->ExceedsLimit(batch_size) && !is_cancelled_) {
     SCOPED_TIMER(recvr_->buffer_full_total_timer_);
     VLOG_ROW << " wait removal: empty=" << (batch_queue_.empty() ? 1 : 0)
              << " #buffered=" << recvr_->num_buffered_bytes_
@@ -165,6 +290,7 @@ void DataStreamRecvr::SenderQueue::AddBatch(const TRowBatch& thrift_batch) {
     // one thread may lock the try_lock, and that 'winner' starts the
     // scoped timer.
     bool got_timer_lock = false;
+    ++num_waiting_producers_;
     {
       try_mutex::scoped_try_lock timer_lock(recvr_->buffer_wall_timer_lock_);
       if (timer_lock) {
@@ -176,6 +302,7 @@ void DataStreamRecvr::SenderQueue::AddBatch(const TRowBatch& thrift_batch) {
         got_timer_lock = false;
       }
     }
+    --num_waiting_producers_;
     // If we had the timer lock, wake up another writer to make sure
     // that they (if no-one else) starts the timer. The guarantee is
     // that if no thread has the try_lock, the thread that we wake up
@@ -191,24 +318,75 @@ void DataStreamRecvr::SenderQueue::AddBatch(const TRowBatch& thrift_batch) {
     // time it takes this thread to finish (and yield lock_) and the
     // notified thread to be woken up and to acquire the try_lock. In
     // practice, this time is small relative to the total wait time.
-    if (got_timer_lock) data_removal__cv_.notify_one();
+    if (got_timer_lock && num_waiting_producers_ > 0) data_removal__cv_.notify_one();
   }
 
-  if (!is_cancelled_) {
-    RowBatch* batch = NULL;
+  if (is_cancelled_) return;
+  ReserveBatch(batch_size, sender_id);
+  l.unlock();
+  EnqueueBatch(thrift_batch, batch_size, sender_id);
+}
+
+int64_t DataStreamRecvr::SenderQueue::AddBatchWithCredit(TRowBatch* thrift_batch,
+    int sender_id) {
+  int64_t share = max<int64_t>(recvr_->total_buffer_limit_ / recvr_->num_senders_, 1);
+  if (thrift_batch != NULL) {
+    int batch_size = RowBatch::GetBatchSize(*thrift_batch);
     {
-      SCOPED_TIMER(recvr_->deserialize_row_batch_timer_);
-      // Note: if this function makes a row batch, the batch *must* be added
-      // to batch_queue_. It is not valid to create the row batch and destroy
-      // it in this thread.
-      batch = new RowBatch(recvr_->row_desc(), thrift_batch, recvr_->mem_tracker());
+      lock_guard<mutex> l(lock_);
+      // Let a cancelled stream's senders send on, their batches are dropped.
+      if (is_cancelled_) return share;
+      COUNTER_ADD(recvr_->bytes_received_counter_, batch_size);
+      DCHECK_GT(num_remaining_senders_, 0);
+      ReserveBatch(batch_size, sender_id);
     }
-    VLOG_ROW << "added #rows=" << batch->num_rows()
-             << " batch_size=" << batch_size << "\n";
-    batch_queue_.push_back(make_pair(batch_size, batch));
-    recvr_->num_buffered_bytes_ += batch_size;
-    data_arrival_cv_.notify_one();
+    EnqueueBatch(thrift_batch, batch_size, sender_id);
   }
+  lock_guard<mutex> l(lock_);
+  if (is_cancelled_) return share;
+  // A sender below the prefetch depth always gets credit for one more batch, for the
+  // same reason AddBatch() never blocks on it: a merging receiver may be waiting for
+  // exactly that sender. Otherwise, a sender can have at most its share of the buffer
+  // limit buffered, and no sender gets credit while the whole stream is over the limit.
+  int64_t buffered = sender_buffered_bytes_[SenderIndex(sender_id)];
+  if (BelowPrefetchDepth()) return max<int64_t>(share - buffered, 1);
+  return min(share - buffered,
+      static_cast<int64_t>(recvr_->total_buffer_limit_ - recvr_->num_buffered_bytes_));
+}
+
+void DataStreamRecvr::SenderQueue::ReserveBatch(int batch_size, int sender_id) {
+  DCHECK(!is_cancelled_);
+  ++num_pending_batches_;
+  sender_buffered_bytes_[SenderIndex(sender_id)] += batch_size;
+  recvr_->num_buffered_bytes_ += batch_size;
+}
+
+void DataStreamRecvr::SenderQueue::EnqueueBatch(TRowBatch* thrift_batch, int batch_size,
+    int sender_id) {
+  QueuedBatch queued_batch;
+  queued_batch.batch_size = batch_size;
+  queued_batch.sender_id = sender_id;
+  {
+    SCOPED_TIMER(recvr_->deserialize_row_batch_timer_);
+    // Note: if this function makes a row batch, the batch *must* be added
+    // to batch_queue_. It is not valid to create the row batch and destroy
+    // it in this thread.
+    queued_batch.batch =
+        new RowBatch(recvr_->row_desc(), thrift_batch, recvr_->mem_tracker());
+  }
+  VLOG_ROW << "added #rows=" << queued_batch.batch->num_rows()
+           << " batch_size=" << batch_size << "\n";
+  lock_guard<mutex> l(lock_);
+  DCHECK_GT(num_pending_batches_, 0);
+  --num_pending_batches_;
+  // If the stream was cancelled while the batch was deserialized, Close() frees it.
+  batch_queue_.push_back(queued_batch);
+  if (is_cancelled_) {
+    if (num_pending_batches_ == 0) pending_batches_done_cv_.notify_all();
+    return;
+  }
+  // The consumer only waits if the queue was empty.
+  if (consumer_waiting_) data_arrival_cv_.notify_one();
 }
 
 void DataStreamRecvr::SenderQueue::DecrementSenders() {
@@ -219,7 +397,7 @@ void DataStreamRecvr::SenderQueue::DecrementSenders() {
             << recvr_->fragment_instance_id()
             << " node_id=" << recvr_->dest_node_id()
             << " #senders=" << num_remaining_senders_;
-  if (num_remaining_senders_ == 0) data_arrival_cv_.notify_one();
+  if (num_remaining_senders_ == 0 && consumer_waiting_) data_arrival_cv_.notify_one();
 }
 
 void DataStreamRecvr::SenderQueue::Cancel() {
@@ -240,32 +418,239 @@ void DataStreamRecvr::SenderQueue::Cancel() {
 }
 
 void DataStreamRecvr::SenderQueue::Close() {
-  // Delete any batches queued in batch_queue_
-  for (RowBatchQueue::iterator it = batch_queue_.begin();
-      it != batch_queue_.end(); ++it) {
-    delete it->second;
+  // Batches that arrive from now on are dropped by their producers.
+  Cancel();
+  {
+    unique_lock<mutex> l(lock_);
+    // Wait for the batches that are being deserialized, they are freed below together
+    // with the queued batches. The receiver's memory tracker must outlive them.
+    while (num_pending_batches_ > 0) pending_batches_done_cv_.wait(l);
+    // Delete any batches queued in batch_queue_
+    for (RowBatchQueue::iterator it = batch_queue_.begin();
+        it != batch_queue_.end(); ++it) {
+      delete it->batch;
+    }
+    batch_queue_.clear();
   }
 
   current_batch_.reset();
 }
 
-Status DataStreamRecvr::CreateMerger(const TupleRowComparator& less_than) {
+// A group of sender queues of a merging receiver that is merged by its own thread into
+// a queue of sorted row batches, which are in turn one of the runs of the receiver's
+// final merge. The group's merger does not deep copy, so the resources of the sender
+// batches are attached to the merged batches and, by the final merger, to the output
+// batches of the receiver.
+class DataStreamRecvr::MergeGroup {
+ public:
+  // 'stall_timer' counts the time the group's thread waits for batches of its senders.
+  MergeGroup(DataStreamRecvr* recvr, const vector<SenderQueue*>& queues,
+      const TupleRowComparator& less_than, RuntimeProfile* profile,
+      RuntimeProfile::Counter* stall_timer)
+    : recvr_(recvr),
+      queues_(queues),
+      merger_(new SortedRunMerger(less_than, &recvr->row_desc_, profile, false)),
+      batch_queue_(MERGE_GROUP_QUEUE_DEPTH),
+      unsent_batch_(NULL),
+      received_first_batch_(false) {
+    BOOST_FOREACH(SenderQueue* queue, queues_) {
+      queue->SetMergeGroup(stall_timer);
+    }
+  }
+
+  ~MergeGroup() {
+    DCHECK(merge_thread_.get() == NULL) << "Must call Stop()";
+  }
+
+  // Starts the thread that merges the group.
+  void Start() {
+    merge_thread_.reset(new Thread("data-stream-recvr", "merge-group",
+        &MergeGroup::MergeThread, this));
+  }
+
+  // The RunBatchSupplier of the group for the final merge. Returns the next merged
+  // batch, or NULL once the group is exhausted. The previous batch is freed.
+  Status GetBatch(RowBatch** next_batch) {
+    current_batch_.reset();
+    *next_batch = NULL;
+    RowBatch* batch;
+    {
+      // The consumer waits for the group instead of its senders, so this counts as
+      // the consumer's time waiting for data.
+      SCOPED_TIMER(recvr_->data_arrival_timer_);
+      SCOPED_TIMER(received_first_batch_ ? NULL : recvr_->first_batch_wait_total_timer_);
+      if (!batch_queue_.BlockingGet(&batch)) return Status::CANCELLED;
+    }
+    received_first_batch_ = true;
+    // The merge thread puts a final NULL batch after setting status_.
+    if (batch == NULL) return status_;
+    current_batch_.reset(batch);
+    *next_batch = batch;
+    return Status::OK;
+  }
+
+  // Cancels the group's sender queues and waits for the merge thread to finish.
+  // Idempotent.
+  void Stop() {
+    if (merge_thread_.get() == NULL) return;
+    BOOST_FOREACH(SenderQueue* queue, queues_) {
+      queue->Cancel();
+    }
+    batch_queue_.Shutdown();
+    merge_thread_->Join();
+    merge_thread_.reset();
+  }
+
+  // Transfers the resources of all batches the group still holds to 'transfer_batch'.
+  // Stop() must have been called. The resources of the current batches of the group's
+  // sender queues are transferred by the receiver.
+  void TransferAllResources(RowBatch* transfer_batch) {
+    DCHECK(merge_thread_.get() == NULL);
+    if (current_batch_.get() != NULL) {
+      current_batch_->TransferResourceOwnership(transfer_batch);
+    }
+    RowBatch* batch;
+    batch_queue_.Shutdown();
+    while (batch_queue_.BlockingGet(&batch)) {
+      if (batch == NULL) continue;
+      batch->TransferResourceOwnership(transfer_batch);
+      delete batch;
+    }
+    if (unsent_batch_ != NULL) {
+      unsent_batch_->TransferResourceOwnership(transfer_batch);
+      delete unsent_batch_;
+      unsent_batch_ = NULL;
+    }
+  }
+
+  // Frees all batches. Stop() must have been called.
+  void Close() {
+    DCHECK(merge_thread_.get() == NULL);
+    current_batch_.reset();
+    RowBatch* batch;
+    batch_queue_.Shutdown();
+    while (batch_queue_.BlockingGet(&batch)) delete batch;
+    delete unsent_batch_;
+    unsent_batch_ = NULL;
+  }
+
+ private:
+  // Merges the sender queues into batch_queue_ until they are exhausted, an error
+  // occurs or batch_queue_ is shut down.
+  void MergeThread() {
+    vector<SortedRunMerger::RunBatchSupplier> input_batch_suppliers;
+    BOOST_FOREACH(SenderQueue* queue, queues_) {
+      input_batch_suppliers.push_back(bind(mem_fn(&SenderQueue::GetBatch), queue, _1));
+    }
+    Status status = merger_->Prepare(input_batch_suppliers);
+    bool eos = false;
+    while (status.ok() && !eos) {
+      RowBatch* batch = new RowBatch(recvr_->row_desc_, MERGE_GROUP_BATCH_SIZE,
+          recvr_->mem_tracker());
+      status = merger_->GetNext(batch, &eos);
+      // A batch without rows (only at eos) is kept rather than freed, because it may
+      // hold resources of rows that were returned in earlier batches.
+      if (!status.ok() || batch->num_rows() == 0) {
+        unsent_batch_ = batch;
+        break;
+      }
+      if (!batch_queue_.BlockingPut(batch)) {
+        unsent_batch_ = batch;
+        return;
+      }
+    }
+    status_ = status;
+    batch_queue_.BlockingPut(NULL);
+  }
+
+  DataStreamRecvr* recvr_;
+
+  // The sender queues merged by this group. Owned by the receiver.
+  vector<SenderQueue*> queues_;
+
+  // Merges queues_. Only used by the merge thread.
+  scoped_ptr<SortedRunMerger> merger_;
+
+  // Merged batches that were not returned by GetBatch() yet. A NULL batch marks the end
+  // of the group.
+  BlockingQueue<RowBatch*> batch_queue_;
+
+  // The batch most recently returned by GetBatch().
+  scoped_ptr<RowBatch> current_batch_;
+
+  // A merged batch that the merge thread could not put into batch_queue_. It may hold
+  // resources of rows that were returned in earlier batches.
+  RowBatch* unsent_batch_;
+
+  // Set to true when GetBatch() returned for the first time. Only used by the consumer.
+  bool received_first_batch_;
+
+  // Status of the merge. Set by the merge thread before the final NULL batch.
+  Status status_;
+
+  scoped_ptr<Thread> merge_thread_;
+};
+
+int DataStreamRecvr::num_merge_groups() const {
+  DCHECK(is_merging_);
+  int group_size = FLAGS_exchange_merge_group_size;
+  if (group_size <= 1 || sender_queues_.size() <= group_size) return 0;
+  return (sender_queues_.size() + group_size - 1) / group_size;
+}
+
+Status DataStreamRecvr::CreateMerger(const TupleRowComparator& less_than,
+    const vector<TupleRowComparator>& group_less_thans) {
   DCHECK(is_merging_);
   vector<SortedRunMerger::RunBatchSupplier> input_batch_suppliers;
-  input_batch_suppliers.reserve(sender_queues_.size());
 
   // Create the merger that will a single stream of sorted rows.
   merger_.reset(new SortedRunMerger(less_than, &row_desc_, profile_, false));
 
-  for (int i = 0; i < sender_queues_.size(); ++i) {
-    input_batch_suppliers.push_back(
-        bind(mem_fn(&SenderQueue::GetBatch), sender_queues_[i], _1));
+  int num_groups = num_merge_groups();
+  if (num_groups > 0 && group_less_thans.size() == num_groups) {
+    RuntimeProfile* pre_merge_profile =
+        sender_queue_pool_.Add(new RuntimeProfile(&sender_queue_pool_, "PreMerge"));
+    profile_->AddChild(pre_merge_profile);
+    // Spread the senders evenly over the groups.
+    int num_queues = sender_queues_.size();
+    for (int i = 0; i < num_groups; ++i) {
+      int begin = static_cast<int64_t>(i) * num_queues / num_groups;
+      int end = static_cast<int64_t>(i + 1) * num_queues / num_groups;
+      vector<SenderQueue*> queues(
+          sender_queues_.begin() + begin, sender_queues_.begin() + end);
+      // The stall time of a group is broken down by the senders of the group.
+      string group_timer_name = Substitute("MergeGroup$0StallTime", i);
+      RuntimeProfile::Counter* stall_timer =
+          ADD_CHILD_TIMER(profile_, group_timer_name, "SenderStallTime");
+      for (int j = begin; j < end; ++j) {
+        sender_queues_[j]->SetStallTimer(ADD_CHILD_TIMER(profile_,
+            Substitute("Sender$0StallTime", j), group_timer_name));
+      }
+      MergeGroup* group = sender_queue_pool_.Add(new MergeGroup(this, queues,
+          group_less_thans[i], pre_merge_profile, stall_timer));
+      merge_groups_.push_back(group);
+      group->Start();
+      input_batch_suppliers.push_back(
+          bind(mem_fn(&MergeGroup::GetBatch), group, _1));
+    }
+  } else {
+    input_batch_suppliers.reserve(sender_queues_.size());
+    for (int i = 0; i < sender_queues_.size(); ++i) {
+      sender_queues_[i]->SetStallTimer(ADD_CHILD_TIMER(profile_,
+          Substitute("Sender$0StallTime", i), "SenderStallTime"));
+      input_batch_suppliers.push_back(
+          bind(mem_fn(&SenderQueue::GetBatch), sender_queues_[i], _1));
+    }
   }
   RETURN_IF_ERROR(merger_->Prepare(input_batch_suppliers));
   return Status::OK;
 }
 
 void DataStreamRecvr::TransferAllResources(RowBatch* transfer_batch) {
+  BOOST_FOREACH(MergeGroup* group, merge_groups_) {
+    group->Stop();
+    group->TransferAllResources(transfer_batch);
+  }
   BOOST_FOREACH(SenderQueue* sender_queue, sender_queues_) {
     if (sender_queue->current_batch() != NULL) {
       sender_queue->current_batch()->TransferResourceOwnership(transfer_batch);
@@ -282,6 +667,7 @@ DataStreamRecvr::DataStreamRecvr(DataStreamMgr* stream_mgr, MemTracker* parent_t
     dest_node_id_(dest_node_id),
     total_buffer_limit_(total_buffer_limit),
     row_desc_(row_desc),
+    num_senders_(num_senders),
     is_merging_(is_merging),
     num_buffered_bytes_(0),
     profile_(profile) {
@@ -290,6 +676,8 @@ DataStreamRecvr::DataStreamRecvr(DataStreamMgr* stream_mgr, MemTracker* parent_t
   int num_queues = is_merging ? num_senders : 1;
   sender_queues_.reserve(num_queues);
   int num_sender_per_queue = is_merging ? 1 : num_senders;
+  DCHECK_GT(num_senders, 0);
+  sender_stall_timer_ = is_merging ? ADD_TIMER(profile_, "SenderStallTime") : NULL;
   for (int i = 0; i < num_queues; ++i) {
     SenderQueue* queue = sender_queue_pool_.Add(new SenderQueue(this,
         num_sender_per_queue, profile));
@@ -314,10 +702,15 @@ Status DataStreamRecvr::GetNext(RowBatch* output_batch, bool* eos) {
   return merger_->GetNext(output_batch, eos);
 }
 
-void DataStreamRecvr::AddBatch(const TRowBatch& thrift_batch, int sender_id) {
+void DataStreamRecvr::AddBatch(TRowBatch* thrift_batch, int sender_id) {
   int use_sender_id = is_merging_ ? sender_id : 0;
   // Add all batches to the same queue if is_merging_ is false.
-  sender_queues_[use_sender_id]->AddBatch(thrift_batch);
+  sender_queues_[use_sender_id]->AddBatch(thrift_batch, sender_id);
+}
+
+int64_t DataStreamRecvr::AddBatchWithCredit(TRowBatch* thrift_batch, int sender_id) {
+  int use_sender_id = is_merging_ ? sender_id : 0;
+  return sender_queues_[use_sender_id]->AddBatchWithCredit(thrift_batch, sender_id);
 }
 
 void DataStreamRecvr::RemoveSender(int sender_id) {
@@ -332,6 +725,11 @@ void DataStreamRecvr::CancelStream() {
 }
 
 void DataStreamRecvr::Close() {
+  // The pre-merge threads use the sender queues.
+  BOOST_FOREACH(MergeGroup* group, merge_groups_) {
+    group->Stop();
+    group->Close();
+  }
   for (int i = 0; i < sender_queues_.size(); ++i) {
     sender_queues_[i]->Close();
   }
@@ -54,6 +54,11 @@ class RuntimeProfile;
 // The receiver sets deep_copy to false on the merger - resources are transferred from
 // the input batches from each sender queue to the merger to the output batch by the
 // merger itself as it processes each run.
+// With more than --exchange_merge_group_size senders, the senders are split into groups
+// that are pre-merged in parallel by one thread per group (a MergeGroup), and the
+// final merge in GetNext() merges the groups' outputs. The pre-merge threads fetch
+// batches from their sender queues ahead of the final merge, so a slow sender does
+// not stall the consumer as long as its group has merged rows left to return.
 //
 // DataStreamRecvr::Close() must be called by the caller of CreateRecvr() to remove the
 // recvr instance from the tracking structure of its DataStreamMgr in all cases.
@@ -72,17 +77,29 @@ class DataStreamRecvr {
   // Deregister from DataStreamMgr instance, which shares ownership of this instance.
   void Close();
 
+  // Returns the number of groups in which CreateMerger() pre-merges the senders in
+  // parallel, or 0 if it merges them directly. Must only be called if is_merging_ is
+  // true.
+  int num_merge_groups() const;
+
   // Create a SortedRunMerger instance to merge rows from multiple sender according to the
   // specified row comparator. Fetches the first batches from the individual sender
   // queues. The exprs used in less_than must have already been prepared and opened.
-  Status CreateMerger(const TupleRowComparator& less_than);
+  // The senders are only pre-merged in groups if 'group_less_thans' has one comparator
+  // for each of the num_merge_groups() groups. Each is used by another thread, so
+  // their exprs must not be shared with each other or with 'less_than' (unless the exprs
+  // are safe to evaluate concurrently, like SlotRefs).
+  Status CreateMerger(const TupleRowComparator& less_than,
+      const std::vector<TupleRowComparator>& group_less_thans =
+          std::vector<TupleRowComparator>());
 
   // Fill output_batch with the next batch of rows obtained by merging the per-sender
   // input streams. Must only be called if is_merging_ is true.
   Status GetNext(RowBatch* output_batch, bool* eos);
 
   // Transfer all resources from the current batches being processed from each sender
-  // queue to the specified batch.
+  // queue to the specified batch. Must only be called once the caller is done
+  // retrieving rows, because it stops the pre-merge threads.
   void TransferAllResources(RowBatch* transfer_batch);
 
   const TUniqueId& fragment_instance_id() const { return fragment_instance_id_; }
@@ -93,6 +110,7 @@ class DataStreamRecvr {
  private:
   friend class DataStreamMgr;
   class SenderQueue;
+  class MergeGroup;
 
   DataStreamRecvr(DataStreamMgr* stream_mgr, MemTracker* parent_tracker,
       const RowDescriptor& row_desc, const TUniqueId& fragment_instance_id,
@@ -100,8 +118,17 @@ class DataStreamRecvr {
       RuntimeProfile* profile);
 
   // Add a new batch of rows to the appropriate sender queue, blocking if the queue is
-  // full. Called from DataStreamMgr.
-  void AddBatch(const TRowBatch& thrift_batch, int sender_id);
+  // full. Called from DataStreamMgr. The uncompressed tuple data of 'thrift_batch' is
+  // taken over by the new row batch.
+  void AddBatch(TRowBatch* thrift_batch, int sender_id);
+
+  // Like AddBatch(), but never blocks. Instead, returns the credit of the sender: the
+  // number of bytes it may still send before the receiver consumed some of the batches
+  // it has buffered. The sender must not send another batch while its credit is not
+  // positive. 'thrift_batch' may be NULL to only get the credit. Called from
+  // DataStreamMgr for batches sent with TransmitDataBatch(), whose handler must not
+  // block because a single rpc carries the batches of many streams.
+  int64_t AddBatchWithCredit(TRowBatch* thrift_batch, int sender_id);
 
   // Indicate that a particular sender is done. Delegated to the appropriate
   // sender queue. Called from DataStreamMgr.
@@ -131,6 +158,10 @@ class DataStreamRecvr {
   // Row schema, copied from the caller of CreateRecvr().
   RowDescriptor row_desc_;
 
+  // Number of senders of this stream. Each gets an equal share of total_buffer_limit_
+  // as credit.
+  int num_senders_;
+
   // True if this reciver merges incoming rows from different senders. Per-sender
   // row batch queues are maintained in this case.
   bool is_merging_;
@@ -150,6 +181,10 @@ class DataStreamRecvr {
   // SortedRunMerger used to merge rows from different senders.
   boost::scoped_ptr<SortedRunMerger> merger_;
 
+  // Groups of sender queues that are pre-merged in parallel before the final merge by
+  // merger_. Empty if the senders are merged directly. Owned by sender_queue_pool_.
+  std::vector<MergeGroup*> merge_groups_;
+
   // Pool of sender queues.
   ObjectPool sender_queue_pool_;
 
@@ -186,6 +221,13 @@ class DataStreamRecvr {
 
   // Total time spent waiting for data to arrive in the recv buffer
   RuntimeProfile::Counter* data_arrival_timer_;
+
+  // Only for merging receivers: the time the merges spent waiting for a batch of a
+  // sender, in total and per sender as child counters. If the senders are pre-merged,
+  // the per sender counters are grouped under a counter per merge group. The waits of
+  // the merge group threads are not counted in data_arrival_timer_ or
+  // first_batch_wait_total_timer_, which only time the consumer.
+  RuntimeProfile::Counter* sender_stall_timer_;
 };
 
 }
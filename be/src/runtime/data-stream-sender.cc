@@ -15,9 +15,12 @@
 #include "runtime/data-stream-sender.h"
 
 #include <iostream>
+#include <limits>
 #include <boost/shared_ptr.hpp>
 #include <thrift/protocol/TDebugProtocol.h>
 
+#include "codegen/codegen-anyval.h"
+#include "codegen/llvm-codegen.h"
 #include "common/logging.h"
 #include "exprs/expr.h"
 #include "exprs/expr-context.h"
@@ -27,9 +30,12 @@
 #include "runtime/raw-value.h"
 #include "runtime/runtime-state.h"
 #include "runtime/client-cache.h"
+#include "runtime/data-stream-transport.h"
 #include "runtime/mem-tracker.h"
 #include "util/debug-util.h"
 #include "util/network-util.h"
+#include "util/stopwatch.h"
+#include "util/time.h"
 #include "rpc/thrift-client.h"
 #include "rpc/thrift-util.h"
 
@@ -39,61 +45,95 @@
 
 using namespace std;
 using namespace boost;
+using namespace llvm;
 using namespace apache::thrift;
 using namespace apache::thrift::protocol;
 using namespace apache::thrift::transport;
 
+DEFINE_string(exchange_compression_codec, "lz4", "Codec for the tuple data of row "
+    "batches sent between fragments: 'lz4', 'snappy', 'none' or 'auto'. 'auto' uses lz4 "
+    "as long as the time spent compressing is less than the network time it saves.");
+DEFINE_int64(adaptive_join_max_broadcast_bytes, 256L * 1024 * 1024, "The largest build "
+    "side, in serialized bytes, of a join with an adaptive exchange that is broadcast. "
+    "Larger build sides are hash partitioned together with the probe side.");
+
 namespace impala {
 
-// A channel sends data asynchronously via calls to TransmitData
-// to a single destination ipaddress/node.
+// With --exchange_compression_codec=auto, the first batches are always compressed to
+// measure the compression ratio and speed.
+static const int MIN_COMPRESSED_BATCHES = 4;
+
+// With --exchange_compression_codec=auto, every this many batches one batch is
+// compressed even if compression did not pay off, so a change in the data or the
+// network is noticed.
+static const int COMPRESSION_PROBE_INTERVAL = 64;
+
+// A channel without credit asks the receiver for it again after waiting for at most
+// this long.
+static const int64_t MAX_CREDIT_POLL_INTERVAL_MS = 16;
+
+// A channel sends data asynchronously to a single destination ipaddress/node through
+// the process-wide DataStreamTransport, which batches the requests of all channels to
+// the same host into one TransmitDataBatch() rpc.
 // It has a fixed-capacity buffer and allows the caller either to add rows to
-// that buffer individually (AddRow()), or circumvent the buffer altogether and send
-// TRowBatches directly (SendBatch()). Either way, there can only be one in-flight RPC
-// at any one time (ie, sending will block if the most recent rpc hasn't finished,
-// which allows the receiver node to throttle the sender by withholding acks).
+// that buffer (AddRows()), or circumvent the buffer altogether and send
+// TRowBatches directly (SendBatch()). Rows added to the buffer are serialized right away
+// into a TRowBatch, which is compressed and swapped with the one that is sent once the
+// buffer is full. Either way, there can only be one in-flight request
+// at any one time (ie, sending will block if the most recent request hasn't finished).
+// The receiver throttles the sender with credit: every response carries the number of
+// bytes the receiver still accepts from this sender, and a batch is only sent while that
+// is positive. Without credit, the channel polls the receiver until it has some.
 // *Not* thread-safe.
 class DataStreamSender::Channel {
  public:
   // Create channel to send data to particular ipaddress/port/query/node
   // combination. buffer_size is specified in bytes and a soft limit on
   // how much tuple data is getting accumulated before being sent; it only applies
-  // when data is added via AddRow() and not sent directly via SendBatch().
+  // when data is added via AddRows() and not sent directly via SendBatch().
   Channel(DataStreamSender* parent, const RowDescriptor& row_desc,
           const TNetworkAddress& destination, const TUniqueId& fragment_instance_id,
           PlanNodeId dest_node_id, int buffer_size)
     : parent_(parent),
       buffer_size_(buffer_size),
-      client_cache_(NULL),
+      transport_(NULL),
       row_desc_(row_desc),
       address_(MakeNetworkAddress(destination.hostname, destination.port)),
       fragment_instance_id_(fragment_instance_id),
       dest_node_id_(dest_node_id),
       num_data_bytes_sent_(0),
-      rpc_thread_("DataStreamSender", "SenderThread", 1, 1,
-          bind<void>(mem_fn(&Channel::TransmitData), this, _1, _2)),
-      rpc_in_flight_(false) {
+      capacity_(0),
+      tracked_bytes_(0),
+      batch_moved_(false),
+      rpc_in_flight_(false),
+      credit_(1) {
+  }
+
+  // The transport may still call TransmitDone() if the channel was not closed.
+  ~Channel() {
+    unique_lock<mutex> l(rpc_thread_lock_);
+    while (rpc_in_flight_) rpc_done_cv_.wait(l);
   }
 
   // Initialize channel.
   // Returns OK if successful, error indication otherwise.
   Status Init(RuntimeState* state);
 
-  // Copies a single row into this channel's output buffer and flushes buffer
-  // if it reaches capacity.
+  // Serializes the rows of 'batch' with the indexes rows[0, num_rows) into this
+  // channel's output buffer and flushes the buffer whenever it reaches capacity.
   // Returns error status if any of the preceding rpcs failed, OK otherwise.
-  Status AddRow(TupleRow* row);
+  Status AddRows(RowBatch* batch, const int* rows, int num_rows);
 
   // Asynchronously sends a row batch.
-  // Returns the status of the most recently finished TransmitData
-  // rpc (or OK if there wasn't one that hasn't been reported yet).
+  // Returns the status of the most recently finished request
+  // (or OK if there wasn't one that hasn't been reported yet).
   Status SendBatch(TRowBatch* batch);
 
-  // Return status of last TransmitData rpc (initiated by the most recent call
+  // Return status of last request (initiated by the most recent call
   // to either SendBatch() or SendCurrentBatch()).
   Status GetSendStatus();
 
-  // Waits for the rpc thread pool to finish the current rpc.
+  // Waits for the transport to finish the current request.
   void WaitForRpc();
 
   // Flush buffered rows and close channel.
@@ -101,13 +141,14 @@ class DataStreamSender::Channel {
   void Close(RuntimeState* state);
 
   int64_t num_data_bytes_sent() const { return num_data_bytes_sent_; }
+  const TNetworkAddress& address() const { return address_; }
   TRowBatch* thrift_batch() { return &thrift_batch_; }
 
  private:
   DataStreamSender* parent_;
   int buffer_size_;
 
-  ImpalaInternalServiceClientCache* client_cache_;
+  DataStreamTransport* transport_;
 
   const RowDescriptor& row_desc_;
   TNetworkAddress address_;
@@ -117,41 +158,76 @@ class DataStreamSender::Channel {
   // the number of TRowBatch.data bytes sent successfully
   int64_t num_data_bytes_sent_;
 
-  // we're accumulating rows into this batch
-  scoped_ptr<RowBatch> batch_;
+  // Maximum number of rows in output_batch_.
+  int capacity_;
+
+  // We're serializing rows into this batch. Its tuple_data is uncompressed.
+  TRowBatch output_batch_;
+
+  // The batch that is being sent. Swapped with output_batch_ when that is full.
   TRowBatch thrift_batch_;
 
-  // We want to reuse the rpc thread to prevent creating a thread per rowbatch.
+  // Scratch buffer for compressing output_batch_.
+  std::string compression_scratch_;
+
+  // Bytes of the buffers above that are counted against parent_->mem_tracker_.
+  int64_t tracked_bytes_;
+
+  // The request that is in flight, or was sent last. Owned by the transport while
+  // rpc_in_flight_ is true.
+  TTransmitDataParams params_;
+
+  // True if thrift_batch_ was moved into params_ and has to be moved back once the
+  // request finished.
+  bool batch_moved_;
+
+  // Measures how long the request in flight takes.
+  MonotonicStopWatch rpc_timer_;
+
   // TODO: currently we only have one batch in flight, but we should buffer more
   // batches. This is a bit tricky since the channels share the outgoing batch
   // pointer we need some mechanism to coordinate when the batch is all done.
-  // TODO: if the order of row batches does not matter, we can consider increasing
-  // the number of threads.
-  ThreadPool<TRowBatch*> rpc_thread_; // sender thread.
-  condition_variable rpc_done_cv_;   // signaled when rpc_in_flight_ is set to true.
-  mutex rpc_thread_lock_; // Lock with rpc_done_cv_ protecting rpc_in_flight_
-  bool rpc_in_flight_;  // true if the rpc_thread_ is busy sending.
+  condition_variable rpc_done_cv_;   // signaled when rpc_in_flight_ is set to false.
+  mutex rpc_thread_lock_; // Lock with rpc_done_cv_ protecting the fields below
+  bool rpc_in_flight_;  // true if the transport is busy sending params_.
+
+  Status rpc_status_;  // status of most recently finished request
 
-  Status rpc_status_;  // status of most recently finished TransmitData rpc
+  // Number of bytes the receiver accepts from this sender, as returned by the last
+  // request. The next batch is only sent while this is positive.
+  int64_t credit_;
 
-  // Serialize batch_ into thrift_batch_ and send via SendBatch().
+  // Compress output_batch_, swap it with thrift_batch_ and send via SendBatch().
   // Returns SendBatch() status.
   Status SendCurrentBatch();
 
-  // Synchronously call TransmitData() on a client from client_cache_ and update
-  // rpc_status_ based on return value (or set to error if RPC failed).
-  // Called from a thread from the rpc_thread_ pool.
-  void TransmitData(int thread_id, const TRowBatch*);
-  void TransmitDataHelper(const TRowBatch*);
+  // Updates tracked_bytes_ and parent_->mem_tracker_ to the current size of the buffers.
+  void UpdateMemUsage();
+
+  // Hands a request with 'batch' (which may be NULL) and 'eos' to the transport. There
+  // must not be a request in flight. thrift_batch_ is moved into the request, other
+  // batches are copied.
+  void Transmit(TRowBatch* batch, bool eos);
+
+  // Called by the transport once the request in params_ finished. Updates rpc_status_,
+  // credit_ and the counters and wakes up WaitForRpc().
+  void TransmitDone(const Status& status, const TTransmitDataResult& result);
+
+  // Waits until credit_ is positive, polling the receiver with requests without a
+  // batch. Returns an error if a request fails or the fragment is cancelled.
+  Status WaitForCredit();
 
   Status CloseInternal();
 };
 
 Status DataStreamSender::Channel::Init(RuntimeState* state) {
-  client_cache_ = state->impalad_client_cache();
-  // TODO: figure out how to size batch_
-  int capacity = max(1, buffer_size_ / max(row_desc_.GetRowSize(), 1));
-  batch_.reset(new RowBatch(row_desc_, capacity, parent_->mem_tracker_.get()));
+  transport_ = state->stream_transport();
+  // TODO: figure out how to size output_batch_
+  capacity_ = max(1, buffer_size_ / max(row_desc_.GetRowSize(), 1));
+  output_batch_.num_rows = 0;
+  output_batch_.compression_type = THdfsCompression::NONE;
+  row_desc_.ToThrift(&output_batch_.row_tuples);
+  row_desc_.ToThrift(&thrift_batch_.row_tuples);
   return Status::OK;
 }
 
@@ -160,72 +236,92 @@ Status DataStreamSender::Channel::SendBatch(TRowBatch* batch) {
            << " dest_node=" << dest_node_id_ << " #rows=" << batch->num_rows;
   // return if the previous batch saw an error
   RETURN_IF_ERROR(GetSendStatus());
-  {
-    unique_lock<mutex> l(rpc_thread_lock_);
-    rpc_in_flight_ = true;
-  }
-  if (!rpc_thread_.Offer(batch)) {
-    unique_lock<mutex> l(rpc_thread_lock_);
-    rpc_in_flight_ = false;
-  }
+  RETURN_IF_ERROR(WaitForCredit());
+  Transmit(batch, false);
   return Status::OK;
 }
 
-void DataStreamSender::Channel::TransmitData(int thread_id, const TRowBatch* batch) {
-  DCHECK(rpc_in_flight_);
-  TransmitDataHelper(batch);
+// Swaps the contents of 'a' and 'b' without copying the tuple data.
+static void SwapRowBatch(TRowBatch* a, TRowBatch* b) {
+  std::swap(a->num_rows, b->num_rows);
+  a->row_tuples.swap(b->row_tuples);
+  a->tuple_offsets.swap(b->tuple_offsets);
+  a->tuple_data.swap(b->tuple_data);
+  std::swap(a->compression_type, b->compression_type);
+  std::swap(a->uncompressed_size, b->uncompressed_size);
+}
 
+void DataStreamSender::Channel::Transmit(TRowBatch* batch, bool eos) {
+  DCHECK(!rpc_in_flight_);
+  params_.protocol_version = ImpalaInternalServiceVersion::V1;
+  params_.__set_dest_fragment_instance_id(fragment_instance_id_);
+  params_.__set_dest_node_id(dest_node_id_);
+  params_.__set_sender_id(parent_->sender_id_);
+  params_.__set_eos(eos);
+  // The channel's own batch is moved into the request and back instead of being copied.
+  // Broadcast batches are shared by all channels and have to be copied.
+  batch_moved_ = batch == &thrift_batch_;
+  if (batch == NULL) {
+    params_.__isset.row_batch = false;
+  } else if (batch_moved_) {
+    SwapRowBatch(batch, &params_.row_batch);
+    params_.__isset.row_batch = true;
+  } else {
+    params_.__set_row_batch(*batch);
+  }
+  VLOG_ROW << "Channel::Transmit() instance_id=" << fragment_instance_id_
+           << " dest_node=" << dest_node_id_
+           << " #rows=" << params_.row_batch.num_rows << " eos=" << eos;
   {
     unique_lock<mutex> l(rpc_thread_lock_);
-    rpc_in_flight_ = false;
+    rpc_in_flight_ = true;
   }
-  rpc_done_cv_.notify_one();
+  rpc_timer_ = MonotonicStopWatch();
+  rpc_timer_.Start();
+  transport_->Send(address_, &params_,
+      bind<void>(mem_fn(&Channel::TransmitDone), this, _1, _2));
 }
 
-void DataStreamSender::Channel::TransmitDataHelper(const TRowBatch* batch) {
-  DCHECK(batch != NULL);
-  try {
-    VLOG_ROW << "Channel::TransmitData() instance_id=" << fragment_instance_id_
-             << " dest_node=" << dest_node_id_
-             << " #rows=" << batch->num_rows;
-    TTransmitDataParams params;
-    params.protocol_version = ImpalaInternalServiceVersion::V1;
-    params.__set_dest_fragment_instance_id(fragment_instance_id_);
-    params.__set_dest_node_id(dest_node_id_);
-    params.__set_row_batch(*batch);  // yet another copy
-    params.__set_eos(false);
-    params.__set_sender_id(parent_->sender_id_);
-
-    ImpalaInternalServiceConnection client(client_cache_, address_, &rpc_status_);
-    if (!rpc_status_.ok()) return;
-
-    TTransmitDataResult res;
-    {
-      SCOPED_TIMER(parent_->thrift_transmit_timer_);
-      try {
-        client->TransmitData(res, params);
-      } catch (const TException& e) {
-        VLOG_RPC << "Retrying TransmitData: " << e.what();
-        rpc_status_ = client.Reopen();
-        if (!rpc_status_.ok()) {
-          return;
-        }
-        client->TransmitData(res, params);
-      }
-    }
+void DataStreamSender::Channel::TransmitDone(const Status& status,
+    const TTransmitDataResult& result) {
+  COUNTER_ADD(parent_->thrift_transmit_timer_, rpc_timer_.ElapsedTime());
+  int64_t batch_size = RowBatch::GetBatchSize(params_.row_batch);
+  if (batch_moved_) {
+    SwapRowBatch(&params_.row_batch, &thrift_batch_);
+  } else {
+    // Free the copy of the broadcast batch.
+    TRowBatch empty_batch;
+    SwapRowBatch(&params_.row_batch, &empty_batch);
+  }
 
-    if (res.status.status_code != TErrorCode::OK) {
-      rpc_status_ = res.status;
-    } else {
-      num_data_bytes_sent_ += RowBatch::GetBatchSize(*batch);
-      VLOG_ROW << "incremented #data_bytes_sent="
-               << num_data_bytes_sent_;
+  unique_lock<mutex> l(rpc_thread_lock_);
+  if (!status.ok()) {
+    rpc_status_ = status;
+  } else {
+    if (params_.__isset.row_batch) {
+      num_data_bytes_sent_ += batch_size;
+      VLOG_ROW << "incremented #data_bytes_sent=" << num_data_bytes_sent_;
     }
-  } catch (TException& e) {
-    stringstream msg;
-    msg << "TransmitData() to " << address_ << " failed:\n" << e.what();
-    rpc_status_ = Status(msg.str());
-    return;
+    // A missing credit means the receiver does not limit this sender.
+    credit_ = result.__isset.credit ? result.credit : numeric_limits<int64_t>::max();
+  }
+  rpc_in_flight_ = false;
+  // Notify while holding the lock: the channel may be destroyed as soon as the waiter
+  // sees that the request finished.
+  rpc_done_cv_.notify_one();
+}
+
+Status DataStreamSender::Channel::WaitForCredit() {
+  if (credit_ > 0) return Status::OK;
+  SCOPED_TIMER(parent_->credit_wait_timer_);
+  int64_t poll_interval_ms = 1;
+  while (true) {
+    Transmit(NULL, false);
+    RETURN_IF_ERROR(GetSendStatus());
+    if (credit_ > 0) return Status::OK;
+    if (parent_->state_->is_cancelled()) return Status::CANCELLED;
+    SleepForMs(poll_interval_ms);
+    poll_interval_ms = min(poll_interval_ms * 2, MAX_CREDIT_POLL_INTERVAL_MS);
   }
 }
 
@@ -237,41 +333,81 @@ void DataStreamSender::Channel::WaitForRpc() {
   }
 }
 
-Status DataStreamSender::Channel::AddRow(TupleRow* row) {
-  int row_num = batch_->AddRow();
-  if (row_num == RowBatch::INVALID_ROW_INDEX) {
-    // batch_ is full, let's send it; but first wait for an ongoing
-    // transmission to finish before modifying thrift_batch_
-    RETURN_IF_ERROR(SendCurrentBatch());
-    row_num = batch_->AddRow();
-    DCHECK_NE(row_num, RowBatch::INVALID_ROW_INDEX);
-  }
-
-  TupleRow* dest = batch_->GetRow(row_num);
-  batch_->CopyRow(row, dest);
+Status DataStreamSender::Channel::AddRows(RowBatch* batch, const int* rows,
+    int num_rows) {
   const vector<TupleDescriptor*>& descs = row_desc_.tuple_descriptors();
-  for (int i = 0; i < descs.size(); ++i) {
-    if (UNLIKELY(row->GetTuple(i) == NULL)) {
-      dest->SetTuple(i, NULL);
-    } else {
-      dest->SetTuple(i, row->GetTuple(i)->DeepCopy(*descs[i],
-          batch_->tuple_data_pool()));
+  for (int i = 0; i < num_rows; ++i) {
+    TupleRow* row = batch->GetRow(rows[i]);
+    int row_size = RowBatch::GetSerializedRowSize(row_desc_, row);
+    int offset = output_batch_.tuple_data.size();
+    if (output_batch_.num_rows == capacity_ ||
+        (output_batch_.num_rows > 0 && offset + row_size > buffer_size_)) {
+      // output_batch_ is full, let's send it. SendCurrentBatch() waits for an
+      // ongoing transmission to finish before reusing thrift_batch_.
+      RETURN_IF_ERROR(SendCurrentBatch());
+      offset = 0;
+    }
+
+    // Copy the tuples, including strings, straight into the serialized batch
+    // (converting string pointers into offsets in the process).
+    output_batch_.tuple_data.resize(offset + row_size);
+    char* tuple_data = const_cast<char*>(output_batch_.tuple_data.data()) + offset;
+    for (int j = 0; j < descs.size(); ++j) {
+      Tuple* tuple = row->GetTuple(j);
+      if (UNLIKELY(tuple == NULL)) {
+        // NULLs are encoded as -1
+        output_batch_.tuple_offsets.push_back(-1);
+        continue;
+      }
+      output_batch_.tuple_offsets.push_back(offset);
+      tuple->DeepCopy(*descs[j], &tuple_data, &offset, /* convert_ptrs */ true);
     }
+    DCHECK_EQ(offset, output_batch_.tuple_data.size());
+    ++output_batch_.num_rows;
   }
-  batch_->CommitLastRow();
+  UpdateMemUsage();
   return Status::OK;
 }
 
 Status DataStreamSender::Channel::SendCurrentBatch() {
-  // make sure there's no in-flight TransmitData() call that might still want to
+  {
+    SCOPED_TIMER(parent_->serialize_batch_timer_);
+    int uncompressed_bytes = RowBatch::GetBatchSize(output_batch_);
+    parent_->CompressBatch(&output_batch_, &compression_scratch_);
+    COUNTER_ADD(parent_->bytes_sent_counter_, RowBatch::GetBatchSize(output_batch_));
+    COUNTER_ADD(parent_->uncompressed_bytes_counter_, uncompressed_bytes);
+  }
+  // make sure there's no in-flight request that might still want to
   // access thrift_batch_
   WaitForRpc();
-  parent_->SerializeBatch(batch_.get(), &thrift_batch_);
-  batch_->Reset();
+  // Swap the buffers instead of copying them. Both batches have the same row_tuples.
+  thrift_batch_.num_rows = output_batch_.num_rows;
+  thrift_batch_.tuple_offsets.swap(output_batch_.tuple_offsets);
+  thrift_batch_.tuple_data.swap(output_batch_.tuple_data);
+  thrift_batch_.compression_type = output_batch_.compression_type;
+  thrift_batch_.uncompressed_size = output_batch_.uncompressed_size;
+  output_batch_.num_rows = 0;
+  output_batch_.tuple_offsets.clear();
+  output_batch_.tuple_data.clear();
+  output_batch_.compression_type = THdfsCompression::NONE;
+  UpdateMemUsage();
   RETURN_IF_ERROR(SendBatch(&thrift_batch_));
   return Status::OK;
 }
 
+void DataStreamSender::Channel::UpdateMemUsage() {
+  int64_t bytes = output_batch_.tuple_data.capacity() +
+      thrift_batch_.tuple_data.capacity() + compression_scratch_.capacity() +
+      (output_batch_.tuple_offsets.capacity() +
+       thrift_batch_.tuple_offsets.capacity()) * sizeof(int32_t);
+  if (bytes > tracked_bytes_) {
+    parent_->mem_tracker_->Consume(bytes - tracked_bytes_);
+  } else {
+    parent_->mem_tracker_->Release(tracked_bytes_ - bytes);
+  }
+  tracked_bytes_ = bytes;
+}
+
 Status DataStreamSender::Channel::GetSendStatus() {
   WaitForRpc();
   if (!rpc_status_.ok()) {
@@ -283,52 +419,25 @@ Status DataStreamSender::Channel::GetSendStatus() {
 Status DataStreamSender::Channel::CloseInternal() {
   VLOG_RPC << "Channel::Close() instance_id=" << fragment_instance_id_
            << " dest_node=" << dest_node_id_
-           << " #rows= " << batch_->num_rows();
+           << " #rows= " << output_batch_.num_rows;
 
-  if (batch_->num_rows() > 0) {
+  if (output_batch_.num_rows > 0) {
     // flush
     RETURN_IF_ERROR(SendCurrentBatch());
   }
   // if the last transmitted batch resulted in a error, return that error
   RETURN_IF_ERROR(GetSendStatus());
-  Status status;
-  ImpalaInternalServiceConnection client(client_cache_, address_, &status);
-  if (!status.ok()) {
-    return status;
-  }
-  try {
-    TTransmitDataParams params;
-    params.protocol_version = ImpalaInternalServiceVersion::V1;
-    params.__set_dest_fragment_instance_id(fragment_instance_id_);
-    params.__set_dest_node_id(dest_node_id_);
-    params.__set_sender_id(parent_->sender_id_);
-    params.__set_eos(true);
-    TTransmitDataResult res;
-    VLOG_RPC << "calling TransmitData to close channel";
-    try {
-      client->TransmitData(res, params);
-    } catch (const TException& e) {
-      VLOG_RPC << "Retrying TransmitData: " << e.what();
-      rpc_status_ = client.Reopen();
-      if (!rpc_status_.ok()) {
-        return rpc_status_;
-      }
-      client->TransmitData(res, params);
-    }
-    return Status(res.status);
-  } catch (TException& e) {
-    stringstream msg;
-    msg << "CloseChannel() to " << address_ << " failed:\n" << e.what();
-    return Status(msg.str());
-  }
-  return Status::OK;
+  VLOG_RPC << "sending eos to close channel";
+  Transmit(NULL, true);
+  return GetSendStatus();
 }
 
 void DataStreamSender::Channel::Close(RuntimeState* state) {
   Status s = CloseInternal();
   if (!s.ok()) state->LogError(s.msg());
-  rpc_thread_.DrainAndShutdown();
-  batch_.reset();
+  WaitForRpc();
+  parent_->mem_tracker_->Release(tracked_bytes_);
+  tracked_bytes_ = 0;
 }
 
 DataStreamSender::DataStreamSender(ObjectPool* pool, int sender_id,
@@ -339,11 +448,27 @@ DataStreamSender::DataStreamSender(ObjectPool* pool, int sender_id,
     pool_(pool),
     row_desc_(row_desc),
     current_channel_idx_(0),
+    num_random_channels_(destinations.size()),
+    adaptive_join_node_id_(-1),
+    is_adaptive_build_(false),
+    awaiting_exchange_mode_(false),
+    buffered_rows_(0),
+    buffered_bytes_(0),
     closed_(false),
     current_thrift_batch_(&thrift_batch1_),
+    hash_row_fn_(NULL),
+    compression_codec_(THdfsCompression::LZ4),
+    adaptive_compression_(false),
+    num_compressed_batches_(0),
+    num_batches_since_compression_(0),
+    compression_time_ns_(0),
+    compression_saved_bytes_(0),
     profile_(NULL),
     serialize_batch_timer_(NULL),
+    hash_partition_timer_(NULL),
     thrift_transmit_timer_(NULL),
+    credit_wait_timer_(NULL),
+    exchange_mode_wait_timer_(NULL),
     bytes_sent_counter_(NULL),
     dest_node_id_(sink.dest_node_id) {
   DCHECK_GT(destinations.size(), 0);
@@ -352,6 +477,12 @@ DataStreamSender::DataStreamSender(ObjectPool* pool, int sender_id,
       || sink.output_partition.type == TPartitionType::RANDOM);
   broadcast_ = sink.output_partition.type == TPartitionType::UNPARTITIONED;
   random_ = sink.output_partition.type == TPartitionType::RANDOM;
+  if (sink.__isset.adaptive_join_node_id) {
+    DCHECK_EQ(sink.output_partition.type, TPartitionType::HASH_PARTITIONED);
+    adaptive_join_node_id_ = sink.adaptive_join_node_id;
+    is_adaptive_build_ = sink.adaptive_exchange_role == TAdaptiveExchangeRole::BUILD;
+    awaiting_exchange_mode_ = true;
+  }
   // TODO: use something like google3's linked_ptr here (scoped_ptr isn't copyable)
   for (int i = 0; i < destinations.size(); ++i) {
     channels_.push_back(
@@ -381,6 +512,9 @@ DataStreamSender::~DataStreamSender() {
   for (int i = 0; i < channels_.size(); ++i) {
     delete channels_[i];
   }
+  for (int i = 0; i < buffered_batches_.size(); ++i) {
+    delete buffered_batches_[i];
+  }
 }
 
 Status DataStreamSender::Prepare(RuntimeState* state) {
@@ -393,6 +527,20 @@ Status DataStreamSender::Prepare(RuntimeState* state) {
 
   mem_tracker_.reset(new MemTracker(profile(), -1, -1, "DataStreamSender",
       state->instance_mem_tracker()));
+  if (FLAGS_exchange_compression_codec == "lz4") {
+    compression_codec_ = THdfsCompression::LZ4;
+  } else if (FLAGS_exchange_compression_codec == "snappy") {
+    compression_codec_ = THdfsCompression::SNAPPY;
+  } else if (FLAGS_exchange_compression_codec == "none") {
+    compression_codec_ = THdfsCompression::NONE;
+  } else if (FLAGS_exchange_compression_codec == "auto") {
+    compression_codec_ = THdfsCompression::LZ4;
+    adaptive_compression_ = true;
+  } else {
+    stringstream msg;
+    msg << "Invalid --exchange_compression_codec: " << FLAGS_exchange_compression_codec;
+    return Status(msg.str());
+  }
   RETURN_IF_ERROR(
       Expr::Prepare(partition_expr_ctxs_, state, row_desc_, mem_tracker_.get()));
 
@@ -402,7 +550,12 @@ Status DataStreamSender::Prepare(RuntimeState* state) {
       ADD_COUNTER(profile(), "UncompressedRowBatchSize", TUnit::BYTES);
   serialize_batch_timer_ =
       ADD_TIMER(profile(), "SerializeBatchTime");
+  hash_partition_timer_ = ADD_TIMER(profile(), "HashPartitionTime");
   thrift_transmit_timer_ = ADD_TIMER(profile(), "ThriftTransmitTime(*)");
+  credit_wait_timer_ = ADD_TIMER(profile(), "CreditWaitTime");
+  if (adaptive_join_node_id_ != -1) {
+    exchange_mode_wait_timer_ = ADD_TIMER(profile(), "AdaptiveExchangeWaitTime");
+  }
   network_throughput_ =
       profile()->AddDerivedCounter("NetworkThroughput(*)", TUnit::BYTES_PER_SECOND,
           bind<int64_t>(&RuntimeProfile::UnitsPerSecond, bytes_sent_counter_,
@@ -415,6 +568,16 @@ Status DataStreamSender::Prepare(RuntimeState* state) {
   for (int i = 0; i < channels_.size(); ++i) {
     RETURN_IF_ERROR(channels_[i]->Init(state));
   }
+
+  if (!partition_expr_ctxs_.empty() && state->codegen_enabled()) {
+    LlvmCodeGen* codegen;
+    RETURN_IF_ERROR(state->GetCodegen(&codegen));
+    Function* hash_row_fn = CodegenHashRow(state);
+    if (hash_row_fn != NULL) {
+      codegen->AddFunctionToJit(hash_row_fn, reinterpret_cast<void**>(&hash_row_fn_));
+      profile()->AddInfoString("ExecOption", "Codegen Enabled");
+    }
+  }
   return Status::OK;
 }
 
@@ -428,7 +591,97 @@ Status DataStreamSender::Send(RuntimeState* state, RowBatch* batch, bool eos) {
   RETURN_IF_ERROR(state->CheckQueryState());
   DCHECK(!closed_);
 
+  if (awaiting_exchange_mode_) {
+    RETURN_IF_ERROR(UpdateExchangeMode(state, batch, eos));
+    if (awaiting_exchange_mode_) return Status::OK;
+    if (is_adaptive_build_) {
+      // 'batch' was buffered as well.
+      for (int i = 0; i < buffered_batches_.size(); ++i) {
+        RETURN_IF_ERROR(SendToChannels(buffered_batches_[i]));
+        delete buffered_batches_[i];
+        buffered_batches_[i] = NULL;
+      }
+      buffered_batches_.clear();
+      return Status::OK;
+    }
+  }
+
   if (batch->num_rows() == 0) return Status::OK;
+  return SendToChannels(batch);
+}
+
+Status DataStreamSender::UpdateExchangeMode(RuntimeState* state, RowBatch* batch,
+    bool eos) {
+  bool broadcast;
+  if (!is_adaptive_build_) {
+    SCOPED_TIMER(exchange_mode_wait_timer_);
+    RETURN_IF_ERROR(state->WaitForExchangeMode(adaptive_join_node_id_, &broadcast));
+    SetExchangeMode(state, broadcast);
+    return Status::OK;
+  }
+
+  if (batch->num_rows() > 0) {
+    // The caller reuses 'batch', so the rows are copied. Serializing the batch copies
+    // them and measures their size at the same time.
+    TRowBatch thrift_batch;
+    {
+      SCOPED_TIMER(serialize_batch_timer_);
+      buffered_bytes_ += batch->Serialize(&thrift_batch, THdfsCompression::NONE);
+    }
+    buffered_rows_ += batch->num_rows();
+    buffered_batches_.push_back(
+        new RowBatch(row_desc_, &thrift_batch, mem_tracker_.get()));
+  }
+
+  bool too_large = buffered_bytes_ > FLAGS_adaptive_join_max_broadcast_bytes;
+  if (!too_large && !eos) {
+    // The join may have been partitioned because of another instance's build side.
+    if (state->GetExchangeMode(adaptive_join_node_id_, &broadcast)) {
+      SetExchangeMode(state, broadcast);
+    }
+    return Status::OK;
+  }
+
+  RETURN_IF_ERROR(state->UpdateBuildSize(adaptive_join_node_id_, buffered_bytes_,
+      buffered_rows_, !too_large));
+  if (too_large) {
+    // The coordinator partitions the join as soon as it gets an incomplete build side,
+    // so there is no need to wait for the decision.
+    SetExchangeMode(state, false);
+    return Status::OK;
+  }
+  SCOPED_TIMER(exchange_mode_wait_timer_);
+  RETURN_IF_ERROR(state->WaitForExchangeMode(adaptive_join_node_id_, &broadcast));
+  SetExchangeMode(state, broadcast);
+  return Status::OK;
+}
+
+void DataStreamSender::SetExchangeMode(RuntimeState* state, bool broadcast) {
+  DCHECK(awaiting_exchange_mode_);
+  awaiting_exchange_mode_ = false;
+  profile()->AddInfoString("AdaptiveExchangeMode",
+      broadcast ? "BROADCAST" : "PARTITIONED");
+  // Otherwise, the sender stays hash partitioned.
+  if (!broadcast) return;
+  if (is_adaptive_build_) {
+    broadcast_ = true;
+    return;
+  }
+  // Every instance of a broadcast join has the whole build side, so the probe rows can
+  // go to any of them. Prefer the ones on this host to not send the rows over the
+  // network.
+  random_ = true;
+  const TNetworkAddress& backend_address = state->exec_env()->backend_address();
+  int num_local_channels = 0;
+  for (int i = 0; i < channels_.size(); ++i) {
+    if (channels_[i]->address() == backend_address) {
+      std::swap(channels_[i], channels_[num_local_channels++]);
+    }
+  }
+  if (num_local_channels > 0) num_random_channels_ = num_local_channels;
+}
+
+Status DataStreamSender::SendToChannels(RowBatch* batch) {
   if (broadcast_ || channels_.size() == 1) {
     // current_thrift_batch_ is *not* the one that was written by the last call
     // to Serialize()
@@ -446,31 +699,199 @@ Status DataStreamSender::Send(RuntimeState* state, RowBatch* batch, bool eos) {
     Channel* current_channel = channels_[current_channel_idx_];
     current_channel->WaitForRpc();
     SerializeBatch(batch, current_channel->thrift_batch());
-    current_channel->SendBatch(current_channel->thrift_batch());
-    current_channel_idx_ = (current_channel_idx_ + 1) % channels_.size();
+    RETURN_IF_ERROR(current_channel->SendBatch(current_channel->thrift_batch()));
+    current_channel_idx_ = (current_channel_idx_ + 1) % num_random_channels_;
   } else {
-    // hash-partition batch's rows across channels
-    int num_channels = channels_.size();
-    for (int i = 0; i < batch->num_rows(); ++i) {
-      TupleRow* row = batch->GetRow(i);
-      uint32_t hash_val = HashUtil::FNV_SEED;
-      for (int i = 0; i < partition_expr_ctxs_.size(); ++i) {
-        ExprContext* ctx = partition_expr_ctxs_[i];
-        void* partition_val = ctx->GetValue(row);
-        // We can't use the crc hash function here because it does not result
-        // in uncorrelated hashes with different seeds.  Instead we must use
-        // fnv hash.
-        // TODO: fix crc hash/GetHashValue()
-        hash_val =
-            RawValue::GetHashValueFnv(partition_val, ctx->root()->type(), hash_val);
-      }
+    RETURN_IF_ERROR(HashPartitionBatch(batch));
+  }
+  return Status::OK;
+}
 
-      RETURN_IF_ERROR(channels_[hash_val % num_channels]->AddRow(row));
+Status DataStreamSender::HashPartitionBatch(RowBatch* batch) {
+  int num_rows = batch->num_rows();
+  int num_channels = channels_.size();
+  if (row_channels_.size() < num_rows) {
+    row_channels_.resize(num_rows);
+    partitioned_rows_.resize(num_rows);
+  }
+  channel_offsets_.assign(num_channels + 1, 0);
+  {
+    SCOPED_TIMER(hash_partition_timer_);
+    int* row_channels = &row_channels_[0];
+    // Count the rows per channel in channel_offsets_[channel + 1].
+    int* channel_counts = &channel_offsets_[1];
+    if (hash_row_fn_ != NULL) {
+      for (int i = 0; i < num_rows; ++i) {
+        row_channels[i] = hash_row_fn_(batch->GetRow(i)) % num_channels;
+        ++channel_counts[row_channels[i]];
+      }
+    } else {
+      for (int i = 0; i < num_rows; ++i) {
+        row_channels[i] = HashRow(batch->GetRow(i)) % num_channels;
+        ++channel_counts[row_channels[i]];
+      }
     }
+    // Group the row indexes by channel, keeping the order of the rows within a channel.
+    for (int i = 0; i < num_channels; ++i) channel_offsets_[i + 1] += channel_offsets_[i];
+    vector<int> next(channel_offsets_.begin(), channel_offsets_.end() - 1);
+    int* partitioned_rows = &partitioned_rows_[0];
+    for (int i = 0; i < num_rows; ++i) partitioned_rows[next[row_channels[i]]++] = i;
+  }
+
+  for (int i = 0; i < num_channels; ++i) {
+    int channel_rows = channel_offsets_[i + 1] - channel_offsets_[i];
+    if (channel_rows == 0) continue;
+    RETURN_IF_ERROR(channels_[i]->AddRows(
+        batch, &partitioned_rows_[channel_offsets_[i]], channel_rows));
   }
   return Status::OK;
 }
 
+uint32_t DataStreamSender::HashRow(TupleRow* row) {
+  uint32_t hash_val = HashUtil::FNV_SEED;
+  for (int i = 0; i < partition_expr_ctxs_.size(); ++i) {
+    ExprContext* ctx = partition_expr_ctxs_[i];
+    void* partition_val = ctx->GetValue(row);
+    // We can't use the crc hash function here because it does not result
+    // in uncorrelated hashes with different seeds.  Instead we must use
+    // fnv hash.
+    // TODO: fix crc hash/GetHashValue()
+    hash_val = RawValue::GetHashValueFnv(partition_val, ctx->root()->type(), hash_val);
+  }
+  return hash_val;
+}
+
+// Emits RawValue::HashCombine32(value, seed), which GetHashValueFnv() uses for NULLs and
+// booleans.
+static Value* CodegenHashCombine32(LlvmCodeGen* codegen,
+    LlvmCodeGen::LlvmBuilder* builder, Value* value, Value* seed) {
+  // The magic number is RawValue::HASH32_COMBINE_SEED.
+  Value* result = builder->CreateAdd(
+      codegen->GetIntConstant(TYPE_INT, 0x9e3779b9), value);
+  result = builder->CreateAdd(result, builder->CreateShl(seed, 6));
+  result = builder->CreateAdd(result, builder->CreateLShr(seed, 2));
+  return builder->CreateXor(seed, result, "hash");
+}
+
+// Codegen for HashRow(). For partition exprs (int_col, string_col), the IR looks like:
+// define i32 @HashRow(%"class.impala::TupleRow"* %row) {
+// entry:
+//   %native_val = alloca i32
+//   %result = call i64 @GetSlotRef(%"class.impala::ExprContext"* inttoptr
+//       (i64 88120576 to %"class.impala::ExprContext"*), %"class.impala::TupleRow"* %row)
+//   %is_null = trunc i64 %result to i1
+//   br i1 %is_null, label %null, label %not_null
+//
+// null:                                             ; preds = %entry
+//   br label %continue
+//
+// not_null:                                         ; preds = %entry
+//   %0 = ashr i64 %result, 32
+//   %1 = trunc i64 %0 to i32
+//   store i32 %1, i32* %native_val
+//   %2 = bitcast i32* %native_val to i8*
+//   %hash = call i32 @IrFnvHash(i8* %2, i32 4, i32 -2128831035)
+//   br label %continue
+//
+// continue:                                         ; preds = %not_null, %null
+//   %hash_phi = phi i32 [ -2068148305, %null ], [ %hash, %not_null ]
+//   %result2 = call { i64, i8* } @GetSlotRef1(%"class.impala::ExprContext"* inttoptr
+//       (i64 88120768 to %"class.impala::ExprContext"*), %"class.impala::TupleRow"* %row)
+//   ...
+// null3:                                            ; preds = %continue
+//   %3 = shl i32 %hash_phi, 6
+//   ...
+//   %hash4 = xor i32 %hash_phi, %6
+//   br label %continue5
+//
+// not_null4:                                        ; preds = %continue
+//   ...
+//   %hash6 = call i32 @IrFnvHash1(i8* %result5, i32 %len, i32 %hash_phi)
+//   br label %continue5
+//
+// continue5:                                        ; preds = %not_null4, %null3
+//   %hash_phi7 = phi i32 [ %hash4, %null3 ], [ %hash6, %not_null4 ]
+//   ret i32 %hash_phi7
+// }
+Function* DataStreamSender::CodegenHashRow(RuntimeState* state) {
+  for (int i = 0; i < partition_expr_ctxs_.size(); ++i) {
+    // Disable codegen for CHAR
+    if (partition_expr_ctxs_[i]->root()->type().type == TYPE_CHAR) return NULL;
+  }
+
+  LlvmCodeGen* codegen;
+  if (!state->GetCodegen(&codegen).ok()) return NULL;
+
+  PointerType* tuple_row_ptr_type = codegen->GetPtrType(TupleRow::LLVM_CLASS_NAME);
+  LlvmCodeGen::FnPrototype prototype(codegen, "HashRow", codegen->GetType(TYPE_INT));
+  prototype.AddArgument(LlvmCodeGen::NamedVariable("row", tuple_row_ptr_type));
+
+  LLVMContext& context = codegen->context();
+  LlvmCodeGen::LlvmBuilder builder(context);
+  Value* row;
+  Function* fn = prototype.GeneratePrototype(&builder, &row);
+
+  Value* hash_val = codegen->GetIntConstant(TYPE_INT, HashUtil::FNV_SEED);
+  for (int i = 0; i < partition_expr_ctxs_.size(); ++i) {
+    ExprContext* ctx = partition_expr_ctxs_[i];
+    const ColumnType& type = ctx->root()->type();
+    Function* expr_fn;
+    Status status = ctx->root()->GetCodegendComputeFn(state, &expr_fn);
+    if (!status.ok()) {
+      VLOG_QUERY << "Problem with CodegenHashRow: " << status.GetDetail();
+      fn->eraseFromParent(); // deletes function
+      return NULL;
+    }
+
+    BasicBlock* null_block = BasicBlock::Create(context, "null", fn);
+    BasicBlock* not_null_block = BasicBlock::Create(context, "not_null", fn);
+    BasicBlock* continue_block = BasicBlock::Create(context, "continue", fn);
+
+    Value* ctx_arg = codegen->CastPtrToLlvmPtr(
+        codegen->GetPtrType(ExprContext::LLVM_CLASS_NAME), ctx);
+    Value* expr_fn_args[] = { ctx_arg, row };
+    CodegenAnyVal result = CodegenAnyVal::CreateCallWrapped(
+        codegen, &builder, type, expr_fn, expr_fn_args, "result");
+    builder.CreateCondBr(result.GetIsNull(), null_block, not_null_block);
+
+    // NULLs are hashed like RawValue::GetHashValueFnv(NULL, type, hash_val).
+    builder.SetInsertPoint(null_block);
+    Value* null_hash_val = CodegenHashCombine32(
+        codegen, &builder, codegen->GetIntConstant(TYPE_INT, 0), hash_val);
+    builder.CreateBr(continue_block);
+
+    builder.SetInsertPoint(not_null_block);
+    Value* not_null_hash_val;
+    if (type.type == TYPE_STRING || type.type == TYPE_VARCHAR) {
+      Function* hash_fn = codegen->GetFnvHashFunction();
+      not_null_hash_val = builder.CreateCall3(
+          hash_fn, result.GetPtr(), result.GetLen(), hash_val, "hash");
+    } else if (type.type == TYPE_BOOLEAN) {
+      Value* val = builder.CreateZExt(result.GetVal(), codegen->GetType(TYPE_INT));
+      not_null_hash_val = CodegenHashCombine32(codegen, &builder, val, hash_val);
+    } else {
+      // Hash the bytes of the native value, like GetHashValueFnv() does.
+      Value* native_ptr = codegen->CreateEntryBlockAlloca(
+          builder, codegen->GetType(type), "native_val");
+      result.ToNativePtr(native_ptr);
+      int num_bytes = type.type == TYPE_TIMESTAMP ? 12 : type.GetByteSize();
+      Function* hash_fn = codegen->GetFnvHashFunction(num_bytes);
+      Value* data = builder.CreateBitCast(native_ptr, codegen->ptr_type());
+      not_null_hash_val = builder.CreateCall3(hash_fn, data,
+          codegen->GetIntConstant(TYPE_INT, num_bytes), hash_val, "hash");
+    }
+    builder.CreateBr(continue_block);
+
+    builder.SetInsertPoint(continue_block);
+    PHINode* hash_phi = builder.CreatePHI(codegen->GetType(TYPE_INT), 2, "hash_phi");
+    hash_phi->addIncoming(null_hash_val, null_block);
+    hash_phi->addIncoming(not_null_hash_val, not_null_block);
+    hash_val = hash_phi;
+  }
+  builder.CreateRet(hash_val);
+  return codegen->FinalizeFunction(fn);
+}
+
 void DataStreamSender::Close(RuntimeState* state) {
   if (closed_) return;
   for (int i = 0; i < channels_.size(); ++i) {
@@ -484,12 +905,34 @@ void DataStreamSender::SerializeBatch(RowBatch* src, TRowBatch* dest, int num_re
   VLOG_ROW << "serializing " << src->num_rows() << " rows";
   {
     SCOPED_TIMER(serialize_batch_timer_);
-    int uncompressed_bytes = src->Serialize(dest);
+    int uncompressed_bytes = src->Serialize(dest, THdfsCompression::NONE);
+    CompressBatch(dest, &compression_scratch_);
     COUNTER_ADD(bytes_sent_counter_, RowBatch::GetBatchSize(*dest) * num_receivers);
     COUNTER_ADD(uncompressed_bytes_counter_, uncompressed_bytes * num_receivers);
   }
 }
 
+void DataStreamSender::CompressBatch(TRowBatch* batch, string* compression_scratch) {
+  batch->uncompressed_size = batch->tuple_data.size();
+  if (compression_codec_ == THdfsCompression::NONE) return;
+  if (adaptive_compression_ && num_compressed_batches_ >= MIN_COMPRESSED_BATCHES &&
+      ++num_batches_since_compression_ < COMPRESSION_PROBE_INTERVAL) {
+    // Compress if the network time the compression saved so far is larger than the
+    // time spent compressing. The network time per byte is the average of all rpcs.
+    int64_t bytes_sent = bytes_sent_counter_->value();
+    double network_ns_per_byte = bytes_sent == 0 ? 0 :
+        thrift_transmit_timer_->value() / static_cast<double>(bytes_sent);
+    if (compression_time_ns_ >= compression_saved_bytes_ * network_ns_per_byte) return;
+  }
+  MonotonicStopWatch timer;
+  timer.Start();
+  RowBatch::CompressTupleData(compression_codec_, batch, compression_scratch);
+  compression_time_ns_ += timer.ElapsedTime();
+  compression_saved_bytes_ += batch->uncompressed_size - batch->tuple_data.size();
+  ++num_compressed_batches_;
+  num_batches_since_compression_ = 0;
+}
+
 int64_t DataStreamSender::GetNumDataBytesSent() const {
   // TODO: do we need synchronization here or are reads & writes to 8-byte ints
   // atomic?
@@ -26,6 +26,10 @@
 #include "util/runtime-profile.h"
 #include "gen-cpp/Results_types.h" // for TRowBatch
 
+namespace llvm {
+  class Function;
+}
+
 namespace impala {
 
 class Expr;
@@ -35,10 +39,22 @@ class MemTracker;
 class TDataStreamSink;
 class TNetworkAddress;
 class TPlanFragmentDestination;
+class TupleRow;
 
 // Single sender of an m:n data stream.
 // Row batch data is routed to destinations based on the provided
 // partitioning specification.
+// Hash-partitioned batches are processed a batch at a time: the partition exprs of all
+// rows are hashed into an array of channel indexes (with a codegen'd hash function if
+// possible), the row indexes are grouped by channel and then each channel serializes
+// its rows directly into its outgoing TRowBatch.
+// A sender of an adaptive join exchange (see TDataStreamSink.adaptive_join_node_id)
+// does not send anything before the coordinator decided whether the join is broadcast.
+// The sender of the build side buffers its rows until then. It reports the size of its
+// build side to the coordinator once it has all rows, or as soon as it has more than
+// --adaptive_join_max_broadcast_bytes, in which case it starts hash partitioning right
+// away. The sender of the probe side waits for the decision before sending its first
+// batch.
 // *Not* thread-safe.
 //
 // TODO: capture stats that describe distribution of rows/data volume
@@ -71,7 +87,8 @@ class DataStreamSender : public DataSink {
   // specification provided in c'tor.
   // Blocks until all rows in batch are placed in their appropriate outgoing
   // buffers (ie, blocks if there are still in-flight rpcs from the last
-  // Send() call).
+  // Send() call). The last batch must be sent with 'eos' set, which an adaptive
+  // exchange relies on to flush its buffered rows.
   virtual Status Send(RuntimeState* state, RowBatch* batch, bool eos);
 
   // Flush all buffered data and close all existing channels to destination
@@ -83,6 +100,12 @@ class DataStreamSender : public DataSink {
   // used to maintain metrics.
   void SerializeBatch(RowBatch* src, TRowBatch* dest, int num_receivers = 1);
 
+  // Compresses the uncompressed tuple data of 'batch' with the codec chosen by
+  // --exchange_compression_codec and sets its uncompressed_size. With 'auto', the tuple
+  // data is only compressed while compressing takes less time than sending the bytes
+  // it saves would take. 'compression_scratch' is swapped with the tuple data.
+  void CompressBatch(TRowBatch* batch, std::string* compression_scratch);
+
   // Return total number of bytes sent in TRowBatch.data. If batches are
   // broadcast to multiple receivers, they are counted once per receiver.
   int64_t GetNumDataBytesSent() const;
@@ -92,6 +115,34 @@ class DataStreamSender : public DataSink {
  private:
   class Channel;
 
+  // Hashes the values of partition_expr_ctxs_ for 'row'. The hash must not depend on
+  // whether it was codegen'd, since different senders of the same stream may differ.
+  typedef uint32_t (*HashRowFn)(TupleRow* row);
+
+  // Interpreted version of HashRowFn.
+  uint32_t HashRow(TupleRow* row);
+
+  // Codegen for HashRow(). The partition exprs are baked into the function. Returns
+  // NULL if codegen is not possible.
+  llvm::Function* CodegenHashRow(RuntimeState* state);
+
+  // Hash-partitions the rows of 'batch' across channels_ and adds each channel's rows
+  // to it.
+  Status HashPartitionBatch(RowBatch* batch);
+
+  // Sends the rows of 'batch' according to the partitioning.
+  Status SendToChannels(RowBatch* batch);
+
+  // Called by Send() while awaiting_exchange_mode_ is true. The build side sender
+  // buffers 'batch' and reports the build side size if necessary, the probe side sender
+  // waits for the mode. Calls SetExchangeMode() once the mode is known.
+  Status UpdateExchangeMode(RuntimeState* state, RowBatch* batch, bool eos);
+
+  // Switches an adaptive exchange to its final mode: broadcast (the build side is sent
+  // to all channels, the probe side round-robin to the channels on this host) or hash
+  // partitioned.
+  void SetExchangeMode(RuntimeState* state, bool broadcast);
+
   // Sender instance id, unique within a fragment.
   int sender_id_;
   RuntimeState* state_;
@@ -101,6 +152,23 @@ class DataStreamSender : public DataSink {
   bool random_; // if true, round-robins row batches among channels
   int current_channel_idx_; // index of current channel to send to if random_ == true
 
+  // Number of channels at the front of channels_ that random_ round-robins among.
+  int num_random_channels_;
+
+  // Join of the adaptive exchange this sender belongs to, -1 if it does not belong to
+  // one, and whether it sends the build side.
+  PlanNodeId adaptive_join_node_id_;
+  bool is_adaptive_build_;
+
+  // True while the mode of the adaptive exchange is not known yet.
+  bool awaiting_exchange_mode_;
+
+  // Build side batches that were buffered while awaiting_exchange_mode_ was true, and
+  // their total number of rows and serialized bytes. The batches are owned.
+  std::vector<RowBatch*> buffered_batches_;
+  int64_t buffered_rows_;
+  int64_t buffered_bytes_;
+
   // If true, this sender has been closed. Not valid to call Send() anymore.
   bool closed_;
 
@@ -110,17 +178,50 @@ class DataStreamSender : public DataSink {
   TRowBatch thrift_batch2_;
   TRowBatch* current_thrift_batch_;  // the next one to fill in Send()
 
+  // Scratch buffer for compressing the batches serialized by SerializeBatch().
+  std::string compression_scratch_;
+
+  // Codec to compress tuple data with, NONE to not compress.
+  THdfsCompression::type compression_codec_;
+
+  // If true, compression_codec_ is only used while compression pays off. See
+  // CompressBatch().
+  bool adaptive_compression_;
+
+  // Statistics of the batches compressed by CompressBatch(): their number, the number of
+  // batches that were not compressed since the last one that was, the total time spent
+  // compressing and the number of bytes compression saved.
+  int num_compressed_batches_;
+  int num_batches_since_compression_;
+  int64_t compression_time_ns_;
+  int64_t compression_saved_bytes_;
+
   std::vector<ExprContext*> partition_expr_ctxs_;  // compute per-row partition values
   std::vector<Channel*> channels_;
 
+  // Codegen'd HashRow(), NULL if not codegen'd.
+  HashRowFn hash_row_fn_;
+
+  // Scratch arrays of HashPartitionBatch(), sized to the largest batch seen:
+  // the channel index of every row, the row indexes grouped by channel and the start of
+  // each channel's group in 'partitioned_rows_' (with one extra entry for the end).
+  std::vector<int> row_channels_;
+  std::vector<int> partitioned_rows_;
+  std::vector<int> channel_offsets_;
+
   RuntimeProfile* profile_; // Allocated from pool_
   RuntimeProfile::Counter* serialize_batch_timer_;
+  RuntimeProfile::Counter* hash_partition_timer_;
   RuntimeProfile::Counter* thrift_transmit_timer_;
+  // Time spent waiting for receivers to grant credit.
+  RuntimeProfile::Counter* credit_wait_timer_;
+  // Time spent waiting for the mode of an adaptive exchange.
+  RuntimeProfile::Counter* exchange_mode_wait_timer_;
   RuntimeProfile::Counter* bytes_sent_counter_;
   RuntimeProfile::Counter* uncompressed_bytes_counter_;
   boost::scoped_ptr<MemTracker> mem_tracker_;
 
-  // Throughput per time spent in TransmitData
+  // Throughput per time spent in sending requests
   RuntimeProfile::Counter* network_throughput_;
 
   // Throughput per total time spent in sender
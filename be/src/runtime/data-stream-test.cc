@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
 #include <gtest/gtest.h>
 
@@ -19,6 +20,7 @@
 #include "common/logging.h"
 #include "common/status.h"
 #include "codegen/llvm-codegen.h"
+#include "gutil/strings/substitute.h"
 #include "exprs/slot-ref.h"
 #include "rpc/auth-provider.h"
 #include "rpc/thrift-server.h"
@@ -37,6 +39,9 @@
 #include "util/thread.h"
 #include "util/time.h"
 #include "util/mem-info.h"
+#include "util/network-util.h"
+#include "util/pretty-printer.h"
+#include "util/stopwatch.h"
 #include "util/test-info.h"
 #include "util/tuple-row-compare.h"
 #include "gen-cpp/ImpalaInternalService.h"
@@ -46,6 +51,7 @@
 #include "service/fe-support.h"
 
 #include <iostream>
+#include <limits>
 
 using namespace std;
 using namespace tr1;
@@ -54,9 +60,15 @@ using namespace boost;
 using namespace impala;
 using namespace apache::thrift;
 using namespace apache::thrift::protocol;
+using namespace strings;
 
 DEFINE_int32(port, 20001, "port on which to run Impala test backend");
 DECLARE_string(principal);
+DECLARE_string(exchange_compression_codec);
+DECLARE_int32(exchange_merge_group_size);
+DECLARE_int64(adaptive_join_max_broadcast_bytes);
+DECLARE_string(hostname);
+DECLARE_int32(be_port);
 
 namespace impala {
 
@@ -78,13 +90,52 @@ class ImpalaTestBackend : public ImpalaInternalServiceIf {
       TTransmitDataResult& return_val, const TTransmitDataParams& params) {
     if (!params.eos) {
       mgr_->AddData(params.dest_fragment_instance_id, params.dest_node_id,
-                    params.row_batch, params.sender_id).SetTStatus(&return_val);
+                    const_cast<TRowBatch*>(&params.row_batch),
+                    params.sender_id).SetTStatus(&return_val);
     } else {
       mgr_->CloseSender(params.dest_fragment_instance_id, params.dest_node_id,
           params.sender_id).SetTStatus(&return_val);
     }
   }
 
+  virtual void TransmitDataBatch(
+      TTransmitDataBatchResult& return_val, const TTransmitDataBatchParams& params) {
+    return_val.__isset.results = true;
+    return_val.results.resize(params.requests.size());
+    for (int i = 0; i < params.requests.size(); ++i) {
+      const TTransmitDataParams& request = params.requests[i];
+      TTransmitDataResult& result = return_val.results[i];
+      if (!request.eos) {
+        TRowBatch* row_batch = request.row_batch.num_rows > 0 ?
+            const_cast<TRowBatch*>(&request.row_batch) : NULL;
+        int64_t credit = numeric_limits<int64_t>::max();
+        mgr_->AddDataWithCredit(request.dest_fragment_instance_id,
+            request.dest_node_id, row_batch, request.sender_id,
+            &credit).SetTStatus(&result);
+        result.__set_credit(credit);
+      } else {
+        mgr_->CloseSender(request.dest_fragment_instance_id, request.dest_node_id,
+            request.sender_id).SetTStatus(&result);
+      }
+    }
+  }
+
+  virtual void UpdateFilter(
+      TUpdateFilterResult& return_val, const TUpdateFilterParams& params) {}
+
+  virtual void PublishFilter(
+      TPublishFilterResult& return_val, const TPublishFilterParams& params) {}
+
+  virtual void UpdateBuildSize(
+      TUpdateBuildSizeResult& return_val, const TUpdateBuildSizeParams& params) {
+    lock_guard<mutex> l(lock_);
+    build_sizes_.push_back(params);
+    Status::OK.SetTStatus(&return_val);
+  }
+
+  virtual void PublishExchangeMode(TPublishExchangeModeResult& return_val,
+      const TPublishExchangeModeParams& params) {}
+
   virtual void ExecShortCommand(TRemoteShortCommandResult& _return, const TExecRemoteCommandParams& params){
 
   }
@@ -93,15 +144,28 @@ class ImpalaTestBackend : public ImpalaInternalServiceIf {
 
   }
 
+  // Returns the build sizes reported to this backend as coordinator and clears them.
+  vector<TUpdateBuildSizeParams> TakeBuildSizes() {
+    lock_guard<mutex> l(lock_);
+    vector<TUpdateBuildSizeParams> result;
+    result.swap(build_sizes_);
+    return result;
+  }
+
  private:
   DataStreamMgr* mgr_;
+
+  // Protects build_sizes_.
+  mutex lock_;
+  vector<TUpdateBuildSizeParams> build_sizes_;
 };
 
 class DataStreamTest : public testing::Test {
  protected:
   DataStreamTest()
     : runtime_state_(TPlanFragmentInstanceCtx(), "", &exec_env_),
-      next_val_(0) {
+      next_val_(0),
+      sender_codegen_(false) {
     // Initialize Mem trackers for use by the data stream receiver.
     exec_env_.InitForFeTests();
     runtime_state_.InitMemTrackers(TUniqueId(), NULL, -1);
@@ -198,8 +262,12 @@ class DataStreamTest : public testing::Test {
   // receiving node
   DataStreamMgr* stream_mgr_;
   ThriftServer* server_;
+  // The handler of server_. Owned by server_.
+  ImpalaTestBackend* backend_;
 
   // sending node(s)
+  // If true, the senders codegen their hash functions.
+  bool sender_codegen_;
   TDataStreamSink broadcast_sink_;
   TDataStreamSink random_sink_;
   TDataStreamSink hash_sink_;
@@ -209,8 +277,10 @@ class DataStreamTest : public testing::Test {
     thread* thread_handle;
     Status status;
     int num_bytes_sent;
+    // True if the sender used a codegen'd function.
+    bool codegen_used;
 
-    SenderInfo(): thread_handle(NULL), num_bytes_sent(0) {}
+    SenderInfo(): thread_handle(NULL), num_bytes_sent(0), codegen_used(false) {}
   };
   vector<SenderInfo> sender_info_;
 
@@ -221,6 +291,7 @@ class DataStreamTest : public testing::Test {
 
     thread* thread_handle;
     boost::shared_ptr<DataStreamRecvr> stream_recvr;
+    RuntimeProfile* profile;
     Status status;
     int num_rows_received;
     multiset<int64_t> data_values;
@@ -230,6 +301,7 @@ class DataStreamTest : public testing::Test {
         num_senders(num_senders),
         receiver_num(receiver_num),
         thread_handle(NULL),
+        profile(NULL),
         num_rows_received(0) {}
 
     ~ReceiverInfo() {
@@ -331,6 +403,7 @@ class DataStreamTest : public testing::Test {
     GetNextInstanceId(&instance_id);
     receiver_info_.push_back(ReceiverInfo(stream_type, num_senders, receiver_num));
     ReceiverInfo& info = receiver_info_.back();
+    info.profile = profile;
     info.stream_recvr =
         stream_mgr_->CreateRecvr(&runtime_state_,
             *row_desc_, instance_id, DEST_NODE_ID, num_senders, buffer_size, profile,
@@ -369,8 +442,37 @@ class DataStreamTest : public testing::Test {
     VLOG_QUERY << "done reading";
   }
 
+  // Adds 'num_batches' copies of 'thrift_batch' to each of the receivers of
+  // 'instance_ids' as sender 'sender_id' without rpcs, then closes the sender.
+  void AddDataToRecvrs(const vector<TUniqueId>* instance_ids,
+      const TRowBatch* thrift_batch, int num_batches, int sender_id) {
+    for (int i = 0; i < num_batches; ++i) {
+      for (int j = 0; j < instance_ids->size(); ++j) {
+        // The receiver takes over the tuple data of the batch.
+        TRowBatch batch_copy = *thrift_batch;
+        EXPECT_TRUE(stream_mgr_->AddData(
+            (*instance_ids)[j], DEST_NODE_ID, &batch_copy, sender_id).ok());
+      }
+    }
+    for (int j = 0; j < instance_ids->size(); ++j) {
+      EXPECT_TRUE(stream_mgr_->CloseSender(
+          (*instance_ids)[j], DEST_NODE_ID, sender_id).ok());
+    }
+  }
+
+  // Reads all batches of 'recvr' and counts their rows in 'num_rows'.
+  void DrainRecvr(DataStreamRecvr* recvr, int64_t* num_rows) {
+    RowBatch* batch;
+    while (recvr->GetBatch(&batch).ok() && batch != NULL) {
+      *num_rows += batch->num_rows();
+    }
+  }
+
   void ReadStreamMerging(ReceiverInfo* info, RuntimeProfile* profile) {
-    info->status = info->stream_recvr->CreateMerger(*less_than_);
+    // The SlotRefs of less_than_ can be evaluated by the pre-merge threads concurrently.
+    vector<TupleRowComparator> group_less_thans(
+        info->stream_recvr->num_merge_groups(), *less_than_);
+    info->status = info->stream_recvr->CreateMerger(*less_than_, group_less_thans);
     if (info->status.IsCancelled()) return;
     RowBatch batch(*row_desc_, 1024, &tracker_);
     VLOG_QUERY << "start reading merging";
@@ -445,6 +547,7 @@ class DataStreamTest : public testing::Test {
   // Start backend in separate thread.
   void StartBackend() {
     boost::shared_ptr<ImpalaTestBackend> handler(new ImpalaTestBackend(stream_mgr_));
+    backend_ = handler.get();
     boost::shared_ptr<TProcessor> processor(new ImpalaInternalServiceProcessor(handler));
     server_ = new ThriftServer("DataStreamTest backend", processor, FLAGS_port, NULL);
     server_->Start();
@@ -477,7 +580,10 @@ class DataStreamTest : public testing::Test {
 
   void Sender(int sender_num, int channel_buffer_size,
               TPartitionType::type partition_type) {
-    RuntimeState state(TPlanFragmentInstanceCtx(), "", &exec_env_);
+    TPlanFragmentInstanceCtx fragment_instance_ctx;
+    fragment_instance_ctx.query_ctx.request.query_options.__set_disable_codegen(
+        !sender_codegen_);
+    RuntimeState state(fragment_instance_ctx, "", &exec_env_);
     state.set_desc_tbl(desc_tbl_);
     state.InitMemTrackers(TUniqueId(), NULL, -1);
     VLOG_QUERY << "create sender " << sender_num;
@@ -485,9 +591,17 @@ class DataStreamTest : public testing::Test {
     DataStreamSender sender(
         &obj_pool_, sender_num, *row_desc_, sink, dest_, channel_buffer_size);
     EXPECT_TRUE(sender.Prepare(&state).ok());
+    SenderInfo& info = sender_info_[sender_num];
+    if (state.codegen_created()) {
+      // Compile the module, like the fragment executor does after Prepare().
+      LlvmCodeGen* codegen;
+      EXPECT_TRUE(state.GetCodegen(&codegen, false).ok());
+      EXPECT_TRUE(codegen->FinalizeModule().ok());
+    }
+    const string* exec_option = sender.profile()->GetInfoString("ExecOption");
+    info.codegen_used = exec_option != NULL && *exec_option == "Codegen Enabled";
     EXPECT_TRUE(sender.Open(&state).ok());
     scoped_ptr<RowBatch> batch(CreateRowBatch());
-    SenderInfo& info = sender_info_[sender_num];
     int next_val = 0;
     for (int i = 0; i < NUM_BATCHES; ++i) {
       GetNextBatch(batch.get(), &next_val);
@@ -582,6 +696,345 @@ TEST_F(DataStreamTest, BasicTest) {
   }
 }
 
+// Uncompressed batches are taken over by the receiving row batches instead of being
+// copied, compressed ones are decompressed. Both must arrive intact with every codec.
+TEST_F(DataStreamTest, CompressionCodecs) {
+  const char* codecs[] = {"none", "snappy", "lz4", "auto"};
+  string default_codec = FLAGS_exchange_compression_codec;
+  for (int i = 0; i < sizeof(codecs) / sizeof(*codecs); ++i) {
+    FLAGS_exchange_compression_codec = codecs[i];
+    TestStream(TPartitionType::HASH_PARTITIONED, 4, 4, 1024, false);
+    TestStream(TPartitionType::UNPARTITIONED, 1, 4, 1024 * 1024, true);
+  }
+  FLAGS_exchange_compression_codec = default_codec;
+}
+
+// Checks the credit a receiver grants to its senders.
+TEST_F(DataStreamTest, ReceiverCredit) {
+  scoped_ptr<RowBatch> batch(CreateRowBatch());
+  int next_val = 0;
+  GetNextBatch(batch.get(), &next_val);
+  TRowBatch thrift_batch;
+  batch->Serialize(&thrift_batch, THdfsCompression::NONE);
+  int batch_size = RowBatch::GetBatchSize(thrift_batch);
+
+  // Two senders, each with a share of the buffer that fits one batch.
+  TUniqueId instance_id;
+  GetNextInstanceId(&instance_id);
+  RuntimeProfile* profile = obj_pool_.Add(new RuntimeProfile(&obj_pool_, "Receiver"));
+  boost::shared_ptr<DataStreamRecvr> recvr = stream_mgr_->CreateRecvr(&runtime_state_,
+      *row_desc_, instance_id, DEST_NODE_ID, 2, 2 * batch_size, profile, false);
+
+  int64_t credit = 0;
+  EXPECT_TRUE(stream_mgr_->AddDataWithCredit(
+      instance_id, DEST_NODE_ID, NULL, 0, &credit).ok());
+  EXPECT_EQ(credit, batch_size);
+  EXPECT_TRUE(stream_mgr_->AddDataWithCredit(
+      instance_id, DEST_NODE_ID, &thrift_batch, 0, &credit).ok());
+  EXPECT_LE(credit, 0);
+  // The other sender has nothing buffered and may still send.
+  EXPECT_TRUE(stream_mgr_->AddDataWithCredit(
+      instance_id, DEST_NODE_ID, NULL, 1, &credit).ok());
+  EXPECT_EQ(credit, batch_size);
+
+  // Consuming the batch gives the first sender its credit back.
+  RowBatch* received_batch;
+  EXPECT_TRUE(recvr->GetBatch(&received_batch).ok());
+  ASSERT_TRUE(received_batch != NULL);
+  EXPECT_EQ(received_batch->num_rows(), BATCH_CAPACITY);
+  EXPECT_TRUE(stream_mgr_->AddDataWithCredit(
+      instance_id, DEST_NODE_ID, NULL, 0, &credit).ok());
+  EXPECT_EQ(credit, batch_size);
+  recvr->Close();
+  batch->Reset();
+}
+
+// Hash-partitioned senders with and without a codegen'd hash function. Both must send
+// every row to the receiver that CheckReceivers() computes with the interpreted hash.
+TEST_F(DataStreamTest, HashPartitionCodegen) {
+  bool codegen[] = {true, false};
+  for (int i = 0; i < sizeof(codegen) / sizeof(bool); ++i) {
+    sender_codegen_ = codegen[i];
+    TestStream(TPartitionType::HASH_PARTITIONED, 4, 4, 1024, false);
+    for (int j = 0; j < sender_info_.size(); ++j) {
+      EXPECT_EQ(sender_info_[j].codegen_used, codegen[i]) << j;
+    }
+    TestStream(TPartitionType::HASH_PARTITIONED, 3, 5, 1024 * 1024, true);
+  }
+  sender_codegen_ = false;
+}
+
+// Merging receivers with more senders than --exchange_merge_group_size pre-merge groups
+// of senders in parallel. Groups of different sizes must merge correctly as well.
+TEST_F(DataStreamTest, ParallelMerge) {
+  int default_group_size = FLAGS_exchange_merge_group_size;
+  FLAGS_exchange_merge_group_size = 2;
+  TestStream(TPartitionType::UNPARTITIONED, 4, 1, 1024, true);
+  TestStream(TPartitionType::UNPARTITIONED, 5, 1, 1024 * 1024, true);
+  TestStream(TPartitionType::HASH_PARTITIONED, 4, 4, 1024, true);
+  FLAGS_exchange_merge_group_size = default_group_size;
+}
+
+// Merging receivers break the time spent waiting for senders down by sender, and by
+// merge group if the senders are pre-merged.
+TEST_F(DataStreamTest, SenderStallTimers) {
+  TestStream(TPartitionType::UNPARTITIONED, 3, 1, 1024, true);
+  RuntimeProfile* profile = receiver_info_[0].profile;
+  EXPECT_TRUE(profile->GetCounter("SenderStallTime") != NULL);
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(profile->GetCounter(Substitute("Sender$0StallTime", i)) != NULL) << i;
+  }
+  EXPECT_TRUE(profile->GetCounter("MergeGroup0StallTime") == NULL);
+
+  int default_group_size = FLAGS_exchange_merge_group_size;
+  FLAGS_exchange_merge_group_size = 2;
+  TestStream(TPartitionType::UNPARTITIONED, 4, 1, 1024, true);
+  profile = receiver_info_[0].profile;
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_TRUE(profile->GetCounter(Substitute("MergeGroup$0StallTime", i)) != NULL)
+        << i;
+  }
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_TRUE(profile->GetCounter(Substitute("Sender$0StallTime", i)) != NULL) << i;
+  }
+  FLAGS_exchange_merge_group_size = default_group_size;
+
+  // Receivers that don't merge have no stall timers.
+  TestStream(TPartitionType::UNPARTITIONED, 3, 1, 1024, false);
+  EXPECT_TRUE(receiver_info_[0].profile->GetCounter("SenderStallTime") == NULL);
+}
+
+// The sender of the build side of an adaptive join exchange sends nothing before the
+// mode is published, and then broadcasts the buffered and the remaining rows.
+TEST_F(DataStreamTest, AdaptiveBuildBroadcast) {
+  Reset();
+  for (int i = 0; i < 2; ++i) {
+    StartReceiver(TPartitionType::UNPARTITIONED, 1, i, 1024 * 1024, false);
+  }
+  TDataStreamSink sink = hash_sink_;
+  sink.__set_adaptive_join_node_id(DEST_NODE_ID);
+  sink.__set_adaptive_exchange_role(TAdaptiveExchangeRole::BUILD);
+  RuntimeState state(TPlanFragmentInstanceCtx(), "", &exec_env_);
+  state.set_desc_tbl(desc_tbl_);
+  state.InitMemTrackers(TUniqueId(), NULL, -1);
+  DataStreamSender sender(&obj_pool_, 0, *row_desc_, sink, dest_, 1024);
+  EXPECT_TRUE(sender.Prepare(&state).ok());
+  EXPECT_TRUE(sender.Open(&state).ok());
+
+  scoped_ptr<RowBatch> batch(CreateRowBatch());
+  int next_val = 0;
+  for (int i = 0; i < NUM_BATCHES - 1; ++i) {
+    GetNextBatch(batch.get(), &next_val);
+    EXPECT_TRUE(sender.Send(&state, batch.get(), false).ok());
+  }
+  EXPECT_EQ(sender.GetNumDataBytesSent(), 0);
+
+  // Publish the mode like the coordinator would. The sender notices it with the next
+  // batch, so it does not need to report its build side at eos.
+  TPublishExchangeModeParams params;
+  params.__set_join_node_id(DEST_NODE_ID);
+  params.__set_broadcast(true);
+  state.SetExchangeMode(params);
+  GetNextBatch(batch.get(), &next_val);
+  EXPECT_TRUE(sender.Send(&state, batch.get(), false).ok());
+  batch->Reset();
+  EXPECT_TRUE(sender.Send(&state, batch.get(), true).ok());
+  sender.Close(&state);
+  EXPECT_GT(sender.GetNumDataBytesSent(), 0);
+
+  JoinReceivers();
+  CheckReceivers(TPartitionType::UNPARTITIONED, 1);
+}
+
+// The sender of the build side of an adaptive join exchange keeps hash partitioning if
+// its own build side is too large to broadcast, which it reports to the coordinator,
+// or if the coordinator partitioned the join because of another instance.
+TEST_F(DataStreamTest, AdaptiveBuildPartitioned) {
+  TDataStreamSink sink = hash_sink_;
+  sink.__set_adaptive_join_node_id(DEST_NODE_ID);
+  sink.__set_adaptive_exchange_role(TAdaptiveExchangeRole::BUILD);
+  int64_t default_max_broadcast_bytes = FLAGS_adaptive_join_max_broadcast_bytes;
+  bool own_build_too_large[] = {true, false};
+  for (int i = 0; i < sizeof(own_build_too_large) / sizeof(bool); ++i) {
+    Reset();
+    for (int j = 0; j < 2; ++j) {
+      StartReceiver(TPartitionType::HASH_PARTITIONED, 1, j, 1024 * 1024, false);
+    }
+    // The test backend is the coordinator.
+    TPlanFragmentInstanceCtx fragment_instance_ctx;
+    fragment_instance_ctx.query_ctx.coord_address =
+        MakeNetworkAddress("127.0.0.1", FLAGS_port);
+    RuntimeState state(fragment_instance_ctx, "", &exec_env_);
+    state.set_desc_tbl(desc_tbl_);
+    state.InitMemTrackers(TUniqueId(), NULL, -1);
+    // The first batch is already too large.
+    if (own_build_too_large[i]) FLAGS_adaptive_join_max_broadcast_bytes = 1;
+    DataStreamSender sender(&obj_pool_, 0, *row_desc_, sink, dest_, 1024);
+    EXPECT_TRUE(sender.Prepare(&state).ok());
+    EXPECT_TRUE(sender.Open(&state).ok());
+
+    scoped_ptr<RowBatch> batch(CreateRowBatch());
+    int next_val = 0;
+    GetNextBatch(batch.get(), &next_val);
+    EXPECT_TRUE(sender.Send(&state, batch.get(), false).ok());
+    if (!own_build_too_large[i]) {
+      EXPECT_EQ(sender.GetNumDataBytesSent(), 0);
+      TPublishExchangeModeParams params;
+      params.__set_join_node_id(DEST_NODE_ID);
+      params.__set_broadcast(false);
+      state.SetExchangeMode(params);
+    }
+    for (int j = 1; j < NUM_BATCHES; ++j) {
+      GetNextBatch(batch.get(), &next_val);
+      EXPECT_TRUE(sender.Send(&state, batch.get(), false).ok());
+    }
+    batch->Reset();
+    EXPECT_TRUE(sender.Send(&state, batch.get(), true).ok());
+    sender.Close(&state);
+    FLAGS_adaptive_join_max_broadcast_bytes = default_max_broadcast_bytes;
+    const string* mode = sender.profile()->GetInfoString("AdaptiveExchangeMode");
+    ASSERT_TRUE(mode != NULL);
+    EXPECT_EQ(*mode, "PARTITIONED");
+
+    // Only a sender whose own build side is too large reports it, and the report is
+    // incomplete.
+    vector<TUpdateBuildSizeParams> build_sizes = backend_->TakeBuildSizes();
+    if (own_build_too_large[i]) {
+      ASSERT_EQ(build_sizes.size(), 1);
+      EXPECT_EQ(build_sizes[0].join_node_id, DEST_NODE_ID);
+      EXPECT_EQ(build_sizes[0].num_rows, BATCH_CAPACITY);
+      EXPECT_GT(build_sizes[0].num_bytes, 0);
+      EXPECT_FALSE(build_sizes[0].eos);
+    } else {
+      EXPECT_TRUE(build_sizes.empty());
+    }
+
+    JoinReceivers();
+    CheckReceivers(TPartitionType::HASH_PARTITIONED, 1);
+  }
+}
+
+// The sender of the probe side of a broadcast adaptive join sends its batches
+// round-robin to the join instances on its own host, and to all instances if none of
+// them is local.
+TEST_F(DataStreamTest, AdaptiveProbeLocal) {
+  TDataStreamSink sink = hash_sink_;
+  sink.__set_adaptive_join_node_id(DEST_NODE_ID);
+  sink.__set_adaptive_exchange_role(TAdaptiveExchangeRole::PROBE);
+  const int NUM_RECEIVERS = 4;
+  bool has_local_receivers[] = {true, false};
+  for (int i = 0; i < sizeof(has_local_receivers) / sizeof(bool); ++i) {
+    Reset();
+    for (int j = 0; j < NUM_RECEIVERS; ++j) {
+      StartReceiver(TPartitionType::RANDOM, 1, j, 1024 * 1024, false);
+    }
+    // All receivers are served by the test backend. Receivers 0 and 2 are addressed
+    // like the backend of the sender, so only they are local.
+    if (has_local_receivers[i]) {
+      dest_[0].server = exec_env_.backend_address();
+      dest_[2].server = exec_env_.backend_address();
+    }
+    RuntimeState state(TPlanFragmentInstanceCtx(), "", &exec_env_);
+    state.set_desc_tbl(desc_tbl_);
+    state.InitMemTrackers(TUniqueId(), NULL, -1);
+    DataStreamSender sender(&obj_pool_, 0, *row_desc_, sink, dest_, 1024);
+    EXPECT_TRUE(sender.Prepare(&state).ok());
+    EXPECT_TRUE(sender.Open(&state).ok());
+
+    // The probe sender waits for the mode before it sends anything.
+    TPublishExchangeModeParams params;
+    params.__set_join_node_id(DEST_NODE_ID);
+    params.__set_broadcast(true);
+    state.SetExchangeMode(params);
+    scoped_ptr<RowBatch> batch(CreateRowBatch());
+    int next_val = 0;
+    for (int j = 0; j < NUM_BATCHES; ++j) {
+      GetNextBatch(batch.get(), &next_val);
+      EXPECT_TRUE(sender.Send(&state, batch.get(), false).ok());
+    }
+    batch->Reset();
+    EXPECT_TRUE(sender.Send(&state, batch.get(), true).ok());
+    sender.Close(&state);
+    JoinReceivers();
+
+    // Every row is sent once.
+    multiset<int64_t> all_data_values;
+    for (int j = 0; j < NUM_RECEIVERS; ++j) {
+      const ReceiverInfo& info = receiver_info_[j];
+      EXPECT_TRUE(info.status.ok());
+      bool is_local = !has_local_receivers[i] || j % 2 == 0;
+      if (is_local) {
+        EXPECT_GT(info.data_values.size(), 0) << j;
+      } else {
+        EXPECT_EQ(info.data_values.size(), 0) << j;
+      }
+      all_data_values.insert(info.data_values.begin(), info.data_values.end());
+    }
+    EXPECT_EQ(all_data_values.size(), NUM_BATCHES * BATCH_CAPACITY);
+    int k = 0;
+    for (multiset<int64_t>::iterator it = all_data_values.begin();
+         it != all_data_values.end(); ++it, ++k) {
+      EXPECT_EQ(*it, k);
+      if (*it != k) break;
+    }
+  }
+}
+
+// Measures the throughput of the receiving side of exchanges: many senders add batches
+// to the receivers of many fragment instances concurrently, like the rpc threads of a
+// backend that runs many queries do. There are no rpcs, so the time is spent in
+// DataStreamMgr::AddData(), the sender queues and deserializing the batches.
+TEST_F(DataStreamTest, AddDataThroughput) {
+  const int NUM_RECVRS = 16;
+  const int NUM_THROUGHPUT_SENDERS = 16;
+  const int NUM_BATCHES_PER_SENDER = 500;
+  Reset();
+  scoped_ptr<RowBatch> batch(CreateRowBatch());
+  int next_val = 0;
+  GetNextBatch(batch.get(), &next_val);
+  TRowBatch thrift_batch;
+  batch->Serialize(&thrift_batch, THdfsCompression::NONE);
+
+  vector<TUniqueId> instance_ids(NUM_RECVRS);
+  vector<boost::shared_ptr<DataStreamRecvr> > recvrs;
+  for (int i = 0; i < NUM_RECVRS; ++i) {
+    GetNextInstanceId(&instance_ids[i]);
+    RuntimeProfile* profile = obj_pool_.Add(new RuntimeProfile(&obj_pool_, "Receiver"));
+    recvrs.push_back(stream_mgr_->CreateRecvr(&runtime_state_, *row_desc_,
+        instance_ids[i], DEST_NODE_ID, NUM_THROUGHPUT_SENDERS, 1024 * 1024, profile,
+        false));
+  }
+
+  vector<int64_t> num_rows(NUM_RECVRS, 0);
+  MonotonicStopWatch timer;
+  timer.Start();
+  thread_group consumers;
+  for (int i = 0; i < NUM_RECVRS; ++i) {
+    consumers.add_thread(
+        new thread(&DataStreamTest::DrainRecvr, this, recvrs[i].get(), &num_rows[i]));
+  }
+  thread_group producers;
+  for (int i = 0; i < NUM_THROUGHPUT_SENDERS; ++i) {
+    producers.add_thread(new thread(&DataStreamTest::AddDataToRecvrs, this,
+        &instance_ids, &thrift_batch, NUM_BATCHES_PER_SENDER, i));
+  }
+  producers.join_all();
+  consumers.join_all();
+  timer.Stop();
+
+  int64_t num_batches =
+      static_cast<int64_t>(NUM_RECVRS) * NUM_THROUGHPUT_SENDERS * NUM_BATCHES_PER_SENDER;
+  LOG(INFO) << "AddData() throughput: "
+            << num_batches * 1000L * 1000L * 1000L / max<uint64_t>(timer.ElapsedTime(), 1)
+            << " batches/s, " << num_batches << " batches in "
+            << PrettyPrinter::Print(timer.ElapsedTime(), TUnit::TIME_NS);
+  for (int i = 0; i < NUM_RECVRS; ++i) {
+    EXPECT_EQ(num_rows[i], num_batches / NUM_RECVRS * BATCH_CAPACITY);
+    recvrs[i]->Close();
+  }
+  batch->Reset();
+}
+
 // TODO: more tests:
 // - test case for transmission error in last batch
 // - receivers getting created concurrently
@@ -591,6 +1044,10 @@ TEST_F(DataStreamTest, BasicTest) {
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
   InitCommonRuntime(argc, argv, true, TestInfo::BE_TEST);
+  // The test backend is the backend of the ExecEnvs of the tests, so that senders
+  // recognize destinations on their own host.
+  FLAGS_hostname = "localhost";
+  FLAGS_be_port = FLAGS_port;
   InitFeSupport();
   impala::LlvmCodeGen::InitializeLlvm();
   return RUN_ALL_TESTS();
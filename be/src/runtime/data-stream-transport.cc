@@ -0,0 +1,154 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/data-stream-transport.h"
+
+#include <sstream>
+#include <boost/foreach.hpp>
+#include <gutil/strings/substitute.h>
+
+#include "common/logging.h"
+#include "util/network-util.h"
+
+#include "gen-cpp/ImpalaInternalService.h"
+#include "gen-cpp/ImpalaInternalService_types.h"
+
+using namespace boost;
+using namespace std;
+using namespace strings;   // for Substitute
+
+DEFINE_int32(exchange_rpc_threads_per_host, 2, "Number of threads, and therefore "
+    "connections, that send the row batches of all exchanges to one other host.");
+
+namespace impala {
+
+DataStreamTransport::DataStreamTransport(ImpalaInternalServiceClientCache* client_cache)
+  : client_cache_(client_cache),
+    shut_down_(false) {
+}
+
+DataStreamTransport::~DataStreamTransport() {
+  {
+    lock_guard<mutex> l(lock_);
+    shut_down_ = true;
+  }
+  BOOST_FOREACH(const HostQueueMap::value_type& entry, host_queues_) {
+    HostQueue* queue = entry.second;
+    {
+      // Taking the lock makes sure that no thread misses the notification between
+      // checking shut_down_ and waiting.
+      lock_guard<mutex> l(queue->lock);
+    }
+    queue->cv.notify_all();
+    queue->threads.JoinAll();
+    TTransmitDataResult result;
+    BOOST_FOREACH(const Request& request, queue->requests) {
+      request.done(Status::CANCELLED, result);
+    }
+    delete queue;
+  }
+}
+
+void DataStreamTransport::Send(const TNetworkAddress& address,
+    TTransmitDataParams* params, const DoneCallback& done) {
+  HostQueue* queue = GetHostQueue(address);
+  Request request;
+  request.params = params;
+  request.done = done;
+  {
+    lock_guard<mutex> l(queue->lock);
+    queue->requests.push_back(request);
+  }
+  queue->cv.notify_one();
+}
+
+DataStreamTransport::HostQueue* DataStreamTransport::GetHostQueue(
+    const TNetworkAddress& address) {
+  lock_guard<mutex> l(lock_);
+  DCHECK(!shut_down_);
+  HostQueueMap::iterator it = host_queues_.find(address);
+  if (it != host_queues_.end()) return it->second;
+
+  HostQueue* queue = new HostQueue();
+  queue->address = address;
+  for (int i = 0; i < max(FLAGS_exchange_rpc_threads_per_host, 1); ++i) {
+    queue->threads.AddThread(new Thread("data-stream-transport",
+        Substitute("sender-$0-$1", TNetworkAddressToString(address), i),
+        &DataStreamTransport::SendRequests, this, queue));
+  }
+  host_queues_[address] = queue;
+  return queue;
+}
+
+void DataStreamTransport::SendRequests(HostQueue* queue) {
+  vector<Request> requests;
+  while (true) {
+    {
+      unique_lock<mutex> l(queue->lock);
+      while (queue->requests.empty() && !shut_down_) queue->cv.wait(l);
+      if (shut_down_) return;
+      // Take everything that is queued. Requests that arrive while the rpc is in
+      // progress are picked up by the other threads of this host.
+      requests.assign(queue->requests.begin(), queue->requests.end());
+      queue->requests.clear();
+    }
+    SendBatch(queue->address, &requests);
+    requests.clear();
+  }
+}
+
+void DataStreamTransport::SendBatch(const TNetworkAddress& address,
+    vector<Request>* requests) {
+  TTransmitDataBatchParams params;
+  params.protocol_version = ImpalaInternalServiceVersion::V1;
+  params.__isset.requests = true;
+  params.requests.resize(requests->size());
+  // Move the requests, including their row batches, into the rpc instead of copying.
+  for (int i = 0; i < requests->size(); ++i) {
+    swap(*(*requests)[i].params, params.requests[i]);
+  }
+
+  TTransmitDataBatchResult result;
+  Status status;
+  {
+    ImpalaInternalServiceConnection client(client_cache_, address, &status);
+    if (status.ok()) {
+      status = client.DoRpc(&ImpalaInternalServiceClient::TransmitDataBatch, params,
+          result);
+    }
+  }
+  if (status.ok() && result.results.size() != requests->size()) {
+    stringstream msg;
+    msg << "TransmitDataBatch() to " << address << " returned "
+        << result.results.size() << " results for " << requests->size() << " requests";
+    status = Status(msg.str());
+  }
+  if (!status.ok()) {
+    VLOG_RPC << "TransmitDataBatch() to " << address << " failed: "
+             << status.GetDetail();
+  }
+
+  TTransmitDataResult error_result;
+  for (int i = 0; i < requests->size(); ++i) {
+    swap(*(*requests)[i].params, params.requests[i]);
+    if (!status.ok()) {
+      (*requests)[i].done(status, error_result);
+    } else {
+      const TTransmitDataResult& request_result = result.results[i];
+      (*requests)[i].done(Status(request_result.status), request_result);
+    }
+  }
+}
+
+}
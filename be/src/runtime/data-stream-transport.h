@@ -0,0 +1,109 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_RUNTIME_DATA_STREAM_TRANSPORT_H
+#define IMPALA_RUNTIME_DATA_STREAM_TRANSPORT_H
+
+#include <deque>
+#include <vector>
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "common/status.h"
+#include "runtime/client-cache.h"
+#include "util/container-util.h"
+#include "util/thread.h"
+#include "gen-cpp/Types_types.h"  // for TNetworkAddress
+
+namespace impala {
+
+class TTransmitDataParams;
+class TTransmitDataResult;
+
+// Process-wide transport for the row batches that DataStreamSender channels send to
+// DataStreamRecvrs on other backends.
+// Instead of every channel making its own TransmitData() rpc per batch, the requests
+// of all channels to the same host are put into one queue per host. A small number of
+// long-lived threads per host (--exchange_rpc_threads_per_host) take all requests that
+// are queued at that time and send them in a single TransmitDataBatch() rpc over a
+// persistent connection from the client cache. The number of connections between two
+// hosts is therefore bounded by the number of threads, independent of the number of
+// channels, and a channel's request is not delayed by a round trip of its own if
+// other requests to the same host are already being sent.
+//
+// Requests are not retried and there is no ordering between the requests of different
+// channels. A channel must not queue a new request before the callback of its previous
+// one was called, which keeps the batches of a channel in order.
+class DataStreamTransport {
+ public:
+  // Called once the rpc that carried a request has finished, from a transport thread.
+  // 'status' is the rpc status, or the receiver's status if the rpc succeeded.
+  typedef boost::function<void (const Status& status,
+      const TTransmitDataResult& result)> DoneCallback;
+
+  DataStreamTransport(ImpalaInternalServiceClientCache* client_cache);
+
+  // Stops all threads. Requests that were not sent yet fail with CANCELLED.
+  ~DataStreamTransport();
+
+  // Queues 'params' to be sent to 'address' and returns immediately. 'params' must stay
+  // valid and unchanged until 'done' is called. Its row batch is moved into the rpc
+  // and back without being copied.
+  void Send(const TNetworkAddress& address, TTransmitDataParams* params,
+      const DoneCallback& done);
+
+ private:
+  struct Request {
+    TTransmitDataParams* params;
+    DoneCallback done;
+  };
+
+  // The queue of requests to one host and the threads that send them.
+  struct HostQueue {
+    TNetworkAddress address;
+    boost::mutex lock;
+    boost::condition_variable cv;
+    std::deque<Request> requests;
+    ThreadGroup threads;
+  };
+
+  ImpalaInternalServiceClientCache* client_cache_;
+
+  // Protects host_queues_ and shut_down_.
+  boost::mutex lock_;
+
+  // Queues by destination host. Created on the first request to a host and kept until
+  // the transport is destroyed.
+  typedef boost::unordered_map<TNetworkAddress, HostQueue*> HostQueueMap;
+  HostQueueMap host_queues_;
+
+  // Set in the destructor to stop the threads.
+  bool shut_down_;
+
+  // Returns the queue for 'address', starting its threads if it did not exist yet.
+  HostQueue* GetHostQueue(const TNetworkAddress& address);
+
+  // Loop of the threads of 'queue'. Sends the queued requests until shut_down_ is set.
+  void SendRequests(HostQueue* queue);
+
+  // Sends 'requests' in one rpc and calls their callbacks.
+  void SendBatch(const TNetworkAddress& address, std::vector<Request>* requests);
+};
+
+}
+
+#endif
@@ -24,6 +24,7 @@
 #include "resourcebroker/resource-broker.h"
 #include "runtime/client-cache.h"
 #include "runtime/data-stream-mgr.h"
+#include "runtime/data-stream-transport.h"
 #include "runtime/disk-io-mgr.h"
 #include "runtime/hbase-table-factory.h"
 #include "runtime/hdfs-fs-cache.h"
@@ -129,6 +130,7 @@ ExecEnv::ExecEnv()
   : stream_mgr_(new DataStreamMgr()),
     impalad_client_cache_(new ImpalaInternalServiceClientCache()),
     catalogd_client_cache_(new CatalogServiceClientCache()),
+    stream_transport_(new DataStreamTransport(impalad_client_cache_.get())),
     htable_factory_(new HBaseTableFactory()),
     disk_io_mgr_(new DiskIoMgr()),
     webserver_(new Webserver()),
@@ -176,6 +178,7 @@ ExecEnv::ExecEnv(const string& hostname, int backend_port, int subscriber_port,
   : stream_mgr_(new DataStreamMgr()),
     impalad_client_cache_(new ImpalaInternalServiceClientCache()),
     catalogd_client_cache_(new CatalogServiceClientCache()),
+    stream_transport_(new DataStreamTransport(impalad_client_cache_.get())),
     htable_factory_(new HBaseTableFactory()),
     disk_io_mgr_(new DiskIoMgr()),
     webserver_(new Webserver(webserver_port)),
@@ -30,6 +30,7 @@
 namespace impala {
 
 class DataStreamMgr;
+class DataStreamTransport;
 class DiskIoMgr;
 class HBaseTableFactory;
 class HdfsFsCache;
@@ -76,6 +77,7 @@ class ExecEnv {
   ImpalaInternalServiceClientCache* impalad_client_cache() {
     return impalad_client_cache_.get();
   }
+  DataStreamTransport* stream_transport() { return stream_transport_.get(); }
   CatalogServiceClientCache* catalogd_client_cache() {
     return catalogd_client_cache_.get();
   }
@@ -122,6 +124,9 @@ class ExecEnv {
   boost::scoped_ptr<StatestoreSubscriber> statestore_subscriber_;
   boost::scoped_ptr<ImpalaInternalServiceClientCache> impalad_client_cache_;
   boost::scoped_ptr<CatalogServiceClientCache> catalogd_client_cache_;
+  // Sends the row batches of all DataStreamSenders. Declared after
+  // impalad_client_cache_, whose clients it uses until it is destroyed.
+  boost::scoped_ptr<DataStreamTransport> stream_transport_;
   boost::scoped_ptr<HBaseTableFactory> htable_factory_;
   boost::scoped_ptr<DiskIoMgr> disk_io_mgr_;
   boost::scoped_ptr<Webserver> webserver_;
@@ -95,6 +95,8 @@ Status PlanFragmentExecutor::Prepare(const TExecPlanFragmentParams& request) {
 
   runtime_state_.reset(
       new RuntimeState(request.fragment_instance_ctx, cgroup, exec_env_));
+  runtime_state_->InitGlobalFilters(params.global_filter_source_slot_ids,
+      params.global_filter_target_slot_ids);
 
   // total_time_counter() is in the runtime_state_ so start it up now.
   SCOPED_TIMER(profile()->total_time_counter());
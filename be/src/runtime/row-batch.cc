@@ -55,51 +55,55 @@ RowBatch::RowBatch(const RowDescriptor& row_desc, int capacity,
 //              xfer += iprot->readString(this->tuple_data[_i9]);
 // to allocated string data in special mempool
 // (change via python script that runs over Data_types.cc)
-RowBatch::RowBatch(const RowDescriptor& row_desc, const TRowBatch& input_batch,
+RowBatch::RowBatch(const RowDescriptor& row_desc, TRowBatch* input_batch,
     MemTracker* mem_tracker)
   : mem_tracker_(mem_tracker),
     has_in_flight_row_(false),
-    num_rows_(input_batch.num_rows),
+    num_rows_(input_batch->num_rows),
     capacity_(num_rows_),
-    num_tuples_per_row_(input_batch.row_tuples.size()),
+    num_tuples_per_row_(input_batch->row_tuples.size()),
     row_desc_(row_desc),
     auxiliary_mem_usage_(0),
     tuple_data_pool_(new MemPool(mem_tracker)) {
   DCHECK(mem_tracker_ != NULL);
-  tuple_ptrs_size_ = num_rows_ * input_batch.row_tuples.size() * sizeof(Tuple*);
+  tuple_ptrs_size_ = num_rows_ * input_batch->row_tuples.size() * sizeof(Tuple*);
   tuple_ptrs_ = reinterpret_cast<Tuple**>(tuple_data_pool_->Allocate(tuple_ptrs_size_));
-  if (input_batch.compression_type != THdfsCompression::NONE) {
+  uint8_t* tuple_data;
+  if (input_batch->compression_type != THdfsCompression::NONE) {
     // Decompress tuple data into data pool
-    uint8_t* compressed_data = (uint8_t*)input_batch.tuple_data.c_str();
-    size_t compressed_size = input_batch.tuple_data.size();
+    uint8_t* compressed_data = (uint8_t*)input_batch->tuple_data.c_str();
+    size_t compressed_size = input_batch->tuple_data.size();
 
     scoped_ptr<Codec> decompressor;
-    Status status = Codec::CreateDecompressor(NULL, false, input_batch.compression_type,
+    Status status = Codec::CreateDecompressor(NULL, false, input_batch->compression_type,
         &decompressor);
     DCHECK(status.ok()) << status.GetDetail();
 
-    int64_t uncompressed_size = input_batch.uncompressed_size;
+    int64_t uncompressed_size = input_batch->uncompressed_size;
     DCHECK_NE(uncompressed_size, -1) << "RowBatch decompression failed";
-    uint8_t* data = tuple_data_pool_->Allocate(uncompressed_size);
+    tuple_data = tuple_data_pool_->Allocate(uncompressed_size);
     status = decompressor->ProcessBlock(true, compressed_size, compressed_data,
-        &uncompressed_size, &data);
+        &uncompressed_size, &tuple_data);
     DCHECK(status.ok()) << "RowBatch decompression failed.";
     decompressor->Close();
   } else {
-    // Tuple data uncompressed, copy directly into data pool
-    uint8_t* data = tuple_data_pool_->Allocate(input_batch.tuple_data.size());
-    memcpy(data, input_batch.tuple_data.c_str(), input_batch.tuple_data.size());
+    // Tuple data uncompressed, take it over instead of copying it into the data pool
+    string* data = new string();
+    data->swap(input_batch->tuple_data);
+    mem_tracker_->Consume(data->capacity());
+    auxiliary_mem_usage_ += data->capacity();
+    received_tuple_data_.push_back(data);
+    tuple_data = reinterpret_cast<uint8_t*>(const_cast<char*>(data->data()));
   }
 
   // convert input_batch.tuple_offsets into pointers
   int tuple_idx = 0;
-  for (vector<int32_t>::const_iterator offset = input_batch.tuple_offsets.begin();
-       offset != input_batch.tuple_offsets.end(); ++offset) {
+  for (vector<int32_t>::const_iterator offset = input_batch->tuple_offsets.begin();
+       offset != input_batch->tuple_offsets.end(); ++offset) {
     if (*offset == -1) {
       tuple_ptrs_[tuple_idx++] = NULL;
     } else {
-      tuple_ptrs_[tuple_idx++] = reinterpret_cast<Tuple*>(
-          tuple_data_pool_->GetDataPtr(*offset + tuple_ptrs_size_));
+      tuple_ptrs_[tuple_idx++] = reinterpret_cast<Tuple*>(tuple_data + *offset);
     }
   }
 
@@ -128,8 +132,8 @@ RowBatch::RowBatch(const RowDescriptor& row_desc, const TRowBatch& input_batch,
       for (; slot != (*desc)->string_slots().end(); ++slot) {
         DCHECK((*slot)->type().IsVarLen());
         StringValue* string_val = t->GetStringSlot((*slot)->tuple_offset());
-        int offset = reinterpret_cast<intptr_t>(string_val->ptr) + tuple_ptrs_size_;
-        string_val->ptr = reinterpret_cast<char*>(tuple_data_pool_->GetDataPtr(offset));
+        int offset = reinterpret_cast<intptr_t>(string_val->ptr);
+        string_val->ptr = reinterpret_cast<char*>(tuple_data + offset);
       }
     }
   }
@@ -143,9 +147,10 @@ RowBatch::~RowBatch() {
   for (int i = 0; i < tuple_streams_.size(); ++i) {
     tuple_streams_[i]->Close();
   }
+  FreeReceivedTupleData();
 }
 
-int RowBatch::Serialize(TRowBatch* output_batch) {
+int RowBatch::Serialize(TRowBatch* output_batch, THdfsCompression::type codec) {
   // why does Thrift not generate a Clear() function?
   output_batch->row_tuples.clear();
   output_batch->tuple_offsets.clear();
@@ -181,27 +186,8 @@ int RowBatch::Serialize(TRowBatch* output_batch) {
   }
   DCHECK_EQ(offset, size);
 
-  if (size > 0) {
-    // Try compressing tuple_data to compression_scratch_, swap if compressed data is
-    // smaller
-    scoped_ptr<Codec> compressor;
-    Status status = Codec::CreateCompressor(NULL, false, THdfsCompression::LZ4,
-                                            &compressor);
-    DCHECK(status.ok()) << status.GetDetail();
-
-    int64_t compressed_size = compressor->MaxOutputLen(size);
-    if (compression_scratch_.size() < compressed_size) {
-      compression_scratch_.resize(compressed_size);
-    }
-    uint8_t* input = (uint8_t*)output_batch->tuple_data.c_str();
-    uint8_t* compressed_output = (uint8_t*)compression_scratch_.c_str();
-    compressor->ProcessBlock(true, size, input, &compressed_size, &compressed_output);
-    if (LIKELY(compressed_size < size)) {
-      compression_scratch_.resize(compressed_size);
-      output_batch->tuple_data.swap(compression_scratch_);
-      output_batch->compression_type = THdfsCompression::LZ4;
-    }
-    VLOG_ROW << "uncompressed size: " << size << ", compressed size: " << compressed_size;
+  if (codec != THdfsCompression::NONE) {
+    CompressTupleData(codec, output_batch, &compression_scratch_);
   }
 
   // The size output_batch would be if we didn't compress tuple_data (will be equal to
@@ -209,6 +195,32 @@ int RowBatch::Serialize(TRowBatch* output_batch) {
   return GetBatchSize(*output_batch) - output_batch->tuple_data.size() + size;
 }
 
+void RowBatch::CompressTupleData(THdfsCompression::type codec, TRowBatch* output_batch,
+    string* compression_scratch) {
+  DCHECK(codec == THdfsCompression::LZ4 || codec == THdfsCompression::SNAPPY) << codec;
+  int size = output_batch->tuple_data.size();
+  if (size == 0) return;
+  // Try compressing tuple_data to compression_scratch, swap if compressed data is
+  // smaller
+  scoped_ptr<Codec> compressor;
+  Status status = Codec::CreateCompressor(NULL, false, codec, &compressor);
+  DCHECK(status.ok()) << status.GetDetail();
+
+  int64_t compressed_size = compressor->MaxOutputLen(size);
+  if (compression_scratch->size() < compressed_size) {
+    compression_scratch->resize(compressed_size);
+  }
+  uint8_t* input = (uint8_t*)output_batch->tuple_data.c_str();
+  uint8_t* compressed_output = (uint8_t*)compression_scratch->c_str();
+  compressor->ProcessBlock(true, size, input, &compressed_size, &compressed_output);
+  if (LIKELY(compressed_size < size)) {
+    compression_scratch->resize(compressed_size);
+    output_batch->tuple_data.swap(*compression_scratch);
+    output_batch->compression_type = codec;
+  }
+  VLOG_ROW << "uncompressed size: " << size << ", compressed size: " << compressed_size;
+}
+
 void RowBatch::AddIoBuffer(DiskIoMgr::BufferDescriptor* buffer) {
   DCHECK(buffer != NULL);
   io_buffers_.push_back(buffer);
@@ -236,6 +248,7 @@ void RowBatch::Reset() {
     tuple_streams_[i]->Close();
   }
   tuple_streams_.clear();
+  FreeReceivedTupleData();
   auxiliary_mem_usage_ = 0;
   tuple_ptrs_ = reinterpret_cast<Tuple**>(tuple_data_pool_->Allocate(tuple_ptrs_size_));
   need_to_return_ = false;
@@ -256,12 +269,34 @@ void RowBatch::TransferResourceOwnership(RowBatch* dest) {
     dest->auxiliary_mem_usage_ += tuple_streams_[i]->byte_size();
   }
   tuple_streams_.clear();
+  TransferReceivedTupleData(dest);
   dest->need_to_return_ |= need_to_return_;
   auxiliary_mem_usage_ = 0;
   tuple_ptrs_ = NULL;
   Reset();
 }
 
+void RowBatch::TransferReceivedTupleData(RowBatch* dest) {
+  for (int i = 0; i < received_tuple_data_.size(); ++i) {
+    string* data = received_tuple_data_[i];
+    dest->received_tuple_data_.push_back(data);
+    dest->auxiliary_mem_usage_ += data->capacity();
+    if (dest->mem_tracker_ != mem_tracker_) {
+      mem_tracker_->Release(data->capacity());
+      dest->mem_tracker_->Consume(data->capacity());
+    }
+  }
+  received_tuple_data_.clear();
+}
+
+void RowBatch::FreeReceivedTupleData() {
+  for (int i = 0; i < received_tuple_data_.size(); ++i) {
+    mem_tracker_->Release(received_tuple_data_[i]->capacity());
+    delete received_tuple_data_[i];
+  }
+  received_tuple_data_.clear();
+}
+
 int RowBatch::GetBatchSize(const TRowBatch& batch) {
   int result = batch.tuple_data.size();
   result += batch.row_tuples.size() * sizeof(TTupleId);
@@ -287,6 +322,7 @@ void RowBatch::AcquireState(RowBatch* src) {
     buffer->SetMemTracker(mem_tracker_);
   }
   src->io_buffers_.clear();
+  src->TransferReceivedTupleData(this);
   src->auxiliary_mem_usage_ = 0;
 
   DCHECK(src->tuple_streams_.empty());
@@ -304,20 +340,25 @@ void RowBatch::AcquireState(RowBatch* src) {
 int RowBatch::TotalByteSize() {
   int result = 0;
   for (int i = 0; i < num_rows_; ++i) {
-    TupleRow* row = GetRow(i);
-    const vector<TupleDescriptor*>& tuple_descs = row_desc_.tuple_descriptors();
-    vector<TupleDescriptor*>::const_iterator desc = tuple_descs.begin();
-    for (int j = 0; desc != tuple_descs.end(); ++desc, ++j) {
-      Tuple* tuple = row->GetTuple(j);
-      if (tuple == NULL) continue;
-      result += (*desc)->byte_size();
-      vector<SlotDescriptor*>::const_iterator slot = (*desc)->string_slots().begin();
-      for (; slot != (*desc)->string_slots().end(); ++slot) {
-        DCHECK((*slot)->type().IsVarLen());
-        if (tuple->IsNull((*slot)->null_indicator_offset())) continue;
-        StringValue* string_val = tuple->GetStringSlot((*slot)->tuple_offset());
-        result += string_val->len;
-      }
+    result += GetSerializedRowSize(row_desc_, GetRow(i));
+  }
+  return result;
+}
+
+int RowBatch::GetSerializedRowSize(const RowDescriptor& row_desc, TupleRow* row) {
+  int result = 0;
+  const vector<TupleDescriptor*>& tuple_descs = row_desc.tuple_descriptors();
+  vector<TupleDescriptor*>::const_iterator desc = tuple_descs.begin();
+  for (int j = 0; desc != tuple_descs.end(); ++desc, ++j) {
+    Tuple* tuple = row->GetTuple(j);
+    if (tuple == NULL) continue;
+    result += (*desc)->byte_size();
+    vector<SlotDescriptor*>::const_iterator slot = (*desc)->string_slots().begin();
+    for (; slot != (*desc)->string_slots().end(); ++slot) {
+      DCHECK((*slot)->type().IsVarLen());
+      if (tuple->IsNull((*slot)->null_indicator_offset())) continue;
+      StringValue* string_val = tuple->GetStringSlot((*slot)->tuple_offset());
+      result += string_val->len;
     }
   }
   return result;
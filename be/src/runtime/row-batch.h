@@ -25,6 +25,7 @@
 #include "runtime/disk-io-mgr.h"
 #include "runtime/mem-pool.h"
 #include "runtime/mem-tracker.h"
+#include "gen-cpp/CatalogObjects_types.h"  // for THdfsCompression
 
 namespace impala {
 
@@ -70,18 +71,17 @@ class RowBatch {
   // tracker cannot be NULL.
   RowBatch(const RowDescriptor& row_desc, int capacity, MemTracker* tracker);
 
-  // Populate a row batch from input_batch by copying input_batch's
-  // tuple_data into the row batch's mempool and converting all offsets
-  // in the data back into pointers.
-  // TODO: figure out how to transfer the data from input_batch to this RowBatch
-  // (so that we don't need to make yet another copy)
-  RowBatch(const RowDescriptor& row_desc, const TRowBatch& input_batch,
-      MemTracker* tracker);
+  // Populate a row batch from input_batch and convert all offsets in the data back into
+  // pointers. Compressed tuple data is decompressed into the row batch's mempool.
+  // Uncompressed tuple data is not copied: the row batch takes over
+  // input_batch->tuple_data (leaving it empty) and the rows point into it.
+  RowBatch(const RowDescriptor& row_desc, TRowBatch* input_batch, MemTracker* tracker);
 
   // Releases all resources accumulated at this row batch.  This includes
   //  - tuple_ptrs
   //  - tuple mem pool data
   //  - buffer handles from the io mgr
+  //  - tuple data taken over from a TRowBatch
   ~RowBatch();
 
   static const int INVALID_ROW_INDEX = -1;
@@ -137,6 +137,10 @@ class RowBatch {
   // auxiliary (i.e. the smallest footprint for the row batch).
   int TotalByteSize();
 
+  // The number of bytes 'row' adds to the tuple data of a serialized row batch, i.e. the
+  // size of its non-NULL tuples and the string data they reference.
+  static int GetSerializedRowSize(const RowDescriptor& row_desc, TupleRow* row);
+
   TupleRow* GetRow(int row_idx) {
     DCHECK(tuple_ptrs_ != NULL);
     DCHECK_GE(row_idx, 0);
@@ -201,13 +205,22 @@ class RowBatch {
 
   // Create a serialized version of this row batch in output_batch, attaching all of the
   // data it references to output_batch.tuple_data. output_batch.tuple_data will be
-  // snappy-compressed unless the compressed data is larger than the uncompressed
-  // data. Use output_batch.is_compressed to determine whether tuple_data is compressed.
+  // compressed with 'codec' unless that is NONE or the compressed data is larger than
+  // the uncompressed data. Use output_batch.compression_type to determine whether
+  // tuple_data is compressed.
   // If an in-flight row is present in this row batch, it is ignored.
   // This function does not Reset().
   // Returns the uncompressed serialized size (this will be the true size of output_batch
   // if tuple_data is actually uncompressed).
-  int Serialize(TRowBatch* output_batch);
+  int Serialize(TRowBatch* output_batch,
+      THdfsCompression::type codec = THdfsCompression::LZ4);
+
+  // Compresses the (uncompressed) output_batch->tuple_data with 'codec' (LZ4 or SNAPPY)
+  // and sets output_batch->compression_type if the compressed data is smaller. The
+  // compressed data is written to 'compression_scratch', which is swapped with
+  // tuple_data, so both strings keep their allocations when reused.
+  static void CompressTupleData(THdfsCompression::type codec, TRowBatch* output_batch,
+      std::string* compression_scratch);
 
   // Utility function: returns total size of batch.
   static int GetBatchSize(const TRowBatch& batch);
@@ -260,6 +273,16 @@ class RowBatch {
   // Tuple streams currently owned by this row batch.
   std::vector<BufferedTupleStream*> tuple_streams_;
 
+  // Uncompressed tuple data taken over from TRowBatches that rows point into. Owned by
+  // this row batch and transferred like the IO buffers. Counted against mem_tracker_.
+  std::vector<std::string*> received_tuple_data_;
+
+  // Moves received_tuple_data_ to 'dest', including the memory accounting.
+  void TransferReceivedTupleData(RowBatch* dest);
+
+  // Frees received_tuple_data_.
+  void FreeReceivedTupleData();
+
   // String to write compressed tuple data to in Serialize().
   // This is a string so we can swap() with the string in the TRowBatch we're serializing
   // to (we don't compress directly into the TRowBatch in case the compressed data is
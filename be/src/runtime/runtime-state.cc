@@ -17,6 +17,7 @@
 
 #include "common/logging.h"
 #include <boost/algorithm/string/join.hpp>
+#include <boost/thread/thread_time.hpp>
 #include <gutil/strings/substitute.h>
 
 #include "codegen/llvm-codegen.h"
@@ -24,12 +25,16 @@
 #include "common/status.h"
 #include "exprs/expr.h"
 #include "runtime/buffered-block-mgr.h"
+#include "runtime/client-cache.h"
 #include "runtime/descriptors.h"
+#include "runtime/raw-value.h"
 #include "runtime/runtime-state.h"
 #include "runtime/timestamp-value.h"
 #include "runtime/data-stream-mgr.h"
 #include "runtime/data-stream-recvr.h"
 #include "util/bitmap.h"
+#include "util/bit-util.h"
+#include "util/bloom-filter.h"
 #include "util/cpu-info.h"
 #include "util/debug-util.h"
 #include "util/disk-info.h"
@@ -41,12 +46,18 @@
 #include <jni.h>
 #include <iostream>
 
+#include "gen-cpp/ImpalaInternalService.h"
+
 DECLARE_int32(max_errors);
+DEFINE_int32(global_runtime_filter_size, 1024 * 1024, "Size in bytes of the bloom "
+    "filters that joins send to the scans of their probe side in other fragments. "
+    "Rounded down to a power of two.");
 
 using namespace boost;
 using namespace llvm;
 using namespace std;
 using namespace boost::algorithm;
+using namespace apache::thrift;
 
 // The fraction of the query mem limit that is used for the block mgr. Operators
 // that accumulate memory all use the block mgr so the majority of the memory should
@@ -105,6 +116,12 @@ RuntimeState::~RuntimeState() {
     }
   }
 
+  typedef boost::unordered_map<SlotId, BloomFilter*>::iterator GlobalFilterIterator;
+  for (GlobalFilterIterator it = global_filters_.begin();
+       it != global_filters_.end(); ++it) {
+    delete it->second;
+  }
+
   // query_mem_tracker_ must be valid as long as instance_mem_tracker_ is so
   // delete instance_mem_tracker_ first.
   // LogUsage() walks the MemTracker tree top-down when the memory limit is exceeded.
@@ -311,6 +328,165 @@ void RuntimeState::AddBitmapFilter(SlotId slot, Bitmap* bitmap,
   }
 }
 
+void RuntimeState::InitGlobalFilters(const vector<SlotId>& source_slots,
+    const vector<SlotId>& target_slots) {
+  global_filter_source_slots_.insert(source_slots.begin(), source_slots.end());
+  global_filter_target_slots_.insert(target_slots.begin(), target_slots.end());
+}
+
+void RuntimeState::PublishGlobalFilter(SlotId slot, const BloomFilter* filter) {
+  DCHECK(IsGlobalFilterSource(slot));
+  TUpdateFilterParams params;
+  params.protocol_version = ImpalaInternalServiceVersion::V1;
+  params.__set_query_id(query_id());
+  params.__set_fragment_instance_id(fragment_instance_id());
+  params.__set_slot_id(slot);
+  if (filter != NULL) {
+    params.__set_bloom_filter(
+        string(reinterpret_cast<const char*>(filter->data()), filter->size()));
+  }
+  VLOG_QUERY << "Sending global filter on slot " << slot << " for instance "
+             << PrintId(fragment_instance_id())
+             << (filter == NULL ? " (disabled)" : "");
+
+  const TNetworkAddress& coord_address = query_ctx().coord_address;
+  Status status;
+  ImpalaInternalServiceConnection coord(impalad_client_cache(), coord_address, &status);
+  if (status.ok()) {
+    TUpdateFilterResult res;
+    try {
+      try {
+        coord->UpdateFilter(res, params);
+      } catch (const TException& e) {
+        VLOG_RPC << "Retrying UpdateFilter: " << e.what();
+        status = coord.Reopen();
+        if (status.ok()) coord->UpdateFilter(res, params);
+      }
+      if (status.ok()) status = Status(res.status);
+    } catch (TException& e) {
+      stringstream msg;
+      msg << "UpdateFilter() to " << coord_address << " failed:\n" << e.what();
+      status = Status(msg.str());
+    }
+  }
+  if (!status.ok()) {
+    LOG(WARNING) << "Could not send global filter on slot " << slot << ": "
+                 << status.GetDetail();
+  }
+}
+
+void RuntimeState::SetGlobalFilter(const TPublishFilterParams& params) {
+  scoped_ptr<BloomFilter> filter;
+  if (params.__isset.bloom_filter) {
+    filter.reset(new BloomFilter(0));
+    if (!BloomFilter::Deserialize(
+            reinterpret_cast<const uint8_t*>(params.bloom_filter.data()),
+            params.bloom_filter.size(), filter.get())) {
+      LOG(WARNING) << "Ignoring invalid global filter on slot " << params.slot_id;
+      filter.reset();
+    }
+  }
+  lock_guard<mutex> l(global_filter_lock_);
+  // Filters that are not expected or duplicates are harmless and dropped.
+  if (global_filter_target_slots_.find(params.slot_id) ==
+      global_filter_target_slots_.end()) {
+    return;
+  }
+  if (global_filters_.find(params.slot_id) != global_filters_.end()) return;
+  global_filters_[params.slot_id] = filter.release();
+  global_filter_cv_.notify_all();
+}
+
+bool RuntimeState::WaitForGlobalFilters(int64_t timeout_ms) {
+  system_time deadline = get_system_time() + posix_time::milliseconds(timeout_ms);
+  unique_lock<mutex> l(global_filter_lock_);
+  while (global_filters_.size() < global_filter_target_slots_.size()) {
+    if (is_cancelled()) return false;
+    system_time now = get_system_time();
+    if (now >= deadline) return false;
+    // Wake up periodically to check for cancellation.
+    global_filter_cv_.timed_wait(l, min(deadline, now + posix_time::milliseconds(100)));
+  }
+  return true;
+}
+
+const BloomFilter* RuntimeState::GetGlobalFilter(SlotId slot) {
+  lock_guard<mutex> l(global_filter_lock_);
+  boost::unordered_map<SlotId, BloomFilter*>::const_iterator it =
+      global_filters_.find(slot);
+  return it == global_filters_.end() ? NULL : it->second;
+}
+
+uint64_t RuntimeState::GetGlobalFilterHash(const void* value, const ColumnType& type) {
+  // RawValue only has 32-bit hash functions. Combine two unrelated ones since the bloom
+  // filter uses the upper half to pick the block and the lower half to set the bits.
+  uint64_t hash = RawValue::GetHashValueFnv(value, type, HashUtil::FNV_SEED);
+  return (hash << 32) | RawValue::GetHashValue(value, type, 0);
+}
+
+int RuntimeState::global_filter_log_num_blocks() {
+  int64_t num_blocks = max<int64_t>(
+      FLAGS_global_runtime_filter_size / BloomFilter::BYTES_PER_BLOCK, 1);
+  return min(BitUtil::Log2(num_blocks + 1) - 1, 30);
+}
+
+Status RuntimeState::UpdateBuildSize(PlanNodeId join_node_id, int64_t num_bytes,
+    int64_t num_rows, bool eos) {
+  TUpdateBuildSizeParams params;
+  params.protocol_version = ImpalaInternalServiceVersion::V1;
+  params.__set_query_id(query_id());
+  params.__set_fragment_instance_id(fragment_instance_id());
+  params.__set_join_node_id(join_node_id);
+  params.__set_num_bytes(num_bytes);
+  params.__set_num_rows(num_rows);
+  params.__set_eos(eos);
+  VLOG_QUERY << "Reporting build size of adaptive exchange of join " << join_node_id
+             << " for instance " << PrintId(fragment_instance_id()) << ": "
+             << num_bytes << " bytes, " << num_rows << " rows"
+             << (eos ? "" : " (incomplete)");
+
+  const TNetworkAddress& coord_address = query_ctx().coord_address;
+  Status status;
+  ImpalaInternalServiceConnection coord(impalad_client_cache(), coord_address, &status);
+  RETURN_IF_ERROR(status);
+  TUpdateBuildSizeResult res;
+  RETURN_IF_ERROR(
+      coord.DoRpc(&ImpalaInternalServiceClient::UpdateBuildSize, params, res));
+  return Status(res.status);
+}
+
+void RuntimeState::SetExchangeMode(const TPublishExchangeModeParams& params) {
+  lock_guard<mutex> l(exchange_mode_lock_);
+  // The first mode wins, the coordinator never changes its decision.
+  if (exchange_modes_.find(params.join_node_id) != exchange_modes_.end()) return;
+  exchange_modes_[params.join_node_id] = params.broadcast;
+  exchange_mode_cv_.notify_all();
+}
+
+bool RuntimeState::GetExchangeMode(PlanNodeId join_node_id, bool* broadcast) {
+  lock_guard<mutex> l(exchange_mode_lock_);
+  boost::unordered_map<PlanNodeId, bool>::const_iterator it =
+      exchange_modes_.find(join_node_id);
+  if (it == exchange_modes_.end()) return false;
+  *broadcast = it->second;
+  return true;
+}
+
+Status RuntimeState::WaitForExchangeMode(PlanNodeId join_node_id, bool* broadcast) {
+  unique_lock<mutex> l(exchange_mode_lock_);
+  while (true) {
+    boost::unordered_map<PlanNodeId, bool>::const_iterator it =
+        exchange_modes_.find(join_node_id);
+    if (it != exchange_modes_.end()) {
+      *broadcast = it->second;
+      return Status::OK;
+    }
+    if (is_cancelled()) return Status::CANCELLED;
+    // Wake up periodically to check for cancellation.
+    exchange_mode_cv_.timed_wait(l, get_system_time() + posix_time::milliseconds(100));
+  }
+}
+
 Status RuntimeState::GetCodegen(LlvmCodeGen** codegen, bool initialize) {
   if (codegen_.get() == NULL && initialize) RETURN_IF_ERROR(CreateCodegen());
   *codegen = codegen_.get();
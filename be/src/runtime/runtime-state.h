@@ -21,6 +21,9 @@
 
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <set>
 #include <vector>
 #include <string>
 // stringstream is a typedef, so can't forward declare it.
@@ -40,6 +43,7 @@
 namespace impala {
 
 class Bitmap;
+class BloomFilter;
 class BufferedBlockMgr;
 class DescriptorTbl;
 class ObjectPool;
@@ -49,6 +53,7 @@ class Expr;
 class LlvmCodeGen;
 class TimestampValue;
 class DataStreamRecvr;
+class DataStreamTransport;
 
 // Counts how many rows an INSERT query has added to a particular partition
 // (partitions are identified by their partition keys: k1=v1/k2=v2
@@ -142,6 +147,7 @@ class RuntimeState {
   ImpalaInternalServiceClientCache* impalad_client_cache() {
     return exec_env_->impalad_client_cache();
   }
+  DataStreamTransport* stream_transport() { return exec_env_->stream_transport(); }
   CatalogServiceClientCache* catalogd_client_cache() {
     return exec_env_->catalogd_client_cache();
   }
@@ -183,6 +189,74 @@ class RuntimeState {
     return slot_bitmap_filters_[slot];
   }
 
+  // Global filters are the cluster-wide counterpart of the bitmap filters: a join builds
+  // a bloom filter over its build side values, sends it to the coordinator, which
+  // merges the filters of all instances of the join and publishes the result to the
+  // fragment instances that scan the probe side (see Coordinator::UpdateFilter()).
+
+  // Sets the probe slots this fragment instance builds global filters on and the slots
+  // it receives global filters on. Called once, before the fragment is opened.
+  void InitGlobalFilters(const std::vector<SlotId>& source_slots,
+      const std::vector<SlotId>& target_slots);
+
+  // Returns true if a join of this fragment instance should build a global filter on
+  // probe slot 'slot' and send it with PublishGlobalFilter().
+  bool IsGlobalFilterSource(SlotId slot) const {
+    return global_filter_source_slots_.find(slot) != global_filter_source_slots_.end();
+  }
+
+  // Returns true if this fragment instance receives any global filters.
+  bool has_global_filter_targets() const { return !global_filter_target_slots_.empty(); }
+
+  // Sends the global filter on 'slot' built by this fragment instance to the
+  // coordinator. 'filter' is NULL if the filter could not be built, which disables it
+  // for the whole query. Failures are logged and otherwise ignored since the filter is
+  // only an optimization.
+  void PublishGlobalFilter(SlotId slot, const BloomFilter* filter);
+
+  // Installs the merged global filter sent by the coordinator. Thread safe.
+  void SetGlobalFilter(const TPublishFilterParams& params);
+
+  // Blocks until all the global filters this fragment instance receives have arrived or
+  // 'timeout_ms' have passed. Returns false on timeout.
+  bool WaitForGlobalFilters(int64_t timeout_ms);
+
+  // Returns the global filter on 'slot'. Returns NULL if the filter has not arrived or
+  // was disabled. Thread safe. A returned filter is valid for the lifetime of this
+  // object.
+  const BloomFilter* GetGlobalFilter(SlotId slot);
+
+  // Returns the hash of slot value 'value' to insert into or look up in a global filter.
+  // Unlike fragment_hash_seed(), this does not depend on the fragment so that filters
+  // built by different fragments can be merged.
+  static uint64_t GetGlobalFilterHash(const void* value, const ColumnType& type);
+
+  // Log2 of the number of blocks of a global filter. All global filters have the same
+  // size so that they can be merged.
+  static int global_filter_log_num_blocks();
+
+  // The distribution of an adaptive join exchange (see
+  // TDataStreamSink.adaptive_join_node_id) is decided by the coordinator from the sizes
+  // of the build side reported by the senders, and published to all of its senders.
+
+  // Reports the size of the build side of the exchange of 'join_node_id' that this
+  // fragment instance has produced so far to the coordinator. 'eos' is true if these
+  // are all its rows. The exchange's senders wait for the decision, so unlike the
+  // global filters a failure is returned.
+  Status UpdateBuildSize(PlanNodeId join_node_id, int64_t num_bytes, int64_t num_rows,
+      bool eos);
+
+  // Installs the mode of an adaptive join exchange sent by the coordinator. Thread safe.
+  void SetExchangeMode(const TPublishExchangeModeParams& params);
+
+  // Returns true and sets 'broadcast' if the mode of the exchange of 'join_node_id' has
+  // arrived. Thread safe.
+  bool GetExchangeMode(PlanNodeId join_node_id, bool* broadcast);
+
+  // Blocks until the mode of the exchange of 'join_node_id' has arrived. Returns
+  // CANCELLED if the fragment instance is cancelled first.
+  Status WaitForExchangeMode(PlanNodeId join_node_id, bool* broadcast);
+
   PartitionStatusMap* per_partition_status() { return &per_partition_status_; }
 
   // Returns runtime state profile
@@ -386,6 +460,27 @@ class RuntimeState {
   // value can be filtered out. These filters are generated during the query execution.
   boost::unordered_map<SlotId, Bitmap*> slot_bitmap_filters_;
 
+  // Probe slots this fragment instance builds global filters on.
+  std::set<SlotId> global_filter_source_slots_;
+
+  // Slots this fragment instance receives global filters on.
+  std::set<SlotId> global_filter_target_slots_;
+
+  // Protects global_filters_. Signalled by global_filter_cv_ when a filter arrives.
+  boost::mutex global_filter_lock_;
+  boost::condition_variable global_filter_cv_;
+
+  // Global filters that have arrived, keyed by slot. Disabled filters are NULL. Owned.
+  boost::unordered_map<SlotId, BloomFilter*> global_filters_;
+
+  // Protects exchange_modes_. Signalled by exchange_mode_cv_ when a mode arrives.
+  boost::mutex exchange_mode_lock_;
+  boost::condition_variable exchange_mode_cv_;
+
+  // Modes of the adaptive join exchanges that have arrived, keyed by join node id. True
+  // if the join is broadcast.
+  boost::unordered_map<PlanNodeId, bool> exchange_modes_;
+
   // prohibit copies
   RuntimeState(const RuntimeState&);
 };
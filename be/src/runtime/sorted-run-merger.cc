@@ -38,6 +38,7 @@ class SortedRunMerger::BatchedRowSupplier {
     : sorted_run_(sorted_run),
       input_row_batch_(NULL),
       input_row_batch_index_(-1),
+      done_(false),
       parent_(parent) {
   }
 
@@ -89,70 +90,78 @@ class SortedRunMerger::BatchedRowSupplier {
   // Index into input_row_batch_ of the current row being processed.
   int input_row_batch_index_;
 
+  // True if the run is exhausted.
+  bool done_;
+
   // The parent merger instance.
   SortedRunMerger* parent_;
 };
 
-void SortedRunMerger::Heapify(int parent_index) {
-  int left_index = 2 * parent_index + 1;
-  int right_index = left_index + 1;
-  if (left_index >= min_heap_.size()) return;
-  int least_child;
-  // Find the least child of parent.
-  if (right_index >= min_heap_.size() ||
-      compare_less_than_(min_heap_[left_index]->current_row(),
-          min_heap_[right_index]->current_row())) {
-    least_child = left_index;
-  } else {
-    least_child = right_index;
+inline bool SortedRunMerger::Wins(int lhs, int rhs) {
+  if (runs_[lhs]->done_) return false;
+  if (runs_[rhs]->done_) return true;
+  return compare_less_than_(runs_[lhs]->current_row(), runs_[rhs]->current_row());
+}
+
+int SortedRunMerger::BuildTree(int node) {
+  int num_runs = runs_.size();
+  if (node >= num_runs) return node - num_runs;
+  int left = BuildTree(2 * node);
+  int right = BuildTree(2 * node + 1);
+  if (Wins(right, left)) {
+    loser_tree_[node] = left;
+    return right;
   }
+  loser_tree_[node] = right;
+  return left;
+}
 
-  // If the parent is out of place, swap it with the least child and invoke
-  // Heapify recursively.
-  if (compare_less_than_(min_heap_[least_child]->current_row(),
-      min_heap_[parent_index]->current_row())) {
-    iter_swap(min_heap_.begin() + least_child, min_heap_.begin() + parent_index);
-    Heapify(least_child);
+void SortedRunMerger::Replay(int run) {
+  int winner = run;
+  for (int node = (runs_.size() + run) / 2; node > 0; node /= 2) {
+    if (Wins(loser_tree_[node], winner)) std::swap(loser_tree_[node], winner);
   }
+  loser_tree_[0] = winner;
 }
 
 SortedRunMerger::SortedRunMerger(const TupleRowComparator& compare_less_than,
     RowDescriptor* row_desc, RuntimeProfile* profile, bool deep_copy_input)
   : compare_less_than_(compare_less_than),
     input_row_desc_(row_desc),
-    deep_copy_input_(deep_copy_input) {
+    deep_copy_input_(deep_copy_input),
+    num_active_runs_(0) {
   get_next_timer_ = ADD_TIMER(profile, "MergeGetNext");
   get_next_batch_timer_ = ADD_TIMER(profile, "MergeGetNextBatch");
 }
 
 Status SortedRunMerger::Prepare(const vector<RunBatchSupplier>& input_runs) {
-  DCHECK_EQ(min_heap_.size(), 0);
-  min_heap_.reserve(input_runs.size());
+  DCHECK_EQ(runs_.size(), 0);
+  runs_.reserve(input_runs.size());
   BOOST_FOREACH(const RunBatchSupplier& input_run, input_runs) {
     BatchedRowSupplier* new_elem = pool_.Add(new BatchedRowSupplier(this, input_run));
     bool empty;
     RETURN_IF_ERROR(new_elem->Init(&empty));
-    if (!empty) min_heap_.push_back(new_elem);
-  }
-
-  // Construct the min heap from the sorted runs.
-  int last_parent = (min_heap_.size() / 2) - 1;
-  for (int i = last_parent; i >= 0; --i) {
-    Heapify(i);
+    if (!empty) runs_.push_back(new_elem);
   }
+  num_active_runs_ = runs_.size();
+  if (runs_.empty()) return Status::OK;
 
+  // Play the initial tournament between the sorted runs.
+  loser_tree_.resize(runs_.size());
+  loser_tree_[0] = BuildTree(1);
   return Status::OK;
 }
 
 Status SortedRunMerger::GetNext(RowBatch* output_batch, bool* eos) {
   ScopedTimer<MonotonicStopWatch> timer(get_next_timer_);
-  if (min_heap_.empty()) {
+  if (num_active_runs_ == 0) {
     *eos = true;
     return Status::OK;
   }
 
   while (!output_batch->AtCapacity()) {
-    BatchedRowSupplier* min = min_heap_[0];
+    int min_run = loser_tree_[0];
+    BatchedRowSupplier* min = runs_[min_run];
     int output_row_index = output_batch->AddRow();
     TupleRow* output_row = output_batch->GetRow(output_row_index);
     if (deep_copy_input_) {
@@ -172,16 +181,15 @@ Status SortedRunMerger::GetNext(RowBatch* output_batch, bool* eos) {
     RETURN_IF_ERROR(min->Next(deep_copy_input_ ? NULL : output_batch,
         &min_run_complete));
     if (min_run_complete) {
-      // Remove the element from the heap.
-      iter_swap(min_heap_.begin(), min_heap_.end() - 1);
-      min_heap_.pop_back();
-      if (min_heap_.empty()) break;
+      // The exhausted run stays in the tree and loses every match from now on.
+      min->done_ = true;
+      if (--num_active_runs_ == 0) break;
     }
 
-    Heapify(0);
+    Replay(min_run);
   }
 
-  *eos = min_heap_.empty();
+  *eos = num_active_runs_ == 0;
   return Status::OK;
 }
 
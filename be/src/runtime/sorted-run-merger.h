@@ -30,8 +30,11 @@ class RuntimeProfile;
 
 // SortedRunMerger is used to merge multiple sorted runs of tuples. A run is a sorted
 // sequence of row batches, which are fetched from a RunBatchSupplier function object.
-// Merging is implemented using a binary min-heap that maintains the run with the next
-// tuple in sorted order at the top of the heap.
+// Merging is implemented using a loser tree (tournament tree) over the runs. Every
+// internal node of the tree holds the run that lost the match at that node and the
+// root holds the overall winner, i.e. the run with the next tuple in sorted order.
+// After the winner advanced, only the matches on the path from its leaf to the root
+// are replayed, which takes one comparison per level (a binary heap needs two).
 //
 // Merged batches of rows are retrieved from SortedRunMerger via calls to GetNext().
 // The merger is constructed with a boolean flag deep_copy_input.
@@ -64,18 +67,29 @@ class SortedRunMerger {
  private:
   class BatchedRowSupplier;
 
-  // Assuming the element at parent_index is the only out of place element in the heap,
-  // restore the heap property (i.e. swap elements so parent <= children).
-  void Heapify(int parent_index);
-
-  // The binary min-heap used to merge rows from the sorted input runs. Since the heap is
-  // stored in a 0-indexed array, the 0-th element is the minimum element in the heap,
-  // and the children of the element at index i are 2*i+1 and 2*i+2. The heap property is
-  // that row of the parent element is <= the rows of the child elements according to the
-  // comparator compare_less_than_.
-  // The BatchedRowSupplier objects used in the min_heap_ are owned by this
-  // SortedRunMerger instance.
-  std::vector<BatchedRowSupplier*> min_heap_;
+  // Returns true if run 'lhs' wins against run 'rhs', i.e. if its current row comes
+  // first. Exhausted runs lose against all others.
+  bool Wins(int lhs, int rhs);
+
+  // Plays the matches of the subtree rooted at 'node', stores the losers in
+  // loser_tree_ and returns the index of the winning run.
+  int BuildTree(int node);
+
+  // Replays the matches on the path from the leaf of 'run' to the root after the
+  // current row of 'run' changed, and stores the new winner in loser_tree_[0].
+  void Replay(int run);
+
+  // The non-empty input runs. Owned by pool_.
+  std::vector<BatchedRowSupplier*> runs_;
+
+  // The loser tree, stored like a binary heap: the children of node i are 2*i and
+  // 2*i+1 and the leaf of run r is node runs_.size() + r (leaves are not stored).
+  // Internal nodes [1, runs_.size()) hold the index of the run that lost the match at
+  // the node, loser_tree_[0] holds the index of the winning run.
+  std::vector<int> loser_tree_;
+
+  // Number of runs in runs_ that are not exhausted.
+  int num_active_runs_;
 
   // Row comparator. Returns true if lhs < rhs.
   TupleRowComparator compare_less_than_;
@@ -0,0 +1,226 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+
+#include <gtest/gtest.h>
+#include "common/init.h"
+#include "common/object-pool.h"
+#include "exprs/expr-context.h"
+#include "exprs/slot-ref.h"
+#include "runtime/descriptors.h"
+#include "runtime/disk-io-mgr.h"
+#include "runtime/exec-env.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/sorter.h"
+#include "runtime/thread-resource-mgr.h"
+#include "runtime/tmp-file-mgr.h"
+#include "runtime/tuple-row.h"
+#include "testutil/desc-tbl-builder.h"
+#include "util/cpu-info.h"
+#include "util/runtime-profile.h"
+#include "util/test-info.h"
+
+#include "gen-cpp/ImpalaInternalService_types.h"
+
+using namespace boost;
+using namespace std;
+
+DECLARE_int32(read_size);
+DECLARE_int32(sort_run_threads);
+
+namespace impala {
+
+// Small blocks, so that the sort spills after a few hundred thousand rows.
+static const int BLOCK_SIZE = 128 * 1024;
+static const int64_t BLOCK_MGR_MEM = 40 * BLOCK_SIZE;
+// Enough rows for several runs, each of which is large enough to be sorted by
+// multiple threads.
+static const int NUM_ROWS = 2 * 1024 * 1024;
+static const int BATCH_SIZE = 1024;
+
+class SorterTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    // The block size of the block mgr is the read size of the io mgr.
+    FLAGS_read_size = BLOCK_SIZE;
+    exec_env_.reset(new ExecEnv);
+    exec_env_->disk_io_mgr()->Init(&tracker_);
+    TPlanFragmentInstanceCtx fragment_instance_ctx;
+    fragment_instance_ctx.query_ctx.request.query_options.__set_max_block_mgr_memory(
+        BLOCK_MGR_MEM);
+    runtime_state_.reset(new RuntimeState(fragment_instance_ctx, "", exec_env_.get()));
+    runtime_state_->InitMemTrackers(TUniqueId(), NULL, -1);
+    ASSERT_TRUE(runtime_state_->CreateBlockMgr().ok());
+
+    // The input rows and the sort tuples both have a single BIGINT slot.
+    DescriptorTblBuilder builder(&pool_);
+    builder.DeclareTuple() << TYPE_BIGINT;
+    DescriptorTbl* desc_tbl = builder.Build();
+    vector<bool> nullable_tuples(1, false);
+    vector<TTupleId> tuple_ids(1, static_cast<TTupleId>(0));
+    row_desc_ = pool_.Add(new RowDescriptor(*desc_tbl, tuple_ids, nullable_tuples));
+    tuple_desc_ = desc_tbl->GetTupleDescriptor(0);
+    slot_offset_ = tuple_desc_->slots()[0]->tuple_offset();
+
+    slot_ctxs_.push_back(pool_.Add(new ExprContext(
+        pool_.Add(new SlotRef(TYPE_BIGINT, slot_offset_)))));
+    ASSERT_TRUE(Expr::Prepare(slot_ctxs_, runtime_state_.get(), *row_desc_,
+        &tracker_).ok());
+    ASSERT_TRUE(Expr::Open(slot_ctxs_, runtime_state_.get()).ok());
+  }
+
+  virtual void TearDown() {
+    Expr::Close(slot_ctxs_, runtime_state_.get());
+    runtime_state_.reset();
+    exec_env_.reset();
+  }
+
+  // Returns a batch with the next 'num_rows' values of 'values', starting at 'start'.
+  RowBatch* CreateBatch(const vector<int64_t>& values, int start, int num_rows) {
+    RowBatch* batch = new RowBatch(*row_desc_, num_rows, &tracker_);
+    uint8_t* tuple_mem = batch->tuple_data_pool()->Allocate(
+        tuple_desc_->byte_size() * num_rows);
+    memset(tuple_mem, 0, tuple_desc_->byte_size() * num_rows);
+    for (int i = 0; i < num_rows; ++i) {
+      Tuple* tuple = reinterpret_cast<Tuple*>(tuple_mem);
+      *reinterpret_cast<int64_t*>(tuple->GetSlot(slot_offset_)) = values[start + i];
+      int row_idx = batch->AddRow();
+      batch->GetRow(row_idx)->SetTuple(0, tuple);
+      batch->CommitLastRow();
+      tuple_mem += tuple_desc_->byte_size();
+    }
+    return batch;
+  }
+
+  // Sorts NUM_ROWS random values with a sorter that uses up to 'num_threads' threads
+  // and checks the output. Returns the sorter's profile.
+  RuntimeProfile* Sort(int num_threads) {
+    FLAGS_sort_run_threads = num_threads;
+    vector<int64_t> values(NUM_ROWS);
+    // Some duplicates, so that the partitioning steps see equal keys.
+    for (int i = 0; i < NUM_ROWS; ++i) values[i] = rand() % (NUM_ROWS / 2);
+
+    RuntimeProfile* profile = pool_.Add(new RuntimeProfile(&pool_, "Sorter"));
+    TupleRowComparator less_than(slot_ctxs_, slot_ctxs_, true, false);
+    scoped_ptr<Sorter> sorter(new Sorter(less_than, slot_ctxs_, row_desc_,
+        runtime_state_->instance_mem_tracker(), profile, runtime_state_.get()));
+    Status status = sorter->Init();
+    EXPECT_TRUE(status.ok()) << status.GetDetail();
+    for (int i = 0; i < NUM_ROWS; i += BATCH_SIZE) {
+      scoped_ptr<RowBatch> batch(CreateBatch(values, i, min(BATCH_SIZE, NUM_ROWS - i)));
+      status = sorter->AddBatch(batch.get());
+      EXPECT_TRUE(status.ok()) << status.GetDetail();
+      if (!status.ok()) return profile;
+    }
+    status = sorter->InputDone();
+    EXPECT_TRUE(status.ok()) << status.GetDetail();
+
+    sort(values.begin(), values.end());
+    RowBatch output_batch(*row_desc_, BATCH_SIZE, &tracker_);
+    int num_output_rows = 0;
+    bool eos = false;
+    while (!eos && status.ok()) {
+      status = sorter->GetNext(&output_batch, &eos);
+      EXPECT_TRUE(status.ok()) << status.GetDetail();
+      for (int i = 0; i < output_batch.num_rows(); ++i) {
+        Tuple* tuple = output_batch.GetRow(i)->GetTuple(0);
+        int64_t value = *reinterpret_cast<int64_t*>(tuple->GetSlot(slot_offset_));
+        if (num_output_rows < NUM_ROWS) {
+          EXPECT_EQ(values[num_output_rows], value) << "row " << num_output_rows;
+        }
+        ++num_output_rows;
+      }
+      output_batch.Reset();
+    }
+    EXPECT_EQ(NUM_ROWS, num_output_rows);
+    return profile;
+  }
+
+  static int64_t CounterValue(RuntimeProfile* profile, const string& name) {
+    RuntimeProfile::Counter* counter = profile->GetCounter(name);
+    EXPECT_TRUE(counter != NULL) << name;
+    return counter == NULL ? 0 : counter->value();
+  }
+
+  ObjectPool pool_;
+  MemTracker tracker_;
+  scoped_ptr<ExecEnv> exec_env_;
+  scoped_ptr<RuntimeState> runtime_state_;
+  RowDescriptor* row_desc_;
+  TupleDescriptor* tuple_desc_;
+  int slot_offset_;
+  vector<ExprContext*> slot_ctxs_;
+};
+
+TEST_F(SorterTest, SingleThread) {
+  RuntimeProfile* profile = Sort(1);
+  EXPECT_GT(CounterValue(profile, "InitialRunsCreated"), 1);
+  EXPECT_EQ(CounterValue(profile, "RunsSortedInParallel"), 0);
+  EXPECT_EQ(CounterValue(profile, "RunsSortedInBackground"), 0);
+}
+
+TEST_F(SorterTest, MultipleThreads) {
+  RuntimeProfile* profile = Sort(4);
+  EXPECT_GT(CounterValue(profile, "InitialRunsCreated"), 1);
+  // The number of threads is limited by the number of cores.
+  if (CpuInfo::num_cores() > 1) {
+    EXPECT_GT(CounterValue(profile, "RunsSortedInParallel"), 0);
+    EXPECT_GT(CounterValue(profile, "RunsSortedInBackground"), 0);
+  }
+}
+
+TEST_F(SorterTest, NoThreadTokens) {
+  // Without thread tokens, the calling thread sorts every run itself.
+  runtime_state_->resource_pool()->set_max_quota(0);
+  RuntimeProfile* profile = Sort(4);
+  EXPECT_GT(CounterValue(profile, "InitialRunsCreated"), 1);
+  EXPECT_EQ(CounterValue(profile, "RunsSortedInParallel"), 0);
+  EXPECT_EQ(CounterValue(profile, "RunsSortedInBackground"), 0);
+}
+
+TEST_F(SorterTest, CancelledSortReleasesThreadTokens) {
+  FLAGS_sort_run_threads = 4;
+  vector<int64_t> values(NUM_ROWS);
+  for (int i = 0; i < NUM_ROWS; ++i) values[i] = rand();
+  RuntimeProfile* profile = pool_.Add(new RuntimeProfile(&pool_, "Sorter"));
+  TupleRowComparator less_than(slot_ctxs_, slot_ctxs_, true, false);
+  scoped_ptr<Sorter> sorter(new Sorter(less_than, slot_ctxs_, row_desc_,
+      runtime_state_->instance_mem_tracker(), profile, runtime_state_.get()));
+  ASSERT_TRUE(sorter->Init().ok());
+  for (int i = 0; i < NUM_ROWS; i += BATCH_SIZE) {
+    scoped_ptr<RowBatch> batch(CreateBatch(values, i, min(BATCH_SIZE, NUM_ROWS - i)));
+    ASSERT_TRUE(sorter->AddBatch(batch.get()).ok());
+  }
+  // The sort of the last run stops early, after taking the tokens of its threads.
+  runtime_state_->set_is_cancelled(true);
+  EXPECT_FALSE(sorter->InputDone().ok());
+  sorter.reset();
+  EXPECT_EQ(runtime_state_->resource_pool()->num_optional_threads(), 0);
+}
+
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::InitCommonRuntime(argc, argv, false, impala::TestInfo::BE_TEST);
+  impala::TmpFileMgr::Init();
+  return RUN_ALL_TESTS();
+}
@@ -14,22 +14,48 @@
 
 #include "runtime/sorter.h"
 #include <gutil/strings/substitute.h>
+#include <limits>
 
 #include "runtime/buffered-block-mgr.h"
+#include "runtime/mem-tracker.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "runtime/sorted-run-merger.h"
+#include "runtime/thread-resource-mgr.h"
+#include "util/cpu-info.h"
+#include "util/key-normalizer.inline.h"
+#include "util/normalized-key-sorter.h"
 #include "util/runtime-profile.h"
+#include "util/thread.h"
 
 using namespace boost;
 using namespace std;
 using namespace strings;
 
+DEFINE_int32(sort_run_threads, 4, "(Advanced) Maximum number of threads used to sort "
+    "each in-memory run of a sort. If greater than 1, the runs of a sort that spills "
+    "are also sorted in the background while the next run is collected. Threads beyond "
+    "the calling one are only used if thread tokens are available.");
+DEFINE_bool(sort_normalized_keys, true, "(Advanced) If true, sorts runs by a radix sort "
+    "of normalized key prefixes and only compares tuples with the sort exprs if their "
+    "key prefixes are equal.");
+
 namespace impala {
 
 // Number of pinned blocks required for a merge.
 const int BLOCKS_REQUIRED_FOR_MERGE = 3;
 
+// Minimum number of tuples per thread for a run to be sorted by multiple threads.
+const int64_t MIN_TUPLES_PER_SORT_THREAD = 64 * 1024;
+
+// Number of key ranges per thread a run is split into before sorting it in parallel.
+// More ranges than threads even out the work if the partitioning steps are uneven.
+const int RANGES_PER_SORT_THREAD = 4;
+
+// Minimum number of blocks in the unsorted runs that are sorted in the background.
+// Limiting runs to fewer blocks would create too many runs to merge.
+const int MIN_BLOCKS_PER_BACKGROUND_RUN = 8;
+
 // Error message when pinning fixed or variable length blocks failed.
 // TODO: Add the node id that iniated the sort
 const string PIN_FAILED_ERROR_MSG = "Failed to pin block for $0-length data needed "
@@ -72,6 +98,12 @@ class Sorter::Run {
   // Deletes all blocks.
   void DeleteAllBlocks();
 
+  // Number of blocks currently held by this run.
+  int num_blocks() const {
+    return fixed_len_blocks_.size() + var_len_blocks_.size() +
+        (var_len_copy_block_ != NULL ? 1 : 0);
+  }
+
   // Interface for merger - get the next batch of rows from this run. The callee (Run)
   // still owns the returned batch. Calls GetNext(RowBatch*, bool*).
   Status GetNextBatch(RowBatch** sorted_batch);
@@ -199,10 +231,17 @@ class Sorter::Run {
 // Quick sort is used for sequences of tuples larger that 16 elements, and insertion sort
 // is used for smaller sequences. The TupleSorter is initialized with a RuntimeState
 // instance to check for cancellation during an in-memory sort.
+// If the leading sort keys can be normalized (see KeyNormalizer), a sequence of tuples
+// is instead sorted by computing a normalized key prefix for each tuple, radix sorting
+// the prefixes together with the tuple indices (see NormalizedKeySorter) and then
+// moving the tuples into the sorted order. The comparator is only evaluated for tuples
+// with equal prefixes, and only if some key did not fit into its prefix. The memory for
+// the prefixes is counted against 'mem_tracker'; if it is not available, the quick sort
+// is used.
 class Sorter::TupleSorter {
  public:
   TupleSorter(const TupleRowComparator& less_than_comp, int64_t block_size,
-      int tuple_size, RuntimeState* state);
+      int tuple_size, RuntimeState* state, MemTracker* mem_tracker);
 
   ~TupleSorter();
 
@@ -212,6 +251,15 @@ class Sorter::TupleSorter {
   // is returned - the caller must check for cancellation.
   void Sort(Run* run);
 
+  // Splits the tuples of 'run' into at most 'num_ranges' ranges [first, last) of tuple
+  // indices by partitioning them in place, so that every tuple in a range is <= every
+  // tuple in the following ranges. The ranges can then be sorted independently.
+  // Returns early with an incomplete split if state_->is_cancelled() is true.
+  void Split(Run* run, int num_ranges, vector<pair<int64_t, int64_t> >* ranges);
+
+  // Sorts each of the 'ranges' of tuples in 'run'. Does not mark the run as sorted.
+  void SortRanges(Run* run, const vector<pair<int64_t, int64_t> >* ranges);
+
  private:
   static const int INSERTION_THRESHOLD = 16;
 
@@ -329,6 +377,46 @@ class Sorter::TupleSorter {
 
   // Swaps tuples pointed to by left and right using the swap buffer.
   void Swap(uint8_t* left, uint8_t* right);
+
+  // Sorts the tuples in the range [first, last) with SortNormalized() if possible and
+  // with SortHelper() otherwise.
+  void SortRange(int64_t first, int64_t last);
+
+  // Sorts the tuples in the range [first, last) by their normalized keys. Returns false
+  // without modifying the run if the memory for the keys could not be reserved.
+  // Checks state_->is_cancelled() and returns early if true.
+  bool SortNormalized(int64_t first, int64_t last);
+
+  // Returns the tuple with index 'index' in run_.
+  uint8_t* GetTuple(int64_t index) {
+    return run_->fixed_len_blocks_[index / block_capacity_]->buffer() +
+        (index % block_capacity_) * tuple_size_;
+  }
+
+  // Compares the tuples of run_ at offsets 'lhs' and 'rhs' from 'first' with
+  // less_than_comp_. Breaks ties between equal normalized keys.
+  struct TupleIndexLessThan {
+    TupleIndexLessThan(TupleSorter* sorter, int64_t first)
+      : sorter_(sorter), first_(first) { }
+    bool operator()(uint32_t lhs, uint32_t rhs) const {
+      return sorter_->less_than_comp_(
+          reinterpret_cast<Tuple*>(sorter_->GetTuple(first_ + lhs)),
+          reinterpret_cast<Tuple*>(sorter_->GetTuple(first_ + rhs)));
+    }
+    TupleSorter* sorter_;
+    int64_t first_;
+  };
+
+  // Memory for the normalized keys is counted against this tracker. Not owned.
+  MemTracker* const mem_tracker_;
+
+  // Normalizes the leading sort keys that can be normalized. NULL if the first key
+  // cannot be normalized or --sort_normalized_keys is false.
+  boost::scoped_ptr<KeyNormalizer> key_normalizer_;
+
+  // True if key_normalizer_ normalizes all sort keys, i.e. if equal normalized keys that
+  // did not go over the budget belong to equal tuples.
+  bool normalizes_all_keys_;
 }; // class TupleSorter
 
 // Sorter::Run methods
@@ -717,6 +805,11 @@ Status Sorter::Run::TryAddBlock(vector<BufferedBlockMgr::Block*>* block_sequence
   DCHECK(!block_sequence->empty());
   BufferedBlockMgr::Block* last_block = block_sequence->back();
   if (!is_sorted_) {
+    if (sorter_->max_blocks_per_unsorted_run_ > 0 &&
+        num_blocks() >= sorter_->max_blocks_per_unsorted_run_) {
+      *added = false;
+      return Status::OK;
+    }
     sorter_->sorted_data_size_->Add(last_block->valid_data_len());
     last_block = NULL;
   } else {
@@ -755,15 +848,33 @@ void Sorter::Run::CopyVarLenDataConvertOffset(char* dest, int64_t offset,
 
 // Sorter::TupleSorter methods.
 Sorter::TupleSorter::TupleSorter(const TupleRowComparator& comp, int64_t block_size,
-    int tuple_size, RuntimeState* state)
+    int tuple_size, RuntimeState* state, MemTracker* mem_tracker)
   : tuple_size_(tuple_size),
     block_capacity_(block_size / tuple_size),
     last_tuple_block_offset_(tuple_size * ((block_size / tuple_size) - 1)),
     less_than_comp_(comp),
-    state_(state) {
+    state_(state),
+    mem_tracker_(mem_tracker),
+    normalizes_all_keys_(false) {
   temp_tuple_buffer_ = new uint8_t[tuple_size];
   temp_tuple_row_ = reinterpret_cast<TupleRow*>(&temp_tuple_buffer_);
   swap_buffer_ = new uint8_t[tuple_size];
+
+  if (!FLAGS_sort_normalized_keys) return;
+  const vector<ExprContext*>& key_expr_ctxs = less_than_comp_.key_expr_ctxs_lhs();
+  vector<ExprContext*> normalized_ctxs;
+  vector<bool> is_asc;
+  vector<bool> nulls_first;
+  for (int i = 0; i < key_expr_ctxs.size(); ++i) {
+    if (!KeyNormalizer::IsSupported(key_expr_ctxs[i]->root()->type())) break;
+    normalized_ctxs.push_back(key_expr_ctxs[i]);
+    is_asc.push_back(less_than_comp_.is_asc(i));
+    nulls_first.push_back(less_than_comp_.nulls_first(i));
+  }
+  if (normalized_ctxs.empty()) return;
+  key_normalizer_.reset(new KeyNormalizer(normalized_ctxs, NormalizedKeySorter::KEY_LEN,
+      is_asc, nulls_first));
+  normalizes_all_keys_ = normalized_ctxs.size() == key_expr_ctxs.size();
 }
 
 Sorter::TupleSorter::~TupleSorter() {
@@ -773,10 +884,103 @@ Sorter::TupleSorter::~TupleSorter() {
 
 void Sorter::TupleSorter::Sort(Run* run) {
   run_ = run;
-  SortHelper(TupleIterator(this, 0), TupleIterator(this, run_->num_tuples_));
+  SortRange(0, run_->num_tuples_);
   run->is_sorted_ = true;
 }
 
+void Sorter::TupleSorter::Split(Run* run, int num_ranges,
+    vector<pair<int64_t, int64_t> >* ranges) {
+  run_ = run;
+  ranges->clear();
+  ranges->push_back(make_pair(0L, run_->num_tuples_));
+  // Keep splitting the largest range with the same partitioning step as SortHelper().
+  while (ranges->size() < num_ranges) {
+    int largest = 0;
+    for (int i = 1; i < ranges->size(); ++i) {
+      if ((*ranges)[i].second - (*ranges)[i].first >
+          (*ranges)[largest].second - (*ranges)[largest].first) {
+        largest = i;
+      }
+    }
+    int64_t first = (*ranges)[largest].first;
+    int64_t last = (*ranges)[largest].second;
+    if (last - first <= INSERTION_THRESHOLD) break;
+    TupleIterator pivot(this, first + (last - first) / 2);
+    TupleIterator cut = Partition(TupleIterator(this, first), TupleIterator(this, last),
+        reinterpret_cast<Tuple*>(pivot.current_tuple_));
+    if (UNLIKELY(state_->is_cancelled())) return;
+    // Stop if the partitioning step did not split the range, e.g. all keys are equal.
+    if (cut.index_ <= first || cut.index_ >= last) break;
+    (*ranges)[largest].second = cut.index_;
+    ranges->push_back(make_pair(cut.index_, last));
+  }
+}
+
+void Sorter::TupleSorter::SortRanges(Run* run,
+    const vector<pair<int64_t, int64_t> >* ranges) {
+  run_ = run;
+  for (int i = 0; i < ranges->size(); ++i) {
+    SortRange((*ranges)[i].first, (*ranges)[i].second);
+  }
+}
+
+void Sorter::TupleSorter::SortRange(int64_t first, int64_t last) {
+  if (key_normalizer_.get() != NULL && last - first > INSERTION_THRESHOLD &&
+      SortNormalized(first, last)) {
+    return;
+  }
+  SortHelper(TupleIterator(this, first), TupleIterator(this, last));
+}
+
+bool Sorter::TupleSorter::SortNormalized(int64_t first, int64_t last) {
+  int64_t num_tuples = last - first;
+  // Entries refer to tuples by 32-bit offsets.
+  if (num_tuples > numeric_limits<uint32_t>::max()) return false;
+  int64_t entries_bytes = num_tuples * sizeof(NormalizedKeySorter::Entry);
+  if (!mem_tracker_->TryConsume(entries_bytes)) return false;
+  NormalizedKeySorter::Entry* entries = new NormalizedKeySorter::Entry[num_tuples];
+
+  bool went_over_budget = false;
+  TupleIterator iter(this, first);
+  for (int64_t i = 0; i < num_tuples; ++i) {
+    went_over_budget |= key_normalizer_->NormalizeKey(
+        reinterpret_cast<TupleRow*>(&iter.current_tuple_), entries[i].key);
+    entries[i].index = i;
+    iter.Next();
+  }
+
+  if (LIKELY(!state_->is_cancelled())) {
+    // Equal keys only need to be compared further if they may belong to different
+    // tuples.
+    TupleIndexLessThan tie_less_than(this, first);
+    NormalizedKeySorter::Sort(entries, entries + num_tuples,
+        went_over_budget || !normalizes_all_keys_ ? &tie_less_than : NULL);
+
+    // Move the tuples into the sorted order by following the cycles of the
+    // permutation. An entry's index is reset to its position once that position holds
+    // the right tuple.
+    for (int64_t i = 0; i < num_tuples; ++i) {
+      if (entries[i].index == i) continue;
+      memcpy(temp_tuple_buffer_, GetTuple(first + i), tuple_size_);
+      int64_t dst = i;
+      while (true) {
+        int64_t src = entries[dst].index;
+        entries[dst].index = dst;
+        if (src == i) {
+          memcpy(GetTuple(first + dst), temp_tuple_buffer_, tuple_size_);
+          break;
+        }
+        memcpy(GetTuple(first + dst), GetTuple(first + src), tuple_size_);
+        dst = src;
+      }
+    }
+  }
+
+  delete[] entries;
+  mem_tracker_->Release(entries_bytes);
+  return true;
+}
+
 // Sort the sequence of tuples from [first, last).
 // Begin with a sorted sequence of size 1 [first, first+1).
 // During each pass of the outermost loop, add the next tuple (at position 'i') to
@@ -871,6 +1075,7 @@ Sorter::Sorter(const TupleRowComparator& compare_less_than,
     RuntimeProfile* profile, RuntimeState* state)
   : state_(state),
     compare_less_than_(compare_less_than),
+    max_blocks_per_unsorted_run_(0),
     block_mgr_(state->block_mgr()),
     unsorted_run_(NULL),
     output_row_desc_(output_row_desc),
@@ -880,6 +1085,9 @@ Sorter::Sorter(const TupleRowComparator& compare_less_than,
 }
 
 Sorter::~Sorter() {
+  // The background sort may still be running if the sort was cancelled or failed.
+  WaitForBackgroundSort();
+  Expr::Close(cloned_expr_ctxs_, state_);
   // Delete all blocks from the block mgr.
   for (list<Run*>::iterator it = sorted_runs_.begin(); it != sorted_runs_.end(); ++it) {
     (*it)->DeleteAllBlocks();
@@ -895,14 +1103,27 @@ Status Sorter::Init() {
   DCHECK(unsorted_run_ == NULL) << "Already initialized";
   TupleDescriptor* sort_tuple_desc = output_row_desc_->tuple_descriptors()[0];
   has_var_len_slots_ = sort_tuple_desc->string_slots().size() > 0;
-  in_mem_tuple_sorter_.reset(new TupleSorter(compare_less_than_,
-      block_mgr_->max_block_size(), sort_tuple_desc->byte_size(), state_));
+  int num_sort_threads = max(1, min(FLAGS_sort_run_threads, CpuInfo::num_cores()));
+  for (int i = 0; i < num_sort_threads; ++i) {
+    TupleRowComparator less_than(compare_less_than_);
+    // Runs may be sorted on other threads than the one that created the sorter, so
+    // every sorter needs its own exprs once there is more than one thread.
+    if (num_sort_threads > 1) {
+      RETURN_IF_ERROR(less_than.CloneExprContexts(state_, &cloned_expr_ctxs_));
+    }
+    tuple_sorters_.push_back(obj_pool_.Add(new TupleSorter(less_than,
+        block_mgr_->max_block_size(), sort_tuple_desc->byte_size(), state_,
+        mem_tracker_)));
+  }
   unsorted_run_ = obj_pool_.Add(new Run(this, sort_tuple_desc, true));
 
   initial_runs_counter_ = ADD_COUNTER(profile_, "InitialRunsCreated", TUnit::UNIT);
   num_merges_counter_ = ADD_COUNTER(profile_, "TotalMergesPerformed", TUnit::UNIT);
   in_mem_sort_timer_ = ADD_TIMER(profile_, "InMemorySortTime");
   sorted_data_size_ = ADD_COUNTER(profile_, "SortDataSize", TUnit::BYTES);
+  parallel_sorts_counter_ = ADD_COUNTER(profile_, "RunsSortedInParallel", TUnit::UNIT);
+  background_sorts_counter_ =
+      ADD_COUNTER(profile_, "RunsSortedInBackground", TUnit::UNIT);
 
   int min_blocks_required = BLOCKS_REQUIRED_FOR_MERGE;
   // Fixed and var-length blocks are separate, so we need BLOCKS_REQUIRED_FOR_MERGE
@@ -933,20 +1154,31 @@ Status Sorter::AddBatch(RowBatch* batch) {
     }
     cur_batch_index += num_processed;
     if (cur_batch_index < batch->num_rows()) {
-      // The current run is full. Sort it and begin the next one.
-      RETURN_IF_ERROR(SortRun());
-      RETURN_IF_ERROR(sorted_runs_.back()->UnpinAllBlocks());
+      // The current run is full. Sort it and begin the next one. Only one run is
+      // sorted in the background at a time.
+      RETURN_IF_ERROR(WaitForBackgroundSort());
+      bool first_run = sorted_runs_.empty();
+      int run_blocks = unsorted_run_->num_blocks();
+      RETURN_IF_ERROR(SortRun(true));
+      if (first_run && tuple_sorters_.size() > 1 &&
+          run_blocks / 2 >= MIN_BLOCKS_PER_BACKGROUND_RUN) {
+        // The first run got all the memory the sort could get. From now on, each run
+        // gets half of it, so one run can be collected while the previous one is
+        // sorted in the background.
+        max_blocks_per_unsorted_run_ = run_blocks / 2;
+      }
       unsorted_run_ = obj_pool_.Add(
           new Run(this, output_row_desc_->tuple_descriptors()[0], true));
-      unsorted_run_->Init();
+      RETURN_IF_ERROR(unsorted_run_->Init());
     }
   }
   return Status::OK;
 }
 
 Status Sorter::InputDone() {
+  RETURN_IF_ERROR(WaitForBackgroundSort());
   // Sort the tuples accumulated so far in the current run.
-  RETURN_IF_ERROR(SortRun());
+  RETURN_IF_ERROR(SortRun(false));
 
   if (sorted_runs_.size() == 1) {
     // The entire input fit in one run. Read sorted rows in GetNext() directly
@@ -1001,7 +1233,7 @@ Status Sorter::GetNext(RowBatch* output_batch, bool* eos) {
   return Status::OK;
 }
 
-Status Sorter::SortRun() {
+Status Sorter::SortRun(bool unpin) {
   BufferedBlockMgr::Block* last_block = unsorted_run_->fixed_len_blocks_.back();
   if (last_block->valid_data_len() > 0) {
     sorted_data_size_->Add(last_block->valid_data_len());
@@ -1023,16 +1255,118 @@ Status Sorter::SortRun() {
       }
     }
   }
-  {
-    SCOPED_TIMER(in_mem_sort_timer_);
-    in_mem_tuple_sorter_->Sort(unsorted_run_);
+  Run* run = unsorted_run_;
+  sorted_runs_.push_back(run);
+  unsorted_run_ = NULL;
+  // Like the build threads of the joins, the background sort needs a thread token.
+  // Without one, the run is sorted on the calling thread.
+  if (unpin && max_blocks_per_unsorted_run_ > 0 &&
+      state_->resource_pool()->TryAcquireThreadToken()) {
+    DCHECK(background_sort_thread_.get() == NULL);
+    COUNTER_ADD(background_sorts_counter_, 1);
+    background_sort_thread_.reset(
+        new Thread("sorter", "sort-run", &Sorter::SortAndUnpinRun, this, run));
+    return Status::OK;
+  }
+  RETURN_IF_ERROR(InMemorySort(run));
+  if (unpin) RETURN_IF_ERROR(run->UnpinAllBlocks());
+  return Status::OK;
+}
+
+// Thread tokens acquired from a resource pool. The tokens that were not handed over to
+// threads are released when this goes out of scope.
+class ScopedThreadTokens {
+ public:
+  ScopedThreadTokens(ThreadResourceMgr::ResourcePool* pool)
+    : pool_(pool), num_tokens_(0) {
+  }
+
+  ~ScopedThreadTokens() {
+    for (int i = 0; i < num_tokens_; ++i) pool_->ReleaseThreadToken(false);
+  }
+
+  bool TryAcquire() {
+    if (!pool_->TryAcquireThreadToken()) return false;
+    ++num_tokens_;
+    return true;
+  }
+
+  // Hands over a token to a thread, which must release it.
+  void Transfer() {
+    DCHECK_GT(num_tokens_, 0);
+    --num_tokens_;
+  }
+
+ private:
+  ThreadResourceMgr::ResourcePool* pool_;
+  int num_tokens_;
+};
+
+Status Sorter::InMemorySort(Run* run) {
+  SCOPED_TIMER(in_mem_sort_timer_);
+  int max_threads = min<int64_t>(tuple_sorters_.size(),
+      run->num_tuples_ / MIN_TUPLES_PER_SORT_THREAD);
+  // The calling thread sorts with tuple_sorters_[0]. Every additional thread needs a
+  // thread token, which it releases as soon as its ranges are sorted.
+  ScopedThreadTokens tokens(state_->resource_pool());
+  int num_threads = 1;
+  while (num_threads < max_threads && tokens.TryAcquire()) ++num_threads;
+  if (num_threads == 1) {
+    tuple_sorters_[0]->Sort(run);
+  } else {
+    COUNTER_ADD(parallel_sorts_counter_, 1);
+    vector<pair<int64_t, int64_t> > ranges;
+    tuple_sorters_[0]->Split(run, RANGES_PER_SORT_THREAD * num_threads, &ranges);
     RETURN_IF_CANCELLED(state_);
+    // Hand out the ranges, largest first, to the thread with the fewest tuples so far.
+    vector<pair<int64_t, int> > ranges_by_size;
+    for (int i = 0; i < ranges.size(); ++i) {
+      ranges_by_size.push_back(make_pair(ranges[i].second - ranges[i].first, i));
+    }
+    sort(ranges_by_size.rbegin(), ranges_by_size.rend());
+    vector<vector<pair<int64_t, int64_t> > > thread_ranges(num_threads);
+    vector<int64_t> thread_tuples(num_threads, 0);
+    for (int i = 0; i < ranges_by_size.size(); ++i) {
+      int thread_idx =
+          min_element(thread_tuples.begin(), thread_tuples.end()) - thread_tuples.begin();
+      thread_ranges[thread_idx].push_back(ranges[ranges_by_size[i].second]);
+      thread_tuples[thread_idx] += ranges_by_size[i].first;
+    }
+    // The calling thread sorts the first share itself.
+    ThreadGroup sort_threads;
+    for (int i = 1; i < num_threads; ++i) {
+      sort_threads.AddThread(new Thread("sorter", "sort-range",
+          &Sorter::SortRangesThread, this, tuple_sorters_[i], run, &thread_ranges[i]));
+      tokens.Transfer();
+    }
+    tuple_sorters_[0]->SortRanges(run, &thread_ranges[0]);
+    sort_threads.JoinAll();
+    run->is_sorted_ = true;
   }
-  sorted_runs_.push_back(unsorted_run_);
-  unsorted_run_ = NULL;
+  ExprContext::FreeLocalAllocations(cloned_expr_ctxs_);
+  RETURN_IF_CANCELLED(state_);
   return Status::OK;
 }
 
+void Sorter::SortRangesThread(TupleSorter* tuple_sorter, Run* run,
+    const vector<pair<int64_t, int64_t> >* ranges) {
+  tuple_sorter->SortRanges(run, ranges);
+  state_->resource_pool()->ReleaseThreadToken(false);
+}
+
+void Sorter::SortAndUnpinRun(Run* run) {
+  background_sort_status_ = InMemorySort(run);
+  if (background_sort_status_.ok()) background_sort_status_ = run->UnpinAllBlocks();
+  state_->resource_pool()->ReleaseThreadToken(false);
+}
+
+Status Sorter::WaitForBackgroundSort() {
+  if (background_sort_thread_.get() == NULL) return Status::OK;
+  background_sort_thread_->Join();
+  background_sort_thread_.reset();
+  return background_sort_status_;
+}
+
 uint64_t Sorter::EstimateMergeMem(uint64_t available_blocks,
     RowDescriptor* row_desc, int merge_batch_size) {
   bool has_var_len_slots = row_desc->tuple_descriptors()[0]->string_slots().size() > 0;
@@ -23,6 +23,7 @@ namespace impala {
 class SortedRunMerger;
 class RuntimeProfile;
 class RowBatch;
+class Thread;
 
 // Sorter contains the external sort implementation. Its purpose is to sort arbitrarily
 // large input data sets with a fixed memory budget by spilling data to disk if
@@ -65,6 +66,18 @@ class RowBatch;
 // input run, and one batch is created to hold deep copied rows (i.e. ptrs + data) from
 // the output of the merge.
 //
+// Runs are sorted with up to --sort_run_threads threads: the run is split into disjoint
+// key ranges by quicksort partitioning steps on the calling thread and the ranges are
+// then sorted in parallel, each thread with its own clone of the comparator's exprs.
+// If the input does not fit in one run, the sort has to spill and the runs after the
+// first one are limited to half of the blocks the first run got. Each full run is then
+// sorted and unpinned on a background thread while the next run is collected, so both
+// runs together stay within the memory the sort had for a single run. Every thread
+// other than the calling one needs a thread token from the query's resource pool. If
+// none is available, the calling thread does the work itself.
+//
+// The final merge is done by the calling thread.
+//
 // If there is a single sorted run (i.e. no merge required), only tuple rows are
 // copied into the output batch supplied by GetNext, and the data itself is left in
 // pinned blocks held by the sorter.
@@ -76,6 +89,9 @@ class RowBatch;
 // for these batches have already been accounted for in the memory budget for the sort.
 // That is, the memory for these batches does not come out of the block buffer manager.
 //
+// TODO: Partition the final merge into key ranges that are merged by separate threads.
+// This needs pinned blocks from every run for each range and a way to seek a spilled
+// run to a key.
 // TODO: Not necessary to actually copy var-len data - instead take ownership of the
 // var-length data in the input batch. Copying can be deferred until a run is unpinned.
 // TODO: When the first run is constructed, create a sequence of pointers to materialized
@@ -139,14 +155,45 @@ class Sorter {
 
   // Sorts unsorted_run_ and appends it to the list of sorted runs. Deletes any empty
   // blocks at the end of the run. Updates the sort bytes counter if necessary.
-  Status SortRun();
+  // If 'unpin' is true, the run is unpinned after it was sorted. If runs are limited
+  // by max_blocks_per_unsorted_run_, this happens on background_sort_thread_ and the
+  // run must not be used before WaitForBackgroundSort() returns.
+  Status SortRun(bool unpin);
+
+  // Sorts the tuples of 'run' in place using up to tuple_sorters_.size() threads.
+  // Returns CANCELLED if the query was cancelled.
+  Status InMemorySort(Run* run);
+
+  // Body of the threads started by InMemorySort(). Sorts the 'ranges' of 'run' with
+  // 'tuple_sorter' and releases the thread's token.
+  void SortRangesThread(TupleSorter* tuple_sorter, Run* run,
+      const std::vector<std::pair<int64_t, int64_t> >* ranges);
+
+  // Body of background_sort_thread_. Sorts and unpins 'run', sets
+  // background_sort_status_ and releases the thread's token.
+  void SortAndUnpinRun(Run* run);
+
+  // Waits for background_sort_thread_, if any, to finish and returns its status.
+  Status WaitForBackgroundSort();
 
   // Runtime state instance used to check for cancellation. Not owned.
   RuntimeState* const state_;
 
-  // In memory sorter and less-than comparator.
+  // In memory sorters and less-than comparator. With more than one sort thread, each
+  // TupleSorter evaluates its own clones of the comparator's exprs, which are kept in
+  // cloned_expr_ctxs_. Owned by obj_pool_.
   TupleRowComparator compare_less_than_;
-  boost::scoped_ptr<TupleSorter> in_mem_tuple_sorter_;
+  std::vector<TupleSorter*> tuple_sorters_;
+  std::vector<ExprContext*> cloned_expr_ctxs_;
+
+  // Maximum number of blocks in an unsorted run, or 0 if unlimited. Set once the first
+  // run is full if runs can be sorted in the background.
+  int max_blocks_per_unsorted_run_;
+
+  // Thread sorting and unpinning the last full run while the next run is collected.
+  // NULL if there is no such run. background_sort_status_ is the result of the sort.
+  boost::scoped_ptr<Thread> background_sort_thread_;
+  Status background_sort_status_;
 
   // Block manager object used to allocate, pin and release runs. Not owned by Sorter.
   BufferedBlockMgr* block_mgr_;
@@ -197,6 +244,11 @@ class Sorter {
   RuntimeProfile::Counter* num_merges_counter_;
   RuntimeProfile::Counter* in_mem_sort_timer_;
   RuntimeProfile::Counter* sorted_data_size_;
+
+  // Number of runs sorted by more than one thread, and sorted on
+  // background_sort_thread_.
+  RuntimeProfile::Counter* parallel_sorts_counter_;
+  RuntimeProfile::Counter* background_sorts_counter_;
 };
 
 } // namespace impala
@@ -92,6 +92,28 @@ TEST(ThreadResourceMgr, BasicTest) {
   EXPECT_EQ(counter2.counter(), 1);
 }
 
+TEST(ThreadResourceMgr, DegreeOfParallelism) {
+  ThreadResourceMgr mgr(8);
+  EXPECT_EQ(mgr.GetDegreeOfParallelism(4), 4);
+  EXPECT_EQ(mgr.GetDegreeOfParallelism(16), 8);
+
+  // The quota is shared with the registered pools.
+  ThreadResourceMgr::ResourcePool* c1 = mgr.RegisterPool();
+  EXPECT_EQ(mgr.GetDegreeOfParallelism(16), 4);
+  ThreadResourceMgr::ResourcePool* c2 = mgr.RegisterPool();
+  ThreadResourceMgr::ResourcePool* c3 = mgr.RegisterPool();
+  EXPECT_EQ(mgr.GetDegreeOfParallelism(16), 2);
+  ThreadResourceMgr::ResourcePool* c4 = mgr.RegisterPool();
+  ThreadResourceMgr::ResourcePool* c5 = mgr.RegisterPool();
+  EXPECT_EQ(mgr.GetDegreeOfParallelism(16), 1);
+  mgr.UnregisterPool(c1);
+  mgr.UnregisterPool(c2);
+  mgr.UnregisterPool(c3);
+  mgr.UnregisterPool(c4);
+  mgr.UnregisterPool(c5);
+  EXPECT_EQ(mgr.GetDegreeOfParallelism(16), 8);
+}
+
 }
 
 int main(int argc, char **argv) {
@@ -86,6 +86,12 @@ void ThreadResourceMgr::UnregisterPool(ResourcePool* pool) {
   UpdatePoolQuotas();
 }
 
+int ThreadResourceMgr::GetDegreeOfParallelism(int mt_dop) {
+  unique_lock<mutex> l(lock_);
+  int share = system_threads_quota_ / (pools_.size() + 1);
+  return max(1, min(mt_dop, share));
+}
+
 void ThreadResourceMgr::ResourcePool::SetThreadAvailableCb(ThreadAvailableCb fn) {
   unique_lock<mutex> l(lock_);
   DCHECK(thread_available_fn_ == NULL || fn == NULL);
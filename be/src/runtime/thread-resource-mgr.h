@@ -204,6 +204,12 @@ class ThreadResourceMgr {
   // This updates the quotas for the remaining pools.
   void UnregisterPool(ResourcePool* pool);
 
+  // Returns the number of instances per host to run the fragments of a query with
+  // requested degree of parallelism 'mt_dop' with: 'mt_dop', capped by the share of
+  // the system quota that a new pool would get with the pools currently registered.
+  // Always at least 1.
+  int GetDegreeOfParallelism(int mt_dop);
+
  private:
   // 'Optimal' number of threads for the entire process.
   int system_threads_quota_;
@@ -153,6 +153,8 @@ void ChildQuery::SetQueryOptions(const TQueryOptions& parent_options,
   SET_QUERY_OPTION(seq_compression_mode, SEQ_COMPRESSION_MODE);
   SET_QUERY_OPTION(exec_single_node_rows_threshold,
       EXEC_SINGLE_NODE_ROWS_THRESHOLD);
+  SET_QUERY_OPTION(mt_dop, MT_DOP);
+  SET_QUERY_OPTION(adaptive_join_distribution, ADAPTIVE_JOIN_DISTRIBUTION);
 }
 
 void ChildQuery::Cancel() {
@@ -44,6 +44,21 @@ Status FragmentMgr::FragmentExecState::Prepare(
   return Status::OK;
 }
 
+void FragmentMgr::FragmentExecState::PublishFilter(const TPublishFilterParams& params) {
+  RuntimeState* runtime_state = executor_.runtime_state();
+  // The coordinator only publishes filters after all fragments are prepared.
+  DCHECK(runtime_state != NULL);
+  if (runtime_state != NULL) runtime_state->SetGlobalFilter(params);
+}
+
+void FragmentMgr::FragmentExecState::PublishExchangeMode(
+    const TPublishExchangeModeParams& params) {
+  RuntimeState* runtime_state = executor_.runtime_state();
+  // The coordinator only publishes the mode after all fragments are prepared.
+  DCHECK(runtime_state != NULL);
+  if (runtime_state != NULL) runtime_state->SetExchangeMode(params);
+}
+
 void FragmentMgr::FragmentExecState::Exec() {
   // Open() does the full execution, because all plan fragments have sinks
   executor_.Open();
@@ -51,6 +51,12 @@ class FragmentMgr::FragmentExecState {
   // Main loop of plan fragment execution. Blocks until execution finishes.
   void Exec();
 
+  // Installs a global runtime filter. Must be called after Prepare().
+  void PublishFilter(const TPublishFilterParams& params);
+
+  // Installs the mode of an adaptive join exchange. Must be called after Prepare().
+  void PublishExchangeMode(const TPublishExchangeModeParams& params);
+
   const TUniqueId& query_id() const {
     return fragment_instance_ctx_.query_ctx.query_id;
   }
@@ -112,6 +112,30 @@ boost::shared_ptr<FragmentMgr::FragmentExecState> FragmentMgr::GetFragmentExecSt
   }
 }
 
+void FragmentMgr::PublishFilter(TPublishFilterResult& return_val,
+    const TPublishFilterParams& params) {
+  VLOG_FILE << "PublishFilter(): instance_id=" << params.dst_fragment_instance_id
+            << " slot_id=" << params.slot_id;
+  boost::shared_ptr<FragmentExecState> exec_state =
+      GetFragmentExecState(params.dst_fragment_instance_id);
+  // The fragment may have finished already, in which case the filter is not needed.
+  if (exec_state.get() != NULL) exec_state->PublishFilter(params);
+  Status::OK.SetTStatus(&return_val);
+}
+
+void FragmentMgr::PublishExchangeMode(TPublishExchangeModeResult& return_val,
+    const TPublishExchangeModeParams& params) {
+  VLOG_FILE << "PublishExchangeMode(): instance_id=" << params.dst_fragment_instance_id
+            << " join_node_id=" << params.join_node_id
+            << " broadcast=" << params.broadcast;
+  boost::shared_ptr<FragmentExecState> exec_state =
+      GetFragmentExecState(params.dst_fragment_instance_id);
+  // The fragment may have been cancelled already, in which case it does not wait for
+  // the mode anymore.
+  if (exec_state.get() != NULL) exec_state->PublishExchangeMode(params);
+  Status::OK.SetTStatus(&return_val);
+}
+
 void FragmentMgr::CancelPlanFragment(TCancelPlanFragmentResult& return_val,
     const TCancelPlanFragmentParams& params) {
   VLOG_QUERY << "CancelPlanFragment(): instance_id=" << params.fragment_instance_id;
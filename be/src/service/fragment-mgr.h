@@ -47,6 +47,15 @@ class FragmentMgr {
   void CancelPlanFragment(TCancelPlanFragmentResult& return_val,
       const TCancelPlanFragmentParams& params);
 
+  // Delivers a global runtime filter to a plan fragment that is running asynchronously.
+  void PublishFilter(TPublishFilterResult& return_val,
+      const TPublishFilterParams& params);
+
+  // Delivers the mode of an adaptive join exchange to a plan fragment that is running
+  // asynchronously.
+  void PublishExchangeMode(TPublishExchangeModeResult& return_val,
+      const TPublishExchangeModeParams& params);
+
   class FragmentExecState;
 
   // Returns a shared pointer to the FragmentExecState if one can be found for the
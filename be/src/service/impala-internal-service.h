@@ -15,6 +15,7 @@
 #ifndef IMPALA_SERVICE_IMPALA_INTERNAL_SERVICE_H
 #define IMPALA_SERVICE_IMPALA_INTERNAL_SERVICE_H
 
+#include <vector>
 #include <boost/shared_ptr.hpp>
 
 #include "gen-cpp/ImpalaInternalService.h"
@@ -64,6 +65,38 @@ class ImpalaInternalService : public ImpalaInternalServiceIf {
     impala_server_->TransmitData(return_val, params);
   }
 
+  virtual void TransmitDataBatch(TTransmitDataBatchResult& return_val,
+      const TTransmitDataBatchParams& params) {
+    // Keep the fragments of all receivers alive, see TransmitData().
+    std::vector<boost::shared_ptr<FragmentMgr::FragmentExecState> >
+        fragment_exec_states(params.requests.size());
+    for (int i = 0; i < params.requests.size(); ++i) {
+      fragment_exec_states[i] = fragment_mgr_->GetFragmentExecState(
+          params.requests[i].dest_fragment_instance_id);
+    }
+    impala_server_->TransmitDataBatch(return_val, params);
+  }
+
+  virtual void UpdateFilter(TUpdateFilterResult& return_val,
+      const TUpdateFilterParams& params) {
+    impala_server_->UpdateFilter(return_val, params);
+  }
+
+  virtual void PublishFilter(TPublishFilterResult& return_val,
+      const TPublishFilterParams& params) {
+    fragment_mgr_->PublishFilter(return_val, params);
+  }
+
+  virtual void UpdateBuildSize(TUpdateBuildSizeResult& return_val,
+      const TUpdateBuildSizeParams& params) {
+    impala_server_->UpdateBuildSize(return_val, params);
+  }
+
+  virtual void PublishExchangeMode(TPublishExchangeModeResult& return_val,
+      const TPublishExchangeModeParams& params) {
+    fragment_mgr_->PublishExchangeMode(return_val, params);
+  }
+
   /** Execute the short command. Mostly is introduced to execute the remote dfs commands by
    * nodes that are responsible to cache the part of remote dfs content.
    *
@@ -16,6 +16,7 @@
 
 #include <algorithm>
 #include <exception>
+#include <limits>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/filesystem.hpp>
@@ -1000,6 +1001,38 @@ void ImpalaServer::ReportExecStatus(
   exec_state->coord()->UpdateFragmentExecStatus(params).SetTStatus(&return_val);
 }
 
+void ImpalaServer::UpdateFilter(
+    TUpdateFilterResult& return_val, const TUpdateFilterParams& params) {
+  VLOG_FILE << "UpdateFilter() query_id=" << params.query_id
+            << " instance_id=" << params.fragment_instance_id
+            << " slot_id=" << params.slot_id;
+  boost::shared_ptr<QueryExecState> exec_state = GetQueryExecState(params.query_id, false);
+  if (exec_state.get() == NULL) {
+    // The query finished or was cancelled while the filter was in flight.
+    VLOG_QUERY << "UpdateFilter(): Received filter for unknown query ID: "
+               << PrintId(params.query_id);
+    Status::OK.SetTStatus(&return_val);
+    return;
+  }
+  exec_state->coord()->UpdateFilter(params).SetTStatus(&return_val);
+}
+
+void ImpalaServer::UpdateBuildSize(
+    TUpdateBuildSizeResult& return_val, const TUpdateBuildSizeParams& params) {
+  VLOG_FILE << "UpdateBuildSize() query_id=" << params.query_id
+            << " instance_id=" << params.fragment_instance_id
+            << " join_node_id=" << params.join_node_id;
+  boost::shared_ptr<QueryExecState> exec_state = GetQueryExecState(params.query_id, false);
+  if (exec_state.get() == NULL) {
+    // The query finished or was cancelled while the report was in flight.
+    VLOG_QUERY << "UpdateBuildSize(): Received report for unknown query ID: "
+               << PrintId(params.query_id);
+    Status::OK.SetTStatus(&return_val);
+    return;
+  }
+  exec_state->coord()->UpdateBuildSize(params).SetTStatus(&return_val);
+}
+
 void ImpalaServer::ReportCommandStatus(TReportCommandStatusResult& return_val,
       const TReportCommandStatusParams& params){
 	 VLOG_FILE << "ReportCommandStatus() query_id = \"" << params.query_id
@@ -1035,11 +1068,13 @@ void ImpalaServer::TransmitData(
            << " #rows=" << params.row_batch.num_rows
            << "sender_id=" << params.sender_id
            << " eos=" << (params.eos ? "true" : "false");
-  // TODO: fix Thrift so we can simply take ownership of thrift_batch instead
-  // of having to copy its data
   if (params.row_batch.num_rows > 0) {
+    // 'params' is deserialized by the Thrift processor into an object that is discarded
+    // after this call returns, so the receiver can take ownership of the row batch's
+    // tuple data instead of copying it.
+    TRowBatch* row_batch = const_cast<TRowBatch*>(&params.row_batch);
     Status status = exec_env_->stream_mgr()->AddData(
-        params.dest_fragment_instance_id, params.dest_node_id, params.row_batch,
+        params.dest_fragment_instance_id, params.dest_node_id, row_batch,
         params.sender_id);
     status.SetTStatus(&return_val);
     if (!status.ok()) {
@@ -1055,6 +1090,35 @@ void ImpalaServer::TransmitData(
   }
 }
 
+void ImpalaServer::TransmitDataBatch(TTransmitDataBatchResult& return_val,
+    const TTransmitDataBatchParams& params) {
+  VLOG_ROW << "TransmitDataBatch(): #requests=" << params.requests.size();
+  return_val.__isset.results = true;
+  return_val.results.resize(params.requests.size());
+  for (int i = 0; i < params.requests.size(); ++i) {
+    const TTransmitDataParams& request = params.requests[i];
+    TTransmitDataResult& result = return_val.results[i];
+    Status status;
+    if (!request.eos || request.row_batch.num_rows > 0) {
+      // As in TransmitData(), the receiver takes over the tuple data. Requests without
+      // rows only ask for the credit.
+      TRowBatch* row_batch = request.row_batch.num_rows > 0 ?
+          const_cast<TRowBatch*>(&request.row_batch) : NULL;
+      // A receiver that is gone accepts (and drops) everything.
+      int64_t credit = numeric_limits<int64_t>::max();
+      status = exec_env_->stream_mgr()->AddDataWithCredit(
+          request.dest_fragment_instance_id, request.dest_node_id, row_batch,
+          request.sender_id, &credit);
+      result.__set_credit(credit);
+    }
+    if (status.ok() && request.eos) {
+      status = exec_env_->stream_mgr()->CloseSender(request.dest_fragment_instance_id,
+          request.dest_node_id, request.sender_id);
+    }
+    status.SetTStatus(&result);
+  }
+}
+
 void ImpalaServer::InitializeConfigVariables() {
   Status status = ParseQueryOptions(FLAGS_default_query_options, &default_query_options_);
   if (!status.ok()) {
@@ -206,6 +206,12 @@ class ImpalaServer : public ImpalaServiceIf, public ImpalaHiveServer2ServiceIf,
       const TReportExecStatusParams& params);
   void TransmitData(TTransmitDataResult& return_val,
       const TTransmitDataParams& params);
+  void TransmitDataBatch(TTransmitDataBatchResult& return_val,
+      const TTransmitDataBatchParams& params);
+  void UpdateFilter(TUpdateFilterResult& return_val,
+      const TUpdateFilterParams& params);
+  void UpdateBuildSize(TUpdateBuildSizeResult& return_val,
+      const TUpdateBuildSizeParams& params);
 
   void ReportCommandStatus(TReportCommandStatusResult& return_val,
       const TReportCommandStatusParams& params);
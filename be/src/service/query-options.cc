@@ -156,6 +156,12 @@ void impala::TQueryOptionsToMap(const TQueryOptions& query_options,
       case TImpalaQueryOptions::EXEC_SINGLE_NODE_ROWS_THRESHOLD:
         val << query_options.exec_single_node_rows_threshold;
         break;
+      case TImpalaQueryOptions::MT_DOP:
+        val << query_options.mt_dop;
+        break;
+      case TImpalaQueryOptions::ADAPTIVE_JOIN_DISTRIBUTION:
+        val << query_options.adaptive_join_distribution;
+        break;
       default:
         // We hit this DCHECK(false) if we forgot to add the corresponding entry here
         // when we add a new query option.
@@ -328,6 +334,17 @@ Status impala::SetQueryOption(const string& key, const string& value,
       case TImpalaQueryOptions::EXEC_SINGLE_NODE_ROWS_THRESHOLD:
         query_options->__set_exec_single_node_rows_threshold(atoi(value.c_str()));
         break;
+      case TImpalaQueryOptions::MT_DOP: {
+        int dop = atoi(value.c_str());
+        if (dop < 0) return Status(Substitute("Invalid MT_DOP: '$0'.", value));
+        query_options->__set_mt_dop(dop);
+        break;
+      }
+      case TImpalaQueryOptions::ADAPTIVE_JOIN_DISTRIBUTION: {
+        query_options->__set_adaptive_join_distribution(
+            iequals(value, "true") || iequals(value, "1"));
+        break;
+      }
       default:
         // We hit this DCHECK(false) if we forgot to add the corresponding entry here
         // when we add a new query option.
@@ -43,13 +43,17 @@ typedef boost::unordered_map<TNetworkAddress, PerNodeScanRanges>
 
 // execution parameters for a single fragment; used to assemble the
 // per-fragment instance TPlanFragmentExecParams;
-// hosts.size() == instance_ids.size()
+// hosts.size() == instance_ids.size(); a host appears more than once if the fragment
+// runs several instances on it (see TQueryOptions.mt_dop)
 struct FragmentExecParams {
   std::vector<TNetworkAddress> hosts; // execution backends
   std::vector<TUniqueId> instance_ids;
   std::vector<TPlanFragmentDestination> destinations;
   std::map<PlanNodeId, int> per_exch_num_senders;
   FragmentScanRangeAssignment scan_range_assignment;
+  // If not empty, the scan ranges of each instance, indexed like hosts. Set if the
+  // instances on a host divide the ranges that scan_range_assignment assigns to it.
+  std::vector<PerNodeScanRanges> per_instance_scan_ranges;
   // In its role as a data sender, a fragment instance is assigned a "sender id" to
   // uniquely identify it to a receiver. The id that a particular fragment instance
   // is assigned ranges from [sender_id_base, sender_id_base + N - 1], where
@@ -18,6 +18,7 @@
 
 #include "common/logging.h"
 #include "simple-scheduler.h"
+#include "util/network-util.h"
 
 using namespace std;
 using namespace boost;
@@ -62,6 +63,45 @@ class SimpleSchedulerTest : public testing::Test {
     local_remote_scheduler_.reset(new SimpleScheduler(backends, NULL, NULL, NULL, NULL));
   }
 
+  // Returns the parameters of a scan range of 'length' bytes.
+  static TScanRangeParams MakeScanRange(int64_t length) {
+    TScanRangeParams scan_range;
+    scan_range.scan_range.__isset.hdfs_file_split = true;
+    scan_range.scan_range.hdfs_file_split.length = length;
+    return scan_range;
+  }
+
+  static TPlanNode MakePlanNode(TPlanNodeId node_id, TPlanNodeType::type node_type,
+      int num_children) {
+    TPlanNode node;
+    node.node_id = node_id;
+    node.node_type = node_type;
+    node.num_children = num_children;
+    return node;
+  }
+
+  // Returns the total length of the scan ranges of 'ranges'.
+  static int64_t TotalLength(const PerNodeScanRanges& ranges) {
+    int64_t total = 0;
+    for (PerNodeScanRanges::const_iterator it = ranges.begin(); it != ranges.end();
+        ++it) {
+      for (int i = 0; i < it->second.size(); ++i) {
+        total += it->second[i].scan_range.hdfs_file_split.length;
+      }
+    }
+    return total;
+  }
+
+  // Access to the private functions of the scheduler.
+  void CreateInstancesPerHost(int dop, FragmentExecParams* params) {
+    hostname_scheduler_->CreateInstancesPerHost(dop, params);
+  }
+
+  void ComputeFragmentHosts(const TQueryExecRequest& exec_request, int dop,
+      QuerySchedule* schedule) {
+    hostname_scheduler_->ComputeFragmentHosts(exec_request, dop, schedule);
+  }
+
   int base_port_;
   int num_backends_;
 
@@ -147,6 +187,116 @@ TEST_F(SimpleSchedulerTest, NonLocalHost) {
   EXPECT_EQ(backends.at(4).address.port, 1000);
 }
 
+TEST_F(SimpleSchedulerTest, FewerRangesThanDop) {
+  // A host with fewer ranges than dop gets one instance per range, a host without any
+  // ranges a single instance.
+  TNetworkAddress host_a = MakeNetworkAddress("127.0.0.1", 1000);
+  TNetworkAddress host_b = MakeNetworkAddress("127.0.0.2", 1000);
+  FragmentExecParams params;
+  params.hosts.push_back(host_a);
+  params.hosts.push_back(host_b);
+  params.scan_range_assignment[host_a][0].push_back(MakeScanRange(100));
+  params.scan_range_assignment[host_a][0].push_back(MakeScanRange(200));
+  CreateInstancesPerHost(4, &params);
+
+  ASSERT_EQ(3, params.hosts.size());
+  ASSERT_EQ(3, params.per_instance_scan_ranges.size());
+  EXPECT_EQ(host_a, params.hosts[0]);
+  EXPECT_EQ(host_a, params.hosts[1]);
+  EXPECT_EQ(host_b, params.hosts[2]);
+  EXPECT_EQ(1, params.per_instance_scan_ranges[0][0].size());
+  EXPECT_EQ(1, params.per_instance_scan_ranges[1][0].size());
+  EXPECT_EQ(300, TotalLength(params.per_instance_scan_ranges[0]) +
+      TotalLength(params.per_instance_scan_ranges[1]));
+  EXPECT_TRUE(params.per_instance_scan_ranges[2].empty());
+}
+
+TEST_F(SimpleSchedulerTest, UnevenRanges) {
+  // Ranges of different sizes of two scans are divided by bytes, not by count.
+  const int64_t LENGTHS[] = {1000, 10, 10, 10, 10, 10, 500, 400, 20, 30};
+  const int NUM_RANGES = sizeof(LENGTHS) / sizeof(int64_t);
+  const int DOP = 3;
+  TNetworkAddress host = MakeNetworkAddress("127.0.0.1", 1000);
+  FragmentExecParams params;
+  params.hosts.push_back(host);
+  int64_t total_length = 0;
+  for (int i = 0; i < NUM_RANGES; ++i) {
+    params.scan_range_assignment[host][i % 2].push_back(MakeScanRange(LENGTHS[i]));
+    total_length += LENGTHS[i];
+  }
+  CreateInstancesPerHost(DOP, &params);
+
+  ASSERT_EQ(DOP, params.hosts.size());
+  ASSERT_EQ(DOP, params.per_instance_scan_ranges.size());
+  int num_ranges = 0;
+  int64_t assigned_length = 0;
+  int64_t min_length = total_length;
+  int64_t max_length = 0;
+  for (int i = 0; i < DOP; ++i) {
+    EXPECT_EQ(host, params.hosts[i]);
+    const PerNodeScanRanges& ranges = params.per_instance_scan_ranges[i];
+    for (PerNodeScanRanges::const_iterator it = ranges.begin(); it != ranges.end();
+        ++it) {
+      num_ranges += it->second.size();
+    }
+    int64_t length = TotalLength(ranges);
+    assigned_length += length;
+    min_length = min(min_length, length);
+    max_length = max(max_length, length);
+  }
+  // Every range is scanned exactly once.
+  EXPECT_EQ(NUM_RANGES, num_ranges);
+  EXPECT_EQ(total_length, assigned_length);
+  // The largest range gets an instance of its own, the others share the rest.
+  EXPECT_EQ(1000, max_length);
+  EXPECT_GE(min_length, 400);
+}
+
+TEST_F(SimpleSchedulerTest, SeveralScans) {
+  // A fragment whose only scan is its leftmost node runs 'dop' instances per host, a
+  // fragment with two scans keeps one instance per host.
+  TNetworkAddress host = MakeNetworkAddress("127.0.0.1", 1000);
+  TScanRangeLocations locations;
+  locations.scan_range = MakeScanRange(100).scan_range;
+
+  TQueryExecRequest exec_request;
+  exec_request.fragments.resize(2);
+  // Fragment 0: a join of two scans.
+  exec_request.fragments[0].partition.type = TPartitionType::RANDOM;
+  exec_request.fragments[0].plan.nodes.push_back(
+      MakePlanNode(0, TPlanNodeType::HASH_JOIN_NODE, 2));
+  exec_request.fragments[0].plan.nodes.push_back(
+      MakePlanNode(1, TPlanNodeType::HDFS_SCAN_NODE, 0));
+  exec_request.fragments[0].plan.nodes.push_back(
+      MakePlanNode(2, TPlanNodeType::HDFS_SCAN_NODE, 0));
+  // Fragment 1: a single scan.
+  exec_request.fragments[1].partition.type = TPartitionType::RANDOM;
+  exec_request.fragments[1].plan.nodes.push_back(
+      MakePlanNode(3, TPlanNodeType::HDFS_SCAN_NODE, 0));
+  for (TPlanNodeId scan_id = 1; scan_id <= 3; ++scan_id) {
+    exec_request.per_node_scan_ranges[scan_id].push_back(locations);
+  }
+
+  QuerySchedule schedule(TUniqueId(), exec_request, TQueryOptions(), "", NULL, NULL);
+  vector<FragmentExecParams>& params = *schedule.exec_params();
+  for (int i = 0; i < 4; ++i) {
+    params[0].scan_range_assignment[host][1].push_back(MakeScanRange(100));
+    params[0].scan_range_assignment[host][2].push_back(MakeScanRange(100));
+    params[1].scan_range_assignment[host][3].push_back(MakeScanRange(100));
+  }
+  ComputeFragmentHosts(exec_request, 4, &schedule);
+
+  ASSERT_EQ(1, params[0].hosts.size());
+  EXPECT_EQ(host, params[0].hosts[0]);
+  EXPECT_TRUE(params[0].per_instance_scan_ranges.empty());
+  ASSERT_EQ(4, params[1].hosts.size());
+  ASSERT_EQ(4, params[1].per_instance_scan_ranges.size());
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(host, params[1].hosts[i]);
+    EXPECT_EQ(1, params[1].per_instance_scan_ranges[i][3].size());
+  }
+}
+
 }
 
 int main(int argc, char **argv) {
@@ -14,6 +14,7 @@
 
 #include "statestore/simple-scheduler.h"
 
+#include <algorithm>
 #include <vector>
 
 #include <boost/algorithm/string.hpp>
@@ -27,6 +28,7 @@
 #include "util/metrics.h"
 #include "runtime/exec-env.h"
 #include "runtime/coordinator.h"
+#include "runtime/thread-resource-mgr.h"
 #include "service/impala-server.h"
 
 #include "statestore/statestore-subscriber.h"
@@ -656,7 +658,7 @@ void SimpleScheduler::ComputeFragmentExecParams(const TQueryExecRequest& exec_re
 }
 
 void SimpleScheduler::ComputeFragmentHosts(const TQueryExecRequest& exec_request,
-    QuerySchedule* schedule) {
+    int dop, QuerySchedule* schedule) {
   vector<FragmentExecParams>* fragment_exec_params = schedule->exec_params();
   TNetworkAddress coord = MakeNetworkAddress(FLAGS_hostname, FLAGS_be_port);
   DCHECK_EQ(fragment_exec_params->size(), exec_request.fragments.size());
@@ -727,6 +729,13 @@ void SimpleScheduler::ComputeFragmentHosts(const TQueryExecRequest& exec_request
     // This fragment is executed on those hosts that have scan ranges
     // for the leftmost scan.
     GetScanHosts(leftmost_scan_id, exec_request, params, &params.hosts);
+    if (dop > 1) {
+      // Only the ranges of the leftmost scan can be divided among the instances, the
+      // other scans of a fragment would have to return all their rows to each instance.
+      vector<TPlanNodeId> scan_nodes;
+      FindNodes(fragment.plan, scan_node_types, &scan_nodes);
+      if (scan_nodes.size() == 1) CreateInstancesPerHost(dop, &params);
+    }
   }
 
   unordered_set<TNetworkAddress> unique_hosts;
@@ -737,6 +746,48 @@ void SimpleScheduler::ComputeFragmentHosts(const TQueryExecRequest& exec_request
   schedule->SetUniqueHosts(unique_hosts);
 }
 
+// Returns the number of bytes of 'scan_range', or 1 if it is not a file split.
+static int64_t GetScanRangeLength(const TScanRangeParams& scan_range) {
+  if (!scan_range.scan_range.__isset.hdfs_file_split) return 1;
+  return max<int64_t>(scan_range.scan_range.hdfs_file_split.length, 1);
+}
+
+void SimpleScheduler::CreateInstancesPerHost(int dop, FragmentExecParams* params) {
+  DCHECK(params->per_instance_scan_ranges.empty());
+  vector<TNetworkAddress> hosts;
+  hosts.swap(params->hosts);
+  BOOST_FOREACH(const TNetworkAddress& host, hosts) {
+    FragmentScanRangeAssignment::const_iterator it =
+        params->scan_range_assignment.find(host);
+    if (it == params->scan_range_assignment.end()) {
+      params->hosts.push_back(host);
+      params->per_instance_scan_ranges.push_back(PerNodeScanRanges());
+      continue;
+    }
+    const PerNodeScanRanges& host_ranges = it->second;
+    int num_ranges = 0;
+    BOOST_FOREACH(const PerNodeScanRanges::value_type& entry, host_ranges) {
+      num_ranges += entry.second.size();
+    }
+    int num_instances = max(1, min(dop, num_ranges));
+    int first_instance = params->per_instance_scan_ranges.size();
+    params->hosts.insert(params->hosts.end(), num_instances, host);
+    params->per_instance_scan_ranges.resize(first_instance + num_instances);
+
+    // Give each range to the instance with the fewest bytes so far.
+    vector<int64_t> instance_bytes(num_instances, 0);
+    BOOST_FOREACH(const PerNodeScanRanges::value_type& entry, host_ranges) {
+      BOOST_FOREACH(const TScanRangeParams& scan_range, entry.second) {
+        int instance = min_element(instance_bytes.begin(), instance_bytes.end()) -
+            instance_bytes.begin();
+        instance_bytes[instance] += GetScanRangeLength(scan_range);
+        params->per_instance_scan_ranges[first_instance + instance][entry.first]
+            .push_back(scan_range);
+      }
+    }
+  }
+}
+
 PlanNodeId SimpleScheduler::FindLeftmostNode(
     const TPlan& plan, const vector<TPlanNodeType::type>& types) {
   // the first node with num_children == 0 is the leftmost node
@@ -868,7 +919,16 @@ Status SimpleScheduler::Schedule(Coordinator* coord, QuerySchedule* schedule) {
   }
 
   RETURN_IF_ERROR(ComputeScanRangeAssignment(schedule->request(), schedule));
-  ComputeFragmentHosts(schedule->request(), schedule);
+  // Number of instances per host of the fragments with a scan. The fragments that inherit
+  // the hosts of their input fragment get the same number of instances.
+  int dop = 1;
+  if (schedule->query_options().mt_dop > 1) {
+    dop = ExecEnv::GetInstance()->thread_mgr()->GetDegreeOfParallelism(
+        schedule->query_options().mt_dop);
+    VLOG_QUERY << "mt_dop=" << schedule->query_options().mt_dop
+               << " instances per host=" << dop;
+  }
+  ComputeFragmentHosts(schedule->request(), dop, schedule);
   ComputeFragmentExecParams(schedule->request(), schedule);
   if (!FLAGS_enable_rm) return Status::OK;
   schedule->PrepareReservationRequest(pool, user);
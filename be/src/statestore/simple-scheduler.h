@@ -94,6 +94,8 @@ class SimpleScheduler : public Scheduler {
   virtual void HandleLostResource(const TUniqueId& client_resource_id);
 
  private:
+  friend class SimpleSchedulerTest;
+
   // Protects access to backend_map_ and backend_ip_map_, which might otherwise be updated
   // asynchronously with respect to reads. Also protects the locality
   // counters, which are updated in GetBackends.
@@ -223,10 +225,17 @@ class SimpleScheduler : public Scheduler {
       QuerySchedule* schedule);
 
   // For each fragment in exec_request, computes hosts on which to run the instances
-  // and stores result in fragment_exec_params_.hosts.
-  void ComputeFragmentHosts(const TQueryExecRequest& exec_request,
+  // and stores result in fragment_exec_params_.hosts. Fragments whose only scan is their
+  // leftmost node run up to 'dop' instances per host, see CreateInstancesPerHost().
+  void ComputeFragmentHosts(const TQueryExecRequest& exec_request, int dop,
       QuerySchedule* schedule);
 
+  // Runs the fragment of 'params' with up to 'dop' instances on each of its hosts. The
+  // instances on a host divide the host's scan ranges, so that they scan about the same
+  // number of bytes, and get them from params->per_instance_scan_ranges. Hosts with
+  // fewer scan ranges than 'dop' get one instance per scan range.
+  void CreateInstancesPerHost(int dop, FragmentExecParams* params);
+
   // Returns the id of the leftmost node of any of the given types in 'plan',
   // or INVALID_PLAN_NODE_ID if no such node present.
   PlanNodeId FindLeftmostNode(
@@ -0,0 +1,91 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+
+#include <gtest/gtest.h>
+#include "util/bloom-filter.h"
+#include "util/cpu-info.h"
+
+using namespace std;
+
+namespace impala {
+
+static uint64_t HashInt(int64_t v) {
+  return BloomFilter::Hash(&v, sizeof(v));
+}
+
+TEST(BloomFilter, NoFalseNegatives) {
+  BloomFilter filter(BloomFilter::MinLogNumBlocks(10000, 0.01));
+  for (int64_t i = 0; i < 10000; ++i) filter.Insert(HashInt(i * 7));
+  for (int64_t i = 0; i < 10000; ++i) EXPECT_TRUE(filter.Find(HashInt(i * 7)));
+}
+
+TEST(BloomFilter, FalsePositiveRate) {
+  BloomFilter filter(BloomFilter::MinLogNumBlocks(10000, 0.01));
+  for (int64_t i = 0; i < 10000; ++i) filter.Insert(HashInt(i));
+  int false_positives = 0;
+  for (int64_t i = 10000; i < 110000; ++i) false_positives += filter.Find(HashInt(i));
+  // Allow some slack over the requested 1%.
+  EXPECT_LT(false_positives, 2000);
+}
+
+TEST(BloomFilter, Fold) {
+  BloomFilter filter(12);
+  for (int64_t i = 0; i < 100; ++i) filter.Insert(HashInt(i));
+  filter.Fold(0, 0.5);
+  EXPECT_LT(filter.log_num_blocks(), 12);
+  EXPECT_LE(filter.FillRatio(), 0.5);
+  for (int64_t i = 0; i < 100; ++i) EXPECT_TRUE(filter.Find(HashInt(i)));
+
+  // A full filter must not be folded.
+  BloomFilter full(4);
+  for (int64_t i = 0; i < 10000; ++i) full.Insert(HashInt(i));
+  full.Fold(0, 0.5);
+  EXPECT_EQ(full.log_num_blocks(), 4);
+}
+
+TEST(BloomFilter, Serialize) {
+  BloomFilter filter(6);
+  for (int64_t i = 0; i < 500; ++i) filter.Insert(HashInt(i));
+  BloomFilter copy(0);
+  EXPECT_TRUE(BloomFilter::Deserialize(filter.data(), filter.size(), &copy));
+  EXPECT_EQ(copy.log_num_blocks(), 6);
+  for (int64_t i = 0; i < 500; ++i) EXPECT_TRUE(copy.Find(HashInt(i)));
+
+  // Lengths that are not a power-of-two number of blocks are rejected.
+  EXPECT_FALSE(BloomFilter::Deserialize(filter.data(), 3 * BloomFilter::BYTES_PER_BLOCK,
+      &copy));
+  EXPECT_FALSE(BloomFilter::Deserialize(filter.data(), 17, &copy));
+  EXPECT_EQ(copy.log_num_blocks(), 6);
+}
+
+TEST(BloomFilter, Or) {
+  BloomFilter evens(8);
+  BloomFilter odds(8);
+  for (int64_t i = 0; i < 1000; i += 2) evens.Insert(HashInt(i));
+  for (int64_t i = 1; i < 1000; i += 2) odds.Insert(HashInt(i));
+  evens.Or(odds);
+  for (int64_t i = 0; i < 1000; ++i) EXPECT_TRUE(evens.Find(HashInt(i)));
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::CpuInfo::Init();
+  return RUN_ALL_TESTS();
+}
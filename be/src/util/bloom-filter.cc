@@ -0,0 +1,83 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/bloom-filter.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "util/bit-util.h"
+
+using namespace impala;
+using namespace std;
+
+const uint32_t BloomFilter::SALT[WORDS_PER_BLOCK] = {
+  0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+  0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+};
+
+BloomFilter::BloomFilter(int log_num_blocks)
+  : log_num_blocks_(log_num_blocks),
+    directory_((1LL << log_num_blocks) * WORDS_PER_BLOCK, 0) {
+  DCHECK_GE(log_num_blocks, 0);
+  DCHECK_LT(log_num_blocks, 32);
+}
+
+bool BloomFilter::Deserialize(const uint8_t* data, int64_t len, BloomFilter* filter) {
+  if (len < BYTES_PER_BLOCK || len % BYTES_PER_BLOCK != 0) return false;
+  int64_t num_blocks = len / BYTES_PER_BLOCK;
+  if ((num_blocks & (num_blocks - 1)) != 0) return false;
+  filter->log_num_blocks_ = BitUtil::Log2(num_blocks);
+  filter->directory_.resize(len / sizeof(uint32_t));
+  memcpy(&filter->directory_[0], data, len);
+  return true;
+}
+
+int BloomFilter::MinLogNumBlocks(int64_t ndv, double fpp) {
+  DCHECK_GT(fpp, 0.0);
+  DCHECK_LT(fpp, 1.0);
+  // With k = WORDS_PER_BLOCK bits set per value, fpp ~= (1 - e^(-k * ndv / m))^k for a
+  // filter of m bits. Solve for m.
+  double m = -WORDS_PER_BLOCK * max<int64_t>(ndv, 1) /
+      log(1 - pow(fpp, 1.0 / WORDS_PER_BLOCK));
+  int64_t num_blocks = max<int64_t>(1, ceil(m / (BYTES_PER_BLOCK * 8)));
+  return min(BitUtil::Log2(num_blocks), 31);
+}
+
+void BloomFilter::Fold(int min_log_num_blocks, double max_fill) {
+  while (log_num_blocks_ > min_log_num_blocks) {
+    int64_t half = directory_.size() / 2;
+    int64_t bits_set = 0;
+    for (int64_t i = 0; i < half; ++i) {
+      bits_set += BitUtil::Popcount(directory_[i] | directory_[i + half]);
+    }
+    if (bits_set > max_fill * half * 32) break;
+    for (int64_t i = 0; i < half; ++i) directory_[i] |= directory_[i + half];
+    directory_.resize(half);
+    --log_num_blocks_;
+  }
+}
+
+void BloomFilter::Or(const BloomFilter& other) {
+  DCHECK_EQ(log_num_blocks_, other.log_num_blocks_);
+  for (int64_t i = 0; i < directory_.size(); ++i) directory_[i] |= other.directory_[i];
+}
+
+double BloomFilter::FillRatio() const {
+  int64_t bits_set = 0;
+  for (int64_t i = 0; i < directory_.size(); ++i) {
+    bits_set += BitUtil::Popcount(directory_[i]);
+  }
+  return static_cast<double>(bits_set) / (directory_.size() * 32);
+}
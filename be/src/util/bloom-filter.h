@@ -0,0 +1,108 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_UTIL_BLOOM_FILTER_H
+#define IMPALA_UTIL_BLOOM_FILTER_H
+
+#include <vector>
+#include <boost/cstdint.hpp>
+
+#include "common/logging.h"
+#include "common/compiler-util.h"
+#include "util/hash-util.h"
+
+namespace impala {
+
+// Split-block bloom filter. The filter is an array of 32-byte blocks, each made up of
+// eight 32-bit words. A value is added by picking one block with the high half of its
+// 64-bit hash and setting one bit in each of the block's words, chosen by multiplying
+// the low half of the hash by a per-word salt. A lookup therefore touches a single
+// cache line.
+// The number of blocks is always a power of two and the block is chosen from the low
+// bits of the high half of the hash, so a sparsely populated filter can be folded in
+// half (OR-ing the upper blocks into the lower ones) without rehashing.
+// The serialized form is just the block array, in host (little endian) order.
+class BloomFilter {
+ public:
+  static const int BYTES_PER_BLOCK = 32;
+  static const int WORDS_PER_BLOCK = 8;
+
+  // Creates a filter with 2^log_num_blocks blocks.
+  explicit BloomFilter(int log_num_blocks);
+
+  // Replaces the contents of 'filter' with the serialized filter in 'data'. 'len' must
+  // be a power-of-two multiple of BYTES_PER_BLOCK; returns false otherwise and leaves
+  // *filter unchanged.
+  static bool Deserialize(const uint8_t* data, int64_t len, BloomFilter* filter);
+
+  // Returns the log2 of the number of blocks needed to hold 'ndv' distinct values with
+  // a false positive probability of at most 'fpp'.
+  static int MinLogNumBlocks(int64_t ndv, double fpp);
+
+  // Hashes 'len' bytes at 'data'. All writers and readers of a filter must use this so
+  // the serialized filters stay compatible.
+  static uint64_t Hash(const void* data, int len) {
+    return HashUtil::MurmurHash2_64(data, len, HASH_SEED);
+  }
+
+  void Insert(uint64_t hash) {
+    uint32_t* block = &directory_[BlockIndex(hash) * WORDS_PER_BLOCK];
+    uint32_t key = static_cast<uint32_t>(hash);
+    for (int i = 0; i < WORDS_PER_BLOCK; ++i) {
+      block[i] |= 1U << ((key * SALT[i]) >> 27);
+    }
+  }
+
+  bool Find(uint64_t hash) const {
+    const uint32_t* block = &directory_[BlockIndex(hash) * WORDS_PER_BLOCK];
+    uint32_t key = static_cast<uint32_t>(hash);
+    for (int i = 0; i < WORDS_PER_BLOCK; ++i) {
+      if ((block[i] & (1U << ((key * SALT[i]) >> 27))) == 0) return false;
+    }
+    return true;
+  }
+
+  // Repeatedly halves the filter while it has more than 2^min_log_num_blocks blocks and
+  // no more than 'max_fill' of its bits would be set after folding. Used by writers
+  // that sized the filter for an upper bound of distinct values.
+  void Fold(int min_log_num_blocks, double max_fill);
+
+  // Adds all values of 'other' to this filter. Both filters must have the same size.
+  void Or(const BloomFilter& other);
+
+  // Fraction of bits that are set.
+  double FillRatio() const;
+
+  const uint8_t* data() const {
+    return reinterpret_cast<const uint8_t*>(&directory_[0]);
+  }
+  int64_t size() const { return directory_.size() * sizeof(uint32_t); }
+  int log_num_blocks() const { return log_num_blocks_; }
+
+ private:
+  static const uint64_t HASH_SEED = 0x3b1e4e05b1a8f2c9ULL;
+  static const uint32_t SALT[WORDS_PER_BLOCK];
+
+  uint32_t BlockIndex(uint64_t hash) const {
+    return static_cast<uint32_t>(hash >> 32) & ((1U << log_num_blocks_) - 1);
+  }
+
+  int log_num_blocks_;
+  std::vector<uint32_t> directory_;
+};
+
+}
+
+#endif
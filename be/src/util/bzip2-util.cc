@@ -0,0 +1,118 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/bzip2-util.h"
+
+#include "common/logging.h"
+
+using namespace impala;
+using namespace std;
+
+// The digits of pi and sqrt(pi), in BCD.
+static const uint64_t BLOCK_MAGIC = 0x314159265359ULL;
+static const uint64_t EOS_MAGIC = 0x177245385090ULL;
+static const uint64_t MARKER_MASK = (1ULL << Bzip2Util::MARKER_BITS) - 1;
+static const int CRC_BITS = 32;
+
+// The stream header. The block size (the last character) only bounds the memory the
+// decoder allocates, so the largest one can be used for any block.
+static const uint8_t STREAM_HEADER[] = { 'B', 'Z', 'h', '9' };
+
+namespace {
+
+// Appends bits to a byte vector, most significant bit first (the bzip2 bit order).
+class BitWriter {
+ public:
+  BitWriter(vector<uint8_t>* out) : out_(out), bits_(0), num_bits_(0) { }
+
+  // Appends the low 'num_bits' (at most 32) bits of 'value'.
+  void Put(uint64_t value, int num_bits) {
+    DCHECK_LE(num_bits, 32);
+    bits_ = (bits_ << num_bits) | (value & ((1ULL << num_bits) - 1));
+    num_bits_ += num_bits;
+    while (num_bits_ >= 8) {
+      num_bits_ -= 8;
+      out_->push_back(static_cast<uint8_t>(bits_ >> num_bits_));
+    }
+  }
+
+  // Pads the last byte with zeros.
+  void Flush() {
+    if (num_bits_ > 0) Put(0, 8 - num_bits_);
+  }
+
+ private:
+  vector<uint8_t>* out_;
+  uint64_t bits_;
+  int num_bits_;
+};
+
+// Returns the 'num_bits' (at most 32) bits of 'buf' starting at bit 'bit'. The bits
+// must lie within the buffer.
+uint64_t GetBits(const uint8_t* buf, int64_t bit, int num_bits) {
+  DCHECK_LE(num_bits, 32);
+  const uint8_t* byte = buf + bit / 8;
+  int skip = bit % 8;
+  int num_bytes = (skip + num_bits + 7) / 8;
+  uint64_t value = 0;
+  for (int i = 0; i < num_bytes; ++i) value = (value << 8) | byte[i];
+  value >>= num_bytes * 8 - skip - num_bits;
+  return value & ((1ULL << num_bits) - 1);
+}
+
+}
+
+int64_t Bzip2Util::FindMarker(const uint8_t* buf, int64_t len, int64_t start_bit,
+    bool* is_block) {
+  DCHECK_GE(start_bit, 0);
+  // 'window' holds the bits up to the end of byte i. A marker that ends inside byte i
+  // ends 'shift' bits before the end of the window.
+  uint64_t window = 0;
+  for (int64_t i = start_bit / 8; i < len; ++i) {
+    window = (window << 8) | buf[i];
+    int64_t window_end = (i + 1) * 8;
+    for (int shift = 7; shift >= 0; --shift) {
+      int64_t marker_bit = window_end - shift - MARKER_BITS;
+      if (marker_bit < start_bit) continue;
+      uint64_t bits = (window >> shift) & MARKER_MASK;
+      if (bits == BLOCK_MAGIC || bits == EOS_MAGIC) {
+        *is_block = bits == BLOCK_MAGIC;
+        return marker_bit;
+      }
+    }
+  }
+  return -1;
+}
+
+void Bzip2Util::WrapBlock(const uint8_t* buf, int64_t start_bit, int64_t end_bit,
+    vector<uint8_t>* stream) {
+  DCHECK_GE(end_bit - start_bit, MARKER_BITS + CRC_BITS);
+  DCHECK_EQ(GetBits(buf, start_bit, 24), BLOCK_MAGIC >> 24);
+  stream->clear();
+  stream->reserve(sizeof(STREAM_HEADER) + (end_bit - start_bit) / 8 + 12);
+  stream->insert(stream->end(), STREAM_HEADER, STREAM_HEADER + sizeof(STREAM_HEADER));
+
+  BitWriter writer(stream);
+  for (int64_t bit = start_bit; bit < end_bit; bit += 32) {
+    int num_bits = min<int64_t>(32, end_bit - bit);
+    writer.Put(GetBits(buf, bit, num_bits), num_bits);
+  }
+  // The combined CRC of a stream is built as crc = rotl(crc, 1) ^ block_crc over its
+  // blocks, starting from 0, so for a single block it is just the block's CRC.
+  uint64_t block_crc = GetBits(buf, start_bit + MARKER_BITS, CRC_BITS);
+  writer.Put(EOS_MAGIC >> 24, 24);
+  writer.Put(EOS_MAGIC, 24);
+  writer.Put(block_crc, CRC_BITS);
+  writer.Flush();
+}
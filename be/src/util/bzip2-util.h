@@ -0,0 +1,53 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_UTIL_BZIP2_UTIL_H
+#define IMPALA_UTIL_BZIP2_UTIL_H
+
+#include <vector>
+#include <boost/cstdint.hpp>
+
+namespace impala {
+
+// Helpers to decompress a bzip2 file one compressed block at a time, which lets a file
+// be split into scan ranges at block boundaries.
+// A bzip2 stream is a 4 byte header ("BZh" and the block size) followed by the
+// compressed blocks and an end-of-stream marker. Each block starts with a 48-bit magic
+// number and the CRC of its uncompressed data; the end-of-stream marker is a different
+// 48-bit magic number followed by the combined CRC of all blocks. Blocks are not byte
+// aligned, so the markers have to be searched for at every bit offset. A marker can in
+// principle also appear inside compressed data; such a false match surfaces as a
+// decompression error rather than wrong results, because the CRCs will not match.
+class Bzip2Util {
+ public:
+  static const int MARKER_BITS = 48;
+
+  // Returns the bit offset of the first block or end-of-stream marker that starts at or
+  // after bit 'start_bit' and lies entirely within the 'len' bytes at 'buf', or -1 if
+  // there is none. Sets *is_block to true if it is a block marker.
+  static int64_t FindMarker(const uint8_t* buf, int64_t len, int64_t start_bit,
+      bool* is_block);
+
+  // Replaces the contents of 'stream' with a standalone bzip2 stream holding only the
+  // block in 'buf' that starts at bit 'start_bit' (at a block marker) and ends at bit
+  // 'end_bit' (at the next marker). The result can be decompressed by
+  // BzipDecompressor.
+  static void WrapBlock(const uint8_t* buf, int64_t start_bit, int64_t end_bit,
+      std::vector<uint8_t>* stream);
+};
+
+}
+
+#endif
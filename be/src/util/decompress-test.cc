@@ -15,9 +15,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <iostream>
+#include <sstream>
 #include <gtest/gtest.h>
 #include "runtime/mem-tracker.h"
 #include "runtime/mem-pool.h"
+#include "util/bzip2-util.h"
 #include "util/decompress.h"
 #include "util/compress.h"
 #include "gen-cpp/Descriptors_types.h"
@@ -228,6 +230,54 @@ TEST_F(DecompressorTest, Bzip) {
   RunTest(THdfsCompression::BZIP2);
 }
 
+// Decompressing a multi-block bzip2 file one block at a time, as the text scanner does
+// for split files, must produce the original data.
+TEST_F(DecompressorTest, BzipBlocks) {
+  string input;
+  for (int i = 0; i < 200000; ++i) {
+    stringstream ss;
+    ss << i << "," << (i * 7919) % 10007 << ",row\n";
+    input += ss.str();
+  }
+  scoped_ptr<Codec> compressor;
+  scoped_ptr<Codec> decompressor;
+  EXPECT_TRUE(Codec::CreateCompressor(
+      &mem_pool_, false, THdfsCompression::BZIP2, &compressor).ok());
+  EXPECT_TRUE(Codec::CreateDecompressor(
+      &mem_pool_, false, THdfsCompression::BZIP2, &decompressor).ok());
+  uint8_t* compressed;
+  int64_t compressed_len;
+  EXPECT_TRUE(compressor->ProcessBlock(false, input.size(),
+      reinterpret_cast<const uint8_t*>(input.data()), &compressed_len,
+      &compressed).ok());
+
+  string output;
+  int num_blocks = 0;
+  vector<uint8_t> stream;
+  bool is_block;
+  int64_t block_bit = Bzip2Util::FindMarker(compressed, compressed_len, 0, &is_block);
+  EXPECT_EQ(block_bit, 32);
+  while (block_bit >= 0 && is_block) {
+    int64_t end_bit = Bzip2Util::FindMarker(compressed, compressed_len,
+        block_bit + Bzip2Util::MARKER_BITS, &is_block);
+    ASSERT_GT(end_bit, block_bit);
+    Bzip2Util::WrapBlock(compressed, block_bit, end_bit, &stream);
+    uint8_t* block_output;
+    int64_t block_output_len;
+    EXPECT_TRUE(decompressor->ProcessBlock(false, stream.size(), &stream[0],
+        &block_output_len, &block_output).ok());
+    output.append(reinterpret_cast<char*>(block_output), block_output_len);
+    ++num_blocks;
+    block_bit = end_bit;
+  }
+  EXPECT_FALSE(is_block);
+  EXPECT_GT(num_blocks, 1);
+  EXPECT_TRUE(output == input);
+
+  compressor->Close();
+  decompressor->Close();
+}
+
 TEST_F(DecompressorTest, SnappyBlocked) {
   RunTest(THdfsCompression::SNAPPY_BLOCKED);
 }
@@ -201,6 +201,13 @@ class DictDecoder : public DictDecoderBase {
   // the string data is from the dictionary buffer passed into the c'tor.
   bool GetValue(T* value);
 
+  // Same as GetValue() but also returns the dictionary index of the value in *index.
+  bool GetValue(T* value, int* index);
+
+  // Returns the dictionary entry at 'index' in *value. 'index' must be less than
+  // num_entries(). Used to evaluate predicates once per distinct value.
+  void GetDictValue(int index, T* value) const;
+
  private:
   std::vector<T> dict_;
 };
@@ -262,28 +269,35 @@ inline int DictEncoder<StringValue>::AddToTable(const StringValue& value,
 
 template<typename T>
 inline bool DictDecoder<T>::GetValue(T* value) {
-  DCHECK(data_decoder_.get() != NULL);
   int index;
-  bool result = data_decoder_->Get(&index);
+  return GetValue(value, &index);
+}
+
+template<typename T>
+inline bool DictDecoder<T>::GetValue(T* value, int* index) {
+  DCHECK(data_decoder_.get() != NULL);
+  bool result = data_decoder_->Get(index);
   if (!result) return false;
-  if (index >= dict_.size()) return false;
-  *value = dict_[index];
+  if (*index >= dict_.size()) return false;
+  GetDictValue(*index, value);
   return true;
 }
 
+template<typename T>
+inline void DictDecoder<T>::GetDictValue(int index, T* value) const {
+  DCHECK_LT(index, dict_.size());
+  *value = dict_[index];
+}
+
 template<>
-inline bool DictDecoder<Decimal16Value>::GetValue(Decimal16Value* value) {
-  DCHECK(data_decoder_.get() != NULL);
-  int index;
-  bool result = data_decoder_->Get(&index);
-  if (!result) return false;
-  if (index >= dict_.size()) return false;
+inline void DictDecoder<Decimal16Value>::GetDictValue(int index,
+    Decimal16Value* value) const {
+  DCHECK_LT(index, dict_.size());
   // Workaround for IMPALA-959. Use memcpy instead of '=' so addresses
   // do not need to be 16 byte aligned.
-  uint8_t* addr = reinterpret_cast<uint8_t*>(&dict_[0]);
+  const uint8_t* addr = reinterpret_cast<const uint8_t*>(&dict_[0]);
   addr = addr + index * sizeof(*value);
   memcpy(value, addr, sizeof(*value));
-  return true;
 }
 
 template<typename T>
@@ -58,6 +58,19 @@ void ValidateDict(const vector<T>& values, int fixed_buffer_byte_size) {
     decoder.GetValue(&j);
     EXPECT_EQ(i, j);
   }
+
+  // Decode again, checking the returned indices map back to the same values.
+  decoder.SetData(data_buffer, data_len);
+  BOOST_FOREACH(T i, values) {
+    T j;
+    int index;
+    EXPECT_TRUE(decoder.GetValue(&j, &index));
+    EXPECT_EQ(i, j);
+    EXPECT_LT(index, decoder.num_entries());
+    T k;
+    decoder.GetDictValue(index, &k);
+    EXPECT_EQ(i, k);
+  }
   pool.FreeAll();
 }
 
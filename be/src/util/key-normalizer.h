@@ -42,24 +42,32 @@ namespace impala {
 //     64 bits for time of day in nanoseconds.
 //     All numbers assumed unsigned.
 // Strings:
-//     Write one character at a time with a null byte at the end (inverted if
-//     sort descending). Unlike other data types, we may write partial strings.
-//     NOTE: This assumes strings do not contain null characters.
+//     Write one character at a time followed by two null bytes (inverted if sort
+//     descending). A null character in the string is written as a null byte followed
+//     by a 1 byte, so the terminator sorts before any continuation of the string.
 // Booleans/Nulls:
 //     Left as-is.
 //
-// Finally, we pad any remaining bytes of the key with zeroes.
+// The encoding of a key is never a prefix of the encoding of a different key. If the
+// encoding does not fit into key_len bytes, the first key_len bytes are written, which
+// may end within a value. Otherwise, we pad any remaining bytes of the key with zeroes.
+// Either way, if the normalized keys of two rows differ, memcmp() of the normalized keys
+// orders the rows like the key exprs do. Only if the normalized keys are equal and one
+// of them went over budget must the rows be compared by evaluating the exprs.
 class KeyNormalizer {
  public:
   // Initializes the normalizer with the key exprs and length alloted to each normalized
   // key.
-  KeyNormalizer(const std::vector<ExprContext*>& key_exprs_ctxs, int key_len,
+  KeyNormalizer(const std::vector<ExprContext*>& key_expr_ctxs, int key_len,
       const std::vector<bool>& is_asc, const std::vector<bool>& nulls_first)
       : key_expr_ctxs_(key_expr_ctxs), key_len_(key_len), is_asc_(is_asc),
         nulls_first_(nulls_first) {
   }
 
-  // Normalizes all keys and writes the value into dst.
+  // Returns true if values of 'type' can be normalized.
+  static bool IsSupported(const ColumnType& type);
+
+  // Normalizes all keys and writes exactly key_len_ bytes into dst.
   // Returns true if we went over the max key size while writing the key.
   // If the return value is true, then key_idx_over_budget will be set to
   // the index of the key expr which went over.
@@ -67,6 +75,12 @@ class KeyNormalizer {
   bool NormalizeKey(TupleRow* tuple_row, uint8_t* dst, int* key_idx_over_budget = NULL);
 
  private:
+  // Largest number of bytes a fixed-length value is normalized to (for timestamps).
+  static const int MAX_FIXED_LEN_SIZE = 12;
+
+  // Returns the number of bytes a non-string value of 'type' is normalized to.
+  static int NormalizedSize(const ColumnType& type);
+
   // Returns true if we went over the max key size while writing the null bit.
   static bool WriteNullBit(uint8_t null_bit, uint8_t* value, uint8_t* dst,
       int* bytes_left);
@@ -87,7 +101,17 @@ class KeyNormalizer {
 
   static void NormalizeTimestamp(uint8_t* src, uint8_t* dst, bool is_asc);
 
-  // Normalizes a sort key value and writes it to dst.
+  // Normalizes a non-string sort key value and writes it to dst.
+  static void NormalizeFixedLenValue(const ColumnType& type, bool is_asc,
+      uint8_t* value, uint8_t* dst);
+
+  // Writes the escaped and terminated string 'value' to dst.
+  // Updates bytes_left and returns true if we went over the max key size.
+  static bool WriteNormalizedString(const StringValue* value, bool is_asc,
+      uint8_t* dst, int* bytes_left);
+
+  // Normalizes a sort key value and writes it to dst. If the value does not fit, the
+  // first bytes_left bytes of it are written.
   // Updates bytes_left and returns true if we went over the max key size.
   static bool WriteNormalizedKey(const ColumnType& type, bool is_asc,
       uint8_t* value, uint8_t* dst, int* bytes_left);
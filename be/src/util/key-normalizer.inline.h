@@ -83,19 +83,33 @@ inline void KeyNormalizer::NormalizeTimestamp(uint8_t* src, uint8_t* dst, bool i
   StoreFinalValue<uint64_t>(time_ns, dst + sizeof(date), is_asc);
 }
 
-inline bool KeyNormalizer::WriteNormalizedKey(const ColumnType& type, bool is_asc,
-    uint8_t* value, uint8_t* dst, int* bytes_left) {
-  // Expend bytes_left or fail if we don't have enough.
-  // Variable-length data types (i.e., strings) account for themselves.
-  int byte_size = type.GetByteSize();
-  if (byte_size != 0) {
-    if (*bytes_left >= byte_size) {
-      *bytes_left -= byte_size;
-    } else {
+inline bool KeyNormalizer::IsSupported(const ColumnType& type) {
+  switch (type.type) {
+    case TYPE_NULL:
+    case TYPE_BOOLEAN:
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+    case TYPE_TIMESTAMP:
+    case TYPE_STRING:
+    case TYPE_VARCHAR:
       return true;
-    }
+    default:
+      return false;
   }
+}
+
+inline int KeyNormalizer::NormalizedSize(const ColumnType& type) {
+  // Timestamps are normalized to a 4 byte date and an 8 byte time of day.
+  if (type.type == TYPE_TIMESTAMP) return 12;
+  return type.GetByteSize();
+}
 
+inline void KeyNormalizer::NormalizeFixedLenValue(const ColumnType& type, bool is_asc,
+    uint8_t* value, uint8_t* dst) {
   switch(type.type) {
     case TYPE_BIGINT:
       NormalizeInt<int64_t>(value, dst, is_asc);
@@ -121,24 +135,6 @@ inline bool KeyNormalizer::WriteNormalizedKey(const ColumnType& type, bool is_as
       NormalizeTimestamp(value, dst, is_asc);
       break;
 
-    case TYPE_STRING:
-    case TYPE_VARCHAR: {
-      StringValue* string_val = reinterpret_cast<StringValue*>(value);
-
-      // Copy the string over, with an additional NULL at the end.
-      int size = std::min(string_val->len, *bytes_left);
-      for (int i = 0; i < size; ++i) {
-        StoreFinalValue<uint8_t>(string_val->ptr[i], dst + i, is_asc);
-      }
-      *bytes_left -= size;
-
-      if (*bytes_left == 0) return true;
-
-      StoreFinalValue<uint8_t>(0, dst + size, is_asc);
-      --*bytes_left;
-      return false;
-    }
-
     case TYPE_BOOLEAN:
       StoreFinalValue<uint8_t>(*reinterpret_cast<uint8_t*>(value), dst, is_asc);
       break;
@@ -148,10 +144,51 @@ inline bool KeyNormalizer::WriteNormalizedKey(const ColumnType& type, bool is_as
     default:
       DCHECK(false) << "Value type not supported for normalization";
   }
+}
 
+inline bool KeyNormalizer::WriteNormalizedString(const StringValue* value, bool is_asc,
+    uint8_t* dst, int* bytes_left) {
+  for (int i = 0; i < value->len; ++i) {
+    if (*bytes_left == 0) return true;
+    uint8_t c = value->ptr[i];
+    StoreFinalValue<uint8_t>(c, dst++, is_asc);
+    --*bytes_left;
+    if (c != 0) continue;
+    // Escape null characters so they sort after the terminator.
+    if (*bytes_left == 0) return true;
+    StoreFinalValue<uint8_t>(1, dst++, is_asc);
+    --*bytes_left;
+  }
+  for (int i = 0; i < 2; ++i) {
+    if (*bytes_left == 0) return true;
+    StoreFinalValue<uint8_t>(0, dst++, is_asc);
+    --*bytes_left;
+  }
   return false;
 }
 
+inline bool KeyNormalizer::WriteNormalizedKey(const ColumnType& type, bool is_asc,
+    uint8_t* value, uint8_t* dst, int* bytes_left) {
+  if (type.type == TYPE_STRING || type.type == TYPE_VARCHAR) {
+    return WriteNormalizedString(reinterpret_cast<StringValue*>(value), is_asc, dst,
+        bytes_left);
+  }
+
+  int byte_size = NormalizedSize(type);
+  if (*bytes_left >= byte_size) {
+    NormalizeFixedLenValue(type, is_asc, value, dst);
+    *bytes_left -= byte_size;
+    return false;
+  }
+  // Write as much of the value as fits.
+  DCHECK_LE(byte_size, MAX_FIXED_LEN_SIZE);
+  uint8_t buffer[MAX_FIXED_LEN_SIZE];
+  NormalizeFixedLenValue(type, is_asc, value, buffer);
+  memcpy(dst, buffer, *bytes_left);
+  *bytes_left = 0;
+  return true;
+}
+
 inline bool KeyNormalizer::NormalizeKeyColumn(const ColumnType& type, uint8_t null_bit,
     bool is_asc, uint8_t* value, uint8_t* dst, int* bytes_left) {
   bool went_over = WriteNullBit(null_bit, value, dst, bytes_left);
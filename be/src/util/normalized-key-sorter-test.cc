@@ -0,0 +1,164 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "common/object-pool.h"
+#include "exprs/expr-context.h"
+#include "exprs/slot-ref.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/string-value.h"
+#include "util/cpu-info.h"
+#include "util/key-normalizer.inline.h"
+#include "util/normalized-key-sorter.h"
+#include "util/tuple-row-compare.h"
+
+using namespace std;
+
+namespace impala {
+
+typedef NormalizedKeySorter::Entry Entry;
+
+// Orders indices by a second key, like the sort exprs order tuples with equal keys.
+struct SecondKeyLessThan {
+  bool operator()(uint32_t lhs, uint32_t rhs) const {
+    return (*second_keys)[lhs] < (*second_keys)[rhs];
+  }
+  const vector<int>* second_keys;
+};
+
+// Returns true if 'lhs' should be sorted before 'rhs'.
+static bool EntryLessThan(const Entry& lhs, const Entry& rhs,
+    const SecondKeyLessThan* tie_less_than) {
+  int result = memcmp(lhs.key, rhs.key, NormalizedKeySorter::KEY_LEN);
+  if (result != 0) return result < 0;
+  return tie_less_than != NULL && (*tie_less_than)(lhs.index, rhs.index);
+}
+
+static void TestSort(int num_entries, int num_distinct_bytes, bool break_ties) {
+  vector<Entry> entries(num_entries);
+  vector<int> second_keys(num_entries);
+  for (int i = 0; i < num_entries; ++i) {
+    // Only vary a few bytes so that there are long common prefixes and equal keys.
+    memset(entries[i].key, 7, NormalizedKeySorter::KEY_LEN);
+    entries[i].key[3] = rand() % num_distinct_bytes;
+    entries[i].key[NormalizedKeySorter::KEY_LEN - 1] = rand() % num_distinct_bytes;
+    entries[i].index = i;
+    second_keys[i] = rand();
+  }
+  SecondKeyLessThan tie_less_than;
+  tie_less_than.second_keys = &second_keys;
+  const SecondKeyLessThan* tie_breaker = break_ties ? &tie_less_than : NULL;
+  NormalizedKeySorter::Sort(&entries[0], &entries[0] + num_entries, tie_breaker);
+
+  vector<bool> seen(num_entries, false);
+  for (int i = 0; i < num_entries; ++i) {
+    ASSERT_FALSE(seen[entries[i].index]);
+    seen[entries[i].index] = true;
+    if (i > 0) ASSERT_FALSE(EntryLessThan(entries[i], entries[i - 1], tie_breaker));
+  }
+}
+
+TEST(NormalizedKeySorter, Sort) {
+  TestSort(10, 256, true);
+  TestSort(1000, 1, false);
+  TestSort(1000, 1, true);
+  TestSort(10000, 3, true);
+  TestSort(10000, 256, false);
+  TestSort(10000, 256, true);
+}
+
+// Layout of the tuples that are normalized below.
+struct TestTuple {
+  StringValue str;
+  int32_t i;
+};
+
+// Checks that memcmp() of the normalized keys orders the tuples like the comparator,
+// and that keys that did not go over the budget are only equal for equal tuples.
+static void TestNormalizeKey(const vector<TestTuple>& tuples, bool is_asc, int key_len) {
+  ObjectPool pool;
+  MemTracker tracker;
+  RowDescriptor desc;
+  vector<ExprContext*> ctxs;
+  ctxs.push_back(pool.Add(new ExprContext(pool.Add(
+      new SlotRef(TYPE_STRING, offsetof(TestTuple, str))))));
+  ctxs.push_back(pool.Add(new ExprContext(pool.Add(
+      new SlotRef(TYPE_INT, offsetof(TestTuple, i))))));
+  ASSERT_TRUE(Expr::Prepare(ctxs, NULL, desc, &tracker).ok());
+  ASSERT_TRUE(Expr::Open(ctxs, NULL).ok());
+
+  vector<bool> asc(2, is_asc);
+  vector<bool> nulls_first(2, false);
+  TupleRowComparator comparator(ctxs, ctxs, asc, nulls_first);
+  KeyNormalizer normalizer(ctxs, key_len, asc, nulls_first);
+  vector<vector<uint8_t> > keys(tuples.size(), vector<uint8_t>(key_len));
+  vector<bool> went_over(tuples.size());
+  for (int i = 0; i < tuples.size(); ++i) {
+    TestTuple* tuple = const_cast<TestTuple*>(&tuples[i]);
+    went_over[i] = normalizer.NormalizeKey(
+        reinterpret_cast<TupleRow*>(&tuple), &keys[i][0]);
+  }
+
+  for (int i = 0; i < tuples.size(); ++i) {
+    for (int j = 0; j < tuples.size(); ++j) {
+      TestTuple* lhs = const_cast<TestTuple*>(&tuples[i]);
+      TestTuple* rhs = const_cast<TestTuple*>(&tuples[j]);
+      int expected = comparator.Compare(reinterpret_cast<TupleRow*>(&lhs),
+          reinterpret_cast<TupleRow*>(&rhs));
+      int result = memcmp(&keys[i][0], &keys[j][0], key_len);
+      if (result == 0) {
+        if (!went_over[i] && !went_over[j]) EXPECT_EQ(expected, 0) << i << " " << j;
+      } else {
+        EXPECT_EQ(expected < 0, result < 0) << i << " " << j;
+      }
+    }
+  }
+  Expr::Close(ctxs, NULL);
+}
+
+TEST(KeyNormalizer, StringsAndInts) {
+  // Strings that are prefixes of each other and contain null characters.
+  const char* STRINGS[] = { "", "a", "ab", "abc", "b", "a\0", "a\0b", "a\0\0", "\0",
+      "\xff", "abcdefghijklmnopqrstuvwxyz" };
+  const int STRING_LENS[] = { 0, 1, 2, 3, 1, 2, 3, 3, 1, 1, 26 };
+  const int INTS[] = { -100, -1, 0, 1, 1 << 30 };
+  vector<TestTuple> tuples;
+  for (int i = 0; i < sizeof(STRING_LENS) / sizeof(int); ++i) {
+    for (int j = 0; j < sizeof(INTS) / sizeof(int); ++j) {
+      TestTuple tuple;
+      tuple.str = StringValue(const_cast<char*>(STRINGS[i]), STRING_LENS[i]);
+      tuple.i = INTS[j];
+      tuples.push_back(tuple);
+    }
+  }
+  // Keys that fit, keys that end within the int and keys that end within the string.
+  TestNormalizeKey(tuples, true, NormalizedKeySorter::KEY_LEN);
+  TestNormalizeKey(tuples, false, NormalizedKeySorter::KEY_LEN);
+  TestNormalizeKey(tuples, true, 8);
+  TestNormalizeKey(tuples, false, 8);
+  TestNormalizeKey(tuples, true, 3);
+}
+
+}
+
+int main(int argc, char **argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::CpuInfo::Init();
+  return RUN_ALL_TESTS();
+}
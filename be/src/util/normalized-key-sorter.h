@@ -0,0 +1,150 @@
+// Copyright 2015 Cloudera Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef IMPALA_UTIL_NORMALIZED_KEY_SORTER_H
+#define IMPALA_UTIL_NORMALIZED_KEY_SORTER_H
+
+#include <algorithm>
+#include <string.h>
+#include <boost/cstdint.hpp>
+
+#include "common/logging.h"
+
+namespace impala {
+
+// Sorts entries made up of a fixed-length normalized key prefix (see KeyNormalizer) and
+// the index of the row the key belongs to. The entries are sorted by an in-place MSD
+// radix sort (American flag sort) on the key bytes, switching to an insertion sort for
+// small buckets. Entries with equal key prefixes are ordered by a tie breaker that
+// compares the rows by their indices, which is only needed if some of the keys did not
+// fit into the prefix.
+class NormalizedKeySorter {
+ public:
+  // Length of the normalized key prefix. Chosen so that an entry is 32 bytes.
+  static const int KEY_LEN = 28;
+
+  struct Entry {
+    uint8_t key[KEY_LEN];
+    uint32_t index;
+  };
+
+  // Sorts the entries in [begin, end) by their keys. If 'tie_less_than' is not NULL,
+  // entries with equal keys are sorted by tie_less_than(l.index, r.index), which must
+  // return true if the row with index l is less than the row with index r.
+  template <typename TieLessThan>
+  static void Sort(Entry* begin, Entry* end, const TieLessThan* tie_less_than) {
+    SortHelper(begin, end, 0, tie_less_than);
+  }
+
+ private:
+  // Buckets with at most this many entries are sorted by insertion sort.
+  static const int INSERTION_THRESHOLD = 32;
+
+  // Returns true if the key of 'lhs' is less than the key of 'rhs', comparing the bytes
+  // from 'depth' on. The bytes before 'depth' are known to be equal.
+  template <typename TieLessThan>
+  static bool Less(const Entry& lhs, const Entry& rhs, int depth,
+      const TieLessThan* tie_less_than) {
+    int result = memcmp(lhs.key + depth, rhs.key + depth, KEY_LEN - depth);
+    if (result != 0 || tie_less_than == NULL) return result < 0;
+    return (*tie_less_than)(lhs.index, rhs.index);
+  }
+
+  template <typename TieLessThan>
+  static void InsertionSort(Entry* begin, Entry* end, int depth,
+      const TieLessThan* tie_less_than) {
+    for (Entry* insert = begin + 1; insert < end; ++insert) {
+      Entry value = *insert;
+      Entry* pos = insert;
+      while (pos > begin && Less(value, *(pos - 1), depth, tie_less_than)) {
+        *pos = *(pos - 1);
+        --pos;
+      }
+      *pos = value;
+    }
+  }
+
+  // Sorts [begin, end), whose keys are equal in the first 'depth' bytes.
+  template <typename TieLessThan>
+  static void SortHelper(Entry* begin, Entry* end, int depth,
+      const TieLessThan* tie_less_than) {
+    while (true) {
+      if (end - begin <= INSERTION_THRESHOLD) {
+        InsertionSort(begin, end, depth, tie_less_than);
+        return;
+      }
+      if (depth == KEY_LEN) {
+        // All keys are equal.
+        if (tie_less_than != NULL) {
+          std::sort(begin, end, TieLess<TieLessThan>(tie_less_than));
+        }
+        return;
+      }
+
+      int64_t counts[256];
+      memset(counts, 0, sizeof(counts));
+      for (Entry* e = begin; e < end; ++e) ++counts[e->key[depth]];
+      // Skip bytes that are the same for all entries without moving anything.
+      if (counts[begin->key[depth]] == end - begin) {
+        ++depth;
+        continue;
+      }
+
+      // Move every entry into its bucket by following cycles of misplaced entries.
+      Entry* next[256];
+      Entry* bucket_end[256];
+      Entry* bucket_start = begin;
+      for (int i = 0; i < 256; ++i) {
+        next[i] = bucket_start;
+        bucket_start += counts[i];
+        bucket_end[i] = bucket_start;
+      }
+      for (int i = 0; i < 256; ++i) {
+        while (next[i] < bucket_end[i]) {
+          Entry value = *next[i];
+          uint8_t bucket = value.key[depth];
+          while (bucket != i) {
+            std::swap(value, *next[bucket]++);
+            bucket = value.key[depth];
+          }
+          *next[i]++ = value;
+        }
+      }
+
+      bucket_start = begin;
+      for (int i = 0; i < 256; ++i) {
+        if (counts[i] > 1) {
+          SortHelper(bucket_start, bucket_start + counts[i], depth + 1, tie_less_than);
+        }
+        bucket_start += counts[i];
+      }
+      return;
+    }
+  }
+
+  // Adapts a tie breaker on indices to entries.
+  template <typename TieLessThan>
+  struct TieLess {
+    TieLess(const TieLessThan* tie_less_than) : tie_less_than_(tie_less_than) { }
+    bool operator()(const Entry& lhs, const Entry& rhs) const {
+      return (*tie_less_than_)(lhs.index, rhs.index);
+    }
+    const TieLessThan* tie_less_than_;
+  };
+};
+
+}
+
+#endif
@@ -26,6 +26,10 @@ namespace SSEUtil {
   // for loading 64 or 128 bits into a register at a time.
   static const int CHARS_PER_64_BIT_REGISTER = 8;
   static const int CHARS_PER_128_BIT_REGISTER = 16;
+  static const int CHARS_PER_256_BIT_REGISTER = 32;
+
+  // Number of characters AVX2_cmpeq_any4_mask() searches for at once.
+  static const int AVX2_MAX_SEARCH_CHARS = 4;
 
   // SSE4.2 adds instructions for text processing.  The instructions have a control
   // byte that determines some of functionality of the instruction.  (Equivalent to
@@ -171,6 +175,65 @@ static inline int64_t POPCNT_popcnt_u64(uint64_t a) {
 
 #endif
 
+// Define the AVX2 byte compares used for text parsing. AVX2 has no equivalent of the
+// PCMPxSTRy instructions; instead each search character is broadcast to a 256-bit
+// register and compared to 32 bytes at once. As above, the caller must verify at
+// runtime that the processor supports AVX2, and the native code cannot be compiled
+// with -mavx2, so these are written in inline asm. Each function ends with vzeroupper
+// to avoid the AVX-SSE transition penalty in the (non-VEX) code around it.
+#ifndef IR_COMPILE
+
+// Returns a mask with bit i set if byte i of the 32 bytes at 'str' is equal to 'c'.
+static inline uint32_t AVX2_cmpeq_mask(const char* str, char c) {
+  uint32_t result;
+  __asm__("vmovd %2, %%xmm1\n\t"
+          "vpbroadcastb %%xmm1, %%ymm1\n\t"
+          "vpcmpeqb (%1), %%ymm1, %%ymm1\n\t"
+          "vpmovmskb %%ymm1, %0\n\t"
+          "vzeroupper"
+      : "=r"(result) : "r"(str), "r"(static_cast<int>(c)) : "xmm1", "memory");
+  return result;
+}
+
+// Returns a mask with bit i set if byte i of the 32 bytes at 'str' is equal to any of
+// the SSEUtil::AVX2_MAX_SEARCH_CHARS characters at 'chars'. Callers searching for
+// fewer characters should repeat one of them.
+static inline uint32_t AVX2_cmpeq_any4_mask(const char* str, const char* chars) {
+  uint32_t result;
+  __asm__("vmovdqu (%1), %%ymm0\n\t"
+          "vpbroadcastb (%2), %%ymm1\n\t"
+          "vpcmpeqb %%ymm0, %%ymm1, %%ymm1\n\t"
+          "vpbroadcastb 1(%2), %%ymm2\n\t"
+          "vpcmpeqb %%ymm0, %%ymm2, %%ymm2\n\t"
+          "vpor %%ymm2, %%ymm1, %%ymm1\n\t"
+          "vpbroadcastb 2(%2), %%ymm2\n\t"
+          "vpcmpeqb %%ymm0, %%ymm2, %%ymm2\n\t"
+          "vpor %%ymm2, %%ymm1, %%ymm1\n\t"
+          "vpbroadcastb 3(%2), %%ymm2\n\t"
+          "vpcmpeqb %%ymm0, %%ymm2, %%ymm2\n\t"
+          "vpor %%ymm2, %%ymm1, %%ymm1\n\t"
+          "vpmovmskb %%ymm1, %0\n\t"
+          "vzeroupper"
+      : "=r"(result) : "r"(str), "r"(chars) : "xmm0", "xmm1", "xmm2", "memory");
+  return result;
+}
+
+#else  // IR_COMPILE
+// The cross-compiled IR cannot contain inline asm and is never built with AVX2, and
+// callers must not use these on the IR path.
+
+static inline uint32_t AVX2_cmpeq_mask(const char* str, char c) {
+  DCHECK(false) << "AVX2 is not available in cross-compiled code";
+  return 0;
+}
+
+static inline uint32_t AVX2_cmpeq_any4_mask(const char* str, const char* chars) {
+  DCHECK(false) << "AVX2 is not available in cross-compiled code";
+  return 0;
+}
+
+#endif
+
 }
 
 #endif
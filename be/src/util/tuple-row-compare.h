@@ -96,6 +96,29 @@ class TupleRowComparator {
     return (*this)(lhs_row, rhs_row);
   }
 
+  const std::vector<ExprContext*>& key_expr_ctxs_lhs() const {
+    return key_expr_ctxs_lhs_;
+  }
+  bool is_asc(int i) const { return is_asc_[i]; }
+  bool nulls_first(int i) const { return nulls_first_[i] < 0; }
+
+  // Replaces the key expr contexts of this comparator with clones, so that it can be
+  // used from a different thread than the comparator it was copied from. The clones are
+  // appended to 'cloned_ctxs' and must be closed by the caller.
+  Status CloneExprContexts(RuntimeState* state, std::vector<ExprContext*>* cloned_ctxs) {
+    for (int i = 0; i < key_expr_ctxs_lhs_.size(); ++i) {
+      ExprContext* lhs_clone;
+      RETURN_IF_ERROR(key_expr_ctxs_lhs_[i]->Clone(state, &lhs_clone));
+      cloned_ctxs->push_back(lhs_clone);
+      key_expr_ctxs_lhs_[i] = lhs_clone;
+      ExprContext* rhs_clone;
+      RETURN_IF_ERROR(key_expr_ctxs_rhs_[i]->Clone(state, &rhs_clone));
+      cloned_ctxs->push_back(rhs_clone);
+      key_expr_ctxs_rhs_[i] = rhs_clone;
+    }
+    return Status::OK;
+  }
+
  private:
   std::vector<ExprContext*> key_expr_ctxs_lhs_;
   std::vector<ExprContext*> key_expr_ctxs_rhs_;
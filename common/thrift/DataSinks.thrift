@@ -30,6 +30,15 @@ enum TTableSinkType {
   HBASE
 }
 
+// Role of a data stream sink in an adaptive join exchange.
+enum TAdaptiveExchangeRole {
+  // Sends the build side of the join.
+  BUILD,
+
+  // Sends the probe side of the join.
+  PROBE
+}
+
 // Sink which forwards data to a remote plan fragment,
 // according to the given output partition specification
 // (ie, the m:1 part of an m:n data stream)
@@ -41,6 +50,17 @@ struct TDataStreamSink {
   // If the partitioning type is UNPARTITIONED, the output is broadcast
   // to each destination host.
   2: required Partitions.TDataPartition output_partition
+
+  // If set, the distribution of the join with this plan node id is decided at runtime
+  // from the actual size of its build side. output_partition must be HASH_PARTITIONED
+  // on the join exprs of the sink's side, which is used if the build side is too large
+  // to broadcast. Otherwise the BUILD sink broadcasts its rows and the PROBE sink sends
+  // its rows to the join instances on its own host. The coordinator makes the decision
+  // for all sinks of the join.
+  3: optional Types.TPlanNodeId adaptive_join_node_id
+
+  // Required if adaptive_join_node_id is set.
+  4: optional TAdaptiveExchangeRole adaptive_exchange_role
 }
 
 // Creates a new Hdfs files according to the evaluation of the partitionKeyExprs,
@@ -111,6 +111,15 @@ struct TQueryOptions {
   // If the number of rows that are processed for a single query is below the
   // threshold, it will be executed on the coordinator only with codegen disabled
   31: optional i32 exec_single_node_rows_threshold = 100
+
+  // Degree of parallelism per host. If > 1, fragments with a single scan run up to
+  // mt_dop instances per host, which divide the host's scan ranges, and so do the
+  // fragments that inherit their hosts. Capped by the backend's thread quota.
+  32: optional i32 mt_dop = 0
+
+  // If true, partitioned joins whose join type allows broadcasting decide at runtime
+  // between broadcasting and partitioning, from the actual size of their build side.
+  33: optional bool adaptive_join_distribution = false
 }
 
 // Impala currently has two types of sessions: Beeswax and HiveServer2
@@ -274,6 +283,14 @@ struct TPlanFragmentExecParams {
 
   // Id of this fragment in its role as a sender.
   8: optional i32 sender_id
+
+  // Probe-side slots of the joins in this fragment whose build side filter is sent to
+  // the coordinator with UpdateFilter() once the build side is complete.
+  9: optional list<Types.TSlotId> global_filter_source_slot_ids
+
+  // Slots of the scans in this fragment that receive a global filter through
+  // PublishFilter(). The scans wait for these filters before starting.
+  10: optional list<Types.TSlotId> global_filter_target_slot_ids
 }
 
 // Service Protocol Details
@@ -516,6 +533,125 @@ struct TTransmitDataParams {
 struct TTransmitDataResult {
   // required in V1
   1: optional Status.TStatus status
+
+  // Number of bytes of row batches the receiver is willing to accept from this sender
+  // before it has consumed some of the batches it has buffered. Only set by
+  // TransmitDataBatch(). The sender may send its next batch only while this is positive.
+  2: optional i64 credit
+}
+
+// TransmitDataBatch
+
+struct TTransmitDataBatchParams {
+  1: required ImpalaInternalServiceVersion protocol_version
+
+  // The requests of all channels from one host to the receivers on another host. A
+  // request without a row batch and eos not set only asks for the receiver's credit.
+  2: optional list<TTransmitDataParams> requests
+}
+
+struct TTransmitDataBatchResult {
+  // One result for every entry of TTransmitDataBatchParams.requests, in the same order.
+  1: optional list<TTransmitDataResult> results
+}
+
+
+// UpdateFilter
+
+struct TUpdateFilterParams {
+  1: required ImpalaInternalServiceVersion protocol_version
+
+  // required in V1
+  2: optional Types.TUniqueId query_id
+
+  // required in V1
+  3: optional Types.TUniqueId fragment_instance_id
+
+  // Probe-side slot the filter applies to; required in V1
+  4: optional Types.TSlotId slot_id
+
+  // Serialized bloom filter over the build side values of the join. Not set if the
+  // fragment instance could not build the filter (e.g. because the join spilled), which
+  // disables the filter for the whole query.
+  5: optional binary bloom_filter
+}
+
+struct TUpdateFilterResult {
+  // required in V1
+  1: optional Status.TStatus status
+}
+
+
+// PublishFilter
+
+struct TPublishFilterParams {
+  1: required ImpalaInternalServiceVersion protocol_version
+
+  // required in V1
+  2: optional Types.TUniqueId dst_fragment_instance_id
+
+  // required in V1
+  3: optional Types.TSlotId slot_id
+
+  // The union of the filters of all fragment instances that build the filter. Not set
+  // if the filter was disabled, in which case the scans stop waiting for it.
+  4: optional binary bloom_filter
+}
+
+struct TPublishFilterResult {
+  // required in V1
+  1: optional Status.TStatus status
+}
+
+
+// UpdateBuildSize
+
+struct TUpdateBuildSizeParams {
+  1: required ImpalaInternalServiceVersion protocol_version
+
+  // required in V1
+  2: optional Types.TUniqueId query_id
+
+  // required in V1
+  3: optional Types.TUniqueId fragment_instance_id
+
+  // Join of the adaptive exchange; required in V1
+  4: optional Types.TPlanNodeId join_node_id
+
+  // Size of the build side rows the instance has produced so far; required in V1
+  5: optional i64 num_bytes
+  6: optional i64 num_rows
+
+  // True if these are all rows of the instance. If false, the instance has produced
+  // more rows than can be broadcast.
+  7: optional bool eos
+}
+
+struct TUpdateBuildSizeResult {
+  // required in V1
+  1: optional Status.TStatus status
+}
+
+
+// PublishExchangeMode
+
+struct TPublishExchangeModeParams {
+  1: required ImpalaInternalServiceVersion protocol_version
+
+  // required in V1
+  2: optional Types.TUniqueId dst_fragment_instance_id
+
+  // required in V1
+  3: optional Types.TPlanNodeId join_node_id
+
+  // If true, the join is broadcast, otherwise both sides are hash partitioned;
+  // required in V1
+  4: optional bool broadcast
+}
+
+struct TPublishExchangeModeResult {
+  // required in V1
+  1: optional Status.TStatus status
 }
 
 // Parameters for RequestPoolService.resolveRequestPool()
@@ -578,11 +714,32 @@ service ImpalaInternalService {
   // Called by sender to transmit single row batch. Returns error indication
   // if params.fragmentId or params.destNodeId are unknown or if data couldn't be read.
   TTransmitDataResult TransmitData(1:TTransmitDataParams params);
-  
+
+  // Called by the DataStreamTransport of a backend to transmit the row batches of many
+  // channels to this backend in one rpc. Unlike TransmitData(), never blocks on a full
+  // receiver; flow control is done with the credits returned for every request.
+  TTransmitDataBatchResult TransmitDataBatch(1:TTransmitDataBatchParams params);
+
   // Called by coordinator to issue remote handler to run the command specified
   TRemoteShortCommandResult ExecShortCommand(1:TExecRemoteCommandParams params);
      
   // Periodically called by backend to report status of command execution
   // back to coordinator; also called when execution is finished, for whatever reason.
   TReportCommandStatusResult ReportCommandStatus(1:TReportCommandStatusParams params);
+
+  // Called by a backend to send the filter built by one of its joins to the coord,
+  // which merges the filters of all instances of the join.
+  TUpdateFilterResult UpdateFilter(1:TUpdateFilterParams params);
+
+  // Called by coord to deliver a merged filter to a fragment instance that scans the
+  // probe side of the join.
+  TPublishFilterResult PublishFilter(1:TPublishFilterParams params);
+
+  // Called by a backend to report the size of the build side of an adaptive join
+  // exchange that one of its fragment instances sends.
+  TUpdateBuildSizeResult UpdateBuildSize(1:TUpdateBuildSizeParams params);
+
+  // Called by coord to tell the fragment instances that send the build or probe side of
+  // an adaptive join exchange whether the join is broadcast.
+  TPublishExchangeModeResult PublishExchangeMode(1:TPublishExchangeModeParams params);
 }
@@ -165,6 +165,14 @@ enum TImpalaQueryOptions {
   // If the number of rows that are processed for a single query is below the
   // threshold, it will be executed on the coordinator only with codegen disabled
   EXEC_SINGLE_NODE_ROWS_THRESHOLD
+
+  // Number of instances per host of the fragments that scan and of the fragments
+  // above them. 0 or 1 means a single instance per host.
+  MT_DOP
+
+  // If true, the planner lets partitioned joins that could also be broadcast choose
+  // their distribution at runtime, see --adaptive_join_max_broadcast_bytes.
+  ADAPTIVE_JOIN_DISTRIBUTION
 }
 
 // The summary of an insert.
@@ -183,6 +183,12 @@ struct THashJoinNode {
   // If true, this join node can (but may choose not to) generate slot filters
   // after constructing the build side that can be applied to the probe side.
   4: optional bool add_probe_filters
+
+  // Probe slots of eq_join_conjuncts whose build side values may be sent as global
+  // runtime filters to the scans of the slots in other fragments. Only set for joins
+  // that drop the probe rows without a match, and only for slots that reach the join
+  // through exchanges and joins.
+  5: optional list<Types.TSlotId> global_filter_probe_slot_ids
 }
 
 struct TAggregationNode {
@@ -201,6 +207,11 @@ struct TAggregationNode {
 
   // Set to true if this aggregation node needs to run the finalization step.
   5: required bool need_finalize
+
+  // Set to true if this is the first phase of a two-phase aggregation, i.e. its output
+  // is sent to an exchange and merged by an aggregation in another fragment. Such
+  // aggregations may return rows that are not fully aggregated.
+  6: optional bool is_preagg
 }
 
 struct TSortInfo {
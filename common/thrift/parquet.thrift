@@ -400,6 +400,56 @@ struct ColumnChunk {
    * metadata.
    **/
   3: optional ColumnMetaData meta_data
+
+  /** File offset of ColumnChunk's OffsetIndex **/
+  4: optional i64 offset_index_offset
+
+  /** Size of ColumnChunk's OffsetIndex, in bytes **/
+  5: optional i32 offset_index_length
+
+  /** File offset of ColumnChunk's ColumnIndex **/
+  6: optional i64 column_index_offset
+
+  /** Size of ColumnChunk's ColumnIndex, in bytes **/
+  7: optional i32 column_index_length
+}
+
+/** Location of a data page within the file **/
+struct PageLocation {
+  /** Offset of the page header in the file **/
+  1: required i64 offset
+
+  /** Size of the page, including the header, in bytes **/
+  2: required i32 compressed_page_size
+
+  /** Index within the row group of the first row of the page **/
+  3: required i64 first_row_index
+}
+
+/** Locations of all data pages of a column chunk, in the order they appear. **/
+struct OffsetIndex {
+  1: required list<PageLocation> page_locations
+}
+
+/** Whether min_values / max_values of a ColumnIndex are ordered. **/
+enum BoundaryOrder {
+  UNORDERED = 0,
+  ASCENDING = 1,
+  DESCENDING = 2
+}
+
+/**
+ * Per-page statistics of a column chunk. The lists are parallel to
+ * OffsetIndex.page_locations. For pages with only nulls, null_pages is true and
+ * min_values/max_values hold empty byte arrays. Values use the PLAIN encoding, except
+ * byte arrays, which hold the bytes without the length prefix.
+ **/
+struct ColumnIndex {
+  1: required list<bool> null_pages
+  2: required list<binary> min_values
+  3: required list<binary> max_values
+  4: required BoundaryOrder boundary_order
+  5: optional list<i64> null_counts
 }
 
 struct RowGroup {
@@ -351,10 +351,13 @@ public class AnalyticExpr extends Expr {
 
     standardize(analyzer);
 
-    // min/max is not currently supported on sliding windows (i.e. start bound is not
-    // unbounded).
+    // min/max is only supported on sliding windows (i.e. start bound is not unbounded)
+    // for ROWS windows over fixed-length types. The backend keeps the values in the
+    // window in a monotonic deque, which cannot hold variable-length values.
     if (window_ != null && isMinMax(fn) &&
-        window_.getLeftBoundary().getType() != BoundaryType.UNBOUNDED_PRECEDING) {
+        window_.getLeftBoundary().getType() != BoundaryType.UNBOUNDED_PRECEDING &&
+        (window_.getType() != AnalyticWindow.Type.ROWS ||
+         getFnCall().getChild(0).getType().isStringType())) {
       throw new AnalysisException(
           "'" + getFnCall().toSql() + "' is only supported with an "
             + "UNBOUNDED PRECEDING start bound.");
@@ -58,6 +58,11 @@ public class AggregationNode extends PlanNode {
   // node is the root node of a distributed aggregation.
   private boolean needsFinalize_;
 
+  // Set to true if this is the first phase of a two-phase aggregation whose output is
+  // merged by an aggregation in a parent fragment. Such a node may pass rows through
+  // without fully aggregating them.
+  private boolean isPreagg_;
+
   /**
    * Create an agg node from aggInfo.
    */
@@ -76,6 +81,7 @@ public class AggregationNode extends PlanNode {
     super(id, src, "AGGREGATE");
     aggInfo_ = src.aggInfo_;
     needsFinalize_ = src.needsFinalize_;
+    isPreagg_ = src.isPreagg_;
   }
 
   public AggregateInfo getAggInfo() { return aggInfo_; }
@@ -87,6 +93,15 @@ public class AggregationNode extends PlanNode {
     needsFinalize_ = false;
   }
 
+  /**
+   * Marks this node as the first phase of a two-phase aggregation. Only valid to call
+   * if the node does not need to finalize its output.
+   */
+  public void setIsPreagg() {
+    Preconditions.checkState(!needsFinalize_);
+    isPreagg_ = true;
+  }
+
   /**
    * Have this node materialize the aggregation's intermediate tuple instead of
    * the output tuple.
@@ -199,6 +214,7 @@ public class AggregationNode extends PlanNode {
         aggregateFunctions,
         aggInfo_.getIntermediateTupleId().asInt(),
         aggInfo_.getOutputTupleId().asInt(), needsFinalize_);
+    msg.agg_node.setIs_preagg(isPreagg_);
     List<Expr> groupingExprs = aggInfo_.getGroupingExprs();
     if (groupingExprs != null) {
       msg.agg_node.setGrouping_exprs(Expr.treesToThrift(groupingExprs));
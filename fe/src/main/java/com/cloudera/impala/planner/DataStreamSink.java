@@ -14,6 +14,7 @@
 
 package com.cloudera.impala.planner;
 
+import com.cloudera.impala.thrift.TAdaptiveExchangeRole;
 import com.cloudera.impala.thrift.TDataSink;
 import com.cloudera.impala.thrift.TDataSinkType;
 import com.cloudera.impala.thrift.TDataStreamSink;
@@ -27,6 +28,11 @@ public class DataStreamSink extends DataSink {
   private final ExchangeNode exchNode_;
   private final DataPartition outputPartition_;
 
+  // If set, the join whose distribution is decided at runtime, see
+  // PlanFragment.setAdaptiveJoin().
+  private PlanNodeId adaptiveJoinNodeId_;
+  private TAdaptiveExchangeRole adaptiveExchangeRole_;
+
   public DataStreamSink(ExchangeNode exchNode, DataPartition partition) {
     Preconditions.checkNotNull(exchNode);
     Preconditions.checkNotNull(partition);
@@ -34,14 +40,25 @@ public class DataStreamSink extends DataSink {
     outputPartition_ = partition;
   }
 
+  public void setAdaptiveJoin(PlanNodeId joinNodeId, TAdaptiveExchangeRole role) {
+    Preconditions.checkState(outputPartition_.isHashPartitioned());
+    adaptiveJoinNodeId_ = joinNodeId;
+    adaptiveExchangeRole_ = role;
+  }
+
   @Override
   public String getExplainString(String prefix, String detailPrefix,
       TExplainLevel detailLevel) {
     StringBuilder output = new StringBuilder();
+    String adaptiveJoin = "";
+    if (adaptiveJoinNodeId_ != null) {
+      adaptiveJoin = String.format(", ADAPTIVE %s OF JOIN=%s",
+          adaptiveExchangeRole_.toString(), adaptiveJoinNodeId_.toString());
+    }
     output.append(
-        String.format("%sDATASTREAM SINK [FRAGMENT=%s, EXCHANGE=%s, %s]",
+        String.format("%sDATASTREAM SINK [FRAGMENT=%s, EXCHANGE=%s, %s%s]",
         prefix, exchNode_.getFragment().getId().toString(),
-        exchNode_.getId().toString(), exchNode_.getDisplayLabelDetail()));
+        exchNode_.getId().toString(), exchNode_.getDisplayLabelDetail(), adaptiveJoin));
     return output.toString();
   }
 
@@ -50,6 +67,10 @@ public class DataStreamSink extends DataSink {
     TDataSink result = new TDataSink(TDataSinkType.DATA_STREAM_SINK);
     TDataStreamSink tStreamSink =
         new TDataStreamSink(exchNode_.getId().asInt(), outputPartition_.toThrift());
+    if (adaptiveJoinNodeId_ != null) {
+      tStreamSink.setAdaptive_join_node_id(adaptiveJoinNodeId_.asInt());
+      tStreamSink.setAdaptive_exchange_role(adaptiveExchangeRole_);
+    }
     result.setStream_sink(tStreamSink);
     return result;
   }
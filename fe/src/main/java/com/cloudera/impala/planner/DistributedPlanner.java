@@ -30,6 +30,7 @@ import com.cloudera.impala.analysis.QueryStmt;
 import com.cloudera.impala.common.ImpalaException;
 import com.cloudera.impala.common.InternalException;
 import com.cloudera.impala.common.NotImplementedException;
+import com.cloudera.impala.thrift.TAdaptiveExchangeRole;
 import com.cloudera.impala.thrift.TPartitionType;
 import com.google.common.base.Preconditions;
 import com.google.common.collect.Lists;
@@ -475,10 +476,46 @@ public class DistributedPlanner {
       rightChildFragment.setDestination(rhsExchange);
       rightChildFragment.setOutputPartition(rhsJoinPartition);
 
+      if (isAdaptiveJoin(node, lhsJoinExprs, rhsJoinExprs)) {
+        // The backend broadcasts the build side instead if it turns out to be small.
+        // The output of the join is then not partitioned on the lhs join exprs, so
+        // nothing above the join may rely on that.
+        joinFragment.setDataPartition(DataPartition.RANDOM);
+        leftChildFragment.setAdaptiveJoin(node.getId(), TAdaptiveExchangeRole.PROBE);
+        rightChildFragment.setAdaptiveJoin(node.getId(), TAdaptiveExchangeRole.BUILD);
+      }
       return joinFragment;
     }
   }
 
+  /**
+   * Returns true if the distribution of the partitioned join 'node', whose inputs are
+   * hash partitioned on 'lhsJoinExprs' and 'rhsJoinExprs', can be decided at runtime:
+   * the query option adaptive_join_distribution is set, the join type allows a
+   * broadcast join, the join was not hinted to be partitioned, and the join exprs of
+   * both sides have identical types. The latter is needed because a randomly
+   * partitioned join fragment doesn't get its senders' partition exprs cast to common
+   * types in PlanFragment.finalize().
+   */
+  private boolean isAdaptiveJoin(HashJoinNode node, List<Expr> lhsJoinExprs,
+      List<Expr> rhsJoinExprs) {
+    if (!ctx_.getQueryOptions().isAdaptive_join_distribution()) return false;
+    if (node.getTableRef().isPartitionedJoin()) return false;
+    JoinOperator joinOp = node.getJoinOp();
+    if (joinOp == JoinOperator.RIGHT_OUTER_JOIN
+        || joinOp == JoinOperator.FULL_OUTER_JOIN
+        || joinOp == JoinOperator.RIGHT_SEMI_JOIN
+        || joinOp == JoinOperator.RIGHT_ANTI_JOIN) {
+      return false;
+    }
+    for (int i = 0; i < lhsJoinExprs.size(); ++i) {
+      if (!lhsJoinExprs.get(i).getType().equals(rhsJoinExprs.get(i).getType())) {
+        return false;
+      }
+    }
+    return true;
+  }
+
   /**
    * Returns true if the lhs and rhs partitions are physically compatible for executing
    * a partitioned join with the given lhs/rhs join exprs. Physical compatibility means
@@ -714,6 +751,7 @@ public class DistributedPlanner {
       long limit = node.getLimit();
       node.unsetLimit();
       node.unsetNeedsFinalize();
+      node.setIsPreagg();
 
       DataPartition parentPartition = null;
       if (hasGrouping) {
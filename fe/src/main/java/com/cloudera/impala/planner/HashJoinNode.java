@@ -25,8 +25,10 @@ import com.cloudera.impala.analysis.Expr;
 import com.cloudera.impala.analysis.ExprSubstitutionMap;
 import com.cloudera.impala.analysis.JoinOperator;
 import com.cloudera.impala.analysis.SlotDescriptor;
+import com.cloudera.impala.analysis.SlotId;
 import com.cloudera.impala.analysis.SlotRef;
 import com.cloudera.impala.analysis.TableRef;
+import com.cloudera.impala.analysis.TupleId;
 import com.cloudera.impala.catalog.ColumnStats;
 import com.cloudera.impala.catalog.Table;
 import com.cloudera.impala.catalog.Type;
@@ -87,6 +89,11 @@ public class HashJoinNode extends PlanNode {
   // there are few build rows.
   private boolean addProbeFilters_;
 
+  // Probe slots of eqJoinConjuncts_ whose build values can be sent as global runtime
+  // filters to the scans that produce them in other fragments. Set in
+  // computeGlobalFilterSlots().
+  private List<SlotId> globalFilterSlotIds_ = Lists.newArrayList();
+
   public HashJoinNode(
       PlanNode outer, PlanNode inner, TableRef tblRef,
       List<BinaryPredicate> eqJoinConjuncts, List<Expr> otherJoinConjuncts) {
@@ -144,6 +151,54 @@ public class HashJoinNode extends PlanNode {
   public DistributionMode getDistributionMode() { return distrMode_; }
   public void setDistributionMode(DistributionMode distrMode) { distrMode_ = distrMode; }
   public void setAddProbeFilters(boolean b) { addProbeFilters_ = true; }
+  public List<SlotId> getGlobalFilterSlotIds() { return globalFilterSlotIds_; }
+
+  /**
+   * Computes globalFilterSlotIds_. A scan may only drop rows that fail the filter of
+   * a probe slot if the join drops probe rows without a match anyway, i.e. not for
+   * outer joins that preserve the probe side or left anti joins. In addition, the
+   * rows must reach the join through nodes that do not change the result of the
+   * remaining rows: exchanges and other joins. Rows removed below an inner join can
+   * only turn matches into non-matches of the other side, which are either dropped
+   * or NULL-extended, and NULL never passes this join's eq predicates. Aggregations,
+   * analytic functions, unions and limits are not passed.
+   */
+  public void computeGlobalFilterSlots() {
+    globalFilterSlotIds_.clear();
+    switch (joinOp_) {
+      case INNER_JOIN:
+      case LEFT_SEMI_JOIN:
+      case RIGHT_OUTER_JOIN:
+      case RIGHT_SEMI_JOIN:
+      case RIGHT_ANTI_JOIN:
+        break;
+      default:
+        return;
+    }
+    for (BinaryPredicate conjunct: eqJoinConjuncts_) {
+      if (!(conjunct.getChild(0) instanceof SlotRef)) continue;
+      SlotDescriptor slotDesc = ((SlotRef) conjunct.getChild(0)).getDesc();
+      if (reachesScan(getChild(0), slotDesc.getParent().getId())) {
+        globalFilterSlotIds_.add(slotDesc.getId());
+      }
+    }
+  }
+
+  /**
+   * Returns true if the rows of 'tupleId' in the output of 'node' are produced by an
+   * HdfsScanNode and only pass through exchanges and hash joins without a limit.
+   */
+  private static boolean reachesScan(PlanNode node, TupleId tupleId) {
+    if (node.hasLimit() || !node.getTupleIds().contains(tupleId)) return false;
+    if (node instanceof HdfsScanNode) return true;
+    if (node instanceof ExchangeNode) return reachesScan(node.getChild(0), tupleId);
+    if (node instanceof HashJoinNode) {
+      for (PlanNode child: node.getChildren()) {
+        if (child.getTupleIds().contains(tupleId)) return reachesScan(child, tupleId);
+      }
+    }
+    return false;
+  }
 
   @Override
   public void init(Analyzer analyzer) throws InternalException {
@@ -450,6 +505,9 @@ public class HashJoinNode extends PlanNode {
       msg.hash_join_node.addToOther_join_conjuncts(e.treeToThrift());
     }
     msg.hash_join_node.setAdd_probe_filters(addProbeFilters_);
+    for (SlotId slotId: globalFilterSlotIds_) {
+      msg.hash_join_node.addToGlobal_filter_probe_slot_ids(slotId.asInt());
+    }
   }
 
   @Override
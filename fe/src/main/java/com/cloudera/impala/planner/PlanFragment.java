@@ -30,6 +30,7 @@ import com.cloudera.impala.common.AnalysisException;
 import com.cloudera.impala.common.InternalException;
 import com.cloudera.impala.common.NotImplementedException;
 import com.cloudera.impala.planner.HashJoinNode.DistributionMode;
+import com.cloudera.impala.thrift.TAdaptiveExchangeRole;
 import com.cloudera.impala.thrift.TExplainLevel;
 import com.cloudera.impala.thrift.TPartitionType;
 import com.cloudera.impala.thrift.TPlanFragment;
@@ -87,6 +88,11 @@ public class PlanFragment {
   // if the output is UNPARTITIONED, it is being broadcast
   private DataPartition outputPartition_;
 
+  // if set, this fragment sends one side of a join whose distribution is decided at
+  // runtime; outputPartition_ is then used only if the join is partitioned
+  private PlanNodeId adaptiveJoinNodeId_;
+  private TAdaptiveExchangeRole adaptiveExchangeRole_;
+
   /**
    * C'tor for fragment with specific partition; the output is by default broadcast.
    */
@@ -127,12 +133,18 @@ public class PlanFragment {
    */
   public void finalize(Analyzer analyzer)
       throws InternalException, NotImplementedException {
-    if (planRoot_ != null) computeCanAddSlotFilters(planRoot_);
+    if (planRoot_ != null) {
+      computeCanAddSlotFilters(planRoot_);
+      computeGlobalFilterSlots(planRoot_);
+    }
 
     if (destNode_ != null) {
       Preconditions.checkState(sink_ == null);
       // we're streaming to an exchange node
       DataStreamSink streamSink = new DataStreamSink(destNode_, outputPartition_);
+      if (adaptiveJoinNodeId_ != null) {
+        streamSink.setAdaptiveJoin(adaptiveJoinNodeId_, adaptiveExchangeRole_);
+      }
       streamSink.setFragment(this);
       sink_ = streamSink;
     }
@@ -246,6 +258,17 @@ public class PlanFragment {
     }
   }
 
+  /**
+   * Computes the probe slots of the hash joins of this fragment whose filters can be
+   * sent to scans in other fragments, see HashJoinNode.computeGlobalFilterSlots().
+   * Does not descend into the fragments of exchanges, they are finalized separately.
+   */
+  private void computeGlobalFilterSlots(PlanNode node) {
+    if (node instanceof HashJoinNode) ((HashJoinNode) node).computeGlobalFilterSlots();
+    if (node instanceof ExchangeNode) return;
+    for (PlanNode child: node.getChildren()) computeGlobalFilterSlots(child);
+  }
+
   /**
    * Estimates the per-node number of distinct values of exprs based on the data
    * partition of this fragment and its number of nodes. Returns -1 for an invalid
@@ -339,6 +362,16 @@ public class PlanFragment {
   }
 
   public void setDestination(ExchangeNode destNode) { destNode_ = destNode; }
+
+  /**
+   * Marks this fragment as the sender of the build or probe side of the join with id
+   * 'joinNodeId', whose distribution the backend decides at runtime.
+   */
+  public void setAdaptiveJoin(PlanNodeId joinNodeId, TAdaptiveExchangeRole role) {
+    Preconditions.checkState(destNode_ != null && outputPartition_.isHashPartitioned());
+    adaptiveJoinNodeId_ = joinNodeId;
+    adaptiveExchangeRole_ = role;
+  }
   public boolean hasSink() { return sink_ != null; }
   public DataSink getSink() { return sink_; }
   public void setSink(DataSink sink) {
@@ -688,10 +688,14 @@ public class AnalyzeExprsTest extends AnalyzerTest {
         "RANGE is only supported with both the lower and upper bounds UNBOUNDED or one "
             + "UNBOUNDED and the other CURRENT ROW.");
 
-    // Min/max do not support start bounds with offsets
-    AnalysisError("select max(int_col) over (partition by id order by tinyint_col "
+    // Min/max only support start bounds with offsets for fixed-length types
+    AnalyzesOk("select max(int_col) over (partition by id order by tinyint_col "
+        + "rows 2 preceding) from functional.alltypes");
+    AnalyzesOk("select min(timestamp_col) over (order by id "
+        + "rows between 5 preceding and 2 following) from functional.alltypes");
+    AnalysisError("select max(string_col) over (partition by id order by tinyint_col "
         + "rows 2 preceding) from functional.alltypes",
-        "'max(int_col)' is only supported with an UNBOUNDED PRECEDING start bound.");
+        "'max(string_col)' is only supported with an UNBOUNDED PRECEDING start bound.");
     // If the query can be re-written so that the start is unbounded, it should
     // be supported (IMPALA-1433).
     AnalyzesOk("select max(id) over (order by id rows between current row and "
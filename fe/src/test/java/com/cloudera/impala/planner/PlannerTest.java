@@ -14,9 +14,21 @@
 
 package com.cloudera.impala.planner;
 
+import static org.junit.Assert.assertEquals;
+import static org.junit.Assert.assertTrue;
+
+import java.util.List;
+
 import org.junit.Test;
 
+import com.cloudera.impala.common.ImpalaException;
 import com.cloudera.impala.planner.PlannerTestBase;
+import com.cloudera.impala.thrift.TAdaptiveExchangeRole;
+import com.cloudera.impala.thrift.TDataStreamSink;
+import com.cloudera.impala.thrift.TPartitionType;
+import com.cloudera.impala.thrift.TPlanFragment;
+import com.cloudera.impala.thrift.TPlanNode;
+import com.cloudera.impala.thrift.TPlanNodeType;
 import com.cloudera.impala.thrift.TQueryOptions;
 
 // All planner tests, except for S3 specific tests should go here.
@@ -171,4 +183,110 @@ public class PlannerTest extends PlannerTestBase {
     options.setExec_single_node_rows_threshold(8);
     runPlannerTestFile("small-query-opt", options);
   }
+
+  /**
+   * Checks if the single hash join of the distributed plan of 'query' sends a global
+   * runtime filter on its probe slot.
+   */
+  private void checkGlobalFilter(String query, boolean expectFilter)
+      throws ImpalaException {
+    List<TPlanNode> joins = getDistributedHashJoins(query);
+    assertEquals(query, 1, joins.size());
+    TPlanNode join = joins.get(0);
+    assertEquals(query, expectFilter,
+        join.hash_join_node.isSetGlobal_filter_probe_slot_ids());
+    if (expectFilter) {
+      assertEquals(query, 1,
+          join.hash_join_node.getGlobal_filter_probe_slot_ids().size());
+    }
+  }
+
+  @Test
+  public void testGlobalRuntimeFilters() throws ImpalaException {
+    // straight_join keeps alltypes on the probe side.
+    String select = "select straight_join count(*) from ";
+    // Probe rows without a match are dropped, and they come from a scan through an
+    // exchange.
+    checkGlobalFilter(select +
+        "alltypes a join [shuffle] alltypessmall b on a.id = b.id", true);
+    checkGlobalFilter(select +
+        "alltypes a left semi join [shuffle] alltypessmall b on a.id = b.id", true);
+    checkGlobalFilter(select +
+        "alltypes a right outer join [shuffle] alltypessmall b on a.id = b.id", true);
+    // The join returns the probe rows without a match.
+    checkGlobalFilter(select +
+        "alltypes a left outer join [shuffle] alltypessmall b on a.id = b.id", false);
+    checkGlobalFilter(select +
+        "alltypes a full outer join [shuffle] alltypessmall b on a.id = b.id", false);
+    checkGlobalFilter(select +
+        "alltypes a left anti join [shuffle] alltypessmall b on a.id = b.id", false);
+    // The probe slot is not produced by a scan.
+    checkGlobalFilter(select + "(select id, count(*) from alltypes group by id) a " +
+        "join [shuffle] alltypessmall b on a.id = b.id", false);
+    // Filtering below the limit would change which rows reach the join.
+    checkGlobalFilter(select + "(select id from alltypes limit 10) a " +
+        "join [shuffle] alltypessmall b on a.id = b.id", false);
+  }
+
+  /**
+   * Checks if the join of the distributed plan of 'query', planned with the query option
+   * adaptive_join_distribution, has adaptive build and probe exchanges. If it does, its
+   * fragment must be randomly partitioned, since the join may be broadcast.
+   */
+  private void checkAdaptiveJoin(String query, boolean adaptiveOption,
+      boolean expectAdaptive) throws ImpalaException {
+    TQueryOptions options = defaultQueryOptions();
+    options.setAdaptive_join_distribution(adaptiveOption);
+    List<TPlanFragment> fragments = getDistributedFragments(query, options);
+    int numBuildSinks = 0;
+    int numProbeSinks = 0;
+    for (TPlanFragment fragment: fragments) {
+      if (!fragment.isSetOutput_sink()
+          || !fragment.output_sink.isSetStream_sink()) {
+        continue;
+      }
+      TDataStreamSink sink = fragment.output_sink.stream_sink;
+      if (!sink.isSetAdaptive_join_node_id()) continue;
+      assertEquals(query, TPartitionType.HASH_PARTITIONED, sink.output_partition.type);
+      if (sink.adaptive_exchange_role == TAdaptiveExchangeRole.BUILD) {
+        ++numBuildSinks;
+      } else {
+        ++numProbeSinks;
+      }
+      // The join is in the fragment that the sink sends to.
+      boolean foundJoin = false;
+      for (TPlanFragment joinFragment: fragments) {
+        for (TPlanNode node: joinFragment.plan.nodes) {
+          if (node.node_id != sink.adaptive_join_node_id) continue;
+          assertEquals(query, TPlanNodeType.HASH_JOIN_NODE, node.node_type);
+          assertEquals(query, TPartitionType.RANDOM, joinFragment.partition.type);
+          foundJoin = true;
+        }
+      }
+      assertTrue(query, foundJoin);
+    }
+    assertEquals(query, expectAdaptive ? 1 : 0, numBuildSinks);
+    assertEquals(query, expectAdaptive ? 1 : 0, numProbeSinks);
+  }
+
+  @Test
+  public void testAdaptiveJoins() throws ImpalaException {
+    // The build side is too large to be broadcast according to the stats, as in TPC-H
+    // Q18.
+    String select = "select straight_join count(*) from tpch.lineitem ";
+    String on = " tpch.orders on l_orderkey = o_orderkey";
+    checkAdaptiveJoin(select + "join" + on, true, true);
+    checkAdaptiveJoin(select + "left outer join" + on, true, true);
+    checkAdaptiveJoin(select + "left semi join" + on, true, true);
+    checkAdaptiveJoin(select + "left anti join" + on, true, true);
+    // The option is off.
+    checkAdaptiveJoin(select + "join" + on, false, false);
+    // These joins must not be broadcast.
+    checkAdaptiveJoin(select + "right outer join" + on, true, false);
+    checkAdaptiveJoin(select + "full outer join" + on, true, false);
+    checkAdaptiveJoin(select + "right semi join" + on, true, false);
+    checkAdaptiveJoin(select + "right anti join" + on, true, false);
+    // The query asks for a partitioned join.
+    checkAdaptiveJoin(select + "join [shuffle]" + on, true, false);
+  }
 }
@@ -61,6 +61,7 @@ import com.cloudera.impala.thrift.THdfsTable;
 import com.cloudera.impala.thrift.TNetworkAddress;
 import com.cloudera.impala.thrift.TPlanFragment;
 import com.cloudera.impala.thrift.TPlanNode;
+import com.cloudera.impala.thrift.TPlanNodeType;
 import com.cloudera.impala.thrift.TQueryCtx;
 import com.cloudera.impala.thrift.TQueryExecRequest;
 import com.cloudera.impala.thrift.TQueryOptions;
@@ -320,7 +321,24 @@ public class PlannerTestBase {
     return a;
   }
 
-  private TQueryOptions defaultQueryOptions() {
+  /**
+   * Returns the fragments of the distributed plan of 'query', planned with 'options', or
+   * with defaultQueryOptions() if 'options' is null.
+   */
+  protected List<TPlanFragment> getDistributedFragments(String query,
+      TQueryOptions options) throws ImpalaException {
+    TQueryCtx queryCtx = TestUtils.createQueryContext(
+        "functional", System.getProperty("user.name"));
+    queryCtx.request.query_options = options == null ? defaultQueryOptions() : options;
+    queryCtx.request.getQuery_options().setNum_nodes(
+        ImpalaInternalServiceConstants.NUM_NODES_ALL);
+    queryCtx.request.setStmt(query);
+    TExecRequest execRequest =
+        frontend_.createExecRequest(queryCtx, new StringBuilder());
+    return execRequest.query_exec_request.fragments;
+  }
+
+  protected TQueryOptions defaultQueryOptions() {
     TQueryOptions options = new TQueryOptions();
     options.setExplain_level(TExplainLevel.STANDARD);
     options.setAllow_unsupported_formats(true);
@@ -467,6 +485,21 @@ public class PlannerTestBase {
     }
   }
 
+  /**
+   * Returns the hash join nodes of the distributed plan of 'query' on the functional
+   * database.
+   */
+  protected List<TPlanNode> getDistributedHashJoins(String query)
+      throws ImpalaException {
+    List<TPlanNode> joins = Lists.newArrayList();
+    for (TPlanFragment fragment: getDistributedFragments(query, null)) {
+      for (TPlanNode node: fragment.plan.nodes) {
+        if (node.node_type == TPlanNodeType.HASH_JOIN_NODE) joins.add(node);
+      }
+    }
+    return joins;
+  }
+
   private void testColumnLineageOutput(TestCase testCase, TQueryCtx queryCtx,
       StringBuilder errorLog, StringBuilder actualOutput) throws CatalogException {
     ArrayList<String> expectedLineage = testCase.getSectionContents(Section.LINEAGE);
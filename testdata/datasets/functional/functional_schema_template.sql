@@ -1338,6 +1338,30 @@ ${IMPALA_HOME}/testdata/data/bad_compressed_size.parquet \
 /test-warehouse/bad_compressed_size_parquet/
 ====
 ---- DATASET
+-- Parquet file whose row group has 3 rows but whose metadata states 4 rows.
+functional
+---- BASE_TABLE_NAME
+bad_row_count
+---- COLUMNS
+x STRING
+---- LOAD
+`hadoop fs -mkdir -p /test-warehouse/bad_row_count_parquet && hadoop fs -put -f \
+${IMPALA_HOME}/testdata/data/bad_row_count.parquet \
+/test-warehouse/bad_row_count_parquet/
+====
+---- DATASET
+-- Parquet file whose only column is repeated.
+functional
+---- BASE_TABLE_NAME
+repeated_column
+---- COLUMNS
+x STRING
+---- LOAD
+`hadoop fs -mkdir -p /test-warehouse/repeated_column_parquet && hadoop fs -put -f \
+${IMPALA_HOME}/testdata/data/repeated_column.parquet \
+/test-warehouse/repeated_column_parquet/
+====
+---- DATASET
 functional
 ---- BASE_TABLE_NAME
 bad_serde
@@ -0,0 +1,72 @@
+#!/usr/bin/env python
+# Copyright (c) 2015 Cloudera, Inc. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Tests joins that decide between broadcasting and partitioning at runtime
+# (query option adaptive_join_distribution).
+
+import pytest
+from tests.common.custom_cluster_test_suite import CustomClusterTestSuite
+from tests.common.test_dimensions import (create_single_exec_option_dimension,
+    create_uncompressed_text_dimension)
+
+# Joins that the planner partitions because orders is too large to broadcast according
+# to the stats. The join types allow broadcasting.
+QUERIES = [
+    "select straight_join count(*), sum(l_quantity), max(o_comment) "
+    "from tpch.lineitem join tpch.orders on l_orderkey = o_orderkey",
+    "select straight_join count(*), count(o_orderkey), min(o_totalprice) "
+    "from tpch.lineitem left outer join tpch.orders "
+    "on l_orderkey = o_orderkey and o_orderstatus = 'F'",
+    "select straight_join count(*), sum(l_extendedprice) "
+    "from tpch.lineitem left semi join tpch.orders "
+    "on l_orderkey = o_orderkey and o_orderpriority = '1-URGENT'",
+    "select straight_join count(*), sum(l_extendedprice) "
+    "from tpch.lineitem left anti join tpch.orders "
+    "on l_orderkey = o_orderkey and o_orderpriority = '1-URGENT'"]
+
+class TestAdaptiveJoins(CustomClusterTestSuite):
+  @classmethod
+  def get_workload(self):
+    return 'tpch'
+
+  @classmethod
+  def add_test_dimensions(cls):
+    super(TestAdaptiveJoins, cls).add_test_dimensions()
+    cls.TestMatrix.clear_constraints()
+    cls.TestMatrix.add_dimension(create_uncompressed_text_dimension(cls.get_workload()))
+    cls.TestMatrix.add_dimension(create_single_exec_option_dimension())
+
+  def _check_queries(self, expected_mode):
+    for query in QUERIES:
+      expected = self.execute_query(query)
+      result = self.execute_query(query, {'adaptive_join_distribution': 1})
+      assert result.data == expected.data, query
+      profile = result.runtime_profile
+      assert 'AdaptiveExchangeMode: %s' % expected_mode in profile, profile
+      assert 'AdaptiveExchangeMode' not in expected.runtime_profile, query
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(
+      impalad_args="--adaptive_join_max_broadcast_bytes=%d" % (1024 * 1024 * 1024))
+  def test_broadcast(self, vector):
+    # The build sides fit the limit, so the joins are broadcast.
+    self._check_queries('BROADCAST')
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(
+      impalad_args="--adaptive_join_max_broadcast_bytes=1024")
+  def test_partitioned(self, vector):
+    # The build sides exceed the limit, so the joins stay partitioned.
+    self._check_queries('PARTITIONED')
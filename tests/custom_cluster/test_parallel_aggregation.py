@@ -0,0 +1,43 @@
+#!/usr/bin/env python
+# Copyright (c) 2015 Cloudera, Inc. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Tests for aggregations that consume their input with several threads.
+
+import pytest
+from tests.common.custom_cluster_test_suite import CustomClusterTestSuite
+from tests.common.test_dimensions import (ALL_NODES_ONLY,
+    create_exec_option_dimension, create_uncompressed_text_dimension)
+
+class TestParallelAggregation(CustomClusterTestSuite):
+  @classmethod
+  def get_workload(self):
+    return 'functional-query'
+
+  @classmethod
+  def add_test_dimensions(cls):
+    super(TestParallelAggregation, cls).add_test_dimensions()
+    cls.TestMatrix.clear_constraints()
+    cls.TestMatrix.add_dimension(create_uncompressed_text_dimension(cls.get_workload()))
+    # Small batches make the threads interleave more often.
+    cls.TestMatrix.add_dimension(create_exec_option_dimension(
+        cluster_sizes=ALL_NODES_ONLY, disable_codegen_options=[False],
+        batch_sizes=[0, 16]))
+
+  # The input rows of the merge aggregations reference the tuple data that the
+  # exchange attached to later batches, so the threads must not reset them early.
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(impalad_args="--aggregation_threads=4")
+  def test_parallel_aggregation(self, vector):
+    self.run_test_case('QueryTest/parallel-aggregation', vector)
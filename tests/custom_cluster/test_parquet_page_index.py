@@ -0,0 +1,99 @@
+#!/usr/bin/env python
+# Copyright (c) 2015 Cloudera, Inc. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Tests that Parquet files written with page indexes and bloom filters are read back
+# with the same results, while the scanner skips pages and row groups.
+
+import pytest
+import re
+from tests.common.custom_cluster_test_suite import CustomClusterTestSuite
+from tests.common.test_dimensions import (create_single_exec_option_dimension,
+    create_uncompressed_text_dimension)
+
+TEST_DB = 'parquet_page_index_db'
+WRITER_ARGS = "--parquet_write_page_index=true --parquet_bloom_filter_columns=o_custkey"
+SELECT_LIST = "count(*), sum(o_custkey), min(o_orderstatus), max(o_comment)"
+
+class TestParquetPageIndex(CustomClusterTestSuite):
+  @classmethod
+  def get_workload(self):
+    return 'tpch'
+
+  @classmethod
+  def add_test_dimensions(cls):
+    super(TestParquetPageIndex, cls).add_test_dimensions()
+    cls.TestMatrix.clear_constraints()
+    cls.TestMatrix.add_dimension(create_uncompressed_text_dimension(cls.get_workload()))
+    cls.TestMatrix.add_dimension(create_single_exec_option_dimension())
+
+  def _counter_sum(self, name, profile):
+    # Counters are printed as e.g. '12', or '1.23K (1230)' for larger values.
+    total = 0
+    for value, exact in re.findall(r'%s: (\S+)(?: \((\d+)\))?' % name, profile):
+      total += int(exact or value)
+    return total
+
+  def _create_orders(self):
+    self.cleanup_db(TEST_DB)
+    self.execute_query("create database %s" % TEST_DB)
+    # A single writer keeps the rows in the order of tpch.orders, which is sorted by
+    # o_orderkey, so that the pages of o_orderkey cover narrow ranges.
+    self.execute_query("create table %s.orders stored as parquet as "
+        "select o_orderkey, o_custkey, o_orderstatus, o_comment from tpch.orders"
+        % TEST_DB, {'num_nodes': 1})
+
+  def _check_query(self, where):
+    expected = self.execute_query("select %s from tpch.orders where %s"
+        % (SELECT_LIST, where))
+    result = self.execute_query("select %s from %s.orders where %s"
+        % (SELECT_LIST, TEST_DB, where))
+    assert result.data == expected.data, where
+    return result.runtime_profile
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(impalad_args=WRITER_ARGS)
+  def test_page_index_round_trip(self, vector):
+    self._create_orders()
+    try:
+      # Predicates that select a few pages of o_orderkey.
+      for where in ["o_orderkey = 3000000", "o_orderkey in (1, 4000000, 5999975)",
+          "o_orderkey < 1000", "o_orderkey between 2000000 and 2001000",
+          "1000 > o_orderkey"]:
+        profile = self._check_query(where)
+        assert self._counter_sum('NumPageIndexSkippedPages', profile) > 0, profile
+
+      # Predicates that skip little or nothing, or compare with NULL, must not change
+      # the results either.
+      for where in ["o_orderkey > 0", "o_comment like '%express%'",
+          "o_orderkey = null", "o_orderkey in (null, 7)"]:
+        self._check_query(where)
+
+      # No orders have a customer key that is a multiple of 3, so the bloom filter
+      # rejects the row groups although the value is between their min and max.
+      profile = self._check_query("o_custkey = 3")
+      assert self._counter_sum('NumBloomFilteredRowGroups', profile) > 0, profile
+    finally:
+      self.cleanup_db(TEST_DB)
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(
+      impalad_args=WRITER_ARGS + " --parquet_index_filtering=false")
+  def test_index_filtering_disabled(self, vector):
+    self._create_orders()
+    try:
+      profile = self._check_query("o_orderkey = 3000000")
+      assert self._counter_sum('NumPageIndexSkippedPages', profile) == 0, profile
+    finally:
+      self.cleanup_db(TEST_DB)
@@ -0,0 +1,110 @@
+#!/usr/bin/env python
+# Copyright (c) 2015 Cloudera, Inc. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Tests that the Parquet writer produces the same data when it encodes the columns in
+# parallel (--parquet_writer_threads > 1) as when it encodes them on the fragment
+# thread, and that errors of the column threads fail the insert.
+
+import pytest
+from tests.common.custom_cluster_test_suite import CustomClusterTestSuite
+from tests.common.test_dimensions import (create_single_exec_option_dimension,
+    create_uncompressed_text_dimension)
+
+TEST_DB = 'parquet_writer_threads_db'
+PARALLEL_ARGS = "--parquet_writer_threads=4"
+# Small enough that tpch.orders is written to several files, i.e. row groups, each
+# with many data pages per column.
+FILE_SIZE = 8 * 1024 * 1024
+
+# Order independent checksum of every column. Sums of bigints wrap around on overflow,
+# which does not depend on the order of the rows either.
+ORDERS_CHECKSUM = ("select count(*), sum(o_orderkey), sum(o_custkey), "
+    "sum(fnv_hash(o_orderstatus)), sum(o_totalprice), sum(fnv_hash(o_orderdate)), "
+    "sum(fnv_hash(o_orderpriority)), sum(fnv_hash(o_clerk)), sum(o_shippriority), "
+    "sum(fnv_hash(o_comment)) from %s")
+# alltypesagg has NULLs in most columns.
+ALLTYPESAGG_CHECKSUM = ("select count(*), count(bool_col), sum(tinyint_col), "
+    "sum(smallint_col), sum(int_col), sum(bigint_col), sum(fnv_hash(float_col)), "
+    "sum(fnv_hash(double_col)), sum(fnv_hash(date_string_col)), "
+    "sum(fnv_hash(string_col)), sum(fnv_hash(timestamp_col)) from %s")
+
+class TestParquetWriterThreads(CustomClusterTestSuite):
+  @classmethod
+  def get_workload(self):
+    return 'tpch'
+
+  @classmethod
+  def add_test_dimensions(cls):
+    super(TestParquetWriterThreads, cls).add_test_dimensions()
+    cls.TestMatrix.clear_constraints()
+    cls.TestMatrix.add_dimension(create_uncompressed_text_dimension(cls.get_workload()))
+    cls.TestMatrix.add_dimension(create_single_exec_option_dimension())
+
+  def _num_files(self, table):
+    ls = self.hdfs_client.list_dir("test-warehouse/%s.db/%s/" % (TEST_DB, table))
+    return len([f for f in ls['FileStatuses']['FileStatus'] if f['type'] == 'FILE'])
+
+  def _check_insert(self, table, source, checksum, query_options):
+    self.execute_query("create table %s.%s stored as parquet as select * from %s"
+        % (TEST_DB, table, source), query_options)
+    expected = self.execute_query(checksum % source)
+    result = self.execute_query(checksum % ("%s.%s" % (TEST_DB, table)))
+    assert result.data == expected.data, table
+
+  def _check_inserts(self):
+    self.cleanup_db(TEST_DB)
+    self.execute_query("create database %s" % TEST_DB)
+    try:
+      # A single writer with a small file size writes several row groups.
+      options = {'num_nodes': 1, 'parquet_file_size': FILE_SIZE}
+      for codec in ['none', 'snappy']:
+        options['compression_codec'] = codec
+        table = "orders_%s" % codec
+        self._check_insert(table, "tpch.orders", ORDERS_CHECKSUM, options)
+        assert self._num_files(table) > 1, table
+      self._check_insert("alltypesagg", "functional.alltypesagg", ALLTYPESAGG_CHECKSUM,
+          {'num_nodes': 1})
+    finally:
+      self.cleanup_db(TEST_DB)
+
+  @pytest.mark.execute_serially
+  def test_serial_writer(self, vector):
+    self._check_inserts()
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(impalad_args=PARALLEL_ARGS)
+  def test_parallel_writer(self, vector):
+    self._check_inserts()
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(
+      impalad_args=PARALLEL_ARGS + " --debug_parquet_writer_fail_column=2")
+  def test_column_thread_error(self, vector):
+    self.cleanup_db(TEST_DB)
+    self.execute_query("create database %s" % TEST_DB)
+    try:
+      result = self.execute_query_expect_failure(self.client,
+          "create table %s.orders stored as parquet as select * from tpch.orders"
+          % TEST_DB,
+          {'num_nodes': 1, 'parquet_file_size': FILE_SIZE})
+      assert "Debug failure appending column 2" in str(result)
+      # The column threads are still usable after the failure. This table has no
+      # column 2, so the insert succeeds.
+      self.execute_query("create table %s.orders_keys stored as parquet as "
+          "select o_orderkey, o_custkey from tpch.orders" % TEST_DB, {'num_nodes': 1})
+      result = self.execute_query("select count(*) from %s.orders_keys" % TEST_DB)
+      assert result.data == ['1500000']
+    finally:
+      self.cleanup_db(TEST_DB)
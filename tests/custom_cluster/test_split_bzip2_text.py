@@ -0,0 +1,86 @@
+#!/usr/bin/env python
+# Copyright (c) 2015 Cloudera, Inc. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Tests that a bzip2-compressed text file with many bzip2 blocks is read without losing
+# or duplicating rows when it is split into scan ranges (--split_bzip2_text).
+
+import bz2
+import pytest
+import random
+from tests.common.custom_cluster_test_suite import CustomClusterTestSuite
+from tests.common.test_dimensions import (create_single_exec_option_dimension,
+    create_uncompressed_text_dimension)
+
+TEST_DB = 'split_bzip2_text_db'
+NUM_ROWS = 200000
+# Scan range lengths that are much smaller than, close to and larger than the
+# compressed bzip2 blocks, so that ranges contain no block start, one or several.
+SCAN_RANGE_LENGTHS = [1024, 16 * 1024, 100 * 1024, 0]
+
+class TestSplitBzip2Text(CustomClusterTestSuite):
+  @classmethod
+  def get_workload(self):
+    return 'functional-query'
+
+  @classmethod
+  def add_test_dimensions(cls):
+    super(TestSplitBzip2Text, cls).add_test_dimensions()
+    cls.TestMatrix.clear_constraints()
+    cls.TestMatrix.add_dimension(create_uncompressed_text_dimension(cls.get_workload()))
+    cls.TestMatrix.add_dimension(create_single_exec_option_dimension())
+
+  def _create_table(self):
+    """Creates a table with a single bzip2 file and returns the expected result of
+    CHECK_QUERY."""
+    rand = random.Random(0)
+    rows = []
+    total_len = 0
+    for i in xrange(NUM_ROWS):
+      # Rows of different lengths, so that rows span the block boundaries at different
+      # offsets.
+      s = ''.join(rand.choice('abcdefgh') for j in xrange(rand.randint(0, 40)))
+      rows.append("%d,%s\n" % (i, s))
+      total_len += len(s)
+    # Compression level 1 uses blocks of 100KB of uncompressed data.
+    data = bz2.compress(''.join(rows), 1)
+
+    self.cleanup_db(TEST_DB)
+    self.execute_query("create database %s" % TEST_DB)
+    self.execute_query("create table %s.t (id int, s string) row format delimited "
+        "fields terminated by ','" % TEST_DB)
+    self.hdfs_client.create_file("test-warehouse/%s.db/t/data.bz2" % TEST_DB, data)
+    self.execute_query("refresh %s.t" % TEST_DB)
+    return ["%d\t%d\t%d\t%d\t%d" %
+        (NUM_ROWS, NUM_ROWS, 0, NUM_ROWS - 1, sum(xrange(NUM_ROWS)) + total_len)]
+
+  def _check_scan_ranges(self):
+    expected = self._create_table()
+    try:
+      for length in SCAN_RANGE_LENGTHS:
+        result = self.execute_query("select count(*), count(distinct id), min(id), "
+            "max(id), sum(id) + sum(length(s)) from %s.t" % TEST_DB,
+            {'max_scan_range_length': length})
+        assert result.data == expected, length
+    finally:
+      self.cleanup_db(TEST_DB)
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(impalad_args="--split_bzip2_text=true")
+  def test_split_bzip2_text(self, vector):
+    self._check_scan_ranges()
+
+  @pytest.mark.execute_serially
+  def test_unsplit_bzip2_text(self, vector):
+    self._check_scan_ranges()
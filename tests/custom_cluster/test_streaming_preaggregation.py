@@ -0,0 +1,56 @@
+#!/usr/bin/env python
+# Copyright (c) 2015 Cloudera, Inc. All rights reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+# Tests for pre-aggregations that stop growing their hash tables and pass rows through.
+
+import pytest
+import re
+from tests.common.custom_cluster_test_suite import CustomClusterTestSuite
+from tests.common.test_dimensions import (ALL_NODES_ONLY,
+    create_exec_option_dimension, create_uncompressed_text_dimension)
+
+# Small enough that the hash table of every pre-aggregation partition reaches it.
+MAX_HT_BYTES_ARGS = "--streaming_preagg_max_ht_bytes=1024"
+
+class TestStreamingPreaggregation(CustomClusterTestSuite):
+  @classmethod
+  def get_workload(self):
+    return 'functional-query'
+
+  @classmethod
+  def add_test_dimensions(cls):
+    super(TestStreamingPreaggregation, cls).add_test_dimensions()
+    cls.TestMatrix.clear_constraints()
+    cls.TestMatrix.add_dimension(create_uncompressed_text_dimension(cls.get_workload()))
+    cls.TestMatrix.add_dimension(create_exec_option_dimension(
+        cluster_sizes=ALL_NODES_ONLY, disable_codegen_options=[False, True],
+        batch_sizes=[0, 16]))
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(impalad_args=MAX_HT_BYTES_ARGS)
+  def test_streaming_preaggregation(self, vector):
+    self.run_test_case('QueryTest/streaming-preaggregation', vector)
+
+  @pytest.mark.execute_serially
+  @CustomClusterTestSuite.with_args(impalad_args=MAX_HT_BYTES_ARGS)
+  def test_rows_passed_through(self, vector):
+    result = self.execute_query(
+        "select count(*) from (select id, count(*) from functional.alltypes "
+        "group by id) t")
+    assert result.data == ['7300']
+    # The counter is printed as e.g. '7.28K (7280)', or '0' if no row was passed through.
+    counters = re.findall(r'RowsPassedThrough: (\S+)', result.runtime_profile)
+    assert len(counters) > 0, result.runtime_profile
+    assert any(counter != '0' for counter in counters), result.runtime_profile
@@ -47,6 +47,11 @@ class TestJoinQueries(ImpalaTestSuite):
     new_vector.get_value('exec_option')['batch_size'] = vector.get_value('batch_size')
     self.run_test_case('QueryTest/outer-joins', new_vector)
 
+  def test_global_runtime_filters(self, vector):
+    new_vector = copy(vector)
+    new_vector.get_value('exec_option')['batch_size'] = vector.get_value('batch_size')
+    self.run_test_case('QueryTest/global-runtime-filters', new_vector)
+
 @skip_if_s3_insert
 class TestSemiJoinQueries(ImpalaTestSuite):
   @classmethod
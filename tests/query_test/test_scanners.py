@@ -200,6 +200,32 @@ class TestParquet(ImpalaTestSuite):
   def test_parquet(self, vector):
     self.run_test_case('QueryTest/parquet', vector)
 
+  def test_filter_mid_batch(self, vector):
+    # The conjuncts filter out tuples in the middle of batches, which the scanner then
+    # compacts. Small batches also end in the middle of row groups.
+    for batch_size in [0, 16]:
+      vector.get_value('exec_option')['batch_size'] = batch_size
+      self.run_test_case('QueryTest/parquet-filter', vector)
+
+  def test_row_group_row_count_mismatch(self, vector):
+    # bad_row_count.parquet has a row group with 3 rows whose metadata states 4 rows.
+    query = "select x from functional_parquet.bad_row_count"
+    error = "there are 4 rows, but only 3 rows were read"
+    result = self.execute_query(query, {'abort_on_error': 0})
+    assert result.data == ['parquet', 'parquet', 'parquet']
+    assert error in result.log
+    e = self.execute_query_expect_failure(self.client, query, {'abort_on_error': 1})
+    assert error in str(e)
+
+  def test_repeated_column(self, vector):
+    # Page indexes are only used for flat columns. A predicate on a repeated column
+    # must fail like any other read of it.
+    error = "contains an unsupported column repetition type"
+    for query in ["select x from functional_parquet.repeated_column",
+        "select x from functional_parquet.repeated_column where x = 'parquet'"]:
+      e = self.execute_query_expect_failure(self.client, query)
+      assert error in str(e), query
+
 class TestParquetComplexTypes(ImpalaTestSuite):
   COMPLEX_COLUMN_TABLE = "functional_parquet.nested_column_types"
 
@@ -265,6 +291,13 @@ class TestParquetComplexTypes(ImpalaTestSuite):
     assert(len(result.data) == 2)
     assert(result.data[1] == "bar")
 
+    # Predicates on the flat columns can be used for index filtering next to the
+    # repeated columns.
+    result = self.execute_query(
+      "select a, f from %s where f = 'bar' and a < 2" % self.COMPLEX_COLUMN_TABLE)
+    assert(len(result.data) == 2)
+    assert(result.data[1] == "1\tbar")
+
     result = self.execute_query(
       "select p2, f from %s" % self.COMPLEX_COLUMN_TABLE)
     assert(len(result.data) == 2)